@@ -0,0 +1,454 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "async/engine.h"
+#include "async/queue.h"
+#include "cli/node_ops.h"
+#include "core/interface.h"
+#include "core/node.h"
+#include "core/pktbuf.h"
+#include "topology/topology.h"
+#include "utils/byteops.h"
+#include "utils/magi_error.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_QUEUE_PRODUCERS 4U
+#define BENCH_QUEUE_MESSAGES 1000000U
+#define BENCH_LEGACY_CAPACITY 256U
+#define BENCH_HOSTS 8U
+#define BENCH_FRAMES_PER_HOST 50000U
+#define BENCH_FRAME_LEN 64U
+#define BENCH_ETHERTYPE 0x88B5U
+#define BENCH_POD_HOSTS 9U
+#define BENCH_SCALE_PRODUCERS 4U
+#define BENCH_SCALE_FRAMES 100000U
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* The pre-MPSC queue: one mutex and two condvars taken on every push and pop. */
+typedef struct LegacyQueue {
+  MagiMsg items[BENCH_LEGACY_CAPACITY];
+  size_t head;
+  size_t tail;
+  size_t count;
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+} LegacyQueue;
+
+static void legacy_push(LegacyQueue* q, MagiMsg msg) {
+  pthread_mutex_lock(&q->lock);
+  while (q->count == BENCH_LEGACY_CAPACITY) {
+    pthread_cond_wait(&q->not_full, &q->lock);
+  }
+  q->items[q->tail] = msg;
+  q->tail = (q->tail + 1U) % BENCH_LEGACY_CAPACITY;
+  q->count++;
+  pthread_cond_signal(&q->not_empty);
+  pthread_mutex_unlock(&q->lock);
+}
+
+static MagiMsg legacy_pop(LegacyQueue* q) {
+  pthread_mutex_lock(&q->lock);
+  while (q->count == 0U) {
+    pthread_cond_wait(&q->not_empty, &q->lock);
+  }
+  MagiMsg msg = q->items[q->head];
+  q->head = (q->head + 1U) % BENCH_LEGACY_CAPACITY;
+  q->count--;
+  pthread_cond_signal(&q->not_full);
+  pthread_mutex_unlock(&q->lock);
+  return msg;
+}
+
+typedef struct QueueBench {
+  LegacyQueue* legacy;
+  MagiQueue* ring;
+} QueueBench;
+
+static void* queue_producer(void* ctx) {
+  QueueBench* bench = ctx;
+  MagiMsg msg = {0};
+  msg.len = 1U;
+  for (size_t index = 0U; index < BENCH_QUEUE_MESSAGES; ++index) {
+    if (bench->legacy != NULL) {
+      legacy_push(bench->legacy, msg);
+    } else {
+      (void)queue_push_blocking(bench->ring, msg);
+    }
+  }
+  return NULL;
+}
+
+/* BENCH_QUEUE_PRODUCERS threads push into one queue; the main thread is the consumer. */
+static double bench_queue(QueueBench* bench) {
+  pthread_t threads[BENCH_QUEUE_PRODUCERS];
+  size_t total = (size_t)BENCH_QUEUE_PRODUCERS * BENCH_QUEUE_MESSAGES;
+  size_t received = 0U;
+
+  double start = now_sec();
+  for (size_t index = 0U; index < BENCH_QUEUE_PRODUCERS; ++index) {
+    pthread_create(&threads[index], NULL, queue_producer, bench);
+  }
+  while (received < total) {
+    if (bench->legacy != NULL) {
+      received += legacy_pop(bench->legacy).len;
+    } else {
+      MagiMsg batch[32];
+      size_t count = queue_pop_batch(bench->ring, batch, 32U);
+      for (size_t index = 0U; index < count; ++index) {
+        received += batch[index].len;
+      }
+    }
+  }
+  double elapsed = now_sec() - start;
+  for (size_t index = 0U; index < BENCH_QUEUE_PRODUCERS; ++index) {
+    pthread_join(threads[index], NULL);
+  }
+  return (double)total / elapsed;
+}
+
+static void bench_queues(void) {
+  LegacyQueue legacy = {.lock = PTHREAD_MUTEX_INITIALIZER,
+                        .not_empty = PTHREAD_COND_INITIALIZER,
+                        .not_full = PTHREAD_COND_INITIALIZER};
+  QueueBench locked = {.legacy = &legacy, .ring = NULL};
+  double locked_rate = bench_queue(&locked);
+
+  QueueBench mpsc = {.legacy = NULL, .ring = queue_new(BENCH_LEGACY_CAPACITY)};
+  if (mpsc.ring == NULL) {
+    fprintf(stderr, "RESULT: FAIL - queue_new\n");
+    exit(1);
+  }
+  double mpsc_rate = bench_queue(&mpsc);
+
+  fprintf(stderr, "queue, %u producers x %u msgs, %u slots:\n", BENCH_QUEUE_PRODUCERS,
+          BENCH_QUEUE_MESSAGES, BENCH_LEGACY_CAPACITY);
+  fprintf(stderr, "  mutex+condvar ring: %.2f Mmsg/s\n", locked_rate / 1e6);
+  fprintf(stderr, "  lock-free MPSC:     %.2f Mmsg/s (%zu consumer wakeups)\n", mpsc_rate / 1e6,
+          queue_wakeups(mpsc.ring));
+  queue_free(mpsc.ring);
+}
+
+#ifdef MAGI_ASYNC
+
+static atomic_size_t frames_delivered;
+
+static void sink_receive(Node* node, Interface* iface, const uint8_t* data, size_t len) {
+  (void)node;
+  (void)iface;
+  (void)data;
+  (void)len;
+  atomic_fetch_add_explicit(&frames_delivered, 1U, memory_order_relaxed);
+}
+
+typedef struct HostTraffic {
+  Interface* iface;
+  uint8_t dst_mac[6];
+  size_t frames;
+} HostTraffic;
+
+static PktBuf* make_frame(const uint8_t dst_mac[6], const uint8_t src_mac[6]) {
+  PktBuf* pkt = pktbuf_new(0U, BENCH_FRAME_LEN);
+  uint8_t* frame = pktbuf_put(pkt, BENCH_FRAME_LEN);
+  if (frame == NULL) {
+    fprintf(stderr, "RESULT: FAIL - pktbuf_new\n");
+    exit(1);
+  }
+  memset(frame, 0, BENCH_FRAME_LEN);
+  memcpy(frame, dst_mac, 6U);
+  memcpy(frame + 6U, src_mac, 6U);
+  WRITE_U16(frame, 12U, BENCH_ETHERTYPE);
+  return pkt;
+}
+
+static void* host_producer(void* ctx) {
+  HostTraffic* traffic = ctx;
+  for (size_t index = 0U; index < traffic->frames; ++index) {
+    (void)interface_send_pkt(traffic->iface, make_frame(traffic->dst_mac, traffic->iface->mac));
+  }
+  return NULL;
+}
+
+static size_t topology_drops(const Topology* topology) {
+  size_t drops = 0U;
+  for (size_t index = 0U; index < topology->nodes->capacity; ++index) {
+    HashEntry* entry = &topology->nodes->entries[index];
+    if (entry->key != NULL && !entry->tombstone) {
+      drops += queue_dropped(((TopologyNodeInfo*)entry->value)->node->queue);
+    }
+  }
+  return drops;
+}
+
+/* Wait until every sent frame is delivered or dropped; give up after 10 s without progress. */
+static bool wait_accounted(const Topology* topology, size_t sent, size_t base_drops) {
+  size_t last = 0U;
+  double deadline = now_sec() + 10.0;
+  while (now_sec() < deadline) {
+    size_t seen = atomic_load(&frames_delivered) + topology_drops(topology) - base_drops;
+    if (seen >= sent) {
+      return seen == sent;
+    }
+    if (seen != last) {
+      last = seen;
+      deadline = now_sec() + 10.0;
+    }
+    struct timespec pause = {.tv_sec = 0, .tv_nsec = 100000L};
+    nanosleep(&pause, NULL);
+  }
+  return false;
+}
+
+/*
+ * H1-H4 hang off S1 and H5-H8 off S2. H1-H4 send across the trunk to H5-H8, and
+ * H5-H8 send to each other, so the S1 -> S2 trunk and S2's queue carry all the
+ * load. Traffic never flows S2 -> S1, which keeps back-pressure mode free of
+ * the two-switch wait cycle documented on engine_set_backpressure().
+ */
+static void bench_topology(bool backpressure) {
+  Topology* topology = topology_new();
+  topology_set_node_ops(topology, cli_topology_node_ops());
+  Node* hosts[BENCH_HOSTS];
+  bool ok = topology_add_node(topology, TOPOLOGY_NODE_SWITCH, "S1") != NULL &&
+            topology_add_node(topology, TOPOLOGY_NODE_SWITCH, "S2") != NULL &&
+            topology_add_link(topology, "S1", 5U, "S2", 5U, 0U, 1500U) != NULL;
+  for (size_t index = 0U; ok && index < BENCH_HOSTS; ++index) {
+    char name[8];
+    snprintf(name, sizeof(name), "H%zu", index + 1U);
+    TopologyNodeInfo* info = topology_add_node(topology, TOPOLOGY_NODE_HOST, name);
+    ok = info != NULL && topology_add_link(topology, name, 1U, index < 4U ? "S1" : "S2",
+                                           (uint16_t)(index % 4U + 1U), 0U, 1500U) != NULL;
+    if (ok) {
+      hosts[index] = info->node;
+      hosts[index]->handle_receive = sink_receive;
+    }
+  }
+  if (!ok) {
+    fprintf(stderr, "RESULT: FAIL - topology setup\n");
+    exit(1);
+  }
+
+  engine_set_backpressure(backpressure);
+  if (engine_init(topology) != MAGI_OK) {
+    fprintf(stderr, "RESULT: FAIL - engine_init\n");
+    exit(1);
+  }
+
+  /* One broadcast per host teaches both switches every MAC before timing starts. */
+  static const uint8_t broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+  atomic_store(&frames_delivered, 0U);
+  for (size_t index = 0U; index < BENCH_HOSTS; ++index) {
+    Interface* iface = node_get_interface(hosts[index], 1U);
+    (void)interface_send_pkt(iface, make_frame(broadcast, iface->mac));
+  }
+  if (!wait_accounted(topology, BENCH_HOSTS * (BENCH_HOSTS - 1U), 0U)) {
+    fprintf(stderr, "RESULT: FAIL - MAC learning warm-up\n");
+    exit(1);
+  }
+
+  HostTraffic traffic[BENCH_HOSTS];
+  pthread_t threads[BENCH_HOSTS];
+  for (size_t index = 0U; index < BENCH_HOSTS; ++index) {
+    size_t peer = index < 4U ? index + 4U : 4U + (index - 3U) % 4U;
+    traffic[index].iface = node_get_interface(hosts[index], 1U);
+    traffic[index].frames = BENCH_FRAMES_PER_HOST;
+    memcpy(traffic[index].dst_mac, node_get_interface(hosts[peer], 1U)->mac, 6U);
+  }
+
+  size_t sent = (size_t)BENCH_HOSTS * BENCH_FRAMES_PER_HOST;
+  size_t base_drops = topology_drops(topology);
+  atomic_store(&frames_delivered, 0U);
+  double start = now_sec();
+  for (size_t index = 0U; index < BENCH_HOSTS; ++index) {
+    pthread_create(&threads[index], NULL, host_producer, &traffic[index]);
+  }
+  for (size_t index = 0U; index < BENCH_HOSTS; ++index) {
+    pthread_join(threads[index], NULL);
+  }
+  bool accounted = wait_accounted(topology, sent, base_drops);
+  double elapsed = now_sec() - start;
+
+  size_t delivered = atomic_load(&frames_delivered);
+  size_t drops = topology_drops(topology) - base_drops;
+  size_t threads_used = engine_thread_count();
+  engine_shutdown();
+  topology_free(topology);
+
+  fprintf(stderr,
+          "%-13s %zu frames in %.3f s -> %.0f delivered frames/s, %zu dropped, %zu threads\n",
+          backpressure ? "back-pressure:" : "drop-on-full:", sent, elapsed,
+          (double)delivered / elapsed, drops, threads_used);
+  if (!accounted || (backpressure && delivered != sent)) {
+    fprintf(stderr, "RESULT: FAIL - %zu of %zu frames unaccounted for\n", sent - delivered - drops,
+            sent);
+    exit(1);
+  }
+}
+
+typedef struct ScaleProducer {
+  Interface** ifaces;
+  uint8_t (*dst_macs)[6];
+  size_t hosts;
+  size_t first;
+  size_t frames;
+} ScaleProducer;
+
+/* Send frames round-robin from every BENCH_SCALE_PRODUCERS-th host starting at first. */
+static void* scale_producer(void* ctx) {
+  ScaleProducer* producer = ctx;
+  size_t host = producer->first;
+  for (size_t index = 0U; index < producer->frames; ++index) {
+    (void)interface_send_pkt(producer->ifaces[host],
+                             make_frame(producer->dst_macs[host], producer->ifaces[host]->mac));
+    host += BENCH_SCALE_PRODUCERS;
+    if (host >= producer->hosts) {
+      host = producer->first;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * nodes / 10 pods of one switch and nine hosts, with the pod switches chained.
+ * Each host streams to the next host in its pod, so every switch and host
+ * node is busy and the pool has to spread them over its workers.
+ */
+static void bench_scale(size_t nodes, size_t workers) {
+  size_t pods = nodes / (BENCH_POD_HOSTS + 1U);
+  size_t hosts = pods * BENCH_POD_HOSTS;
+  Topology* topology = topology_new();
+  topology_set_node_ops(topology, cli_topology_node_ops());
+  Interface** ifaces = calloc(hosts, sizeof(*ifaces));
+  uint8_t (*dst_macs)[6] = calloc(hosts, sizeof(*dst_macs));
+  bool ok = topology != NULL && ifaces != NULL && dst_macs != NULL;
+
+  for (size_t pod = 0U; ok && pod < pods; ++pod) {
+    char sw[24];
+    char prev[24];
+    snprintf(sw, sizeof(sw), "P%zu", pod);
+    snprintf(prev, sizeof(prev), "P%zu", pod - 1U);
+    ok = topology_add_node(topology, TOPOLOGY_NODE_SWITCH, sw) != NULL &&
+         (pod == 0U || topology_add_link(topology, prev, 11U, sw, 10U, 0U, 1500U) != NULL);
+    for (size_t slot = 0U; ok && slot < BENCH_POD_HOSTS; ++slot) {
+      char name[32];
+      snprintf(name, sizeof(name), "P%zuH%zu", pod, slot);
+      TopologyNodeInfo* info = topology_add_node(topology, TOPOLOGY_NODE_HOST, name);
+      ok = info != NULL &&
+           topology_add_link(topology, name, 1U, sw, (uint16_t)(slot + 1U), 0U, 1500U) != NULL;
+      if (ok) {
+        info->node->handle_receive = sink_receive;
+        ifaces[pod * BENCH_POD_HOSTS + slot] = node_get_interface(info->node, 1U);
+      }
+    }
+  }
+  if (!ok) {
+    fprintf(stderr, "RESULT: FAIL - scale topology setup\n");
+    exit(1);
+  }
+  for (size_t host = 0U; host < hosts; ++host) {
+    size_t pod_base = host - host % BENCH_POD_HOSTS;
+    memcpy(dst_macs[host], ifaces[pod_base + (host + 1U) % BENCH_POD_HOSTS]->mac, 6U);
+  }
+
+  engine_set_backpressure(true);
+  engine_set_worker_count(workers);
+  if (engine_init(topology) != MAGI_OK) {
+    fprintf(stderr, "RESULT: FAIL - engine_init\n");
+    exit(1);
+  }
+
+  /* Teach each pod switch its hosts: one broadcast, then unicasts back to its sender. */
+  static const uint8_t broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+  for (size_t pod = 0U; pod < pods; ++pod) {
+    Interface* first = ifaces[pod * BENCH_POD_HOSTS];
+    atomic_store(&frames_delivered, 0U);
+    (void)interface_send_pkt(first, make_frame(broadcast, first->mac));
+    bool learned = wait_accounted(topology, hosts - 1U, topology_drops(topology));
+    atomic_store(&frames_delivered, 0U);
+    for (size_t slot = 1U; slot < BENCH_POD_HOSTS; ++slot) {
+      Interface* iface = ifaces[pod * BENCH_POD_HOSTS + slot];
+      (void)interface_send_pkt(iface, make_frame(first->mac, iface->mac));
+    }
+    if (!learned ||
+        !wait_accounted(topology, BENCH_POD_HOSTS - 1U, topology_drops(topology))) {
+      fprintf(stderr, "RESULT: FAIL - MAC learning warm-up\n");
+      exit(1);
+    }
+  }
+
+  ScaleProducer producers[BENCH_SCALE_PRODUCERS];
+  pthread_t threads[BENCH_SCALE_PRODUCERS];
+  atomic_store(&frames_delivered, 0U);
+  double start = now_sec();
+  for (size_t index = 0U; index < BENCH_SCALE_PRODUCERS; ++index) {
+    producers[index] = (ScaleProducer){.ifaces = ifaces,
+                                       .dst_macs = dst_macs,
+                                       .hosts = hosts,
+                                       .first = index,
+                                       .frames = BENCH_SCALE_FRAMES / BENCH_SCALE_PRODUCERS};
+    pthread_create(&threads[index], NULL, scale_producer, &producers[index]);
+  }
+  for (size_t index = 0U; index < BENCH_SCALE_PRODUCERS; ++index) {
+    pthread_join(threads[index], NULL);
+  }
+  bool accounted = wait_accounted(topology, BENCH_SCALE_FRAMES, 0U);
+  double elapsed = now_sec() - start;
+
+  size_t threads_used = engine_thread_count();
+  engine_shutdown();
+  engine_set_worker_count(0U);
+  engine_set_backpressure(false);
+  topology_free(topology);
+  free(ifaces);
+  free(dst_macs);
+
+  fprintf(stderr, "  %4zu nodes, %4zu threads: %.0f frames/s\n", nodes, threads_used,
+          (double)BENCH_SCALE_FRAMES / elapsed);
+  if (!accounted) {
+    fprintf(stderr, "RESULT: FAIL - scale run lost frames\n");
+    exit(1);
+  }
+}
+
+#endif
+
+int main(void) {
+  printf("--- Async queue and engine benchmark ---\n");
+  fflush(stdout);
+
+  /* Per-frame switch LOG lines would dominate the measurement; discard them. */
+  if (freopen("/dev/null", "w", stdout) == NULL) {
+    return 1;
+  }
+  bench_queues();
+#ifdef MAGI_ASYNC
+  fprintf(stderr, "2 switches, %u hosts, %u frames/host of %u bytes:\n", BENCH_HOSTS,
+          BENCH_FRAMES_PER_HOST, BENCH_FRAME_LEN);
+  bench_topology(false);
+  bench_topology(true);
+
+  static const size_t sizes[] = {10U, 100U, 1000U};
+  fprintf(stderr, "generated pods, %u frames, pool sized to CPUs vs one worker per node:\n",
+          BENCH_SCALE_FRAMES);
+  for (size_t index = 0U; index < sizeof(sizes) / sizeof(sizes[0]); ++index) {
+    bench_scale(sizes[index], 0U);
+    bench_scale(sizes[index], sizes[index]);
+  }
+#else
+  fprintf(stderr, "topology benchmark needs MAGI_ASYNC (make async-bench); skipped\n");
+#endif
+  fprintf(stderr, "RESULT: PASS\n");
+  return 0;
+}
@@ -0,0 +1,182 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "layer3/ipv4.h"
+#include "layer3/router.h"
+#include "utils/magi_error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_QUERIES 1000000U
+#define BENCH_LINEAR_BUDGET 20000000U
+
+typedef struct RouteArray {
+  RoutingTableEntry* routes;
+  size_t count;
+  size_t cap;
+} RouteArray;
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t rng_next(void) {
+  rng_state ^= rng_state << 13U;
+  rng_state ^= rng_state >> 7U;
+  rng_state ^= rng_state << 17U;
+  return (uint32_t)(rng_state >> 16U);
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Prefix length mix loosely modelled on a BGP table: mostly /24, some /16-/23, a few long. */
+static int random_prefix_len(void) {
+  uint32_t roll = rng_next() % 100U;
+  if (roll < 55U) {
+    return 24;
+  }
+  if (roll < 85U) {
+    return 16 + (int)(rng_next() % 8U);
+  }
+  if (roll < 95U) {
+    return 8 + (int)(rng_next() % 8U);
+  }
+  return 25 + (int)(rng_next() % 8U);
+}
+
+static void collect_route(const RoutingTableEntry* route, void* ctx) {
+  RouteArray* array = ctx;
+  if (array->count == array->cap) {
+    array->cap = array->cap == 0U ? 1024U : array->cap * 2U;
+    array->routes = realloc(array->routes, array->cap * sizeof(*array->routes));
+    if (array->routes == NULL) {
+      printf("RESULT: FAIL - out of memory\n");
+      exit(1);
+    }
+  }
+  array->routes[array->count++] = *route;
+}
+
+/* Reference implementation: the pre-FIB linear LPM scan. */
+static const RoutingTableEntry* linear_lookup(const RouteArray* array, const uint8_t dst_ip[4]) {
+  const RoutingTableEntry* best = NULL;
+  int best_prefix = -1;
+  for (size_t index = 0U; index < array->count; ++index) {
+    const RoutingTableEntry* route = &array->routes[index];
+    if (route->prefix_len > best_prefix &&
+        ipv4_addr_in_network(dst_ip, route->network, route->mask)) {
+      best = route;
+      best_prefix = route->prefix_len;
+    }
+  }
+  return best;
+}
+
+static void run_size(size_t prefix_count) {
+  Router* router = router_new("BENCH");
+  if (router == NULL) {
+    printf("RESULT: FAIL - router_new\n");
+    exit(1);
+  }
+
+  double start = now_sec();
+  for (size_t index = 0U; index < prefix_count; ++index) {
+    uint32_t addr = rng_next();
+    char cidr[32];
+    snprintf(cidr, sizeof(cidr), "%u.%u.%u.%u/%d", (unsigned)(addr >> 24U),
+             (unsigned)((addr >> 16U) & 0xFFU), (unsigned)((addr >> 8U) & 0xFFU),
+             (unsigned)(addr & 0xFFU), random_prefix_len());
+    if (router_add_route(router, cidr, "10.0.0.1", (uint16_t)(1U + index % 4U)) != MAGI_OK) {
+      printf("RESULT: FAIL - router_add_route %s\n", cidr);
+      exit(1);
+    }
+  }
+  double build_sec = now_sec() - start;
+
+  RouteArray array = {0};
+  router_foreach_route(router, collect_route, &array);
+
+  uint8_t (*queries)[4] = malloc(BENCH_QUERIES * sizeof(*queries));
+  if (queries == NULL) {
+    printf("RESULT: FAIL - out of memory\n");
+    exit(1);
+  }
+  for (size_t index = 0U; index < BENCH_QUERIES; ++index) {
+    uint32_t addr = rng_next();
+    if ((index & 1U) == 0U && array.count > 0U) {
+      const RoutingTableEntry* route = &array.routes[rng_next() % array.count];
+      uint32_t host_bits = route->prefix_len >= 32 ? 0U : (0xFFFFFFFFU >> route->prefix_len);
+      addr = (((uint32_t)route->network[0] << 24U) | ((uint32_t)route->network[1] << 16U) |
+              ((uint32_t)route->network[2] << 8U) | route->network[3]) |
+             (addr & host_bits);
+    }
+    queries[index][0] = (uint8_t)(addr >> 24U);
+    queries[index][1] = (uint8_t)(addr >> 16U);
+    queries[index][2] = (uint8_t)(addr >> 8U);
+    queries[index][3] = (uint8_t)addr;
+  }
+
+  size_t hits = 0U;
+  start = now_sec();
+  for (size_t index = 0U; index < BENCH_QUERIES; ++index) {
+    hits += lpm_lookup(router, queries[index]) != NULL;
+  }
+  double fib_sec = now_sec() - start;
+
+  size_t linear_queries = BENCH_LINEAR_BUDGET / (array.count > 0U ? array.count : 1U);
+  if (linear_queries < 1000U) {
+    linear_queries = 1000U;
+  }
+  if (linear_queries > BENCH_QUERIES) {
+    linear_queries = BENCH_QUERIES;
+  }
+
+  size_t linear_hits = 0U;
+  start = now_sec();
+  for (size_t index = 0U; index < linear_queries; ++index) {
+    linear_hits += linear_lookup(&array, queries[index]) != NULL;
+  }
+  double linear_sec = now_sec() - start;
+
+  for (size_t index = 0U; index < linear_queries; ++index) {
+    const RoutingTableEntry* expected = linear_lookup(&array, queries[index]);
+    const RoutingTableEntry* actual = lpm_lookup(router, queries[index]);
+    bool same = (expected == NULL && actual == NULL) ||
+                (expected != NULL && actual != NULL &&
+                 expected->prefix_len == actual->prefix_len &&
+                 ipv4_addr_equal(expected->network, actual->network) &&
+                 expected->out_port == actual->out_port);
+    if (!same) {
+      printf("RESULT: FAIL - FIB disagrees with linear scan at query %zu\n", index);
+      exit(1);
+    }
+  }
+
+  double fib_ns = fib_sec * 1e9 / (double)BENCH_QUERIES;
+  double linear_ns = linear_sec * 1e9 / (double)linear_queries;
+  printf("%8zu %8zu %10.1f %10.1f %10.2f %12.1f %10.0fx\n", prefix_count, array.count,
+         build_sec * 1e3, fib_ns, 1e3 / fib_ns, linear_ns, linear_ns / fib_ns);
+  (void)hits;
+  (void)linear_hits;
+
+  free(queries);
+  free(array.routes);
+  router_free(router);
+}
+
+int main(void) {
+  printf("--- LPM benchmark: DIR-16-8-8 FIB vs linear scan ---\n");
+  printf("%8s %8s %10s %10s %10s %12s %11s\n", "added", "unique", "build_ms", "fib_ns",
+         "fib_Mlps", "linear_ns", "speedup");
+  run_size(1000U);
+  run_size(10000U);
+  run_size(100000U);
+  printf("RESULT: PASS - FIB lookups match the linear scan.\n");
+  return 0;
+}
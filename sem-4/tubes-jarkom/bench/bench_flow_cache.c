@@ -0,0 +1,371 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "core/interface.h"
+#include "core/link.h"
+#include "core/node.h"
+#include "core/sim.h"
+#include "core/stats.h"
+#include "layer2/neighbor.h"
+#include "layer3/ipv4.h"
+#include "layer3/router.h"
+#include "utils/byteops.h"
+#include "utils/log.h"
+#include "utils/magi_error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAGI_ASYNC
+int main(void) {
+  printf("--- Flow cache benchmark ---\n");
+  fprintf(stderr, "flow cache: skipped (async links deliver on worker threads)\n");
+  fprintf(stderr, "RESULT: PASS\n");
+  return 0;
+}
+#else
+
+#define BENCH_EGRESS 4U
+#define BENCH_ROUTES 20000U
+#define BENCH_ELEPHANTS 64U
+#define BENCH_MICE 40000U
+#define BENCH_PACKETS 1000000U
+#define BENCH_PAYLOAD 64U
+
+typedef struct Sink {
+  size_t frames;
+  uint8_t last_dst[6];
+  uint16_t last_ethertype;
+} Sink;
+
+typedef struct Frame {
+  uint8_t* data;
+  size_t len;
+} Frame;
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t rng_next(void) {
+  rng_state ^= rng_state << 13U;
+  rng_state ^= rng_state >> 7U;
+  rng_state ^= rng_state << 17U;
+  return (uint32_t)(rng_state >> 16U);
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void fail(const char* what) {
+  fprintf(stderr, "RESULT: FAIL - %s\n", what);
+  exit(1);
+}
+
+static void sink_receive(Node* node, Interface* iface, const uint8_t* data, size_t len) {
+  (void)iface;
+  Sink* sink = node->data;
+  sink->frames++;
+  if (len >= 14U) {
+    memcpy(sink->last_dst, data, 6U);
+    sink->last_ethertype = READ_U16(data, 12U);
+  }
+}
+
+static size_t build_arp_reply(uint8_t* out, const uint8_t dst_mac[6], const uint8_t src_mac[6],
+                              const uint8_t sender_ip[4], const uint8_t target_ip[4]) {
+  memcpy(out, dst_mac, 6U);
+  memcpy(out + 6U, src_mac, 6U);
+  WRITE_U16(out, 12U, 0x0806U);
+  uint8_t* arp = out + 14U;
+  WRITE_U16(arp, 0U, 1U);
+  WRITE_U16(arp, 2U, 0x0800U);
+  arp[4] = 6U;
+  arp[5] = 4U;
+  WRITE_U16(arp, 6U, 2U);
+  memcpy(arp + 8U, src_mac, 6U);
+  memcpy(arp + 14U, sender_ip, 4U);
+  memcpy(arp + 18U, dst_mac, 6U);
+  memcpy(arp + 24U, target_ip, 4U);
+  return 14U + 28U;
+}
+
+/* A UDP or TCP-numbered packet; the router only reads the ports, so no real L4 header. */
+static Frame build_frame(const uint8_t dst_mac[6], const uint8_t src_ip[4],
+                         const uint8_t dst_ip[4], uint8_t protocol, uint16_t sport,
+                         uint16_t dport) {
+  uint8_t payload[BENCH_PAYLOAD] = {0};
+  WRITE_U16(payload, 0U, sport);
+  WRITE_U16(payload, 2U, dport);
+  IPv4Packet pkt = {0};
+  pkt.version_ihl = IPV4_VERSION_IHL;
+  pkt.ttl = 64U;
+  pkt.protocol = protocol;
+  memcpy(pkt.src_ip, src_ip, 4U);
+  memcpy(pkt.dst_ip, dst_ip, 4U);
+  pkt.payload = payload;
+  pkt.payload_len = sizeof(payload);
+  uint8_t* ip_bytes = NULL;
+  size_t ip_len = 0U;
+  if (ipv4_packet_to_bytes(&pkt, &ip_bytes, &ip_len) != MAGI_OK) {
+    fail("ipv4_packet_to_bytes");
+  }
+
+  Frame frame = {.data = malloc(14U + ip_len), .len = 14U + ip_len};
+  if (frame.data == NULL) {
+    fail("alloc");
+  }
+  memcpy(frame.data, dst_mac, 6U);
+  memset(frame.data + 6U, 0x02, 6U);
+  WRITE_U16(frame.data, 12U, 0x0800U);
+  memcpy(frame.data + 14U, ip_bytes, ip_len);
+  free(ip_bytes);
+  return frame;
+}
+
+/* Destinations fall inside the 20.0.0.0/8 routes; the route table decides the egress. */
+static void random_destination(uint8_t out[4]) {
+  uint32_t addr = (20U << 24U) | (rng_next() & 0x00FFFFFFU);
+  WRITE_U32(out, 0U, addr);
+}
+
+static Router* router;
+static Interface* ingress;
+static Interface* egress[BENCH_EGRESS];
+static Node* sink_nodes[BENCH_EGRESS];
+static Sink sinks[BENCH_EGRESS];
+static Link* links[BENCH_EGRESS];
+
+static void next_hop_ip(uint32_t port_index, uint8_t out[4]) {
+  memcpy(out, (uint8_t[4]){10U, 0U, (uint8_t)(2U + port_index), 2U}, 4U);
+}
+
+static void announce_next_hop(uint32_t port_index, const uint8_t mac[6]) {
+  uint8_t nh[4];
+  uint8_t gw[4];
+  next_hop_ip(port_index, nh);
+  next_hop_ip(port_index, gw);
+  gw[3] = 1U;
+  uint8_t arp[64];
+  size_t len = build_arp_reply(arp, egress[port_index]->mac, mac, nh, gw);
+  router_handle_receive(router_as_node(router), egress[port_index], arp, len);
+}
+
+static void build_router(void) {
+  router = router_new("R1");
+  Node* rnode = router_as_node(router);
+  ingress = node_add_interface(rnode, 1U);
+  if (ingress == NULL || interface_set_ip(ingress, "10.0.1.1/24") != MAGI_OK) {
+    fail("ingress setup");
+  }
+
+  for (uint32_t index = 0U; index < BENCH_EGRESS; ++index) {
+    char cidr[24];
+    snprintf(cidr, sizeof(cidr), "10.0.%u.1/24", (unsigned)(2U + index));
+    egress[index] = node_add_interface(rnode, (uint16_t)(2U + index));
+    sink_nodes[index] = node_new("SINK");
+    if (egress[index] == NULL || sink_nodes[index] == NULL ||
+        interface_set_ip(egress[index], cidr) != MAGI_OK) {
+      fail("egress setup");
+    }
+    sink_nodes[index]->handle_receive = sink_receive;
+    sink_nodes[index]->data = &sinks[index];
+    Interface* sink_iface = node_add_interface(sink_nodes[index], 1U);
+    links[index] = link_new(egress[index], sink_iface, 0U, 1500U);
+    if (links[index] == NULL) {
+      fail("link_new");
+    }
+    announce_next_hop(index, sink_iface->mac);
+  }
+
+  /* A BGP-ish mix of /12 to /24 prefixes so LPM has real work to do. */
+  for (uint32_t index = 0U; index < BENCH_ROUTES; ++index) {
+    uint8_t network[4];
+    uint8_t nh[4];
+    char cidr[24];
+    char nh_text[16];
+    random_destination(network);
+    uint32_t port_index = rng_next() % BENCH_EGRESS;
+    next_hop_ip(port_index, nh);
+    ipv4_format_cidr(network, (int)(12U + rng_next() % 13U), cidr, sizeof(cidr));
+    ipv4_address_to_string(nh, nh_text);
+    if (router_add_route(router, cidr, nh_text, (uint16_t)(2U + port_index)) != MAGI_OK) {
+      fail("router_add_route");
+    }
+  }
+  if (router_add_route(router, "0.0.0.0/0", "10.0.2.2", 2U) != MAGI_OK) {
+    fail("default route");
+  }
+}
+
+static double run_traffic(const Frame* frames, const uint32_t* schedule, size_t out_counts[]) {
+  for (uint32_t index = 0U; index < BENCH_EGRESS; ++index) {
+    sinks[index].frames = 0U;
+  }
+
+  double start = now_sec();
+  for (uint32_t index = 0U; index < BENCH_PACKETS; ++index) {
+    const Frame* frame = &frames[schedule[index]];
+    router_handle_receive(router_as_node(router), ingress, frame->data, frame->len);
+  }
+  double elapsed = now_sec() - start;
+
+  size_t total = 0U;
+  for (uint32_t index = 0U; index < BENCH_EGRESS; ++index) {
+    out_counts[index] = sinks[index].frames;
+    total += sinks[index].frames;
+  }
+  if (total != BENCH_PACKETS) {
+    fail("packets lost in forwarding");
+  }
+  return elapsed;
+}
+
+static uint64_t node_counter(MagiNodeCounter counter) {
+  return magi_counter_read(&router_as_node(router)->counters, counter);
+}
+
+/* Send one packet of a flow and return the egress it left on, or -1. */
+static int send_one(const Frame* frame) {
+  size_t before[BENCH_EGRESS];
+  for (uint32_t index = 0U; index < BENCH_EGRESS; ++index) {
+    before[index] = sinks[index].frames;
+  }
+  router_handle_receive(router_as_node(router), ingress, frame->data, frame->len);
+  for (uint32_t index = 0U; index < BENCH_EGRESS; ++index) {
+    if (sinks[index].frames != before[index]) {
+      return (int)index;
+    }
+  }
+  return -1;
+}
+
+/* Route, ARP and aging changes must reach flows that are already cached. */
+static void check_invalidation(const Frame* flow, const uint8_t dst_ip[4]) {
+  int home = send_one(flow);
+  uint64_t hits = node_counter(MAGI_NODE_FLOW_HITS);
+  if (home < 0 || send_one(flow) != home || node_counter(MAGI_NODE_FLOW_HITS) != hits + 1U) {
+    fail("cached flow not forwarded from the cache");
+  }
+
+  uint32_t other = ((uint32_t)home + 1U) % BENCH_EGRESS;
+  char cidr[24];
+  char nh_text[16];
+  uint8_t nh[4];
+  next_hop_ip(other, nh);
+  ipv4_format_cidr(dst_ip, 32, cidr, sizeof(cidr));
+  ipv4_address_to_string(nh, nh_text);
+  if (router_add_route(router, cidr, nh_text, (uint16_t)(2U + other)) != MAGI_OK ||
+      send_one(flow) != (int)other) {
+    fail("route add did not redirect a cached flow");
+  }
+  if (router_remove_route(router, cidr) != MAGI_OK || send_one(flow) != home) {
+    fail("route removal did not restore a cached flow");
+  }
+
+  static const uint8_t moved_mac[6] = {0x02U, 0xAAU, 0xBBU, 0xCCU, 0xDDU, 0xEEU};
+  announce_next_hop((uint32_t)home, moved_mac);
+  if (send_one(flow) != home || memcmp(sinks[home].last_dst, moved_mac, 6U) != 0) {
+    fail("new next-hop MAC not used by a cached flow");
+  }
+
+  /* Nothing confirms the next hop for longer than its lifetime: the flow must re-ARP. */
+  hits = node_counter(MAGI_NODE_FLOW_HITS);
+  sim_run_until(sim_now_ns() + ((uint64_t)NEIGHBOR_REACHABLE_MS + NEIGHBOR_STALE_MS) *
+                                   SIM_NS_PER_MS);
+  if (send_one(flow) != home || sinks[home].last_ethertype != 0x0806U ||
+      node_counter(MAGI_NODE_FLOW_HITS) != hits) {
+    fail("cached flow outlived its neighbor entry");
+  }
+}
+
+int main(void) {
+  printf("--- Flow cache benchmark ---\n");
+  /* Per-packet LOG lines go to stdout; keep them out of the way and out of the timing. */
+  if (freopen("/dev/null", "w", stdout) == NULL) {
+    return 1;
+  }
+  magi_log_set_level(MAGI_LOG_L3, MAGI_LOG_WARN);
+  build_router();
+
+  /* Long flows carry 90% of the packets; the rest are short flows seen once or twice. */
+  Frame* frames = calloc(BENCH_ELEPHANTS + BENCH_MICE, sizeof(*frames));
+  uint8_t(*destinations)[4] = calloc(BENCH_ELEPHANTS + BENCH_MICE, sizeof(*destinations));
+  uint32_t* schedule = malloc(BENCH_PACKETS * sizeof(*schedule));
+  if (frames == NULL || destinations == NULL || schedule == NULL) {
+    fail("alloc");
+  }
+  for (uint32_t index = 0U; index < BENCH_ELEPHANTS + BENCH_MICE; ++index) {
+    uint8_t src[4] = {10U, 0U, 1U, (uint8_t)(2U + rng_next() % 200U)};
+    random_destination(destinations[index]);
+    uint8_t protocol = rng_next() % 4U == 0U ? IPV4_PROTOCOL_UDP : IPV4_PROTOCOL_TCP;
+    frames[index] = build_frame(ingress->mac, src, destinations[index], protocol,
+                                (uint16_t)(1024U + rng_next() % 60000U),
+                                rng_next() % 2U == 0U ? 443U : 80U);
+  }
+  uint32_t mouse = 0U;
+  for (uint32_t index = 0U; index < BENCH_PACKETS; ++index) {
+    schedule[index] = rng_next() % 10U != 0U ? rng_next() % BENCH_ELEPHANTS
+                                              : BENCH_ELEPHANTS + mouse++ % BENCH_MICE;
+  }
+
+  size_t uncached_counts[BENCH_EGRESS];
+  size_t cached_counts[BENCH_EGRESS];
+  if (router_set_flow_cache(router, 0U) != MAGI_OK) {
+    fail("disable flow cache");
+  }
+  uint64_t lookups = node_counter(MAGI_NODE_FIB_LOOKUPS);
+  double uncached = run_traffic(frames, schedule, uncached_counts);
+  uint64_t uncached_lookups = node_counter(MAGI_NODE_FIB_LOOKUPS) - lookups;
+
+  if (router_set_flow_cache(router, ROUTER_FLOW_CACHE_SLOTS) != MAGI_OK) {
+    fail("enable flow cache");
+  }
+  uint64_t hits = node_counter(MAGI_NODE_FLOW_HITS);
+  uint64_t misses = node_counter(MAGI_NODE_FLOW_MISSES);
+  lookups = node_counter(MAGI_NODE_FIB_LOOKUPS);
+  double cached = run_traffic(frames, schedule, cached_counts);
+  hits = node_counter(MAGI_NODE_FLOW_HITS) - hits;
+  misses = node_counter(MAGI_NODE_FLOW_MISSES) - misses;
+  uint64_t cached_lookups = node_counter(MAGI_NODE_FIB_LOOKUPS) - lookups;
+
+  if (memcmp(uncached_counts, cached_counts, sizeof(cached_counts)) != 0) {
+    fail("cached and uncached runs chose different egress ports");
+  }
+  if (hits + misses != BENCH_PACKETS || cached_lookups != misses) {
+    fail("flow cache counters");
+  }
+
+  fprintf(stderr, "%u routes, %u packets, %u long flows + %u short flows:\n", BENCH_ROUTES,
+          BENCH_PACKETS, BENCH_ELEPHANTS, BENCH_MICE);
+  fprintf(stderr, "  no cache   %9.0f pkt/s (%5.0f ns/pkt), %llu FIB lookups\n",
+          BENCH_PACKETS / uncached, uncached * 1e9 / BENCH_PACKETS,
+          (unsigned long long)uncached_lookups);
+  fprintf(stderr,
+          "  flow cache %9.0f pkt/s (%5.0f ns/pkt), %llu FIB lookups, hit rate %.1f%% (%.2fx)\n",
+          BENCH_PACKETS / cached, cached * 1e9 / BENCH_PACKETS,
+          (unsigned long long)cached_lookups, 100.0 * (double)hits / BENCH_PACKETS,
+          uncached / cached);
+
+  check_invalidation(&frames[0], destinations[0]);
+
+  for (uint32_t index = 0U; index < BENCH_ELEPHANTS + BENCH_MICE; ++index) {
+    free(frames[index].data);
+  }
+  free(schedule);
+  free(destinations);
+  free(frames);
+  for (uint32_t index = 0U; index < BENCH_EGRESS; ++index) {
+    link_free(links[index]);
+    sink_nodes[index]->data = NULL;
+    node_free(sink_nodes[index]);
+  }
+  router_free(router);
+  fprintf(stderr, "RESULT: PASS\n");
+  return 0;
+}
+#endif
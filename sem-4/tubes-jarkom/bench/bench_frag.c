@@ -0,0 +1,345 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "cli/node_ops.h"
+#include "core/interface.h"
+#include "core/node.h"
+#include "core/pktbuf.h"
+#include "core/sim.h"
+#include "layer3/icmp.h"
+#include "layer3/ipv4.h"
+#include "layer3/ipv4_frag.h"
+#include "layer3/router.h"
+#include "topology/topology.h"
+#include "utils/byteops.h"
+#include "utils/magi_error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Largest datagram IPv4 allows: 65535 bytes on the wire. */
+#define BENCH_PAYLOAD (0xFFFFU - IPV4_HEADER_LEN)
+#define BENCH_MTU 1500U
+#define BENCH_MAX_FRAGMENTS 64U
+#define BENCH_DATAGRAMS 10000U
+
+typedef struct FragmentList {
+  PktBuf* items[BENCH_MAX_FRAGMENTS];
+  size_t count;
+} FragmentList;
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void fail(const char* what) {
+  fprintf(stderr, "RESULT: FAIL - %s\n", what);
+  exit(1);
+}
+
+static int collect_fragment(PktBuf* fragment, void* ctx) {
+  FragmentList* list = ctx;
+  if (list->count == BENCH_MAX_FRAGMENTS) {
+    pktbuf_release(fragment);
+    return MAGI_ERR_BADARGS;
+  }
+  list->items[list->count++] = fragment;
+  return MAGI_OK;
+}
+
+static void fill_pattern(uint8_t* data, size_t len) {
+  for (size_t index = 0U; index < len; ++index) {
+    data[index] = (uint8_t)(index * 31U + 7U);
+  }
+}
+
+/* One maximum-size UDP-sized datagram, split at BENCH_MTU. */
+static void build_fragments(FragmentList* list, uint8_t* payload) {
+  fill_pattern(payload, BENCH_PAYLOAD);
+  IPv4Packet header = {0};
+  header.identification = 0x4242U;
+  header.ttl = IPV4_DEFAULT_TTL;
+  header.protocol = IPV4_PROTOCOL_UDP;
+  memcpy(header.src_ip, (uint8_t[4]){10U, 0U, 0U, 1U}, 4U);
+  memcpy(header.dst_ip, (uint8_t[4]){10U, 0U, 0U, 2U}, 4U);
+  header.payload = payload;
+  header.payload_len = BENCH_PAYLOAD;
+
+  PktBuf* datagram = pktbuf_new(PKTBUF_HEADROOM, 0xFFFFU);
+  if (datagram == NULL || ipv4_pack(&header, pktbuf_put(datagram, 0xFFFFU), 0xFFFFU) != MAGI_OK ||
+      ipv4_fragment(datagram, BENCH_MTU, collect_fragment, list) != MAGI_OK) {
+    fail("fragmenting a 64 KB datagram");
+  }
+}
+
+/* Feed every fragment in the given order; return the completed datagram. */
+static uint8_t* reassemble(Ipv4Reasm* table, const FragmentList* list, const size_t* order,
+                           size_t* len_out) {
+  uint8_t* datagram = NULL;
+  for (size_t index = 0U; index < list->count; ++index) {
+    const PktBuf* fragment = list->items[order[index]];
+    IPv4Packet pkt = {0};
+    if (ipv4_unpack(&pkt, fragment->data, fragment->len) != MAGI_OK ||
+        ipv4_reasm_input(table, &pkt, &datagram, len_out) != MAGI_OK) {
+      fail("reassembly input");
+    }
+    if (datagram != NULL && index + 1U != list->count) {
+      fail("datagram completed early");
+    }
+  }
+  return datagram;
+}
+
+static void bench_order(const char* label, const FragmentList* list, const size_t* order,
+                        const uint8_t* payload) {
+  Ipv4Reasm* table = ipv4_reasm_new(0U, 0U, 0U);
+  size_t len = 0U;
+  uint8_t* datagram = reassemble(table, list, order, &len);
+  IPv4Packet whole = {0};
+  if (datagram == NULL || ipv4_unpack(&whole, datagram, len) != MAGI_OK ||
+      whole.payload_len != BENCH_PAYLOAD || ipv4_is_fragment(&whole) ||
+      memcmp(whole.payload, payload, BENCH_PAYLOAD) != 0) {
+    fail("reassembled datagram differs from the original");
+  }
+  free(datagram);
+
+  double start = now_sec();
+  for (size_t round = 0U; round < BENCH_DATAGRAMS; ++round) {
+    free(reassemble(table, list, order, &len));
+  }
+  double elapsed = now_sec() - start;
+
+  Ipv4ReasmStats stats;
+  ipv4_reasm_get_stats(table, &stats);
+  if (stats.reassembled != BENCH_DATAGRAMS + 1U || stats.entries != 0U || stats.bytes != 0U) {
+    fail("reassembly counters");
+  }
+  fprintf(stderr, "reassemble %-9s %zu x %u B fragments: %.0f datagrams/s, %.2f Gbit/s\n", label,
+          list->count, BENCH_MTU, (double)BENCH_DATAGRAMS / elapsed,
+          (double)BENCH_DATAGRAMS * 0xFFFFU * 8.0 / elapsed / 1e9);
+  ipv4_reasm_free(table);
+}
+
+static void bench_fragment(const uint8_t* payload) {
+  IPv4Packet header = {0};
+  header.ttl = IPV4_DEFAULT_TTL;
+  header.protocol = IPV4_PROTOCOL_UDP;
+  header.payload = payload;
+  header.payload_len = BENCH_PAYLOAD;
+
+  double start = now_sec();
+  for (size_t round = 0U; round < BENCH_DATAGRAMS; ++round) {
+    FragmentList list = {0};
+    PktBuf* datagram = pktbuf_new(PKTBUF_HEADROOM, 0xFFFFU);
+    if (datagram == NULL ||
+        ipv4_pack(&header, pktbuf_put(datagram, 0xFFFFU), 0xFFFFU) != MAGI_OK ||
+        ipv4_fragment(datagram, BENCH_MTU, collect_fragment, &list) != MAGI_OK) {
+      fail("fragment");
+    }
+    for (size_t index = 0U; index < list.count; ++index) {
+      pktbuf_release(list.items[index]);
+    }
+  }
+  double elapsed = now_sec() - start;
+  fprintf(stderr, "fragment   64 KB datagrams at mtu %u: %.0f datagrams/s\n", BENCH_MTU,
+          (double)BENCH_DATAGRAMS / elapsed);
+}
+
+/* Entry and byte limits evict the oldest datagram; the clock drops stale ones. */
+static void check_limits(const FragmentList* list) {
+  Ipv4Reasm* table = ipv4_reasm_new(8U, 0U, 0U);
+  for (uint16_t id = 0U; id < 20U; ++id) {
+    IPv4Packet pkt = {0};
+    uint8_t* datagram = NULL;
+    size_t len = 0U;
+    if (ipv4_unpack(&pkt, list->items[0]->data, list->items[0]->len) != MAGI_OK) {
+      fail("unpack");
+    }
+    pkt.identification = id;
+    if (ipv4_reasm_input(table, &pkt, &datagram, &len) != MAGI_OK || datagram != NULL) {
+      fail("partial datagram");
+    }
+  }
+
+  Ipv4ReasmStats stats;
+  ipv4_reasm_get_stats(table, &stats);
+  if (stats.entries != 8U || stats.evictions != 12U) {
+    fail("entry limit");
+  }
+
+#ifndef MAGI_ASYNC
+  (void)sim_run_until(sim_now_ns() + (uint64_t)IPV4_REASM_TIMEOUT_MS * SIM_NS_PER_MS);
+  ipv4_reasm_get_stats(table, &stats);
+  if (stats.entries != 0U || stats.timeouts != 8U || stats.bytes != 0U) {
+    fail("timeout did not drop incomplete datagrams");
+  }
+#endif
+  ipv4_reasm_free(table);
+
+  /* 256 KB budget: each 64 KB datagram in progress holds its full buffer. */
+  table = ipv4_reasm_new(0U, 256U * 1024U, 0U);
+  size_t last = list->count - 1U;
+  for (uint16_t id = 0U; id < 10U; ++id) {
+    IPv4Packet pkt = {0};
+    uint8_t* datagram = NULL;
+    size_t len = 0U;
+    (void)ipv4_unpack(&pkt, list->items[last]->data, list->items[last]->len);
+    pkt.identification = id;
+    if (ipv4_reasm_input(table, &pkt, &datagram, &len) != MAGI_OK) {
+      fail("tail fragment");
+    }
+  }
+  ipv4_reasm_get_stats(table, &stats);
+  fprintf(stderr, "limits: 20 partial datagrams into 8 slots -> 12 evicted; "
+                  "64 KB tails into 256 KB -> %zu held, %llu evicted\n",
+          stats.entries, (unsigned long long)stats.evictions);
+  if (stats.bytes > 256U * 1024U || stats.entries + stats.evictions != 10U) {
+    fail("byte limit");
+  }
+  ipv4_reasm_free(table);
+}
+
+#ifndef MAGI_ASYNC
+static size_t sink_datagrams = 0U;
+static size_t sink_bytes = 0U;
+static uint16_t reported_mtu = 0U;
+static node_l3_receive_fn h1_receive = NULL;
+
+static void sink_l4(Node* node, const uint8_t src_ip[4], const uint8_t dst_ip[4], uint8_t protocol,
+                    const uint8_t* payload, size_t len) {
+  (void)node;
+  (void)src_ip;
+  (void)dst_ip;
+  uint8_t expected[BENCH_PAYLOAD];
+  fill_pattern(expected, len);
+  if (protocol == IPV4_PROTOCOL_UDP && memcmp(payload, expected, len) == 0) {
+    sink_datagrams++;
+    sink_bytes += len;
+  }
+}
+
+/* Watch H1's IPv4 input for Fragmentation Needed, then hand the packet on. */
+static void spy_l3(Node* node, Interface* iface, const uint8_t* data, size_t len) {
+  IPv4Packet pkt = {0};
+  ICMPMessage msg = {0};
+  if (ipv4_unpack(&pkt, data, len) == MAGI_OK && pkt.protocol == IPV4_PROTOCOL_ICMP &&
+      icmp_unpack(&msg, pkt.payload, pkt.payload_len) == MAGI_OK &&
+      msg.type == ICMP_TYPE_DEST_UNREACHABLE && msg.code == ICMP_CODE_FRAG_NEEDED) {
+    reported_mtu = msg.sequence;
+  }
+  h1_receive(node, iface, data, len);
+}
+
+/* H1 -(1500)- R1 -(576)- H2: R1 re-fragments, H2 reassembles, DF is refused. */
+static void check_path(void) {
+  Topology* topology = topology_new();
+  topology_set_node_ops(topology, cli_topology_node_ops());
+  bool ok = topology_add_node(topology, TOPOLOGY_NODE_HOST, "H1") != NULL &&
+            topology_add_node(topology, TOPOLOGY_NODE_HOST, "H2") != NULL &&
+            topology_add_node(topology, TOPOLOGY_NODE_ROUTER, "R1") != NULL &&
+            topology_add_link(topology, "H1", 1U, "R1", 1U, 1U, 1500U) != NULL &&
+            topology_add_link(topology, "R1", 2U, "H2", 1U, 1U, 576U) != NULL;
+  Node* r1 = topology_get_node(topology, "R1");
+  ok = ok && interface_set_ip(node_get_interface(r1, 1U), "10.0.1.1/24") == MAGI_OK &&
+       interface_set_ip(node_get_interface(r1, 2U), "10.0.2.1/24") == MAGI_OK &&
+       topology_configure_host(topology, "H1", "10.0.1.10/24", "10.0.1.1") == MAGI_OK &&
+       topology_configure_host(topology, "H2", "10.0.2.10/24", "10.0.2.1") == MAGI_OK;
+  if (!ok) {
+    fail("topology setup");
+  }
+
+  Node* h1 = topology_get_node(topology, "H1");
+  Node* h2 = topology_get_node(topology, "H2");
+  h2->handle_l4_packet = sink_l4;
+  h1_receive = h1->handle_l3_packet;
+  h1->handle_l3_packet = spy_l3;
+
+  const uint8_t src[4] = {10U, 0U, 1U, 10U};
+  const uint8_t dst[4] = {10U, 0U, 2U, 10U};
+  uint8_t* payload = malloc(60000U);
+  if (payload == NULL) {
+    fail("malloc");
+  }
+  fill_pattern(payload, 60000U);
+  for (size_t round = 0U; round < 10U; ++round) {
+    if (ipv4_send_packet(h1, src, dst, IPV4_PROTOCOL_UDP, IPV4_DEFAULT_TTL, payload, 60000U) !=
+        MAGI_OK) {
+      fail("ipv4_send_packet");
+    }
+    (void)sim_run_for(1000U * SIM_NS_PER_MS);
+  }
+  free(payload);
+  fprintf(stderr, "path 1500 -> 576: %zu of 10 60000-byte datagrams reassembled at H2\n",
+          sink_datagrams);
+  if (sink_datagrams != 10U || sink_bytes != 600000U) {
+    fail("end-to-end reassembly");
+  }
+
+  if (ipv4_host_ping_sized(h1, "10.0.2.10", 1400U, true) != MAGI_OK) {
+    fail("DF ping");
+  }
+  (void)sim_run_for(1000U * SIM_NS_PER_MS);
+  fprintf(stderr, "DF ping of 1400 bytes: Fragmentation Needed, next-hop MTU %u\n",
+          (unsigned)reported_mtu);
+  if (reported_mtu != 576U) {
+    fail("no Fragmentation Needed for DF packet");
+  }
+  if (ipv4_host_ping_sized(h1, "10.0.2.10", 1600U, true) != MAGI_ERR_MSGSIZE) {
+    fail("DF packet larger than the host's own link was sent");
+  }
+
+  topology_free(topology);
+}
+#endif
+
+int main(void) {
+  printf("--- IPv4 fragmentation benchmark ---\n");
+  if (freopen("/dev/null", "w", stdout) == NULL) {
+    return 1;
+  }
+
+  uint8_t* payload = malloc(BENCH_PAYLOAD);
+  if (payload == NULL) {
+    return 1;
+  }
+  FragmentList list = {0};
+  build_fragments(&list, payload);
+
+  size_t in_order[BENCH_MAX_FRAGMENTS];
+  size_t reversed[BENCH_MAX_FRAGMENTS];
+  size_t shuffled[BENCH_MAX_FRAGMENTS];
+  for (size_t index = 0U; index < list.count; ++index) {
+    in_order[index] = index;
+    reversed[index] = list.count - 1U - index;
+    shuffled[index] = index;
+  }
+  uint32_t seed = 12345U;
+  for (size_t index = list.count - 1U; index > 0U; --index) {
+    seed = seed * 1103515245U + 12345U;
+    size_t other = (seed >> 8U) % (index + 1U);
+    size_t tmp = shuffled[index];
+    shuffled[index] = shuffled[other];
+    shuffled[other] = tmp;
+  }
+
+  bench_fragment(payload);
+  bench_order("in-order", &list, in_order, payload);
+  bench_order("reversed", &list, reversed, payload);
+  bench_order("shuffled", &list, shuffled, payload);
+  check_limits(&list);
+#ifndef MAGI_ASYNC
+  check_path();
+#endif
+
+  for (size_t index = 0U; index < list.count; ++index) {
+    pktbuf_release(list.items[index]);
+  }
+  free(payload);
+  fprintf(stderr, "RESULT: PASS\n");
+  return 0;
+}
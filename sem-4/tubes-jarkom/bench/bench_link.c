@@ -0,0 +1,198 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "core/interface.h"
+#include "core/link.h"
+#include "core/node.h"
+#include "core/pktbuf.h"
+#include "core/sim.h"
+#include "utils/magi_error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAGI_ASYNC
+int main(void) {
+  printf("--- Link shaping benchmark ---\n");
+  fprintf(stderr, "link shaping: skipped (queueing is modelled on the virtual clock)\n");
+  printf("RESULT: PASS\n");
+  return 0;
+}
+#else
+#define BENCH_FRAME_LEN 1250U
+#define BENCH_RATE_BPS 10000000U
+#define BENCH_DELAY_MS 2U
+/* 1250 bytes at 10 Mbit/s. */
+#define BENCH_FRAME_NS 1000000U
+#define BENCH_OVERLOAD_FRAMES 20000U
+#define BENCH_WALL_FRAMES 1000000U
+
+typedef struct SinkStats {
+  size_t frames;
+  uint64_t delay_sum_ns;
+  uint64_t last_arrival_ns;
+} SinkStats;
+
+static SinkStats sink = {0};
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void fail(const char* what) {
+  fprintf(stderr, "RESULT: FAIL - %s\n", what);
+  exit(1);
+}
+
+/* Frames carry their send time; the sink turns it into one-way delay. */
+static void sink_receive(Node* node, Interface* iface, const uint8_t* data, size_t len) {
+  (void)node;
+  (void)iface;
+  uint64_t sent_ns = 0U;
+  if (len >= sizeof(sent_ns)) {
+    memcpy(&sent_ns, data, sizeof(sent_ns));
+  }
+  sink.frames++;
+  sink.delay_sum_ns += sim_now_ns() - sent_ns;
+  sink.last_arrival_ns = sim_now_ns();
+}
+
+static void send_stamped(Interface* iface) {
+  PktBuf* pkt = pktbuf_new(0U, BENCH_FRAME_LEN);
+  uint8_t* frame = pktbuf_put(pkt, BENCH_FRAME_LEN);
+  if (frame == NULL) {
+    fail("pktbuf_new");
+  }
+  uint64_t now = sim_now_ns();
+  memset(frame, 0, BENCH_FRAME_LEN);
+  memcpy(frame, &now, sizeof(now));
+  (void)interface_send_pkt(iface, pkt);
+}
+
+typedef struct Pair {
+  Node* sender;
+  Node* receiver;
+  Link* link;
+} Pair;
+
+static Pair make_pair(uint64_t rate_bps, LinkQueueKind kind, uint32_t limit) {
+  Pair pair = {.sender = node_new("TX"), .receiver = node_new("RX")};
+  pair.receiver->handle_receive = sink_receive;
+  pair.link = link_new(node_add_interface(pair.sender, 1U), node_add_interface(pair.receiver, 1U),
+                       BENCH_DELAY_MS, 1500U);
+  LinkQueueConfig queue = {.kind = kind, .limit = limit};
+  if (pair.link == NULL || link_set_bandwidth(pair.link, rate_bps) != MAGI_OK ||
+      link_set_queue(pair.link, &queue) != MAGI_OK) {
+    fail("link setup");
+  }
+  sink = (SinkStats){0};
+  return pair;
+}
+
+static void free_pair(Pair* pair) {
+  link_free(pair->link);
+  node_free(pair->sender);
+  node_free(pair->receiver);
+}
+
+/* Send count frames, one every interval_ns, then let the link drain. */
+static void offer(Pair* pair, size_t count, uint64_t interval_ns) {
+  Interface* iface = node_get_interface(pair->sender, 1U);
+  uint64_t start = sim_now_ns();
+  for (size_t index = 0U; index < count; ++index) {
+    (void)sim_run_until(start + index * interval_ns);
+    send_stamped(iface);
+  }
+  (void)sim_run_until(sim_now_ns() + 1000U * SIM_NS_PER_MS);
+}
+
+static LinkStats stats_of(const Pair* pair) {
+  LinkStats stats = {0};
+  (void)link_get_stats(pair->link, node_get_interface(pair->sender, 1U), &stats);
+  return stats;
+}
+
+/* 1000 back-to-back frames into a 100-frame FIFO: exact drop count and finish time. */
+static void bench_burst(void) {
+  Pair pair = make_pair(BENCH_RATE_BPS, LINK_QUEUE_FIFO, 100U);
+  uint64_t start = sim_now_ns();
+  offer(&pair, 1000U, 0U);
+  LinkStats stats = stats_of(&pair);
+  uint64_t finish_ms = (sink.last_arrival_ns - start) / SIM_NS_PER_MS;
+  fprintf(stderr,
+          "burst  fifo/100: sent 1000, delivered %zu, drops %llu, hwm %u, last at %llu ms\n",
+          sink.frames, (unsigned long long)stats.drops, (unsigned)stats.queue_hwm,
+          (unsigned long long)finish_ms);
+  if (sink.frames != 100U || stats.drops != 900U || stats.queue_hwm != 100U ||
+      finish_ms != 100U + BENCH_DELAY_MS) {
+    fail("burst accounting");
+  }
+  free_pair(&pair);
+}
+
+/* 80% load with even spacing never queues: delay is serialization plus propagation. */
+static void bench_paced(void) {
+  Pair pair = make_pair(BENCH_RATE_BPS, LINK_QUEUE_FIFO, 100U);
+  offer(&pair, 1000U, BENCH_FRAME_NS * 5U / 4U);
+  LinkStats stats = stats_of(&pair);
+  uint64_t mean_ns = sink.delay_sum_ns / sink.frames;
+  fprintf(stderr, "paced  80%% load: delivered %zu, drops %llu, hwm %u, mean delay %.3f ms\n",
+          sink.frames, (unsigned long long)stats.drops, (unsigned)stats.queue_hwm,
+          (double)mean_ns / 1e6);
+  if (sink.frames != 1000U || stats.drops != 0U || stats.queue_hwm != 1U ||
+      mean_ns != BENCH_FRAME_NS + BENCH_DELAY_MS * SIM_NS_PER_MS) {
+    fail("paced accounting");
+  }
+  free_pair(&pair);
+}
+
+/* Sustained 125% load: FIFO sits full, RED keeps the standing queue short. */
+static void bench_overload(LinkQueueKind kind) {
+  Pair pair = make_pair(BENCH_RATE_BPS, kind, 100U);
+  offer(&pair, BENCH_OVERLOAD_FRAMES, BENCH_FRAME_NS * 4U / 5U);
+  LinkStats stats = stats_of(&pair);
+  fprintf(stderr,
+          "over   %s/100 125%% load: delivered %zu, drops %llu, hwm %u, mean delay %.2f ms\n",
+          link_queue_kind_name(kind), sink.frames, (unsigned long long)stats.drops,
+          (unsigned)stats.queue_hwm, (double)sink.delay_sum_ns / (double)sink.frames / 1e6);
+  if (sink.frames + stats.drops != BENCH_OVERLOAD_FRAMES || stats.drops == 0U) {
+    fail("overload accounting");
+  }
+  free_pair(&pair);
+}
+
+/* Wall-clock cost of shaping: frames through a 1 Gbit/s link at half load. */
+static void bench_wall(void) {
+  Pair pair = make_pair(1000000000U, LINK_QUEUE_FIFO, 100U);
+  double start = now_sec();
+  offer(&pair, BENCH_WALL_FRAMES, 20000U);
+  double elapsed = now_sec() - start;
+  if (sink.frames != BENCH_WALL_FRAMES) {
+    fail("wall run lost frames");
+  }
+  fprintf(stderr, "shaped 1G link: %u frames in %.3f s -> %.0f ns/frame\n",
+          (unsigned)BENCH_WALL_FRAMES, elapsed, elapsed * 1e9 / (double)BENCH_WALL_FRAMES);
+  free_pair(&pair);
+}
+
+int main(void) {
+  printf("--- Link shaping benchmark ---\n");
+  if (freopen("/dev/null", "w", stdout) == NULL) {
+    return 1;
+  }
+
+  bench_burst();
+  bench_paced();
+  bench_overload(LINK_QUEUE_FIFO);
+  bench_overload(LINK_QUEUE_RED);
+  bench_wall();
+
+  fprintf(stderr, "RESULT: PASS\n");
+  return 0;
+}
+#endif
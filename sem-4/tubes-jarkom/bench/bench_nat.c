@@ -0,0 +1,379 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "core/sim.h"
+#include "layer3/ipv4.h"
+#include "middleboxes/nat.h"
+#include "utils/byteops.h"
+#include "utils/log.h"
+#include "utils/magi_error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_FLOWS 100000U
+#define BENCH_PACKETS 2000000U
+#define BENCH_SEGMENT 36U
+#define BENCH_DATA_OFF 20U
+
+#define TCP_SYN 0x02U
+#define TCP_RST 0x04U
+#define TCP_ACK 0x10U
+#define TCP_FIN_ACK 0x11U
+#define TCP_SYN_ACK 0x12U
+
+static const uint8_t public_ip[4] = {203U, 0U, 113U, 1U};
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t rng_next(void) {
+  rng_state ^= rng_state << 13U;
+  rng_state ^= rng_state >> 7U;
+  rng_state ^= rng_state << 17U;
+  return (uint32_t)(rng_state >> 16U);
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void fail(const char* what) {
+  fprintf(stderr, "RESULT: FAIL - %s\n", what);
+  exit(1);
+}
+
+/* Let idle timers run out: virtual time in sync builds, a real sleep in async ones. */
+static void advance_ms(uint64_t ms) {
+#ifdef MAGI_ASYNC
+  struct timespec ts = {.tv_sec = 0, .tv_nsec = (long)(ms * SIM_NS_PER_MS)};
+  nanosleep(&ts, NULL);
+#else
+  sim_run_until(sim_now_ns() + ms * SIM_NS_PER_MS);
+#endif
+}
+
+/* A packet and the transport segment its payload points into. */
+typedef struct BenchPacket {
+  IPv4Packet ip;
+  uint8_t segment[BENCH_SEGMENT];
+} BenchPacket;
+
+/* Two flows per private endpoint, one to each of two servers. Every fifth endpoint uses
+ * UDP, every tenth ICMP echo, the rest TCP. */
+static uint8_t flow_protocol(uint32_t flow) {
+  uint32_t endpoint = flow / 2U;
+  if (endpoint % 10U == 9U) {
+    return NAT_PROTO_ICMP;
+  }
+  return endpoint % 5U == 4U ? NAT_PROTO_UDP : NAT_PROTO_TCP;
+}
+
+/* Stamp the full transport checksum the sender would have written. */
+static void fill_checksum(BenchPacket* p) {
+  uint8_t* seg = p->segment;
+  if (p->ip.protocol == NAT_PROTO_ICMP) {
+    WRITE_U16(seg, 2U, 0U);
+    uint16_t cksum = ipv4_checksum(seg, BENCH_SEGMENT);
+    WRITE_U16(seg, 2U, cksum);
+    return;
+  }
+
+  size_t off = p->ip.protocol == NAT_PROTO_TCP ? 16U : 6U;
+  uint8_t pseudo[12];
+  memcpy(pseudo, p->ip.src_ip, 4U);
+  memcpy(pseudo + 4U, p->ip.dst_ip, 4U);
+  pseudo[8] = 0U;
+  pseudo[9] = p->ip.protocol;
+  WRITE_U16(pseudo, 10U, BENCH_SEGMENT);
+  WRITE_U16(seg, off, 0U);
+  uint16_t cksum = transport_checksum(pseudo, sizeof(pseudo), seg, BENCH_SEGMENT);
+  WRITE_U16(seg, off, p->ip.protocol == NAT_PROTO_UDP && cksum == 0U ? 0xFFFFU : cksum);
+}
+
+/* Check the incrementally patched checksums against a full recompute. */
+static void verify_checksums(const BenchPacket* p) {
+  IPv4Packet header = p->ip;
+  uint8_t scratch[IPV4_HEADER_LEN];
+  if (ipv4_pack_header(&header, scratch, sizeof(scratch)) != MAGI_OK ||
+      header.checksum != p->ip.checksum) {
+    fail("IPv4 header checksum differs from a full recompute");
+  }
+
+  BenchPacket full = *p;
+  full.ip.payload = full.segment;
+  fill_checksum(&full);
+  if (memcmp(full.segment, p->segment, BENCH_SEGMENT) != 0) {
+    fail("transport checksum differs from a full recompute");
+  }
+}
+
+static void set_tcp_flags(BenchPacket* p, uint8_t flags) {
+  p->segment[13] = flags;
+  fill_checksum(p);
+}
+
+/* Outbound packet of a flow, as the private host sends it. */
+static void build_outbound(BenchPacket* p, uint32_t flow) {
+  uint32_t endpoint = flow / 2U;
+  uint32_t host = endpoint / 8U;
+  memset(p, 0, sizeof(*p));
+  p->ip.version_ihl = 0x45U;
+  p->ip.ttl = 64U;
+  p->ip.protocol = flow_protocol(flow);
+  p->ip.src_ip[0] = 10U;
+  p->ip.src_ip[1] = (uint8_t)(host >> 16U);
+  p->ip.src_ip[2] = (uint8_t)(host >> 8U);
+  p->ip.src_ip[3] = (uint8_t)host;
+  p->ip.dst_ip[0] = 198U;
+  p->ip.dst_ip[1] = 51U;
+  p->ip.dst_ip[2] = 100U;
+  p->ip.dst_ip[3] = (uint8_t)(1U + flow % 2U);
+  uint16_t sport = (uint16_t)(20000U + endpoint % 8U);
+  uint16_t dport = flow % 2U == 0U ? 443U : 53U;
+  if (p->ip.protocol == NAT_PROTO_ICMP) {
+    p->segment[0] = 8U; /* Echo request */
+    WRITE_U16(p->segment, 4U, sport);
+    WRITE_U16(p->segment, 6U, (uint16_t)(flow % 2U));
+  } else {
+    WRITE_U16(p->segment, 0U, sport);
+    WRITE_U16(p->segment, 2U, dport);
+  }
+  if (p->ip.protocol == NAT_PROTO_TCP) {
+    WRITE_U32(p->segment, 4U, flow * 7919U);
+    p->segment[12] = 0x50U;
+    p->segment[13] = TCP_SYN;
+    WRITE_U16(p->segment, 14U, 65535U);
+  } else if (p->ip.protocol == NAT_PROTO_UDP) {
+    WRITE_U16(p->segment, 4U, BENCH_SEGMENT);
+  }
+  for (uint32_t index = BENCH_DATA_OFF; index < BENCH_SEGMENT; ++index) {
+    p->segment[index] = (uint8_t)rng_next();
+  }
+  p->ip.payload = p->segment;
+  p->ip.payload_len = BENCH_SEGMENT;
+  fill_checksum(p);
+
+  uint8_t scratch[IPV4_HEADER_LEN];
+  ipv4_pack_header(&p->ip, scratch, sizeof(scratch));
+}
+
+/* The remote's answer to a translated outbound packet. */
+static void build_reply(BenchPacket* reply, const BenchPacket* out) {
+  *reply = *out;
+  reply->ip.payload = reply->segment;
+  memcpy(reply->ip.src_ip, out->ip.dst_ip, 4U);
+  memcpy(reply->ip.dst_ip, out->ip.src_ip, 4U);
+  if (reply->ip.protocol == NAT_PROTO_ICMP) {
+    reply->segment[0] = 0U; /* Echo reply */
+  } else {
+    WRITE_U16(reply->segment, 0U, READ_U16(out->segment, 2U));
+    WRITE_U16(reply->segment, 2U, READ_U16(out->segment, 0U));
+  }
+  if (reply->ip.protocol == NAT_PROTO_TCP) {
+    reply->segment[13] = TCP_SYN_ACK;
+  }
+  fill_checksum(reply);
+  uint8_t scratch[IPV4_HEADER_LEN];
+  ipv4_pack_header(&reply->ip, scratch, sizeof(scratch));
+}
+
+static void translate(NATTable* nat, BenchPacket* p, bool outbound, const char* what) {
+  int status = outbound ? nat_translate_out(nat, &p->ip) : nat_translate_in(nat, &p->ip);
+  if (status != MAGI_OK) {
+    fail(what);
+  }
+}
+
+int main(void) {
+  printf("--- NAT connection tracking benchmark ---\n");
+  /* Per-flow LOG lines go to stdout; keep them out of the timing. */
+  if (freopen("/dev/null", "w", stdout) == NULL) {
+    return 1;
+  }
+  magi_log_set_level(MAGI_LOG_L3, MAGI_LOG_WARN);
+
+  NATTable* nat = nat_table_new(public_ip);
+  BenchPacket* out = calloc(BENCH_FLOWS, sizeof(*out));
+  BenchPacket* in = calloc(BENCH_FLOWS, sizeof(*in));
+  if (nat == NULL || out == NULL || in == NULL) {
+    fail("alloc");
+  }
+  for (uint32_t flow = 0U; flow < BENCH_FLOWS; ++flow) {
+    build_outbound(&out[flow], flow);
+  }
+
+  /* Opening packets: every one creates a flow, every other one a mapping. */
+  BenchPacket work;
+  double start = now_sec();
+  for (uint32_t flow = 0U; flow < BENCH_FLOWS; ++flow) {
+    work = out[flow];
+    work.ip.payload = work.segment;
+    translate(nat, &work, true, "new flow refused");
+    if (flow == 0U) {
+      start = now_sec(); /* Leave the first allocations out of the average. */
+    }
+    build_reply(&in[flow], &work);
+  }
+  double create_ns = (now_sec() - start) * 1e9 / (BENCH_FLOWS - 1U);
+
+  NATStats stats;
+  nat_get_stats(nat, &stats);
+  if (stats.flows != BENCH_FLOWS || stats.mappings != BENCH_FLOWS / 2U ||
+      stats.created != BENCH_FLOWS) {
+    fail("flow and mapping counts after setup");
+  }
+
+  /* Translated packets must carry exactly the checksums a full recompute gives. */
+  for (uint32_t flow = 0U; flow < BENCH_FLOWS; ++flow) {
+    work = out[flow];
+    work.ip.payload = work.segment;
+    translate(nat, &work, true, "outbound on a known flow");
+    verify_checksums(&work);
+    if (memcmp(work.ip.src_ip, public_ip, 4U) != 0 ||
+        READ_U16(work.segment, work.ip.protocol == NAT_PROTO_ICMP ? 4U : 0U) !=
+            READ_U16(in[flow].segment, work.ip.protocol == NAT_PROTO_ICMP ? 4U : 2U)) {
+      fail("flow moved to another public port");
+    }
+
+    work = in[flow];
+    work.ip.payload = work.segment;
+    translate(nat, &work, false, "reply to a known flow");
+    verify_checksums(&work);
+    if (memcmp(work.ip.dst_ip, out[flow].ip.src_ip, 4U) != 0 ||
+        READ_U16(work.segment, work.ip.protocol == NAT_PROTO_ICMP ? 4U : 2U) !=
+            READ_U16(out[flow].segment, work.ip.protocol == NAT_PROTO_ICMP ? 4U : 0U)) {
+      fail("reply not restored to the private endpoint");
+    }
+  }
+
+  /* Steady state: random flows, both directions, with the table full. */
+  for (uint32_t flow = 0U; flow < BENCH_FLOWS; ++flow) {
+    if (out[flow].ip.protocol == NAT_PROTO_TCP) {
+      set_tcp_flags(&out[flow], TCP_ACK);
+      set_tcp_flags(&in[flow], TCP_ACK);
+    }
+  }
+  uint32_t* order = malloc(BENCH_PACKETS * sizeof(*order));
+  if (order == NULL) {
+    fail("alloc");
+  }
+  for (uint32_t index = 0U; index < BENCH_PACKETS; ++index) {
+    order[index] = rng_next() % BENCH_FLOWS;
+  }
+  start = now_sec();
+  for (uint32_t index = 0U; index < BENCH_PACKETS; ++index) {
+    work = out[order[index]];
+    work.ip.payload = work.segment;
+    translate(nat, &work, true, "steady outbound");
+  }
+  double out_ns = (now_sec() - start) * 1e9 / BENCH_PACKETS;
+  start = now_sec();
+  for (uint32_t index = 0U; index < BENCH_PACKETS; ++index) {
+    work = in[order[index]];
+    work.ip.payload = work.segment;
+    translate(nat, &work, false, "steady inbound");
+  }
+  double in_ns = (now_sec() - start) * 1e9 / BENCH_PACKETS;
+  free(order);
+
+  /* Unsolicited inbound traffic finds no flow. */
+  work = in[0];
+  work.ip.payload = work.segment;
+  WRITE_U16(work.segment, 0U, 8080U);
+  if (nat_translate_in(nat, &work.ip) == MAGI_OK) {
+    fail("unsolicited inbound packet translated");
+  }
+
+  fprintf(stderr,
+          "%u flows over %zu mappings: new flow %5.1f ns, outbound %5.1f ns, "
+          "inbound %5.1f ns per packet (%u random packets each way)\n",
+          BENCH_FLOWS, stats.mappings, create_ns, out_ns, in_ns, BENCH_PACKETS);
+
+  /* TCP teardown: FIN each way closes flow 0, a RST from the remote closes flow 2. */
+  work = out[0];
+  work.ip.payload = work.segment;
+  set_tcp_flags(&work, TCP_FIN_ACK);
+  translate(nat, &work, true, "FIN out");
+  work = in[0];
+  work.ip.payload = work.segment;
+  set_tcp_flags(&work, TCP_FIN_ACK);
+  translate(nat, &work, false, "FIN in");
+  work = in[2];
+  work.ip.payload = work.segment;
+  set_tcp_flags(&work, TCP_RST);
+  translate(nat, &work, false, "RST in");
+
+  /* Shrink the short timeouts and let them pass: closed TCP, UDP and ICMP flows go. */
+  size_t udp_icmp = 0U;
+  for (uint32_t flow = 0U; flow < BENCH_FLOWS; ++flow) {
+    udp_icmp += out[flow].ip.protocol != NAT_PROTO_TCP ? 1U : 0U;
+  }
+  nat->timeouts.udp_ms = 1U;
+  nat->timeouts.icmp_ms = 1U;
+  nat->timeouts.tcp_closed_ms = 1U;
+  advance_ms(5U);
+  start = now_sec();
+  size_t expired = nat_expire(nat);
+  double sweep_ms = (now_sec() - start) * 1e3;
+  nat_get_stats(nat, &stats);
+  if (expired != udp_icmp + 2U || stats.flows != BENCH_FLOWS - udp_icmp - 2U ||
+      stats.mappings != (BENCH_FLOWS - udp_icmp) / 2U) {
+    fail("expiry by protocol and TCP state");
+  }
+  work = in[4];
+  work.ip.payload = work.segment;
+  if (work.ip.protocol != NAT_PROTO_TCP || nat_translate_in(nat, &work.ip) != MAGI_OK) {
+    fail("established flow expired");
+  }
+  fprintf(stderr, "expiry     swept %zu idle UDP/ICMP and closed TCP flows in %.1f ms\n", expired,
+          sweep_ms);
+
+  nat_table_free(nat);
+
+  /* Fill a protocol's port space, then let the exhaustion path reclaim idle flows. */
+  nat = nat_table_new(public_ip);
+  if (nat == NULL) {
+    fail("alloc");
+  }
+  uint32_t port_space = NAT_MAX_PORT - NAT_MIN_PORT + 1U;
+  BenchPacket udp;
+  build_outbound(&udp, 4U * 2U); /* Endpoint 4 is UDP */
+  start = now_sec();
+  for (uint32_t index = 0U; index <= port_space; ++index) {
+    work = udp;
+    work.ip.payload = work.segment;
+    WRITE_U32(work.ip.src_ip, 0U, 0x0A000000U + index);
+    int status = nat_translate_out(nat, &work.ip);
+    if ((index < port_space) != (status == MAGI_OK)) {
+      fail("port allocator did not hand out exactly the port space");
+    }
+  }
+  double alloc_ns = (now_sec() - start) * 1e9 / port_space;
+  nat_get_stats(nat, &stats);
+  if (stats.no_port != 1U || stats.mappings != port_space) {
+    fail("port exhaustion accounting");
+  }
+  nat->timeouts.udp_ms = 1U;
+  advance_ms(5U);
+  work = udp;
+  work.ip.payload = work.segment;
+  WRITE_U32(work.ip.src_ip, 0U, 0x0B000001U);
+  if (nat_translate_out(nat, &work.ip) != MAGI_OK) {
+    fail("exhausted ports not reclaimed from idle flows");
+  }
+  magi_log_set_level(MAGI_LOG_L3, MAGI_LOG_INFO);
+  nat_print(nat, "R1");
+  fprintf(stderr, "ports      %u mapped at %.1f ns each, exhaustion reclaimed idle flows\n",
+          port_space, alloc_ns);
+
+  nat_table_free(nat);
+  free(in);
+  free(out);
+  fprintf(stderr, "RESULT: PASS\n");
+  return 0;
+}
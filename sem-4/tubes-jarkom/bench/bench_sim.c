@@ -0,0 +1,176 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "cli/node_ops.h"
+#include "core/interface.h"
+#include "core/node.h"
+#include "core/sim.h"
+#include "layer3/ipv4.h"
+#include "layer3/router.h"
+#include "topology/topology.h"
+#include "utils/magi_error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef MAGI_ASYNC
+int main(void) {
+  printf("--- Discrete-event clock benchmark ---\n");
+  fprintf(stderr, "virtual clock: skipped (async builds run on the wall clock)\n");
+  printf("RESULT: PASS\n");
+  return 0;
+}
+#else
+#define BENCH_ROUTERS 9U
+#define BENCH_LINK_DELAY_MS 20U
+#define BENCH_PINGS 1000U
+#define BENCH_RTT_MS (2U * (BENCH_ROUTERS + 1U) * BENCH_LINK_DELAY_MS)
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void fail(const char* what) {
+  fprintf(stderr, "RESULT: FAIL - %s\n", what);
+  exit(1);
+}
+
+/*
+ * H1 - R1 - R2 - ... - R9 - H2, every link BENCH_LINK_DELAY_MS long. Link k
+ * carries 10.0.k.0/24; the router on its left owns .2 (port 2), the one on
+ * its right .1 (port 1), and the hosts sit at .100 on port 1.
+ */
+static Topology* build_chain(void) {
+  Topology* topology = topology_new();
+  topology_set_node_ops(topology, cli_topology_node_ops());
+  bool ok = topology_add_node(topology, TOPOLOGY_NODE_HOST, "H1") != NULL &&
+            topology_add_node(topology, TOPOLOGY_NODE_HOST, "H2") != NULL;
+
+  char prev[8] = "H1";
+  for (unsigned index = 1U; ok && index <= BENCH_ROUTERS; ++index) {
+    char name[8];
+    snprintf(name, sizeof(name), "R%u", index);
+    uint16_t prev_port = index == 1U ? 1U : 2U;
+    ok = topology_add_node(topology, TOPOLOGY_NODE_ROUTER, name) != NULL &&
+         topology_add_link(topology, prev, prev_port, name, 1U, BENCH_LINK_DELAY_MS, 1500U) != NULL;
+    snprintf(prev, sizeof(prev), "%s", name);
+  }
+  ok = ok && topology_add_link(topology, prev, 2U, "H2", 1U, BENCH_LINK_DELAY_MS, 1500U) != NULL;
+  if (!ok) {
+    fail("topology setup");
+  }
+
+  for (unsigned index = 1U; index <= BENCH_ROUTERS; ++index) {
+    char name[8];
+    char left[24];
+    char right[24];
+    snprintf(name, sizeof(name), "R%u", index);
+    snprintf(left, sizeof(left), "10.0.%u.1/24", index - 1U);
+    snprintf(right, sizeof(right), "10.0.%u.2/24", index);
+    Node* node = topology_get_node(topology, name);
+    Router* router = router_from_node(node);
+    ok = interface_set_ip(node_get_interface(node, 1U), left) == MAGI_OK &&
+         interface_set_ip(node_get_interface(node, 2U), right) == MAGI_OK;
+
+    char next_hop[16];
+    if (ok && index < BENCH_ROUTERS) {
+      snprintf(next_hop, sizeof(next_hop), "10.0.%u.1", index);
+      ok = router_add_route(router, "10.0.9.0/24", next_hop, 2U) == MAGI_OK;
+    }
+    if (ok && index > 1U) {
+      snprintf(next_hop, sizeof(next_hop), "10.0.%u.2", index - 1U);
+      ok = router_add_route(router, "10.0.0.0/24", next_hop, 1U) == MAGI_OK;
+    }
+    if (!ok) {
+      fail("router setup");
+    }
+  }
+
+  if (topology_configure_host(topology, "H1", "10.0.0.100/24", "10.0.0.1") != MAGI_OK ||
+      topology_configure_host(topology, "H2", "10.0.9.100/24", "10.0.9.2") != MAGI_OK) {
+    fail("host setup");
+  }
+  return topology;
+}
+
+/* Ping once and return the virtual time it took, in milliseconds. */
+static uint64_t timed_ping(Node* host, const char* target) {
+  uint64_t start = sim_now_ns();
+  if (ipv4_host_ping(host, target) != MAGI_OK) {
+    fail("ipv4_host_ping");
+  }
+  return (sim_now_ns() - start) / SIM_NS_PER_MS;
+}
+
+int main(void) {
+  printf("--- Discrete-event clock benchmark ---\n");
+  /* Per-hop LOG lines go to stdout; keep them out of the timing. */
+  if (freopen("/dev/null", "w", stdout) == NULL) {
+    return 1;
+  }
+
+  Topology* topology = build_chain();
+  Node* h1 = topology_get_node(topology, "H1");
+
+  uint64_t cold_ms = timed_ping(h1, "10.0.9.100");
+  uint64_t warm_ms = timed_ping(h1, "10.0.9.100");
+  fprintf(stderr, "%u links of %u ms: cold ping %llu ms (ARP on every hop), warm %llu ms\n",
+          BENCH_ROUTERS + 1U, BENCH_LINK_DELAY_MS, (unsigned long long)cold_ms,
+          (unsigned long long)warm_ms);
+  if (warm_ms != BENCH_RTT_MS) {
+    fail("warm ping RTT is not exactly 2 x path delay");
+  }
+
+  uint64_t start_ns = sim_now_ns();
+  double start = now_sec();
+  if (ipv4_host_traceroute(h1, "10.0.9.100", 16U) != MAGI_OK) {
+    fail("ipv4_host_traceroute");
+  }
+  double trace_wall = now_sec() - start;
+  uint64_t trace_ms = (sim_now_ns() - start_ns) / SIM_NS_PER_MS;
+  /* Probe k turns around after k links: sum of 2 x k x delay for k = 1..10. */
+  uint64_t trace_expected = (uint64_t)BENCH_LINK_DELAY_MS * (BENCH_ROUTERS + 1U) *
+                            (BENCH_ROUTERS + 2U);
+  fprintf(stderr, "traceroute: %llu ms virtual in %.3f ms wall\n", (unsigned long long)trace_ms,
+          trace_wall * 1e3);
+  if (trace_ms != trace_expected) {
+    fail("traceroute virtual time does not match the hop delays");
+  }
+
+  /* Neighbor entries age on the virtual clock too, so some pings re-resolve ARP. */
+  size_t refreshed = 0U;
+  start_ns = sim_now_ns();
+  start = now_sec();
+  for (size_t index = 0U; index < BENCH_PINGS; ++index) {
+    uint64_t rtt_ms = timed_ping(h1, "10.0.9.100");
+    if (rtt_ms < BENCH_RTT_MS) {
+      fail("ping faster than the path delay");
+    }
+    refreshed += rtt_ms != BENCH_RTT_MS;
+  }
+  double pings_wall = now_sec() - start;
+  double pings_virtual = (double)(sim_now_ns() - start_ns) / 1e9;
+  fprintf(stderr,
+          "%u pings (%zu paid an ARP refresh): %.1f s virtual in %.3f s wall -> %.0fx real time\n",
+          BENCH_PINGS, refreshed, pings_virtual, pings_wall, pings_virtual / pings_wall);
+
+  sim_set_realtime(true);
+  start = now_sec();
+  uint64_t paced_ms = timed_ping(h1, "10.0.9.100");
+  double paced_wall = now_sec() - start;
+  sim_set_realtime(false);
+  fprintf(stderr, "real-time paced ping: %llu ms virtual in %.3f s wall\n",
+          (unsigned long long)paced_ms, paced_wall);
+  if (paced_ms != BENCH_RTT_MS || paced_wall < (double)BENCH_RTT_MS / 1e3 * 0.95) {
+    fail("real-time pacing");
+  }
+
+  topology_free(topology);
+  fprintf(stderr, "RESULT: PASS\n");
+  return 0;
+}
+#endif
@@ -0,0 +1,237 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "cli/node_ops.h"
+#include "core/interface.h"
+#include "core/link.h"
+#include "core/node.h"
+#include "core/stats.h"
+#include "layer3/ipv4.h"
+#include "topology/stats_export.h"
+#include "topology/topology.h"
+#include "utils/magi_error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAGI_ASYNC
+#include <pthread.h>
+#include <stdatomic.h>
+#endif
+
+#define BENCH_ADDS 50000000U
+#define BENCH_THREADS 4U
+#define BENCH_THREAD_ADDS 10000000U
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void fail(const char* what) {
+  fprintf(stderr, "RESULT: FAIL - %s\n", what);
+  exit(1);
+}
+
+/* Cost of one counter bump on the calling thread. */
+static void bench_single_thread(void) {
+  MagiCounters counters = {0};
+  if (magi_counters_init(&counters, MAGI_IFACE_COUNTER_COUNT) != MAGI_OK) {
+    fail("counter setup");
+  }
+
+  double start = now_sec();
+  for (uint32_t index = 0U; index < BENCH_ADDS; ++index) {
+    magi_counter_add(&counters, MAGI_IFACE_RX_PACKETS, 1U);
+    magi_counter_add(&counters, MAGI_IFACE_RX_BYTES, 64U + (index & 1023U));
+  }
+  double elapsed = now_sec() - start;
+  if (magi_counter_read(&counters, MAGI_IFACE_RX_PACKETS) != BENCH_ADDS) {
+    fail("single-thread count");
+  }
+  fprintf(stderr, "1 thread   %5.2f ns per packet (packets + bytes)\n",
+          elapsed * 1e9 / BENCH_ADDS);
+  magi_counters_free(&counters);
+}
+
+#ifdef MAGI_ASYNC
+static MagiCounters shared_counters;
+static _Atomic uint64_t shared_cell;
+
+static void* sharded_worker(void* arg) {
+  (void)arg;
+  for (uint32_t index = 0U; index < BENCH_THREAD_ADDS; ++index) {
+    magi_counter_add(&shared_counters, MAGI_IFACE_TX_PACKETS, 1U);
+  }
+  return NULL;
+}
+
+static void* single_cell_worker(void* arg) {
+  (void)arg;
+  for (uint32_t index = 0U; index < BENCH_THREAD_ADDS; ++index) {
+    atomic_fetch_add_explicit(&shared_cell, 1U, memory_order_relaxed);
+  }
+  return NULL;
+}
+
+static double run_threads(void* (*worker)(void*)) {
+  pthread_t threads[BENCH_THREADS];
+  double start = now_sec();
+  for (size_t index = 0U; index < BENCH_THREADS; ++index) {
+    if (pthread_create(&threads[index], NULL, worker, NULL) != 0) {
+      fail("pthread_create");
+    }
+  }
+  for (size_t index = 0U; index < BENCH_THREADS; ++index) {
+    pthread_join(threads[index], NULL);
+  }
+  return (now_sec() - start) * 1e9 / BENCH_THREAD_ADDS;
+}
+
+/* Several engine-like threads counting into one interface at once. */
+static void bench_contended(void) {
+  if (magi_counters_init(&shared_counters, MAGI_IFACE_COUNTER_COUNT) != MAGI_OK) {
+    fail("counter setup");
+  }
+
+  double single_ns = run_threads(single_cell_worker);
+  double sharded_ns = run_threads(sharded_worker);
+  uint64_t expected = (uint64_t)BENCH_THREADS * BENCH_THREAD_ADDS;
+  if (magi_counter_read(&shared_counters, MAGI_IFACE_TX_PACKETS) != expected ||
+      atomic_load(&shared_cell) != expected) {
+    fail("contended count lost increments");
+  }
+  fprintf(stderr, "%u threads  one shared atomic %5.2f ns, per-thread shards %5.2f ns per add\n",
+          BENCH_THREADS, single_ns, sharded_ns);
+  magi_counters_free(&shared_counters);
+}
+#else
+/* H1 - R1 - H2 over two 1 ms links; R1 routes between 10.0.0.0/24 and 10.0.1.0/24. */
+static Topology* build_topology(void) {
+  Topology* topology = topology_new();
+  topology_set_node_ops(topology, cli_topology_node_ops());
+  bool ok = topology_add_node(topology, TOPOLOGY_NODE_HOST, "H1") != NULL &&
+            topology_add_node(topology, TOPOLOGY_NODE_HOST, "H2") != NULL &&
+            topology_add_node(topology, TOPOLOGY_NODE_ROUTER, "R1") != NULL &&
+            topology_add_link(topology, "H1", 1U, "R1", 1U, 1U, 1500U) != NULL &&
+            topology_add_link(topology, "R1", 2U, "H2", 1U, 1U, 1500U) != NULL;
+  Node* router = ok ? topology_get_node(topology, "R1") : NULL;
+  ok = ok && interface_set_ip(node_get_interface(router, 1U), "10.0.0.1/24") == MAGI_OK &&
+       interface_set_ip(node_get_interface(router, 2U), "10.0.1.1/24") == MAGI_OK &&
+       topology_configure_host(topology, "H1", "10.0.0.100/24", "10.0.0.1") == MAGI_OK &&
+       topology_configure_host(topology, "H2", "10.0.1.100/24", "10.0.1.1") == MAGI_OK;
+  if (!ok) {
+    fail("topology setup");
+  }
+  return topology;
+}
+
+static uint64_t iface_counter(Topology* topology, const char* name, uint16_t port,
+                              MagiIfaceCounter counter) {
+  Interface* iface = node_get_interface(topology_get_node(topology, name), port);
+  return iface != NULL ? magi_counter_read(&iface->counters, counter) : 0U;
+}
+
+static uint64_t node_counter(Topology* topology, const char* name, MagiNodeCounter counter) {
+  Node* node = topology_get_node(topology, name);
+  return node != NULL ? magi_counter_read(&node->counters, counter) : 0U;
+}
+
+/* Each end of a link must have received exactly what the other end sent. */
+static void check_link(Topology* topology, const char* a, uint16_t port_a, const char* b,
+                       uint16_t port_b) {
+  Interface* end_a = node_get_interface(topology_get_node(topology, a), port_a);
+  LinkStats link_stats = {0};
+  if (link_get_stats(end_a->link, end_a, &link_stats) != MAGI_OK ||
+      iface_counter(topology, a, port_a, MAGI_IFACE_TX_PACKETS) != link_stats.tx_packets ||
+      iface_counter(topology, a, port_a, MAGI_IFACE_TX_PACKETS) !=
+          iface_counter(topology, b, port_b, MAGI_IFACE_RX_PACKETS) ||
+      iface_counter(topology, a, port_a, MAGI_IFACE_TX_BYTES) !=
+          iface_counter(topology, b, port_b, MAGI_IFACE_RX_BYTES) ||
+      iface_counter(topology, b, port_b, MAGI_IFACE_TX_PACKETS) !=
+          iface_counter(topology, a, port_a, MAGI_IFACE_RX_PACKETS)) {
+    fail("interface counters disagree across a link");
+  }
+}
+
+static bool dump_contains(Topology* topology, TopologyStatsFormat format, const char* needle) {
+  char* text = NULL;
+  size_t len = 0U;
+  FILE* out = open_memstream(&text, &len);
+  if (out == NULL || topology_write_stats(topology, format, out) != MAGI_OK) {
+    fail("stats dump");
+  }
+  fclose(out);
+  bool found = strstr(text, needle) != NULL;
+  free(text);
+  return found;
+}
+
+/* Drive pings, a traceroute and an unroutable ping through a small topology. */
+static void check_topology_counters(void) {
+  Topology* topology = build_topology();
+  Node* h1 = topology_get_node(topology, "H1");
+  if (ipv4_host_ping(h1, "10.0.1.100") != MAGI_OK || ipv4_host_ping(h1, "10.0.1.100") != MAGI_OK ||
+      ipv4_host_traceroute(h1, "10.0.1.100", 4U) != MAGI_OK) {
+    fail("ping/traceroute");
+  }
+  (void)ipv4_host_ping(h1, "10.9.9.9");
+
+  check_link(topology, "H1", 1U, "R1", 1U);
+  check_link(topology, "R1", 2U, "H2", 1U);
+  /* One traceroute probe expires at R1; the ping to 10.9.9.9 has nowhere to go. */
+  if (node_counter(topology, "R1", MAGI_NODE_DROP_TTL) != 1U ||
+      node_counter(topology, "R1", MAGI_NODE_DROP_NO_ROUTE) != 1U ||
+      node_counter(topology, "R1", MAGI_NODE_FIB_LOOKUPS) == 0U ||
+      node_counter(topology, "H1", MAGI_NODE_ARP_MISSES) != 1U ||
+      node_counter(topology, "H1", MAGI_NODE_ARP_HITS) == 0U ||
+      node_counter(topology, "R1", MAGI_NODE_ARP_HITS) == 0U) {
+    fail("node counters");
+  }
+
+  char expected[96];
+  snprintf(expected, sizeof(expected),
+           "magi_interface_rx_packets_total{node=\"R1\",port=\"1\"} %llu\n",
+           (unsigned long long)iface_counter(topology, "R1", 1U, MAGI_IFACE_RX_PACKETS));
+  if (!dump_contains(topology, TOPOLOGY_STATS_OPENMETRICS,
+                     "magi_node_drops_total{node=\"R1\",reason=\"ttl\"} 1\n") ||
+      !dump_contains(topology, TOPOLOGY_STATS_OPENMETRICS, expected) ||
+      !dump_contains(topology, TOPOLOGY_STATS_OPENMETRICS, "# EOF\n") ||
+      !dump_contains(topology, TOPOLOGY_STATS_JSON, "\"drop_no_route\": 1,")) {
+    fail("export contents");
+  }
+  fprintf(stderr, "topology   H1 port 1 tx=%llu rx=%llu, R1 drops ttl=1 no_route=1, "
+                  "%llu FIB lookups\n",
+          (unsigned long long)iface_counter(topology, "H1", 1U, MAGI_IFACE_TX_PACKETS),
+          (unsigned long long)iface_counter(topology, "H1", 1U, MAGI_IFACE_RX_PACKETS),
+          (unsigned long long)node_counter(topology, "R1", MAGI_NODE_FIB_LOOKUPS));
+
+  topology_reset_stats(topology);
+  if (iface_counter(topology, "R1", 1U, MAGI_IFACE_RX_PACKETS) != 0U ||
+      node_counter(topology, "R1", MAGI_NODE_DROP_TTL) != 0U) {
+    fail("reset");
+  }
+  topology_free(topology);
+}
+#endif
+
+int main(void) {
+  printf("--- Counter benchmark ---\n");
+  /* Per-hop LOG lines go to stdout; keep them out of the timing. */
+  if (freopen("/dev/null", "w", stdout) == NULL) {
+    return 1;
+  }
+
+  bench_single_thread();
+#ifdef MAGI_ASYNC
+  bench_contended();
+#else
+  check_topology_counters();
+#endif
+  fprintf(stderr, "RESULT: PASS\n");
+  return 0;
+}
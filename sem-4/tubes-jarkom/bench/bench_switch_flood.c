@@ -0,0 +1,413 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "core/interface.h"
+#include "core/link.h"
+#include "core/node.h"
+#include "layer2/fdb.h"
+#include "layer2/switch.h"
+#include "utils/hashmap.h"
+#include "utils/mac.h"
+#include "utils/magi_error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#else
+#define BENCH_HAVE_TSC 0
+#endif
+
+#ifdef MAGI_ASYNC
+int main(void) {
+  printf("--- Switch flood benchmark ---\n");
+  fprintf(stderr, "switch flood: skipped (async links deliver on worker threads)\n");
+  printf("RESULT: PASS\n");
+  return 0;
+}
+#else
+#define BENCH_PORTS 48U
+#define BENCH_FLOOD_FRAMES 20000U
+#define BENCH_TRUNKS 4U
+#define BENCH_VLANS 4U
+#define BENCH_STORM_HOSTS 1024U
+#define BENCH_UNICAST_FRAMES 200000U
+#define BENCH_LOOKUPS 10000000U
+#define BENCH_PAYLOAD 64U
+#define BENCH_STATIONS 4096U
+#define BENCH_FDB_LOOKUPS 4000000U
+
+static size_t frames_delivered = 0U;
+static size_t tagged_delivered = 0U;
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t ticks(void) {
+#if BENCH_HAVE_TSC
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static void fail(const char* what) {
+  fprintf(stderr, "RESULT: FAIL - %s\n", what);
+  exit(1);
+}
+
+static void sink_receive(Node* node, Interface* iface, const uint8_t* data, size_t len) {
+  (void)node;
+  (void)iface;
+  frames_delivered++;
+  if (len >= 14U && data[12] == 0x81U && data[13] == 0x00U) {
+    tagged_delivered++;
+  }
+}
+
+typedef struct Fabric {
+  Switch* sw;
+  Node* sinks[BENCH_PORTS];
+  Link* links[BENCH_PORTS];
+} Fabric;
+
+static void fabric_build(Fabric* fabric) {
+  fabric->sw = switch_new("SW1");
+  if (fabric->sw == NULL || switch_configure_num_ports(fabric->sw, BENCH_PORTS) != MAGI_OK) {
+    fail("switch setup");
+  }
+  Node* node = switch_as_node(fabric->sw);
+  for (uint16_t port = 1U; port <= BENCH_PORTS; ++port) {
+    char name[16];
+    snprintf(name, sizeof(name), "H%u", (unsigned)port);
+    Node* sink = node_new(name);
+    if (sink == NULL) {
+      fail("sink setup");
+    }
+    sink->handle_receive = sink_receive;
+    fabric->sinks[port - 1U] = sink;
+    fabric->links[port - 1U] =
+        link_new(node_get_interface(node, port), node_add_interface(sink, 1U), 0U, 1500U);
+    if (fabric->links[port - 1U] == NULL) {
+      fail("link setup");
+    }
+  }
+}
+
+static void fabric_free(Fabric* fabric) {
+  for (size_t index = 0U; index < BENCH_PORTS; ++index) {
+    link_free(fabric->links[index]);
+    node_free(fabric->sinks[index]);
+  }
+  switch_free(fabric->sw);
+}
+
+static size_t build_frame(uint8_t* out, const uint8_t dst[6], const uint8_t src[6]) {
+  memcpy(out, dst, 6U);
+  memcpy(out + 6U, src, 6U);
+  out[12] = 0x08U;
+  out[13] = 0x00U;
+  for (size_t index = 0U; index < BENCH_PAYLOAD; ++index) {
+    out[14U + index] = (uint8_t)index;
+  }
+  return 14U + BENCH_PAYLOAD;
+}
+
+/* Broadcast from port 1: one ingress parse, BENCH_PORTS - 1 egress copies. */
+static void bench_flood(Fabric* fabric) {
+  static const uint8_t broadcast[6] = {0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU};
+  static const uint8_t src[6] = {0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U};
+  uint8_t frame[14U + BENCH_PAYLOAD];
+  size_t len = build_frame(frame, broadcast, src);
+  Interface* ingress = node_get_interface(switch_as_node(fabric->sw), 1U);
+
+  frames_delivered = 0U;
+  double start = now_sec();
+  uint64_t t0 = ticks();
+  for (size_t index = 0U; index < BENCH_FLOOD_FRAMES; ++index) {
+    interface_receive(ingress, frame, len);
+  }
+  uint64_t t1 = ticks();
+  double elapsed = now_sec() - start;
+
+  if (frames_delivered != (size_t)BENCH_FLOOD_FRAMES * (BENCH_PORTS - 1U)) {
+    fail("flood did not reach every other port");
+  }
+  fprintf(stderr, "flood     %u ports: %8.0f %s/frame  %6.0f ns/frame  %6.1f ns/egress copy\n",
+          BENCH_PORTS, (double)(t1 - t0) / BENCH_FLOOD_FRAMES, BENCH_HAVE_TSC ? "cycles" : "ticks",
+          elapsed * 1e9 / BENCH_FLOOD_FRAMES, elapsed * 1e9 / (double)frames_delivered);
+}
+
+/*
+ * ARP-storm shape: broadcasts from BENCH_STORM_HOSTS sources on port 1 with
+ * the switch split into BENCH_VLANS access VLANs plus BENCH_TRUNKS trunks.
+ * Each frame reaches the other access ports of its VLAN and every trunk.
+ */
+static void bench_flood_vlans(Fabric* fabric) {
+  static const uint8_t broadcast[6] = {0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU};
+  const uint16_t access_ports = BENCH_PORTS - BENCH_TRUNKS;
+  for (uint16_t port = 1U; port <= BENCH_PORTS; ++port) {
+    int status = port <= access_ports
+                     ? switch_configure_port(fabric->sw, port, "access",
+                                             (uint16_t)(port % BENCH_VLANS + 1U))
+                     : switch_configure_port(fabric->sw, port, "trunk", 0U);
+    if (status != MAGI_OK) {
+      fail("vlan setup");
+    }
+  }
+
+  uint8_t src[6] = {0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U};
+  uint8_t frame[14U + BENCH_PAYLOAD];
+  size_t len = build_frame(frame, broadcast, src);
+  Interface* ingress = node_get_interface(switch_as_node(fabric->sw), 1U);
+
+  frames_delivered = 0U;
+  tagged_delivered = 0U;
+  double start = now_sec();
+  uint64_t t0 = ticks();
+  for (size_t index = 0U; index < BENCH_FLOOD_FRAMES; ++index) {
+    frame[10] = (uint8_t)((index % BENCH_STORM_HOSTS) >> 8U);
+    frame[11] = (uint8_t)index;
+    interface_receive(ingress, frame, len);
+  }
+  uint64_t t1 = ticks();
+  double elapsed = now_sec() - start;
+
+  size_t per_frame = access_ports / BENCH_VLANS - 1U + BENCH_TRUNKS;
+  if (frames_delivered != (size_t)BENCH_FLOOD_FRAMES * per_frame ||
+      tagged_delivered != (size_t)BENCH_FLOOD_FRAMES * BENCH_TRUNKS) {
+    fail("vlan flood reached the wrong ports");
+  }
+  fprintf(stderr, "storm     %u vlans:  %8.0f %s/frame  %6.0f ns/frame  (%zu egress, %u tagged)\n",
+          BENCH_VLANS, (double)(t1 - t0) / BENCH_FLOOD_FRAMES, BENCH_HAVE_TSC ? "cycles" : "ticks",
+          elapsed * 1e9 / BENCH_FLOOD_FRAMES, per_frame, BENCH_TRUNKS);
+
+  /* Detaching a link and re-tagging a port must both reshape the next flood. */
+  Node* node = switch_as_node(fabric->sw);
+  link_free(fabric->links[1U + BENCH_VLANS - 1U]);
+  fabric->links[1U + BENCH_VLANS - 1U] = NULL;
+  frames_delivered = 0U;
+  interface_receive(ingress, frame, len);
+  if (frames_delivered != per_frame - 1U) {
+    fail("flood list kept a detached port");
+  }
+  fabric->links[1U + BENCH_VLANS - 1U] =
+      link_new(node_get_interface(node, 1U + BENCH_VLANS),
+               node_get_interface(fabric->sinks[BENCH_VLANS], 1U), 0U, 1500U);
+  if (fabric->links[1U + BENCH_VLANS - 1U] == NULL ||
+      switch_configure_port(fabric->sw, 2U, "trunk", 0U) != MAGI_OK) {
+    fail("relink");
+  }
+  frames_delivered = 0U;
+  interface_receive(ingress, frame, len);
+  if (frames_delivered != per_frame + 1U) {
+    fail("flood list missed a reattached or re-tagged port");
+  }
+}
+
+/* Known unicast from port 1 to the host learned on the last port. */
+static void bench_unicast(Fabric* fabric) {
+  static const uint8_t host_a[6] = {0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U};
+  static const uint8_t host_b[6] = {0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x02U};
+  Node* node = switch_as_node(fabric->sw);
+  uint8_t frame[14U + BENCH_PAYLOAD];
+
+  /* Teach the switch where host_b lives. */
+  size_t len = build_frame(frame, host_a, host_b);
+  interface_receive(node_get_interface(node, BENCH_PORTS), frame, len);
+
+  len = build_frame(frame, host_b, host_a);
+  Interface* ingress = node_get_interface(node, 1U);
+  frames_delivered = 0U;
+  double start = now_sec();
+  uint64_t t0 = ticks();
+  for (size_t index = 0U; index < BENCH_UNICAST_FRAMES; ++index) {
+    interface_receive(ingress, frame, len);
+  }
+  uint64_t t1 = ticks();
+  double elapsed = now_sec() - start;
+
+  if (frames_delivered != BENCH_UNICAST_FRAMES) {
+    fail("unicast frames were not forwarded exactly once");
+  }
+  fprintf(stderr, "unicast   %u ports: %8.0f %s/frame  %6.0f ns/frame\n", BENCH_PORTS,
+          (double)(t1 - t0) / BENCH_UNICAST_FRAMES, BENCH_HAVE_TSC ? "cycles" : "ticks",
+          elapsed * 1e9 / BENCH_UNICAST_FRAMES);
+}
+
+/* Port lookup alone: the decimal-string map the node used to index vs the port table. */
+static void bench_lookup(Fabric* fabric) {
+  Node* node = switch_as_node(fabric->sw);
+  size_t hits = 0U;
+
+  uint64_t t0 = ticks();
+  for (size_t index = 0U; index < BENCH_LOOKUPS; ++index) {
+    char key[16];
+    snprintf(key, sizeof(key), "%u", (unsigned)(index % BENCH_PORTS + 1U));
+    hits += hashmap_get(node->interfaces, key) != NULL;
+  }
+  uint64_t t1 = ticks();
+  for (size_t index = 0U; index < BENCH_LOOKUPS; ++index) {
+    hits += node_get_interface(node, (uint16_t)(index % BENCH_PORTS + 1U)) != NULL;
+  }
+  uint64_t t2 = ticks();
+
+  if (hits != 2U * BENCH_LOOKUPS) {
+    fail("port lookup missed");
+  }
+  const char* unit = BENCH_HAVE_TSC ? "cycles" : "ticks";
+  fprintf(stderr, "lookup    string map %6.1f %s, port table %6.1f %s\n",
+          (double)(t1 - t0) / BENCH_LOOKUPS, unit, (double)(t2 - t1) / BENCH_LOOKUPS, unit);
+
+  /* Iteration must see every port once, in ascending order. */
+  if (node->iface_count != BENCH_PORTS) {
+    fail("interface list size");
+  }
+  for (size_t index = 0U; index < node->iface_count; ++index) {
+    if (node->iface_list[index]->port_number != index + 1U) {
+      fail("interface list is not in port order");
+    }
+  }
+}
+
+static void station_mac(uint32_t index, uint8_t mac[6]) {
+  mac[0] = 0x02U;
+  mac[1] = 0x00U;
+  mac[2] = (uint8_t)(index >> 24U);
+  mac[3] = (uint8_t)(index >> 16U);
+  mac[4] = (uint8_t)(index >> 8U);
+  mac[5] = (uint8_t)index;
+}
+
+/* The "vlan:mac" text key the switch used to hash for every frame. */
+static void text_key(uint16_t vlan_id, const uint8_t mac[6], char out[32]) {
+  char mac_text[18];
+  mac_to_str(mac, mac_text);
+  snprintf(out, 32U, "%u:%s", (unsigned)vlan_id, mac_text);
+}
+
+/* FDB semantics (capacity, moves, flaps, aging) and lookup cost against the text-keyed map. */
+static void bench_fdb(void) {
+  Fdb* fdb = fdb_new(BENCH_STATIONS, 0U);
+  HashMap* map = hashmap_new(16U);
+  static uint16_t ports[BENCH_STATIONS];
+  if (fdb == NULL || map == NULL) {
+    fail("fdb setup");
+  }
+
+  uint8_t mac[6];
+  for (uint32_t index = 0U; index < BENCH_STATIONS; ++index) {
+    uint16_t vlan_id = (uint16_t)(index % 4U + 1U);
+    ports[index] = (uint16_t)(index % BENCH_PORTS + 1U);
+    station_mac(index, mac);
+    if (fdb_learn(fdb, vlan_id, mac, ports[index], 0U, NULL) != FDB_LEARN_NEW) {
+      fail("fdb did not learn a new station");
+    }
+    char key[32];
+    text_key(vlan_id, mac, key);
+    if (hashmap_set(map, key, &ports[index]) != MAGI_OK) {
+      fail("text map insert");
+    }
+  }
+  station_mac(BENCH_STATIONS, mac);
+  if (fdb_learn(fdb, 1U, mac, 1U, 0U, NULL) != FDB_LEARN_FULL) {
+    fail("fdb learned past its capacity");
+  }
+
+  size_t hits = 0U;
+  uint64_t t0 = ticks();
+  for (uint32_t index = 0U; index < BENCH_FDB_LOOKUPS; ++index) {
+    uint32_t station = (index * 2654435761U) % BENCH_STATIONS;
+    station_mac(station, mac);
+    char key[32];
+    text_key((uint16_t)(station % 4U + 1U), mac, key);
+    uint16_t* port = hashmap_get(map, key);
+    hits += port != NULL && *port == ports[station];
+  }
+  uint64_t t1 = ticks();
+  for (uint32_t index = 0U; index < BENCH_FDB_LOOKUPS; ++index) {
+    uint32_t station = (index * 2654435761U) % BENCH_STATIONS;
+    station_mac(station, mac);
+    uint16_t port = 0U;
+    hits += fdb_lookup(fdb, (uint16_t)(station % 4U + 1U), mac, 1U, &port) &&
+            port == ports[station];
+  }
+  uint64_t t2 = ticks();
+  if (hits != 2U * BENCH_FDB_LOOKUPS) {
+    fail("fdb lookup missed");
+  }
+  const char* unit = BENCH_HAVE_TSC ? "cycles" : "ticks";
+  fprintf(stderr, "fdb       %u stations: text map %6.1f %s, packed fdb %6.1f %s per lookup\n",
+          BENCH_STATIONS, (double)(t1 - t0) / BENCH_FDB_LOOKUPS, unit,
+          (double)(t2 - t1) / BENCH_FDB_LOOKUPS, unit);
+
+  /* Station 0 bounces between ports: two moves 10 ms apart are one flap. */
+  uint16_t prev_port = 0U;
+  station_mac(0U, mac);
+  if (fdb_learn(fdb, 1U, mac, 2U, 10U, &prev_port) != FDB_LEARN_MOVED || prev_port != 1U ||
+      fdb_learn(fdb, 1U, mac, 1U, 20U, NULL) != FDB_LEARN_MOVED ||
+      fdb_learn(fdb, 1U, mac, 1U, 5000U, NULL) != FDB_LEARN_REFRESHED) {
+    fail("fdb move detection");
+  }
+
+  /* Everything but station 0 was last seen at t=0 and has aged out. */
+  uint64_t later = (uint64_t)FDB_AGING_MS + 100U;
+  uint16_t port = 0U;
+  if (!fdb_lookup(fdb, 1U, mac, later, &port) || port != 1U) {
+    fail("refreshed station aged out");
+  }
+  station_mac(1U, mac);
+  if (fdb_lookup(fdb, 2U, mac, later, &port)) {
+    fail("stale station still resolves");
+  }
+  if (fdb_expire(fdb, later) != BENCH_STATIONS - 2U) {
+    fail("fdb_expire count");
+  }
+  station_mac(BENCH_STATIONS, mac);
+  if (fdb_learn(fdb, 1U, mac, 1U, later, NULL) != FDB_LEARN_NEW) {
+    fail("aged slots were not reused");
+  }
+
+  FdbStats stats;
+  fdb_get_stats(fdb, &stats);
+  if (stats.entries != 2U || stats.learned != BENCH_STATIONS + 1U || stats.moves != 2U ||
+      stats.flaps != 1U || stats.aged != BENCH_STATIONS - 1U || stats.full_drops != 1U) {
+    fail("fdb counters");
+  }
+
+  hashmap_free(map);
+  fdb_free(fdb);
+}
+
+int main(void) {
+  printf("--- Switch flood benchmark ---\n");
+  fflush(stdout);
+
+  /* Per-frame LOG lines would dominate the measurement; discard them. */
+  if (freopen("/dev/null", "w", stdout) == NULL) {
+    return 1;
+  }
+
+  Fabric fabric;
+  fabric_build(&fabric);
+  bench_flood(&fabric);
+  bench_unicast(&fabric);
+  bench_lookup(&fabric);
+  bench_flood_vlans(&fabric);
+  fabric_free(&fabric);
+  bench_fdb();
+
+  fprintf(stderr, "RESULT: PASS\n");
+  return 0;
+}
+#endif
@@ -0,0 +1,304 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "core/interface.h"
+#include "core/link.h"
+#include "core/node.h"
+#include "core/sim.h"
+#include "layer2/host.h"
+#include "layer3/ipv4.h"
+#include "layer4/l4_host.h"
+#include "layer4/port_registry.h"
+#include "layer4/tcp_socket.h"
+#include "utils/magi_error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MAGI_ASYNC
+int main(void) {
+  printf("--- TCP congestion control benchmark ---\n");
+  fprintf(stderr, "tcp cc: skipped (retransmission timers run on the virtual clock)\n");
+  printf("RESULT: PASS\n");
+  return 0;
+}
+#else
+#define BENCH_SERVER_PORT 80U
+#define BENCH_CLIENT_PORT 40000U
+/* Ethernet + IPv4 + TCP headers: anything longer carries data. */
+#define BENCH_HEADERS_LEN 54U
+#define BENCH_MAX_DROPS 4U
+#define BENCH_TIMEOUT_NS (120000U * SIM_NS_PER_MS)
+
+/* Frames arriving at the server are dropped by index or inside a blackout window. */
+typedef struct LossPlan {
+  size_t data_frames;
+  size_t drop_at[BENCH_MAX_DROPS];
+  size_t drop_count;
+  uint64_t blackout_from_ns;
+  uint64_t blackout_to_ns;
+  size_t dropped;
+} LossPlan;
+
+static LossPlan loss = {0};
+
+typedef struct Conn {
+  Node* client;
+  Node* server;
+  Link* link;
+  TCPSocket* cli;
+  TCPSocket* srv;
+} Conn;
+
+static void fail(const char* what) {
+  fprintf(stderr, "RESULT: FAIL - %s\n", what);
+  exit(1);
+}
+
+static uint8_t pattern_byte(size_t offset) {
+  return (uint8_t)(offset * 131U + 7U);
+}
+
+static void lossy_receive(Interface* iface, const uint8_t* data, size_t len) {
+  uint64_t now = sim_now_ns();
+  if (now >= loss.blackout_from_ns && now < loss.blackout_to_ns) {
+    loss.dropped++;
+    return;
+  }
+  if (len > BENCH_HEADERS_LEN) {
+    size_t index = ++loss.data_frames;
+    for (size_t drop = 0U; drop < loss.drop_count; ++drop) {
+      if (loss.drop_at[drop] == index) {
+        loss.dropped++;
+        return;
+      }
+    }
+  }
+  interface_receive(iface, data, len);
+}
+
+static Node* make_host(const char* name, const char* cidr) {
+  Host* host = host_new(name);
+  Node* node = host_as_node(host);
+  if (host == NULL || host_configure(host, cidr, NULL) != MAGI_OK ||
+      ipv4_host_attach(node) != MAGI_OK || l4_host_attach(node) != MAGI_OK) {
+    fail("host setup");
+  }
+  return node;
+}
+
+static bool established(const void* ctx) {
+  const Conn* conn = ctx;
+  return conn->cli->state == TCP_ESTABLISHED && conn->srv->state == TCP_ESTABLISHED;
+}
+
+/* Client A -> server B over one link; the loss plan applies to frames reaching B. */
+static Conn open_conn(uint64_t rate_bps, uint32_t delay_ms, uint16_t mtu, uint32_t queue_limit) {
+  Conn conn = {.client = make_host("A", "10.0.0.1/24"), .server = make_host("B", "10.0.0.2/24")};
+  conn.link = link_new(node_get_interface(conn.client, 1U), node_get_interface(conn.server, 1U),
+                       delay_ms, mtu);
+  LinkQueueConfig queue = {.kind = LINK_QUEUE_FIFO, .limit = queue_limit};
+  if (conn.link == NULL ||
+      (rate_bps > 0U && (link_set_bandwidth(conn.link, rate_bps) != MAGI_OK ||
+                         link_set_queue(conn.link, &queue) != MAGI_OK))) {
+    fail("link setup");
+  }
+  node_get_interface(conn.server, 1U)->receive_up = lossy_receive;
+  loss = (LossPlan){0};
+
+  conn.srv = tcp_socket_new(conn.server);
+  conn.cli = tcp_socket_new(conn.client);
+  if (conn.srv == NULL || conn.cli == NULL) {
+    fail("socket allocation");
+  }
+  conn.cli->local_port = BENCH_CLIENT_PORT;
+  if (tcp_socket_bind_listen(conn.srv, conn.server, BENCH_SERVER_PORT) != MAGI_OK ||
+      port_registry_bind(l4_host_get_registry(conn.server), PORT_PROTOCOL_TCP, BENCH_SERVER_PORT,
+                         conn.srv) != MAGI_OK ||
+      port_registry_bind(l4_host_get_registry(conn.client), PORT_PROTOCOL_TCP, BENCH_CLIENT_PORT,
+                         conn.cli) != MAGI_OK ||
+      tcp_socket_connect(conn.cli, conn.client, "10.0.0.2", BENCH_SERVER_PORT) != MAGI_OK ||
+      !sim_run_until_cond(established, &conn, 1000U * SIM_NS_PER_MS)) {
+    fail("connection setup");
+  }
+  return conn;
+}
+
+static void close_conn(Conn* conn) {
+  (void)port_registry_unbind(l4_host_get_registry(conn->server), PORT_PROTOCOL_TCP,
+                             BENCH_SERVER_PORT);
+  (void)port_registry_unbind(l4_host_get_registry(conn->client), PORT_PROTOCOL_TCP,
+                             BENCH_CLIENT_PORT);
+  tcp_socket_free(conn->srv);
+  tcp_socket_free(conn->cli);
+  link_free(conn->link);
+  node_free(conn->client);
+  node_free(conn->server);
+}
+
+/*
+ * Offer total bytes as fast as the send buffer takes them and let the server
+ * read after every simulation event. Checks the byte stream and returns the
+ * virtual time the transfer took; the final ACKs are then let in.
+ */
+static uint64_t transfer(Conn* conn, size_t total) {
+  static uint8_t chunk[16384];
+  uint8_t sink[16384];
+  size_t offered = 0U;
+  size_t received = 0U;
+  uint64_t start = sim_now_ns();
+  uint64_t deadline = start + BENCH_TIMEOUT_NS;
+
+  while (received < total) {
+    while (offered < total) {
+      size_t len = total - offered < sizeof(chunk) ? total - offered : sizeof(chunk);
+      for (size_t index = 0U; index < len; ++index) {
+        chunk[index] = pattern_byte(offered + index);
+      }
+      if (tcp_socket_send(conn->cli, conn->client, chunk, len) != MAGI_OK) {
+        break;
+      }
+      offered += len;
+    }
+
+    size_t rd = 0U;
+    while ((rd = tcp_recv_buf_read(conn->srv, sink, sizeof(sink))) > 0U) {
+      for (size_t index = 0U; index < rd; ++index) {
+        if (sink[index] != pattern_byte(received + index)) {
+          fail("byte stream corrupted");
+        }
+      }
+      received += rd;
+    }
+    if (received < total && !sim_run_next(deadline)) {
+      fail("transfer stalled");
+    }
+  }
+  uint64_t elapsed = sim_now_ns() - start;
+  (void)sim_run_until(sim_now_ns() + 100U * SIM_NS_PER_MS);
+  return elapsed;
+}
+
+static TCPSocketStats client_stats(const Conn* conn) {
+  TCPSocketStats stats = {0};
+  tcp_socket_get_stats(conn->cli, &stats);
+  return stats;
+}
+
+static void print_stats(const char* label, const TCPSocketStats* stats) {
+  fprintf(stderr,
+          "  %-9s cwnd %u ssthresh %d srtt %.2f ms rto %llu ms, sent %llu, retx %llu "
+          "(fast %llu, timeouts %llu), in flight %zu\n",
+          label, (unsigned)stats->cwnd,
+          stats->ssthresh == UINT32_MAX ? -1 : (int)stats->ssthresh,
+          (double)stats->srtt_us / 1000.0, (unsigned long long)stats->rto_ms,
+          (unsigned long long)stats->segments_sent, (unsigned long long)stats->retransmits,
+          (unsigned long long)stats->fast_retransmits, (unsigned long long)stats->timeouts,
+          stats->bytes_in_flight);
+}
+
+/* One large send on a 576-byte MTU link leaves as MSS-sized segments. */
+static void bench_segmentation(void) {
+  Conn conn = open_conn(0U, 1U, 576U, 0U);
+  size_t total = 65536U;
+  (void)transfer(&conn, total);
+  TCPSocketStats stats = client_stats(&conn);
+  size_t expected = (total + 535U) / 536U;
+  fprintf(stderr, "segment  64 KiB over MTU 576: mss %u, %llu segments (expected %zu)\n",
+          (unsigned)stats.mss, (unsigned long long)stats.segments_sent, expected);
+  if (stats.mss != 536U || stats.segments_sent != expected || stats.retransmits != 0U) {
+    fail("segmentation");
+  }
+  close_conn(&conn);
+}
+
+/* A lone mid-stream loss is repaired by three duplicate ACKs, without a timeout. */
+static void bench_fast_retransmit(void) {
+  Conn conn = open_conn(0U, 5U, 1500U, 0U);
+  loss.drop_at[0] = 40U;
+  loss.drop_count = 1U;
+  uint64_t elapsed = transfer(&conn, 100U * 1460U);
+  TCPSocketStats stats = client_stats(&conn);
+  fprintf(stderr, "fastrtx  drop segment 40 of 100: done in %.1f ms\n", (double)elapsed / 1e6);
+  print_stats("client", &stats);
+  if (stats.fast_retransmits != 1U || stats.timeouts != 0U || stats.retransmits != 1U ||
+      stats.bytes_in_flight != 0U) {
+    fail("fast retransmit");
+  }
+  close_conn(&conn);
+}
+
+/* Losing the last segment leaves nothing to generate duplicate ACKs: the RTO repairs it. */
+static void bench_tail_loss(void) {
+  Conn conn = open_conn(0U, 5U, 1500U, 0U);
+  loss.drop_at[0] = 10U;
+  loss.drop_count = 1U;
+  uint64_t elapsed = transfer(&conn, 10U * 1460U);
+  TCPSocketStats stats = client_stats(&conn);
+  fprintf(stderr, "tailloss drop segment 10 of 10: done in %.1f ms\n", (double)elapsed / 1e6);
+  print_stats("client", &stats);
+  if (stats.timeouts != 1U || stats.fast_retransmits != 0U ||
+      elapsed < TCP_RTO_MIN_MS * SIM_NS_PER_MS) {
+    fail("tail loss");
+  }
+  close_conn(&conn);
+}
+
+/* A 5 s outage: timeouts back off exponentially, then the transfer completes. */
+static void bench_blackout(void) {
+  Conn conn = open_conn(0U, 5U, 1500U, 0U);
+  loss.blackout_from_ns = sim_now_ns() + 20U * SIM_NS_PER_MS;
+  loss.blackout_to_ns = loss.blackout_from_ns + 5000U * SIM_NS_PER_MS;
+  uint64_t elapsed = transfer(&conn, 200U * 1460U);
+  TCPSocketStats stats = client_stats(&conn);
+  fprintf(stderr, "blackout 5 s outage: done in %.1f ms, %zu frames lost\n", (double)elapsed / 1e6,
+          loss.dropped);
+  print_stats("client", &stats);
+  /* 200 + 400 + 800 + 1600 + 3200 ms of backoff spans the outage. */
+  if (stats.timeouts < 4U || stats.timeouts > 6U || elapsed < 5000U * SIM_NS_PER_MS) {
+    fail("blackout backoff");
+  }
+  close_conn(&conn);
+}
+
+/* Bulk transfer through a 10 Mbit/s bottleneck with a short FIFO: NewReno fills the pipe. */
+static void bench_bottleneck(void) {
+  uint64_t rate_bps = 10000000U;
+  Conn conn = open_conn(rate_bps, 2U, 1500U, 4U);
+  size_t total = 4U * 1024U * 1024U;
+  uint64_t elapsed = transfer(&conn, total);
+  TCPSocketStats stats = client_stats(&conn);
+  LinkStats link_stats = {0};
+  (void)link_get_stats(conn.link, node_get_interface(conn.client, 1U), &link_stats);
+  double goodput = (double)total * 8.0 / ((double)elapsed / 1e9);
+  fprintf(stderr,
+          "bottle   4 MiB over 10 Mbit/s, 2 ms, fifo/4: %.2f Mbit/s goodput (%.0f%% of link), "
+          "%llu queue drops\n",
+          goodput / 1e6, goodput * 100.0 / (double)rate_bps,
+          (unsigned long long)link_stats.drops);
+  print_stats("client", &stats);
+  if (link_stats.drops == 0U || stats.fast_retransmits == 0U ||
+      goodput < 0.8 * (double)rate_bps) {
+    fail("bottleneck goodput");
+  }
+  close_conn(&conn);
+}
+
+int main(void) {
+  printf("--- TCP congestion control benchmark ---\n");
+  if (freopen("/dev/null", "w", stdout) == NULL) {
+    return 1;
+  }
+
+  bench_segmentation();
+  bench_fast_retransmit();
+  bench_tail_loss();
+  bench_blackout();
+  bench_bottleneck();
+
+  fprintf(stderr, "RESULT: PASS\n");
+  return 0;
+}
+#endif
@@ -0,0 +1,217 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "core/node.h"
+#include "layer3/ipv4.h"
+#include "layer4/l4_host.h"
+#include "layer4/port_registry.h"
+#include "layer4/udp.h"
+#include "layer4/udp_socket.h"
+#include "layer7/magi_socket.h"
+#include "utils/hashmap.h"
+#include "utils/log.h"
+#include "utils/magi_error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_BOUND 1024U
+#define BENCH_LOOKUPS 20000000U
+#define BENCH_SOCKETS 256U
+#define BENCH_ROUNDS 4000U
+#define BENCH_PAYLOAD 32U
+#define BENCH_CHURN 2000000U
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t rng_next(void) {
+  rng_state ^= rng_state << 13U;
+  rng_state ^= rng_state >> 7U;
+  rng_state ^= rng_state << 17U;
+  return (uint32_t)(rng_state >> 16U);
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void fail(const char* what) {
+  fprintf(stderr, "RESULT: FAIL - %s\n", what);
+  exit(1);
+}
+
+/* Bound ports scattered over the whole 16-bit space, as servers and clients mix. */
+static uint16_t bound_port(uint32_t index) {
+  return (uint16_t)(1U + index * 61U);
+}
+
+/* Lookup cost: the radix registry against the old "udp:<port>" string key in a HashMap. */
+static void bench_lookup(void) {
+  PortRegistry* reg = port_registry_new();
+  HashMap* strings = hashmap_new(16U);
+  static int sockets[BENCH_BOUND];
+  for (uint32_t index = 0U; index < BENCH_BOUND; ++index) {
+    char key[16];
+    snprintf(key, sizeof(key), "udp:%u", (unsigned)bound_port(index));
+    if (port_registry_bind(reg, PORT_PROTOCOL_UDP, bound_port(index), &sockets[index]) !=
+            MAGI_OK ||
+        hashmap_set(strings, key, &sockets[index]) != MAGI_OK) {
+      fail("lookup setup");
+    }
+  }
+
+  /* Half the probes hit a bound port, half miss, in a pattern the branch predictor cannot learn. */
+  uint16_t* probes = malloc(BENCH_LOOKUPS * sizeof(*probes));
+  if (probes == NULL) {
+    fail("alloc");
+  }
+  for (uint32_t index = 0U; index < BENCH_LOOKUPS; ++index) {
+    uint32_t roll = rng_next();
+    probes[index] = (roll & 1U) != 0U ? bound_port((roll >> 1U) % BENCH_BOUND) : (uint16_t)roll;
+  }
+
+  size_t radix_hits = 0U;
+  double start = now_sec();
+  for (uint32_t index = 0U; index < BENCH_LOOKUPS; ++index) {
+    radix_hits += port_registry_lookup(reg, PORT_PROTOCOL_UDP, probes[index]) != NULL ? 1U : 0U;
+  }
+  double radix_ns = (now_sec() - start) * 1e9 / BENCH_LOOKUPS;
+
+  size_t string_hits = 0U;
+  start = now_sec();
+  for (uint32_t index = 0U; index < BENCH_LOOKUPS; ++index) {
+    char key[16];
+    snprintf(key, sizeof(key), "udp:%u", (unsigned)probes[index]);
+    string_hits += hashmap_get(strings, key) != NULL ? 1U : 0U;
+  }
+  double string_ns = (now_sec() - start) * 1e9 / BENCH_LOOKUPS;
+
+  if (radix_hits != string_hits || radix_hits < BENCH_LOOKUPS / 2U) {
+    fail("registries disagree");
+  }
+  fprintf(stderr, "lookup     radix %5.2f ns, string key + hashmap %6.2f ns (%.1fx)\n", radix_ns,
+          string_ns, string_ns / radix_ns);
+  free(probes);
+  hashmap_free(strings);
+  port_registry_free(reg);
+}
+
+/* Full receive path: node->handle_l4_packet through checksum, registry and socket buffer. */
+static void bench_dispatch(void) {
+  Node* node = node_new("UdpSink");
+  if (node == NULL || l4_host_attach(node) != MAGI_OK) {
+    fail("node setup");
+  }
+  /* One LOG line per datagram would dominate the measurement. */
+  magi_log_set_level(MAGI_LOG_L4, MAGI_LOG_WARN);
+
+  static const uint8_t src_ip[4] = {10U, 0U, 0U, 1U};
+  static const uint8_t dst_ip[4] = {10U, 0U, 0U, 2U};
+  static uint8_t packets[BENCH_SOCKETS][UDP_HEADER_LEN + BENCH_PAYLOAD];
+  uint8_t payload[BENCH_PAYLOAD];
+  memset(payload, 0xA5, sizeof(payload));
+  MagiSocket* sockets[BENCH_SOCKETS];
+  for (uint32_t index = 0U; index < BENCH_SOCKETS; ++index) {
+    sockets[index] = magi_socket(node, MAGI_AF_INET, MAGI_SOCK_DGRAM);
+    UDPDatagram dgram = {.src_port = 5000U,
+                         .dst_port = bound_port(index),
+                         .payload = payload,
+                         .payload_len = sizeof(payload)};
+    if (sockets[index] == NULL ||
+        magi_bind(sockets[index], "10.0.0.2", bound_port(index)) != MAGI_OK ||
+        udp_pack(&dgram, src_ip, dst_ip, packets[index], sizeof(packets[index])) != MAGI_OK) {
+      fail("socket setup");
+    }
+  }
+
+  uint8_t drain[BENCH_PAYLOAD * 4U];
+  uint64_t received = 0U;
+  double start = now_sec();
+  for (uint32_t round = 0U; round < BENCH_ROUNDS; ++round) {
+    for (uint32_t index = 0U; index < BENCH_SOCKETS; ++index) {
+      node->handle_l4_packet(node, src_ip, dst_ip, IPV4_PROTOCOL_UDP, packets[index],
+                             sizeof(packets[index]));
+    }
+    for (uint32_t index = 0U; index < BENCH_SOCKETS; ++index) {
+      received += udp_socket_read((UDPSocketState*)sockets[index]->transport, drain, sizeof(drain));
+    }
+  }
+  double elapsed = now_sec() - start;
+  magi_log_set_level(MAGI_LOG_L4, MAGI_LOG_INFO);
+
+  uint64_t datagrams = (uint64_t)BENCH_ROUNDS * BENCH_SOCKETS;
+  if (received != datagrams * BENCH_PAYLOAD) {
+    fail("datagrams lost in dispatch");
+  }
+  fprintf(stderr, "dispatch   %u sockets, %llu datagrams of %u B: %.0f/s (%.0f ns each)\n",
+          BENCH_SOCKETS, (unsigned long long)datagrams, BENCH_PAYLOAD, (double)datagrams / elapsed,
+          elapsed * 1e9 / (double)datagrams);
+
+  for (uint32_t index = 0U; index < BENCH_SOCKETS; ++index) {
+    magi_close(sockets[index]);
+  }
+  node_free(node);
+}
+
+/* Allocator cost when the ephemeral range is 90% taken and ports come and go at random. */
+static void bench_ephemeral(void) {
+  PortRegistry* reg = port_registry_new();
+  static int owner;
+  uint32_t range = PORT_EPHEMERAL_MAX - PORT_EPHEMERAL_MIN + 1U;
+  uint32_t live_count = range * 9U / 10U;
+  uint16_t* live = malloc(live_count * sizeof(*live));
+  if (live == NULL) {
+    fail("alloc");
+  }
+
+  double start = now_sec();
+  for (uint32_t index = 0U; index < live_count; ++index) {
+    if (port_registry_bind_ephemeral(reg, PORT_PROTOCOL_TCP, &owner, &live[index]) != MAGI_OK) {
+      fail("fill");
+    }
+  }
+  double fill_ns = (now_sec() - start) * 1e9 / live_count;
+
+  start = now_sec();
+  for (uint32_t index = 0U; index < BENCH_CHURN; ++index) {
+    uint32_t slot = rng_next() % live_count;
+    if (port_registry_unbind(reg, PORT_PROTOCOL_TCP, live[slot]) != MAGI_OK ||
+        port_registry_bind_ephemeral(reg, PORT_PROTOCOL_TCP, &owner, &live[slot]) != MAGI_OK) {
+      fail("churn");
+    }
+  }
+  double churn_ns = (now_sec() - start) * 1e9 / BENCH_CHURN;
+
+  /* Exhaust the range, then make sure the allocator says so instead of colliding. */
+  uint16_t port = 0U;
+  uint32_t extra = 0U;
+  while (port_registry_bind_ephemeral(reg, PORT_PROTOCOL_TCP, &owner, &port) == MAGI_OK) {
+    ++extra;
+  }
+  if (live_count + extra != range) {
+    fail("ephemeral range accounting");
+  }
+  fprintf(stderr, "ephemeral  fill %5.1f ns/port, churn at 90%% full %5.1f ns/unbind+bind\n",
+          fill_ns, churn_ns);
+  free(live);
+  port_registry_free(reg);
+}
+
+int main(void) {
+  printf("--- UDP dispatch benchmark ---\n");
+  /* Per-socket LOG lines go to stdout; keep them out of the timing. */
+  if (freopen("/dev/null", "w", stdout) == NULL) {
+    return 1;
+  }
+
+  bench_lookup();
+  bench_dispatch();
+  bench_ephemeral();
+  fprintf(stderr, "RESULT: PASS\n");
+  return 0;
+}
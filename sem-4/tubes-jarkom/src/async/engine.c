@@ -14,22 +14,72 @@ int engine_init(struct Topology* topology) {
 void engine_shutdown(void) {
 }
 
+void engine_set_backpressure(bool enabled) {
+  (void)enabled;
+}
+
+void engine_set_worker_count(size_t count) {
+  (void)count;
+}
+
+size_t engine_thread_count(void) {
+  return 0U;
+}
+
 #else
 
 #include "async/queue.h"
 #include "core/interface.h"
 #include "core/link.h"
 #include "core/node.h"
+#include "core/sim.h"
 #include "topology/topology.h"
 
-#include <errno.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #define ENGINE_RIP_INTERVAL_SEC 30L
+/** Messages drained from a node queue per scheduling turn. */
+#define ENGINE_BATCH 32U
+/** How deep a worker blocked on a full queue may nest other nodes' turns. */
+#define ENGINE_HELP_DEPTH 8U
+#define ENGINE_NS_PER_SEC 1000000000ULL
+
+/**
+ * @brief One pool worker and its deque of runnable nodes.
+ *
+ * The owner takes from the front so nodes get turns in arrival order;
+ * thieves take from the back. Every node is in at most one deque, so a
+ * capacity equal to the node count never overflows.
+ */
+typedef struct EngineWorker {
+  pthread_t thread;
+  size_t index;
+  pthread_mutex_t lock;
+  Node** tasks;
+  size_t capacity;
+  size_t head;
+  size_t count;
+} EngineWorker;
+
+/**
+ * @brief A frame waiting out link latency before it enters the receiver's queue.
+ */
+typedef struct EngineDeferred {
+  /** Delivery time on the sim_now_ns() clock. */
+  uint64_t due_ns;
+  /** Insertion order; keeps frames due at the same time in send order. */
+  uint64_t seq;
+  /** Receiving node. */
+  Node* node;
+  /** Message to push when due. */
+  MagiMsg msg;
+} EngineDeferred;
 
 typedef struct EngineState {
   Topology* topology;
@@ -37,8 +87,27 @@ typedef struct EngineState {
   bool stopping;
   pthread_t timer_thread;
   bool timer_started;
+  bool backpressure;
+  size_t requested_workers;
+  EngineWorker* workers;
+  size_t worker_count;
+  size_t workers_started;
+  /** Set once at shutdown; workers stop even if nodes keep each other busy. */
+  atomic_bool pool_stopping;
+  /** Nodes sitting in some deque; idle workers sleep only while this is 0. */
+  atomic_size_t pending;
+  atomic_uint idle_workers;
+  atomic_size_t next_worker;
+  pthread_mutex_t idle_lock;
+  pthread_cond_t work_cond;
   pthread_mutex_t lock;
+  /** Wakes the timer thread at shutdown or when an earlier deferral arrives. */
   pthread_cond_t stop_cond;
+  /** Min-heap of frames in flight, ordered by (due_ns, seq); guarded by lock. */
+  EngineDeferred* deferred;
+  size_t deferred_count;
+  size_t deferred_capacity;
+  uint64_t deferred_seq;
 } EngineState;
 
 static EngineState engine_state = {
@@ -47,10 +116,26 @@ static EngineState engine_state = {
     .stopping = false,
     .timer_thread = 0,
     .timer_started = false,
+    .backpressure = false,
+    .requested_workers = 0U,
+    .workers = NULL,
+    .worker_count = 0U,
+    .workers_started = 0U,
+    .idle_lock = PTHREAD_MUTEX_INITIALIZER,
+    .work_cond = PTHREAD_COND_INITIALIZER,
     .lock = PTHREAD_MUTEX_INITIALIZER,
     .stop_cond = PTHREAD_COND_INITIALIZER,
+    .deferred = NULL,
+    .deferred_count = 0U,
+    .deferred_capacity = 0U,
+    .deferred_seq = 0U,
 };
 
+/** Worker owning the calling thread, or NULL outside the pool. */
+static _Thread_local EngineWorker* current_worker = NULL;
+/** Nesting depth of engine_help() on the calling worker. */
+static _Thread_local size_t help_depth = 0U;
+
 static Interface* message_receiver(Node* node, const MagiMsg* msg) {
   if (node == NULL || msg == NULL || msg->src_iface == NULL || msg->src_iface->link == NULL) {
     return NULL;
@@ -67,33 +152,303 @@ static Interface* message_receiver(Node* node, const MagiMsg* msg) {
   return receiver != NULL && receiver->node == node ? receiver : NULL;
 }
 
-static void* node_worker(void* ctx) {
-  Node* node = (Node*)ctx;
-  if (node == NULL || node->queue == NULL) {
-    return NULL;
+/**
+ * @brief Wake one sleeping worker, if any, after a task was queued.
+ */
+static void engine_wake_idle(void) {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit(&engine_state.idle_workers, memory_order_relaxed) == 0U) {
+    return;
   }
 
-  for (;;) {
-    MagiMsg msg = {0};
-    if (queue_pop(node->queue, &msg) != MAGI_OK) {
+  pthread_mutex_lock(&engine_state.idle_lock);
+  pthread_cond_signal(&engine_state.work_cond);
+  pthread_mutex_unlock(&engine_state.idle_lock);
+}
+
+/**
+ * @brief Queue notify hook: make a node runnable unless it already is.
+ *
+ * Runs on whichever thread pushed into the node's queue. Pool workers
+ * schedule onto their own deque; outside threads spread round-robin.
+ *
+ * @param ctx Node whose queue received a message.
+ */
+static void engine_schedule(void* ctx) {
+  Node* node = ctx;
+  if (atomic_load_explicit(&node->async_scheduled, memory_order_relaxed) ||
+      atomic_exchange_explicit(&node->async_scheduled, true, memory_order_acq_rel)) {
+    return;
+  }
+
+  EngineWorker* worker = current_worker;
+  if (worker == NULL) {
+    size_t next = atomic_fetch_add_explicit(&engine_state.next_worker, 1U, memory_order_relaxed);
+    worker = &engine_state.workers[next % engine_state.worker_count];
+  }
+
+  pthread_mutex_lock(&worker->lock);
+  worker->tasks[(worker->head + worker->count) % worker->capacity] = node;
+  worker->count++;
+  pthread_mutex_unlock(&worker->lock);
+
+  atomic_fetch_add_explicit(&engine_state.pending, 1U, memory_order_relaxed);
+  engine_wake_idle();
+}
+
+/**
+ * @brief Take a runnable node: own deque first, then steal from the others.
+ *
+ * @param self Calling worker.
+ * @return Node to run, or NULL if every deque was empty.
+ */
+static Node* engine_take_task(EngineWorker* self) {
+  Node* node = NULL;
+  pthread_mutex_lock(&self->lock);
+  if (self->count > 0U) {
+    node = self->tasks[self->head];
+    self->head = (self->head + 1U) % self->capacity;
+    self->count--;
+  }
+  pthread_mutex_unlock(&self->lock);
+
+  size_t workers = engine_state.worker_count;
+  for (size_t offset = 1U; node == NULL && offset < workers; ++offset) {
+    EngineWorker* victim = &engine_state.workers[(self->index + offset) % workers];
+    pthread_mutex_lock(&victim->lock);
+    if (victim->count > 0U) {
+      victim->count--;
+      node = victim->tasks[(victim->head + victim->count) % victim->capacity];
+    }
+    pthread_mutex_unlock(&victim->lock);
+  }
+
+  if (node != NULL) {
+    atomic_fetch_sub_explicit(&engine_state.pending, 1U, memory_order_relaxed);
+  }
+  return node;
+}
+
+/**
+ * @brief Give a node one turn: deliver up to ENGINE_BATCH frames under its lock.
+ *
+ * The frames go to the node as one burst, so switches and routers run
+ * each stage of their pipeline over all of them. The scheduled flag is
+ * cleared before the final emptiness check, so a producer racing with the
+ * end of the turn either sees the flag clear and reschedules, or its
+ * message is seen here.
+ *
+ * @param node Node to run; must have been taken from a deque.
+ */
+static void engine_run_node(Node* node) {
+  MagiMsg batch[ENGINE_BATCH];
+  size_t count = queue_try_pop_batch(node->queue, batch, ENGINE_BATCH);
+
+  if (count > 0U) {
+    RxFrame frames[ENGINE_BATCH];
+    size_t owner[ENGINE_BATCH];
+    size_t burst = 0U;
+    pthread_mutex_lock(&node->lock);
+    for (size_t index = 0U; index < count; ++index) {
+      Interface* receiver = message_receiver(node, &batch[index]);
+      if (receiver != NULL) {
+        frames[burst] = (RxFrame){.iface = receiver,
+                                  .data = batch[index].data,
+                                  .len = batch[index].len,
+                                  .pkt = batch[index].pkt};
+        owner[burst++] = index;
+      }
+    }
+    interface_receive_batch(frames, burst);
+    pthread_mutex_unlock(&node->lock);
+
+    for (size_t index = 0U; index < burst; ++index) {
+      MagiMsg* msg = &batch[owner[index]];
+      if (msg->pkt != NULL && frames[index].pkt == NULL) {
+        msg->data = NULL;
+        msg->pkt = NULL;
+      }
+    }
+
+    for (size_t index = 0U; index < count; ++index) {
+      queue_msg_release(&batch[index]);
+    }
+  }
+
+  atomic_store_explicit(&node->async_scheduled, false, memory_order_seq_cst);
+  atomic_thread_fence(memory_order_seq_cst);
+  if (queue_has_pending(node->queue)) {
+    engine_schedule(node);
+  }
+}
+
+/**
+ * @brief Queue wait helper: run another node's turn instead of sleeping.
+ *
+ * @return true if a node was run, false outside the pool or with nothing to run.
+ */
+static bool engine_help(void) {
+  EngineWorker* self = current_worker;
+  if (self == NULL || help_depth >= ENGINE_HELP_DEPTH) {
+    return false;
+  }
+
+  Node* node = engine_take_task(self);
+  if (node == NULL) {
+    return false;
+  }
+
+  help_depth++;
+  engine_run_node(node);
+  help_depth--;
+  return true;
+}
+
+static void* pool_worker(void* ctx) {
+  EngineWorker* self = ctx;
+  current_worker = self;
+
+  while (!atomic_load_explicit(&engine_state.pool_stopping, memory_order_relaxed)) {
+    Node* node = engine_take_task(self);
+    if (node != NULL) {
+      engine_run_node(node);
       continue;
     }
 
-    if (msg.data == NULL) {
+    pthread_mutex_lock(&engine_state.idle_lock);
+    atomic_fetch_add_explicit(&engine_state.idle_workers, 1U, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    while (!atomic_load_explicit(&engine_state.pool_stopping, memory_order_relaxed) &&
+           atomic_load_explicit(&engine_state.pending, memory_order_relaxed) == 0U) {
+      pthread_cond_wait(&engine_state.work_cond, &engine_state.idle_lock);
+    }
+    atomic_fetch_sub_explicit(&engine_state.idle_workers, 1U, memory_order_relaxed);
+    pthread_mutex_unlock(&engine_state.idle_lock);
+  }
+
+  current_worker = NULL;
+  return NULL;
+}
+
+/**
+ * @brief Push a message into a node's queue, counting and releasing it on a drop.
+ */
+static int engine_deliver(Node* node, MagiMsg msg) {
+  int status = queue_push(node->queue, msg);
+  if (status != MAGI_OK) {
+    node_count(node, MAGI_NODE_DROP_QUEUE_FULL);
+    queue_msg_release(&msg);
+    magi_errno = status;
+  }
+  return status;
+}
+
+static bool deferred_before(const EngineDeferred* left, const EngineDeferred* right) {
+  return left->due_ns != right->due_ns ? left->due_ns < right->due_ns : left->seq < right->seq;
+}
+
+/**
+ * @brief Add an entry to the deferred heap. Caller holds engine_state.lock.
+ *
+ * @return MAGI_OK, or MAGI_ERR_NOMEM if the heap could not grow.
+ */
+static int deferred_push(EngineDeferred entry) {
+  if (engine_state.deferred_count == engine_state.deferred_capacity) {
+    size_t capacity = engine_state.deferred_capacity == 0U ? 64U
+                                                           : engine_state.deferred_capacity * 2U;
+    EngineDeferred* grown = realloc(engine_state.deferred, capacity * sizeof(*grown));
+    if (grown == NULL) {
+      return MAGI_ERR_NOMEM;
+    }
+    engine_state.deferred = grown;
+    engine_state.deferred_capacity = capacity;
+  }
+
+  EngineDeferred* heap = engine_state.deferred;
+  size_t index = engine_state.deferred_count++;
+  while (index > 0U) {
+    size_t parent = (index - 1U) / 2U;
+    if (!deferred_before(&entry, &heap[parent])) {
       break;
     }
+    heap[index] = heap[parent];
+    index = parent;
+  }
+  heap[index] = entry;
+  return MAGI_OK;
+}
 
-    Interface* receiver = message_receiver(node, &msg);
-    if (receiver != NULL && receiver->receive_up != NULL) {
-      pthread_mutex_lock(&node->lock);
-      receiver->receive_up(receiver, msg.data, msg.len);
-      pthread_mutex_unlock(&node->lock);
+/**
+ * @brief Remove the earliest entry from the deferred heap. Caller holds engine_state.lock.
+ */
+static EngineDeferred deferred_pop(void) {
+  EngineDeferred* heap = engine_state.deferred;
+  EngineDeferred top = heap[0];
+  EngineDeferred last = heap[--engine_state.deferred_count];
+  size_t count = engine_state.deferred_count;
+  size_t index = 0U;
+  for (;;) {
+    size_t child = index * 2U + 1U;
+    if (child >= count) {
+      break;
+    }
+    if (child + 1U < count && deferred_before(&heap[child + 1U], &heap[child])) {
+      child++;
     }
+    if (!deferred_before(&heap[child], &last)) {
+      break;
+    }
+    heap[index] = heap[child];
+    index = child;
+  }
+  if (count > 0U) {
+    heap[index] = last;
+  }
+  return top;
+}
+
+int engine_push_at(Node* node, MagiMsg msg, uint64_t due_ns) {
+  if (node == NULL || node->queue == NULL) {
+    queue_msg_release(&msg);
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  pthread_mutex_lock(&engine_state.lock);
+  if (!engine_state.running || engine_state.stopping || due_ns <= sim_now_ns()) {
+    pthread_mutex_unlock(&engine_state.lock);
+    return engine_deliver(node, msg);
+  }
 
-    free(msg.data);
+  EngineDeferred entry = {
+      .due_ns = due_ns, .seq = engine_state.deferred_seq++, .node = node, .msg = msg};
+  int status = deferred_push(entry);
+  if (status == MAGI_OK && engine_state.deferred[0].seq == entry.seq) {
+    pthread_cond_signal(&engine_state.stop_cond);
   }
+  pthread_mutex_unlock(&engine_state.lock);
 
-  return NULL;
+  if (status != MAGI_OK) {
+    node_count(node, MAGI_NODE_DROP_QUEUE_FULL);
+    queue_msg_release(&msg);
+    magi_errno = status;
+  }
+  return status;
+}
+
+/**
+ * @brief Drop every deferred frame; used once the timer thread has stopped.
+ */
+static void deferred_clear(void) {
+  pthread_mutex_lock(&engine_state.lock);
+  for (size_t index = 0U; index < engine_state.deferred_count; ++index) {
+    queue_msg_release(&engine_state.deferred[index].msg);
+  }
+  free(engine_state.deferred);
+  engine_state.deferred = NULL;
+  engine_state.deferred_count = 0U;
+  engine_state.deferred_capacity = 0U;
+  pthread_mutex_unlock(&engine_state.lock);
 }
 
 static void run_periodic_ticks(Topology* topology) {
@@ -119,67 +474,77 @@ static void run_periodic_ticks(Topology* topology) {
   }
 }
 
+/**
+ * @brief Timer thread: releases deferred frames when due and runs the 30 s ticks.
+ *
+ * Due frames are pushed outside the lock, so link_send() callers never wait
+ * behind a full receiver queue.
+ */
 static void* timer_worker(void* ctx) {
   Topology* topology = (Topology*)ctx;
+  uint64_t tick_ns = sim_now_ns() + (uint64_t)ENGINE_RIP_INTERVAL_SEC * ENGINE_NS_PER_SEC;
 
-  for (;;) {
-    struct timespec deadline;
-    if (clock_gettime(CLOCK_REALTIME, &deadline) != 0) {
-      return NULL;
-    }
-    deadline.tv_sec += ENGINE_RIP_INTERVAL_SEC;
-
-    pthread_mutex_lock(&engine_state.lock);
-    while (!engine_state.stopping) {
-      int wait_status = pthread_cond_timedwait(&engine_state.stop_cond, &engine_state.lock,
-                                               &deadline);
-      if (wait_status == ETIMEDOUT) {
-        break;
+  pthread_mutex_lock(&engine_state.lock);
+  while (!engine_state.stopping) {
+    uint64_t now = sim_now_ns();
+    if (engine_state.deferred_count > 0U && engine_state.deferred[0].due_ns <= now) {
+      EngineDeferred due[ENGINE_BATCH];
+      size_t count = 0U;
+      while (count < ENGINE_BATCH && engine_state.deferred_count > 0U &&
+             engine_state.deferred[0].due_ns <= now) {
+        due[count++] = deferred_pop();
       }
+      pthread_mutex_unlock(&engine_state.lock);
+      for (size_t index = 0U; index < count; ++index) {
+        (void)engine_deliver(due[index].node, due[index].msg);
+      }
+      pthread_mutex_lock(&engine_state.lock);
+      continue;
     }
-    bool stopping = engine_state.stopping;
-    pthread_mutex_unlock(&engine_state.lock);
 
-    if (stopping) {
-      break;
+    if (now >= tick_ns) {
+      pthread_mutex_unlock(&engine_state.lock);
+      run_periodic_ticks(topology);
+      tick_ns = sim_now_ns() + (uint64_t)ENGINE_RIP_INTERVAL_SEC * ENGINE_NS_PER_SEC;
+      pthread_mutex_lock(&engine_state.lock);
+      continue;
     }
 
-    run_periodic_ticks(topology);
+    uint64_t wake_ns = tick_ns;
+    if (engine_state.deferred_count > 0U && engine_state.deferred[0].due_ns < wake_ns) {
+      wake_ns = engine_state.deferred[0].due_ns;
+    }
+    struct timespec deadline;
+    if (clock_gettime(CLOCK_REALTIME, &deadline) != 0) {
+      break;
+    }
+    uint64_t wait_ns = wake_ns - now + (uint64_t)deadline.tv_nsec;
+    deadline.tv_sec += (time_t)(wait_ns / ENGINE_NS_PER_SEC);
+    deadline.tv_nsec = (long)(wait_ns % ENGINE_NS_PER_SEC);
+    (void)pthread_cond_timedwait(&engine_state.stop_cond, &engine_state.lock, &deadline);
   }
+  pthread_mutex_unlock(&engine_state.lock);
 
   return NULL;
 }
 
-static int start_node_worker(Node* node) {
-  if (node == NULL || node->queue == NULL || node->async_worker_started) {
-    return MAGI_OK;
-  }
-
-  if (pthread_create(&node->thread, NULL, node_worker, node) != 0) {
-    magi_errno = MAGI_ERR_NOMEM;
-    return MAGI_ERR_NOMEM;
-  }
-
-  node->async_worker_started = true;
-  return MAGI_OK;
-}
-
-static void enqueue_stop(Node* node) {
-  if (node == NULL || node->queue == NULL || !node->async_worker_started) {
+static void attach_node(Node* node) {
+  if (node == NULL || node->queue == NULL) {
     return;
   }
 
-  MagiMsg sentinel = {0};
-  (void)queue_push_blocking(node->queue, sentinel);
+  atomic_store(&node->async_scheduled, false);
+  queue_set_backpressure(node->queue, engine_state.backpressure);
+  queue_set_notify(node->queue, engine_schedule, node);
 }
 
-static void join_node_worker(Node* node) {
-  if (node == NULL || !node->async_worker_started) {
+static void detach_node(Node* node) {
+  if (node == NULL || node->queue == NULL) {
     return;
   }
 
-  pthread_join(node->thread, NULL);
-  node->async_worker_started = false;
+  queue_set_notify(node->queue, NULL, NULL);
+  atomic_store(&node->async_scheduled, false);
 }
 
 static void foreach_node(Topology* topology, void (*fn)(Node* node)) {
@@ -200,6 +565,47 @@ static void foreach_node(Topology* topology, void (*fn)(Node* node)) {
   }
 }
 
+/**
+ * @brief Allocate the worker array and one deque per worker.
+ *
+ * @param count Number of workers.
+ * @param capacity Deque capacity, at least the number of schedulable nodes.
+ * @return MAGI_OK on success, or MAGI_ERR_NOMEM.
+ */
+static int create_workers(size_t count, size_t capacity) {
+  engine_state.workers = calloc(count, sizeof(*engine_state.workers));
+  if (engine_state.workers == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
+  }
+
+  engine_state.worker_count = count;
+  for (size_t index = 0U; index < count; ++index) {
+    EngineWorker* worker = &engine_state.workers[index];
+    worker->index = index;
+    worker->capacity = capacity;
+    worker->tasks = calloc(capacity, sizeof(*worker->tasks));
+    if (worker->tasks == NULL || pthread_mutex_init(&worker->lock, NULL) != 0) {
+      free(worker->tasks);
+      engine_state.worker_count = index;
+      magi_errno = MAGI_ERR_NOMEM;
+      return MAGI_ERR_NOMEM;
+    }
+  }
+
+  return MAGI_OK;
+}
+
+static void destroy_workers(void) {
+  for (size_t index = 0U; index < engine_state.worker_count; ++index) {
+    pthread_mutex_destroy(&engine_state.workers[index].lock);
+    free(engine_state.workers[index].tasks);
+  }
+  free(engine_state.workers);
+  engine_state.workers = NULL;
+  engine_state.worker_count = 0U;
+}
+
 int engine_init(Topology* topology) {
   if (topology == NULL) {
     magi_errno = MAGI_ERR_BADARGS;
@@ -217,20 +623,33 @@ int engine_init(Topology* topology) {
   engine_state.running = true;
   pthread_mutex_unlock(&engine_state.lock);
 
-  if (topology->nodes != NULL) {
-    for (size_t index = 0U; index < topology->nodes->capacity; ++index) {
-      HashEntry* entry = &topology->nodes->entries[index];
-      if (entry->key == NULL || entry->tombstone) {
-        continue;
-      }
-
-      TopologyNodeInfo* info = (TopologyNodeInfo*)entry->value;
-      int status = start_node_worker(info != NULL ? info->node : NULL);
-      if (status != MAGI_OK) {
-        engine_shutdown();
-        return status;
-      }
+  size_t count = engine_state.requested_workers;
+  if (count == 0U) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    count = online > 0L ? (size_t)online : 1U;
+  }
+  size_t capacity = topology->nodes != NULL ? topology->nodes->count + 1U : 1U;
+
+  atomic_store(&engine_state.pool_stopping, false);
+  atomic_store(&engine_state.pending, 0U);
+  atomic_store(&engine_state.idle_workers, 0U);
+  atomic_store(&engine_state.next_worker, 0U);
+  int status = create_workers(count, capacity);
+  if (status != MAGI_OK) {
+    engine_shutdown();
+    return status;
+  }
+  foreach_node(topology, attach_node);
+  queue_set_wait_helper(engine_help);
+
+  for (size_t index = 0U; index < count; ++index) {
+    EngineWorker* worker = &engine_state.workers[index];
+    if (pthread_create(&worker->thread, NULL, pool_worker, worker) != 0) {
+      engine_shutdown();
+      magi_errno = MAGI_ERR_NOMEM;
+      return MAGI_ERR_NOMEM;
     }
+    engine_state.workers_started++;
   }
 
   if (pthread_create(&engine_state.timer_thread, NULL, timer_worker, topology) != 0) {
@@ -243,6 +662,27 @@ int engine_init(Topology* topology) {
   return MAGI_OK;
 }
 
+void engine_set_backpressure(bool enabled) {
+  pthread_mutex_lock(&engine_state.lock);
+  engine_state.backpressure = enabled;
+  pthread_mutex_unlock(&engine_state.lock);
+}
+
+void engine_set_worker_count(size_t count) {
+  pthread_mutex_lock(&engine_state.lock);
+  engine_state.requested_workers = count;
+  pthread_mutex_unlock(&engine_state.lock);
+}
+
+size_t engine_thread_count(void) {
+  pthread_mutex_lock(&engine_state.lock);
+  size_t count = engine_state.running
+                     ? engine_state.workers_started + (engine_state.timer_started ? 1U : 0U)
+                     : 0U;
+  pthread_mutex_unlock(&engine_state.lock);
+  return count;
+}
+
 void engine_shutdown(void) {
   pthread_mutex_lock(&engine_state.lock);
   if (!engine_state.running) {
@@ -255,13 +695,25 @@ void engine_shutdown(void) {
   pthread_cond_broadcast(&engine_state.stop_cond);
   pthread_mutex_unlock(&engine_state.lock);
 
-  foreach_node(topology, enqueue_stop);
-  foreach_node(topology, join_node_worker);
+  pthread_mutex_lock(&engine_state.idle_lock);
+  atomic_store(&engine_state.pool_stopping, true);
+  pthread_cond_broadcast(&engine_state.work_cond);
+  pthread_mutex_unlock(&engine_state.idle_lock);
+
+  for (size_t index = 0U; index < engine_state.workers_started; ++index) {
+    pthread_join(engine_state.workers[index].thread, NULL);
+  }
+  engine_state.workers_started = 0U;
 
   if (engine_state.timer_started) {
     pthread_join(engine_state.timer_thread, NULL);
     engine_state.timer_started = false;
   }
+  deferred_clear();
+
+  queue_set_wait_helper(NULL);
+  foreach_node(topology, detach_node);
+  destroy_workers();
 
   pthread_mutex_lock(&engine_state.lock);
   engine_state.topology = NULL;
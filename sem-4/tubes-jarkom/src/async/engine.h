@@ -1,29 +1,88 @@
 /**
  * @file engine.h
  * @brief Async packet delivery engine.
+ *
+ * Nodes are not given threads of their own. A fixed pool of workers, one
+ * per CPU by default, runs nodes as tasks: a push into an idle node's queue
+ * schedules the node on a worker's deque, and a worker with an empty deque
+ * steals from the others. A node is only ever run by one worker at a time,
+ * under node->lock, so handlers see the same serialization as before.
  */
 
 #ifndef MAGI_ASYNC_ENGINE_H
 #define MAGI_ASYNC_ENGINE_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef MAGI_ASYNC
+#include "async/queue.h"
+#endif
+
+struct Node;
 struct Topology;
 
 /**
- * @brief Start async workers for all nodes in a topology.
+ * @brief Start the worker pool and timer thread for a topology.
  *
  * In sequential builds this is a no-op so top-level code can call it
  * unconditionally.
  *
- * @param topology Topology whose nodes should receive worker threads.
+ * @param topology Topology whose nodes should be scheduled on the pool.
  * @return MAGI_OK on success, otherwise an error code.
  */
 int engine_init(struct Topology* topology);
 
 /**
- * @brief Stop all running async workers and timer threads.
+ * @brief Stop the worker pool and timer thread.
  *
- * In sequential builds this is a no-op.
+ * Messages still queued at shutdown stay in their node queues and are
+ * released when the nodes are freed. Frames still waiting out link latency
+ * are dropped. In sequential builds this is a no-op.
  */
 void engine_shutdown(void);
 
+#ifdef MAGI_ASYNC
+/**
+ * @brief Push a message into a node's queue once the monotonic clock reaches due_ns.
+ *
+ * The timer thread holds the message until it is due, so the sender's
+ * worker goes straight back to the pool instead of sleeping out the link
+ * latency. Messages already due, or sent while the engine is not running,
+ * are pushed at once.
+ *
+ * @param node Receiving node; must have a queue.
+ * @param msg Message to deliver. Its payload is always consumed.
+ * @param due_ns Delivery time on the sim_now_ns() clock.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int engine_push_at(struct Node* node, MagiMsg msg, uint64_t due_ns);
+#endif
+
+/**
+ * @brief Choose whether a full node queue blocks the sender or drops the frame.
+ *
+ * Applies to later engine_init() calls. Dropping is the default. With
+ * back-pressure, a blocked pool worker runs other nodes while it waits.
+ * Two nodes flooding each other can still wait on each other forever.
+ *
+ * @param enabled true to block senders on a full queue.
+ */
+void engine_set_backpressure(bool enabled);
+
+/**
+ * @brief Set the worker pool size used by later engine_init() calls.
+ *
+ * @param count Number of workers, or 0 for one per online CPU.
+ */
+void engine_set_worker_count(size_t count);
+
+/**
+ * @brief Number of threads the running engine owns (workers plus timer).
+ *
+ * @return Thread count, or 0 when the engine is not running.
+ */
+size_t engine_thread_count(void);
+
 #endif
@@ -2,43 +2,178 @@
 
 #include "queue.h"
 
+#include "core/pktbuf.h"
 #include "utils/magi_error.h"
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+/** Process-wide helper for producers blocked on a full ring; see queue_set_wait_helper(). */
+static queue_wait_helper_fn queue_wait_helper = NULL;
+
+/**
+ * @brief Try to claim and fill one slot without blocking.
+ *
+ * Producers race on tail with a compare-and-swap; the winner owns the slot
+ * and publishes the message by storing seq = position + 1 with release
+ * ordering. A slot whose seq lags its position is still held by the
+ * consumer from the previous lap, which means the ring is full.
+ *
+ * @param q   Queue handle.
+ * @param msg Message to store.
+ * @return true if the message was enqueued, false if the ring is full.
+ */
+static bool queue_try_push(MagiQueue* q, const MagiMsg* msg) {
+  size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  for (;;) {
+    MagiQueueSlot* slot = &q->slots[pos & q->mask];
+    size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1U, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        slot->msg = *msg;
+        atomic_store_explicit(&slot->seq, pos + 1U, memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    }
+  }
+}
+
+/**
+ * @brief Check whether the slot at head holds a published message.
+ *
+ * @param q Queue handle.
+ * @return true if the consumer can pop without waiting.
+ */
+static bool queue_ready(const MagiQueue* q) {
+  size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+  const MagiQueueSlot* slot = &q->slots[head & q->mask];
+  return atomic_load_explicit(&slot->seq, memory_order_acquire) == head + 1U;
+}
 
 /**
- * @brief Allocate and initialize a thread-safe bounded queue.
+ * @brief Pop up to max published messages without blocking.
  *
- * Allocates a MagiQueue with a circular buffer of size (capacity + 1)
- * to distinguish full from empty. Initialises the mutex and condition
- * variable. If capacity is zero it is clamped to one.
+ * Each consumed slot is handed back to producers of the next lap by
+ * storing seq = position + capacity.
+ *
+ * @param q   Queue handle.
+ * @param out Destination array.
+ * @param max Maximum number of messages to pop.
+ * @return Number of messages popped.
+ */
+static size_t queue_take(MagiQueue* q, MagiMsg* out, size_t max) {
+  size_t count = 0U;
+  while (count < max && queue_ready(q)) {
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    MagiQueueSlot* slot = &q->slots[head & q->mask];
+    out[count++] = slot->msg;
+    atomic_store_explicit(&slot->seq, head + q->mask + 1U, memory_order_release);
+    atomic_store_explicit(&q->head, head + 1U, memory_order_relaxed);
+  }
+  return count;
+}
+
+/**
+ * @brief Wake the consumer if it went to sleep on an empty ring.
+ *
+ * Called after a successful push. The fence pairs with the one in
+ * queue_pop_batch(): either this producer sees consumer_waiting set, or
+ * the consumer's re-check sees the published slot. Only the producer that
+ * clears the flag signals, so a burst into an empty ring costs one wakeup.
+ * With a notify hook installed the hook decides instead; the fence gives it
+ * the same guarantee against the consumer's own re-check.
+ *
+ * @param q Queue handle.
+ */
+static void queue_wake_consumer(MagiQueue* q) {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (q->notify != NULL) {
+    q->notify(q->notify_ctx);
+    return;
+  }
+
+  if (atomic_load_explicit(&q->consumer_waiting, memory_order_relaxed) == 0U ||
+      atomic_exchange_explicit(&q->consumer_waiting, 0U, memory_order_relaxed) == 0U) {
+    return;
+  }
+
+  atomic_fetch_add_explicit(&q->wakeups, 1U, memory_order_relaxed);
+  pthread_mutex_lock(&q->lock);
+  pthread_cond_signal(&q->not_empty);
+  pthread_mutex_unlock(&q->lock);
+}
+
+/**
+ * @brief Wake producers blocked on a full ring after the consumer freed slots.
+ *
+ * @param q Queue handle.
+ */
+static void queue_wake_producers(MagiQueue* q) {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit(&q->producers_waiting, memory_order_relaxed) == 0U) {
+    return;
+  }
+
+  pthread_mutex_lock(&q->lock);
+  pthread_cond_broadcast(&q->not_full);
+  pthread_mutex_unlock(&q->lock);
+}
+
+/**
+ * @brief Allocate and initialize a lock-free MPSC queue.
+ *
+ * Rounds the capacity up to a power of two (minimum two), allocates the
+ * cache-line aligned control block and the slot ring, stamps every slot
+ * with its position, and initialises the slow-path mutex and condition
+ * variables.
  *
  * @param capacity Desired queue capacity.
  * @return Pointer to the new queue on success, or NULL with magi_errno
  *         set on allocation or initialisation failure.
  */
 MagiQueue* queue_new(size_t capacity) {
-  if (capacity == 0U) {
-    capacity = 1U;
+  size_t slots = 2U;
+  while (slots < capacity) {
+    slots *= 2U;
   }
 
-  MagiQueue* q = calloc(1U, sizeof(*q));
+  size_t size = (sizeof(MagiQueue) + 63U) & ~(size_t)63U;
+  MagiQueue* q = aligned_alloc(64U, size);
   if (q == NULL) {
     magi_errno = MAGI_ERR_NOMEM;
     return NULL;
   }
+  memset(q, 0, size);
 
-  q->cap = capacity + 1U;
-  q->buf = calloc(q->cap, sizeof(*q->buf));
-  if (q->buf == NULL) {
+  q->slots = calloc(slots, sizeof(*q->slots));
+  if (q->slots == NULL) {
     free(q);
     magi_errno = MAGI_ERR_NOMEM;
     return NULL;
   }
 
+  q->mask = slots - 1U;
+  for (size_t index = 0U; index < slots; ++index) {
+    atomic_init(&q->slots[index].seq, index);
+  }
+  atomic_init(&q->tail, 0U);
+  atomic_init(&q->head, 0U);
+  atomic_init(&q->consumer_waiting, 0U);
+  atomic_init(&q->producers_waiting, 0U);
+  atomic_init(&q->block_when_full, false);
+  atomic_init(&q->dropped, 0U);
+  atomic_init(&q->wakeups, 0U);
+
   if (pthread_mutex_init(&q->lock, NULL) != 0) {
-    free(q->buf);
+    free(q->slots);
     free(q);
     magi_errno = MAGI_ERR_NOMEM;
     return NULL;
@@ -46,7 +181,16 @@ MagiQueue* queue_new(size_t capacity) {
 
   if (pthread_cond_init(&q->not_empty, NULL) != 0) {
     pthread_mutex_destroy(&q->lock);
-    free(q->buf);
+    free(q->slots);
+    free(q);
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+
+  if (pthread_cond_init(&q->not_full, NULL) != 0) {
+    pthread_cond_destroy(&q->not_empty);
+    pthread_mutex_destroy(&q->lock);
+    free(q->slots);
     free(q);
     magi_errno = MAGI_ERR_NOMEM;
     return NULL;
@@ -58,9 +202,10 @@ MagiQueue* queue_new(size_t capacity) {
 /**
  * @brief Release all resources owned by a queue.
  *
- * Drains any pending messages (freeing their data buffers), then
+ * Drains any pending messages (releasing their payloads), then
  * destroys the synchronisation primitives and deallocates the
- * circular buffer and the queue struct itself.
+ * slot ring and the queue struct itself. No producer or consumer may
+ * still be using the queue.
  *
  * @param q Queue to destroy. Passing NULL is safe and results in a
  *          no-op.
@@ -70,94 +215,237 @@ void queue_free(MagiQueue* q) {
     return;
   }
 
-  while (q->head != q->tail) {
-    free(q->buf[q->head].data);
-    q->head = (q->head + 1U) % q->cap;
+  MagiMsg msg;
+  while (queue_take(q, &msg, 1U) == 1U) {
+    queue_msg_release(&msg);
   }
 
+  pthread_cond_destroy(&q->not_full);
   pthread_cond_destroy(&q->not_empty);
   pthread_mutex_destroy(&q->lock);
-  free(q->buf);
+  free(q->slots);
   free(q);
 }
 
+void queue_set_notify(MagiQueue* q, queue_notify_fn notify, void* ctx) {
+  if (q != NULL) {
+    q->notify = notify;
+    q->notify_ctx = ctx;
+  }
+}
+
+void queue_set_wait_helper(queue_wait_helper_fn helper) {
+  queue_wait_helper = helper;
+}
+
+void queue_set_backpressure(MagiQueue* q, bool enabled) {
+  if (q != NULL) {
+    atomic_store_explicit(&q->block_when_full, enabled, memory_order_relaxed);
+  }
+}
+
 /**
  * @brief Enqueue one message into the queue.
  *
- * Locks the queue, writes the message at the tail position, advances
- * the tail index, signals the not_empty condition variable, and
- * unlocks. If the queue is full the operation fails immediately
- * without blocking.
+ * Lock-free on the fast path. If the ring is full the message is either
+ * dropped (the default, counted in queue_dropped()) or, with
+ * back-pressure enabled, the call waits like queue_push_blocking().
  *
  * @param q   Queue handle.
- * @param msg Message to enqueue. The caller transfers ownership of the
- *            embedded data pointer to the queue.
+ * @param msg Message to enqueue. On success the caller transfers
+ *            ownership of the embedded payload to the queue.
  * @return MAGI_OK on success, MAGI_ERR_BADARGS if q is invalid, or
- *         MAGI_ERR_TIMEOUT if the queue is full.
+ *         MAGI_ERR_TIMEOUT if the queue is full and back-pressure is off.
  */
 int queue_push(MagiQueue* q, MagiMsg msg) {
-  if (q == NULL || q->buf == NULL) {
+  if (q == NULL || q->slots == NULL) {
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
-  if (pthread_mutex_lock(&q->lock) != 0) {
+  if (queue_try_push(q, &msg)) {
+    queue_wake_consumer(q);
+    return MAGI_OK;
+  }
+
+  if (atomic_load_explicit(&q->block_when_full, memory_order_relaxed)) {
+    return queue_push_blocking(q, msg);
+  }
+
+  atomic_fetch_add_explicit(&q->dropped, 1U, memory_order_relaxed);
+  magi_errno = MAGI_ERR_TIMEOUT;
+  return MAGI_ERR_TIMEOUT;
+}
+
+/**
+ * @brief Sleep until the consumer frees a slot, then try the push once more.
+ *
+ * The producer registers in producers_waiting before re-trying under the
+ * mutex, so a consumer that frees a slot concurrently either lets the
+ * retry succeed or sees the registration and broadcasts not_full. With a
+ * wait helper installed the sleep is capped at a millisecond so the
+ * helper gets polled again.
+ *
+ * @param q   Queue handle.
+ * @param msg Message to enqueue.
+ * @return true if the message was enqueued.
+ */
+static bool queue_wait_slot(MagiQueue* q, const MagiMsg* msg) {
+  pthread_mutex_lock(&q->lock);
+  atomic_fetch_add_explicit(&q->producers_waiting, 1U, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  bool pushed = queue_try_push(q, msg);
+  if (!pushed && queue_wait_helper != NULL) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&q->not_full, &q->lock, &deadline);
+  } else if (!pushed) {
+    pthread_cond_wait(&q->not_full, &q->lock);
+  }
+  atomic_fetch_sub_explicit(&q->producers_waiting, 1U, memory_order_relaxed);
+  pthread_mutex_unlock(&q->lock);
+  return pushed;
+}
+
+/**
+ * @brief Enqueue one message, waiting while the ring is full.
+ *
+ * Before each sleep the installed wait helper, if any, gets a chance to
+ * drain work so a pool worker never parks while it could run the
+ * consumer it is waiting on.
+ *
+ * @param q   Queue handle.
+ * @param msg Message to enqueue; ownership transfers to the queue.
+ * @return MAGI_OK on success, or MAGI_ERR_BADARGS if q is invalid.
+ */
+int queue_push_blocking(MagiQueue* q, MagiMsg msg) {
+  if (q == NULL || q->slots == NULL) {
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
-  size_t next_tail = (q->tail + 1U) % q->cap;
-  if (next_tail == q->head) {
-    pthread_mutex_unlock(&q->lock);
-    magi_errno = MAGI_ERR_TIMEOUT;
-    return MAGI_ERR_TIMEOUT;
+  while (!queue_try_push(q, &msg)) {
+    queue_wait_helper_fn helper = queue_wait_helper;
+    if (helper != NULL && helper()) {
+      continue;
+    }
+    if (queue_wait_slot(q, &msg)) {
+      break;
+    }
   }
 
-  q->buf[q->tail] = msg;
-  q->tail = next_tail;
-  pthread_cond_signal(&q->not_empty);
-  pthread_mutex_unlock(&q->lock);
+  queue_wake_consumer(q);
   return MAGI_OK;
 }
 
 /**
  * @brief Dequeue one message from the queue, blocking if empty.
  *
- * Locks the queue and waits on the not_empty condition variable
- * while the buffer is empty. Once a message is available it is
- * copied to out, the head index advances, the slot is zeroed, and
- * the lock is released.
- *
  * @param q   Queue handle.
  * @param out Destination for the dequeued message. The caller assumes
- *            ownership of the data pointer embedded in the message.
+ *            ownership of the payload embedded in the message.
  * @return MAGI_OK on success, or MAGI_ERR_BADARGS if any parameter
- *         is NULL or a synchronisation error occurs.
+ *         is NULL.
  */
 int queue_pop(MagiQueue* q, MagiMsg* out) {
-  if (q == NULL || q->buf == NULL || out == NULL) {
+  if (queue_pop_batch(q, out, 1U) != 1U) {
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
-  if (pthread_mutex_lock(&q->lock) != 0) {
+  return MAGI_OK;
+}
+
+/**
+ * @brief Dequeue a batch of messages, blocking while the queue is empty.
+ *
+ * Drains up to max published messages in one pass. When the ring is
+ * empty the consumer advertises consumer_waiting, re-checks under the
+ * mutex, and sleeps on not_empty until a producer clears the flag.
+ * Producers blocked on a full ring are woken after the batch is taken.
+ *
+ * @param q   Queue handle.
+ * @param out Destination array with room for max messages.
+ * @param max Maximum number of messages to dequeue.
+ * @return Number of messages dequeued (at least one), or 0 on invalid
+ *         arguments.
+ */
+size_t queue_pop_batch(MagiQueue* q, MagiMsg* out, size_t max) {
+  if (q == NULL || q->slots == NULL || out == NULL || max == 0U) {
     magi_errno = MAGI_ERR_BADARGS;
-    return MAGI_ERR_BADARGS;
+    return 0U;
   }
 
-  while (q->head == q->tail) {
-    if (pthread_cond_wait(&q->not_empty, &q->lock) != 0) {
-      pthread_mutex_unlock(&q->lock);
-      memset(out, 0, sizeof(*out));
-      magi_errno = MAGI_ERR_BADARGS;
-      return MAGI_ERR_BADARGS;
+  size_t count = queue_take(q, out, max);
+  if (count == 0U) {
+    pthread_mutex_lock(&q->lock);
+    while (!queue_ready(q)) {
+      atomic_store_explicit(&q->consumer_waiting, 1U, memory_order_relaxed);
+      atomic_thread_fence(memory_order_seq_cst);
+      if (queue_ready(q)) {
+        break;
+      }
+      pthread_cond_wait(&q->not_empty, &q->lock);
     }
+    atomic_store_explicit(&q->consumer_waiting, 0U, memory_order_relaxed);
+    pthread_mutex_unlock(&q->lock);
+    count = queue_take(q, out, max);
   }
 
-  *out = q->buf[q->head];
-  memset(&q->buf[q->head], 0, sizeof(q->buf[q->head]));
-  q->head = (q->head + 1U) % q->cap;
-  pthread_mutex_unlock(&q->lock);
+  queue_wake_producers(q);
+  return count;
+}
 
-  return MAGI_OK;
+size_t queue_try_pop_batch(MagiQueue* q, MagiMsg* out, size_t max) {
+  if (q == NULL || q->slots == NULL || out == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return 0U;
+  }
+
+  size_t count = queue_take(q, out, max);
+  if (count > 0U) {
+    queue_wake_producers(q);
+  }
+  return count;
+}
+
+bool queue_has_pending(const MagiQueue* q) {
+  return q != NULL && q->slots != NULL && queue_ready(q);
+}
+
+/**
+ * @brief Release the payload owned by a dequeued message.
+ *
+ * Messages produced by link_transmit_pkt() carry a refcounted packet
+ * buffer that is dropped with pktbuf_release(); plain messages own a
+ * heap block that is passed to free(). Both pointers are cleared so a
+ * second call is a no-op.
+ *
+ * @param msg Message to release. Passing NULL is safe.
+ */
+void queue_msg_release(MagiMsg* msg) {
+  if (msg == NULL) {
+    return;
+  }
+
+  if (msg->pkt != NULL) {
+    pktbuf_release(msg->pkt);
+  } else {
+    free(msg->data);
+  }
+  msg->pkt = NULL;
+  msg->data = NULL;
+}
+
+size_t queue_dropped(const MagiQueue* q) {
+  return q != NULL ? atomic_load_explicit(&q->dropped, memory_order_relaxed) : 0U;
+}
+
+size_t queue_wakeups(const MagiQueue* q) {
+  return q != NULL ? atomic_load_explicit(&q->wakeups, memory_order_relaxed) : 0U;
 }
@@ -1,16 +1,30 @@
 /**
  * @file queue.h
  * @brief Async queue primitives used when MAGI_ASYNC is enabled.
+ *
+ * Each node owns one MagiQueue. Every neighbor pushes into it from its own
+ * worker thread, and only the node's worker pops, so the queue is a bounded
+ * lock-free multi-producer/single-consumer ring (Vyukov-style per-slot
+ * sequence numbers). The mutex and condition variables are touched only on
+ * the slow paths: when the consumer goes to sleep on an empty ring, and
+ * when a producer in back-pressure mode waits on a full one.
+ *
+ * The async engine does not park a thread per queue. It installs a notify
+ * hook instead, which schedules the owning node on the worker pool after
+ * each push, and drains the ring with queue_try_pop_batch().
  */
 
 #ifndef MAGI_ASYNC_QUEUE_H
 #define MAGI_ASYNC_QUEUE_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
 struct Interface;
+struct PktBuf;
 
 /**
  * @brief A queued frame payload for async delivery.
@@ -18,34 +32,78 @@ struct Interface;
 typedef struct MagiMsg {
   /** Source interface that produced the payload. */
   struct Interface* src_iface;
-  /** Raw payload buffer. Receiver owns and frees after dequeue. */
+  /** Payload bytes. Receiver owns them and releases with queue_msg_release(). */
   uint8_t* data;
   /** Payload length in bytes. */
   size_t len;
+  /** Packet buffer backing data, or NULL when data is a plain heap block. */
+  struct PktBuf* pkt;
 } MagiMsg;
 
 /**
- * @brief Single-producer/single-consumer queue state.
+ * @brief One ring slot; seq tells producers and the consumer whose turn it is.
+ */
+typedef struct MagiQueueSlot {
+  /** Equals the slot's position when free, position + 1 when filled. */
+  atomic_size_t seq;
+  /** Stored message. */
+  MagiMsg msg;
+} MagiQueueSlot;
+
+/**
+ * @brief Called after every successful push when installed with queue_set_notify().
+ */
+typedef void (*queue_notify_fn)(void* ctx);
+
+/**
+ * @brief Lets a producer stuck on a full ring do useful work before it sleeps.
+ *
+ * @return true if the helper made progress and the push should be retried.
+ */
+typedef bool (*queue_wait_helper_fn)(void);
+
+/**
+ * @brief Multi-producer/single-consumer queue state.
  */
 typedef struct MagiQueue {
-  /** Circular buffer storage for queue items. */
-  MagiMsg* buf;
-  /** Read index in the circular buffer. */
-  size_t head;
-  /** Write index in the circular buffer. */
-  size_t tail;
-  /** Maximum number of queue entries. */
-  size_t cap;
-  /** Mutex protecting queue state. */
+  /** Ring storage; the slot count is a power of two. */
+  MagiQueueSlot* slots;
+  /** Slot count minus one. */
+  size_t mask;
+  /** Next position to claim; shared by all producers. */
+  _Alignas(64) atomic_size_t tail;
+  /**
+   * Next position to read; written only by the consumer. Atomic because the
+   * engine hands the consumer role between workers, and a worker finishing a
+   * turn may still peek at it while the next one pops.
+   */
+  _Alignas(64) atomic_size_t head;
+  /** Non-zero while the consumer is (about to be) asleep on not_empty. */
+  atomic_uint consumer_waiting;
+  /** Number of producers asleep on not_full. */
+  atomic_uint producers_waiting;
+  /** When true, queue_push() blocks on a full ring instead of dropping. */
+  atomic_bool block_when_full;
+  /** Messages dropped because the ring was full. */
+  atomic_size_t dropped;
+  /** Times a producer had to wake the consumer. */
+  atomic_size_t wakeups;
+  /** Mutex protecting the slow-path waits. */
   pthread_mutex_t lock;
-  /** Condition signaled when queue transitions from empty. */
+  /** Condition signaled when the ring turns non-empty under a sleeping consumer. */
   pthread_cond_t not_empty;
+  /** Condition signaled when the consumer frees slots under sleeping producers. */
+  pthread_cond_t not_full;
+  /** Optional push hook replacing the not_empty wakeup; see queue_set_notify(). */
+  queue_notify_fn notify;
+  /** Context passed to notify. */
+  void* notify_ctx;
 } MagiQueue;
 
 /**
  * @brief Allocate and initialize a queue.
  *
- * @param capacity Desired queue capacity.
+ * @param capacity Desired queue capacity; rounded up to a power of two.
  * @return Queue instance, or NULL on allocation/initialization failure.
  */
 MagiQueue* queue_new(size_t capacity);
@@ -57,17 +115,62 @@ MagiQueue* queue_new(size_t capacity);
  */
 void queue_free(MagiQueue* q);
 
+/**
+ * @brief Choose what queue_push() does when the ring is full.
+ *
+ * Back-pressure can deadlock two nodes that fill each other's queues from
+ * their own workers, so it is off by default.
+ *
+ * @param q Queue handle.
+ * @param enabled true to block the producer, false to drop the message.
+ */
+void queue_set_backpressure(MagiQueue* q, bool enabled);
+
+/**
+ * @brief Route consumer wakeups through a callback instead of not_empty.
+ *
+ * Must be installed before producers start pushing. While a hook is set,
+ * the consumer is expected to poll with queue_try_pop_batch() rather than
+ * sleep in queue_pop_batch().
+ *
+ * @param q Queue handle.
+ * @param notify Hook called after each successful push, or NULL to clear it.
+ * @param ctx Context passed to notify.
+ */
+void queue_set_notify(MagiQueue* q, queue_notify_fn notify, void* ctx);
+
+/**
+ * @brief Install a process-wide helper run by producers blocked on a full ring.
+ *
+ * The async engine uses this so a pool worker waiting on a full queue runs
+ * other nodes, including the one it is waiting on, instead of sleeping.
+ * While a helper is installed, blocked producers re-poll every millisecond.
+ *
+ * @param helper Helper, or NULL to clear it.
+ */
+void queue_set_wait_helper(queue_wait_helper_fn helper);
+
 /**
  * @brief Push one message into the queue.
  *
  * @param q Queue handle.
  * @param msg Message to enqueue.
- * @return MAGI_OK on success, otherwise an error code.
+ * @return MAGI_OK on success, MAGI_ERR_TIMEOUT if the ring is full and
+ *         back-pressure is off, otherwise an error code.
  */
 int queue_push(MagiQueue* q, MagiMsg msg);
 
 /**
- * @brief Pop one message from the queue.
+ * @brief Push one message, waiting for a free slot if the ring is full.
+ *
+ * @param q Queue handle.
+ * @param msg Message to enqueue.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int queue_push_blocking(MagiQueue* q, MagiMsg msg);
+
+/**
+ * @brief Pop one message from the queue, blocking while it is empty.
  *
  * @param q Queue handle.
  * @param out Destination for the popped message.
@@ -75,4 +178,59 @@ int queue_push(MagiQueue* q, MagiMsg msg);
  */
 int queue_pop(MagiQueue* q, MagiMsg* out);
 
+/**
+ * @brief Pop up to max messages, blocking until at least one is available.
+ *
+ * Must only be called from the queue's single consumer thread.
+ *
+ * @param q Queue handle.
+ * @param out Destination array with room for max messages.
+ * @param max Maximum number of messages to pop.
+ * @return Number of messages popped, or 0 on invalid arguments.
+ */
+size_t queue_pop_batch(MagiQueue* q, MagiMsg* out, size_t max);
+
+/**
+ * @brief Pop up to max messages without blocking.
+ *
+ * Must only be called by whichever thread currently owns the consumer side.
+ *
+ * @param q Queue handle.
+ * @param out Destination array with room for max messages.
+ * @param max Maximum number of messages to pop.
+ * @return Number of messages popped; 0 if the ring is empty or arguments are invalid.
+ */
+size_t queue_try_pop_batch(MagiQueue* q, MagiMsg* out, size_t max);
+
+/**
+ * @brief Check from the consumer side whether a message is ready to pop.
+ *
+ * @param q Queue handle.
+ * @return true if queue_try_pop_batch() would return at least one message.
+ */
+bool queue_has_pending(const MagiQueue* q);
+
+/**
+ * @brief Release the payload owned by a dequeued message.
+ *
+ * @param msg Message whose data (or packet buffer) should be freed.
+ */
+void queue_msg_release(MagiMsg* msg);
+
+/**
+ * @brief Number of messages dropped on a full ring.
+ *
+ * @param q Queue handle.
+ * @return Drop count, or 0 for NULL.
+ */
+size_t queue_dropped(const MagiQueue* q);
+
+/**
+ * @brief Number of producer-side consumer wakeups.
+ *
+ * @param q Queue handle.
+ * @return Wakeup count, or 0 for NULL.
+ */
+size_t queue_wakeups(const MagiQueue* q);
+
 #endif
@@ -4,6 +4,7 @@
 
 #include "commands.h"
 
+#include "core/sim.h"
 #include "utils/log.h"
 #include "utils/magi_error.h"
 
@@ -11,13 +12,18 @@
 #include <stdio.h>
 #include <string.h>
 
+/** Simulated time a command's traffic is given to land before the next prompt. */
+#define CLI_SETTLE_MS 1000U
+
 /**
  * @brief Run the interactive MAGI shell loop.
  *
  * Reads input line-by-line from stdin, strips trailing newline/carriage-return,
  * tokenizes the line on whitespace, and dispatches to commands_dispatch().
  * The loop continues until commands_dispatch() returns CLI_EXIT_REQUEST
- * (triggered by "exit" or "quit") or EOF is received on stdin.
+ * (triggered by "exit" or "quit") or EOF is received on stdin. After each
+ * command the simulation runs events due within CLI_SETTLE_MS, so frames
+ * the command left in flight on delayed links are delivered.
  *
  * @param topology Mutable topology context used by all commands.
  * @return MAGI_OK on graceful exit, MAGI_ERR_BADARGS if topology is NULL.
@@ -60,6 +66,7 @@ int cli_run(Topology* topology) {
     if (status == CLI_EXIT_REQUEST) {
       break;
     }
+    (void)sim_run_for(CLI_SETTLE_MS * SIM_NS_PER_MS);
   }
 
   return MAGI_OK;
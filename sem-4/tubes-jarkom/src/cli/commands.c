@@ -1,9 +1,13 @@
 #define _POSIX_C_SOURCE 200809L
+#define MAGI_LOG_SUBSYS MAGI_LOG_CLI
 
 #include "commands.h"
 
+#include "core/capture.h"
 #include "core/interface.h"
+#include "core/link.h"
 #include "core/node.h"
+#include "core/sim.h"
 #include "layer2/arp.h"
 #include "layer2/host.h"
 #include "layer2/switch.h"
@@ -17,6 +21,7 @@
 #include "layer7/http.h"
 #include "layer7/magi_socket.h"
 #include "topology/json_loader.h"
+#include "topology/replay.h"
 #include "utils/log.h"
 #include "utils/magi_error.h"
 
@@ -166,6 +171,26 @@ static bool is_ipv4_target(const char* target) {
   return arp_ipv4_from_string(target, ip) == MAGI_OK;
 }
 
+/**
+ * @brief sim_run_until_cond() predicate: the TCP handshake has finished.
+ *
+ * @param ctx The TCPSocket being connected.
+ * @return true once the socket has left SYN_SENT.
+ */
+static bool tcp_handshake_done(const void* ctx) {
+  return ((const TCPSocket*)ctx)->state != TCP_SYN_SENT;
+}
+
+/**
+ * @brief sim_run_until_cond() predicate: the TCP socket has data to read.
+ *
+ * @param ctx The TCPSocket to check.
+ * @return true if received data is buffered.
+ */
+static bool tcp_reply_ready(const void* ctx) {
+  return tcp_socket_has_data((const TCPSocket*)ctx);
+}
+
 /**
  * @brief Print CLI command usage summary to the log.
  *
@@ -175,16 +200,23 @@ static bool is_ipv4_target(const char* target) {
 void commands_print_help(void) {
   LOG("CLI", "=== Topology Commands ===");
   LOG("CLI", "  create <host|switch|router> <name>");
-  LOG("CLI", "  link <dev1> <dev2> [delay_ms] [mtu]");
+  LOG("CLI", "  link <dev1> <dev2> [delay_ms] [mtu] [bandwidth] [fifo|red] [queue_limit]");
+  LOG("CLI", "  link stats");
   LOG("CLI", "  unlink <dev1> <dev2>");
   LOG("CLI", "  topology");
   LOG("CLI", "  save [filename]");
   LOG("CLI", "  load [filename]");
+  LOG("CLI", "  clock [advance <ms> | realtime <on|off>]");
+  LOG("CLI", "  log [level <lvl>[,<core|l2|l3|l4|l7|cli>=<lvl>...] | sink <sync|ring>]");
+  LOG("CLI", "  stats [<node> | json [file] | openmetrics [file] | reset]");
+  LOG("CLI", "  capture [start [link] <node>.<port> <file> [snaplen <n>] [filter <expr>]]");
+  LOG("CLI", "  capture stop [link] <node>.<port>");
+  LOG("CLI", "  replay <node>.<port> <file> [original|fast|x<speed>] [loops <n>] [dstmac]");
   LOG("CLI", "  help");
   LOG("CLI", "  exit | quit");
   LOG("CLI", "");
   LOG("CLI", "=== Host Actions ===");
-  LOG("CLI", "  <host> ping <ip>");
+  LOG("CLI", "  <host> ping <ip> [size] [df]");
   LOG("CLI", "  <host> traceroute <ip> [max_hops]");
   LOG("CLI", "  <host> arp");
   LOG("CLI", "  <host> tcp_connect <ip> <port>");
@@ -256,12 +288,15 @@ int cmd_create(Topology* topology, const char* type, const char* name) {
  * @param dev2 Second endpoint spec ("Name" or "Name:Port").
  * @param delay_ms Link propagation delay in milliseconds.
  * @param mtu Link maximum transmission unit in bytes.
+ * @param bandwidth_bps Line rate in bits per second, or 0 for unlimited.
+ * @param queue Egress queue configuration, or NULL for the default FIFO.
  * @return MAGI_OK on success, MAGI_ERR_BADARGS if endpoints are invalid or link fails.
  */
 int cmd_link(Topology* topology, const char* dev1, const char* dev2, uint32_t delay_ms,
-             uint16_t mtu) {
+             uint16_t mtu, uint64_t bandwidth_bps, const LinkQueueConfig* queue) {
   if (topology == NULL || dev1 == NULL || dev2 == NULL) {
-    LOG("CLI", "link: missing arguments. Usage: link <dev1> <dev2> [delay_ms] [mtu]");
+    LOG("CLI", "link: missing arguments. Usage: link <dev1> <dev2> [delay_ms] [mtu] [bandwidth] "
+               "[fifo|red] [queue_limit]");
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
@@ -274,8 +309,10 @@ int cmd_link(Topology* topology, const char* dev1, const char* dev2, uint32_t de
     return MAGI_ERR_BADARGS;
   }
 
-  if (topology_add_link(topology, endpoint_a.node_info->node->name, endpoint_a.port,
-                        endpoint_b.node_info->node->name, endpoint_b.port, delay_ms, mtu) == NULL) {
+  TopologyLinkInfo* info =
+      topology_add_link(topology, endpoint_a.node_info->node->name, endpoint_a.port,
+                        endpoint_b.node_info->node->name, endpoint_b.port, delay_ms, mtu);
+  if (info == NULL) {
     LOG("CLI",
         "link: failed to create link between %s and %s. Possible causes: link already "
         "exists, or one/both interfaces are already connected to another link",
@@ -283,7 +320,35 @@ int cmd_link(Topology* topology, const char* dev1, const char* dev2, uint32_t de
     return MAGI_ERR_BADARGS;
   }
 
-  LOG("TOPO", "Linked %s <-> %s delay=%ums mtu=%u", dev1, dev2, (unsigned)delay_ms, (unsigned)mtu);
+  if (link_set_bandwidth(info->link, bandwidth_bps) != MAGI_OK ||
+      (queue != NULL && link_set_queue(info->link, queue) != MAGI_OK)) {
+    LOG("CLI", "link: invalid bandwidth or queue settings for %s <-> %s", dev1, dev2);
+    (void)topology_remove_link(topology, endpoint_a.node_info->node->name, endpoint_a.port,
+                               endpoint_b.node_info->node->name, endpoint_b.port);
+    return MAGI_ERR_BADARGS;
+  }
+
+  if (bandwidth_bps == 0U) {
+    LOG("TOPO", "Linked %s <-> %s delay=%ums mtu=%u", dev1, dev2, (unsigned)delay_ms,
+        (unsigned)mtu);
+  } else {
+    char rate[24];
+    link_format_rate(bandwidth_bps, rate, sizeof(rate));
+    LOG("TOPO", "Linked %s <-> %s delay=%ums mtu=%u bw=%sbps queue=%s/%u", dev1, dev2,
+        (unsigned)delay_ms, (unsigned)mtu, rate, link_queue_kind_name(info->link->queue.kind),
+        (unsigned)info->link->queue.limit);
+  }
+  return MAGI_OK;
+}
+
+/**
+ * @brief Print every link with per-direction traffic counters.
+ *
+ * @param topology Topology context to display.
+ * @return MAGI_OK.
+ */
+int cmd_link_stats(Topology* topology) {
+  topology_print_link_stats(topology);
   return MAGI_OK;
 }
 
@@ -412,6 +477,338 @@ int cmd_load(Topology* topology, const char* filename) {
   return MAGI_OK;
 }
 
+/**
+ * @brief Print the simulation clock and pacing mode.
+ *
+ * @return MAGI_OK.
+ */
+int cmd_clock(void) {
+  uint64_t now_ns = sim_now_ns();
+  LOG("CLI", "clock: %llu.%06llu ms (%s, %zu events pending)",
+      (unsigned long long)(now_ns / SIM_NS_PER_MS), (unsigned long long)(now_ns % SIM_NS_PER_MS),
+      sim_realtime() ? "real-time" : "virtual", sim_pending());
+  return MAGI_OK;
+}
+
+/**
+ * @brief Advance the simulation clock, running every event due on the way.
+ *
+ * Periodic work such as RIP updates only happens when the clock passes
+ * it, so this is how the user lets time go by between commands.
+ *
+ * @param delta_ms Simulated milliseconds to advance by.
+ * @return MAGI_OK, or MAGI_ERR_BADARGS in async builds.
+ */
+int cmd_clock_advance(uint32_t delta_ms) {
+#ifdef MAGI_ASYNC
+  (void)delta_ms;
+  LOG("CLI", "clock: async builds run on the wall clock; advance is not available");
+  return MAGI_ERR_BADARGS;
+#else
+  size_t ran = sim_run_until(sim_now_ns() + (uint64_t)delta_ms * SIM_NS_PER_MS);
+  LOG("CLI", "clock: advanced %u ms, ran %zu events", (unsigned)delta_ms, ran);
+  return cmd_clock();
+#endif
+}
+
+/**
+ * @brief Turn real-time pacing of simulation events on or off.
+ *
+ * @param enabled true to sleep through simulated delays.
+ * @return MAGI_OK.
+ */
+int cmd_clock_realtime(bool enabled) {
+  sim_set_realtime(enabled);
+  LOG("CLI", "clock: real-time pacing %s", enabled ? "on" : "off");
+  return MAGI_OK;
+}
+
+/**
+ * @brief Print the log sink, per-subsystem levels and ring drop count.
+ *
+ * @return MAGI_OK.
+ */
+int cmd_log(void) {
+  LOG("CLI", "log: sink %s, %llu lines dropped",
+      magi_log_sink() == MAGI_LOG_SINK_RING ? "ring" : "sync",
+      (unsigned long long)magi_log_dropped());
+  for (int subsys = 0; subsys < MAGI_LOG_SUBSYS_COUNT; ++subsys) {
+    LOG("CLI", "log:   %-4s %s", magi_log_subsys_name((MagiLogSubsys)subsys),
+        magi_log_level_name(magi_log_level((MagiLogSubsys)subsys)));
+  }
+  return MAGI_OK;
+}
+
+/**
+ * @brief Apply a log level spec, then show the resulting levels.
+ *
+ * @param spec Level spec such as "warn" or "info,l3=debug".
+ * @return MAGI_OK, or MAGI_ERR_BADARGS for a malformed spec.
+ */
+int cmd_log_level(const char* spec) {
+  if (magi_log_apply_spec(spec) != MAGI_OK) {
+    LOG("CLI", "log: bad level spec '%s' (levels: error, warn, info, debug)",
+        spec != NULL ? spec : "");
+    return MAGI_ERR_BADARGS;
+  }
+  return cmd_log();
+}
+
+/**
+ * @brief Switch between synchronous and ring-buffer log output.
+ *
+ * @param sink New sink.
+ * @return MAGI_OK, or an error code if the ring sink cannot start.
+ */
+int cmd_log_sink(MagiLogSink sink) {
+  int status = magi_log_set_sink(sink);
+  if (status != MAGI_OK) {
+    LOG("CLI", "log: could not start the ring sink");
+    return status;
+  }
+  LOG("CLI", "log: sink %s", sink == MAGI_LOG_SINK_RING ? "ring" : "sync");
+  return MAGI_OK;
+}
+
+/**
+ * @brief Print packet, drop, ARP and FIB counters.
+ *
+ * @param topology Topology context.
+ * @param node_name Node to show, or NULL for every node.
+ * @return MAGI_OK, or MAGI_ERR_BADARGS for an unknown node.
+ */
+int cmd_stats(Topology* topology, const char* node_name) {
+  int status = topology_print_stats(topology, node_name);
+  if (status == MAGI_ERR_BADARGS && node_name != NULL) {
+    LOG("CLI", "stats: unknown node '%s'", node_name);
+  }
+  return status;
+}
+
+/**
+ * @brief Dump every counter as JSON or OpenMetrics text.
+ *
+ * @param topology Topology context.
+ * @param format Output format.
+ * @param filename Output path, or NULL for stdout.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int cmd_stats_export(Topology* topology, TopologyStatsFormat format, const char* filename) {
+  int status = topology_export_stats(topology, format, filename);
+  if (status != MAGI_OK) {
+    LOG("CLI", "stats: could not write %s", filename != NULL ? filename : "stdout");
+    return status;
+  }
+
+  if (filename != NULL) {
+    LOG("CLI", "stats: wrote %s", filename);
+  }
+  return MAGI_OK;
+}
+
+/**
+ * @brief Zero every node, interface and link counter.
+ *
+ * @param topology Topology context.
+ * @return MAGI_OK.
+ */
+int cmd_stats_reset(Topology* topology) {
+  topology_reset_stats(topology);
+  LOG("CLI", "stats: counters reset");
+  return MAGI_OK;
+}
+
+/**
+ * @brief Resolve "Name.Port", "Name:Port" or a bare host name to an interface.
+ */
+static Interface* resolve_interface_spec(const Topology* topology, const char* command,
+                                         const char* spec) {
+  char endpoint[96];
+  if (snprintf(endpoint, sizeof(endpoint), "%s", spec) >= (int)sizeof(endpoint)) {
+    LOG("CLI", "%s: endpoint '%s' is too long", command, spec);
+    return NULL;
+  }
+
+  char* dot = strrchr(endpoint, '.');
+  if (strchr(endpoint, ':') == NULL && dot != NULL) {
+    *dot = ':';
+  }
+
+  EndpointRef ref = {0};
+  if (resolve_endpoint(topology, endpoint, &ref) != MAGI_OK) {
+    return NULL;
+  }
+
+  Interface* iface = node_get_interface(ref.node_info->node, ref.port);
+  if (iface == NULL) {
+    LOG("CLI", "%s: %s has no port %u", command, ref.node_info->node->name, (unsigned)ref.port);
+  }
+  return iface;
+}
+
+/**
+ * @brief Log one running capture.
+ */
+static void log_capture(const char* what, Capture* capture) {
+  CaptureStats stats;
+  capture_flush(capture);
+  capture_get_stats(capture, &stats);
+  LOG("CLI", "capture: %s -> %s (%llu written, %llu filtered, %llu dropped)", what,
+      capture_path(capture), (unsigned long long)stats.written,
+      (unsigned long long)stats.filtered, (unsigned long long)stats.dropped);
+}
+
+static void list_node_captures_cb(const char* key, void* value, void* ctx) {
+  (void)key;
+  const TopologyNodeInfo* info = value;
+  size_t* count = ctx;
+  for (size_t index = 0U; info->node != NULL && index < info->node->iface_count; ++index) {
+    Interface* iface = info->node->iface_list[index];
+    if (iface->capture != NULL) {
+      char name[96];
+      snprintf(name, sizeof(name), "%s.%u", info->node->name, (unsigned)iface->port_number);
+      log_capture(name, iface->capture);
+      (*count)++;
+    }
+  }
+}
+
+static void list_link_captures_cb(const char* key, void* value, void* ctx) {
+  (void)key;
+  const TopologyLinkInfo* info = value;
+  size_t* count = ctx;
+  if (info->link != NULL && info->link->capture != NULL) {
+    char name[160];
+    snprintf(name, sizeof(name), "link %s.%u-%s.%u", info->node_a, (unsigned)info->port_a,
+             info->node_b, (unsigned)info->port_b);
+    log_capture(name, info->link->capture);
+    (*count)++;
+  }
+}
+
+/**
+ * @brief List every running capture with its counters.
+ *
+ * @param topology Topology context.
+ * @return MAGI_OK.
+ */
+int cmd_capture_list(Topology* topology) {
+  size_t count = 0U;
+  if (topology != NULL) {
+    hashmap_foreach(topology->nodes, list_node_captures_cb, &count);
+    hashmap_foreach(topology->links, list_link_captures_cb, &count);
+  }
+  if (count == 0U) {
+    LOG("CLI", "capture: none running");
+  }
+  return MAGI_OK;
+}
+
+/**
+ * @brief Start a pcapng capture on an interface or on the link attached to it.
+ *
+ * @param topology Topology context.
+ * @param endpoint Interface spec ("Name.Port" or "Name:Port").
+ * @param on_link Capture the interface's link rather than the interface.
+ * @param path Output file.
+ * @param config Snap length and filter.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int cmd_capture_start(Topology* topology, const char* endpoint, bool on_link, const char* path,
+                      const CaptureConfig* config) {
+  Interface* iface = resolve_interface_spec(topology, "capture", endpoint);
+  if (iface == NULL) {
+    return MAGI_ERR_BADARGS;
+  }
+
+  if (on_link && iface->link == NULL) {
+    LOG("CLI", "capture: %s is not linked", endpoint);
+    return MAGI_ERR_NOLINK;
+  }
+
+  int status = on_link ? capture_start_link(iface->link, path, config)
+                       : capture_start_interface(iface, path, config);
+  if (status != MAGI_OK) {
+    LOG("CLI", "capture: could not start on %s%s (already running, or %s unwritable)",
+        on_link ? "the link at " : "", endpoint, path);
+    return status;
+  }
+
+  LOG("CLI", "capture: %s%s -> %s", on_link ? "link at " : "", endpoint, path);
+  return MAGI_OK;
+}
+
+/**
+ * @brief Stop a capture and report what it wrote.
+ *
+ * @param topology Topology context.
+ * @param endpoint Interface spec ("Name.Port" or "Name:Port").
+ * @param on_link Stop the capture on the interface's link.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int cmd_capture_stop(Topology* topology, const char* endpoint, bool on_link) {
+  Interface* iface = resolve_interface_spec(topology, "capture", endpoint);
+  if (iface == NULL) {
+    return MAGI_ERR_BADARGS;
+  }
+
+  CaptureStats stats;
+  int status = on_link ? capture_stop_link(iface->link, &stats)
+                       : capture_stop_interface(iface, &stats);
+  if (status != MAGI_OK) {
+    LOG("CLI", "capture: nothing running on %s%s", on_link ? "the link at " : "", endpoint);
+    return status;
+  }
+
+  LOG("CLI", "capture: stopped %s%s, %llu frames written, %llu filtered, %llu dropped",
+      on_link ? "link at " : "", endpoint, (unsigned long long)stats.written,
+      (unsigned long long)stats.filtered, (unsigned long long)stats.dropped);
+  return MAGI_OK;
+}
+
+/**
+ * @brief Replay a pcap/pcapng file into an interface and report rates and drops.
+ *
+ * @param topology Topology context.
+ * @param endpoint Interface spec ("Name.Port" or "Name:Port").
+ * @param path Capture file.
+ * @param config Timing, loop count and MAC rewrite.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int cmd_replay(Topology* topology, const char* endpoint, const char* path,
+               const ReplayConfig* config) {
+  Interface* iface = resolve_interface_spec(topology, "replay", endpoint);
+  if (iface == NULL) {
+    return MAGI_ERR_BADARGS;
+  }
+
+  ReplayReport report;
+  int status = replay_run(topology, iface, path, config, &report);
+  if (status != MAGI_OK && report.packets == 0U) {
+    LOG("CLI", "replay: could not read %s as pcap or pcapng", path);
+    return status;
+  }
+  if (status != MAGI_OK) {
+    LOG("CLI", "replay: %s is damaged; stopped after %llu frames", path,
+        (unsigned long long)report.packets);
+  }
+
+  LOG("CLI", "replay: %llu frames (%llu bytes) into %s in %.3f s wall, %.3f s simulated",
+      (unsigned long long)report.packets, (unsigned long long)report.bytes, endpoint,
+      report.wall_sec, report.sim_sec);
+  LOG("CLI", "replay: %.0f packets/s, %.1f Mbit/s", report.pps,
+      report.wall_sec > 0.0 ? (double)report.bytes * 8.0 / report.wall_sec / 1e6 : 0.0);
+  LOG("CLI", "replay: skipped %llu truncated, %llu non-Ethernet",
+      (unsigned long long)report.skipped_truncated, (unsigned long long)report.skipped_linktype);
+  for (int reason = 0; reason < MAGI_NODE_DROP_REASONS; ++reason) {
+    if (report.drops[reason] > 0U) {
+      LOG("CLI", "replay: dropped %-10s %llu", magi_drop_reason_name((MagiNodeCounter)reason),
+          (unsigned long long)report.drops[reason]);
+    }
+  }
+  return status;
+}
+
 /**
  * @brief Dispatch node-scoped subcommands by node type.
  *
@@ -443,7 +840,7 @@ static int dispatch_node_action(Topology* topology, int argc, char** argv) {
       return MAGI_ERR_BADARGS;
     }
     if (argc < 3) {
-      LOG("CLI", "ping: missing target IP. Usage: <host> ping <ip>");
+      LOG("CLI", "ping: missing target IP. Usage: <host> ping <ip> [size] [df]");
       return MAGI_ERR_BADARGS;
     }
 
@@ -452,7 +849,21 @@ static int dispatch_node_action(Topology* topology, int argc, char** argv) {
       return MAGI_ERR_BADARGS;
     }
 
-    return ipv4_host_ping(node_info->node, argv[2]);
+    if (argc < 4) {
+      return ipv4_host_ping(node_info->node, argv[2]);
+    }
+
+    uint32_t size = 0U;
+    if (parse_uint32(argv[3], &size) != MAGI_OK || size > IPV4_PING_MAX_PAYLOAD) {
+      LOG("CLI", "ping: size must be an integer between 0 and %u", IPV4_PING_MAX_PAYLOAD);
+      return MAGI_ERR_BADARGS;
+    }
+    if (argc >= 5 && strcmp(argv[4], "df") != 0) {
+      LOG("CLI", "ping: unknown option '%s'. Usage: <host> ping <ip> [size] [df]", argv[4]);
+      return MAGI_ERR_BADARGS;
+    }
+
+    return ipv4_host_ping_sized(node_info->node, argv[2], size, argc >= 5);
   }
 
   if (strcmp(argv[1], "traceroute") == 0) {
@@ -519,7 +930,7 @@ static int dispatch_node_action(Topology* topology, int argc, char** argv) {
     }
 
     Node* node = node_info->node;
-    HashMap* reg = (HashMap*)l4_host_get_registry(node);
+    PortRegistry* reg = l4_host_get_registry(node);
     if (reg == NULL) {
       LOG(argv[0], "tcp_connect: L4 is not attached (port registry missing)");
       return MAGI_ERR_BADARGS;
@@ -533,14 +944,14 @@ static int dispatch_node_action(Topology* topology, int argc, char** argv) {
     }
 
     /* Bind to ephemeral local port and register */
-    sock->local_port = (uint16_t)(49152U + ((uintptr_t)sock & 0x3FFFU));
-    uint16_t local_port_tmp = sock->local_port;
-    int status = port_registry_bind(reg, PORT_PROTOCOL_TCP, local_port_tmp, sock);
+    uint16_t local_port_tmp = 0U;
+    int status = port_registry_bind_ephemeral(reg, PORT_PROTOCOL_TCP, sock, &local_port_tmp);
     if (status != MAGI_OK) {
-      LOG(argv[0], "tcp_connect: failed to bind to local port %u", (unsigned)local_port_tmp);
+      LOG(argv[0], "tcp_connect: no free ephemeral port");
       tcp_socket_free(sock);
       return status;
     }
+    sock->local_port = local_port_tmp;
 
     /* Initiate connection */
     LOG(argv[0], "TCP connect to %s:%u (local port %u)...", argv[2], (unsigned)remote_port,
@@ -552,6 +963,7 @@ static int dispatch_node_action(Topology* topology, int argc, char** argv) {
       tcp_socket_free(sock);
       return status;
     }
+    (void)sim_run_until_cond(tcp_handshake_done, sock, MAGI_SOCKET_WAIT_MS * SIM_NS_PER_MS);
 
     if (sock->state == TCP_ESTABLISHED) {
       LOG(argv[0], "TCP connection established (3-way handshake complete)");
@@ -561,6 +973,7 @@ static int dispatch_node_action(Topology* topology, int argc, char** argv) {
       status = tcp_socket_send(sock, node, hello, sizeof(hello) - 1U);
       if (status == MAGI_OK) {
         LOG(argv[0], "TCP sent %zu bytes", sizeof(hello) - 1U);
+        (void)sim_run_until_cond(tcp_reply_ready, sock, MAGI_SOCKET_WAIT_MS * SIM_NS_PER_MS);
       }
 
       /* Read any data that arrived */
@@ -692,9 +1105,10 @@ int cmd_exit(void) {
  * @brief Dispatch one tokenized CLI command line.
  *
  * Matches argv[0] against known root-level commands (help, exit, quit,
- * create, link, unlink, topology, save, load). If no match is found,
- * falls through to dispatch_node_action() which treats argv[0] as a
- * node name for node-scoped subcommands.
+ * create, link, unlink, topology, save, load, clock, log, stats,
+ * replay, capture). If no match is found, falls through to
+ * dispatch_node_action() which treats argv[0] as a node name for
+ * node-scoped subcommands.
  *
  * @param topology Mutable topology context.
  * @param argc Number of tokens in argv.
@@ -728,9 +1142,16 @@ int commands_dispatch(Topology* topology, int argc, char** argv) {
   if (strcmp(argv[0], "link") == 0) {
     uint32_t delay_ms = 0U;
     uint16_t mtu = 1500U;
+    uint64_t bandwidth_bps = 0U;
+    LinkQueueConfig queue = {.kind = LINK_QUEUE_FIFO, .limit = LINK_QUEUE_DEFAULT_LIMIT};
+
+    if (argc == 2 && strcmp(argv[1], "stats") == 0) {
+      return cmd_link_stats(topology);
+    }
 
     if (argc < 3) {
-      LOG("CLI", "link: missing arguments. Usage: link <dev1> <dev2> [delay_ms] [mtu]");
+      LOG("CLI", "link: missing arguments. Usage: link <dev1> <dev2> [delay_ms] [mtu] "
+                 "[bandwidth] [fifo|red] [queue_limit]");
       return MAGI_ERR_BADARGS;
     }
 
@@ -748,7 +1169,28 @@ int commands_dispatch(Topology* topology, int argc, char** argv) {
       }
     }
 
-    return cmd_link(topology, argv[1], argv[2], delay_ms, mtu);
+    if (argc >= 6) {
+      if (!link_parse_rate(argv[5], &bandwidth_bps)) {
+        LOG("CLI", "link: invalid bandwidth '%s'. Use bits/s, optionally with k, M or G", argv[5]);
+        return MAGI_ERR_BADARGS;
+      }
+    }
+
+    if (argc >= 7) {
+      if (!link_parse_queue_kind(argv[6], &queue.kind)) {
+        LOG("CLI", "link: invalid queue discipline '%s'. Must be fifo or red", argv[6]);
+        return MAGI_ERR_BADARGS;
+      }
+    }
+
+    if (argc >= 8) {
+      if (parse_uint32(argv[7], &queue.limit) != MAGI_OK || queue.limit == 0U) {
+        LOG("CLI", "link: invalid queue limit '%s'. Must be a positive integer", argv[7]);
+        return MAGI_ERR_BADARGS;
+      }
+    }
+
+    return cmd_link(topology, argv[1], argv[2], delay_ms, mtu, bandwidth_bps, &queue);
   }
 
   if (strcmp(argv[0], "unlink") == 0) {
@@ -772,5 +1214,144 @@ int commands_dispatch(Topology* topology, int argc, char** argv) {
     return cmd_load(topology, argc >= 2 ? argv[1] : NULL);
   }
 
+  if (strcmp(argv[0], "clock") == 0) {
+    if (argc == 1) {
+      return cmd_clock();
+    }
+
+    if (strcmp(argv[1], "advance") == 0) {
+      uint32_t delta_ms = 0U;
+      if (argc < 3 || parse_uint32(argv[2], &delta_ms) != MAGI_OK) {
+        LOG("CLI", "clock: usage: clock advance <ms>");
+        return MAGI_ERR_BADARGS;
+      }
+      return cmd_clock_advance(delta_ms);
+    }
+
+    if (strcmp(argv[1], "realtime") == 0 && argc >= 3 &&
+        (strcmp(argv[2], "on") == 0 || strcmp(argv[2], "off") == 0)) {
+      return cmd_clock_realtime(strcmp(argv[2], "on") == 0);
+    }
+
+    LOG("CLI", "clock: usage: clock [advance <ms> | realtime <on|off>]");
+    return MAGI_ERR_BADARGS;
+  }
+
+  if (strcmp(argv[0], "log") == 0) {
+    if (argc == 1) {
+      return cmd_log();
+    }
+
+    if (strcmp(argv[1], "level") == 0 && argc >= 3) {
+      return cmd_log_level(argv[2]);
+    }
+
+    if (strcmp(argv[1], "sink") == 0 && argc >= 3 &&
+        (strcmp(argv[2], "sync") == 0 || strcmp(argv[2], "ring") == 0)) {
+      return cmd_log_sink(strcmp(argv[2], "ring") == 0 ? MAGI_LOG_SINK_RING : MAGI_LOG_SINK_SYNC);
+    }
+
+    LOG("CLI", "log: usage: log [level <spec> | sink <sync|ring>]");
+    return MAGI_ERR_BADARGS;
+  }
+
+  if (strcmp(argv[0], "stats") == 0) {
+    if (argc == 1) {
+      return cmd_stats(topology, NULL);
+    }
+
+    TopologyStatsFormat format = TOPOLOGY_STATS_JSON;
+    if (topology_stats_parse_format(argv[1], &format)) {
+      return cmd_stats_export(topology, format, argc >= 3 ? argv[2] : NULL);
+    }
+
+    if (strcmp(argv[1], "reset") == 0) {
+      return cmd_stats_reset(topology);
+    }
+
+    return cmd_stats(topology, argv[1]);
+  }
+
+  if (strcmp(argv[0], "replay") == 0) {
+    if (argc < 3) {
+      LOG("CLI", "replay: usage: replay <node>.<port> <file> [original|fast|x<speed>] "
+                 "[loops <n>] [dstmac]");
+      return MAGI_ERR_BADARGS;
+    }
+
+    ReplayConfig config = {.timing = REPLAY_TIMING_ORIGINAL, .loops = 1U};
+    for (int next = 3; next < argc; ++next) {
+      if (strcmp(argv[next], "loops") == 0 && next + 1 < argc) {
+        if (parse_uint32(argv[++next], &config.loops) != MAGI_OK || config.loops == 0U) {
+          LOG("CLI", "replay: loops must be a positive integer");
+          return MAGI_ERR_BADARGS;
+        }
+      } else if (strcmp(argv[next], "dstmac") == 0) {
+        config.rewrite_dst_mac = true;
+      } else if (!replay_parse_timing(argv[next], &config)) {
+        LOG("CLI", "replay: unexpected '%s'", argv[next]);
+        return MAGI_ERR_BADARGS;
+      }
+    }
+
+    return cmd_replay(topology, argv[1], argv[2], &config);
+  }
+
+  if (strcmp(argv[0], "capture") == 0) {
+    if (argc == 1) {
+      return cmd_capture_list(topology);
+    }
+
+    bool start = strcmp(argv[1], "start") == 0;
+    bool stop = strcmp(argv[1], "stop") == 0;
+    int next = 2;
+    bool on_link = next < argc && strcmp(argv[next], "link") == 0;
+    next += on_link ? 1 : 0;
+    if (stop && next + 1 == argc) {
+      return cmd_capture_stop(topology, argv[next], on_link);
+    }
+
+    if (!start || next + 2 > argc) {
+      LOG("CLI", "capture: usage: capture [start|stop] [link] <node>.<port> [file] "
+                 "[snaplen <n>] [filter <expr>]");
+      return MAGI_ERR_BADARGS;
+    }
+
+    const char* endpoint = argv[next];
+    const char* path = argv[next + 1];
+    CaptureConfig config = {0};
+    char filter[256] = "";
+    for (next += 2; next < argc; ++next) {
+      if (strcmp(argv[next], "snaplen") == 0 && next + 1 < argc) {
+        if (parse_uint32(argv[++next], &config.snaplen) != MAGI_OK || config.snaplen == 0U ||
+            config.snaplen > CAPTURE_MAX_SNAPLEN) {
+          LOG("CLI", "capture: snaplen must be between 1 and %u", CAPTURE_MAX_SNAPLEN);
+          return MAGI_ERR_BADARGS;
+        }
+        continue;
+      }
+      if (strcmp(argv[next], "filter") == 0 && next + 1 < argc) {
+        /* The filter is the rest of the line. */
+        for (++next; next < argc; ++next) {
+          size_t used = strlen(filter);
+          snprintf(filter + used, sizeof(filter) - used, "%s%s", used > 0U ? " " : "",
+                   argv[next]);
+        }
+        config.filter = filter;
+        break;
+      }
+      LOG("CLI", "capture: unexpected '%s'", argv[next]);
+      return MAGI_ERR_BADARGS;
+    }
+
+    CaptureFilter compiled;
+    if (capture_filter_compile(config.filter, &compiled) != MAGI_OK) {
+      LOG("CLI", "capture: bad filter '%s'", filter);
+      return MAGI_ERR_BADARGS;
+    }
+
+    return cmd_capture_start(topology, endpoint, on_link, path, &config);
+  }
+
   return dispatch_node_action(topology, argc, argv);
 }
@@ -10,7 +10,11 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "core/capture.h"
+#include "topology/replay.h"
+#include "topology/stats_export.h"
 #include "topology/topology.h"
+#include "utils/log.h"
 
 /** Continue CLI loop after command execution. */
 #define CLI_CONTINUE 0
@@ -50,10 +54,20 @@ int cmd_create(Topology* topology, const char* type, const char* name);
  * @param dev2 Endpoint spec (name or name:port).
  * @param delay_ms Link delay in milliseconds.
  * @param mtu Link MTU in bytes.
+ * @param bandwidth_bps Line rate in bits per second, or 0 for unlimited.
+ * @param queue Egress queue configuration, or NULL for the default FIFO.
  * @return MAGI_OK on success, otherwise an error code.
  */
 int cmd_link(Topology* topology, const char* dev1, const char* dev2, uint32_t delay_ms,
-             uint16_t mtu);
+             uint16_t mtu, uint64_t bandwidth_bps, const LinkQueueConfig* queue);
+
+/**
+ * @brief Print every link with per-direction traffic counters.
+ *
+ * @param topology Topology context.
+ * @return MAGI_OK.
+ */
+int cmd_link_stats(Topology* topology);
 
 /**
  * @brief Remove an existing link between two endpoints.
@@ -91,6 +105,122 @@ int cmd_save(Topology* topology, const char* filename);
  */
 int cmd_load(Topology* topology, const char* filename);
 
+/**
+ * @brief Print the simulation clock and pacing mode.
+ *
+ * @return MAGI_OK.
+ */
+int cmd_clock(void);
+
+/**
+ * @brief Advance the simulation clock, running every event due on the way.
+ *
+ * @param delta_ms Simulated milliseconds to advance by.
+ * @return MAGI_OK, or MAGI_ERR_BADARGS in async builds, which run on wall time.
+ */
+int cmd_clock_advance(uint32_t delta_ms);
+
+/**
+ * @brief Turn real-time pacing of simulation events on or off.
+ *
+ * @param enabled true to sleep through simulated delays.
+ * @return MAGI_OK.
+ */
+int cmd_clock_realtime(bool enabled);
+
+/**
+ * @brief Print the log sink, per-subsystem levels and ring drop count.
+ *
+ * @return MAGI_OK.
+ */
+int cmd_log(void);
+
+/**
+ * @brief Apply a log level spec such as "warn" or "info,l3=debug".
+ *
+ * @param spec Level spec (see magi_log_apply_spec()).
+ * @return MAGI_OK, or MAGI_ERR_BADARGS for a malformed spec.
+ */
+int cmd_log_level(const char* spec);
+
+/**
+ * @brief Switch between synchronous and ring-buffer log output.
+ *
+ * @param sink New sink.
+ * @return MAGI_OK, or an error code if the ring sink cannot start.
+ */
+int cmd_log_sink(MagiLogSink sink);
+
+/**
+ * @brief Print packet, drop, ARP and FIB counters.
+ *
+ * @param topology Topology context.
+ * @param node_name Node to show, or NULL for every node.
+ * @return MAGI_OK, or MAGI_ERR_BADARGS for an unknown node.
+ */
+int cmd_stats(Topology* topology, const char* node_name);
+
+/**
+ * @brief Dump every counter as JSON or OpenMetrics text.
+ *
+ * @param topology Topology context.
+ * @param format Output format.
+ * @param filename Output path, or NULL for stdout.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int cmd_stats_export(Topology* topology, TopologyStatsFormat format, const char* filename);
+
+/**
+ * @brief Zero every node, interface and link counter.
+ *
+ * @param topology Topology context.
+ * @return MAGI_OK.
+ */
+int cmd_stats_reset(Topology* topology);
+
+/**
+ * @brief List every running capture with its counters.
+ *
+ * @param topology Topology context.
+ * @return MAGI_OK.
+ */
+int cmd_capture_list(Topology* topology);
+
+/**
+ * @brief Start a pcapng capture on an interface or on the link attached to it.
+ *
+ * @param topology Topology context.
+ * @param endpoint Interface spec ("Name.Port" or "Name:Port").
+ * @param on_link Capture the interface's link rather than the interface.
+ * @param path Output file.
+ * @param config Snap length and filter.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int cmd_capture_start(Topology* topology, const char* endpoint, bool on_link, const char* path,
+                      const CaptureConfig* config);
+
+/**
+ * @brief Stop a capture and report what it wrote.
+ *
+ * @param topology Topology context.
+ * @param endpoint Interface spec ("Name.Port" or "Name:Port").
+ * @param on_link Stop the capture on the interface's link.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int cmd_capture_stop(Topology* topology, const char* endpoint, bool on_link);
+
+/**
+ * @brief Replay a pcap/pcapng file into an interface and report rates and drops.
+ *
+ * @param topology Topology context.
+ * @param endpoint Interface spec ("Name.Port" or "Name:Port").
+ * @param path Capture file.
+ * @param config Timing, loop count and MAC rewrite.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int cmd_replay(Topology* topology, const char* endpoint, const char* path,
+               const ReplayConfig* config);
+
 /**
  * @brief Request clean CLI shutdown.
  *
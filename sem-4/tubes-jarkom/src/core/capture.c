@@ -0,0 +1,779 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "capture.h"
+
+#include "core/interface.h"
+#include "core/link.h"
+#include "core/node.h"
+#include "core/sim.h"
+#include "core/stats.h"
+#include "utils/magi_error.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** Writer thread sleep when the ring is empty. */
+#define CAPTURE_IDLE_NS 1000000L
+/** stdio buffer of the output file. */
+#define CAPTURE_FILE_BUFFER (256U * 1024U)
+/** Fewest ring slots, whatever ring_bytes says. */
+#define CAPTURE_MIN_SLOTS 16U
+/** Longest filter expression. */
+#define CAPTURE_FILTER_TEXT_MAX 256U
+
+/* pcapng block types, option codes and link type. */
+#define PCAPNG_SHB 0x0A0D0D0AU
+#define PCAPNG_IDB 0x00000001U
+#define PCAPNG_EPB 0x00000006U
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4DU
+#define PCAPNG_OPT_END 0U
+#define PCAPNG_OPT_IF_NAME 2U
+#define PCAPNG_OPT_IF_TSRESOL 9U
+#define PCAPNG_OPT_EPB_FLAGS 2U
+#define PCAPNG_LINKTYPE_ETHERNET 1U
+
+#define ETHERTYPE_IPV4 0x0800U
+#define ETHERTYPE_ARP 0x0806U
+#define ETHERTYPE_VLAN 0x8100U
+
+/**
+ * @brief Filter primitive kinds.
+ */
+enum {
+  FILTER_ETHERTYPE = 1,
+  FILTER_VLAN,
+  FILTER_VLAN_ANY,
+  FILTER_HOST,
+  FILTER_SRC_HOST,
+  FILTER_DST_HOST,
+  FILTER_NET,
+  FILTER_PROTO,
+  FILTER_PORT,
+  FILTER_SRC_PORT,
+  FILTER_DST_PORT,
+};
+
+/**
+ * @brief Capture counters, kept in a MagiCounters block.
+ */
+enum {
+  CAPTURE_SEEN = 0,
+  CAPTURE_FILTERED,
+  CAPTURE_WRITTEN,
+  CAPTURE_DROPPED,
+  CAPTURE_COUNTER_COUNT,
+};
+
+/**
+ * @brief One ring slot, followed by snaplen bytes of frame.
+ *
+ * seq follows the same bounded MPMC scheme as the log ring: a producer
+ * fills the slot when seq equals its ticket and publishes ticket + 1; the
+ * writer empties it at head + 1 and hands it to the next lap.
+ */
+typedef struct CaptureSlot {
+  atomic_size_t seq;
+  uint64_t ts_ns;
+  uint32_t orig_len;
+  uint32_t cap_len;
+  uint32_t if_index;
+  uint32_t flags;
+  uint8_t data[];
+} CaptureSlot;
+
+struct Capture {
+  CaptureFilter filter;
+  uint32_t snaplen;
+  uint32_t if_count;
+  /* Producer side. */
+  uint8_t* slots;
+  size_t slot_stride;
+  size_t slot_count;
+  atomic_size_t tail;
+  MagiCounters counters;
+  /* Writer side, guarded by drain_lock. */
+  pthread_mutex_t drain_lock;
+  size_t head;
+  FILE* file;
+  char* path;
+  pthread_t thread;
+  atomic_bool stop;
+};
+
+/**
+ * @brief Parsed fields of a frame that filters look at.
+ */
+typedef struct CaptureView {
+  uint16_t ethertype;
+  bool has_vlan;
+  uint16_t vlan_id;
+  bool has_ip;
+  uint8_t proto;
+  uint32_t src;
+  uint32_t dst;
+  bool has_ports;
+  uint16_t sport;
+  uint16_t dport;
+} CaptureView;
+
+static uint16_t read_be16(const uint8_t* bytes) {
+  return (uint16_t)((bytes[0] << 8) | bytes[1]);
+}
+
+static uint32_t read_be32(const uint8_t* bytes) {
+  return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) |
+         (uint32_t)bytes[3];
+}
+
+/**
+ * @brief Parse a dotted-quad address into host order.
+ */
+static bool parse_ipv4(const char* text, uint32_t* out) {
+  unsigned int octets[4];
+  char tail = '\0';
+  if (sscanf(text, "%u.%u.%u.%u%c", &octets[0], &octets[1], &octets[2], &octets[3], &tail) != 4) {
+    return false;
+  }
+  uint32_t value = 0U;
+  for (size_t index = 0U; index < 4U; ++index) {
+    if (octets[index] > 255U) {
+      return false;
+    }
+    value = (value << 8) | octets[index];
+  }
+  *out = value;
+  return true;
+}
+
+/**
+ * @brief Parse an unsigned number (decimal or 0x hex) no larger than max.
+ */
+static bool parse_number(const char* text, uint32_t max, uint32_t* out) {
+  if (text == NULL || *text == '\0' || *text == '-') {
+    return false;
+  }
+  char* end = NULL;
+  int base = text[0] == '0' && (text[1] == 'x' || text[1] == 'X') ? 16 : 10;
+  unsigned long value = strtoul(text, &end, base);
+  if (*end != '\0' || value > max) {
+    return false;
+  }
+  *out = (uint32_t)value;
+  return true;
+}
+
+/**
+ * @brief Compile one primitive starting at tokens[*pos].
+ */
+static bool compile_term(char** tokens, size_t count, size_t* pos, CaptureFilterTerm* term) {
+  const char* word = tokens[*pos];
+  const char* arg = *pos + 1U < count ? tokens[*pos + 1U] : NULL;
+  const char* arg2 = *pos + 2U < count ? tokens[*pos + 2U] : NULL;
+  *term = (CaptureFilterTerm){0};
+  *pos += 1U;
+
+  if (strcmp(word, "ip") == 0 || strcmp(word, "arp") == 0) {
+    term->kind = FILTER_ETHERTYPE;
+    term->value = word[0] == 'i' ? ETHERTYPE_IPV4 : ETHERTYPE_ARP;
+    return true;
+  }
+  if (strcmp(word, "tcp") == 0 || strcmp(word, "udp") == 0 || strcmp(word, "icmp") == 0) {
+    term->kind = FILTER_PROTO;
+    term->value = word[0] == 't' ? 6U : (word[0] == 'u' ? 17U : 1U);
+    return true;
+  }
+  if (strcmp(word, "vlan") == 0) {
+    if (arg != NULL && parse_number(arg, 4095U, &term->value)) {
+      term->kind = FILTER_VLAN;
+      *pos += 1U;
+    } else {
+      term->kind = FILTER_VLAN_ANY;
+    }
+    return true;
+  }
+  if (strcmp(word, "ether") == 0) {
+    if (arg == NULL || arg2 == NULL || strcmp(arg, "proto") != 0) {
+      return false;
+    }
+    *pos += 2U;
+    term->kind = FILTER_ETHERTYPE;
+    if (strcmp(arg2, "ip") == 0) {
+      term->value = ETHERTYPE_IPV4;
+      return true;
+    }
+    if (strcmp(arg2, "arp") == 0) {
+      term->value = ETHERTYPE_ARP;
+      return true;
+    }
+    return parse_number(arg2, 0xFFFFU, &term->value);
+  }
+  if (strcmp(word, "proto") == 0) {
+    term->kind = FILTER_PROTO;
+    *pos += 1U;
+    return parse_number(arg, 255U, &term->value);
+  }
+  if (strcmp(word, "net") == 0) {
+    const char* slash = arg != NULL ? strchr(arg, '/') : NULL;
+    char address[16];
+    uint32_t prefix = 0U;
+    if (slash == NULL || (size_t)(slash - arg) >= sizeof(address) ||
+        !parse_number(slash + 1, 32U, &prefix)) {
+      return false;
+    }
+    memcpy(address, arg, (size_t)(slash - arg));
+    address[slash - arg] = '\0';
+    term->kind = FILTER_NET;
+    term->mask = prefix == 0U ? 0U : 0xFFFFFFFFU << (32U - prefix);
+    *pos += 1U;
+    if (!parse_ipv4(address, &term->value)) {
+      return false;
+    }
+    term->value &= term->mask;
+    return true;
+  }
+
+  /* [src|dst] host <ip> and [src|dst] port <n>. */
+  int side = 0;
+  if (strcmp(word, "src") == 0 || strcmp(word, "dst") == 0) {
+    side = word[0] == 's' ? 1 : 2;
+    word = arg;
+    arg = arg2;
+    *pos += 1U;
+  }
+  if (word == NULL || arg == NULL) {
+    return false;
+  }
+  *pos += 1U;
+  if (strcmp(word, "host") == 0) {
+    term->kind = side == 0 ? FILTER_HOST : (side == 1 ? FILTER_SRC_HOST : FILTER_DST_HOST);
+    return parse_ipv4(arg, &term->value);
+  }
+  if (strcmp(word, "port") == 0) {
+    term->kind = side == 0 ? FILTER_PORT : (side == 1 ? FILTER_SRC_PORT : FILTER_DST_PORT);
+    return parse_number(arg, 0xFFFFU, &term->value);
+  }
+  return false;
+}
+
+int capture_filter_compile(const char* text, CaptureFilter* out) {
+  if (out == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+  out->count = 0U;
+  if (text == NULL || *text == '\0') {
+    return MAGI_OK;
+  }
+
+  char buffer[CAPTURE_FILTER_TEXT_MAX];
+  if (strlen(text) >= sizeof(buffer)) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+  snprintf(buffer, sizeof(buffer), "%s", text);
+
+  char* tokens[CAPTURE_FILTER_TEXT_MAX / 2U];
+  size_t token_count = 0U;
+  char* save = NULL;
+  for (char* token = strtok_r(buffer, " \t", &save); token != NULL;
+       token = strtok_r(NULL, " \t", &save)) {
+    tokens[token_count++] = token;
+  }
+
+  size_t pos = 0U;
+  bool expect_term = true;
+  while (pos < token_count) {
+    if (!expect_term) {
+      if (strcmp(tokens[pos], "and") != 0 && strcmp(tokens[pos], "&&") != 0) {
+        break;
+      }
+      pos++;
+      expect_term = true;
+      continue;
+    }
+    if (out->count == CAPTURE_FILTER_MAX_TERMS ||
+        !compile_term(tokens, token_count, &pos, &out->terms[out->count])) {
+      break;
+    }
+    out->count++;
+    expect_term = false;
+  }
+
+  if (pos < token_count || expect_term) {
+    out->count = 0U;
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+  return MAGI_OK;
+}
+
+/**
+ * @brief Pull the filtered-on fields out of a frame.
+ */
+static void capture_parse(const uint8_t* frame, size_t len, CaptureView* view) {
+  *view = (CaptureView){0};
+  if (len < 14U) {
+    return;
+  }
+  size_t offset = 12U;
+  view->ethertype = read_be16(frame + offset);
+  if (view->ethertype == ETHERTYPE_VLAN && len >= 18U) {
+    view->has_vlan = true;
+    view->vlan_id = read_be16(frame + 14U) & 0x0FFFU;
+    offset += 4U;
+    view->ethertype = read_be16(frame + offset);
+  }
+  offset += 2U;
+
+  if (view->ethertype != ETHERTYPE_IPV4 || len < offset + 20U) {
+    return;
+  }
+  const uint8_t* ip = frame + offset;
+  size_t header_len = (size_t)(ip[0] & 0x0FU) * 4U;
+  if ((ip[0] >> 4) != 4U || header_len < 20U || len < offset + header_len) {
+    return;
+  }
+  view->has_ip = true;
+  view->proto = ip[9];
+  view->src = read_be32(ip + 12);
+  view->dst = read_be32(ip + 16);
+
+  /* Only the first fragment carries the transport header. */
+  bool first_fragment = (read_be16(ip + 6) & 0x1FFFU) == 0U;
+  if (first_fragment && (view->proto == 6U || view->proto == 17U) &&
+      len >= offset + header_len + 4U) {
+    view->has_ports = true;
+    view->sport = read_be16(ip + header_len);
+    view->dport = read_be16(ip + header_len + 2U);
+  }
+}
+
+/**
+ * @brief Test one primitive against a parsed frame.
+ */
+static bool term_matches(const CaptureFilterTerm* term, const CaptureView* view) {
+  switch (term->kind) {
+    case FILTER_ETHERTYPE:
+      return view->ethertype == term->value;
+    case FILTER_VLAN:
+      return view->has_vlan && view->vlan_id == term->value;
+    case FILTER_VLAN_ANY:
+      return view->has_vlan;
+    case FILTER_HOST:
+      return view->has_ip && (view->src == term->value || view->dst == term->value);
+    case FILTER_SRC_HOST:
+      return view->has_ip && view->src == term->value;
+    case FILTER_DST_HOST:
+      return view->has_ip && view->dst == term->value;
+    case FILTER_NET:
+      return view->has_ip &&
+             ((view->src & term->mask) == term->value || (view->dst & term->mask) == term->value);
+    case FILTER_PROTO:
+      return view->has_ip && view->proto == term->value;
+    case FILTER_PORT:
+      return view->has_ports && (view->sport == term->value || view->dport == term->value);
+    case FILTER_SRC_PORT:
+      return view->has_ports && view->sport == term->value;
+    case FILTER_DST_PORT:
+      return view->has_ports && view->dport == term->value;
+    default:
+      return false;
+  }
+}
+
+bool capture_filter_match(const CaptureFilter* filter, const uint8_t* frame, size_t len) {
+  if (filter == NULL || filter->count == 0U) {
+    return true;
+  }
+  if (frame == NULL) {
+    return false;
+  }
+
+  CaptureView view;
+  capture_parse(frame, len, &view);
+  for (size_t index = 0U; index < filter->count; ++index) {
+    if (!term_matches(&filter->terms[index], &view)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static CaptureSlot* capture_slot(const Capture* capture, size_t pos) {
+  return (CaptureSlot*)(capture->slots + (pos & (capture->slot_count - 1U)) * capture->slot_stride);
+}
+
+static size_t pad4(size_t len) {
+  return (len + 3U) & ~(size_t)3U;
+}
+
+/**
+ * @brief Append one pcapng option (code, length, value padded to 4 bytes).
+ *
+ * @return Bytes written to out.
+ */
+static size_t put_option(uint8_t* out, uint16_t code, const void* value, uint16_t len) {
+  memcpy(out, &code, 2U);
+  memcpy(out + 2U, &len, 2U);
+  memset(out + 4U, 0, pad4(len));
+  if (len > 0U) {
+    memcpy(out + 4U, value, len);
+  }
+  return 4U + pad4(len);
+}
+
+/**
+ * @brief Write the Section Header Block and one Interface Description Block per name.
+ */
+static bool capture_write_header(Capture* capture, const char* const* if_names) {
+  uint32_t shb[7] = {PCAPNG_SHB, 28U, PCAPNG_BYTE_ORDER_MAGIC, 1U, 0xFFFFFFFFU, 0xFFFFFFFFU, 28U};
+  /* Version 1.0 is two 16-bit fields; a section length of -1 means "not given". */
+  uint16_t version[2] = {1U, 0U};
+  memcpy(&shb[3], version, sizeof(version));
+  if (fwrite(shb, sizeof(shb), 1U, capture->file) != 1U) {
+    return false;
+  }
+
+  for (size_t index = 0U; index < capture->if_count; ++index) {
+    uint8_t block[320];
+    size_t name_len = strnlen(if_names[index], 128U);
+    uint16_t linktype = PCAPNG_LINKTYPE_ETHERNET;
+    uint16_t reserved = 0U;
+    uint8_t tsresol = 9U;
+    size_t len = 8U;
+    memcpy(block + len, &linktype, 2U);
+    memcpy(block + len + 2U, &reserved, 2U);
+    memcpy(block + len + 4U, &capture->snaplen, 4U);
+    len += 8U;
+    len += put_option(block + len, PCAPNG_OPT_IF_NAME, if_names[index], (uint16_t)name_len);
+    len += put_option(block + len, PCAPNG_OPT_IF_TSRESOL, &tsresol, 1U);
+    len += put_option(block + len, PCAPNG_OPT_END, NULL, 0U);
+    uint32_t type = PCAPNG_IDB;
+    uint32_t total = (uint32_t)(len + 4U);
+    memcpy(block, &type, 4U);
+    memcpy(block + 4U, &total, 4U);
+    memcpy(block + len, &total, 4U);
+    if (fwrite(block, total, 1U, capture->file) != 1U) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Write one slot as an Enhanced Packet Block.
+ */
+static void capture_write_slot(Capture* capture, const CaptureSlot* slot) {
+  static const uint8_t zeros[4] = {0};
+  size_t padded = pad4(slot->cap_len);
+  uint32_t total = (uint32_t)(28U + padded + 12U + 4U);
+  uint32_t header[7] = {PCAPNG_EPB,
+                        total,
+                        slot->if_index,
+                        (uint32_t)(slot->ts_ns >> 32),
+                        (uint32_t)slot->ts_ns,
+                        slot->cap_len,
+                        slot->orig_len};
+  uint8_t trailer[16];
+  size_t trailer_len = put_option(trailer, PCAPNG_OPT_EPB_FLAGS, &slot->flags, 4U);
+  trailer_len += put_option(trailer + trailer_len, PCAPNG_OPT_END, NULL, 0U);
+  memcpy(trailer + trailer_len, &total, 4U);
+  trailer_len += 4U;
+
+  fwrite(header, sizeof(header), 1U, capture->file);
+  fwrite(slot->data, 1U, slot->cap_len, capture->file);
+  fwrite(zeros, 1U, padded - slot->cap_len, capture->file);
+  fwrite(trailer, 1U, trailer_len, capture->file);
+}
+
+/**
+ * @brief Write out every published slot in order. Caller holds drain_lock.
+ *
+ * @return Number of frames written.
+ */
+static size_t capture_drain_locked(Capture* capture) {
+  size_t drained = 0U;
+  for (;;) {
+    CaptureSlot* slot = capture_slot(capture, capture->head);
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != capture->head + 1U) {
+      break;
+    }
+    capture_write_slot(capture, slot);
+    atomic_store_explicit(&slot->seq, capture->head + capture->slot_count, memory_order_release);
+    capture->head++;
+    drained++;
+  }
+  if (drained > 0U) {
+    magi_counter_add(&capture->counters, CAPTURE_WRITTEN, drained);
+    fflush(capture->file);
+  }
+  return drained;
+}
+
+/**
+ * @brief Writer thread: empty the ring, sleeping briefly whenever it is idle.
+ */
+static void* capture_thread_main(void* arg) {
+  Capture* capture = arg;
+  const struct timespec idle = {.tv_sec = 0, .tv_nsec = CAPTURE_IDLE_NS};
+  while (!atomic_load_explicit(&capture->stop, memory_order_acquire)) {
+    pthread_mutex_lock(&capture->drain_lock);
+    size_t drained = capture_drain_locked(capture);
+    pthread_mutex_unlock(&capture->drain_lock);
+    if (drained == 0U) {
+      nanosleep(&idle, NULL);
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Release a capture's memory; the file and thread are already gone.
+ */
+static void capture_destroy(Capture* capture) {
+  magi_counters_free(&capture->counters);
+  pthread_mutex_destroy(&capture->drain_lock);
+  free(capture->slots);
+  free(capture->path);
+  free(capture);
+}
+
+Capture* capture_open(const char* path, const CaptureConfig* config, const char* const* if_names,
+                      size_t if_count) {
+  CaptureConfig defaults = {0};
+  if (config == NULL) {
+    config = &defaults;
+  }
+  if (path == NULL || if_names == NULL || if_count == 0U || if_count > 2U ||
+      config->snaplen > CAPTURE_MAX_SNAPLEN) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return NULL;
+  }
+
+  Capture* capture = calloc(1U, sizeof(*capture));
+  if (capture == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+  if (capture_filter_compile(config->filter, &capture->filter) != MAGI_OK) {
+    free(capture);
+    return NULL;
+  }
+
+  capture->snaplen = config->snaplen != 0U ? config->snaplen : CAPTURE_DEFAULT_SNAPLEN;
+  capture->if_count = (uint32_t)if_count;
+  capture->slot_stride = (sizeof(CaptureSlot) + capture->snaplen + 63U) & ~(size_t)63U;
+  size_t ring_bytes = config->ring_bytes != 0U ? config->ring_bytes : CAPTURE_DEFAULT_RING_BYTES;
+  capture->slot_count = CAPTURE_MIN_SLOTS;
+  while (capture->slot_count * 2U * capture->slot_stride <= ring_bytes) {
+    capture->slot_count *= 2U;
+  }
+
+  pthread_mutex_init(&capture->drain_lock, NULL);
+  capture->path = strdup(path);
+  capture->slots = aligned_alloc(64U, capture->slot_count * capture->slot_stride);
+  if (capture->path == NULL || capture->slots == NULL ||
+      magi_counters_init(&capture->counters, CAPTURE_COUNTER_COUNT) != MAGI_OK) {
+    capture_destroy(capture);
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+  /* Touch the whole ring now so the data path never takes a page fault on it. */
+  memset(capture->slots, 0, capture->slot_count * capture->slot_stride);
+  for (size_t index = 0U; index < capture->slot_count; ++index) {
+    atomic_init(&capture_slot(capture, index)->seq, index);
+  }
+
+  capture->file = fopen(path, "wb");
+  if (capture->file == NULL) {
+    capture_destroy(capture);
+    magi_errno = MAGI_ERR_BADARGS;
+    return NULL;
+  }
+  setvbuf(capture->file, NULL, _IOFBF, CAPTURE_FILE_BUFFER);
+  if (!capture_write_header(capture, if_names) || fflush(capture->file) != 0 ||
+      pthread_create(&capture->thread, NULL, capture_thread_main, capture) != 0) {
+    fclose(capture->file);
+    capture_destroy(capture);
+    magi_errno = MAGI_ERR_BADARGS;
+    return NULL;
+  }
+  return capture;
+}
+
+void capture_packet(Capture* capture, uint32_t if_index, CaptureDirection direction,
+                    const uint8_t* frame, size_t len) {
+  if (capture == NULL || frame == NULL) {
+    return;
+  }
+
+  magi_counter_add(&capture->counters, CAPTURE_SEEN, 1U);
+  if (capture->filter.count != 0U && !capture_filter_match(&capture->filter, frame, len)) {
+    magi_counter_add(&capture->counters, CAPTURE_FILTERED, 1U);
+    return;
+  }
+
+  size_t pos = atomic_load_explicit(&capture->tail, memory_order_relaxed);
+  CaptureSlot* slot;
+  for (;;) {
+    slot = capture_slot(capture, pos);
+    size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (seq == pos) {
+      if (atomic_compare_exchange_weak_explicit(&capture->tail, &pos, pos + 1U,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if ((ptrdiff_t)(seq - pos) < 0) {
+      magi_counter_add(&capture->counters, CAPTURE_DROPPED, 1U);
+      return;
+    } else {
+      pos = atomic_load_explicit(&capture->tail, memory_order_relaxed);
+    }
+  }
+
+  slot->ts_ns = sim_now_ns();
+  slot->orig_len = (uint32_t)len;
+  slot->cap_len = len < capture->snaplen ? (uint32_t)len : capture->snaplen;
+  slot->if_index = if_index < capture->if_count ? if_index : 0U;
+  slot->flags = (uint32_t)direction;
+  memcpy(slot->data, frame, slot->cap_len);
+  atomic_store_explicit(&slot->seq, pos + 1U, memory_order_release);
+}
+
+void capture_flush(Capture* capture) {
+  if (capture == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&capture->drain_lock);
+  capture_drain_locked(capture);
+  pthread_mutex_unlock(&capture->drain_lock);
+}
+
+void capture_get_stats(const Capture* capture, CaptureStats* out) {
+  if (out == NULL) {
+    return;
+  }
+  *out = (CaptureStats){0};
+  if (capture == NULL) {
+    return;
+  }
+  out->seen = magi_counter_read(&capture->counters, CAPTURE_SEEN);
+  out->filtered = magi_counter_read(&capture->counters, CAPTURE_FILTERED);
+  out->written = magi_counter_read(&capture->counters, CAPTURE_WRITTEN);
+  out->dropped = magi_counter_read(&capture->counters, CAPTURE_DROPPED);
+}
+
+const char* capture_path(const Capture* capture) {
+  return capture != NULL ? capture->path : "";
+}
+
+int capture_close(Capture* capture, CaptureStats* out) {
+  if (capture == NULL) {
+    capture_get_stats(NULL, out);
+    return MAGI_OK;
+  }
+
+  atomic_store_explicit(&capture->stop, true, memory_order_release);
+  pthread_join(capture->thread, NULL);
+  capture_flush(capture);
+  capture_get_stats(capture, out);
+  bool failed = ferror(capture->file) != 0;
+  failed = fclose(capture->file) != 0 || failed;
+  capture_destroy(capture);
+  if (failed) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+  return MAGI_OK;
+}
+
+/**
+ * @brief Wait until no worker is inside a node's turn, so a detached tap is unused.
+ *
+ * Engine workers deliver and send a node's frames while holding its lock.
+ * Must not be called with that lock held.
+ */
+static void capture_quiesce(struct Node* node) {
+#ifdef MAGI_ASYNC
+  if (node != NULL) {
+    pthread_mutex_lock(&node->lock);
+    pthread_mutex_unlock(&node->lock);
+  }
+#else
+  (void)node;
+#endif
+}
+
+/**
+ * @brief Name an interface "node.port" for the file's interface description.
+ */
+static void capture_iface_name(const Interface* iface, char* out, size_t out_len) {
+  snprintf(out, out_len, "%s.%u", iface->node != NULL ? iface->node->name : "?",
+           (unsigned)iface->port_number);
+}
+
+int capture_start_interface(Interface* iface, const char* path, const CaptureConfig* config) {
+  if (iface == NULL || iface->capture != NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  char name[96];
+  capture_iface_name(iface, name, sizeof(name));
+  const char* names[1] = {name};
+  Capture* capture = capture_open(path, config, names, 1U);
+  if (capture == NULL) {
+    return magi_errno;
+  }
+  iface->capture = capture;
+  return MAGI_OK;
+}
+
+int capture_stop_interface(Interface* iface, CaptureStats* out) {
+  if (iface == NULL || iface->capture == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  Capture* capture = iface->capture;
+  iface->capture = NULL;
+  capture_quiesce(iface->node);
+  return capture_close(capture, out);
+}
+
+int capture_start_link(Link* link, const char* path, const CaptureConfig* config) {
+  if (link == NULL || link->capture != NULL || link->endpoint_a == NULL ||
+      link->endpoint_b == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  char name_a[96];
+  char name_b[96];
+  capture_iface_name(link->endpoint_a, name_a, sizeof(name_a));
+  capture_iface_name(link->endpoint_b, name_b, sizeof(name_b));
+  const char* names[2] = {name_a, name_b};
+  Capture* capture = capture_open(path, config, names, 2U);
+  if (capture == NULL) {
+    return magi_errno;
+  }
+  link->capture = capture;
+  return MAGI_OK;
+}
+
+int capture_stop_link(Link* link, CaptureStats* out) {
+  if (link == NULL || link->capture == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  Capture* capture = link->capture;
+  link->capture = NULL;
+  capture_quiesce(link->endpoint_a != NULL ? link->endpoint_a->node : NULL);
+  capture_quiesce(link->endpoint_b != NULL ? link->endpoint_b->node : NULL);
+  return capture_close(capture, out);
+}
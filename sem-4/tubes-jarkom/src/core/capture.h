@@ -0,0 +1,219 @@
+/**
+ * @file capture.h
+ * @brief pcapng packet capture on interfaces and links.
+ *
+ * A capture is attached to an interface (frames it receives and sends) or
+ * to a link (frames sent by either endpoint). The data path copies each
+ * frame that passes the filter, cut to the snap length, into a ring of
+ * preallocated slots and returns; a background thread writes the ring out
+ * as pcapng Enhanced Packet Blocks. When the ring is full, frames are
+ * dropped and counted rather than blocking the sender.
+ *
+ * Frames are written exactly as they sit on the wire, so 802.1Q tags are
+ * kept. Timestamps are sim_now_ns() at nanosecond resolution: simulated
+ * time from zero in the sequential build, CLOCK_MONOTONIC with MAGI_ASYNC.
+ *
+ * Filters are primitives joined by "and":
+ *   ether proto <n|ip|arp>, ip, arp, vlan [id], host|src host|dst host <a.b.c.d>,
+ *   net <a.b.c.d/len>, tcp, udp, icmp, proto <n>, port|src port|dst port <n>.
+ * IP primitives look past one VLAN tag; port primitives match TCP and UDP.
+ */
+
+#ifndef MAGI_CORE_CAPTURE_H
+#define MAGI_CORE_CAPTURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct Interface;
+struct Link;
+
+/** Snap length used when the config leaves it at 0: a full 1500-byte MTU frame plus tags. */
+#define CAPTURE_DEFAULT_SNAPLEN 2048U
+/** Largest accepted snap length. */
+#define CAPTURE_MAX_SNAPLEN 65535U
+/** Ring memory used when the config leaves it at 0. */
+#define CAPTURE_DEFAULT_RING_BYTES (4U * 1024U * 1024U)
+/** Most filter primitives in one expression. */
+#define CAPTURE_FILTER_MAX_TERMS 8U
+
+typedef struct Capture Capture;
+
+/**
+ * @brief Which way a frame crossed the captured interface.
+ */
+typedef enum CaptureDirection {
+  CAPTURE_INBOUND = 1,
+  CAPTURE_OUTBOUND = 2,
+} CaptureDirection;
+
+/**
+ * @brief One filter primitive.
+ */
+typedef struct CaptureFilterTerm {
+  /** Primitive kind (internal to capture.c). */
+  uint8_t kind;
+  /** Address, prefix mask, or number operand. */
+  uint32_t value;
+  uint32_t mask;
+} CaptureFilterTerm;
+
+/**
+ * @brief A compiled filter; a frame passes when every term matches.
+ */
+typedef struct CaptureFilter {
+  CaptureFilterTerm terms[CAPTURE_FILTER_MAX_TERMS];
+  /** Number of terms; 0 passes everything. */
+  size_t count;
+} CaptureFilter;
+
+/**
+ * @brief Capture options.
+ */
+typedef struct CaptureConfig {
+  /** Bytes kept per frame; 0 picks CAPTURE_DEFAULT_SNAPLEN. */
+  uint32_t snaplen;
+  /** Ring memory; 0 picks CAPTURE_DEFAULT_RING_BYTES. */
+  size_t ring_bytes;
+  /** Filter expression, or NULL or "" to keep every frame. */
+  const char* filter;
+} CaptureConfig;
+
+/**
+ * @brief Capture counters.
+ */
+typedef struct CaptureStats {
+  /** Frames offered to the capture. */
+  uint64_t seen;
+  /** Frames rejected by the filter. */
+  uint64_t filtered;
+  /** Frames written to the file. */
+  uint64_t written;
+  /** Frames lost because the ring was full. */
+  uint64_t dropped;
+} CaptureStats;
+
+/**
+ * @brief Compile a filter expression.
+ *
+ * @param text Expression such as "vlan 10 and udp and port 53", or NULL/"".
+ * @param out Compiled filter.
+ * @return MAGI_OK, or MAGI_ERR_BADARGS on a syntax error.
+ */
+int capture_filter_compile(const char* text, CaptureFilter* out);
+
+/**
+ * @brief Test a frame against a compiled filter.
+ *
+ * @param filter Compiled filter.
+ * @param frame Ethernet frame.
+ * @param len Frame length.
+ * @return true if the frame passes.
+ */
+bool capture_filter_match(const CaptureFilter* filter, const uint8_t* frame, size_t len);
+
+/**
+ * @brief Create a pcapng file and start its writer thread.
+ *
+ * One Interface Description Block is written per name; capture_packet()
+ * refers to them by index.
+ *
+ * @param path Output file.
+ * @param config Options, or NULL for the defaults.
+ * @param if_names Interface names recorded in the file.
+ * @param if_count Number of names (1 or 2).
+ * @return Capture, or NULL with magi_errno set.
+ */
+Capture* capture_open(const char* path, const CaptureConfig* config, const char* const* if_names,
+                      size_t if_count);
+
+/**
+ * @brief Offer a frame to a capture. Safe to call from several threads at once.
+ *
+ * @param capture Capture.
+ * @param if_index Interface index given to capture_open().
+ * @param direction Direction recorded in the block's flags.
+ * @param frame Ethernet frame.
+ * @param len Frame length.
+ */
+void capture_packet(Capture* capture, uint32_t if_index, CaptureDirection direction,
+                    const uint8_t* frame, size_t len);
+
+/**
+ * @brief Write out every frame queued so far.
+ *
+ * @param capture Capture.
+ */
+void capture_flush(Capture* capture);
+
+/**
+ * @brief Read a capture's counters.
+ *
+ * @param capture Capture.
+ * @param out Counters; written counts frames flushed so far.
+ */
+void capture_get_stats(const Capture* capture, CaptureStats* out);
+
+/**
+ * @brief Output path of a capture.
+ *
+ * @param capture Capture.
+ * @return Path given to capture_open().
+ */
+const char* capture_path(const Capture* capture);
+
+/**
+ * @brief Stop the writer, write out the ring and close the file.
+ *
+ * @param capture Capture to close. NULL is allowed.
+ * @param out Final counters, or NULL.
+ * @return MAGI_OK, or MAGI_ERR_BADARGS if the file could not be written.
+ */
+int capture_close(Capture* capture, CaptureStats* out);
+
+/**
+ * @brief Start capturing what an interface sends and receives.
+ *
+ * @param iface Interface.
+ * @param path Output file.
+ * @param config Options, or NULL for the defaults.
+ * @return MAGI_OK, MAGI_ERR_BADARGS (including a capture already running), or MAGI_ERR_NOMEM.
+ */
+int capture_start_interface(struct Interface* iface, const char* path,
+                            const CaptureConfig* config);
+
+/**
+ * @brief Stop an interface capture and close its file.
+ *
+ * With MAGI_ASYNC this waits until no worker is still inside the tap.
+ *
+ * @param iface Interface.
+ * @param out Final counters, or NULL.
+ * @return MAGI_OK, or MAGI_ERR_BADARGS if no capture is running.
+ */
+int capture_stop_interface(struct Interface* iface, CaptureStats* out);
+
+/**
+ * @brief Start capturing every frame sent across a link.
+ *
+ * The file describes one interface per endpoint; each frame is recorded
+ * as outbound on the endpoint that sent it.
+ *
+ * @param link Link.
+ * @param path Output file.
+ * @param config Options, or NULL for the defaults.
+ * @return MAGI_OK, MAGI_ERR_BADARGS (including a capture already running), or MAGI_ERR_NOMEM.
+ */
+int capture_start_link(struct Link* link, const char* path, const CaptureConfig* config);
+
+/**
+ * @brief Stop a link capture and close its file.
+ *
+ * @param link Link.
+ * @param out Final counters, or NULL.
+ * @return MAGI_OK, or MAGI_ERR_BADARGS if no capture is running.
+ */
+int capture_stop_link(struct Link* link, CaptureStats* out);
+
+#endif
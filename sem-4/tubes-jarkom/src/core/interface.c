@@ -2,11 +2,14 @@
 
 #include "interface.h"
 
+#include "core/capture.h"
 #include "core/link.h"
 #include "core/node.h"
+#include "core/pktbuf.h"
 #include "utils/mac.h"
 #include "utils/magi_error.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -22,6 +25,11 @@ Interface* interface_new(struct Node* node, uint16_t port) {
     return NULL;
   }
 
+  if (magi_counters_init(&iface->counters, MAGI_IFACE_COUNTER_COUNT) != MAGI_OK) {
+    free(iface);
+    return NULL;
+  }
+
   iface->node = node;
   memset(iface->ip_address, 0, sizeof(iface->ip_address));
   iface->vlan_id = 0U;
@@ -29,6 +37,8 @@ Interface* interface_new(struct Node* node, uint16_t port) {
   iface->link = NULL;
   iface->send_down = NULL;
   iface->receive_up = interface_receive;
+  iface->capture = NULL;
+  iface->rx_pkt = NULL;
 #ifdef MAGI_ASYNC
   iface->queue = NULL;
 #endif
@@ -37,9 +47,35 @@ Interface* interface_new(struct Node* node, uint16_t port) {
 }
 
 void interface_free(Interface* iface) {
+  if (iface != NULL) {
+    capture_close(iface->capture, NULL);
+    magi_counters_free(&iface->counters);
+  }
   free(iface);
 }
 
+int interface_set_ip(Interface* iface, const char* cidr) {
+  if (iface == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  if (cidr != NULL && strlen(cidr) >= sizeof(iface->ip_address)) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  snprintf(iface->ip_address, sizeof(iface->ip_address), "%s", cidr != NULL ? cidr : "");
+  if (iface->node != NULL) {
+    iface->node->iface_gen++;
+  }
+  return MAGI_OK;
+}
+
+uint16_t interface_mtu(const Interface* iface) {
+  return iface != NULL && iface->link != NULL ? iface->link->mtu : 0U;
+}
+
 int interface_send(Interface* iface, const uint8_t* data, size_t len) {
   if (iface == NULL || data == NULL) {
     free((void*)data);
@@ -56,12 +92,123 @@ int interface_send(Interface* iface, const uint8_t* data, size_t len) {
   return link_transmit(iface->link, iface, data, len);
 }
 
+int interface_send_pkt(Interface* iface, PktBuf* pkt) {
+  if (iface == NULL || pkt == NULL) {
+    pktbuf_release(pkt);
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  if (iface->link == NULL) {
+    pktbuf_release(pkt);
+    magi_errno = MAGI_ERR_NOLINK;
+    return MAGI_ERR_NOLINK;
+  }
+
+  return link_transmit_pkt(iface->link, iface, pkt);
+}
+
+/**
+ * @brief Count a received frame and hand it to the interface's capture tap.
+ *
+ * @param iface Interface the frame arrived on.
+ * @param data Frame bytes.
+ * @param len Frame length in bytes.
+ */
+static void interface_account_rx(Interface* iface, const uint8_t* data, size_t len) {
+  magi_counter_add(&iface->counters, MAGI_IFACE_RX_PACKETS, 1U);
+  magi_counter_add(&iface->counters, MAGI_IFACE_RX_BYTES, len);
+  Capture* capture = iface->capture;
+  if (capture != NULL) {
+    capture_packet(capture, 0U, CAPTURE_INBOUND, data, len);
+  }
+}
+
 void interface_receive(Interface* iface, const uint8_t* data, size_t len) {
   if (iface == NULL || iface->node == NULL || data == NULL) {
     return;
   }
 
+  interface_account_rx(iface, data, len);
   if (iface->node->handle_receive != NULL) {
     iface->node->handle_receive(iface->node, iface, data, len);
   }
 }
+
+bool interface_deliver(Interface* iface, const uint8_t* data, size_t len, PktBuf* pkt) {
+  if (iface == NULL || iface->receive_up == NULL) {
+    return false;
+  }
+
+  RxFrame frame = {.iface = iface, .data = data, .len = len, .pkt = pkt};
+  PktBuf* outer = interface_rx_begin(&frame);
+  iface->receive_up(iface, data, len);
+  interface_rx_end(&frame, outer);
+  return pkt != NULL && frame.pkt == NULL;
+}
+
+PktBuf* interface_rx_begin(RxFrame* frame) {
+  /* Saved and restored: a zero-delay loop can deliver to this interface again from inside. */
+  PktBuf* outer = frame->iface->rx_pkt;
+  frame->iface->rx_pkt = frame->pkt;
+  return outer;
+}
+
+void interface_rx_end(RxFrame* frame, PktBuf* outer) {
+  if (frame->pkt != NULL && frame->iface->rx_pkt == NULL) {
+    frame->pkt = NULL;
+  }
+  frame->iface->rx_pkt = outer;
+}
+
+PktBuf* interface_claim_rx(Interface* iface, const uint8_t* data) {
+  PktBuf* pkt = iface != NULL ? iface->rx_pkt : NULL;
+  if (pkt == NULL || pkt->data != data || pktbuf_shared(pkt)) {
+    return NULL;
+  }
+
+  iface->rx_pkt = NULL;
+  return pkt;
+}
+
+/**
+ * @brief Check whether a frame on this interface can go through its node's burst handler.
+ *
+ * @param frame Frame to check.
+ * @return true if the frame would reach handle_receive via interface_receive().
+ */
+static bool interface_rx_batchable(const RxFrame* frame) {
+  const Interface* iface = frame->iface;
+  return iface != NULL && frame->data != NULL && iface->receive_up == interface_receive &&
+         iface->node != NULL && iface->node->handle_receive_batch != NULL;
+}
+
+void interface_receive_batch(RxFrame* frames, size_t count) {
+  if (frames == NULL) {
+    return;
+  }
+
+  size_t index = 0U;
+  while (index < count) {
+    RxFrame* first = &frames[index];
+    if (!interface_rx_batchable(first)) {
+      if (interface_deliver(first->iface, first->data, first->len, first->pkt)) {
+        first->pkt = NULL;
+      }
+      index++;
+      continue;
+    }
+
+    Node* node = first->iface->node;
+    size_t run = 0U;
+    while (run < NODE_RX_BURST && index + run < count &&
+           interface_rx_batchable(&frames[index + run]) &&
+           frames[index + run].iface->node == node) {
+      interface_account_rx(frames[index + run].iface, frames[index + run].data,
+                           frames[index + run].len);
+      run++;
+    }
+    node->handle_receive_batch(node, first, run);
+    index += run;
+  }
+}
@@ -6,11 +6,16 @@
 #ifndef MAGI_CORE_INTERFACE_H
 #define MAGI_CORE_INTERFACE_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+#include "core/stats.h"
+
+struct Capture;
 struct Interface;
 struct Link;
+struct PktBuf;
 struct Node;
 
 #ifdef MAGI_ASYNC
@@ -27,6 +32,20 @@ typedef void (*send_fn_t)(struct Interface* iface, const uint8_t* data, size_t l
  */
 typedef void (*recv_fn_t)(struct Interface* iface, const uint8_t* data, size_t len);
 
+/**
+ * @brief One frame of a receive burst; see interface_receive_batch().
+ */
+typedef struct RxFrame {
+  /** Interface the frame arrived on. */
+  struct Interface* iface;
+  /** Frame bytes. */
+  const uint8_t* data;
+  /** Frame length in bytes. */
+  size_t len;
+  /** Buffer behind data, or NULL; set to NULL once a handler has taken it over. */
+  struct PktBuf* pkt;
+} RxFrame;
+
 /**
  * @brief A physical/logical port attached to a node.
  */
@@ -47,6 +66,17 @@ typedef struct Interface {
   send_fn_t send_down;
   /** Optional up-stack receive hook. */
   recv_fn_t receive_up;
+  /** Traffic counters, indexed by MagiIfaceCounter. */
+  MagiCounters counters;
+  /** Buffer behind the frame receive_up is handling, or NULL; see interface_claim_rx(). */
+  struct PktBuf* rx_pkt;
+#ifdef MAGI_ASYNC
+  /** Capture tap on received and sent frames, or NULL; see capture.h. */
+  struct Capture* _Atomic capture;
+#else
+  /** Capture tap on received and sent frames, or NULL; see capture.h. */
+  struct Capture* capture;
+#endif
 #ifdef MAGI_ASYNC
   /** Optional async receive queue in async mode. */
   struct MagiQueue* queue;
@@ -69,6 +99,26 @@ Interface* interface_new(struct Node* node, uint16_t port);
  */
 void interface_free(Interface* iface);
 
+/**
+ * @brief Assign (or clear) the interface CIDR address.
+ *
+ * Prefer this over writing ip_address directly so that the owning node's
+ * iface_gen is bumped and cached per-interface state is rebuilt.
+ *
+ * @param iface Interface to configure.
+ * @param cidr CIDR text such as "10.0.0.1/24", or NULL/"" to clear.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int interface_set_ip(Interface* iface, const char* cidr);
+
+/**
+ * @brief Largest IPv4 datagram the interface's link carries.
+ *
+ * @param iface Interface to inspect.
+ * @return Link MTU, or 0 when disconnected or unlimited.
+ */
+uint16_t interface_mtu(const Interface* iface);
+
 /**
  * @brief Transmit data out through the interface's link.
  *
@@ -79,6 +129,15 @@ void interface_free(Interface* iface);
  */
 int interface_send(Interface* iface, const uint8_t* data, size_t len);
 
+/**
+ * @brief Transmit a packet buffer out through the interface's link without copying.
+ *
+ * @param iface Source interface.
+ * @param pkt Packet buffer; the caller's reference transfers to the link.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int interface_send_pkt(Interface* iface, struct PktBuf* pkt);
+
 /**
  * @brief Deliver data received from a link into the owning node.
  *
@@ -88,4 +147,68 @@ int interface_send(Interface* iface, const uint8_t* data, size_t len);
  */
 void interface_receive(Interface* iface, const uint8_t* data, size_t len);
 
+/**
+ * @brief Hand a frame from a link to iface->receive_up, noting the buffer behind it.
+ *
+ * While receive_up runs, a handler that forwards the frame can take the
+ * buffer over with interface_claim_rx() instead of copying it.
+ *
+ * @param iface Destination interface.
+ * @param data Frame bytes.
+ * @param len Frame length in bytes.
+ * @param pkt Packet buffer backing data, or NULL for a plain heap block.
+ * @return true if the handler took pkt over; the caller must then not release it.
+ */
+bool interface_deliver(Interface* iface, const uint8_t* data, size_t len, struct PktBuf* pkt);
+
+/**
+ * @brief Take over the buffer behind the frame being received, if it is free to modify.
+ *
+ * Succeeds only during interface_deliver() for that frame, and only when
+ * the delivering link is the buffer's sole holder (a flooded frame shared
+ * between ports is not). The link's reference passes to the caller, which
+ * may rewrite the buffer in place and send it on. The frame bytes passed
+ * to receive_up must not be read after the buffer has been sent.
+ *
+ * @param iface Interface the frame arrived on.
+ * @param data Start of the frame as passed to receive_up.
+ * @return The buffer, or NULL if the frame must be copied.
+ */
+struct PktBuf* interface_claim_rx(Interface* iface, const uint8_t* data);
+
+/**
+ * @brief Deliver a burst of frames that arrived at one node.
+ *
+ * Each frame is counted and captured as interface_receive() would. Runs of
+ * up to NODE_RX_BURST frames then go to the node's handle_receive_batch in
+ * one call, so its parse, lookup and transmit stages each run over the
+ * whole run; frames for a node without one, or for an interface with its
+ * own receive_up, are delivered singly. A frame whose buffer a handler took
+ * over comes back with pkt set to NULL.
+ *
+ * @param frames Frames in arrival order, all on interfaces of the same node.
+ * @param count Number of frames.
+ */
+void interface_receive_batch(RxFrame* frames, size_t count);
+
+/**
+ * @brief Make a burst frame's buffer claimable while a handler works on it.
+ *
+ * Burst handlers bracket the stage that may forward frame in place with
+ * this and interface_rx_end(), which is what interface_deliver() does
+ * around a single frame.
+ *
+ * @param frame Frame about to be handled.
+ * @return The interface's previous buffer, for interface_rx_end().
+ */
+struct PktBuf* interface_rx_begin(RxFrame* frame);
+
+/**
+ * @brief End interface_rx_begin(), noting whether the buffer was claimed.
+ *
+ * @param frame Frame that was handled; its pkt is cleared if it was claimed.
+ * @param outer Value interface_rx_begin() returned.
+ */
+void interface_rx_end(RxFrame* frame, struct PktBuf* outer);
+
 #endif
@@ -2,43 +2,90 @@
 
 #include "link.h"
 
+#include "core/capture.h"
 #include "core/interface.h"
 #include "core/node.h"
+#include "core/pktbuf.h"
+#include "core/sim.h"
 #include "utils/magi_error.h"
 
 #ifdef MAGI_ASYNC
+#include "async/engine.h"
 #include "async/queue.h"
 #endif
 
+#include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
+#include <string.h>
+
+/** RED queue-average weight (Floyd and Jacobson's w_q). */
+#define LINK_RED_WEIGHT 0.002
 
 /**
- * @brief Simulate link propagation delay by sleeping.
- *
- * Blocks the calling thread for the specified number of milliseconds using
- * nanosleep(). Handles interruption by resuming the sleep for the remaining
- * duration. A zero delay returns immediately.
- *
- * @param delay_ms The delay in milliseconds. 0 means no delay.
- * \return MAGI_OK on success (always succeeds).
+ * @brief Release a frame payload: the packet buffer if there is one, else the heap block.
  */
-static int sleep_for_delay(uint32_t delay_ms) {
-  if (delay_ms == 0U) {
-    return MAGI_OK;
+static void release_payload(uint8_t* data, struct PktBuf* pkt) {
+  if (pkt != NULL) {
+    pktbuf_release(pkt);
+  } else {
+    free(data);
   }
+}
 
-  struct timespec request;
-  request.tv_sec = (time_t)(delay_ms / 1000U);
-  request.tv_nsec = (long)((delay_ms % 1000U) * 1000000UL);
+#ifndef MAGI_ASYNC
+/**
+ * @brief A frame crossing a delayed link, waiting on the simulation clock.
+ */
+typedef struct LinkDelivery {
+  /** Fires when the frame reaches the far end. */
+  SimTimer timer;
+  /** Link being crossed. */
+  Link* link;
+  /** Sending endpoint; the receiver is looked up when the frame lands. */
+  struct Interface* sender;
+  /** Frame bytes; owned by pkt when pkt is set, otherwise a heap block. */
+  uint8_t* data;
+  /** Frame length in bytes. */
+  size_t len;
+  /** Packet buffer backing data, or NULL. */
+  struct PktBuf* pkt;
+  /** Neighbours in the link's in-flight list. */
+  struct LinkDelivery* prev;
+  struct LinkDelivery* next;
+} LinkDelivery;
 
-  while (nanosleep(&request, &request) != 0) {
-    if (request.tv_sec == 0 && request.tv_nsec == 0) {
-      break;
-    }
+/**
+ * @brief Unlink a delivery from its link and release it with its payload.
+ */
+static void link_delivery_free(LinkDelivery* delivery) {
+  if (delivery->prev != NULL) {
+    delivery->prev->next = delivery->next;
+  } else {
+    delivery->link->in_flight = delivery->next;
+  }
+  if (delivery->next != NULL) {
+    delivery->next->prev = delivery->prev;
   }
 
-  return MAGI_OK;
+  sim_timer_cancel(&delivery->timer);
+  release_payload(delivery->data, delivery->pkt);
+  free(delivery);
+}
+#endif
+
+/**
+ * @brief Note that an interface gained or lost its link.
+ *
+ * Bumps the owning node's iface_gen so per-port caches (switch flood
+ * lists, connected routes) are rebuilt.
+ *
+ * @param iface Endpoint whose link changed.
+ */
+static void link_endpoint_changed(struct Interface* iface) {
+  if (iface->node != NULL) {
+    iface->node->iface_gen++;
+  }
 }
 
 Link* link_new(struct Interface* a, struct Interface* b, uint32_t delay_ms, uint16_t mtu) {
@@ -47,7 +94,7 @@ Link* link_new(struct Interface* a, struct Interface* b, uint32_t delay_ms, uint
     return NULL;
   }
 
-  Link* link = malloc(sizeof(*link));
+  Link* link = calloc(1U, sizeof(*link));
   if (link == NULL) {
     magi_errno = MAGI_ERR_NOMEM;
     return NULL;
@@ -57,8 +104,20 @@ Link* link_new(struct Interface* a, struct Interface* b, uint32_t delay_ms, uint
   link->endpoint_b = b;
   link->delay_ms = delay_ms;
   link->mtu = mtu;
+  link->in_flight = NULL;
+  link->dir[0].red_rng = 0x9E3779B97F4A7C15ULL;
+  link->dir[1].red_rng = 0xD1B54A32D192ED03ULL;
+
+  LinkQueueConfig queue = {.kind = LINK_QUEUE_FIFO, .limit = LINK_QUEUE_DEFAULT_LIMIT};
+  if (link_set_queue(link, &queue) != MAGI_OK) {
+    free(link);
+    return NULL;
+  }
+
   a->link = link;
   b->link = link;
+  link_endpoint_changed(a);
+  link_endpoint_changed(b);
   return link;
 }
 
@@ -69,64 +128,497 @@ void link_free(Link* link) {
 
   if (link->endpoint_a != NULL && link->endpoint_a->link == link) {
     link->endpoint_a->link = NULL;
+    link_endpoint_changed(link->endpoint_a);
   }
 
   if (link->endpoint_b != NULL && link->endpoint_b->link == link) {
     link->endpoint_b->link = NULL;
+    link_endpoint_changed(link->endpoint_b);
+  }
+
+#ifndef MAGI_ASYNC
+  while (link->in_flight != NULL) {
+    link_delivery_free(link->in_flight);
   }
+#endif
 
+  capture_close(link->capture, NULL);
+  free(link->dir[0].departures);
+  free(link->dir[1].departures);
   free(link);
 }
 
-int link_transmit(Link* link, struct Interface* sender, const uint8_t* data, size_t len) {
-  if (link == NULL || sender == NULL || data == NULL) {
+int link_set_bandwidth(Link* link, uint64_t bandwidth_bps) {
+  if (link == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  link->bandwidth_bps = bandwidth_bps;
+  return MAGI_OK;
+}
+
+int link_set_queue(Link* link, const LinkQueueConfig* config) {
+  if (link == NULL || config == NULL || config->limit == 0U ||
+      (config->kind != LINK_QUEUE_FIFO && config->kind != LINK_QUEUE_RED) ||
+      config->red_max_p < 0.0 || config->red_max_p > 1.0) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  LinkQueueConfig queue = *config;
+  if (queue.red_min == 0U) {
+    queue.red_min = queue.limit / 4U > 0U ? queue.limit / 4U : 1U;
+  }
+  if (queue.red_max == 0U) {
+    queue.red_max = queue.limit / 4U * 3U;
+  }
+  if (queue.red_max <= queue.red_min) {
+    queue.red_max = queue.red_min + 1U;
+  }
+  if (queue.red_max_p == 0.0) {
+    queue.red_max_p = 0.1;
+  }
+
+  uint64_t* rings[2] = {
+      malloc((size_t)queue.limit * sizeof(uint64_t)),
+      malloc((size_t)queue.limit * sizeof(uint64_t)),
+  };
+  if (rings[0] == NULL || rings[1] == NULL) {
+    free(rings[0]);
+    free(rings[1]);
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
+  }
+
+  for (size_t index = 0U; index < 2U; ++index) {
+    LinkDirection* dir = &link->dir[index];
+    free(dir->departures);
+    dir->departures = rings[index];
+    dir->departure_head = 0U;
+    dir->departure_count = 0U;
+    dir->red_avg = 0.0;
+    dir->red_count = 0U;
+  }
+  link->queue = queue;
+  return MAGI_OK;
+}
+
+int link_get_stats(const Link* link, const struct Interface* sender, LinkStats* out) {
+  if (link == NULL || out == NULL ||
+      (sender != NULL && sender != link->endpoint_a && sender != link->endpoint_b)) {
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
-  struct Interface* receiver = NULL;
+  *out = (LinkStats){0};
+  uint64_t now = sim_now_ns();
+  for (size_t index = 0U; index < 2U; ++index) {
+    if (sender != NULL && sender != (index == 0U ? link->endpoint_a : link->endpoint_b)) {
+      continue;
+    }
+
+    const LinkDirection* dir = &link->dir[index];
+    uint32_t depth = 0U;
+    for (size_t n = 0U; n < dir->departure_count; ++n) {
+      depth += dir->departures[(dir->departure_head + n) % link->queue.limit] > now;
+    }
+    out->tx_packets += dir->stats.tx_packets;
+    out->tx_bytes += dir->stats.tx_bytes;
+    out->drops += dir->stats.drops;
+    out->queue_depth += depth;
+    out->queue_hwm = dir->stats.queue_hwm > out->queue_hwm ? dir->stats.queue_hwm : out->queue_hwm;
+  }
+  return MAGI_OK;
+}
+
+void link_reset_stats(Link* link) {
+  if (link == NULL) {
+    return;
+  }
+
+  link->dir[0].stats = (LinkStats){0};
+  link->dir[1].stats = (LinkStats){0};
+}
+
+const char* link_queue_kind_name(LinkQueueKind kind) {
+  return kind == LINK_QUEUE_RED ? "red" : "fifo";
+}
+
+bool link_parse_queue_kind(const char* text, LinkQueueKind* out) {
+  if (text == NULL || out == NULL) {
+    return false;
+  }
+
+  if (strcmp(text, "fifo") == 0) {
+    *out = LINK_QUEUE_FIFO;
+    return true;
+  }
+  if (strcmp(text, "red") == 0) {
+    *out = LINK_QUEUE_RED;
+    return true;
+  }
+  return false;
+}
+
+bool link_parse_rate(const char* text, uint64_t* out) {
+  if (text == NULL || out == NULL || *text < '0' || *text > '9') {
+    return false;
+  }
+
+  char* end = NULL;
+  errno = 0;
+  unsigned long long value = strtoull(text, &end, 10);
+  uint64_t scale = 1U;
+  switch (*end) {
+  case '\0':
+    break;
+  case 'k':
+  case 'K':
+    scale = 1000U;
+    end++;
+    break;
+  case 'm':
+  case 'M':
+    scale = 1000000U;
+    end++;
+    break;
+  case 'g':
+  case 'G':
+    scale = 1000000000U;
+    end++;
+    break;
+  default:
+    return false;
+  }
 
+  if (errno != 0 || *end != '\0' || value > UINT64_MAX / scale) {
+    return false;
+  }
+
+  *out = (uint64_t)value * scale;
+  return true;
+}
+
+void link_format_rate(uint64_t bps, char* out, size_t out_len) {
+  if (out == NULL || out_len == 0U) {
+    return;
+  }
+
+  static const char units[] = {'G', 'M', 'k'};
+  uint64_t scale = 1000000000U;
+  for (size_t index = 0U; index < sizeof(units); ++index, scale /= 1000U) {
+    if (bps != 0U && bps % scale == 0U) {
+      snprintf(out, out_len, "%llu%c", (unsigned long long)(bps / scale), units[index]);
+      return;
+    }
+  }
+  snprintf(out, out_len, "%llu", (unsigned long long)bps);
+}
+
+/**
+ * @brief Find the endpoint opposite the sender.
+ *
+ * @param link Link carrying the payload.
+ * @param sender Source endpoint.
+ * @return Opposite endpoint, or NULL if sender is not attached to link.
+ */
+static struct Interface* link_peer(const Link* link, const struct Interface* sender) {
   if (link->endpoint_a == sender) {
-    receiver = link->endpoint_b;
-  } else if (link->endpoint_b == sender) {
-    receiver = link->endpoint_a;
-  } else {
-    free((void*)data);
-    magi_errno = MAGI_ERR_NOLINK;
-    return MAGI_ERR_NOLINK;
+    return link->endpoint_b;
   }
+  if (link->endpoint_b == sender) {
+    return link->endpoint_a;
+  }
+  return NULL;
+}
 
-  sleep_for_delay(link->delay_ms);
+/**
+ * @brief Draw a uniform random number in [0, 1) from a direction's RED state.
+ */
+static double red_random(LinkDirection* dir) {
+  uint64_t x = dir->red_rng;
+  x ^= x >> 12U;
+  x ^= x << 25U;
+  x ^= x >> 27U;
+  dir->red_rng = x;
+  return (double)((x * 0x2545F4914F6CDD1DULL) >> 11U) * 0x1.0p-53;
+}
+
+/**
+ * @brief Raise a base to an integer power by repeated squaring.
+ */
+static double pow_u64(double base, uint64_t exponent) {
+  double result = 1.0;
+  while (exponent > 0U && result > 0.0) {
+    if ((exponent & 1U) != 0U) {
+      result *= base;
+    }
+    base *= base;
+    exponent >>= 1U;
+  }
+  return result;
+}
+
+/**
+ * @brief Decide whether RED drops an arriving frame.
+ *
+ * Updates the averaged depth first. After an idle period the average
+ * decays as if the queue had seen one empty sample per frame time that
+ * passed, as in Floyd and Jacobson's RED.
+ *
+ * @param queue Queue configuration.
+ * @param dir Direction the frame arrives at.
+ * @param depth Instantaneous queue depth.
+ * @param now Current time.
+ * @param serialize_ns Serialization time of the arriving frame.
+ * @return true to drop the frame.
+ */
+static bool red_should_drop(const LinkQueueConfig* queue, LinkDirection* dir, uint32_t depth,
+                            uint64_t now, uint64_t serialize_ns) {
+  if (depth == 0U && now > dir->busy_until_ns && serialize_ns > 0U) {
+    uint64_t idle_frames = (now - dir->busy_until_ns) / serialize_ns;
+    dir->red_avg *= pow_u64(1.0 - LINK_RED_WEIGHT, idle_frames);
+  }
+  dir->red_avg += LINK_RED_WEIGHT * ((double)depth - dir->red_avg);
+
+  if (dir->red_avg < (double)queue->red_min) {
+    dir->red_count = 0U;
+    return false;
+  }
+  if (dir->red_avg >= (double)queue->red_max) {
+    dir->red_count = 0U;
+    return true;
+  }
+
+  double pb = queue->red_max_p * (dir->red_avg - (double)queue->red_min) /
+              (double)(queue->red_max - queue->red_min);
+  dir->red_count++;
+  double scale = 1.0 - (double)dir->red_count * pb;
+  if (scale <= 0.0 || red_random(dir) < pb / scale) {
+    dir->red_count = 0U;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Admit a frame to a direction's egress queue and compute when it lands.
+ *
+ * Frames whose serialization has finished leave the queue first. With no
+ * bandwidth set there is no serialization and hence no queue.
+ *
+ * @param link Link being crossed.
+ * @param dir Sending direction.
+ * @param len Frame length in bytes.
+ * @param now Current time.
+ * @param arrive_ns Receives the time the frame reaches the far end.
+ * @return MAGI_OK, or MAGI_ERR_QUEUE_FULL if the frame is dropped.
+ */
+static int link_enqueue(Link* link, LinkDirection* dir, size_t len, uint64_t now,
+                        uint64_t* arrive_ns) {
+  uint64_t delay_ns = (uint64_t)link->delay_ms * SIM_NS_PER_MS;
+  if (link->bandwidth_bps == 0U) {
+    dir->stats.tx_packets++;
+    dir->stats.tx_bytes += len;
+    *arrive_ns = now + delay_ns;
+    return MAGI_OK;
+  }
+
+  const LinkQueueConfig* queue = &link->queue;
+  while (dir->departure_count > 0U && dir->departures[dir->departure_head] <= now) {
+    dir->departure_head = (dir->departure_head + 1U) % queue->limit;
+    dir->departure_count--;
+  }
+
+  uint32_t depth = (uint32_t)dir->departure_count;
+  uint64_t serialize_ns = (uint64_t)len * 8000000000ULL / link->bandwidth_bps;
+  dir->stats.queue_depth = depth;
+  if (depth >= queue->limit ||
+      (queue->kind == LINK_QUEUE_RED && red_should_drop(queue, dir, depth, now, serialize_ns))) {
+    dir->stats.drops++;
+    return MAGI_ERR_QUEUE_FULL;
+  }
+
+  uint64_t depart = (dir->busy_until_ns > now ? dir->busy_until_ns : now) + serialize_ns;
+  dir->busy_until_ns = depart;
+  dir->departures[(dir->departure_head + dir->departure_count) % queue->limit] = depart;
+  dir->departure_count++;
+
+  dir->stats.tx_packets++;
+  dir->stats.tx_bytes += len;
+  dir->stats.queue_depth = depth + 1U;
+  if (depth + 1U > dir->stats.queue_hwm) {
+    dir->stats.queue_hwm = depth + 1U;
+  }
+  *arrive_ns = depart + delay_ns;
+  return MAGI_OK;
+}
+
+#ifndef MAGI_ASYNC
+/**
+ * @brief Simulation event: hand a delayed frame to the far endpoint.
+ *
+ * @param ctx The LinkDelivery that fired.
+ */
+static void link_deliver(void* ctx) {
+  LinkDelivery* delivery = ctx;
+  struct Interface* receiver = link_peer(delivery->link, delivery->sender);
+  if (receiver != NULL &&
+      interface_deliver(receiver, delivery->data, delivery->len, delivery->pkt)) {
+    delivery->data = NULL;
+    delivery->pkt = NULL;
+  }
+  link_delivery_free(delivery);
+}
+
+/**
+ * @brief Put a frame in flight until it reaches the far end.
+ *
+ * @param link Link being crossed.
+ * @param sender Sending endpoint.
+ * @param data Frame bytes; a heap block unless pkt is set.
+ * @param len Frame length.
+ * @param pkt Packet buffer backing data, or NULL.
+ * @param delay_ns Time until the frame lands.
+ * @return MAGI_OK, or MAGI_ERR_NOMEM after releasing the payload.
+ */
+static int link_schedule(Link* link, struct Interface* sender, uint8_t* data, size_t len,
+                         struct PktBuf* pkt, uint64_t delay_ns) {
+  LinkDelivery* delivery = calloc(1U, sizeof(*delivery));
+  if (delivery == NULL) {
+    release_payload(data, pkt);
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
+  }
+
+  delivery->link = link;
+  delivery->sender = sender;
+  delivery->data = data;
+  delivery->len = len;
+  delivery->pkt = pkt;
+  delivery->next = link->in_flight;
+  if (link->in_flight != NULL) {
+    link->in_flight->prev = delivery;
+  }
+  link->in_flight = delivery;
+
+  sim_timer_init(&delivery->timer, link_deliver, delivery);
+  int status = sim_timer_arm(&delivery->timer, delay_ns);
+  if (status != MAGI_OK) {
+    link_delivery_free(delivery);
+  }
+  return status;
+}
+#endif
+
+/**
+ * @brief Carry a frame across the link; shared by both transmit entry points.
+ *
+ * @param link Link carrying the frame.
+ * @param sender Sending endpoint, already checked to be on the link.
+ * @param receiver Opposite endpoint.
+ * @param data Frame bytes; a heap block unless pkt is set.
+ * @param len Frame length.
+ * @param pkt Packet buffer backing data, or NULL.
+ * @return MAGI_OK on success, otherwise an error code. The payload is always consumed.
+ */
+static int link_send(Link* link, struct Interface* sender, struct Interface* receiver,
+                     uint8_t* data, size_t len, struct PktBuf* pkt) {
+#ifndef MAGI_ASYNC
+  if (receiver->receive_up == NULL) {
+    release_payload(data, pkt);
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+#endif
+
+  LinkDirection* dir = &link->dir[sender == link->endpoint_a ? 0 : 1];
+  uint64_t now = sim_now_ns();
+  uint64_t arrive_ns = now;
+  int status = link_enqueue(link, dir, len, now, &arrive_ns);
+  if (status != MAGI_OK) {
+    node_count(sender->node, MAGI_NODE_DROP_QUEUE_FULL);
+    release_payload(data, pkt);
+    magi_errno = status;
+    return status;
+  }
+  magi_counter_add(&sender->counters, MAGI_IFACE_TX_PACKETS, 1U);
+  magi_counter_add(&sender->counters, MAGI_IFACE_TX_BYTES, len);
+  Capture* capture = sender->capture;
+  if (capture != NULL) {
+    capture_packet(capture, 0U, CAPTURE_OUTBOUND, data, len);
+  }
+  capture = link->capture;
+  if (capture != NULL) {
+    capture_packet(capture, dir == &link->dir[0] ? 0U : 1U, CAPTURE_OUTBOUND, data, len);
+  }
 
 #ifdef MAGI_ASYNC
-  if (receiver == NULL || receiver->node == NULL || receiver->node->queue == NULL) {
-    free((void*)data);
+  if (receiver->node == NULL || receiver->node->queue == NULL) {
+    release_payload(data, pkt);
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
-  MagiMsg message;
+  MagiMsg message = {0};
   message.src_iface = sender;
-  message.data = (uint8_t*)data;
+  message.data = data;
   message.len = len;
-
-  int status = queue_push(receiver->node->queue, message);
+  message.pkt = pkt;
+  if (arrive_ns > now) {
+    return engine_push_at(receiver->node, message, arrive_ns);
+  }
+  status = queue_push(receiver->node->queue, message);
   if (status != MAGI_OK) {
-    free((void*)data);
+    node_count(receiver->node, MAGI_NODE_DROP_QUEUE_FULL);
+    release_payload(data, pkt);
     magi_errno = status;
     return status;
   }
 
   return MAGI_OK;
 #else
-  if (receiver == NULL || receiver->receive_up == NULL) {
+  if (arrive_ns > now) {
+    return link_schedule(link, sender, data, len, pkt, arrive_ns - now);
+  }
+
+  if (!interface_deliver(receiver, data, len, pkt)) {
+    release_payload(data, pkt);
+  }
+  return MAGI_OK;
+#endif
+}
+
+int link_transmit(Link* link, struct Interface* sender, const uint8_t* data, size_t len) {
+  if (link == NULL || sender == NULL || data == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  struct Interface* receiver = link_peer(link, sender);
+  if (receiver == NULL) {
     free((void*)data);
+    magi_errno = MAGI_ERR_NOLINK;
+    return MAGI_ERR_NOLINK;
+  }
+
+  return link_send(link, sender, receiver, (uint8_t*)data, len, NULL);
+}
+
+int link_transmit_pkt(Link* link, struct Interface* sender, struct PktBuf* pkt) {
+  if (link == NULL || sender == NULL || pkt == NULL) {
+    pktbuf_release(pkt);
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
-  receiver->receive_up(receiver, data, len);
-  free((void*)data);
-  return MAGI_OK;
-#endif
+  struct Interface* receiver = link_peer(link, sender);
+  if (receiver == NULL) {
+    pktbuf_release(pkt);
+    magi_errno = MAGI_ERR_NOLINK;
+    return MAGI_ERR_NOLINK;
+  }
+
+  return link_send(link, sender, receiver, pkt->data, pkt->len, pkt);
 }
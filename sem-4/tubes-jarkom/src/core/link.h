@@ -1,15 +1,90 @@
 /**
  * @file link.h
  * @brief Link abstraction connecting two interfaces.
+ *
+ * A link models propagation delay and, once a bandwidth is set, the
+ * serialization delay of each frame and a bounded egress queue per
+ * direction. A frame sent while the transmitter is busy waits behind the
+ * frames already queued; one that finds the queue full (or is picked by
+ * RED) is dropped and counted.
  */
 
 #ifndef MAGI_CORE_LINK_H
 #define MAGI_CORE_LINK_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+struct Capture;
 struct Interface;
+struct LinkDelivery;
+struct PktBuf;
+
+/** Egress queue length used until link_set_queue() says otherwise, in frames. */
+#define LINK_QUEUE_DEFAULT_LIMIT 100U
+
+/**
+ * @brief Egress queue discipline.
+ */
+typedef enum LinkQueueKind {
+  /** Tail drop once the queue holds limit frames. */
+  LINK_QUEUE_FIFO = 0,
+  /** Random Early Detection on the averaged queue depth, plus tail drop. */
+  LINK_QUEUE_RED = 1,
+} LinkQueueKind;
+
+/**
+ * @brief Egress queue configuration, shared by both directions of a link.
+ */
+typedef struct LinkQueueConfig {
+  /** Queue discipline. */
+  LinkQueueKind kind;
+  /** Maximum frames queued, counting the one being serialized. */
+  uint32_t limit;
+  /** RED: averaged depth where early drops start (0 picks limit / 4). */
+  uint32_t red_min;
+  /** RED: averaged depth where every frame is dropped (0 picks 3 * limit / 4). */
+  uint32_t red_max;
+  /** RED: drop probability as the average reaches red_max (0 picks 0.1). */
+  double red_max_p;
+} LinkQueueConfig;
+
+/**
+ * @brief Traffic counters for one direction of a link, or both summed.
+ */
+typedef struct LinkStats {
+  /** Frames accepted for transmission. */
+  uint64_t tx_packets;
+  /** Bytes accepted for transmission. */
+  uint64_t tx_bytes;
+  /** Frames dropped by the egress queue. */
+  uint64_t drops;
+  /** Frames waiting or being serialized right now. */
+  uint32_t queue_depth;
+  /** Highest queue_depth seen. */
+  uint32_t queue_hwm;
+} LinkStats;
+
+/**
+ * @brief Egress state of one direction of a link.
+ */
+typedef struct LinkDirection {
+  /** Departure times of queued frames, oldest first (ring of queue.limit). */
+  uint64_t* departures;
+  size_t departure_head;
+  size_t departure_count;
+  /** Time the transmitter finishes the last queued frame. */
+  uint64_t busy_until_ns;
+  /** RED averaged queue depth. */
+  double red_avg;
+  /** RED frames accepted since the last early drop. */
+  uint32_t red_count;
+  /** RED random state. */
+  uint64_t red_rng;
+  /** Counters; queue_depth is refreshed on every transmit. */
+  LinkStats stats;
+} LinkDirection;
 
 /**
  * @brief Point-to-point link metadata.
@@ -23,6 +98,21 @@ typedef struct Link {
   uint32_t delay_ms;
   /** Link maximum transmission unit in bytes. */
   uint16_t mtu;
+  /** Line rate in bits per second; 0 means frames take no time to serialize. */
+  uint64_t bandwidth_bps;
+  /** Egress queue configuration. */
+  LinkQueueConfig queue;
+  /** Egress state; [0] is endpoint_a sending, [1] is endpoint_b sending. */
+  LinkDirection dir[2];
+  /** Frames waiting on the simulation clock to cross a delayed link (sequential builds). */
+  struct LinkDelivery* in_flight;
+#ifdef MAGI_ASYNC
+  /** Capture tap on frames sent by either endpoint, or NULL; see capture.h. */
+  struct Capture* _Atomic capture;
+#else
+  /** Capture tap on frames sent by either endpoint, or NULL; see capture.h. */
+  struct Capture* capture;
+#endif
 } Link;
 
 /**
@@ -39,19 +129,116 @@ Link* link_new(struct Interface* a, struct Interface* b, uint32_t delay_ms, uint
 /**
  * @brief Destroy a link and detach it from both endpoints.
  *
+ * Frames still in flight on the link are dropped.
+ *
  * @param link Link to free. NULL is allowed.
  */
 void link_free(Link* link);
 
+/**
+ * @brief Set the line rate.
+ *
+ * @param link Link to configure.
+ * @param bandwidth_bps Bits per second, or 0 for infinitely fast serialization.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int link_set_bandwidth(Link* link, uint64_t bandwidth_bps);
+
+/**
+ * @brief Replace the egress queue configuration of both directions.
+ *
+ * Zero RED parameters are filled with their defaults. Frames already
+ * queued keep their departure times but no longer count toward the depth.
+ *
+ * @param link Link to configure.
+ * @param config New configuration; limit must be at least 1.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int link_set_queue(Link* link, const LinkQueueConfig* config);
+
+/**
+ * @brief Read the counters of one direction, or of both summed.
+ *
+ * @param link Link to inspect.
+ * @param sender Endpoint whose egress to report, or NULL for both directions.
+ * @param out Receives the counters.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int link_get_stats(const Link* link, const struct Interface* sender, LinkStats* out);
+
+/**
+ * @brief Zero the counters of both directions.
+ *
+ * @param link Link to reset. NULL is allowed.
+ */
+void link_reset_stats(Link* link);
+
+/**
+ * @brief Name a queue discipline for display and JSON.
+ *
+ * @param kind Queue discipline.
+ * @return "fifo" or "red".
+ */
+const char* link_queue_kind_name(LinkQueueKind kind);
+
+/**
+ * @brief Parse a queue discipline name.
+ *
+ * @param text "fifo" or "red".
+ * @param out Receives the discipline.
+ * @return true if text names a discipline.
+ */
+bool link_parse_queue_kind(const char* text, LinkQueueKind* out);
+
+/**
+ * @brief Parse a bit rate such as "1000000", "100k", "10M" or "1G" (decimal units).
+ *
+ * @param text Rate text.
+ * @param out Receives bits per second.
+ * @return true if text is a valid rate.
+ */
+bool link_parse_rate(const char* text, uint64_t* out);
+
+/**
+ * @brief Format a bit rate with the largest exact decimal unit, e.g. "10M".
+ *
+ * @param bps Bits per second.
+ * @param out Output buffer.
+ * @param out_len Output buffer size; 24 bytes always suffice.
+ */
+void link_format_rate(uint64_t bps, char* out, size_t out_len);
+
 /**
  * @brief Transmit payload from one endpoint to the opposite endpoint.
  *
+ * The frame leaves once the frames queued ahead of it have been
+ * serialized and takes len * 8 / bandwidth_bps to serialize itself; it
+ * arrives delay_ms after that. A frame that arrives at once (no delay, no
+ * bandwidth) is delivered before returning. In sequential builds other
+ * frames are scheduled on the simulation clock (core/sim.h); async builds
+ * hand them to the engine's timer thread, which pushes them into the
+ * receiver's node queue once they are due (engine_push_at()).
+ *
  * @param link Link carrying the payload.
  * @param sender Source endpoint on the link.
  * @param data Heap-allocated payload bytes; ownership transfers to the link.
  * @param len Payload length in bytes.
- * @return MAGI_OK on success, otherwise an error code.
+ * @return MAGI_OK on success, MAGI_ERR_QUEUE_FULL if the egress queue
+ *         dropped the frame, otherwise an error code.
  */
 int link_transmit(Link* link, struct Interface* sender, const uint8_t* data, size_t len);
 
+/**
+ * @brief Transmit a packet buffer without copying it.
+ *
+ * The receiver's receive_up sees pkt->data directly. In async mode the
+ * buffer rides in the queued message and is released by the consumer.
+ *
+ * @param link Link carrying the packet.
+ * @param sender Source endpoint on the link.
+ * @param pkt Packet buffer; the caller's reference transfers to the link.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int link_transmit_pkt(Link* link, struct Interface* sender, struct PktBuf* pkt);
+
 #endif
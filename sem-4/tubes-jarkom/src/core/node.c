@@ -16,15 +16,13 @@
 #include <stdlib.h>
 #include <string.h>
 
-/**
- * @brief Free one interface entry during node teardown.
- */
-static void free_interface_entry(const char* key, void* value, void* ctx) {
-  (void)key;
-  (void)ctx;
+#ifdef MAGI_ASYNC
+/** Per-node receive ring size; a full ring drops frames unless back-pressure is on. */
+#define NODE_QUEUE_CAPACITY 1024U
+#endif
 
-  interface_free((Interface*)value);
-}
+/** Port table and interface list size allocated by the first interface. */
+#define NODE_PORT_SLOTS_INITIAL 8U
 
 /**
  * @brief Format a numeric port into the node interface map key.
@@ -33,6 +31,79 @@ static void build_port_key(uint16_t port, char key[16]) {
   snprintf(key, 16, "%u", (unsigned)port);
 }
 
+/**
+ * @brief Grow the port-indexed table so it has a slot for port.
+ *
+ * @param node Node whose table grows.
+ * @param port Port that needs a slot.
+ * @return MAGI_OK, or MAGI_ERR_NOMEM.
+ */
+static int node_port_table_reserve(Node* node, uint16_t port) {
+  if ((size_t)port < node->port_slots) {
+    return MAGI_OK;
+  }
+
+  size_t slots = node->port_slots != 0U ? node->port_slots : NODE_PORT_SLOTS_INITIAL;
+  while (slots <= (size_t)port) {
+    slots *= 2U;
+  }
+  Interface** table = realloc(node->port_table, slots * sizeof(*table));
+  if (table == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
+  }
+  memset(table + node->port_slots, 0, (slots - node->port_slots) * sizeof(*table));
+  node->port_table = table;
+  node->port_slots = slots;
+  return MAGI_OK;
+}
+
+/**
+ * @brief Insert an interface into the packed list, keeping port order.
+ *
+ * @param node  Node owning the list.
+ * @param iface Interface to insert.
+ * @return MAGI_OK, or MAGI_ERR_NOMEM.
+ */
+static int node_iface_list_insert(Node* node, Interface* iface) {
+  if (node->iface_count == node->iface_cap) {
+    size_t cap = node->iface_cap != 0U ? node->iface_cap * 2U : NODE_PORT_SLOTS_INITIAL;
+    Interface** list = realloc(node->iface_list, cap * sizeof(*list));
+    if (list == NULL) {
+      magi_errno = MAGI_ERR_NOMEM;
+      return MAGI_ERR_NOMEM;
+    }
+    node->iface_list = list;
+    node->iface_cap = cap;
+  }
+
+  size_t pos = node->iface_count;
+  while (pos > 0U && node->iface_list[pos - 1U]->port_number > iface->port_number) {
+    node->iface_list[pos] = node->iface_list[pos - 1U];
+    pos--;
+  }
+  node->iface_list[pos] = iface;
+  node->iface_count++;
+  return MAGI_OK;
+}
+
+/**
+ * @brief Remove an interface from the packed list.
+ *
+ * @param node  Node owning the list.
+ * @param iface Interface to remove.
+ */
+static void node_iface_list_remove(Node* node, const Interface* iface) {
+  for (size_t index = 0U; index < node->iface_count; ++index) {
+    if (node->iface_list[index] == iface) {
+      memmove(&node->iface_list[index], &node->iface_list[index + 1U],
+              (node->iface_count - index - 1U) * sizeof(*node->iface_list));
+      node->iface_count--;
+      return;
+    }
+  }
+}
+
 Node* node_new(const char* name) {
   Node* node = malloc(sizeof(*node));
   if (node == NULL) {
@@ -52,15 +123,19 @@ Node* node_new(const char* name) {
 
   node->handle_receive = NULL;
   node->arena = arena_new(ARENA_DEFAULT_CAPACITY);
-  if (node->arena == NULL) {
+  if (node->arena == NULL ||
+      magi_counters_init(&node->counters, MAGI_NODE_COUNTER_COUNT) != MAGI_OK) {
+    arena_free(node->arena);
     hashmap_free(node->interfaces);
     free(node);
     return NULL;
   }
 #ifdef MAGI_ASYNC
-  node->queue = queue_new(256U);
-  if (pthread_mutex_init(&node->lock, NULL) != 0) {
+  node->queue = queue_new(NODE_QUEUE_CAPACITY);
+  if (node->queue == NULL || pthread_mutex_init(&node->lock, NULL) != 0) {
     queue_free(node->queue);
+    magi_counters_free(&node->counters);
+    arena_free(node->arena);
     hashmap_free(node->interfaces);
     free(node);
     magi_errno = MAGI_ERR_NOMEM;
@@ -75,6 +150,10 @@ void node_free(Node* node) {
     return;
   }
 
+  if (node->l7_data_free != NULL) {
+    node->l7_data_free(node->l7_data);
+  }
+
   if (node->l4_data_free != NULL) {
     node->l4_data_free(node->l4_data);
   }
@@ -91,10 +170,13 @@ void node_free(Node* node) {
     node->data_free(node->data);
   }
 
-  if (node->interfaces != NULL) {
-    hashmap_foreach(node->interfaces, free_interface_entry, NULL);
-    hashmap_free(node->interfaces);
+  for (size_t index = 0U; index < node->iface_count; ++index) {
+    interface_free(node->iface_list[index]);
   }
+  free(node->iface_list);
+  free(node->port_table);
+  hashmap_free(node->interfaces);
+  magi_counters_free(&node->counters);
 
 #ifdef MAGI_ASYNC
   queue_free(node->queue);
@@ -110,36 +192,46 @@ struct Interface* node_add_interface(Node* node, uint16_t port) {
     return NULL;
   }
 
-  char key[16];
-  build_port_key(port, key);
-
-  Interface* existing = hashmap_get(node->interfaces, key);
+  Interface* existing = node_get_interface(node, port);
   if (existing != NULL) {
     return existing;
   }
 
+  if (node_port_table_reserve(node, port) != MAGI_OK) {
+    return NULL;
+  }
+
   Interface* iface = interface_new(node, port);
   if (iface == NULL) {
     return NULL;
   }
 
+  char key[16];
+  build_port_key(port, key);
   int status = hashmap_set(node->interfaces, key, iface);
+  if (status == MAGI_OK) {
+    status = node_iface_list_insert(node, iface);
+    if (status != MAGI_OK) {
+      (void)hashmap_delete(node->interfaces, key);
+    }
+  }
   if (status != MAGI_OK) {
     interface_free(iface);
     return NULL;
   }
 
+  node->port_table[port] = iface;
+
+  node->iface_gen++;
   return iface;
 }
 
 struct Interface* node_get_interface(Node* node, uint16_t port) {
-  if (node == NULL || port == 0U) {
+  if (node == NULL || (size_t)port >= node->port_slots) {
     return NULL;
   }
 
-  char key[16];
-  build_port_key(port, key);
-  return hashmap_get(node->interfaces, key);
+  return node->port_table[port];
 }
 
 int node_remove_interface(Node* node, uint16_t port) {
@@ -148,10 +240,7 @@ int node_remove_interface(Node* node, uint16_t port) {
     return MAGI_ERR_BADARGS;
   }
 
-  char key[16];
-  build_port_key(port, key);
-  Interface* iface = hashmap_get(node->interfaces, key);
-
+  Interface* iface = node_get_interface(node, port);
   if (iface == NULL) {
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
@@ -162,7 +251,12 @@ int node_remove_interface(Node* node, uint16_t port) {
     return MAGI_ERR_BADARGS;
   }
 
+  char key[16];
+  build_port_key(port, key);
   int status = hashmap_delete(node->interfaces, key);
+  node->port_table[port] = NULL;
+  node_iface_list_remove(node, iface);
   interface_free(iface);
+  node->iface_gen++;
   return status;
 }
@@ -9,19 +9,28 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "core/stats.h"
 #include "utils/arena.h"
 #include "utils/hashmap.h"
 
 struct Interface;
 struct Node;
+struct PktBuf;
+struct RxFrame;
+
+/** Most frames handed to handle_receive_batch in one call; longer bursts are split. */
+#define NODE_RX_BURST 32U
 
 typedef void (*node_l3_receive_fn)(struct Node* node, struct Interface* iface, const uint8_t* data,
                                    size_t len);
 typedef int (*node_l3_send_fn)(struct Node* node, const char* next_hop_ip, uint16_t ethertype,
                                const uint8_t* payload, size_t payload_len);
+typedef int (*node_l3_send_pkt_fn)(struct Node* node, const uint8_t next_hop_ip[4],
+                                   uint16_t ethertype, struct PktBuf* pkt);
 
 #ifdef MAGI_ASYNC
 #include <pthread.h>
+#include <stdatomic.h>
 
 struct MagiQueue;
 #endif
@@ -32,11 +41,28 @@ struct MagiQueue;
 typedef struct Node {
   /** Stable node name used in topology and logs. */
   char name[64];
-  /** Port map keyed by decimal port number string. */
+  /** Port map keyed by decimal port number string; kept for name-based (CLI/topology) lookups. */
   HashMap* interfaces;
+  /** Interfaces indexed by port number; NULL where a port does not exist. */
+  struct Interface** port_table;
+  /** Length of port_table (always greater than the highest port). */
+  size_t port_slots;
+  /** The same interfaces packed in ascending port order, for iteration. */
+  struct Interface** iface_list;
+  /** Number of entries in iface_list. */
+  size_t iface_count;
+  /** Capacity of iface_list. */
+  size_t iface_cap;
+  /** Bumped whenever an interface is added, removed, readdressed, or linked/unlinked. */
+  uint32_t iface_gen;
   /** Optional receive handler for frames arriving on an interface. */
   void (*handle_receive)(struct Node* node, struct Interface* iface, const uint8_t* data,
                          size_t len);
+  /**
+   * Optional burst handler taking up to NODE_RX_BURST frames for this node at once;
+   * see interface_receive_batch(). Nodes without one get their frames one at a time.
+   */
+  void (*handle_receive_batch)(struct Node* node, struct RxFrame* frames, size_t count);
   /** Optional layer-specific state owned by this node. */
   void* data;
   /** Optional destructor for layer-specific state. */
@@ -45,6 +71,8 @@ typedef struct Node {
   node_l3_receive_fn handle_l3_packet;
   /** Optional L3 send hook used by layer3 host logic without including layer2 headers. */
   node_l3_send_fn send_l3_packet;
+  /** Optional zero-copy L3 send hook; prepends the L2 header in place and consumes pkt. */
+  node_l3_send_pkt_fn send_l3_pkt;
   /** Optional L3-owned state. */
   void* l3_data;
   /** Optional destructor for L3-owned state. */
@@ -55,24 +83,47 @@ typedef struct Node {
   void* l4_data;
   /** Optional destructor for L4-specific state. */
   void (*l4_data_free)(void* data);
+  /** Optional L7 service state (HTTP/DNS/DHCP servers). */
+  void* l7_data;
+  /** Optional destructor for L7 service state; runs before the L4 state it uses goes away. */
+  void (*l7_data_free)(void* data);
   /** Optional L4 receive hook called by L3 for non-ICMP protocols. */
   void (*handle_l4_packet)(struct Node* node, const uint8_t src_ip[4], const uint8_t dst_ip[4],
                            uint8_t protocol, const uint8_t* payload, size_t payload_len);
   /** Optional L4→L3 send callback for emitting IP packets. */
   int (*send_ip_packet)(struct Node* node, const uint8_t src_ip[4], const uint8_t dst_ip[4],
                         uint8_t protocol, uint8_t ttl, const uint8_t* data, size_t len);
+  /** Optional zero-copy L4→L3 callback; prepends the IP header in place and consumes pkt. */
+  int (*send_ip_pkt)(struct Node* node, const uint8_t src_ip[4], const uint8_t dst_ip[4],
+                     uint8_t protocol, uint8_t ttl, struct PktBuf* pkt);
   /** Host default gateway, if configured. */
   char default_gateway[64];
+  /** Optional periodic hook run every 30 s by the async engine (RIP updates). */
+  int (*async_tick_30s)(struct Node* node);
+  /** Drop, ARP and FIB counters, indexed by MagiNodeCounter. */
+  MagiCounters counters;
 #ifdef MAGI_ASYNC
-  /** Worker thread used in async mode. */
-  pthread_t thread;
   /** Async message queue used in async mode. */
   struct MagiQueue* queue;
   /** Node-level lock used in async mode. */
   pthread_mutex_t lock;
+  /** True while the node sits in, or is being run from, an engine worker's task deque. */
+  atomic_bool async_scheduled;
 #endif
 } Node;
 
+/**
+ * @brief Count one event against a node.
+ *
+ * @param node Node, or NULL to count nothing.
+ * @param counter Event to count.
+ */
+static inline void node_count(Node* node, MagiNodeCounter counter) {
+  if (node != NULL) {
+    magi_counter_add(&node->counters, counter, 1U);
+  }
+}
+
 /**
  * @brief Allocate and initialize a node.
  *
@@ -100,6 +151,9 @@ struct Interface* node_add_interface(Node* node, uint16_t port);
 /**
  * @brief Look up a node interface by port number.
  *
+ * O(1): indexes node->port_table. To visit every interface, walk
+ * node->iface_list[0..iface_count) instead of the name map.
+ *
  * @param node Node instance.
  * @param port Port number.
  * @return Matching interface, or NULL if absent.
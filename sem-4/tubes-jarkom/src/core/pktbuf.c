@@ -0,0 +1,110 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pktbuf.h"
+
+#include "utils/magi_error.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+PktBuf* pktbuf_new(size_t headroom, size_t size) {
+  if (size > SIZE_MAX - sizeof(PktBuf) || headroom > SIZE_MAX - sizeof(PktBuf) - size) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return NULL;
+  }
+
+  PktBuf* pkt = malloc(sizeof(*pkt) + headroom + size);
+  if (pkt == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+
+  pkt->data = pkt->storage + headroom;
+  pkt->len = 0U;
+  pkt->capacity = headroom + size;
+  atomic_init(&pkt->refcnt, 1U);
+  return pkt;
+}
+
+PktBuf* pktbuf_copy(size_t headroom, const uint8_t* data, size_t len) {
+  if (len > 0U && data == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return NULL;
+  }
+
+  PktBuf* pkt = pktbuf_new(headroom, len);
+  if (pkt == NULL) {
+    return NULL;
+  }
+
+  if (len > 0U) {
+    memcpy(pkt->data, data, len);
+  }
+  pkt->len = len;
+  return pkt;
+}
+
+PktBuf* pktbuf_ref(PktBuf* pkt) {
+  if (pkt != NULL) {
+    atomic_fetch_add_explicit(&pkt->refcnt, 1U, memory_order_relaxed);
+  }
+  return pkt;
+}
+
+void pktbuf_release(PktBuf* pkt) {
+  if (pkt == NULL) {
+    return;
+  }
+
+  if (atomic_fetch_sub_explicit(&pkt->refcnt, 1U, memory_order_acq_rel) == 1U) {
+    free(pkt);
+  }
+}
+
+bool pktbuf_shared(const PktBuf* pkt) {
+  return pkt != NULL && atomic_load_explicit(&pkt->refcnt, memory_order_acquire) > 1U;
+}
+
+uint8_t* pktbuf_push(PktBuf* pkt, size_t n) {
+  if (pkt == NULL || pktbuf_headroom(pkt) < n) {
+    return NULL;
+  }
+
+  pkt->data -= n;
+  pkt->len += n;
+  return pkt->data;
+}
+
+uint8_t* pktbuf_pull(PktBuf* pkt, size_t n) {
+  if (pkt == NULL || pkt->len < n) {
+    return NULL;
+  }
+
+  pkt->data += n;
+  pkt->len -= n;
+  return pkt->data;
+}
+
+uint8_t* pktbuf_put(PktBuf* pkt, size_t n) {
+  if (pkt == NULL || pktbuf_tailroom(pkt) < n) {
+    return NULL;
+  }
+
+  uint8_t* tail = pkt->data + pkt->len;
+  pkt->len += n;
+  return tail;
+}
+
+void pktbuf_trim(PktBuf* pkt, size_t len) {
+  if (pkt != NULL && len < pkt->len) {
+    pkt->len = len;
+  }
+}
+
+size_t pktbuf_headroom(const PktBuf* pkt) {
+  return pkt != NULL ? (size_t)(pkt->data - pkt->storage) : 0U;
+}
+
+size_t pktbuf_tailroom(const PktBuf* pkt) {
+  return pkt != NULL ? pkt->capacity - pktbuf_headroom(pkt) - pkt->len : 0U;
+}
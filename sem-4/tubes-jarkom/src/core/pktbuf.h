@@ -0,0 +1,137 @@
+/**
+ * @file pktbuf.h
+ * @brief Refcounted packet buffer with headroom for zero-copy encapsulation.
+ *
+ * A PktBuf is one allocation holding its control block and storage. Each
+ * layer prepends its header into the headroom with pktbuf_push() instead of
+ * allocating a new buffer and copying the payload behind it, so a TCP
+ * segment travels TCP -> IPv4 -> Ethernet -> link -> receive_up in the
+ * buffer it was built in. A buffer that has been handed to more than one
+ * holder (pktbuf_ref) must be treated as read-only.
+ */
+
+#ifndef MAGI_CORE_PKTBUF_H
+#define MAGI_CORE_PKTBUF_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Default headroom: a VLAN-tagged Ethernet header plus an option-free IPv4 header, rounded up. */
+#define PKTBUF_HEADROOM 64U
+
+/**
+ * @brief Refcounted packet buffer.
+ *
+ * The valid bytes are data[0..len). Bytes between the storage start and
+ * data are headroom; bytes after data + len up to the end of storage are
+ * tailroom.
+ */
+typedef struct PktBuf {
+  /** First valid byte. */
+  uint8_t* data;
+  /** Number of valid bytes. */
+  size_t len;
+  /** Total storage size in bytes. */
+  size_t capacity;
+  /** Number of holders; the buffer is freed when it drops to zero. */
+  atomic_uint refcnt;
+  /** Inline storage. */
+  uint8_t storage[];
+} PktBuf;
+
+/**
+ * @brief Allocate an empty buffer.
+ *
+ * @param headroom Bytes reserved in front of data for later pushes.
+ * @param size Bytes of tailroom available for pktbuf_put().
+ * @return Buffer with refcount 1 and len 0, or NULL on failure.
+ */
+PktBuf* pktbuf_new(size_t headroom, size_t size);
+
+/**
+ * @brief Allocate a buffer holding a copy of existing bytes.
+ *
+ * @param headroom Bytes reserved in front of the copied data.
+ * @param data Source bytes (may be NULL if len is 0).
+ * @param len Number of bytes to copy.
+ * @return Buffer with refcount 1, or NULL on failure.
+ */
+PktBuf* pktbuf_copy(size_t headroom, const uint8_t* data, size_t len);
+
+/**
+ * @brief Take an additional reference.
+ *
+ * @param pkt Buffer to share. NULL is allowed.
+ * @return pkt.
+ */
+PktBuf* pktbuf_ref(PktBuf* pkt);
+
+/**
+ * @brief Drop one reference, freeing the buffer on the last one.
+ *
+ * @param pkt Buffer to release. NULL is allowed.
+ */
+void pktbuf_release(PktBuf* pkt);
+
+/**
+ * @brief Whether more than one holder references the buffer.
+ *
+ * @param pkt Buffer to inspect.
+ * @return true if the buffer must be treated as read-only; false for NULL.
+ */
+bool pktbuf_shared(const PktBuf* pkt);
+
+/**
+ * @brief Grow the valid region at the front (prepend a header).
+ *
+ * @param pkt Buffer to modify.
+ * @param n Number of bytes to prepend.
+ * @return Pointer to the new first byte, or NULL if headroom is too small.
+ */
+uint8_t* pktbuf_push(PktBuf* pkt, size_t n);
+
+/**
+ * @brief Shrink the valid region at the front (strip a header).
+ *
+ * @param pkt Buffer to modify.
+ * @param n Number of bytes to remove.
+ * @return Pointer to the new first byte, or NULL if len is smaller than n.
+ */
+uint8_t* pktbuf_pull(PktBuf* pkt, size_t n);
+
+/**
+ * @brief Grow the valid region at the back (append data).
+ *
+ * @param pkt Buffer to modify.
+ * @param n Number of bytes to append.
+ * @return Pointer to the first appended byte, or NULL if tailroom is too small.
+ */
+uint8_t* pktbuf_put(PktBuf* pkt, size_t n);
+
+/**
+ * @brief Cut the valid region down to a given length.
+ *
+ * @param pkt Buffer to modify.
+ * @param len New length; larger values are ignored.
+ */
+void pktbuf_trim(PktBuf* pkt, size_t len);
+
+/**
+ * @brief Bytes available in front of data.
+ *
+ * @param pkt Buffer.
+ * @return Headroom in bytes, or 0 for NULL.
+ */
+size_t pktbuf_headroom(const PktBuf* pkt);
+
+/**
+ * @brief Bytes available after data + len.
+ *
+ * @param pkt Buffer.
+ * @return Tailroom in bytes, or 0 for NULL.
+ */
+size_t pktbuf_tailroom(const PktBuf* pkt);
+
+#endif
@@ -0,0 +1,245 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "sim.h"
+
+#include "utils/magi_error.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct SimState {
+  /** Virtual clock. */
+  uint64_t now_ns;
+  /** Next arm sequence number. */
+  uint64_t next_seq;
+  /** Binary min-heap of armed timers. */
+  SimTimer** heap;
+  size_t count;
+  size_t capacity;
+  /** Sleep for each clock advance when true. */
+  bool realtime;
+} SimState;
+
+static SimState sim_state = {
+    .now_ns = 0U,
+    .next_seq = 0U,
+    .heap = NULL,
+    .count = 0U,
+    .capacity = 0U,
+    .realtime = false,
+};
+
+/**
+ * @brief Order two timers by deadline, then by arm order.
+ */
+static bool timer_before(const SimTimer* a, const SimTimer* b) {
+  return a->at_ns < b->at_ns || (a->at_ns == b->at_ns && a->seq < b->seq);
+}
+
+/**
+ * @brief Store a timer at a heap index and record the index in the timer.
+ */
+static void heap_place(size_t index, SimTimer* timer) {
+  sim_state.heap[index] = timer;
+  timer->slot = index;
+}
+
+static void heap_sift_up(size_t index) {
+  SimTimer* timer = sim_state.heap[index];
+  while (index > 0U) {
+    size_t parent = (index - 1U) / 2U;
+    if (!timer_before(timer, sim_state.heap[parent])) {
+      break;
+    }
+    heap_place(index, sim_state.heap[parent]);
+    index = parent;
+  }
+  heap_place(index, timer);
+}
+
+static void heap_sift_down(size_t index) {
+  SimTimer* timer = sim_state.heap[index];
+  for (;;) {
+    size_t child = index * 2U + 1U;
+    if (child >= sim_state.count) {
+      break;
+    }
+    if (child + 1U < sim_state.count &&
+        timer_before(sim_state.heap[child + 1U], sim_state.heap[child])) {
+      child++;
+    }
+    if (!timer_before(sim_state.heap[child], timer)) {
+      break;
+    }
+    heap_place(index, sim_state.heap[child]);
+    index = child;
+  }
+  heap_place(index, timer);
+}
+
+/**
+ * @brief Remove the timer at a heap index and mark it idle.
+ */
+static void heap_remove(size_t index) {
+  SimTimer* removed = sim_state.heap[index];
+  sim_state.count--;
+  if (index < sim_state.count) {
+    SimTimer* last = sim_state.heap[sim_state.count];
+    heap_place(index, last);
+    if (index > 0U && timer_before(last, sim_state.heap[(index - 1U) / 2U])) {
+      heap_sift_up(index);
+    } else {
+      heap_sift_down(index);
+    }
+  }
+  removed->slot = SIM_TIMER_IDLE;
+}
+
+/**
+ * @brief Sleep for a span of virtual time when real-time pacing is on.
+ */
+static void pace(uint64_t span_ns) {
+  if (!sim_state.realtime || span_ns == 0U) {
+    return;
+  }
+
+  struct timespec request;
+  request.tv_sec = (time_t)(span_ns / 1000000000ULL);
+  request.tv_nsec = (long)(span_ns % 1000000000ULL);
+  while (nanosleep(&request, &request) != 0) {
+    if (request.tv_sec == 0 && request.tv_nsec == 0) {
+      break;
+    }
+  }
+}
+
+/**
+ * @brief Move the clock forward, pacing if requested. Never moves it back.
+ */
+static void advance_to(uint64_t at_ns) {
+  if (at_ns > sim_state.now_ns) {
+    pace(at_ns - sim_state.now_ns);
+    sim_state.now_ns = at_ns;
+  }
+}
+
+uint64_t sim_now_ns(void) {
+#ifdef MAGI_ASYNC
+  struct timespec now;
+  if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+    return 0U;
+  }
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+#else
+  return sim_state.now_ns;
+#endif
+}
+
+uint64_t sim_now_ms(void) {
+  return sim_now_ns() / SIM_NS_PER_MS;
+}
+
+void sim_timer_init(SimTimer* timer, sim_event_fn fn, void* ctx) {
+  if (timer == NULL) {
+    return;
+  }
+
+  timer->at_ns = 0U;
+  timer->seq = 0U;
+  timer->slot = SIM_TIMER_IDLE;
+  timer->fn = fn;
+  timer->ctx = ctx;
+}
+
+int sim_timer_arm(SimTimer* timer, uint64_t delay_ns) {
+  if (timer == NULL || timer->fn == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  sim_timer_cancel(timer);
+  if (sim_state.count == sim_state.capacity) {
+    size_t capacity = sim_state.capacity == 0U ? 64U : sim_state.capacity * 2U;
+    SimTimer** heap = realloc(sim_state.heap, capacity * sizeof(*heap));
+    if (heap == NULL) {
+      magi_errno = MAGI_ERR_NOMEM;
+      return MAGI_ERR_NOMEM;
+    }
+    sim_state.heap = heap;
+    sim_state.capacity = capacity;
+  }
+
+  timer->at_ns = sim_state.now_ns + delay_ns;
+  timer->seq = sim_state.next_seq++;
+  heap_place(sim_state.count, timer);
+  sim_state.count++;
+  heap_sift_up(timer->slot);
+  return MAGI_OK;
+}
+
+void sim_timer_cancel(SimTimer* timer) {
+  if (timer != NULL && timer->slot != SIM_TIMER_IDLE) {
+    heap_remove(timer->slot);
+  }
+}
+
+bool sim_timer_armed(const SimTimer* timer) {
+  return timer != NULL && timer->slot != SIM_TIMER_IDLE;
+}
+
+bool sim_run_next(uint64_t deadline_ns) {
+  if (sim_state.count == 0U || sim_state.heap[0]->at_ns > deadline_ns) {
+    return false;
+  }
+
+  SimTimer* timer = sim_state.heap[0];
+  heap_remove(0U);
+  advance_to(timer->at_ns);
+  timer->fn(timer->ctx);
+  return true;
+}
+
+size_t sim_run_until(uint64_t deadline_ns) {
+  size_t ran = 0U;
+  while (sim_run_next(deadline_ns)) {
+    ran++;
+  }
+  advance_to(deadline_ns);
+  return ran;
+}
+
+size_t sim_run_for(uint64_t window_ns) {
+  uint64_t deadline = sim_state.now_ns + window_ns;
+  size_t ran = 0U;
+  while (sim_run_next(deadline)) {
+    ran++;
+  }
+  return ran;
+}
+
+bool sim_run_until_cond(sim_cond_fn done, const void* ctx, uint64_t timeout_ns) {
+  if (done == NULL) {
+    return false;
+  }
+
+  uint64_t deadline = sim_state.now_ns + timeout_ns;
+  while (!done(ctx) && sim_run_next(deadline)) {
+  }
+  if (!done(ctx)) {
+    advance_to(deadline);
+    return false;
+  }
+  return true;
+}
+
+size_t sim_pending(void) {
+  return sim_state.count;
+}
+
+void sim_set_realtime(bool enabled) {
+  sim_state.realtime = enabled;
+}
+
+bool sim_realtime(void) {
+  return sim_state.realtime;
+}
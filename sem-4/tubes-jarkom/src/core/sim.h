@@ -0,0 +1,163 @@
+/**
+ * @file sim.h
+ * @brief Discrete-event simulation clock and timer queue.
+ *
+ * Sequential builds run on virtual time. Link delays, RIP updates and
+ * protocol timeouts are timers in one priority queue ordered by
+ * (deadline, arm order), and running an event moves the clock straight to
+ * its deadline. A 10-hop traceroute over 20 ms links therefore finishes
+ * as fast as the CPU allows, and reports exact, reproducible RTTs.
+ * sim_set_realtime() paces events against the wall clock for demos.
+ *
+ * The queue is single-threaded. MAGI_ASYNC builds keep their wall-clock
+ * link delays and engine timer; there sim_now_ns() reads CLOCK_MONOTONIC
+ * and nothing is scheduled on the queue.
+ */
+
+#ifndef MAGI_CORE_SIM_H
+#define MAGI_CORE_SIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Nanoseconds per millisecond, for converting delay_ms style values. */
+#define SIM_NS_PER_MS 1000000ULL
+
+/** SimTimer.slot value for a timer that is not armed. */
+#define SIM_TIMER_IDLE SIZE_MAX
+
+typedef void (*sim_event_fn)(void* ctx);
+typedef bool (*sim_cond_fn)(const void* ctx);
+
+/**
+ * @brief Intrusive timer; embed it in the object the event belongs to.
+ *
+ * The owner must cancel an armed timer before freeing the memory it lives in.
+ */
+typedef struct SimTimer {
+  /** Virtual time the event fires at. */
+  uint64_t at_ns;
+  /** Arm order; breaks ties so equal deadlines fire first-armed first. */
+  uint64_t seq;
+  /** Index in the queue, or SIM_TIMER_IDLE. */
+  size_t slot;
+  /** Callback run when the timer fires. */
+  sim_event_fn fn;
+  /** Context passed to fn. */
+  void* ctx;
+} SimTimer;
+
+/**
+ * @brief Current simulation time.
+ *
+ * @return Virtual nanoseconds since start (wall-clock monotonic time in async builds).
+ */
+uint64_t sim_now_ns(void);
+
+/**
+ * @brief Current simulation time in milliseconds.
+ *
+ * @return sim_now_ns() / SIM_NS_PER_MS.
+ */
+uint64_t sim_now_ms(void);
+
+/**
+ * @brief Initialise an idle timer.
+ *
+ * @param timer Timer to initialise.
+ * @param fn Callback run when the timer fires; the timer is idle again by then.
+ * @param ctx Context passed to fn.
+ */
+void sim_timer_init(SimTimer* timer, sim_event_fn fn, void* ctx);
+
+/**
+ * @brief Arm a timer to fire delay_ns from now, re-arming it if already armed.
+ *
+ * @param timer Initialised timer.
+ * @param delay_ns Delay in nanoseconds.
+ * @return MAGI_OK on success, or MAGI_ERR_NOMEM if the queue cannot grow.
+ */
+int sim_timer_arm(SimTimer* timer, uint64_t delay_ns);
+
+/**
+ * @brief Disarm a timer. Safe on idle timers.
+ *
+ * @param timer Timer to cancel. NULL is allowed.
+ */
+void sim_timer_cancel(SimTimer* timer);
+
+/**
+ * @brief Check whether a timer is armed.
+ *
+ * @param timer Timer to inspect.
+ * @return true if the timer is waiting in the queue.
+ */
+bool sim_timer_armed(const SimTimer* timer);
+
+/**
+ * @brief Run the earliest event if it is due no later than deadline_ns.
+ *
+ * @param deadline_ns Latest virtual time to run an event at.
+ * @return true if an event ran.
+ */
+bool sim_run_next(uint64_t deadline_ns);
+
+/**
+ * @brief Run every event due up to deadline_ns, then set the clock to deadline_ns.
+ *
+ * @param deadline_ns Virtual time to advance to.
+ * @return Number of events run.
+ */
+size_t sim_run_until(uint64_t deadline_ns);
+
+/**
+ * @brief Run events due within window_ns of now; the clock stops at the last one.
+ *
+ * Used to let in-flight traffic land without skipping over idle time.
+ *
+ * @param window_ns Look-ahead window in nanoseconds.
+ * @return Number of events run.
+ */
+size_t sim_run_for(uint64_t window_ns);
+
+/**
+ * @brief Run events until done(ctx) holds or nothing is due within timeout_ns.
+ *
+ * This is how callers that used to rely on synchronous delivery wait for a
+ * reply. On success the clock stops at the event that completed the wait;
+ * on timeout it moves to now + timeout_ns, so the time spent waiting counts
+ * toward retransmit throttles and entry lifetimes.
+ *
+ * @param done Completion predicate.
+ * @param ctx Context passed to done.
+ * @param timeout_ns Give up once the next event lies beyond now + timeout_ns.
+ * @return The final value of done(ctx).
+ */
+bool sim_run_until_cond(sim_cond_fn done, const void* ctx, uint64_t timeout_ns);
+
+/**
+ * @brief Number of armed timers.
+ *
+ * @return Queue length.
+ */
+size_t sim_pending(void);
+
+/**
+ * @brief Pace events against the wall clock.
+ *
+ * When enabled, running an event first sleeps for the virtual time it
+ * advances the clock by, so delays are visible in real time.
+ *
+ * @param enabled true to pace, false to run as fast as possible.
+ */
+void sim_set_realtime(bool enabled);
+
+/**
+ * @brief Check whether real-time pacing is on.
+ *
+ * @return true if sim_set_realtime(true) is in effect.
+ */
+bool sim_realtime(void);
+
+#endif
@@ -0,0 +1,123 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "stats.h"
+
+#include "utils/magi_error.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/** Bytes per cache line. */
+#define MAGI_STATS_LINE_BYTES (MAGI_STATS_LINE_CELLS * sizeof(MagiCounterCell))
+
+_Thread_local uint32_t magi_stats_thread_shard = 0U;
+
+static const char* const iface_counter_names[MAGI_IFACE_COUNTER_COUNT] = {
+    "rx_packets",
+    "rx_bytes",
+    "tx_packets",
+    "tx_bytes",
+};
+
+static const char* const node_counter_names[MAGI_NODE_COUNTER_COUNT] = {
+    "drop_malformed",
+    "drop_vlan",
+    "drop_ttl",
+    "drop_no_route",
+    "drop_acl",
+    "drop_queue_full",
+    "arp_hits",
+    "arp_misses",
+    "fib_lookups",
+    "flow_hits",
+    "flow_misses",
+};
+
+uint32_t magi_stats_assign_shard(void) {
+#ifdef MAGI_ASYNC
+  static atomic_uint next_shard;
+  uint32_t shard = atomic_fetch_add_explicit(&next_shard, 1U, memory_order_relaxed);
+  /* The last shard is shared by every thread past the owned ones. */
+  magi_stats_thread_shard = (shard < MAGI_STATS_SHARDS ? shard : MAGI_STATS_SHARDS - 1U) + 1U;
+#else
+  magi_stats_thread_shard = 1U;
+#endif
+  return magi_stats_thread_shard;
+}
+
+int magi_counters_init(MagiCounters* counters, size_t count) {
+  if (counters == NULL || count == 0U) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  size_t stride = (count + MAGI_STATS_LINE_CELLS - 1U) / MAGI_STATS_LINE_CELLS *
+                  MAGI_STATS_LINE_CELLS;
+  size_t bytes = stride * MAGI_STATS_SHARDS * sizeof(MagiCounterCell);
+  MagiCounterCell* cells = aligned_alloc(MAGI_STATS_LINE_BYTES, bytes);
+  if (cells == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
+  }
+
+  memset(cells, 0, bytes);
+  counters->cells = cells;
+  counters->stride = (uint32_t)stride;
+  counters->count = (uint32_t)count;
+  return MAGI_OK;
+}
+
+void magi_counters_free(MagiCounters* counters) {
+  if (counters == NULL) {
+    return;
+  }
+
+  free(counters->cells);
+  counters->cells = NULL;
+  counters->stride = 0U;
+  counters->count = 0U;
+}
+
+uint64_t magi_counter_read(const MagiCounters* counters, size_t counter) {
+  if (counters == NULL || counters->cells == NULL || counter >= counters->count) {
+    return 0U;
+  }
+
+  uint64_t total = 0U;
+  for (size_t shard = 0U; shard < MAGI_STATS_SHARDS; ++shard) {
+    const MagiCounterCell* cell = &counters->cells[shard * counters->stride + counter];
+#ifdef MAGI_ASYNC
+    total += atomic_load_explicit(cell, memory_order_relaxed);
+#else
+    total += *cell;
+#endif
+  }
+  return total;
+}
+
+void magi_counters_reset(MagiCounters* counters) {
+  if (counters == NULL || counters->cells == NULL) {
+    return;
+  }
+
+  for (size_t index = 0U; index < (size_t)counters->stride * MAGI_STATS_SHARDS; ++index) {
+#ifdef MAGI_ASYNC
+    atomic_store_explicit(&counters->cells[index], 0U, memory_order_relaxed);
+#else
+    counters->cells[index] = 0U;
+#endif
+  }
+}
+
+const char* magi_iface_counter_name(MagiIfaceCounter counter) {
+  return (unsigned)counter < MAGI_IFACE_COUNTER_COUNT ? iface_counter_names[counter] : "?";
+}
+
+const char* magi_node_counter_name(MagiNodeCounter counter) {
+  return (unsigned)counter < MAGI_NODE_COUNTER_COUNT ? node_counter_names[counter] : "?";
+}
+
+const char* magi_drop_reason_name(MagiNodeCounter counter) {
+  /* Skip the "drop_" prefix. */
+  return (unsigned)counter < MAGI_NODE_DROP_REASONS ? node_counter_names[counter] + 5 : "?";
+}
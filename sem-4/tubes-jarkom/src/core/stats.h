@@ -0,0 +1,182 @@
+/**
+ * @file stats.h
+ * @brief Cheap per-interface and per-node packet counters.
+ *
+ * A MagiCounters block is a small array of 64-bit counters. Bumping one is
+ * a plain add in the sequential build. With MAGI_ASYNC the block holds
+ * MAGI_STATS_SHARDS copies, each padded to its own cache line. The first
+ * MAGI_STATS_SHARDS - 1 threads that count each own a copy and update it
+ * with a relaxed load and store (no locked instruction); any further
+ * threads share the last copy through atomic adds. Engine workers thus
+ * never bounce counter lines between cores. Readers sum the copies.
+ */
+
+#ifndef MAGI_CORE_STATS_H
+#define MAGI_CORE_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef MAGI_ASYNC
+#include <stdatomic.h>
+#endif
+
+/** Counters per cache line. */
+#define MAGI_STATS_LINE_CELLS 8U
+
+#ifdef MAGI_ASYNC
+/** Copies of every counter block; all but the last are owned by one thread each. */
+#define MAGI_STATS_SHARDS 16U
+typedef _Atomic uint64_t MagiCounterCell;
+#else
+#define MAGI_STATS_SHARDS 1U
+typedef uint64_t MagiCounterCell;
+#endif
+
+/** @brief Counters kept for every interface. */
+typedef enum MagiIfaceCounter {
+  MAGI_IFACE_RX_PACKETS = 0,
+  MAGI_IFACE_RX_BYTES,
+  MAGI_IFACE_TX_PACKETS,
+  MAGI_IFACE_TX_BYTES,
+  MAGI_IFACE_COUNTER_COUNT,
+} MagiIfaceCounter;
+
+/** @brief Counters kept for every node. The drop reasons come first. */
+typedef enum MagiNodeCounter {
+  /** Frame or packet failed to parse or verify. */
+  MAGI_NODE_DROP_MALFORMED = 0,
+  /** Frame arrived with a VLAN its port does not carry. */
+  MAGI_NODE_DROP_VLAN,
+  /** TTL ran out while forwarding. */
+  MAGI_NODE_DROP_TTL,
+  /** No route (or default gateway) for the destination. */
+  MAGI_NODE_DROP_NO_ROUTE,
+  /** Denied by an access list. */
+  MAGI_NODE_DROP_ACL,
+  /** Egress link queue or node receive queue was full. */
+  MAGI_NODE_DROP_QUEUE_FULL,
+  /** Next-hop MAC found in the neighbor table. */
+  MAGI_NODE_ARP_HITS,
+  /** Next-hop MAC missing; the packet waits for ARP. */
+  MAGI_NODE_ARP_MISSES,
+  /** Longest-prefix-match lookups. */
+  MAGI_NODE_FIB_LOOKUPS,
+  /** Packets forwarded straight from the flow cache. */
+  MAGI_NODE_FLOW_HITS,
+  /** Flow cache lookups that fell back to LPM and ARP. */
+  MAGI_NODE_FLOW_MISSES,
+  MAGI_NODE_COUNTER_COUNT,
+} MagiNodeCounter;
+
+/** Number of drop reasons at the start of MagiNodeCounter. */
+#define MAGI_NODE_DROP_REASONS (MAGI_NODE_DROP_QUEUE_FULL + 1)
+
+/**
+ * @brief A block of counters.
+ */
+typedef struct MagiCounters {
+  /** MAGI_STATS_SHARDS rows of stride cells, cache-line aligned; NULL if not set up. */
+  MagiCounterCell* cells;
+  /** Cells per row: the counter count rounded up to whole cache lines. */
+  uint32_t stride;
+  /** Number of counters. */
+  uint32_t count;
+} MagiCounters;
+
+/** Shard of the calling thread plus one; 0 until the thread first counts. */
+extern _Thread_local uint32_t magi_stats_thread_shard;
+
+/**
+ * @brief Pick a shard for the calling thread (internal; see magi_counter_add()).
+ *
+ * @return Shard index plus one.
+ */
+uint32_t magi_stats_assign_shard(void);
+
+/**
+ * @brief Add to one counter.
+ *
+ * @param counters Counter block; a block that was never set up is ignored.
+ * @param counter Counter index.
+ * @param amount Amount to add.
+ */
+static inline void magi_counter_add(MagiCounters* counters, size_t counter, uint64_t amount) {
+  if (counters->cells == NULL) {
+    return;
+  }
+#ifdef MAGI_ASYNC
+  uint32_t shard = magi_stats_thread_shard;
+  if (shard == 0U) {
+    shard = magi_stats_assign_shard();
+  }
+  MagiCounterCell* cell = &counters->cells[(size_t)(shard - 1U) * counters->stride + counter];
+  if (shard < MAGI_STATS_SHARDS) {
+    /* Only this thread writes its own shard. */
+    uint64_t value = atomic_load_explicit(cell, memory_order_relaxed);
+    atomic_store_explicit(cell, value + amount, memory_order_relaxed);
+  } else {
+    atomic_fetch_add_explicit(cell, amount, memory_order_relaxed);
+  }
+#else
+  counters->cells[counter] += amount;
+#endif
+}
+
+/**
+ * @brief Allocate a zeroed counter block.
+ *
+ * @param counters Block to set up.
+ * @param count Number of counters.
+ * @return MAGI_OK, or MAGI_ERR_NOMEM.
+ */
+int magi_counters_init(MagiCounters* counters, size_t count);
+
+/**
+ * @brief Release a counter block. Safe on a block that was never set up.
+ *
+ * @param counters Block to release.
+ */
+void magi_counters_free(MagiCounters* counters);
+
+/**
+ * @brief Read one counter, summed over every shard.
+ *
+ * @param counters Counter block.
+ * @param counter Counter index.
+ * @return Current value, or 0 for an unset block or index.
+ */
+uint64_t magi_counter_read(const MagiCounters* counters, size_t counter);
+
+/**
+ * @brief Zero every counter in a block.
+ *
+ * @param counters Counter block.
+ */
+void magi_counters_reset(MagiCounters* counters);
+
+/**
+ * @brief Metric name of an interface counter, such as "rx_packets".
+ *
+ * @param counter Counter index.
+ * @return Static string.
+ */
+const char* magi_iface_counter_name(MagiIfaceCounter counter);
+
+/**
+ * @brief Metric name of a node counter, such as "drop_ttl" or "fib_lookups".
+ *
+ * @param counter Counter index.
+ * @return Static string.
+ */
+const char* magi_node_counter_name(MagiNodeCounter counter);
+
+/**
+ * @brief Short name of a drop reason, such as "ttl".
+ *
+ * @param counter A counter below MAGI_NODE_DROP_REASONS.
+ * @return Static string.
+ */
+const char* magi_drop_reason_name(MagiNodeCounter counter);
+
+#endif
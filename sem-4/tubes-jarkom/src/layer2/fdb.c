@@ -0,0 +1,276 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "fdb.h"
+
+#include "core/sim.h"
+#include "utils/magi_error.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define FDB_MIN_SLOTS 8U
+#define FDB_MAC_MASK 0xFFFFFFFFFFFFULL
+
+struct Fdb {
+  FdbEntry* slots;
+  /** Power of two, at least capacity * 4 / 3 so probes stay short when full. */
+  size_t slot_count;
+  size_t capacity;
+  size_t count;
+  uint32_t aging_ms;
+  uint64_t learned;
+  uint64_t moves;
+  uint64_t flaps;
+  uint64_t aged;
+  uint64_t full_drops;
+};
+
+/**
+ * @brief Home slot for a key (multiplicative hash with a high-half fold).
+ *
+ * @param fdb Forwarding database.
+ * @param key Packed (VLAN, MAC) key.
+ * @return Slot index.
+ */
+static size_t fdb_home(const Fdb* fdb, uint64_t key) {
+  uint64_t hash = key * 0x9E3779B97F4A7C15ULL;
+  hash ^= hash >> 32U;
+  return (size_t)(hash & (uint64_t)(fdb->slot_count - 1U));
+}
+
+/**
+ * @brief Find the slot holding a key, or the empty slot where it would go.
+ *
+ * @param fdb Forwarding database.
+ * @param key Packed (VLAN, MAC) key.
+ * @return Slot index.
+ */
+static size_t fdb_probe(const Fdb* fdb, uint64_t key) {
+  size_t mask = fdb->slot_count - 1U;
+  size_t pos = fdb_home(fdb, key);
+  while (fdb->slots[pos].used && fdb->slots[pos].key != key) {
+    pos = (pos + 1U) & mask;
+  }
+  return pos;
+}
+
+/**
+ * @brief Remove the entry at a slot using backward-shift deletion.
+ *
+ * @param fdb Forwarding database.
+ * @param pos Slot of the entry to remove.
+ */
+static void fdb_delete_at(Fdb* fdb, size_t pos) {
+  size_t mask = fdb->slot_count - 1U;
+  size_t hole = pos;
+  size_t next = (pos + 1U) & mask;
+
+  while (fdb->slots[next].used) {
+    size_t home = fdb_home(fdb, fdb->slots[next].key);
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      fdb->slots[hole] = fdb->slots[next];
+      hole = next;
+    }
+    next = (next + 1U) & mask;
+  }
+
+  memset(&fdb->slots[hole], 0, sizeof(fdb->slots[hole]));
+  fdb->count--;
+}
+
+/**
+ * @brief Check whether an entry has outlived the ageing time.
+ *
+ * @param fdb Forwarding database.
+ * @param entry Entry to test.
+ * @param now_ms Current time.
+ * @return true if the entry should be evicted.
+ */
+static bool fdb_entry_expired(const Fdb* fdb, const FdbEntry* entry, uint64_t now_ms) {
+  return now_ms >= entry->last_seen_ms && now_ms - entry->last_seen_ms >= fdb->aging_ms;
+}
+
+uint64_t fdb_now_ms(void) {
+  return sim_now_ms();
+}
+
+uint64_t fdb_key(uint16_t vlan_id, const uint8_t mac[6]) {
+  return ((uint64_t)(vlan_id & 0x0FFFU) << 48U) | ((uint64_t)mac[0] << 40U) |
+         ((uint64_t)mac[1] << 32U) | ((uint64_t)mac[2] << 24U) | ((uint64_t)mac[3] << 16U) |
+         ((uint64_t)mac[4] << 8U) | (uint64_t)mac[5];
+}
+
+uint16_t fdb_key_vlan(uint64_t key) {
+  return (uint16_t)(key >> 48U);
+}
+
+void fdb_key_mac(uint64_t key, uint8_t mac_out[6]) {
+  uint64_t mac = key & FDB_MAC_MASK;
+  for (size_t index = 0U; index < 6U; ++index) {
+    mac_out[index] = (uint8_t)(mac >> (40U - 8U * index));
+  }
+}
+
+Fdb* fdb_new(size_t capacity, uint32_t aging_ms) {
+  Fdb* fdb = calloc(1U, sizeof(*fdb));
+  if (fdb == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+
+  fdb->capacity = capacity != 0U ? capacity : FDB_DEFAULT_CAPACITY;
+  fdb->aging_ms = aging_ms != 0U ? aging_ms : FDB_AGING_MS;
+  size_t slot_count = FDB_MIN_SLOTS;
+  while (slot_count * 3U < fdb->capacity * 4U) {
+    slot_count *= 2U;
+  }
+
+  fdb->slots = calloc(slot_count, sizeof(*fdb->slots));
+  if (fdb->slots == NULL) {
+    free(fdb);
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+
+  fdb->slot_count = slot_count;
+  return fdb;
+}
+
+void fdb_free(Fdb* fdb) {
+  if (fdb == NULL) {
+    return;
+  }
+
+  free(fdb->slots);
+  free(fdb);
+}
+
+int fdb_learn(Fdb* fdb, uint16_t vlan_id, const uint8_t mac[6], uint16_t port, uint64_t now_ms,
+              uint16_t* prev_port) {
+  if (fdb == NULL || mac == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  uint64_t key = fdb_key(vlan_id, mac);
+  size_t pos = fdb_probe(fdb, key);
+  FdbEntry* entry = &fdb->slots[pos];
+  if (entry->used && fdb_entry_expired(fdb, entry, now_ms)) {
+    fdb_delete_at(fdb, pos);
+    fdb->aged++;
+    pos = fdb_probe(fdb, key);
+    entry = &fdb->slots[pos];
+  }
+
+  if (entry->used) {
+    int result = FDB_LEARN_REFRESHED;
+    if (entry->port != port) {
+      if (entry->moves > 0U && now_ms - entry->moved_ms < FDB_FLAP_WINDOW_MS) {
+        fdb->flaps++;
+      }
+      if (prev_port != NULL) {
+        *prev_port = entry->port;
+      }
+      entry->port = port;
+      entry->moved_ms = now_ms;
+      entry->moves++;
+      fdb->moves++;
+      result = FDB_LEARN_MOVED;
+    }
+    entry->last_seen_ms = now_ms;
+    return result;
+  }
+
+  if (fdb->count >= fdb->capacity) {
+    if (fdb_expire(fdb, now_ms) == 0U) {
+      fdb->full_drops++;
+      return FDB_LEARN_FULL;
+    }
+    pos = fdb_probe(fdb, key);
+    entry = &fdb->slots[pos];
+  }
+
+  memset(entry, 0, sizeof(*entry));
+  entry->key = key;
+  entry->port = port;
+  entry->last_seen_ms = now_ms;
+  entry->used = true;
+  fdb->count++;
+  fdb->learned++;
+  return FDB_LEARN_NEW;
+}
+
+bool fdb_lookup(Fdb* fdb, uint16_t vlan_id, const uint8_t mac[6], uint64_t now_ms,
+                uint16_t* port_out) {
+  if (fdb == NULL || mac == NULL || port_out == NULL) {
+    return false;
+  }
+
+  size_t pos = fdb_probe(fdb, fdb_key(vlan_id, mac));
+  const FdbEntry* entry = &fdb->slots[pos];
+  if (!entry->used) {
+    return false;
+  }
+
+  if (fdb_entry_expired(fdb, entry, now_ms)) {
+    fdb_delete_at(fdb, pos);
+    fdb->aged++;
+    return false;
+  }
+
+  *port_out = entry->port;
+  return true;
+}
+
+size_t fdb_expire(Fdb* fdb, uint64_t now_ms) {
+  if (fdb == NULL) {
+    return 0U;
+  }
+
+  size_t evicted = 0U;
+  size_t index = 0U;
+  while (index < fdb->slot_count) {
+    if (fdb->slots[index].used && fdb_entry_expired(fdb, &fdb->slots[index], now_ms)) {
+      fdb_delete_at(fdb, index);
+      evicted++;
+      continue;
+    }
+    index++;
+  }
+
+  fdb->aged += evicted;
+  return evicted;
+}
+
+void fdb_foreach(const Fdb* fdb, uint64_t now_ms, fdb_visitor_fn fn, void* ctx) {
+  if (fdb == NULL || fn == NULL) {
+    return;
+  }
+
+  for (size_t index = 0U; index < fdb->slot_count; ++index) {
+    const FdbEntry* entry = &fdb->slots[index];
+    if (entry->used && !fdb_entry_expired(fdb, entry, now_ms)) {
+      fn(entry, now_ms, ctx);
+    }
+  }
+}
+
+void fdb_get_stats(const Fdb* fdb, FdbStats* out) {
+  if (out == NULL) {
+    return;
+  }
+
+  memset(out, 0, sizeof(*out));
+  if (fdb == NULL) {
+    return;
+  }
+
+  out->entries = fdb->count;
+  out->capacity = fdb->capacity;
+  out->aging_ms = fdb->aging_ms;
+  out->learned = fdb->learned;
+  out->moves = fdb->moves;
+  out->flaps = fdb->flaps;
+  out->aged = fdb->aged;
+  out->full_drops = fdb->full_drops;
+}
@@ -0,0 +1,187 @@
+/**
+ * @file fdb.h
+ * @brief Fixed-capacity switch forwarding database keyed by (VLAN, MAC).
+ *
+ * The VLAN id and the 48-bit MAC are packed into one uint64_t key, so a
+ * lookup is a multiplicative hash and a short linear probe over an inline
+ * slot array; learning a station never allocates. The slot array is sized
+ * once from the configured capacity and never grows: when every entry is
+ * live, aged entries are reclaimed first and otherwise the new station is
+ * not learned (its traffic keeps flooding), as on a hardware switch.
+ *
+ * Entries age out FDB_AGING_MS (configurable) after their source was last
+ * seen. A station re-learned on a different port counts as a move; a move
+ * within FDB_FLAP_WINDOW_MS of the previous one also counts as a flap,
+ * which usually means a loop or a duplicated MAC.
+ */
+
+#ifndef MAGI_LAYER2_FDB_H
+#define MAGI_LAYER2_FDB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Default entry lifetime since last seen (IEEE 802.1D ageing time). */
+#define FDB_AGING_MS 300000U
+/** Default number of stations a table holds. */
+#define FDB_DEFAULT_CAPACITY 4096U
+/** Moves closer together than this are counted as flaps. */
+#define FDB_FLAP_WINDOW_MS 1000U
+
+/** @brief Outcome of fdb_learn(). */
+typedef enum FdbLearnResult {
+  /** Known station seen again on the same port. */
+  FDB_LEARN_REFRESHED = 0,
+  /** New station added. */
+  FDB_LEARN_NEW = 1,
+  /** Known station seen on a different port. */
+  FDB_LEARN_MOVED = 2,
+  /** Table full of live entries; station not learned. */
+  FDB_LEARN_FULL = 3,
+} FdbLearnResult;
+
+/** @brief One forwarding entry (32 bytes). */
+typedef struct FdbEntry {
+  /** Packed key: VLAN id in bits 48-59, MAC in bits 0-47. */
+  uint64_t key;
+  /** Last time a frame from this station was seen. */
+  uint64_t last_seen_ms;
+  /** Time of the last move; meaningful once moves is non-zero. */
+  uint64_t moved_ms;
+  /** Number of times the station changed port. */
+  uint32_t moves;
+  /** Port the station was last seen on. */
+  uint16_t port;
+  /** Slot occupancy flag (internal). */
+  bool used;
+} FdbEntry;
+
+/** @brief Table occupancy and event counters. */
+typedef struct FdbStats {
+  /** Live entries, including any not yet reclaimed after aging. */
+  size_t entries;
+  /** Maximum number of entries. */
+  size_t capacity;
+  /** Configured ageing time. */
+  uint32_t aging_ms;
+  /** Stations added. */
+  uint64_t learned;
+  /** Stations re-learned on a different port. */
+  uint64_t moves;
+  /** Moves within FDB_FLAP_WINDOW_MS of the previous move. */
+  uint64_t flaps;
+  /** Entries removed by aging. */
+  uint64_t aged;
+  /** Stations not learned because the table was full. */
+  uint64_t full_drops;
+} FdbStats;
+
+/** @brief Opaque forwarding database. */
+typedef struct Fdb Fdb;
+
+typedef void (*fdb_visitor_fn)(const FdbEntry* entry, uint64_t now_ms, void* ctx);
+
+/**
+ * @brief Clock used for FDB aging.
+ *
+ * @return Simulation time in milliseconds (see core/sim.h).
+ */
+uint64_t fdb_now_ms(void);
+
+/**
+ * @brief Pack a VLAN id and MAC into a table key.
+ *
+ * @param vlan_id VLAN id (12 bits are kept).
+ * @param mac Hardware address.
+ * @return Packed key.
+ */
+uint64_t fdb_key(uint16_t vlan_id, const uint8_t mac[6]);
+
+/**
+ * @brief VLAN id of a packed key.
+ *
+ * @param key Packed key.
+ * @return VLAN id.
+ */
+uint16_t fdb_key_vlan(uint64_t key);
+
+/**
+ * @brief MAC of a packed key.
+ *
+ * @param key Packed key.
+ * @param mac_out Destination for the hardware address.
+ */
+void fdb_key_mac(uint64_t key, uint8_t mac_out[6]);
+
+/**
+ * @brief Create an empty forwarding database.
+ *
+ * @param capacity Maximum number of entries; 0 selects FDB_DEFAULT_CAPACITY.
+ * @param aging_ms Entry lifetime since last seen; 0 selects FDB_AGING_MS.
+ * @return Table instance, or NULL on failure.
+ */
+Fdb* fdb_new(size_t capacity, uint32_t aging_ms);
+
+/**
+ * @brief Destroy a forwarding database.
+ *
+ * @param fdb Table to free. NULL is allowed.
+ */
+void fdb_free(Fdb* fdb);
+
+/**
+ * @brief Record that a station was seen on a port.
+ *
+ * @param fdb Forwarding database.
+ * @param vlan_id VLAN the frame belongs to.
+ * @param mac Source hardware address.
+ * @param port Ingress port.
+ * @param now_ms Current time.
+ * @param prev_port Set to the previous port on FDB_LEARN_MOVED. May be NULL.
+ * @return An FdbLearnResult, or MAGI_ERR_BADARGS.
+ */
+int fdb_learn(Fdb* fdb, uint16_t vlan_id, const uint8_t mac[6], uint16_t port, uint64_t now_ms,
+              uint16_t* prev_port);
+
+/**
+ * @brief Find the port of a station, evicting its entry if it has aged out.
+ *
+ * @param fdb Forwarding database.
+ * @param vlan_id VLAN to search.
+ * @param mac Destination hardware address.
+ * @param now_ms Current time.
+ * @param port_out Destination for the port on success.
+ * @return true if a live entry was found.
+ */
+bool fdb_lookup(Fdb* fdb, uint16_t vlan_id, const uint8_t mac[6], uint64_t now_ms,
+                uint16_t* port_out);
+
+/**
+ * @brief Evict every entry not seen within the ageing time.
+ *
+ * @param fdb Forwarding database.
+ * @param now_ms Current time.
+ * @return Number of evicted entries.
+ */
+size_t fdb_expire(Fdb* fdb, uint64_t now_ms);
+
+/**
+ * @brief Visit every live, unexpired entry in unspecified order.
+ *
+ * @param fdb Forwarding database.
+ * @param now_ms Current time, forwarded to the visitor for age display.
+ * @param fn Visitor callback.
+ * @param ctx Opaque callback context.
+ */
+void fdb_foreach(const Fdb* fdb, uint64_t now_ms, fdb_visitor_fn fn, void* ctx);
+
+/**
+ * @brief Read occupancy and event counters.
+ *
+ * @param fdb Forwarding database.
+ * @param out Destination; zeroed for a NULL table.
+ */
+void fdb_get_stats(const Fdb* fdb, FdbStats* out);
+
+#endif
@@ -1,10 +1,14 @@
 #define _POSIX_C_SOURCE 200809L
+#define MAGI_LOG_SUBSYS MAGI_LOG_L2
 
 #include "host.h"
 
 #include "core/interface.h"
+#include "core/pktbuf.h"
 #include "layer2/arp.h"
 #include "layer2/ethernet.h"
+#include "layer2/neighbor.h"
+#include "utils/byteops.h"
 #include "utils/log.h"
 #include "utils/mac.h"
 #include "utils/magi_error.h"
@@ -14,8 +18,7 @@
 #include <string.h>
 
 typedef struct PendingPacket {
-  uint8_t* payload;
-  size_t payload_len;
+  PktBuf* pkt;
   uint16_t ethertype;
   uint16_t port;
   struct PendingPacket* next;
@@ -25,7 +28,7 @@ typedef struct HostState {
   char ip_address[64];
   char ip_key[16];
   char default_gateway[64];
-  HashMap* arp_cache;
+  NeighborTable* neighbors;
   HashMap* pending;
 } HostState;
 
@@ -66,25 +69,10 @@ static const HostState* host_state_const(const Host* host) {
   return node != NULL ? (const HostState*)node->data : NULL;
 }
 
-/**
- * Free a single hashmap entry whose value is a heap-allocated string.
- *
- * Callback for hashmap_foreach used to free ARP cache string values.
- *
- * @param key   Entry key (unused).
- * @param value Pointer to the heap-allocated string to free.
- * @param ctx   User context (unused).
- */
-static void free_string_entry(const char* key, void* value, void* ctx) {
-  (void)key;
-  (void)ctx;
-  free(value);
-}
-
 /**
  * Free a linked list of PendingPacket structs.
  *
- * Iterates through the list, freeing each packet's payload buffer and
+ * Iterates through the list, releasing each packet's buffer and freeing
  * the packet struct itself.
  *
  * @param packet Head of the pending packet list to free.
@@ -92,7 +80,7 @@ static void free_string_entry(const char* key, void* value, void* ctx) {
 static void free_pending_list(PendingPacket* packet) {
   while (packet != NULL) {
     PendingPacket* next = packet->next;
-    free(packet->payload);
+    pktbuf_release(packet->pkt);
     free(packet);
     packet = next;
   }
@@ -116,8 +104,8 @@ static void free_pending_entry(const char* key, void* value, void* ctx) {
 /**
  * Free the HostState struct and all its internal resources.
  *
- * Iterates over and frees all ARP cache entries and all pending packet
- * queues, then frees the hash maps and the state struct itself.
+ * Frees the neighbor table and all pending packet queues, then frees
+ * the pending hash map and the state struct itself.
  *
  * @param data Pointer to the HostState to free.
  */
@@ -127,8 +115,7 @@ static void host_state_free(void* data) {
     return;
   }
 
-  hashmap_foreach(state->arp_cache, free_string_entry, NULL);
-  hashmap_free(state->arp_cache);
+  neighbor_table_free(state->neighbors);
   hashmap_foreach(state->pending, free_pending_entry, NULL);
   hashmap_free(state->pending);
   free(state);
@@ -137,8 +124,8 @@ static void host_state_free(void* data) {
 /**
  * Create and initialize a new HostState struct.
  *
- * Allocates a zero-initialized HostState and creates the ARP cache and
- * pending packet hash maps, each with an initial capacity of 8 entries.
+ * Allocates a zero-initialized HostState and creates the neighbor table
+ * and pending packet hash map, each with an initial capacity of 8 entries.
  *
  * @return Pointer to the new HostState, or NULL on allocation failure.
  */
@@ -149,9 +136,9 @@ static HostState* host_state_new(void) {
     return NULL;
   }
 
-  state->arp_cache = hashmap_new(8U);
+  state->neighbors = neighbor_table_new(8U);
   state->pending = hashmap_new(8U);
-  if (state->arp_cache == NULL || state->pending == NULL) {
+  if (state->neighbors == NULL || state->pending == NULL) {
     host_state_free(state);
     magi_errno = MAGI_ERR_NOMEM;
     return NULL;
@@ -160,30 +147,6 @@ static HostState* host_state_new(void) {
   return state;
 }
 
-/**
- * Duplicate a null-terminated string on the heap.
- *
- * Allocates and copies the string including the null terminator.
- *
- * @param text Null-terminated string to duplicate.
- * @return Heap-allocated copy of the string, or NULL on failure.
- */
-static char* duplicate_string(const char* text) {
-  if (text == NULL) {
-    return NULL;
-  }
-
-  size_t len = strlen(text) + 1U;
-  char* copy = malloc(len);
-  if (copy == NULL) {
-    magi_errno = MAGI_ERR_NOMEM;
-    return NULL;
-  }
-
-  memcpy(copy, text, len);
-  return copy;
-}
-
 /**
  * Normalize an IP address string to canonical dotted-decimal form.
  *
@@ -206,10 +169,9 @@ static int normalize_ip_key(const char* ip_text, char out[16]) {
 }
 
 /**
- * Insert or update a MAC address in the host's ARP cache for a given IP.
+ * Insert or refresh a MAC address in the host's neighbor table for a given IP.
  *
- * If an entry already exists for the IP, its MAC text is overwritten.
- * Otherwise, a new heap-allocated copy of the MAC string is stored.
+ * The entry becomes REACHABLE with the given MAC.
  *
  * @param host Pointer to the Host.
  * @param ip   4-byte IPv4 address to use as the cache key.
@@ -223,37 +185,56 @@ static int host_cache_arp(Host* host, const uint8_t ip[4], const uint8_t mac[6])
     return MAGI_ERR_BADARGS;
   }
 
-  char ip_key[16];
-  char mac_text[18];
-  arp_ipv4_to_string(ip, ip_key);
-  mac_to_str(mac, mac_text);
+  return neighbor_update(state->neighbors, ip, mac, neighbor_now_ms());
+}
 
-  char* existing = hashmap_get(state->arp_cache, ip_key);
-  if (existing != NULL) {
-    snprintf(existing, 18U, "%s", mac_text);
-    return MAGI_OK;
+/**
+ * Prepend an Ethernet header to a packet buffer and transmit it.
+ *
+ * The header is written into the buffer's headroom, so the payload is
+ * never copied. The buffer is consumed on every path.
+ *
+ * @param host      Pointer to the Host.
+ * @param iface     Interface to transmit through.
+ * @param dst_mac   Destination MAC address (6 bytes).
+ * @param ethertype Ethertype field value.
+ * @param pkt       Buffer holding the L3 payload.
+ * @return MAGI_OK on success, or a negative error code on failure.
+ */
+static int host_send_ethernet_pkt(Host* host, Interface* iface, const uint8_t dst_mac[6],
+                                  uint16_t ethertype, PktBuf* pkt) {
+  if (host == NULL || iface == NULL || dst_mac == NULL || pkt == NULL) {
+    pktbuf_release(pkt);
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
   }
 
-  char* stored_mac = duplicate_string(mac_text);
-  if (stored_mac == NULL) {
-    return MAGI_ERR_NOMEM;
+  size_t payload_len = pkt->len;
+  uint8_t* header = pktbuf_push(pkt, ETHERNET_MIN_FRAME_LEN);
+  if (header == NULL) {
+    pktbuf_release(pkt);
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
   }
 
-  int status = hashmap_set(state->arp_cache, ip_key, stored_mac);
-  if (status != MAGI_OK) {
-    free(stored_mac);
-    return status;
-  }
+  memcpy(header, dst_mac, ETHERNET_MAC_LEN);
+  memcpy(header + ETHERNET_MAC_LEN, iface->mac, ETHERNET_MAC_LEN);
+  WRITE_U16(header, 12U, ethertype);
 
-  return MAGI_OK;
+  char dst_text[18];
+  mac_to_str(dst_mac, dst_text);
+  Node* node = host_as_node(host);
+  LOG(node->name, "Send Ethernet frame dst=%s ethertype=0x%04X len=%zu", dst_text,
+      (unsigned)ethertype, payload_len);
+
+  return interface_send_pkt(iface, pkt);
 }
 
 /**
  * Send an L2 Ethernet frame with the given payload via a specific interface.
  *
- * Builds an EthernetFrame with the specified destination MAC, source MAC
- * (from the interface), and ethertype, serializes it, and transmits it
- * through the interface.
+ * Copies the payload once into a packet buffer with headroom and hands it
+ * to host_send_ethernet_pkt().
  *
  * @param host        Pointer to the Host.
  * @param iface       Interface to transmit through.
@@ -271,28 +252,12 @@ static int host_send_ethernet_payload(Host* host, Interface* iface, const uint8_
     return MAGI_ERR_BADARGS;
   }
 
-  EthernetFrame frame = {0};
-  memcpy(frame.dst_mac, dst_mac, ETHERNET_MAC_LEN);
-  memcpy(frame.src_mac, iface->mac, ETHERNET_MAC_LEN);
-  frame.ethertype = ethertype;
-  frame.payload = payload;
-  frame.payload_len = payload_len;
-
-  uint8_t* bytes = NULL;
-  size_t len = 0U;
-  int status = ethernet_frame_to_bytes(&frame, &bytes, &len);
-  if (status != MAGI_OK) {
-    return status;
+  PktBuf* pkt = pktbuf_copy(PKTBUF_HEADROOM, payload, payload_len);
+  if (pkt == NULL) {
+    return MAGI_ERR_NOMEM;
   }
 
-  char dst_text[18];
-  mac_to_str(dst_mac, dst_text);
-  Node* node = host_as_node(host);
-  LOG(node->name, "Send Ethernet frame dst=%s ethertype=0x%04X len=%zu", dst_text,
-      (unsigned)ethertype, payload_len);
-
-  status = interface_send(iface, bytes, len);
-  return status;
+  return host_send_ethernet_pkt(host, iface, dst_mac, ethertype, pkt);
 }
 
 /**
@@ -343,41 +308,33 @@ static int host_send_arp_request(Host* host, Interface* iface, const char* targe
  *
  * Creates a PendingPacket entry and appends it to the linked list for the
  * given target IP. If no list exists yet, a new one is created and stored
- * in the pending hash map.
+ * in the pending hash map. The packet buffer is parked as-is, without a
+ * copy, and is consumed on every path.
  *
- * @param host        Pointer to the Host.
- * @param target_ip   Target IP string to key the pending entry.
- * @param port        Port number for the outgoing interface.
- * @param ethertype   Ethertype of the queued packet.
- * @param payload     Payload data (may be NULL if payload_len is 0).
- * @param payload_len Length of the payload in bytes.
+ * @param host      Pointer to the Host.
+ * @param target_ip Target IP string to key the pending entry.
+ * @param port      Port number for the outgoing interface.
+ * @param ethertype Ethertype of the queued packet.
+ * @param pkt       Buffer holding the L3 payload.
  * @return MAGI_OK on success, or a negative error code on failure.
  */
 static int host_queue_pending(Host* host, const char* target_ip, uint16_t port, uint16_t ethertype,
-                              const uint8_t* payload, size_t payload_len) {
+                              PktBuf* pkt) {
   HostState* state = host_state(host);
-  if (state == NULL || target_ip == NULL || (payload_len > 0U && payload == NULL)) {
+  if (state == NULL || target_ip == NULL || pkt == NULL) {
+    pktbuf_release(pkt);
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
   PendingPacket* packet = calloc(1U, sizeof(*packet));
   if (packet == NULL) {
+    pktbuf_release(pkt);
     magi_errno = MAGI_ERR_NOMEM;
     return MAGI_ERR_NOMEM;
   }
 
-  if (payload_len > 0U) {
-    packet->payload = malloc(payload_len);
-    if (packet->payload == NULL) {
-      free(packet);
-      magi_errno = MAGI_ERR_NOMEM;
-      return MAGI_ERR_NOMEM;
-    }
-    memcpy(packet->payload, payload, payload_len);
-  }
-
-  packet->payload_len = payload_len;
+  packet->pkt = pkt;
   packet->ethertype = ethertype;
   packet->port = port;
 
@@ -433,13 +390,13 @@ static int host_flush_pending(Host* host, const char* target_ip, const uint8_t d
     PendingPacket* next = packet->next;
     Interface* iface = node_get_interface(node, packet->port);
     if (iface != NULL) {
-      int status = host_send_ethernet_payload(host, iface, dst_mac, packet->ethertype,
-                                              packet->payload, packet->payload_len);
+      int status = host_send_ethernet_pkt(host, iface, dst_mac, packet->ethertype, packet->pkt);
       if (status != MAGI_OK) {
         final_status = status;
       }
+    } else {
+      pktbuf_release(packet->pkt);
     }
-    free(packet->payload);
     free(packet);
     packet = next;
   }
@@ -467,6 +424,7 @@ static void host_handle_arp(Host* host, Interface* iface, const EthernetFrame* f
 
   ARPMessage message = {0};
   if (arp_message_from_bytes(frame->payload, frame->payload_len, &message) != MAGI_OK) {
+    node_count(host_as_node(host), MAGI_NODE_DROP_MALFORMED);
     LOG(host_as_node(host)->name, "Drop malformed ARP payload");
     return;
   }
@@ -532,6 +490,7 @@ static void host_handle_receive(Node* node, Interface* iface, const uint8_t* dat
   EthernetFrame frame = {0};
 
   if (ethernet_frame_from_bytes(data, len, &frame) != MAGI_OK) {
+    node_count(node, MAGI_NODE_DROP_MALFORMED);
     LOG(node->name, "Drop malformed Ethernet frame");
     return;
   }
@@ -560,19 +519,26 @@ static void host_handle_receive(Node* node, Interface* iface, const uint8_t* dat
 }
 
 /**
- * Print a single ARP cache entry via the logging system.
+ * Print a single neighbor table entry via the logging system.
  *
- * Callback for hashmap_foreach used by host_print_arp_cache. Each entry
- * is logged as "ARP <ip> -> <mac>".
+ * Callback for neighbor_foreach used by host_print_arp_cache. Each entry
+ * is logged as "ARP <ip> -> <mac> <state> age=<seconds>s".
  *
- * @param key   ARP cache key (IP string).
- * @param value ARP cache value (MAC string).
- * @param ctx   Pointer to a PrintArpCtx tracking host name and count.
+ * @param entry  Neighbor table entry.
+ * @param now_ms Current time for age display.
+ * @param ctx    Pointer to a PrintArpCtx tracking host name and count.
  */
-static void print_arp_entry(const char* key, void* value, void* ctx) {
+static void print_arp_entry(const NeighborEntry* entry, uint64_t now_ms, void* ctx) {
   PrintArpCtx* state = ctx;
-  const char* mac = value;
-  LOG(state->host_name, "ARP %s -> %s", key, mac != NULL ? mac : "(null)");
+  uint8_t ip[4] = {(uint8_t)(entry->ip >> 24U), (uint8_t)(entry->ip >> 16U),
+                   (uint8_t)(entry->ip >> 8U), (uint8_t)entry->ip};
+  char ip_text[16];
+  char mac_text[18];
+  arp_ipv4_to_string(ip, ip_text);
+  mac_to_str(entry->mac, mac_text);
+  LOG(state->host_name, "ARP %s -> %s %s age=%llus", ip_text, mac_text,
+      neighbor_state_name(neighbor_entry_state(entry, now_ms)),
+      (unsigned long long)((now_ms - entry->updated_ms) / 1000U));
   state->count++;
 }
 
@@ -594,6 +560,20 @@ static int host_send_l3_from_node(Node* node, const char* next_hop_ip, uint16_t
   return host_send_l3_packet(host_from_node(node), next_hop_ip, ethertype, payload, payload_len);
 }
 
+/**
+ * Node-level adapter for the zero-copy L3 send hook.
+ *
+ * @param node        Host node.
+ * @param next_hop_ip Next-hop IPv4 address.
+ * @param ethertype   Ethertype value.
+ * @param pkt         Buffer holding the L3 payload; consumed.
+ * @return MAGI_OK on success, or a negative error code on failure.
+ */
+static int host_send_l3_pkt_from_node(Node* node, const uint8_t next_hop_ip[4], uint16_t ethertype,
+                                      PktBuf* pkt) {
+  return host_send_l3_pkt(host_from_node(node), next_hop_ip, ethertype, pkt);
+}
+
 Host* host_new(const char* name) {
   Node* node = node_new(name);
   if (node == NULL) {
@@ -610,6 +590,7 @@ Host* host_new(const char* name) {
   node->data_free = host_state_free;
   node->handle_receive = host_handle_receive;
   node->send_l3_packet = host_send_l3_from_node;
+  node->send_l3_pkt = host_send_l3_pkt_from_node;
   return host_from_node(node);
 }
 
@@ -651,7 +632,10 @@ int host_configure(Host* host, const char* ip_address, const char* default_gatew
     if (iface == NULL) {
       return MAGI_ERR_BADARGS;
     }
-    snprintf(iface->ip_address, sizeof(iface->ip_address), "%s", ip_address);
+    status = interface_set_ip(iface, ip_address);
+    if (status != MAGI_OK) {
+      return status;
+    }
   }
 
   if (default_gateway != NULL && default_gateway[0] != '\0') {
@@ -663,58 +647,80 @@ int host_configure(Host* host, const char* ip_address, const char* default_gatew
   return MAGI_OK;
 }
 
-int host_send_l3_packet(Host* host, const char* target_ip, uint16_t ethertype,
-                        const uint8_t* payload, size_t payload_len) {
+int host_send_l3_pkt(Host* host, const uint8_t target_ip[4], uint16_t ethertype, PktBuf* pkt) {
   HostState* state = host_state(host);
-  if (host == NULL || state == NULL || target_ip == NULL || (payload_len > 0U && payload == NULL)) {
+  if (host == NULL || state == NULL || target_ip == NULL || pkt == NULL) {
+    pktbuf_release(pkt);
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
+  Node* node = host_as_node(host);
   if (state->ip_key[0] == '\0') {
-    LOG(host_as_node(host)->name, "Cannot send L2 packet: host IP address is not configured");
+    LOG(node->name, "Cannot send L2 packet: host IP address is not configured");
+    pktbuf_release(pkt);
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
-  char target_key[16];
-  int status = normalize_ip_key(target_ip, target_key);
-  if (status != MAGI_OK) {
-    return status;
-  }
-
-  Node* node = host_as_node(host);
   Interface* iface = node_get_interface(node, 1U);
   if (iface == NULL) {
     iface = node_add_interface(node, 1U);
   }
   if (iface == NULL) {
+    pktbuf_release(pkt);
     return MAGI_ERR_BADARGS;
   }
   if (iface->link == NULL) {
     LOG(node->name, "Cannot send L2 packet: interface 1 is not linked");
+    pktbuf_release(pkt);
     magi_errno = MAGI_ERR_NOLINK;
     return MAGI_ERR_NOLINK;
   }
 
-  char* mac_text = hashmap_get(state->arp_cache, target_key);
-  if (mac_text != NULL) {
-    uint8_t dst_mac[ETHERNET_MAC_LEN];
-    if (mac_from_str(mac_text, dst_mac) != MAGI_OK) {
-      return MAGI_ERR_BADARGS;
-    }
-    return host_send_ethernet_payload(host, iface, dst_mac, ethertype, payload, payload_len);
+  uint64_t now_ms = neighbor_now_ms();
+  uint8_t dst_mac[ETHERNET_MAC_LEN];
+  if (neighbor_resolve(state->neighbors, target_ip, now_ms, dst_mac)) {
+    node_count(node, MAGI_NODE_ARP_HITS);
+    return host_send_ethernet_pkt(host, iface, dst_mac, ethertype, pkt);
   }
+  node_count(node, MAGI_NODE_ARP_MISSES);
 
-  status =
-      host_queue_pending(host, target_key, iface->port_number, ethertype, payload, payload_len);
+  char target_key[16];
+  arp_ipv4_to_string(target_ip, target_key);
+  int status = host_queue_pending(host, target_key, iface->port_number, ethertype, pkt);
   if (status != MAGI_OK) {
     return status;
   }
 
+  if (!neighbor_start_probe(state->neighbors, target_ip, now_ms)) {
+    return MAGI_OK;
+  }
+
   return host_send_arp_request(host, iface, target_key);
 }
 
+int host_send_l3_packet(Host* host, const char* target_ip, uint16_t ethertype,
+                        const uint8_t* payload, size_t payload_len) {
+  if (host == NULL || target_ip == NULL || (payload_len > 0U && payload == NULL)) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  uint8_t target_addr[4];
+  int status = arp_ipv4_from_string(target_ip, target_addr);
+  if (status != MAGI_OK) {
+    return status;
+  }
+
+  PktBuf* pkt = pktbuf_copy(PKTBUF_HEADROOM, payload, payload_len);
+  if (pkt == NULL) {
+    return MAGI_ERR_NOMEM;
+  }
+
+  return host_send_l3_pkt(host, target_addr, ethertype, pkt);
+}
+
 int host_probe_l2(Host* host, const char* target_ip) {
   static const uint8_t payload[] = "M1-L2-PROBE";
   return host_send_l3_packet(host, target_ip, ETHERNET_TYPE_IPV4, payload, sizeof(payload) - 1U);
@@ -729,7 +735,7 @@ void host_print_arp_cache(const Host* host) {
 
   const Node* node = host_as_node_const(host);
   PrintArpCtx ctx = {.host_name = node->name, .count = 0U};
-  hashmap_foreach(state->arp_cache, print_arp_entry, &ctx);
+  neighbor_foreach(state->neighbors, neighbor_now_ms(), print_arp_entry, &ctx);
   if (ctx.count == 0U) {
     LOG(node->name, "ARP cache empty");
   }
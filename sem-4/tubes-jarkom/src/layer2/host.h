@@ -84,6 +84,21 @@ int host_configure(Host* host, const char* ip_address, const char* default_gatew
 int host_send_l3_packet(Host* host, const char* target_ip, uint16_t ethertype,
                         const uint8_t* payload, size_t payload_len);
 
+/**
+ * @brief Send an L3 packet buffer through the host's L2 path without copying it.
+ *
+ * The Ethernet header is prepended in the buffer's headroom. While ARP
+ * resolves, the buffer itself is parked on the pending queue.
+ *
+ * @param host Host node.
+ * @param target_ip Next-hop IPv4 address.
+ * @param ethertype Ethernet ethertype for the payload.
+ * @param pkt Buffer holding the L3 payload; consumed on every path.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int host_send_l3_pkt(Host* host, const uint8_t target_ip[4], uint16_t ethertype,
+                     struct PktBuf* pkt);
+
 /**
  * @brief Trigger a small Milestone-1 ARP probe for CLI ping scaffolding.
  *
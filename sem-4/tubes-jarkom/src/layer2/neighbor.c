@@ -0,0 +1,409 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "neighbor.h"
+
+#include "core/sim.h"
+#include "utils/magi_error.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NEIGHBOR_MIN_CAPACITY 8U
+
+struct NeighborTable {
+  NeighborEntry* slots;
+  size_t capacity;
+  size_t count;
+  uint32_t gen;
+  /** Fires at the earliest eviction time so idle entries still go away. */
+  SimTimer sweep_timer;
+};
+
+/**
+ * @brief Convert a 4-byte IPv4 address to a host-order key.
+ *
+ * @param ip 4-byte IPv4 address.
+ * @return Address as uint32_t.
+ */
+static uint32_t neighbor_key(const uint8_t ip[4]) {
+  return ((uint32_t)ip[0] << 24U) | ((uint32_t)ip[1] << 16U) | ((uint32_t)ip[2] << 8U) |
+         (uint32_t)ip[3];
+}
+
+/**
+ * @brief Home slot for a key (multiplicative hash with a high-bit fold).
+ *
+ * @param table Neighbor table.
+ * @param key Host-order IPv4 address.
+ * @return Slot index.
+ */
+static size_t neighbor_home(const NeighborTable* table, uint32_t key) {
+  uint32_t hash = key * 2654435761U;
+  hash ^= hash >> 16U;
+  return (size_t)(hash & (uint32_t)(table->capacity - 1U));
+}
+
+/**
+ * @brief Find the slot holding a key, or the empty slot where it would go.
+ *
+ * @param table Neighbor table.
+ * @param key Host-order IPv4 address.
+ * @return Slot index.
+ */
+static size_t neighbor_probe(const NeighborTable* table, uint32_t key) {
+  size_t mask = table->capacity - 1U;
+  size_t pos = neighbor_home(table, key);
+  while (table->slots[pos].used && table->slots[pos].ip != key) {
+    pos = (pos + 1U) & mask;
+  }
+  return pos;
+}
+
+/**
+ * @brief Remove the entry at a slot using backward-shift deletion.
+ *
+ * @param table Neighbor table.
+ * @param pos Slot of the entry to remove.
+ */
+static void neighbor_delete_at(NeighborTable* table, size_t pos) {
+  size_t mask = table->capacity - 1U;
+  size_t hole = pos;
+  size_t next = (pos + 1U) & mask;
+
+  if (table->slots[pos].state != NEIGHBOR_INCOMPLETE) {
+    table->gen++;
+  }
+  while (table->slots[next].used) {
+    size_t home = neighbor_home(table, table->slots[next].ip);
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      table->slots[hole] = table->slots[next];
+      hole = next;
+    }
+    next = (next + 1U) & mask;
+  }
+
+  memset(&table->slots[hole], 0, sizeof(table->slots[hole]));
+  table->count--;
+}
+
+/**
+ * @brief Double the slot array and rehash all live entries.
+ *
+ * @param table Neighbor table.
+ * @return MAGI_OK on success, or MAGI_ERR_NOMEM.
+ */
+static int neighbor_grow(NeighborTable* table) {
+  size_t new_cap = table->capacity * 2U;
+  NeighborEntry* slots = calloc(new_cap, sizeof(*slots));
+  if (slots == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
+  }
+
+  NeighborEntry* old = table->slots;
+  size_t old_cap = table->capacity;
+  table->slots = slots;
+  table->capacity = new_cap;
+  for (size_t index = 0U; index < old_cap; ++index) {
+    if (old[index].used) {
+      table->slots[neighbor_probe(table, old[index].ip)] = old[index];
+    }
+  }
+
+  free(old);
+  return MAGI_OK;
+}
+
+/**
+ * @brief Find or create the slot for a key.
+ *
+ * @param table Neighbor table.
+ * @param key Host-order IPv4 address.
+ * @param now_ms Current time, stamped on new entries.
+ * @return Entry pointer, or NULL on allocation failure.
+ */
+static NeighborEntry* neighbor_get_or_insert(NeighborTable* table, uint32_t key,
+                                             uint64_t now_ms) {
+  size_t pos = neighbor_probe(table, key);
+  if (table->slots[pos].used) {
+    return &table->slots[pos];
+  }
+
+  if ((table->count + 1U) * 4U > table->capacity * 3U) {
+    if (neighbor_grow(table) != MAGI_OK) {
+      return NULL;
+    }
+    pos = neighbor_probe(table, key);
+  }
+
+  NeighborEntry* entry = &table->slots[pos];
+  memset(entry, 0, sizeof(*entry));
+  entry->ip = key;
+  entry->used = true;
+  entry->state = NEIGHBOR_INCOMPLETE;
+  entry->updated_ms = now_ms;
+  table->count++;
+  return entry;
+}
+
+/**
+ * @brief Apply timer-driven state transitions to one entry.
+ *
+ * @param entry Entry to age.
+ * @param now_ms Current time.
+ * @return true if the entry has expired and should be evicted.
+ */
+static bool neighbor_age(NeighborEntry* entry, uint64_t now_ms) {
+  uint64_t age = now_ms >= entry->updated_ms ? now_ms - entry->updated_ms : 0U;
+  switch (entry->state) {
+  case NEIGHBOR_INCOMPLETE:
+    return age >= NEIGHBOR_INCOMPLETE_MS;
+  case NEIGHBOR_REACHABLE:
+    if (age >= NEIGHBOR_REACHABLE_MS) {
+      entry->state = NEIGHBOR_STALE;
+    }
+    return age >= (uint64_t)NEIGHBOR_REACHABLE_MS + NEIGHBOR_STALE_MS;
+  default:
+    return age >= (uint64_t)NEIGHBOR_REACHABLE_MS + NEIGHBOR_STALE_MS;
+  }
+}
+
+/**
+ * @brief Time an entry is evicted unless it is refreshed first.
+ *
+ * @param entry Table entry.
+ * @return Eviction time in neighbor_now_ms() units.
+ */
+static uint64_t neighbor_deadline_ms(const NeighborEntry* entry) {
+  if (entry->state == NEIGHBOR_INCOMPLETE) {
+    return entry->updated_ms + NEIGHBOR_INCOMPLETE_MS;
+  }
+  return entry->updated_ms + NEIGHBOR_REACHABLE_MS + NEIGHBOR_STALE_MS;
+}
+
+/**
+ * @brief Make sure the sweep timer fires no later than at_ms.
+ *
+ * Async builds do not run the clock queue; they age entries lazily on lookup.
+ *
+ * @param table Neighbor table.
+ * @param at_ms Eviction time of an entry.
+ */
+static void neighbor_schedule(NeighborTable* table, uint64_t at_ms) {
+#ifndef MAGI_ASYNC
+  uint64_t at_ns = at_ms * SIM_NS_PER_MS;
+  if (sim_timer_armed(&table->sweep_timer) && table->sweep_timer.at_ns <= at_ns) {
+    return;
+  }
+
+  uint64_t now = sim_now_ns();
+  (void)sim_timer_arm(&table->sweep_timer, at_ns > now ? at_ns - now : 0U);
+#else
+  (void)table;
+  (void)at_ms;
+#endif
+}
+
+/**
+ * @brief SimTimer callback: evict expired entries and re-arm for the next one.
+ */
+static void neighbor_sweep_fire(void* ctx) {
+  (void)neighbor_expire(ctx, neighbor_now_ms());
+}
+
+uint64_t neighbor_now_ms(void) {
+  return sim_now_ms();
+}
+
+NeighborTable* neighbor_table_new(size_t initial_capacity) {
+  NeighborTable* table = calloc(1U, sizeof(*table));
+  if (table == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+
+  size_t capacity = NEIGHBOR_MIN_CAPACITY;
+  while (capacity < initial_capacity) {
+    capacity *= 2U;
+  }
+
+  table->slots = calloc(capacity, sizeof(*table->slots));
+  if (table->slots == NULL) {
+    free(table);
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+
+  table->capacity = capacity;
+  sim_timer_init(&table->sweep_timer, neighbor_sweep_fire, table);
+  return table;
+}
+
+void neighbor_table_free(NeighborTable* table) {
+  if (table == NULL) {
+    return;
+  }
+
+  sim_timer_cancel(&table->sweep_timer);
+  free(table->slots);
+  free(table);
+}
+
+int neighbor_update(NeighborTable* table, const uint8_t ip[4], const uint8_t mac[6],
+                    uint64_t now_ms) {
+  if (table == NULL || ip == NULL || mac == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  NeighborEntry* entry = neighbor_get_or_insert(table, neighbor_key(ip), now_ms);
+  if (entry == NULL) {
+    return MAGI_ERR_NOMEM;
+  }
+
+  if (entry->state != NEIGHBOR_INCOMPLETE && memcmp(entry->mac, mac, sizeof(entry->mac)) != 0) {
+    table->gen++;
+  }
+  memcpy(entry->mac, mac, sizeof(entry->mac));
+  entry->state = NEIGHBOR_REACHABLE;
+  entry->updated_ms = now_ms;
+  neighbor_schedule(table, neighbor_deadline_ms(entry));
+  return MAGI_OK;
+}
+
+bool neighbor_resolve(NeighborTable* table, const uint8_t ip[4], uint64_t now_ms,
+                      uint8_t mac_out[6]) {
+  if (table == NULL || ip == NULL || mac_out == NULL) {
+    return false;
+  }
+
+  size_t pos = neighbor_probe(table, neighbor_key(ip));
+  NeighborEntry* entry = &table->slots[pos];
+  if (!entry->used) {
+    return false;
+  }
+
+  if (neighbor_age(entry, now_ms)) {
+    neighbor_delete_at(table, pos);
+    return false;
+  }
+
+  if (entry->state == NEIGHBOR_INCOMPLETE) {
+    return false;
+  }
+
+  memcpy(mac_out, entry->mac, sizeof(entry->mac));
+  return true;
+}
+
+uint64_t neighbor_expires_ms(const NeighborTable* table, const uint8_t ip[4]) {
+  if (table == NULL || ip == NULL) {
+    return 0U;
+  }
+
+  const NeighborEntry* entry = &table->slots[neighbor_probe(table, neighbor_key(ip))];
+  if (!entry->used || entry->state == NEIGHBOR_INCOMPLETE) {
+    return 0U;
+  }
+
+  return entry->updated_ms + NEIGHBOR_REACHABLE_MS + NEIGHBOR_STALE_MS;
+}
+
+uint32_t neighbor_generation(const NeighborTable* table) {
+  return table != NULL ? table->gen : 0U;
+}
+
+bool neighbor_start_probe(NeighborTable* table, const uint8_t ip[4], uint64_t now_ms) {
+  if (table == NULL || ip == NULL) {
+    return true;
+  }
+
+  uint32_t key = neighbor_key(ip);
+  size_t pos = neighbor_probe(table, key);
+  if (table->slots[pos].used && neighbor_age(&table->slots[pos], now_ms)) {
+    neighbor_delete_at(table, pos);
+  }
+
+  NeighborEntry* entry = neighbor_get_or_insert(table, key, now_ms);
+  if (entry == NULL) {
+    return true;
+  }
+
+  if (entry->state != NEIGHBOR_INCOMPLETE) {
+    table->gen++;
+    entry->state = NEIGHBOR_INCOMPLETE;
+    entry->updated_ms = now_ms;
+  } else if (entry->probed_ms != 0U && now_ms - entry->probed_ms < NEIGHBOR_RETRANS_MS) {
+    return false;
+  }
+
+  neighbor_schedule(table, neighbor_deadline_ms(entry));
+  entry->probed_ms = now_ms != 0U ? now_ms : 1U;
+  return true;
+}
+
+size_t neighbor_expire(NeighborTable* table, uint64_t now_ms) {
+  if (table == NULL) {
+    return 0U;
+  }
+
+  size_t evicted = 0U;
+  size_t index = 0U;
+  while (index < table->capacity) {
+    if (table->slots[index].used && neighbor_age(&table->slots[index], now_ms)) {
+      neighbor_delete_at(table, index);
+      evicted++;
+      continue;
+    }
+    index++;
+  }
+
+  /* Backward-shift deletion can move a survivor past the cursor, so re-arm in a second pass. */
+  sim_timer_cancel(&table->sweep_timer);
+  for (index = 0U; index < table->capacity; ++index) {
+    if (table->slots[index].used) {
+      neighbor_schedule(table, neighbor_deadline_ms(&table->slots[index]));
+    }
+  }
+  return evicted;
+}
+
+void neighbor_foreach(const NeighborTable* table, uint64_t now_ms, neighbor_visitor_fn fn,
+                      void* ctx) {
+  if (table == NULL || fn == NULL) {
+    return;
+  }
+
+  for (size_t index = 0U; index < table->capacity; ++index) {
+    if (table->slots[index].used) {
+      fn(&table->slots[index], now_ms, ctx);
+    }
+  }
+}
+
+size_t neighbor_count(const NeighborTable* table) {
+  return table != NULL ? table->count : 0U;
+}
+
+uint8_t neighbor_entry_state(const NeighborEntry* entry, uint64_t now_ms) {
+  if (entry == NULL) {
+    return NEIGHBOR_INCOMPLETE;
+  }
+
+  NeighborEntry copy = *entry;
+  (void)neighbor_age(&copy, now_ms);
+  return copy.state;
+}
+
+const char* neighbor_state_name(uint8_t state) {
+  switch (state) {
+  case NEIGHBOR_INCOMPLETE:
+    return "INCOMPLETE";
+  case NEIGHBOR_REACHABLE:
+    return "REACHABLE";
+  case NEIGHBOR_STALE:
+    return "STALE";
+  default:
+    return "UNKNOWN";
+  }
+}
@@ -0,0 +1,191 @@
+/**
+ * @file neighbor.h
+ * @brief Binary-keyed IPv4 neighbor (ARP) table shared by hosts and routers.
+ *
+ * Entries are keyed by the IPv4 address as a uint32_t and keep the MAC
+ * inline, so a cache hit costs one hash probe and no string formatting.
+ * Each entry follows a reduced RFC 4861-style state machine:
+ * INCOMPLETE (request sent, no answer yet), REACHABLE (recently confirmed)
+ * and STALE (usable, but older than NEIGHBOR_REACHABLE_MS). Stale and
+ * unanswered entries are dropped once their timers run out: on lookup,
+ * and in sequential builds also by a sweep timer on the simulation clock,
+ * so entries nobody asks for again do not linger in `arp` output.
+ *
+ * The table keeps a generation number that changes whenever a resolved
+ * MAC is replaced or withdrawn, so callers caching resolutions (the
+ * router's flow cache) can tell when their copies went bad.
+ */
+
+#ifndef MAGI_LAYER2_NEIGHBOR_H
+#define MAGI_LAYER2_NEIGHBOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Time a confirmed entry stays REACHABLE before turning STALE. */
+#define NEIGHBOR_REACHABLE_MS 30000U
+/** Time a STALE entry is still used before it is evicted. */
+#define NEIGHBOR_STALE_MS 60000U
+/** Time an INCOMPLETE entry waits for a reply before it is evicted. */
+#define NEIGHBOR_INCOMPLETE_MS 3000U
+/** Minimum spacing between ARP requests for the same INCOMPLETE entry. */
+#define NEIGHBOR_RETRANS_MS 1000U
+
+/** @brief Neighbor entry states. */
+typedef enum NeighborState {
+  NEIGHBOR_INCOMPLETE = 0,
+  NEIGHBOR_REACHABLE = 1,
+  NEIGHBOR_STALE = 2,
+} NeighborState;
+
+/** @brief One neighbor table entry. */
+typedef struct NeighborEntry {
+  /** IPv4 address in host byte order. */
+  uint32_t ip;
+  /** Resolved hardware address; zero while INCOMPLETE. */
+  uint8_t mac[6];
+  /** Current NeighborState. */
+  uint8_t state;
+  /** Slot occupancy flag (internal). */
+  bool used;
+  /** Time of the last state change, in neighbor_now_ms() units. */
+  uint64_t updated_ms;
+  /** Time the last ARP request was sent for this entry. */
+  uint64_t probed_ms;
+} NeighborEntry;
+
+/** @brief Opaque neighbor table. */
+typedef struct NeighborTable NeighborTable;
+
+typedef void (*neighbor_visitor_fn)(const NeighborEntry* entry, uint64_t now_ms, void* ctx);
+
+/**
+ * @brief Clock used for neighbor aging.
+ *
+ * @return Simulation time in milliseconds (see core/sim.h).
+ */
+uint64_t neighbor_now_ms(void);
+
+/**
+ * @brief Create an empty neighbor table.
+ *
+ * @param initial_capacity Minimum desired slot count.
+ * @return Table instance, or NULL on failure.
+ */
+NeighborTable* neighbor_table_new(size_t initial_capacity);
+
+/**
+ * @brief Destroy a neighbor table.
+ *
+ * @param table Table to free. NULL is allowed.
+ */
+void neighbor_table_free(NeighborTable* table);
+
+/**
+ * @brief Record a confirmed IP-to-MAC mapping and mark it REACHABLE.
+ *
+ * @param table Neighbor table.
+ * @param ip IPv4 address.
+ * @param mac Hardware address.
+ * @param now_ms Current time.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int neighbor_update(NeighborTable* table, const uint8_t ip[4], const uint8_t mac[6],
+                    uint64_t now_ms);
+
+/**
+ * @brief Resolve an address, applying aging on the way.
+ *
+ * REACHABLE entries older than NEIGHBOR_REACHABLE_MS become STALE and are
+ * still returned; expired STALE or INCOMPLETE entries are evicted.
+ *
+ * @param table Neighbor table.
+ * @param ip IPv4 address.
+ * @param now_ms Current time.
+ * @param mac_out Destination for the MAC on success.
+ * @return true if a REACHABLE or STALE entry was found.
+ */
+bool neighbor_resolve(NeighborTable* table, const uint8_t ip[4], uint64_t now_ms,
+                      uint8_t mac_out[6]);
+
+/**
+ * @brief Time a resolved entry will be evicted unless it is confirmed again.
+ *
+ * @param table Neighbor table.
+ * @param ip IPv4 address.
+ * @return Expiry time in neighbor_now_ms() units, or 0 if the address is not resolved.
+ */
+uint64_t neighbor_expires_ms(const NeighborTable* table, const uint8_t ip[4]);
+
+/**
+ * @brief Generation number, bumped whenever a resolved MAC changes or goes away.
+ *
+ * @param table Neighbor table.
+ * @return Current generation, or 0 for NULL.
+ */
+uint32_t neighbor_generation(const NeighborTable* table);
+
+/**
+ * @brief Note that resolution of an address is in progress.
+ *
+ * Creates an INCOMPLETE entry if none exists. The caller should transmit
+ * an ARP request only when this returns true, which rate-limits requests
+ * to one per NEIGHBOR_RETRANS_MS per address.
+ *
+ * @param table Neighbor table.
+ * @param ip IPv4 address being resolved.
+ * @param now_ms Current time.
+ * @return true if an ARP request should be sent now.
+ */
+bool neighbor_start_probe(NeighborTable* table, const uint8_t ip[4], uint64_t now_ms);
+
+/**
+ * @brief Evict every entry whose timer has run out.
+ *
+ * The table's sweep timer calls this at the earliest eviction time and
+ * re-arms for the next one; callers may also run it directly.
+ *
+ * @param table Neighbor table.
+ * @param now_ms Current time.
+ * @return Number of evicted entries.
+ */
+size_t neighbor_expire(NeighborTable* table, uint64_t now_ms);
+
+/**
+ * @brief Visit every live entry in unspecified order.
+ *
+ * @param table Neighbor table.
+ * @param now_ms Current time, forwarded to the visitor for age display.
+ * @param fn Visitor callback.
+ * @param ctx Opaque callback context.
+ */
+void neighbor_foreach(const NeighborTable* table, uint64_t now_ms, neighbor_visitor_fn fn,
+                      void* ctx);
+
+/**
+ * @brief Number of live entries.
+ *
+ * @param table Neighbor table.
+ * @return Entry count, or 0 for NULL.
+ */
+size_t neighbor_count(const NeighborTable* table);
+
+/**
+ * @brief State an entry would have after aging, without mutating it.
+ *
+ * @param entry Table entry.
+ * @param now_ms Current time.
+ * @return Effective NeighborState.
+ */
+uint8_t neighbor_entry_state(const NeighborEntry* entry, uint64_t now_ms);
+
+/**
+ * @brief Human-readable state name.
+ *
+ * @param state NeighborState value.
+ * @return Static string such as "REACHABLE".
+ */
+const char* neighbor_state_name(uint8_t state);
+
+#endif
@@ -1,10 +1,14 @@
 #define _POSIX_C_SOURCE 200809L
+#define MAGI_LOG_SUBSYS MAGI_LOG_L2
 
 #include "switch.h"
 
 #include "core/interface.h"
+#include "core/pktbuf.h"
 #include "layer2/ethernet.h"
+#include "layer2/fdb.h"
 #include "utils/arena.h"
+#include "utils/byteops.h"
 #include "utils/log.h"
 #include "utils/mac.h"
 #include "utils/magi_error.h"
@@ -14,28 +18,66 @@
 #include <string.h>
 #include <strings.h>
 
-typedef struct SwitchMacEntry {
-  uint16_t port;
-  uint16_t vlan_id;
-  char mac[18];
-} SwitchMacEntry;
+/** Per-port VLAN settings; unconfigured ports behave as access ports on VLAN 1. */
+typedef struct SwitchPortSlot {
+  SwitchPortConfig config;
+  bool configured;
+} SwitchPortSlot;
+
+/** Number of 802.1Q VLAN ids; usable ids are 1..SWITCH_VLAN_COUNT - 2. */
+#define SWITCH_VLAN_COUNT 4096U
+
+/** One flood target: a linked port and whether the frame leaves it tagged. */
+typedef struct SwitchFloodPort {
+  Interface* iface;
+  bool tagged;
+} SwitchFloodPort;
+
+/** Flood targets for one VLAN, a slice of SwitchState.flood_ports in port order. */
+typedef struct SwitchFloodList {
+  size_t first;
+  size_t count;
+} SwitchFloodList;
 
 typedef struct SwitchState {
-  HashMap* mac_table;
-  HashMap* port_configs;
+  /** Forwarding database keyed by (VLAN, MAC). */
+  Fdb* fdb;
+  /** VLAN settings indexed by port number. */
+  SwitchPortSlot* port_slots;
+  /** Length of port_slots. */
+  size_t port_slot_count;
   uint16_t num_ports;
+  /** Flood list number per VLAN id; 0 selects the trunk-only list. */
+  uint16_t* flood_index;
+  /** Flood lists; entry 0 holds only trunk ports. */
+  SwitchFloodList* flood_lists;
+  /** Backing storage for every flood list. */
+  SwitchFloodPort* flood_ports;
+  /** node->iface_gen the lists were built against. */
+  uint32_t flood_gen;
+  /** Set when a port's VLAN settings change. */
+  bool flood_stale;
 } SwitchState;
 
 struct Switch {
   Node node;
 };
 
-typedef struct FloodCtx {
-  Switch* sw;
-  Interface* ingress;
-  const EthernetFrame* frame;
+/** What the lookup stage decided to do with a received frame. */
+typedef enum SwitchRxAction {
+  SWITCH_RX_DROP,
+  SWITCH_RX_FLOOD,
+  SWITCH_RX_FORWARD
+} SwitchRxAction;
+
+/** One received frame on its way through the parse, lookup and transmit stages. */
+typedef struct SwitchRxSlot {
+  EthernetFrame frame;
   uint16_t vlan_id;
-} FloodCtx;
+  SwitchRxAction action;
+  /** Egress port for SWITCH_RX_FORWARD. */
+  Interface* egress;
+} SwitchRxSlot;
 
 typedef struct PrintMacCtx {
   const char* switch_name;
@@ -70,27 +112,11 @@ static const SwitchState* switch_state_const(const Switch* sw) {
   return node != NULL ? (const SwitchState*)node->data : NULL;
 }
 
-/**
- * Free a single hashmap entry whose value is a heap-allocated pointer.
- *
- * Callback for hashmap_foreach used to free MAC table and port config
- * value structs.
- *
- * \param key   Entry key (unused).
- * \param value Pointer to the heap-allocated struct to free.
- * \param ctx   User context (unused).
- */
-static void free_value_entry(const char* key, void* value, void* ctx) {
-  (void)key;
-  (void)ctx;
-  free(value);
-}
-
 /**
  * Free the SwitchState struct and all its internal resources.
  *
- * Iterates over and frees all MAC table entries and port configuration
- * entries, then frees the hash maps and the state struct itself.
+ * Frees the forwarding database, the port configuration array, the
+ * flood lists, and the state struct itself.
  *
  * \param data Pointer to the SwitchState to free.
  */
@@ -100,18 +126,21 @@ static void switch_state_free(void* data) {
     return;
   }
 
-  hashmap_foreach(state->mac_table, free_value_entry, NULL);
-  hashmap_free(state->mac_table);
-  hashmap_foreach(state->port_configs, free_value_entry, NULL);
-  hashmap_free(state->port_configs);
+  fdb_free(state->fdb);
+  free(state->port_slots);
+  free(state->flood_index);
+  free(state->flood_lists);
+  free(state->flood_ports);
   free(state);
 }
 
 /**
  * Create and initialize a new SwitchState struct.
  *
- * Allocates a zero-initialized SwitchState and creates the MAC table and
- * port configuration hash maps, each with an initial capacity of 16 entries.
+ * Allocates a zero-initialized SwitchState and creates a forwarding
+ * database with the default capacity and ageing time, plus the per-VLAN
+ * flood index. The port configuration array grows as ports are
+ * configured; flood lists are built on the first flood.
  *
  * \return Pointer to the new SwitchState, or NULL on allocation failure.
  */
@@ -122,9 +151,10 @@ static SwitchState* switch_state_new(void) {
     return NULL;
   }
 
-  state->mac_table = hashmap_new(16U);
-  state->port_configs = hashmap_new(16U);
-  if (state->mac_table == NULL || state->port_configs == NULL) {
+  state->fdb = fdb_new(FDB_DEFAULT_CAPACITY, FDB_AGING_MS);
+  state->flood_index = calloc(SWITCH_VLAN_COUNT, sizeof(*state->flood_index));
+  state->flood_stale = true;
+  if (state->fdb == NULL || state->flood_index == NULL) {
     switch_state_free(state);
     magi_errno = MAGI_ERR_NOMEM;
     return NULL;
@@ -133,40 +163,12 @@ static SwitchState* switch_state_new(void) {
   return state;
 }
 
-/**
- * Build a decimal string key for a port number.
- *
- * Writes the port number as an unsigned decimal string into the output
- * buffer for use as a hash map key.
- *
- * \param port Port number to format.
- * \param out  Output buffer (must be at least 16 bytes).
- */
-static void build_port_key(uint16_t port, char out[16]) {
-  snprintf(out, 16U, "%u", (unsigned)port);
-}
-
-/**
- * Build a compound hash map key from a VLAN ID and MAC address.
- *
- * Formats the key as "VLANID:AA:BB:CC:DD:EE:FF" for use in the MAC
- * address table.
- *
- * \param vlan_id VLAN identifier.
- * \param mac     6-byte MAC address.
- * \param out     Output buffer (must be at least 32 bytes).
- */
-static void build_mac_key(uint16_t vlan_id, const uint8_t mac[ETHERNET_MAC_LEN], char out[32]) {
-  char mac_text[18];
-  mac_to_str(mac, mac_text);
-  snprintf(out, 32U, "%u:%s", (unsigned)vlan_id, mac_text);
-}
-
 /**
  * Obtain the effective port configuration for a switch port.
  *
  * Returns the port mode (access or trunk) and associated VLAN ID. If no
  * explicit configuration is stored, defaults to access mode on VLAN 1.
+ * The lookup indexes the port array directly.
  *
  * \param sw   Pointer to the Switch.
  * \param port Port number to query.
@@ -183,36 +185,35 @@ static void switch_effective_port_config(const Switch* sw, uint16_t port, Switch
 }
 
 /**
- * Check whether a switch port allows traffic for a given VLAN.
+ * Check whether a port configuration allows traffic for a given VLAN.
  *
  * Trunk ports allow all VLANs. Access ports only allow their configured
  * VLAN ID.
  *
- * \param sw      Pointer to the Switch.
- * \param port    Port number to check.
+ * \param config  Effective configuration of the port.
  * \param vlan_id VLAN ID to test.
  * \return true if the port allows the VLAN, false otherwise.
  */
-static bool switch_port_allows_vlan(const Switch* sw, uint16_t port, uint16_t vlan_id) {
-  SwitchPortConfig config = {0};
-  switch_effective_port_config(sw, port, &config);
-  return config.mode == SWITCH_PORT_TRUNK || config.vlan_id == vlan_id;
+static bool switch_port_allows_vlan(const SwitchPortConfig* config, uint16_t vlan_id) {
+  return config->mode == SWITCH_PORT_TRUNK || config->vlan_id == vlan_id;
 }
 
 /**
- * Learn the source MAC address from an incoming frame into the MAC table.
+ * Learn the source MAC address from an incoming frame into the FDB.
  *
- * Creates or updates a SwitchMacEntry keyed by VLAN ID and source MAC.
- * Broadcast and multicast source addresses are silently ignored.
+ * Creates or refreshes the (VLAN ID, source MAC) entry. Only new stations,
+ * port moves and a full table are logged; refreshing a known station is
+ * silent. Broadcast and multicast source addresses are ignored.
  *
  * \param sw      Pointer to the Switch.
  * \param ingress Interface on which the frame arrived.
  * \param frame   Pointer to the parsed Ethernet frame.
  * \param vlan_id Resolved VLAN ID for the ingress port.
+ * \param now_ms  Current FDB time.
  * \return MAGI_OK on success, or a negative error code on failure.
  */
 static int switch_learn_source(Switch* sw, Interface* ingress, const EthernetFrame* frame,
-                               uint16_t vlan_id) {
+                               uint16_t vlan_id, uint64_t now_ms) {
   SwitchState* state = switch_state(sw);
   if (state == NULL || ingress == NULL || frame == NULL) {
     magi_errno = MAGI_ERR_BADARGS;
@@ -223,30 +224,54 @@ static int switch_learn_source(Switch* sw, Interface* ingress, const EthernetFra
     return MAGI_OK;
   }
 
-  char key[32];
-  build_mac_key(vlan_id, frame->src_mac, key);
+  uint16_t prev_port = 0U;
+  int result =
+      fdb_learn(state->fdb, vlan_id, frame->src_mac, ingress->port_number, now_ms, &prev_port);
+  if (result < 0 || result == FDB_LEARN_REFRESHED) {
+    return result < 0 ? result : MAGI_OK;
+  }
 
-  SwitchMacEntry* entry = hashmap_get(state->mac_table, key);
-  if (entry == NULL) {
-    entry = calloc(1U, sizeof(*entry));
-    if (entry == NULL) {
-      magi_errno = MAGI_ERR_NOMEM;
-      return MAGI_ERR_NOMEM;
-    }
+  char mac_text[18];
+  mac_to_str(frame->src_mac, mac_text);
+  const char* name = switch_as_node(sw)->name;
+  if (result == FDB_LEARN_NEW) {
+    LOG(name, "Learn MAC %s on VLAN %u Port %u", mac_text, (unsigned)vlan_id,
+        (unsigned)ingress->port_number);
+  } else if (result == FDB_LEARN_MOVED) {
+    LOG(name, "MAC %s on VLAN %u moved from Port %u to Port %u", mac_text, (unsigned)vlan_id,
+        (unsigned)prev_port, (unsigned)ingress->port_number);
+  } else {
+    LOG(name, "FDB full; not learning MAC %s on VLAN %u", mac_text, (unsigned)vlan_id);
+  }
+  return MAGI_OK;
+}
 
-    int status = hashmap_set(state->mac_table, key, entry);
-    if (status != MAGI_OK) {
-      free(entry);
-      return status;
-    }
+/**
+ * Build the egress copy of a frame for one VLAN and tagging mode.
+ *
+ * \param frame   Parsed ingress frame; its payload is copied.
+ * \param vlan_id VLAN written into the 802.1Q tag.
+ * \param tagged  true to emit an 802.1Q header.
+ * \return Packet buffer holding the frame, or NULL on allocation failure.
+ */
+static PktBuf* switch_frame_pkt(const EthernetFrame* frame, uint16_t vlan_id, bool tagged) {
+  size_t header_len = tagged ? ETHERNET_VLAN_FRAME_LEN : ETHERNET_MIN_FRAME_LEN;
+  PktBuf* pkt = pktbuf_copy(header_len, frame->payload, frame->payload_len);
+  if (pkt == NULL) {
+    return NULL;
   }
 
-  entry->port = ingress->port_number;
-  entry->vlan_id = vlan_id;
-  mac_to_str(frame->src_mac, entry->mac);
-  LOG(switch_as_node(sw)->name, "Learn MAC %s on VLAN %u Port %u", entry->mac, (unsigned)vlan_id,
-      (unsigned)entry->port);
-  return MAGI_OK;
+  uint8_t* bytes = pktbuf_push(pkt, header_len);
+  memcpy(bytes, frame->dst_mac, ETHERNET_MAC_LEN);
+  memcpy(bytes + ETHERNET_MAC_LEN, frame->src_mac, ETHERNET_MAC_LEN);
+  if (tagged) {
+    WRITE_U16(bytes, 12U, ETHERNET_TYPE_VLAN);
+    WRITE_U16(bytes, 14U, vlan_id & 0x0FFFU);
+    WRITE_U16(bytes, 16U, frame->ethertype);
+  } else {
+    WRITE_U16(bytes, 12U, frame->ethertype);
+  }
+  return pkt;
 }
 
 /**
@@ -269,57 +294,105 @@ static int switch_send_frame(Switch* sw, Interface* egress, const EthernetFrame*
     return MAGI_ERR_BADARGS;
   }
 
-  if (!switch_port_allows_vlan(sw, egress->port_number, vlan_id)) {
-    return MAGI_OK;
-  }
-
   SwitchPortConfig config = {0};
   switch_effective_port_config(sw, egress->port_number, &config);
+  if (!switch_port_allows_vlan(&config, vlan_id)) {
+    return MAGI_OK;
+  }
 
-  EthernetFrame out_frame = *original;
-  out_frame.vlan_id = vlan_id;
-  out_frame.vlan_present = config.mode == SWITCH_PORT_TRUNK;
-
-  uint8_t* bytes = NULL;
-  size_t len = 0U;
-  int status = ethernet_frame_to_bytes(&out_frame, &bytes, &len);
-  if (status != MAGI_OK) {
-    return status;
+  PktBuf* pkt = switch_frame_pkt(original, vlan_id, config.mode == SWITCH_PORT_TRUNK);
+  if (pkt == NULL) {
+    return MAGI_ERR_NOMEM;
   }
 
   LOG(switch_as_node(sw)->name, "Forward frame VLAN %u out Port %u", (unsigned)vlan_id,
       (unsigned)egress->port_number);
-  status = interface_send(egress, bytes, len);
-  return status;
+  return interface_send_pkt(egress, pkt);
 }
 
 /**
- * Callback for hashmap_foreach that floods a frame to all interfaces except the ingress.
+ * Rebuild the per-VLAN flood lists from the port settings and links.
  *
- * Skips interfaces that are NULL, match the ingress port, or have no link.
- * Delegates frame transmission to switch_send_frame.
+ * List 0 holds every linked trunk port. Each VLAN with at least one
+ * linked access port gets its own list of those access ports plus the
+ * trunks. Lists keep ascending port order, so floods leave in the same
+ * order as a walk over the interface list would.
  *
- * \param key   Interface port key (unused).
- * \param value Pointer to the Interface.
- * \param ctx   Pointer to a FloodCtx with flood parameters.
+ * \param sw Pointer to the Switch.
+ * \return MAGI_OK on success, or MAGI_ERR_NOMEM (the old lists are kept).
  */
-static void flood_interface_cb(const char* key, void* value, void* ctx) {
-  (void)key;
+static int switch_rebuild_flood_lists(Switch* sw) {
+  Node* node = switch_as_node(sw);
+  SwitchState* state = switch_state(sw);
 
-  FloodCtx* state = ctx;
-  Interface* egress = value;
-  if (state == NULL || egress == NULL || egress == state->ingress || egress->link == NULL) {
-    return;
+  size_t trunks = 0U;
+  size_t access = 0U;
+  for (size_t index = 0U; index < node->iface_count; ++index) {
+    Interface* iface = node->iface_list[index];
+    SwitchPortConfig config = {0};
+    switch_effective_port_config(sw, iface->port_number, &config);
+    if (iface->link != NULL) {
+      trunks += config.mode == SWITCH_PORT_TRUNK;
+      access += config.mode == SWITCH_PORT_ACCESS;
+    }
   }
 
-  (void)switch_send_frame(state->sw, egress, state->frame, state->vlan_id);
+  /* Worst case: every access port on its own VLAN, each list repeating the trunks. */
+  SwitchFloodList* lists = calloc(access + 1U, sizeof(*lists));
+  SwitchFloodPort* ports = calloc(trunks + access + access * trunks + 1U, sizeof(*ports));
+  if (lists == NULL || ports == NULL) {
+    free(lists);
+    free(ports);
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
+  }
+
+  memset(state->flood_index, 0, SWITCH_VLAN_COUNT * sizeof(*state->flood_index));
+  size_t list_count = 1U;
+  for (size_t index = 0U; index < node->iface_count; ++index) {
+    Interface* iface = node->iface_list[index];
+    SwitchPortConfig config = {0};
+    switch_effective_port_config(sw, iface->port_number, &config);
+    if (iface->link != NULL && config.mode == SWITCH_PORT_ACCESS &&
+        state->flood_index[config.vlan_id] == 0U) {
+      state->flood_index[config.vlan_id] = (uint16_t)list_count++;
+    }
+  }
+
+  size_t used = 0U;
+  for (size_t list = 0U; list < list_count; ++list) {
+    lists[list].first = used;
+    for (size_t index = 0U; index < node->iface_count; ++index) {
+      Interface* iface = node->iface_list[index];
+      SwitchPortConfig config = {0};
+      switch_effective_port_config(sw, iface->port_number, &config);
+      bool trunk = config.mode == SWITCH_PORT_TRUNK;
+      if (iface->link != NULL && (trunk || state->flood_index[config.vlan_id] == list)) {
+        ports[used].iface = iface;
+        ports[used].tagged = trunk;
+        used++;
+      }
+    }
+    lists[list].count = used - lists[list].first;
+  }
+
+  free(state->flood_lists);
+  free(state->flood_ports);
+  state->flood_lists = lists;
+  state->flood_ports = ports;
+  state->flood_gen = node->iface_gen;
+  state->flood_stale = false;
+  return MAGI_OK;
 }
 
 /**
  * Flood a frame to all switch ports in the same VLAN except the ingress port.
  *
- * Iterates over all interfaces on the switch node and transmits the frame
- * to each eligible egress port via flood_interface_cb.
+ * Walks the VLAN's precomputed flood list, rebuilding the lists first if
+ * a port was reconfigured or a link attached or detached since they were
+ * built. The frame is serialized at most twice (untagged for access
+ * ports, tagged for trunks) and every egress port shares that buffer.
+ * One log line covers the whole flood rather than one per port.
  *
  * \param sw      Pointer to the Switch.
  * \param ingress Interface on which the frame arrived (excluded from flood).
@@ -330,16 +403,45 @@ static void flood_interface_cb(const char* key, void* value, void* ctx) {
 static int switch_flood(Switch* sw, Interface* ingress, const EthernetFrame* frame,
                         uint16_t vlan_id) {
   Node* node = switch_as_node(sw);
-  if (node == NULL || node->interfaces == NULL || ingress == NULL || frame == NULL) {
+  SwitchState* state = switch_state(sw);
+  if (node == NULL || state == NULL || ingress == NULL || frame == NULL) {
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
+  if (state->flood_stale || state->flood_gen != node->iface_gen) {
+    int status = switch_rebuild_flood_lists(sw);
+    if (status != MAGI_OK) {
+      return status;
+    }
+  }
+
   LOG(node->name, "Flood frame from Port %u on VLAN %u", (unsigned)ingress->port_number,
       (unsigned)vlan_id);
-  FloodCtx ctx = {.sw = sw, .ingress = ingress, .frame = frame, .vlan_id = vlan_id};
-  hashmap_foreach(node->interfaces, flood_interface_cb, &ctx);
-  return MAGI_OK;
+  const SwitchFloodList* list =
+      &state->flood_lists[vlan_id < SWITCH_VLAN_COUNT ? state->flood_index[vlan_id] : 0U];
+  PktBuf* copies[2] = {NULL, NULL};
+  int status = MAGI_OK;
+  for (size_t index = 0U; index < list->count; ++index) {
+    const SwitchFloodPort* target = &state->flood_ports[list->first + index];
+    if (target->iface == ingress) {
+      continue;
+    }
+
+    PktBuf** copy = &copies[target->tagged ? 1 : 0];
+    if (*copy == NULL) {
+      *copy = switch_frame_pkt(frame, vlan_id, target->tagged);
+      if (*copy == NULL) {
+        status = MAGI_ERR_NOMEM;
+        break;
+      }
+    }
+    (void)interface_send_pkt(target->iface, pktbuf_ref(*copy));
+  }
+
+  pktbuf_release(copies[0]);
+  pktbuf_release(copies[1]);
+  return status;
 }
 
 /**
@@ -367,6 +469,7 @@ static bool switch_resolve_ingress_vlan(Switch* sw, Interface* ingress, const Et
 
   if (config.mode == SWITCH_PORT_ACCESS) {
     if (frame->vlan_present && frame->vlan_id != config.vlan_id) {
+      node_count(switch_as_node(sw), MAGI_NODE_DROP_VLAN);
       LOG(switch_as_node(sw)->name,
           "Drop tagged frame on access Port %u (tag VLAN %u, access VLAN %u)",
           (unsigned)ingress->port_number, (unsigned)frame->vlan_id, (unsigned)config.vlan_id);
@@ -382,87 +485,176 @@ static bool switch_resolve_ingress_vlan(Switch* sw, Interface* ingress, const Et
 }
 
 /**
- * Handle an incoming Ethernet frame received on a switch interface.
+ * Parse stage: decode a received frame and resolve its VLAN.
  *
- * This is the top-level receive callback registered with the Node. The
- * pipeline is: parse Ethernet frame, resolve ingress VLAN, learn source
- * MAC, then flood or unicast forward based on the destination MAC address
- * lookup in the MAC table.
- *
- * \param node The Node (castable to Switch) that received the frame.
+ * \param sw    Pointer to the Switch.
  * \param iface Interface on which the frame arrived.
  * \param data  Pointer to the raw frame bytes.
  * \param len   Length of the raw frame.
+ * \param slot  Receives the parsed frame and VLAN.
+ * \return true if the frame goes on to the lookup stage, false if it was dropped.
  */
-static void switch_handle_receive(Node* node, Interface* iface, const uint8_t* data, size_t len) {
-  Switch* sw = switch_from_node(node);
-  SwitchState* state = switch_state(sw);
-  arena_reset(node->arena);
-  EthernetFrame frame = {0};
-
-  if (state == NULL || iface == NULL || ethernet_frame_from_bytes(data, len, &frame) != MAGI_OK) {
+static bool switch_rx_parse(Switch* sw, Interface* iface, const uint8_t* data, size_t len,
+                            SwitchRxSlot* slot) {
+  Node* node = switch_as_node(sw);
+  memset(&slot->frame, 0, sizeof(slot->frame));
+  if (switch_state(sw) == NULL || iface == NULL ||
+      ethernet_frame_from_bytes(data, len, &slot->frame) != MAGI_OK) {
+    node_count(node, MAGI_NODE_DROP_MALFORMED);
     LOG(node->name, "Drop malformed Ethernet frame");
-    return;
-  }
-
-  uint16_t vlan_id = 0U;
-  if (!switch_resolve_ingress_vlan(sw, iface, &frame, &vlan_id)) {
-    return;
+    return false;
   }
 
-  (void)switch_learn_source(sw, iface, &frame, vlan_id);
+  return switch_resolve_ingress_vlan(sw, iface, &slot->frame, &slot->vlan_id);
+}
 
-  if (ethernet_mac_is_broadcast(frame.dst_mac) || ethernet_mac_is_multicast(frame.dst_mac)) {
-    (void)switch_flood(sw, iface, &frame, vlan_id);
-    return;
-  }
+/**
+ * Lookup stage: learn the source MAC, then pick flood or unicast forward
+ * from the destination MAC's FDB entry.
+ *
+ * \param sw     Pointer to the Switch.
+ * \param iface  Interface on which the frame arrived.
+ * \param slot   Parsed frame; receives the action and egress port.
+ * \param now_ms Current FDB time.
+ */
+static void switch_rx_lookup(Switch* sw, Interface* iface, SwitchRxSlot* slot, uint64_t now_ms) {
+  Node* node = switch_as_node(sw);
+  const EthernetFrame* frame = &slot->frame;
+  (void)switch_learn_source(sw, iface, frame, slot->vlan_id, now_ms);
 
-  char key[32];
-  build_mac_key(vlan_id, frame.dst_mac, key);
-  SwitchMacEntry* entry = hashmap_get(state->mac_table, key);
-  if (entry == NULL) {
-    (void)switch_flood(sw, iface, &frame, vlan_id);
+  slot->action = SWITCH_RX_FLOOD;
+  uint16_t port = 0U;
+  if (ethernet_mac_is_broadcast(frame->dst_mac) || ethernet_mac_is_multicast(frame->dst_mac) ||
+      !fdb_lookup(switch_state(sw)->fdb, slot->vlan_id, frame->dst_mac, now_ms, &port)) {
     return;
   }
 
-  if (entry->port == iface->port_number) {
+  if (port == iface->port_number) {
     LOG(node->name, "Destination is on ingress Port %u; drop loopback frame",
         (unsigned)iface->port_number);
+    slot->action = SWITCH_RX_DROP;
     return;
   }
 
-  Interface* egress = node_get_interface(node, entry->port);
+  Interface* egress = node_get_interface(node, port);
   if (egress == NULL || egress->link == NULL) {
-    LOG(node->name, "Known destination Port %u is unavailable; flood instead",
-        (unsigned)entry->port);
-    (void)switch_flood(sw, iface, &frame, vlan_id);
+    LOG(node->name, "Known destination Port %u is unavailable; flood instead", (unsigned)port);
     return;
   }
 
-  (void)switch_send_frame(sw, egress, &frame, vlan_id);
+  slot->action = SWITCH_RX_FORWARD;
+  slot->egress = egress;
 }
 
 /**
- * Print a single MAC table entry via the logging system.
+ * Transmit stage: send the frame out of its egress port or flood it.
  *
- * Callback for hashmap_foreach used by switch_print_mac_table. Each entry
- * is logged as "MAC VLAN <id> <mac> -> Port <port>".
+ * \param sw    Pointer to the Switch.
+ * \param iface Interface on which the frame arrived.
+ * \param slot  Frame with the action the lookup stage chose.
+ */
+static void switch_rx_transmit(Switch* sw, Interface* iface, const SwitchRxSlot* slot) {
+  if (slot->action == SWITCH_RX_FORWARD) {
+    (void)switch_send_frame(sw, slot->egress, &slot->frame, slot->vlan_id);
+  } else if (slot->action == SWITCH_RX_FLOOD) {
+    (void)switch_flood(sw, iface, &slot->frame, slot->vlan_id);
+  }
+}
+
+/**
+ * Handle an incoming Ethernet frame received on a switch interface.
  *
- * \param key   MAC table key (unused).
- * \param value Pointer to a SwitchMacEntry.
- * \param ctx   Pointer to a PrintMacCtx tracking switch name and count.
+ * This is the top-level receive callback registered with the Node. The
+ * pipeline is: parse Ethernet frame, resolve ingress VLAN, learn source
+ * MAC, then flood or unicast forward based on the destination MAC address
+ * lookup in the FDB.
+ *
+ * \param node The Node (castable to Switch) that received the frame.
+ * \param iface Interface on which the frame arrived.
+ * \param data  Pointer to the raw frame bytes.
+ * \param len   Length of the raw frame.
+ */
+static void switch_handle_receive(Node* node, Interface* iface, const uint8_t* data, size_t len) {
+  Switch* sw = switch_from_node(node);
+  arena_reset(node->arena);
+  SwitchRxSlot slot;
+  if (!switch_rx_parse(sw, iface, data, len, &slot)) {
+    return;
+  }
+
+  switch_rx_lookup(sw, iface, &slot, fdb_now_ms());
+  switch_rx_transmit(sw, iface, &slot);
+}
+
+/**
+ * Handle a burst of frames, running each pipeline stage over all of them
+ * before the next: parse every frame, then learn and look up every
+ * source and destination, then transmit. Per-frame results match
+ * switch_handle_receive() run on the frames in order.
+ *
+ * \param node   The Node (castable to Switch) that received the frames.
+ * \param frames Received frames; handled NODE_RX_BURST at a time.
+ * \param count  Number of frames.
  */
-static void print_mac_entry(const char* key, void* value, void* ctx) {
-  (void)key;
+static void switch_handle_receive_batch(Node* node, RxFrame* frames, size_t count) {
+  Switch* sw = switch_from_node(node);
+  arena_reset(node->arena);
+  SwitchRxSlot slots[NODE_RX_BURST];
+  bool live[NODE_RX_BURST];
+
+  for (size_t base = 0U; base < count; base += NODE_RX_BURST) {
+    RxFrame* burst = &frames[base];
+    size_t size = count - base < NODE_RX_BURST ? count - base : NODE_RX_BURST;
+    for (size_t index = 0U; index < size; ++index) {
+      live[index] = switch_rx_parse(sw, burst[index].iface, burst[index].data, burst[index].len,
+                                    &slots[index]);
+    }
 
+    uint64_t now_ms = fdb_now_ms();
+    for (size_t index = 0U; index < size; ++index) {
+      if (live[index]) {
+        switch_rx_lookup(sw, burst[index].iface, &slots[index], now_ms);
+      }
+    }
+
+    for (size_t index = 0U; index < size; ++index) {
+      if (live[index]) {
+        switch_rx_transmit(sw, burst[index].iface, &slots[index]);
+      }
+    }
+  }
+}
+
+/**
+ * Print a single FDB entry via the logging system.
+ *
+ * Callback for fdb_foreach used by switch_print_mac_table. Each entry is
+ * logged as "MAC VLAN <id> <mac> -> Port <port> age=<s>s", followed by
+ * the move count for stations that have changed port.
+ *
+ * \param entry  FDB entry.
+ * \param now_ms Current time, used for the age.
+ * \param ctx    Pointer to a PrintMacCtx tracking switch name and count.
+ */
+static void print_mac_entry(const FdbEntry* entry, uint64_t now_ms, void* ctx) {
   PrintMacCtx* state = ctx;
-  SwitchMacEntry* entry = value;
   if (state == NULL || entry == NULL) {
     return;
   }
 
-  LOG(state->switch_name, "MAC VLAN %u %s -> Port %u", (unsigned)entry->vlan_id, entry->mac,
-      (unsigned)entry->port);
+  uint8_t mac[ETHERNET_MAC_LEN];
+  char mac_text[18];
+  fdb_key_mac(entry->key, mac);
+  mac_to_str(mac, mac_text);
+  unsigned long long age = (unsigned long long)((now_ms - entry->last_seen_ms) / 1000U);
+  if (entry->moves > 0U) {
+    LOG(state->switch_name, "MAC VLAN %u %s -> Port %u age=%llus moves=%u",
+        (unsigned)fdb_key_vlan(entry->key), mac_text, (unsigned)entry->port, age,
+        (unsigned)entry->moves);
+  } else {
+    LOG(state->switch_name, "MAC VLAN %u %s -> Port %u age=%llus",
+        (unsigned)fdb_key_vlan(entry->key), mac_text, (unsigned)entry->port, age);
+  }
   state->count++;
 }
 
@@ -481,6 +673,7 @@ Switch* switch_new(const char* name) {
   node->data = state;
   node->data_free = switch_state_free;
   node->handle_receive = switch_handle_receive;
+  node->handle_receive_batch = switch_handle_receive_batch;
   return switch_from_node(node);
 }
 
@@ -530,6 +723,10 @@ int switch_configure_port(Switch* sw, uint16_t port, const char* mode_text, uint
 
   SwitchPortConfig parsed = {0};
   if (strcasecmp(mode_text, "access") == 0) {
+    if (vlan_id >= SWITCH_VLAN_COUNT - 1U) {
+      magi_errno = MAGI_ERR_BADARGS;
+      return MAGI_ERR_BADARGS;
+    }
     parsed.mode = SWITCH_PORT_ACCESS;
     parsed.vlan_id = vlan_id != ETHERNET_VLAN_ID_NONE ? vlan_id : 1U;
   } else if (strcasecmp(mode_text, "trunk") == 0) {
@@ -544,24 +741,25 @@ int switch_configure_port(Switch* sw, uint16_t port, const char* mode_text, uint
     return MAGI_ERR_BADARGS;
   }
 
-  char key[16];
-  build_port_key(port, key);
-  SwitchPortConfig* config = hashmap_get(state->port_configs, key);
-  if (config == NULL) {
-    config = malloc(sizeof(*config));
-    if (config == NULL) {
+  if ((size_t)port >= state->port_slot_count) {
+    size_t count = state->port_slot_count != 0U ? state->port_slot_count : 16U;
+    while (count <= (size_t)port) {
+      count *= 2U;
+    }
+    SwitchPortSlot* slots = realloc(state->port_slots, count * sizeof(*slots));
+    if (slots == NULL) {
       magi_errno = MAGI_ERR_NOMEM;
       return MAGI_ERR_NOMEM;
     }
-
-    int status = hashmap_set(state->port_configs, key, config);
-    if (status != MAGI_OK) {
-      free(config);
-      return status;
-    }
+    memset(slots + state->port_slot_count, 0,
+           (count - state->port_slot_count) * sizeof(*slots));
+    state->port_slots = slots;
+    state->port_slot_count = count;
   }
 
-  *config = parsed;
+  state->port_slots[port].config = parsed;
+  state->port_slots[port].configured = true;
+  state->flood_stale = true;
   if (port > state->num_ports) {
     state->num_ports = port;
   }
@@ -575,14 +773,11 @@ bool switch_get_port_config(const Switch* sw, uint16_t port, SwitchPortConfig* o
     return false;
   }
 
-  char key[16];
-  build_port_key(port, key);
-  SwitchPortConfig* config = hashmap_get(state->port_configs, key);
-  if (config == NULL) {
+  if ((size_t)port >= state->port_slot_count || !state->port_slots[port].configured) {
     return false;
   }
 
-  *out = *config;
+  *out = state->port_slots[port].config;
   return true;
 }
 
@@ -595,8 +790,43 @@ void switch_print_mac_table(const Switch* sw) {
 
   const Node* node = switch_as_node_const(sw);
   PrintMacCtx ctx = {.switch_name = node->name, .count = 0U};
-  hashmap_foreach(state->mac_table, print_mac_entry, &ctx);
+  fdb_foreach(state->fdb, fdb_now_ms(), print_mac_entry, &ctx);
   if (ctx.count == 0U) {
     LOG(node->name, "MAC table empty");
   }
+
+  FdbStats stats;
+  fdb_get_stats(state->fdb, &stats);
+  LOG(node->name, "FDB %zu/%zu entries, aging %us, learned %llu, moves %llu, flaps %llu, "
+      "aged %llu, full drops %llu", stats.entries, stats.capacity,
+      (unsigned)(stats.aging_ms / 1000U), (unsigned long long)stats.learned,
+      (unsigned long long)stats.moves, (unsigned long long)stats.flaps,
+      (unsigned long long)stats.aged, (unsigned long long)stats.full_drops);
+}
+
+int switch_configure_fdb(Switch* sw, size_t capacity, uint32_t aging_ms) {
+  SwitchState* state = switch_state(sw);
+  if (sw == NULL || state == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  Fdb* fdb = fdb_new(capacity, aging_ms);
+  if (fdb == NULL) {
+    return MAGI_ERR_NOMEM;
+  }
+
+  fdb_free(state->fdb);
+  state->fdb = fdb;
+  return MAGI_OK;
+}
+
+bool switch_get_fdb_stats(const Switch* sw, FdbStats* out) {
+  const SwitchState* state = switch_state_const(sw);
+  if (state == NULL || out == NULL) {
+    return false;
+  }
+
+  fdb_get_stats(state->fdb, out);
+  return true;
 }
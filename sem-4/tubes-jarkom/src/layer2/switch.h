@@ -10,6 +10,7 @@
 #include <stdint.h>
 
 #include "core/node.h"
+#include "layer2/fdb.h"
 
 /** @brief Opaque switch specialization of Node. */
 typedef struct Switch Switch;
@@ -85,10 +86,12 @@ int switch_configure_num_ports(Switch* sw, uint16_t num_ports);
 /**
  * @brief Configure a switch port as access or trunk.
  *
+ * Flood lists are rebuilt lazily on the next flood.
+ *
  * @param sw Switch node.
  * @param port Port number.
  * @param mode_text "access" or "trunk".
- * @param vlan_id Access VLAN id; zero maps to VLAN 1.
+ * @param vlan_id Access VLAN id (at most 4094); zero maps to VLAN 1.
  * @return MAGI_OK on success, otherwise an error code.
  */
 int switch_configure_port(Switch* sw, uint16_t port, const char* mode_text, uint16_t vlan_id);
@@ -104,10 +107,31 @@ int switch_configure_port(Switch* sw, uint16_t port, const char* mode_text, uint
 bool switch_get_port_config(const Switch* sw, uint16_t port, SwitchPortConfig* out);
 
 /**
- * @brief Print the learned MAC table.
+ * @brief Print the learned MAC table with entry ages and FDB counters.
  *
  * @param sw Switch node.
  */
 void switch_print_mac_table(const Switch* sw);
 
+/**
+ * @brief Replace the forwarding database with an empty one of a new size.
+ *
+ * Learned entries and counters are discarded.
+ *
+ * @param sw Switch node.
+ * @param capacity Maximum number of stations; 0 selects FDB_DEFAULT_CAPACITY.
+ * @param aging_ms Entry lifetime since last seen; 0 selects FDB_AGING_MS.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int switch_configure_fdb(Switch* sw, size_t capacity, uint32_t aging_ms);
+
+/**
+ * @brief Read forwarding database occupancy and move/flap counters.
+ *
+ * @param sw Switch node.
+ * @param out Destination counters.
+ * @return true on success.
+ */
+bool switch_get_fdb_stats(const Switch* sw, FdbStats* out);
+
 #endif
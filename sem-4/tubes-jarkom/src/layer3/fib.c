@@ -0,0 +1,558 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "fib.h"
+
+#include "utils/magi_error.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FIB_ROOT_SIZE 65536U
+#define FIB_CHUNK_SIZE 256U
+#define FIB_CHUNK_FLAG 0x80000000U
+#define FIB_LEAF_EMPTY 0U
+#define FIB_TABLE_ROOT SIZE_MAX
+#define FIB_INDEX_EMPTY UINT32_MAX
+#define FIB_INDEX_MIN_CAP 64U
+
+/**
+ * @brief One installed prefix. Trie leaves refer to slots as (slot index + 1).
+ */
+typedef struct FibSlot {
+  RoutingTableEntry route;
+  uint8_t origin;
+  bool used;
+} FibSlot;
+
+/**
+ * @brief DIR-16-8-8 table plus an exact-match prefix index.
+ *
+ * Table entries are either a leaf (0 = no route, otherwise slot index + 1)
+ * or FIB_CHUNK_FLAG | chunk index. Leaves are pushed down into chunks when a
+ * longer prefix splits an entry, so each entry always holds the final answer
+ * for its address range. Chunks are only reclaimed by fib_free().
+ */
+struct Fib {
+  uint32_t* root;
+  uint32_t* chunks;
+  size_t chunk_count;
+  size_t chunk_cap;
+  FibSlot* slots;
+  size_t slot_count;
+  size_t slot_cap;
+  uint32_t* free_slots;
+  size_t free_count;
+  uint32_t* index;
+  size_t index_cap;
+  size_t live;
+};
+
+/**
+ * @brief Convert a 4-byte IPv4 address to a host-order 32-bit integer.
+ *
+ * @param ip 4-byte IPv4 address.
+ * @return Address as uint32_t.
+ */
+static uint32_t fib_addr_u32(const uint8_t ip[4]) {
+  return ((uint32_t)ip[0] << 24U) | ((uint32_t)ip[1] << 16U) | ((uint32_t)ip[2] << 8U) |
+         (uint32_t)ip[3];
+}
+
+/**
+ * @brief Compute a host-order subnet mask from a prefix length.
+ *
+ * @param prefix_len Prefix length (0-32).
+ * @return Subnet mask as uint32_t.
+ */
+static uint32_t fib_prefix_mask(int prefix_len) {
+  return prefix_len <= 0 ? 0U : 0xFFFFFFFFU << (32 - prefix_len);
+}
+
+/**
+ * @brief Hash a (network, prefix length) pair for the exact-match index.
+ *
+ * @param network Masked network address.
+ * @param prefix_len Prefix length.
+ * @return Unmasked hash value.
+ */
+static size_t fib_hash(uint32_t network, int prefix_len) {
+  uint64_t key = ((uint64_t)network << 6U) | (uint64_t)(unsigned)prefix_len;
+  return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32U);
+}
+
+/**
+ * @brief Find the index position holding a prefix, or the empty position where it would go.
+ *
+ * @param fib FIB instance.
+ * @param network Masked network address.
+ * @param prefix_len Prefix length.
+ * @return Position in fib->index.
+ */
+static size_t fib_index_probe(const Fib* fib, uint32_t network, int prefix_len) {
+  size_t mask = fib->index_cap - 1U;
+  size_t pos = fib_hash(network, prefix_len) & mask;
+
+  for (;;) {
+    uint32_t id = fib->index[pos];
+    if (id == FIB_INDEX_EMPTY) {
+      return pos;
+    }
+
+    const RoutingTableEntry* route = &fib->slots[id].route;
+    if (route->prefix_len == prefix_len && fib_addr_u32(route->network) == network) {
+      return pos;
+    }
+
+    pos = (pos + 1U) & mask;
+  }
+}
+
+/**
+ * @brief Double the exact-match index and reinsert every live slot.
+ *
+ * @param fib FIB instance.
+ * @return MAGI_OK on success, or MAGI_ERR_NOMEM.
+ */
+static int fib_index_grow(Fib* fib) {
+  size_t new_cap = fib->index_cap * 2U;
+  uint32_t* index = malloc(new_cap * sizeof(*index));
+  if (index == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
+  }
+
+  memset(index, 0xFF, new_cap * sizeof(*index));
+  free(fib->index);
+  fib->index = index;
+  fib->index_cap = new_cap;
+
+  for (size_t id = 0U; id < fib->slot_count; ++id) {
+    const FibSlot* slot = &fib->slots[id];
+    if (slot->used) {
+      size_t pos = fib_index_probe(fib, fib_addr_u32(slot->route.network), slot->route.prefix_len);
+      fib->index[pos] = (uint32_t)id;
+    }
+  }
+
+  return MAGI_OK;
+}
+
+/**
+ * @brief Delete one index position using backward-shift deletion.
+ *
+ * Keeps linear-probe chains intact without tombstones.
+ *
+ * @param fib FIB instance.
+ * @param pos Position of the entry to delete.
+ */
+static void fib_index_delete(Fib* fib, size_t pos) {
+  size_t mask = fib->index_cap - 1U;
+  size_t hole = pos;
+  size_t next = (pos + 1U) & mask;
+
+  while (fib->index[next] != FIB_INDEX_EMPTY) {
+    const RoutingTableEntry* route = &fib->slots[fib->index[next]].route;
+    size_t home = fib_hash(fib_addr_u32(route->network), route->prefix_len) & mask;
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      fib->index[hole] = fib->index[next];
+      hole = next;
+    }
+    next = (next + 1U) & mask;
+  }
+
+  fib->index[hole] = FIB_INDEX_EMPTY;
+}
+
+/**
+ * @brief Get the entry array for the root table or one chunk.
+ *
+ * @param fib FIB instance.
+ * @param table FIB_TABLE_ROOT or a chunk index.
+ * @return Pointer to the first entry of the table.
+ */
+static uint32_t* fib_table(Fib* fib, size_t table) {
+  return table == FIB_TABLE_ROOT ? fib->root : &fib->chunks[table * FIB_CHUNK_SIZE];
+}
+
+/**
+ * @brief Prefix length of the route a leaf refers to.
+ *
+ * @param fib FIB instance.
+ * @param leaf Leaf value.
+ * @return Prefix length, or -1 for an empty leaf.
+ */
+static int fib_leaf_prefix(const Fib* fib, uint32_t leaf) {
+  return leaf == FIB_LEAF_EMPTY ? -1 : fib->slots[leaf - 1U].route.prefix_len;
+}
+
+/**
+ * @brief Turn one table entry into a chunk pointer, pushing its leaf into the new chunk.
+ *
+ * @param fib FIB instance.
+ * @param table Table holding the entry.
+ * @param index Entry index within the table.
+ * @param chunk_out Destination for the chunk index.
+ * @return MAGI_OK on success, or MAGI_ERR_NOMEM.
+ */
+static int fib_split(Fib* fib, size_t table, size_t index, size_t* chunk_out) {
+  uint32_t entry = fib_table(fib, table)[index];
+  if ((entry & FIB_CHUNK_FLAG) != 0U) {
+    *chunk_out = entry & ~FIB_CHUNK_FLAG;
+    return MAGI_OK;
+  }
+
+  if (fib->chunk_count >= (size_t)FIB_CHUNK_FLAG) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
+  }
+
+  if (fib->chunk_count == fib->chunk_cap) {
+    size_t new_cap = fib->chunk_cap == 0U ? 16U : fib->chunk_cap * 2U;
+    uint32_t* chunks = realloc(fib->chunks, new_cap * FIB_CHUNK_SIZE * sizeof(*chunks));
+    if (chunks == NULL) {
+      magi_errno = MAGI_ERR_NOMEM;
+      return MAGI_ERR_NOMEM;
+    }
+    fib->chunks = chunks;
+    fib->chunk_cap = new_cap;
+  }
+
+  size_t chunk = fib->chunk_count++;
+  uint32_t* entries = fib_table(fib, chunk);
+  for (size_t slot = 0U; slot < FIB_CHUNK_SIZE; ++slot) {
+    entries[slot] = entry;
+  }
+
+  fib_table(fib, table)[index] = FIB_CHUNK_FLAG | (uint32_t)chunk;
+  *chunk_out = chunk;
+  return MAGI_OK;
+}
+
+/**
+ * @brief Find the table range that a prefix expands to, splitting entries as needed.
+ *
+ * Prefixes up to /16 cover a range of the root table, /17-/24 a range of a
+ * second-level chunk, and /25-/32 a range of a third-level chunk.
+ *
+ * @param fib FIB instance.
+ * @param network Masked network address.
+ * @param prefix_len Prefix length.
+ * @param table_out Destination table.
+ * @param first_out Destination first entry index.
+ * @param count_out Destination entry count.
+ * @return MAGI_OK on success, or MAGI_ERR_NOMEM.
+ */
+static int fib_locate(Fib* fib, uint32_t network, int prefix_len, size_t* table_out,
+                      size_t* first_out, size_t* count_out) {
+  if (fib->root == NULL) {
+    fib->root = calloc(FIB_ROOT_SIZE, sizeof(*fib->root));
+    if (fib->root == NULL) {
+      magi_errno = MAGI_ERR_NOMEM;
+      return MAGI_ERR_NOMEM;
+    }
+  }
+
+  if (prefix_len <= 16) {
+    *table_out = FIB_TABLE_ROOT;
+    *first_out = network >> 16U;
+    *count_out = (size_t)1U << (16 - prefix_len);
+    return MAGI_OK;
+  }
+
+  size_t level2 = 0U;
+  int status = fib_split(fib, FIB_TABLE_ROOT, network >> 16U, &level2);
+  if (status != MAGI_OK) {
+    return status;
+  }
+
+  if (prefix_len <= 24) {
+    *table_out = level2;
+    *first_out = (network >> 8U) & 0xFFU;
+    *count_out = (size_t)1U << (24 - prefix_len);
+    return MAGI_OK;
+  }
+
+  size_t level3 = 0U;
+  status = fib_split(fib, level2, (network >> 8U) & 0xFFU, &level3);
+  if (status != MAGI_OK) {
+    return status;
+  }
+
+  *table_out = level3;
+  *first_out = network & 0xFFU;
+  *count_out = (size_t)1U << (32 - prefix_len);
+  return MAGI_OK;
+}
+
+/**
+ * @brief Install a leaf over a range wherever it is at least as specific as the current leaf.
+ *
+ * Recurses into chunks so that pushed-down copies of shorter prefixes are
+ * overridden as well.
+ *
+ * @param fib FIB instance.
+ * @param table Table to fill.
+ * @param first First entry index.
+ * @param count Number of entries.
+ * @param leaf Leaf value to install.
+ * @param prefix_len Prefix length of the installed route.
+ */
+static void fib_fill(Fib* fib, size_t table, size_t first, size_t count, uint32_t leaf,
+                     int prefix_len) {
+  uint32_t* entries = fib_table(fib, table);
+  for (size_t index = first; index < first + count; ++index) {
+    uint32_t entry = entries[index];
+    if ((entry & FIB_CHUNK_FLAG) != 0U) {
+      fib_fill(fib, entry & ~FIB_CHUNK_FLAG, 0U, FIB_CHUNK_SIZE, leaf, prefix_len);
+    } else if (fib_leaf_prefix(fib, entry) <= prefix_len) {
+      entries[index] = leaf;
+    }
+  }
+}
+
+/**
+ * @brief Replace every occurrence of one leaf with another over a range.
+ *
+ * @param fib FIB instance.
+ * @param table Table to rewrite.
+ * @param first First entry index.
+ * @param count Number of entries.
+ * @param old_leaf Leaf being withdrawn.
+ * @param new_leaf Fallback leaf (may be FIB_LEAF_EMPTY).
+ */
+static void fib_replace(Fib* fib, size_t table, size_t first, size_t count, uint32_t old_leaf,
+                        uint32_t new_leaf) {
+  uint32_t* entries = fib_table(fib, table);
+  for (size_t index = first; index < first + count; ++index) {
+    uint32_t entry = entries[index];
+    if ((entry & FIB_CHUNK_FLAG) != 0U) {
+      fib_replace(fib, entry & ~FIB_CHUNK_FLAG, 0U, FIB_CHUNK_SIZE, old_leaf, new_leaf);
+    } else if (entry == old_leaf) {
+      entries[index] = new_leaf;
+    }
+  }
+}
+
+/**
+ * @brief Take a free route slot, growing the slot arrays if needed.
+ *
+ * @param fib FIB instance.
+ * @param id_out Destination slot index.
+ * @return MAGI_OK on success, or MAGI_ERR_NOMEM.
+ */
+static int fib_alloc_slot(Fib* fib, uint32_t* id_out) {
+  if (fib->free_count > 0U) {
+    *id_out = fib->free_slots[--fib->free_count];
+    return MAGI_OK;
+  }
+
+  if (fib->slot_count == fib->slot_cap) {
+    size_t new_cap = fib->slot_cap == 0U ? 16U : fib->slot_cap * 2U;
+    if (new_cap >= (size_t)FIB_CHUNK_FLAG) {
+      magi_errno = MAGI_ERR_NOMEM;
+      return MAGI_ERR_NOMEM;
+    }
+
+    FibSlot* slots = realloc(fib->slots, new_cap * sizeof(*slots));
+    if (slots == NULL) {
+      magi_errno = MAGI_ERR_NOMEM;
+      return MAGI_ERR_NOMEM;
+    }
+    fib->slots = slots;
+
+    uint32_t* free_slots = realloc(fib->free_slots, new_cap * sizeof(*free_slots));
+    if (free_slots == NULL) {
+      magi_errno = MAGI_ERR_NOMEM;
+      return MAGI_ERR_NOMEM;
+    }
+    fib->free_slots = free_slots;
+    fib->slot_cap = new_cap;
+  }
+
+  *id_out = (uint32_t)fib->slot_count++;
+  return MAGI_OK;
+}
+
+/**
+ * @brief Store a route in its slot with the network masked to the prefix.
+ *
+ * @param slot Destination slot.
+ * @param route Route as given by the caller; its host bits are dropped.
+ * @param network Masked network in host order.
+ * @param origin Route origin tag.
+ */
+static void fib_store_route(FibSlot* slot, const RoutingTableEntry* route, uint32_t network,
+                            uint8_t origin) {
+  slot->route = *route;
+  slot->route.network[0] = (uint8_t)(network >> 24U);
+  slot->route.network[1] = (uint8_t)(network >> 16U);
+  slot->route.network[2] = (uint8_t)(network >> 8U);
+  slot->route.network[3] = (uint8_t)network;
+  slot->origin = origin;
+}
+
+Fib* fib_new(void) {
+  Fib* fib = calloc(1U, sizeof(*fib));
+  if (fib == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+
+  fib->index_cap = FIB_INDEX_MIN_CAP;
+  fib->index = malloc(fib->index_cap * sizeof(*fib->index));
+  if (fib->index == NULL) {
+    free(fib);
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+
+  memset(fib->index, 0xFF, fib->index_cap * sizeof(*fib->index));
+  return fib;
+}
+
+void fib_free(Fib* fib) {
+  if (fib == NULL) {
+    return;
+  }
+
+  free(fib->root);
+  free(fib->chunks);
+  free(fib->slots);
+  free(fib->free_slots);
+  free(fib->index);
+  free(fib);
+}
+
+int fib_insert(Fib* fib, const RoutingTableEntry* route, uint8_t origin) {
+  if (fib == NULL || route == NULL || route->prefix_len < 0 || route->prefix_len > 32) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  uint32_t network = fib_addr_u32(route->network) & fib_prefix_mask(route->prefix_len);
+  size_t pos = fib_index_probe(fib, network, route->prefix_len);
+  if (fib->index[pos] != FIB_INDEX_EMPTY) {
+    fib_store_route(&fib->slots[fib->index[pos]], route, network, origin);
+    return MAGI_OK;
+  }
+
+  if ((fib->live + 1U) * 10U > fib->index_cap * 7U) {
+    int status = fib_index_grow(fib);
+    if (status != MAGI_OK) {
+      return status;
+    }
+  }
+
+  size_t table = 0U;
+  size_t first = 0U;
+  size_t count = 0U;
+  int status = fib_locate(fib, network, route->prefix_len, &table, &first, &count);
+  if (status != MAGI_OK) {
+    return status;
+  }
+
+  uint32_t id = 0U;
+  status = fib_alloc_slot(fib, &id);
+  if (status != MAGI_OK) {
+    return status;
+  }
+
+  FibSlot* slot = &fib->slots[id];
+  fib_store_route(slot, route, network, origin);
+  slot->used = true;
+
+  fib->index[fib_index_probe(fib, network, route->prefix_len)] = id;
+  fib->live++;
+  fib_fill(fib, table, first, count, id + 1U, route->prefix_len);
+  return MAGI_OK;
+}
+
+int fib_remove(Fib* fib, const uint8_t network[4], int prefix_len) {
+  if (fib == NULL || network == NULL || prefix_len < 0 || prefix_len > 32) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  uint32_t masked = fib_addr_u32(network) & fib_prefix_mask(prefix_len);
+  size_t pos = fib_index_probe(fib, masked, prefix_len);
+  uint32_t id = fib->index[pos];
+  if (id == FIB_INDEX_EMPTY) {
+    magi_errno = MAGI_ERR_NOROUTE;
+    return MAGI_ERR_NOROUTE;
+  }
+
+  uint32_t replacement = FIB_LEAF_EMPTY;
+  for (int len = prefix_len - 1; len >= 0; --len) {
+    uint32_t candidate = fib->index[fib_index_probe(fib, masked & fib_prefix_mask(len), len)];
+    if (candidate != FIB_INDEX_EMPTY) {
+      replacement = candidate + 1U;
+      break;
+    }
+  }
+
+  size_t table = 0U;
+  size_t first = 0U;
+  size_t count = 0U;
+  int status = fib_locate(fib, masked, prefix_len, &table, &first, &count);
+  if (status != MAGI_OK) {
+    return status;
+  }
+
+  fib_replace(fib, table, first, count, id + 1U, replacement);
+  fib_index_delete(fib, pos);
+  fib->slots[id].used = false;
+  fib->free_slots[fib->free_count++] = id;
+  fib->live--;
+  return MAGI_OK;
+}
+
+const RoutingTableEntry* fib_find(const Fib* fib, const uint8_t network[4], int prefix_len,
+                                  uint8_t* origin_out) {
+  if (fib == NULL || network == NULL || prefix_len < 0 || prefix_len > 32) {
+    return NULL;
+  }
+
+  uint32_t masked = fib_addr_u32(network) & fib_prefix_mask(prefix_len);
+  uint32_t id = fib->index[fib_index_probe(fib, masked, prefix_len)];
+  if (id == FIB_INDEX_EMPTY) {
+    return NULL;
+  }
+
+  if (origin_out != NULL) {
+    *origin_out = fib->slots[id].origin;
+  }
+  return &fib->slots[id].route;
+}
+
+const RoutingTableEntry* fib_lookup(const Fib* fib, const uint8_t dst_ip[4]) {
+  if (fib == NULL || dst_ip == NULL || fib->root == NULL) {
+    return NULL;
+  }
+
+  uint32_t entry = fib->root[((uint32_t)dst_ip[0] << 8U) | (uint32_t)dst_ip[1]];
+  if ((entry & FIB_CHUNK_FLAG) != 0U) {
+    entry = fib->chunks[(size_t)(entry & ~FIB_CHUNK_FLAG) * FIB_CHUNK_SIZE + dst_ip[2]];
+    if ((entry & FIB_CHUNK_FLAG) != 0U) {
+      entry = fib->chunks[(size_t)(entry & ~FIB_CHUNK_FLAG) * FIB_CHUNK_SIZE + dst_ip[3]];
+    }
+  }
+
+  return entry == FIB_LEAF_EMPTY ? NULL : &fib->slots[entry - 1U].route;
+}
+
+void fib_foreach(const Fib* fib, fib_visitor_fn fn, void* ctx) {
+  if (fib == NULL || fn == NULL) {
+    return;
+  }
+
+  for (size_t id = 0U; id < fib->slot_count; ++id) {
+    if (fib->slots[id].used) {
+      fn(&fib->slots[id].route, fib->slots[id].origin, ctx);
+    }
+  }
+}
+
+size_t fib_count(const Fib* fib) {
+  return fib != NULL ? fib->live : 0U;
+}
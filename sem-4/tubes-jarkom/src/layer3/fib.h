@@ -0,0 +1,107 @@
+/**
+ * @file fib.h
+ * @brief Compiled forwarding table (DIR-16-8-8 multibit trie) for router LPM lookups.
+ *
+ * Prefixes are expanded into a 65536-entry root table indexed by the top 16
+ * address bits, with 256-entry chunks for the third and fourth octets. A
+ * lookup touches at most three table entries regardless of table size.
+ */
+
+#ifndef MAGI_LAYER3_FIB_H
+#define MAGI_LAYER3_FIB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "layer3/router.h"
+
+/** Route installed by router_add_route (static or RIP-learned). */
+#define FIB_ORIGIN_STATIC 0U
+/** Route derived from a router interface address. */
+#define FIB_ORIGIN_CONNECTED 1U
+
+/** @brief Opaque compiled forwarding table. */
+typedef struct Fib Fib;
+
+typedef void (*fib_visitor_fn)(const RoutingTableEntry* route, uint8_t origin, void* ctx);
+
+/**
+ * @brief Create an empty forwarding table.
+ *
+ * The 256 KB root table is allocated lazily on the first insert.
+ *
+ * @return FIB instance, or NULL on failure.
+ */
+Fib* fib_new(void);
+
+/**
+ * @brief Destroy a forwarding table and all owned storage.
+ *
+ * @param fib FIB to free. NULL is allowed.
+ */
+void fib_free(Fib* fib);
+
+/**
+ * @brief Insert a prefix, replacing any entry with the same network/prefix length.
+ *
+ * @param fib FIB instance.
+ * @param route Route to copy into the table; network must already be masked.
+ * @param origin FIB_ORIGIN_STATIC or FIB_ORIGIN_CONNECTED.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int fib_insert(Fib* fib, const RoutingTableEntry* route, uint8_t origin);
+
+/**
+ * @brief Remove the entry for an exact network/prefix length.
+ *
+ * Addresses covered by the removed prefix fall back to the next shorter
+ * covering prefix, if any.
+ *
+ * @param fib FIB instance.
+ * @param network Masked network address.
+ * @param prefix_len Prefix length (0-32).
+ * @return MAGI_OK on success, MAGI_ERR_NOROUTE if absent.
+ */
+int fib_remove(Fib* fib, const uint8_t network[4], int prefix_len);
+
+/**
+ * @brief Find the entry for an exact network/prefix length.
+ *
+ * @param fib FIB instance.
+ * @param network Masked network address.
+ * @param prefix_len Prefix length (0-32).
+ * @param origin_out Optional destination for the entry origin.
+ * @return Matching route, or NULL if absent.
+ */
+const RoutingTableEntry* fib_find(const Fib* fib, const uint8_t network[4], int prefix_len,
+                                  uint8_t* origin_out);
+
+/**
+ * @brief Longest-prefix-match lookup.
+ *
+ * The returned pointer stays valid until the next insert or remove.
+ *
+ * @param fib FIB instance.
+ * @param dst_ip Destination address.
+ * @return Best matching route, or NULL if no prefix covers dst_ip.
+ */
+const RoutingTableEntry* fib_lookup(const Fib* fib, const uint8_t dst_ip[4]);
+
+/**
+ * @brief Visit every installed prefix in unspecified order.
+ *
+ * @param fib FIB instance.
+ * @param fn Visitor callback.
+ * @param ctx Opaque callback context.
+ */
+void fib_foreach(const Fib* fib, fib_visitor_fn fn, void* ctx);
+
+/**
+ * @brief Number of installed prefixes.
+ *
+ * @param fib FIB instance.
+ * @return Prefix count, or 0 for NULL.
+ */
+size_t fib_count(const Fib* fib);
+
+#endif
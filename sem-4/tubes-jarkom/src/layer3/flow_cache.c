@@ -0,0 +1,160 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "flow_cache.h"
+
+#include "utils/magi_error.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FLOW_CACHE_WAYS 2U
+#define FLOW_CACHE_MIN_SLOTS 16U
+
+/** @brief One cached flow. gen 0 never matches, so calloc'd slots start empty. */
+typedef struct FlowEntry {
+  FlowKey key;
+  uint32_t gen;
+  FlowAction action;
+} FlowEntry;
+
+struct FlowCache {
+  FlowEntry* slots;
+  size_t mask;
+  uint32_t gen;
+};
+
+/**
+ * @brief Hash a flow key. The addresses are mixed before the ports go in,
+ * so an address cannot cancel against a port.
+ *
+ * @param key Flow identity.
+ * @return 64-bit hash.
+ */
+static uint64_t flow_hash(const FlowKey* key) {
+  uint64_t hash = key->addrs * 0x9E3779B97F4A7C15ULL;
+  hash ^= ((uint64_t)key->protocol << 56U) | ((uint64_t)key->vlan_id << 44U) |
+          ((uint64_t)key->in_port << 32U) | key->ports;
+  hash *= 0x9E3779B97F4A7C15ULL;
+  return hash ^ (hash >> 29U);
+}
+
+/**
+ * @brief Compare two flow keys field by field (the struct has padding).
+ *
+ * @param lhs First key.
+ * @param rhs Second key.
+ * @return true if both name the same flow.
+ */
+static bool flow_key_equal(const FlowKey* lhs, const FlowKey* rhs) {
+  return lhs->addrs == rhs->addrs && lhs->ports == rhs->ports && lhs->in_port == rhs->in_port &&
+         lhs->vlan_id == rhs->vlan_id && lhs->protocol == rhs->protocol;
+}
+
+/**
+ * @brief First slot of the set a key belongs to.
+ *
+ * @param cache Flow cache.
+ * @param hash Key hash from flow_hash().
+ * @return Index of way 0; way 1 follows it.
+ */
+static size_t flow_set(const FlowCache* cache, uint64_t hash) {
+  return (size_t)hash & cache->mask & ~(size_t)(FLOW_CACHE_WAYS - 1U);
+}
+
+FlowCache* flow_cache_new(size_t slots) {
+  FlowCache* cache = calloc(1U, sizeof(*cache));
+  if (cache == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+
+  size_t capacity = FLOW_CACHE_MIN_SLOTS;
+  while (capacity < slots) {
+    capacity *= 2U;
+  }
+
+  cache->slots = calloc(capacity, sizeof(*cache->slots));
+  if (cache->slots == NULL) {
+    free(cache);
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+
+  cache->mask = capacity - 1U;
+  cache->gen = 1U;
+  return cache;
+}
+
+void flow_cache_free(FlowCache* cache) {
+  if (cache == NULL) {
+    return;
+  }
+
+  free(cache->slots);
+  free(cache);
+}
+
+const FlowAction* flow_cache_lookup(const FlowCache* cache, const FlowKey* key, uint64_t now_ms) {
+  if (cache == NULL || key == NULL) {
+    return NULL;
+  }
+
+  const FlowEntry* set = &cache->slots[flow_set(cache, flow_hash(key))];
+  for (size_t way = 0U; way < FLOW_CACHE_WAYS; ++way) {
+    const FlowEntry* entry = &set[way];
+    if (entry->gen == cache->gen && flow_key_equal(&entry->key, key)) {
+      return now_ms < entry->action.expires_ms ? &entry->action : NULL;
+    }
+  }
+
+  return NULL;
+}
+
+void flow_cache_insert(FlowCache* cache, const FlowKey* key, const FlowAction* action) {
+  if (cache == NULL || key == NULL || action == NULL) {
+    return;
+  }
+
+  uint64_t hash = flow_hash(key);
+  FlowEntry* set = &cache->slots[flow_set(cache, hash)];
+  FlowEntry* victim = NULL;
+  for (size_t way = 0U; way < FLOW_CACHE_WAYS; ++way) {
+    if (set[way].gen == cache->gen && flow_key_equal(&set[way].key, key)) {
+      victim = &set[way];
+      break;
+    }
+    if (victim == NULL && set[way].gen != cache->gen) {
+      victim = &set[way];
+    }
+  }
+  if (victim == NULL) {
+    /* Both ways are live: let a hash bit the set index does not use decide. */
+    victim = &set[(hash >> 40U) & (FLOW_CACHE_WAYS - 1U)];
+  }
+
+  victim->key = *key;
+  victim->gen = cache->gen;
+  victim->action = *action;
+}
+
+void flow_cache_invalidate(FlowCache* cache) {
+  if (cache == NULL) {
+    return;
+  }
+
+  cache->gen++;
+  if (cache->gen == 0U) {
+    /* Wrapped: entries from four billion generations ago would match again. */
+    memset(cache->slots, 0, (cache->mask + 1U) * sizeof(*cache->slots));
+    cache->gen = 1U;
+  }
+}
+
+uint32_t flow_cache_generation(const FlowCache* cache) {
+  return cache != NULL ? cache->gen : 0U;
+}
+
+size_t flow_cache_slots(const FlowCache* cache) {
+  return cache != NULL ? cache->mask + 1U : 0U;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file flow_cache.h
+ * @brief Exact-match flow cache in front of the router's LPM and ARP lookups.
+ *
+ * Forwarding decisions are cached per flow, keyed by ingress port, VLAN
+ * and 5-tuple. A hit hands back the egress interface, next hop and next-hop
+ * MAC in one probe, so long-lived flows skip the FIB walk and the neighbor
+ * table. The cache is two-way set associative: a new flow takes a free or
+ * stale way of its set, else evicts the way its hash picks.
+ *
+ * Entries are never searched for and removed one by one. Each carries the
+ * generation it was inserted under, and flow_cache_invalidate() bumps the
+ * generation, so any route, neighbor or interface change drops the whole
+ * cache in O(1). Entries also carry the time the next-hop MAC stops being
+ * valid, so a busy flow cannot keep a neighbor alive past its aging.
+ */
+
+#ifndef MAGI_LAYER3_FLOW_CACHE_H
+#define MAGI_LAYER3_FLOW_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct Interface;
+
+/** @brief Flow identity. Ports are 0 unless the packet carries a TCP/UDP header. */
+typedef struct FlowKey {
+  /** Source address in the high half, destination in the low, host order. */
+  uint64_t addrs;
+  /** Source port in the high half, destination port in the low. */
+  uint32_t ports;
+  uint16_t in_port;
+  uint16_t vlan_id;
+  uint8_t protocol;
+} FlowKey;
+
+/** @brief Cached forwarding decision. */
+typedef struct FlowAction {
+  /** Egress interface; only valid while the router's interfaces are unchanged. */
+  struct Interface* egress;
+  uint8_t next_hop[4];
+  uint8_t dst_mac[6];
+  /** Time the next-hop MAC would age out of the neighbor table. */
+  uint64_t expires_ms;
+} FlowAction;
+
+/** @brief Opaque flow cache. */
+typedef struct FlowCache FlowCache;
+
+/**
+ * @brief Create an empty flow cache.
+ *
+ * @param slots Minimum number of entries; rounded up to a power of two.
+ * @return Cache instance, or NULL on failure.
+ */
+FlowCache* flow_cache_new(size_t slots);
+
+/**
+ * @brief Destroy a flow cache.
+ *
+ * @param cache Cache to free. NULL is allowed.
+ */
+void flow_cache_free(FlowCache* cache);
+
+/**
+ * @brief Find the action for a flow.
+ *
+ * @param cache Flow cache.
+ * @param key Flow identity.
+ * @param now_ms Current time; entries past expires_ms miss.
+ * @return Cached action, or NULL on a miss. Valid until the next insert or invalidate.
+ */
+const FlowAction* flow_cache_lookup(const FlowCache* cache, const FlowKey* key, uint64_t now_ms);
+
+/**
+ * @brief Cache the action for a flow, replacing any older entry for it.
+ *
+ * @param cache Flow cache.
+ * @param key Flow identity.
+ * @param action Forwarding decision to copy.
+ */
+void flow_cache_insert(FlowCache* cache, const FlowKey* key, const FlowAction* action);
+
+/**
+ * @brief Drop every entry.
+ *
+ * @param cache Flow cache. NULL is allowed.
+ */
+void flow_cache_invalidate(FlowCache* cache);
+
+/**
+ * @brief Current generation, which changes on every flow_cache_invalidate().
+ *
+ * A caller holding a copy of an action can compare generations to tell
+ * whether the cache was dropped since it looked the action up.
+ *
+ * @param cache Flow cache.
+ * @return Generation, or 0 for NULL.
+ */
+uint32_t flow_cache_generation(const FlowCache* cache);
+
+/**
+ * @brief Number of entries the cache can hold.
+ *
+ * @param cache Flow cache.
+ * @return Slot count, or 0 for NULL.
+ */
+size_t flow_cache_slots(const FlowCache* cache);
+
+#endif
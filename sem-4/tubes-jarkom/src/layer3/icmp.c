@@ -21,21 +21,23 @@ int icmp_pack(ICMPMessage* msg, uint8_t* out, size_t out_len) {
     return MAGI_ERR_BADARGS;
   }
 
-  memset(out, 0, total_len);
+  memset(out, 0, ICMP_HEADER_LEN);
   WRITE_U8(out, 0U, msg->type);
   WRITE_U8(out, 1U, msg->code);
   WRITE_U16(out, 2U, 0U);
 
-  if (msg->type == ICMP_TYPE_ECHO_REQUEST || msg->type == ICMP_TYPE_ECHO_REPLY) {
+  if (msg->type == ICMP_TYPE_ECHO_REQUEST || msg->type == ICMP_TYPE_ECHO_REPLY ||
+      (msg->type == ICMP_TYPE_DEST_UNREACHABLE && msg->code == ICMP_CODE_FRAG_NEEDED)) {
     WRITE_U16(out, 4U, msg->identifier);
     WRITE_U16(out, 6U, msg->sequence);
   }
 
+  uint32_t sum = checksum_partial(0U, out, ICMP_HEADER_LEN);
   if (msg->payload_len > 0U) {
-    memcpy(out + ICMP_HEADER_LEN, msg->payload, msg->payload_len);
+    sum = checksum_copy_partial(sum, out + ICMP_HEADER_LEN, msg->payload, msg->payload_len);
   }
 
-  msg->checksum = ipv4_checksum(out, total_len);
+  msg->checksum = checksum_finish(sum);
   WRITE_U16(out, 2U, msg->checksum);
   return MAGI_OK;
 }
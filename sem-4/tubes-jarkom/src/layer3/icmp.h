@@ -15,8 +15,14 @@
 #define ICMP_TYPE_DEST_UNREACHABLE 3U
 #define ICMP_TYPE_ECHO_REQUEST 8U
 #define ICMP_TYPE_TIME_EXCEEDED 11U
+/** Destination Unreachable code: fragmentation needed and DF set. */
+#define ICMP_CODE_FRAG_NEEDED 4U
 #define ICMP_HEADER_LEN 8U
 
+/**
+ * @brief ICMP message. For Fragmentation Needed, sequence carries the
+ *        next-hop MTU (RFC 1191).
+ */
 typedef struct ICMPMessage {
   Packet base;
   uint8_t type;
@@ -1,9 +1,13 @@
 #define _POSIX_C_SOURCE 200809L
+#define MAGI_LOG_SUBSYS MAGI_LOG_L3
 
 #include "ipv4.h"
 
 #include "core/interface.h"
+#include "core/pktbuf.h"
+#include "core/sim.h"
 #include "layer3/icmp.h"
+#include "layer3/ipv4_frag.h"
 #include "utils/byteops.h"
 #include "utils/log.h"
 #include "utils/magi_error.h"
@@ -12,7 +16,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
 typedef struct HostIPv4State {
   uint16_t next_id;
@@ -21,14 +24,20 @@ typedef struct HostIPv4State {
   uint16_t pending_seq;
   uint16_t pending_id;
   uint8_t pending_target[4];
-  struct timespec sent_at;
+  uint64_t sent_at_ns;
   bool awaiting;
   bool trace_mode;
   bool trace_done;
   bool trace_reached;
   uint8_t trace_ttl;
+  Ipv4Reasm* reasm;
 } HostIPv4State;
 
+typedef struct HostFragmentCtx {
+  Node* node;
+  const uint8_t* next_hop;
+} HostFragmentCtx;
+
 /**
  * @brief Convert a 4-byte IPv4 address to a 32-bit integer (host byte order).
  *
@@ -117,24 +126,21 @@ static const HostIPv4State* host_ipv4_state_const(const Node* node) {
 /**
  * @brief Find the first interface that has an IPv4 address configured.
  *
- * Iterates the node's interface hashmap and returns the first interface
+ * Walks the node's interfaces in port order and returns the first one
  * whose ip_address field is non-empty.
  *
  * @param node The node to search.
  * @return Pointer to the first configured Interface, or NULL.
  */
 static Interface* first_ipv4_interface(Node* node) {
-  if (node == NULL || node->interfaces == NULL) {
+  if (node == NULL) {
     return NULL;
   }
 
-  for (size_t index = 0U; index < node->interfaces->capacity; ++index) {
-    HashEntry* entry = &node->interfaces->entries[index];
-    if (entry->key != NULL && !entry->tombstone) {
-      Interface* iface = entry->value;
-      if (iface != NULL && iface->ip_address[0] != '\0') {
-        return iface;
-      }
+  for (size_t index = 0U; index < node->iface_count; ++index) {
+    Interface* iface = node->iface_list[index];
+    if (iface->ip_address[0] != '\0') {
+      return iface;
     }
   }
 
@@ -171,13 +177,12 @@ static bool interface_has_ip(const Interface* iface, const uint8_t ip[4]) {
  * @return true if any interface has the given IP.
  */
 static bool node_has_ip(const Node* node, const uint8_t ip[4]) {
-  if (node == NULL || node->interfaces == NULL || ip == NULL) {
+  if (node == NULL || ip == NULL) {
     return false;
   }
 
-  for (size_t index = 0U; index < node->interfaces->capacity; ++index) {
-    const HashEntry* entry = &node->interfaces->entries[index];
-    if (entry->key != NULL && !entry->tombstone && interface_has_ip(entry->value, ip)) {
+  for (size_t index = 0U; index < node->iface_count; ++index) {
+    if (interface_has_ip(node->iface_list[index], ip)) {
       return true;
     }
   }
@@ -186,27 +191,14 @@ static bool node_has_ip(const Node* node, const uint8_t ip[4]) {
 }
 
 /**
- * @brief Compute elapsed time in milliseconds since a given timestamp.
- *
- * Uses CLOCK_MONOTONIC. Returns 0.0 on error or if start is NULL.
+ * @brief Compute elapsed simulation time in milliseconds since a given timestamp.
  *
- * @param start The reference timestamp.
+ * @param start_ns The reference time from sim_now_ns().
  * @return Elapsed time in milliseconds.
  */
-static double elapsed_ms_since(const struct timespec* start) {
-  struct timespec now;
-  if (start == NULL || clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
-    return 0.0;
-  }
-
-  time_t sec = now.tv_sec - start->tv_sec;
-  long nsec = now.tv_nsec - start->tv_nsec;
-  if (nsec < 0) {
-    --sec;
-    nsec += 1000000000L;
-  }
-
-  return ((double)sec * 1000.0) + ((double)nsec / 1000000.0);
+static double elapsed_ms_since(uint64_t start_ns) {
+  uint64_t now = sim_now_ns();
+  return now > start_ns ? (double)(now - start_ns) / (double)SIM_NS_PER_MS : 0.0;
 }
 
 /**
@@ -236,7 +228,7 @@ static void start_pending(HostIPv4State* state, const uint8_t target_ip[4], uint
   state->trace_done = false;
   state->trace_reached = false;
   state->trace_ttl = ttl;
-  (void)clock_gettime(CLOCK_MONOTONIC, &state->sent_at);
+  state->sent_at_ns = sim_now_ns();
 }
 
 /**
@@ -251,6 +243,29 @@ static bool pending_matches(const HostIPv4State* state, uint16_t id, uint16_t se
   return state != NULL && state->awaiting && state->pending_id == id && state->pending_seq == seq;
 }
 
+/**
+ * @brief sim_run_until_cond() predicate: the pending probe has been answered.
+ *
+ * @param ctx The per-host IPv4 state.
+ * @return true once no probe is awaiting a reply.
+ */
+static bool probe_answered(const void* ctx) {
+  return !((const HostIPv4State*)ctx)->awaiting;
+}
+
+/**
+ * @brief Run the simulation until the pending probe is answered or times out.
+ *
+ * Replies travel over delayed links as clock events, so a probe is only
+ * answered after its round trip has been simulated. Async builds deliver
+ * on worker threads and return immediately.
+ *
+ * @param state The per-host IPv4 state.
+ */
+static void wait_for_probe(const HostIPv4State* state) {
+  (void)sim_run_until_cond(probe_answered, state, IPV4_PROBE_TIMEOUT_MS * SIM_NS_PER_MS);
+}
+
 /**
  * @brief Determine the next-hop IP address for a given destination.
  *
@@ -260,11 +275,11 @@ static bool pending_matches(const HostIPv4State* state, uint16_t id, uint16_t se
  * @param node   The sending node.
  * @param iface  The egress interface.
  * @param dst_ip The destination IPv4 address.
- * @param out    Buffer (size 16) to write the next-hop IP string.
+ * @param out    Destination for the 4-byte next-hop address.
  * @return MAGI_OK on success, or an error code.
  */
 static int choose_next_hop(const Node* node, const Interface* iface, const uint8_t dst_ip[4],
-                           char out[16]) {
+                           uint8_t out[4]) {
   uint8_t iface_ip[4];
   uint8_t network[4];
   uint8_t mask[4];
@@ -282,7 +297,7 @@ static int choose_next_hop(const Node* node, const Interface* iface, const uint8
   }
 
   if (ipv4_addr_in_network(dst_ip, network, mask)) {
-    ipv4_address_to_string(dst_ip, out);
+    memcpy(out, dst_ip, 4U);
     return MAGI_OK;
   }
 
@@ -291,33 +306,102 @@ static int choose_next_hop(const Node* node, const Interface* iface, const uint8
     return MAGI_ERR_NOROUTE;
   }
 
-  uint8_t gateway_ip[4];
-  status = ipv4_parse_address(node->default_gateway, gateway_ip);
-  if (status != MAGI_OK) {
-    return status;
+  return ipv4_parse_address(node->default_gateway, out);
+}
+
+/**
+ * @brief Hand one IPv4 datagram or fragment to L2.
+ *
+ * Nodes without a zero-copy L2 hook fall back to the legacy send_l3_packet
+ * callback. The buffer is consumed on every path.
+ *
+ * @param pkt Buffer starting at the IPv4 header.
+ * @param ctx HostFragmentCtx naming the node and next hop.
+ * @return MAGI_OK on success, or an error code.
+ */
+static int host_emit(PktBuf* pkt, void* ctx) {
+  const HostFragmentCtx* emit = ctx;
+  Node* node = emit->node;
+  if (node->send_l3_pkt != NULL) {
+    return node->send_l3_pkt(node, emit->next_hop, IPV4_ETHERTYPE, pkt);
   }
 
-  ipv4_address_to_string(gateway_ip, out);
-  return MAGI_OK;
+  char next_hop_text[16];
+  ipv4_address_to_string(emit->next_hop, next_hop_text);
+  int status = node->send_l3_packet(node, next_hop_text, IPV4_ETHERTYPE, pkt->data, pkt->len);
+  pktbuf_release(pkt);
+  return status;
+}
+
+/**
+ * @brief Prepend an IPv4 header to a packet buffer and hand it to L2.
+ *
+ * The header is written into the buffer's headroom, so the L4 payload is
+ * not copied unless the datagram exceeds the egress link MTU and has to be
+ * fragmented. The buffer is consumed on every path.
+ *
+ * @param node     The sending node.
+ * @param iface    The egress interface (its link MTU bounds the datagram).
+ * @param state    The per-host IPv4 state (for the identification field).
+ * @param src_ip   Source IPv4 address.
+ * @param dst_ip   Destination IPv4 address.
+ * @param protocol IP protocol number.
+ * @param ttl      IP time-to-live.
+ * @param flags    IPv4 flags (IPV4_FLAG_DF or 0).
+ * @param next_hop Next-hop IPv4 address.
+ * @param pkt      Buffer holding the IPv4 payload.
+ * @return MAGI_OK on success, MAGI_ERR_MSGSIZE if DF forbids fragmenting,
+ *         or an error code.
+ */
+static int host_output_pkt(Node* node, const Interface* iface, HostIPv4State* state,
+                           const uint8_t src_ip[4], const uint8_t dst_ip[4], uint8_t protocol,
+                           uint8_t ttl, uint16_t flags, const uint8_t next_hop[4], PktBuf* pkt) {
+  IPv4Packet hdr = {0};
+  hdr.version_ihl = IPV4_VERSION_IHL;
+  hdr.identification = state->next_id++;
+  hdr.flags_frag_off = flags;
+  hdr.ttl = ttl;
+  hdr.protocol = protocol;
+  memcpy(hdr.src_ip, src_ip, 4U);
+  memcpy(hdr.dst_ip, dst_ip, 4U);
+  hdr.payload_len = pkt->len;
+
+  uint8_t* out = pktbuf_push(pkt, IPV4_HEADER_LEN);
+  if (out == NULL || ipv4_pack_header(&hdr, out, IPV4_HEADER_LEN) != MAGI_OK) {
+    pktbuf_release(pkt);
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  HostFragmentCtx emit = {.node = node, .next_hop = next_hop};
+  uint16_t mtu = interface_mtu(iface);
+  int status = ipv4_fragment(pkt, mtu, host_emit, &emit);
+  if (status == MAGI_ERR_MSGSIZE) {
+    LOG(node->name, "Cannot send %u-byte IPv4 packet with DF set: link MTU is %u",
+        (unsigned)hdr.total_len, (unsigned)mtu);
+  }
+  return status;
 }
 
 /**
  * @brief Build and send an IPv4 packet from a host.
  *
- * Constructs an IPv4 header using the interface's source IP, resolves a
- * next hop, serialises the packet, and passes it to the L2 send callback.
+ * Uses the interface's source IP, resolves a next hop, copies the payload
+ * once into a packet buffer and passes it down via host_output_pkt.
  *
  * @param node        The sending node.
  * @param iface       The egress interface.
  * @param dst_ip      The destination IPv4 address.
  * @param ttl         The IP time-to-live.
  * @param protocol    The IP protocol number (1=ICMP, 6=TCP, 17=UDP).
+ * @param flags       IPv4 flags (IPV4_FLAG_DF or 0).
  * @param payload     Pointer to the payload data.
  * @param payload_len Length of the payload.
  * @return MAGI_OK on success, or an error code.
  */
 static int host_send_ipv4(Node* node, Interface* iface, const uint8_t dst_ip[4], uint8_t ttl,
-                          uint8_t protocol, const uint8_t* payload, size_t payload_len) {
+                          uint8_t protocol, uint16_t flags, const uint8_t* payload,
+                          size_t payload_len) {
   HostIPv4State* state = host_ipv4_state(node);
   if (node == NULL || iface == NULL || dst_ip == NULL || (payload_len > 0U && payload == NULL) ||
       state == NULL || node->send_l3_packet == NULL) {
@@ -332,38 +416,26 @@ static int host_send_ipv4(Node* node, Interface* iface, const uint8_t dst_ip[4],
     return MAGI_ERR_BADARGS;
   }
 
-  IPv4Packet pkt = {0};
-  pkt.version_ihl = IPV4_VERSION_IHL;
-  pkt.identification = state->next_id++;
-  pkt.ttl = ttl;
-  pkt.protocol = protocol;
-  memcpy(pkt.src_ip, src_ip, 4U);
-  memcpy(pkt.dst_ip, dst_ip, 4U);
-  pkt.payload = payload;
-  pkt.payload_len = payload_len;
-
-  uint8_t* bytes = NULL;
-  size_t bytes_len = 0U;
-  int status = ipv4_packet_to_bytes(&pkt, &bytes, &bytes_len);
-  if (status != MAGI_OK) {
-    return status;
-  }
-
   char dst_text[16];
-  char next_hop[16];
+  uint8_t next_hop[4];
   ipv4_address_to_string(dst_ip, dst_text);
-  status = choose_next_hop(node, iface, dst_ip, next_hop);
+  int status = choose_next_hop(node, iface, dst_ip, next_hop);
   if (status != MAGI_OK) {
+    node_count(node, MAGI_NODE_DROP_NO_ROUTE);
     LOG(node->name, "No route to %s (default gateway is not configured)", dst_text);
-    free(bytes);
     return status;
   }
 
+  PktBuf* pkt = pktbuf_copy(PKTBUF_HEADROOM, payload, payload_len);
+  if (pkt == NULL) {
+    return MAGI_ERR_NOMEM;
+  }
+
+  char next_hop_text[16];
+  ipv4_address_to_string(next_hop, next_hop_text);
   LOG(node->name, "Send IPv4 dst=%s ttl=%u proto=%u via %s", dst_text, (unsigned)ttl,
-      (unsigned)protocol, next_hop);
-  status = node->send_l3_packet(node, next_hop, IPV4_ETHERTYPE, bytes, bytes_len);
-  free(bytes);
-  return status;
+      (unsigned)protocol, next_hop_text);
+  return host_output_pkt(node, iface, state, src_ip, dst_ip, protocol, ttl, flags, next_hop, pkt);
 }
 
 /**
@@ -379,13 +451,14 @@ static int host_send_ipv4(Node* node, Interface* iface, const uint8_t dst_ip[4],
  * @param type        ICMP type (Echo Request or Echo Reply).
  * @param id          ICMP identifier.
  * @param seq         ICMP sequence number.
+ * @param flags       IPv4 flags (IPV4_FLAG_DF or 0).
  * @param payload     Pointer to the ICMP payload data.
  * @param payload_len Length of the ICMP payload.
  * @return MAGI_OK on success, or an error code.
  */
 static int send_echo(Node* node, Interface* iface, const uint8_t dst_ip[4], uint8_t ttl,
-                     uint8_t type, uint16_t id, uint16_t seq, const uint8_t* payload,
-                     size_t payload_len) {
+                     uint8_t type, uint16_t id, uint16_t seq, uint16_t flags,
+                     const uint8_t* payload, size_t payload_len) {
   ICMPMessage msg = {0};
   msg.type = type;
   msg.code = 0U;
@@ -401,7 +474,8 @@ static int send_echo(Node* node, Interface* iface, const uint8_t dst_ip[4], uint
     return status;
   }
 
-  status = host_send_ipv4(node, iface, dst_ip, ttl, IPV4_PROTOCOL_ICMP, icmp_bytes, icmp_len);
+  status =
+      host_send_ipv4(node, iface, dst_ip, ttl, IPV4_PROTOCOL_ICMP, flags, icmp_bytes, icmp_len);
   free(icmp_bytes);
   return status;
 }
@@ -422,7 +496,7 @@ static void handle_echo_reply(Node* node, const IPv4Packet* pkt, const ICMPMessa
     return;
   }
 
-  double elapsed = elapsed_ms_since(&state->sent_at);
+  double elapsed = elapsed_ms_since(state->sent_at_ns);
   char src_text[16];
   ipv4_address_to_string(pkt->src_ip, src_text);
 
@@ -458,7 +532,9 @@ static bool embedded_echo_matches(const HostIPv4State* state, const ICMPMessage*
   const uint8_t* original_ip = msg->payload + 4U;
   uint8_t protocol = original_ip[9];
   uint16_t original_total_len = READ_U16(original_ip, 2U);
-  if (protocol != IPV4_PROTOCOL_ICMP || original_total_len < IPV4_HEADER_LEN + ICMP_HEADER_LEN) {
+  uint16_t original_offset = READ_U16(original_ip, 6U) & IPV4_FRAG_OFFSET_MASK;
+  if (protocol != IPV4_PROTOCOL_ICMP || original_total_len < IPV4_HEADER_LEN + ICMP_HEADER_LEN ||
+      original_offset != 0U) {
     return false;
   }
 
@@ -487,18 +563,25 @@ static void handle_icmp_error(Node* node, const IPv4Packet* pkt, const ICMPMessa
     return;
   }
 
-  double elapsed = elapsed_ms_since(&state->sent_at);
+  double elapsed = elapsed_ms_since(state->sent_at_ns);
   char src_text[16];
   ipv4_address_to_string(pkt->src_ip, src_text);
 
+  bool frag_needed =
+      msg->type == ICMP_TYPE_DEST_UNREACHABLE && msg->code == ICMP_CODE_FRAG_NEEDED;
   if (state->trace_mode) {
-    const char* suffix = msg->type == ICMP_TYPE_DEST_UNREACHABLE ? " !N" : "";
+    const char* suffix = frag_needed                                ? " !F"
+                         : msg->type == ICMP_TYPE_DEST_UNREACHABLE ? " !N"
+                                                                   : "";
     LOG(node->name, "traceroute %u %s %.3f ms%s", (unsigned)state->trace_ttl, src_text, elapsed,
         suffix);
     state->trace_done = msg->type == ICMP_TYPE_DEST_UNREACHABLE;
     state->trace_reached = false;
   } else if (msg->type == ICMP_TYPE_TIME_EXCEEDED) {
     LOG(node->name, "ping time exceeded from %s", src_text);
+  } else if (frag_needed) {
+    LOG(node->name, "ping fragmentation needed from %s: next-hop MTU %u", src_text,
+        (unsigned)msg->sequence);
   } else {
     LOG(node->name, "ping destination unreachable from %s", src_text);
   }
@@ -506,14 +589,63 @@ static void handle_icmp_error(Node* node, const IPv4Packet* pkt, const ICMPMessa
   state->awaiting = false;
 }
 
+/**
+ * @brief Dispatch a complete IPv4 datagram addressed to this host.
+ *
+ * Non-ICMP protocols are forwarded to the L4 handler if configured. ICMP
+ * messages are parsed further: Echo Requests generate an Echo Reply, Echo
+ * Replies are correlated against pending probes, and errors (Time
+ * Exceeded / Unreachable) are logged.
+ *
+ * @param node  The receiving node.
+ * @param iface The interface on which the packet arrived.
+ * @param pkt   The unpacked datagram.
+ */
+static void ipv4_host_deliver(Node* node, Interface* iface, const IPv4Packet* pkt) {
+  /* Non-ICMP protocol → dispatch to L4 handler if configured */
+  if (pkt->protocol != IPV4_PROTOCOL_ICMP) {
+    if (node->handle_l4_packet != NULL) {
+      node->handle_l4_packet(node, pkt->src_ip, pkt->dst_ip, pkt->protocol, pkt->payload,
+                             pkt->payload_len);
+      return;
+    }
+    LOG(node->name, "Drop IPv4 protocol %u: no handler", (unsigned)pkt->protocol);
+    return;
+  }
+
+  ICMPMessage msg = {0};
+  if (icmp_unpack(&msg, pkt->payload, pkt->payload_len) != MAGI_OK) {
+    node_count(node, MAGI_NODE_DROP_MALFORMED);
+    LOG(node->name, "Drop ICMP packet: bad checksum");
+    return;
+  }
+
+  char src_text[16];
+  ipv4_address_to_string(pkt->src_ip, src_text);
+
+  if (msg.type == ICMP_TYPE_ECHO_REQUEST) {
+    LOG(node->name, "ICMP echo request from %s seq=%u", src_text, (unsigned)msg.sequence);
+    (void)send_echo(node, iface, pkt->src_ip, IPV4_DEFAULT_TTL, ICMP_TYPE_ECHO_REPLY,
+                    msg.identifier, msg.sequence, 0U, msg.payload, msg.payload_len);
+    return;
+  }
+
+  if (msg.type == ICMP_TYPE_ECHO_REPLY) {
+    handle_echo_reply(node, pkt, &msg);
+    return;
+  }
+
+  if (msg.type == ICMP_TYPE_TIME_EXCEEDED || msg.type == ICMP_TYPE_DEST_UNREACHABLE) {
+    handle_icmp_error(node, pkt, &msg);
+  }
+}
+
 /**
  * @brief Entry point for IPv4 packet reception on a host node.
  *
- * Unpacks the IPv4 header, discards packets not destined for this host,
- * and dispatches by protocol number. Non-ICMP protocols are forwarded to
- * the L4 handler if configured. ICMP messages are parsed further: Echo
- * Requests generate an Echo Reply, Echo Replies are correlated against
- * pending probes, and errors (Time Exceeded / Unreachable) are logged.
+ * Unpacks the IPv4 header and discards packets not destined for this
+ * host. Fragments are held in the host's reassembly table until their
+ * datagram is complete; whole datagrams go to ipv4_host_deliver.
  *
  * @param node  The receiving node.
  * @param iface The interface on which the packet arrived.
@@ -528,6 +660,7 @@ static void ipv4_host_receive(Node* node, Interface* iface, const uint8_t* data,
   IPv4Packet pkt = {0};
   int status = ipv4_unpack(&pkt, data, len);
   if (status != MAGI_OK) {
+    node_count(node, MAGI_NODE_DROP_MALFORMED);
     LOG(node->name, "Drop IPv4 packet: bad header/checksum");
     return;
   }
@@ -536,41 +669,26 @@ static void ipv4_host_receive(Node* node, Interface* iface, const uint8_t* data,
     return;
   }
 
-  /* Non-ICMP protocol → dispatch to L4 handler if configured */
-  if (pkt.protocol != IPV4_PROTOCOL_ICMP) {
-    if (node->handle_l4_packet != NULL) {
-      node->handle_l4_packet(node, pkt.src_ip, pkt.dst_ip, pkt.protocol, pkt.payload,
-                             pkt.payload_len);
-      return;
-    }
-    LOG(node->name, "Drop IPv4 protocol %u: no handler", (unsigned)pkt.protocol);
-    return;
-  }
-
-  ICMPMessage msg = {0};
-  if (icmp_unpack(&msg, pkt.payload, pkt.payload_len) != MAGI_OK) {
-    LOG(node->name, "Drop ICMP packet: bad checksum");
+  HostIPv4State* state = host_ipv4_state(node);
+  if (!ipv4_is_fragment(&pkt) || state == NULL) {
+    ipv4_host_deliver(node, iface, &pkt);
     return;
   }
 
-  char src_text[16];
-  ipv4_address_to_string(pkt.src_ip, src_text);
-
-  if (msg.type == ICMP_TYPE_ECHO_REQUEST) {
-    LOG(node->name, "ICMP echo request from %s seq=%u", src_text, (unsigned)msg.sequence);
-    (void)send_echo(node, iface, pkt.src_ip, IPV4_DEFAULT_TTL, ICMP_TYPE_ECHO_REPLY, msg.identifier,
-                    msg.sequence, msg.payload, msg.payload_len);
+  uint8_t* datagram = NULL;
+  size_t datagram_len = 0U;
+  if (ipv4_reasm_input(state->reasm, &pkt, &datagram, &datagram_len) != MAGI_OK) {
+    LOG(node->name, "Drop IPv4 fragment id=%u", (unsigned)pkt.identification);
     return;
   }
-
-  if (msg.type == ICMP_TYPE_ECHO_REPLY) {
-    handle_echo_reply(node, &pkt, &msg);
+  if (datagram == NULL) {
     return;
   }
 
-  if (msg.type == ICMP_TYPE_TIME_EXCEEDED || msg.type == ICMP_TYPE_DEST_UNREACHABLE) {
-    handle_icmp_error(node, &pkt, &msg);
+  if (ipv4_unpack(&pkt, datagram, datagram_len) == MAGI_OK) {
+    ipv4_host_deliver(node, iface, &pkt);
   }
+  free(datagram);
 }
 
 int ipv4_pack(IPv4Packet* pkt, uint8_t* out, size_t out_len) {
@@ -585,7 +703,25 @@ int ipv4_pack(IPv4Packet* pkt, uint8_t* out, size_t out_len) {
     return MAGI_ERR_BADARGS;
   }
 
-  memset(out, 0, total_len);
+  if (pkt->payload_len > 0U) {
+    memcpy(out + IPV4_HEADER_LEN, pkt->payload, pkt->payload_len);
+  }
+
+  return ipv4_pack_header(pkt, out, out_len);
+}
+
+int ipv4_pack_header(IPv4Packet* pkt, uint8_t* out, size_t out_len) {
+  if (pkt == NULL || out == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  size_t total_len = IPV4_HEADER_LEN + pkt->payload_len;
+  if (total_len > 0xFFFFU || out_len < IPV4_HEADER_LEN) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
   uint8_t version_ihl = pkt->version_ihl != 0U ? pkt->version_ihl : IPV4_VERSION_IHL;
   WRITE_U8(out, 0U, version_ihl);
   WRITE_U8(out, 1U, pkt->tos);
@@ -598,10 +734,6 @@ int ipv4_pack(IPv4Packet* pkt, uint8_t* out, size_t out_len) {
   memcpy(out + 12U, pkt->src_ip, 4U);
   memcpy(out + 16U, pkt->dst_ip, 4U);
 
-  if (pkt->payload_len > 0U) {
-    memcpy(out + IPV4_HEADER_LEN, pkt->payload, pkt->payload_len);
-  }
-
   pkt->version_ihl = version_ihl;
   pkt->total_len = (uint16_t)total_len;
   pkt->checksum = ipv4_checksum(out, IPV4_HEADER_LEN);
@@ -846,6 +978,19 @@ bool ipv4_addr_in_network(const uint8_t ip[4], const uint8_t network[4], const u
   return (ipv4_to_u32(ip) & ipv4_to_u32(mask)) == ipv4_to_u32(network);
 }
 
+/**
+ * @brief Free a host's IPv4 state, including its reassembly table.
+ *
+ * @param data HostIPv4State to free.
+ */
+static void host_ipv4_state_free(void* data) {
+  HostIPv4State* state = data;
+  if (state != NULL) {
+    ipv4_reasm_free(state->reasm);
+  }
+  free(state);
+}
+
 int ipv4_host_attach(Node* node) {
   if (node == NULL) {
     magi_errno = MAGI_ERR_BADARGS;
@@ -863,17 +1008,34 @@ int ipv4_host_attach(Node* node) {
     return MAGI_ERR_NOMEM;
   }
 
+  state->reasm = ipv4_reasm_new(0U, 0U, 0U);
+  if (state->reasm == NULL) {
+    free(state);
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
+  }
+
   state->next_id = 1U;
   state->next_seq = 1U;
   state->echo_id = node_echo_id(node);
   node->l3_data = state;
-  node->l3_data_free = free;
+  node->l3_data_free = host_ipv4_state_free;
   node->handle_l3_packet = ipv4_host_receive;
   return MAGI_OK;
 }
 
-int ipv4_host_ping(Node* node, const char* target_ip) {
-  static const uint8_t payload[] = "MAGI-PING";
+/**
+ * @brief Send one echo request and wait for its answer.
+ *
+ * @param node          The pinging host.
+ * @param target_ip     Dotted-decimal destination.
+ * @param payload       ICMP payload bytes.
+ * @param payload_len   Length of the payload.
+ * @param dont_fragment Set DF on the request.
+ * @return MAGI_OK if the request was sent, or an error code.
+ */
+static int host_ping(Node* node, const char* target_ip, const uint8_t* payload,
+                     size_t payload_len, bool dont_fragment) {
   HostIPv4State* state = host_ipv4_state(node);
   if (node == NULL || target_ip == NULL || state == NULL) {
     magi_errno = MAGI_ERR_BADARGS;
@@ -896,12 +1058,13 @@ int ipv4_host_ping(Node* node, const char* target_ip) {
   uint16_t seq = state->next_seq++;
   start_pending(state, dst_ip, state->echo_id, seq, false, IPV4_DEFAULT_TTL);
   status = send_echo(node, iface, dst_ip, IPV4_DEFAULT_TTL, ICMP_TYPE_ECHO_REQUEST, state->echo_id,
-                     seq, payload, sizeof(payload) - 1U);
+                     seq, dont_fragment ? IPV4_FLAG_DF : 0U, payload, payload_len);
   if (status != MAGI_OK) {
     state->awaiting = false;
     return status;
   }
 
+  wait_for_probe(state);
   if (host_ipv4_state_const(node)->awaiting) {
     LOG(node->name, "ping request for %s is pending", target_ip);
   }
@@ -909,6 +1072,47 @@ int ipv4_host_ping(Node* node, const char* target_ip) {
   return MAGI_OK;
 }
 
+int ipv4_host_ping(Node* node, const char* target_ip) {
+  static const uint8_t payload[] = "MAGI-PING";
+  return host_ping(node, target_ip, payload, sizeof(payload) - 1U, false);
+}
+
+/**
+ * @brief Ping with a payload of a given size, optionally with Don't Fragment set.
+ *
+ * Payloads larger than the link MTU are fragmented unless dont_fragment is
+ * set, in which case the first hop that cannot carry them answers with
+ * ICMP Fragmentation Needed.
+ *
+ * @param node          The pinging host.
+ * @param target_ip     Dotted-decimal destination.
+ * @param payload_len   ICMP payload bytes, at most IPV4_PING_MAX_PAYLOAD.
+ * @param dont_fragment Set DF on the request.
+ * @return MAGI_OK if the request was sent, MAGI_ERR_MSGSIZE if it has DF
+ *         set and does not fit the host's own link, or an error code.
+ */
+int ipv4_host_ping_sized(Node* node, const char* target_ip, size_t payload_len,
+                         bool dont_fragment) {
+  static const char pattern[] = "MAGI-PING";
+  if (payload_len > IPV4_PING_MAX_PAYLOAD) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  uint8_t* payload = malloc(payload_len > 0U ? payload_len : 1U);
+  if (payload == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
+  }
+  for (size_t index = 0U; index < payload_len; ++index) {
+    payload[index] = (uint8_t)pattern[index % (sizeof(pattern) - 1U)];
+  }
+
+  int status = host_ping(node, target_ip, payload, payload_len, dont_fragment);
+  free(payload);
+  return status;
+}
+
 int ipv4_host_traceroute(Node* node, const char* target_ip, uint8_t max_hops) {
   static const uint8_t payload[] = "MAGI-TRACE";
   HostIPv4State* state = host_ipv4_state(node);
@@ -937,13 +1141,14 @@ int ipv4_host_traceroute(Node* node, const char* target_ip, uint8_t max_hops) {
   for (uint8_t ttl = 1U; ttl <= max_hops; ++ttl) {
     uint16_t seq = state->next_seq++;
     start_pending(state, dst_ip, state->echo_id, seq, true, ttl);
-    status = send_echo(node, iface, dst_ip, ttl, ICMP_TYPE_ECHO_REQUEST, state->echo_id, seq,
+    status = send_echo(node, iface, dst_ip, ttl, ICMP_TYPE_ECHO_REQUEST, state->echo_id, seq, 0U,
                        payload, sizeof(payload) - 1U);
     if (status != MAGI_OK) {
       state->awaiting = false;
       return status;
     }
 
+    wait_for_probe(state);
     if (state->awaiting) {
       LOG(node->name, "traceroute %u * * *", (unsigned)ttl);
       state->awaiting = false;
@@ -957,9 +1162,11 @@ int ipv4_host_traceroute(Node* node, const char* target_ip, uint8_t max_hops) {
   return MAGI_OK;
 }
 
-int ipv4_send_packet(Node* node, const uint8_t src_ip[4], const uint8_t dst_ip[4], uint8_t protocol,
-                     uint8_t ttl, const uint8_t* data, size_t len) {
-  if (node == NULL || src_ip == NULL || dst_ip == NULL || (len > 0U && data == NULL)) {
+int ipv4_send_pkt(Node* node, const uint8_t src_ip[4], const uint8_t dst_ip[4], uint8_t protocol,
+                  uint8_t ttl, PktBuf* pkt) {
+  if (node == NULL || src_ip == NULL || dst_ip == NULL || pkt == NULL ||
+      (node->send_l3_pkt == NULL && node->send_l3_packet == NULL)) {
+    pktbuf_release(pkt);
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
@@ -967,43 +1174,41 @@ int ipv4_send_packet(Node* node, const uint8_t src_ip[4], const uint8_t dst_ip[4
   Interface* iface = first_ipv4_interface(node);
   if (iface == NULL) {
     LOG(node->name, "Cannot send IPv4 packet: no interface configured");
+    pktbuf_release(pkt);
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
   HostIPv4State* state = host_ipv4_state(node);
   if (state == NULL) {
+    pktbuf_release(pkt);
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
-  IPv4Packet pkt;
-  memset(&pkt, 0, sizeof(pkt));
-  pkt.version_ihl = IPV4_VERSION_IHL;
-  pkt.identification = state->next_id++;
-  pkt.ttl = ttl;
-  pkt.protocol = protocol;
-  memcpy(pkt.src_ip, src_ip, 4U);
-  memcpy(pkt.dst_ip, dst_ip, 4U);
-  pkt.payload = data;
-  pkt.payload_len = len;
-
-  uint8_t* bytes = NULL;
-  size_t bytes_len = 0U;
-  int status = ipv4_packet_to_bytes(&pkt, &bytes, &bytes_len);
+  uint8_t next_hop[4];
+  int status = choose_next_hop(node, iface, dst_ip, next_hop);
   if (status != MAGI_OK) {
+    node_count(node, MAGI_NODE_DROP_NO_ROUTE);
+    LOG(node->name, "No route to destination");
+    pktbuf_release(pkt);
     return status;
   }
 
-  char next_hop[16];
-  status = choose_next_hop(node, iface, dst_ip, next_hop);
-  if (status != MAGI_OK) {
-    LOG(node->name, "No route to destination");
-    free(bytes);
-    return status;
+  return host_output_pkt(node, iface, state, src_ip, dst_ip, protocol, ttl, 0U, next_hop, pkt);
+}
+
+int ipv4_send_packet(Node* node, const uint8_t src_ip[4], const uint8_t dst_ip[4], uint8_t protocol,
+                     uint8_t ttl, const uint8_t* data, size_t len) {
+  if (node == NULL || src_ip == NULL || dst_ip == NULL || (len > 0U && data == NULL)) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
   }
 
-  status = node->send_l3_packet(node, next_hop, IPV4_ETHERTYPE, bytes, bytes_len);
-  free(bytes);
-  return status;
+  PktBuf* pkt = pktbuf_copy(PKTBUF_HEADROOM, data, len);
+  if (pkt == NULL) {
+    return MAGI_ERR_NOMEM;
+  }
+
+  return ipv4_send_pkt(node, src_ip, dst_ip, protocol, ttl, pkt);
 }
@@ -20,6 +20,13 @@
 #define IPV4_PROTOCOL_TCP 6U
 #define IPV4_PROTOCOL_UDP 17U
 #define IPV4_ETHERTYPE 0x0800U
+#define IPV4_PROBE_TIMEOUT_MS 2000U
+/** flags_frag_off bits. */
+#define IPV4_FLAG_DF 0x4000U
+#define IPV4_FLAG_MF 0x2000U
+#define IPV4_FRAG_OFFSET_MASK 0x1FFFU
+/** Largest ping payload: 65535 minus the IPv4 and ICMP headers. */
+#define IPV4_PING_MAX_PAYLOAD 65507U
 
 typedef struct IPv4Packet {
   Packet base;
@@ -38,6 +45,7 @@ typedef struct IPv4Packet {
 } IPv4Packet;
 
 int ipv4_pack(IPv4Packet* pkt, uint8_t* out, size_t out_len);
+int ipv4_pack_header(IPv4Packet* pkt, uint8_t* out, size_t out_len);
 int ipv4_unpack(IPv4Packet* pkt, const uint8_t* in, size_t in_len);
 int ipv4_packet_to_bytes(IPv4Packet* pkt, uint8_t** bytes_out, size_t* len_out);
 
@@ -53,7 +61,11 @@ bool ipv4_addr_in_network(const uint8_t ip[4], const uint8_t network[4], const u
 int ipv4_host_attach(Node* node);
 int ipv4_send_packet(Node* node, const uint8_t src_ip[4], const uint8_t dst_ip[4], uint8_t protocol,
                      uint8_t ttl, const uint8_t* data, size_t len);
+int ipv4_send_pkt(Node* node, const uint8_t src_ip[4], const uint8_t dst_ip[4], uint8_t protocol,
+                  uint8_t ttl, struct PktBuf* pkt);
 int ipv4_host_ping(Node* node, const char* target_ip);
+int ipv4_host_ping_sized(Node* node, const char* target_ip, size_t payload_len,
+                         bool dont_fragment);
 int ipv4_host_traceroute(Node* node, const char* target_ip, uint8_t max_hops);
 
 #endif
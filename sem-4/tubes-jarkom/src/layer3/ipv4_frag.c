@@ -0,0 +1,468 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ipv4_frag.h"
+
+#include "core/pktbuf.h"
+#include "core/sim.h"
+#include "utils/byteops.h"
+#include "utils/magi_error.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/** Largest IPv4 payload: 65535 minus the header. */
+#define REASM_MAX_PAYLOAD (0xFFFFU - IPV4_HEADER_LEN)
+/** Fragment offsets count 8-byte blocks. */
+#define REASM_BLOCK 8U
+#define REASM_BLOCKS ((REASM_MAX_PAYLOAD + REASM_BLOCK - 1U) / REASM_BLOCK)
+#define REASM_BITMAP_WORDS ((REASM_BLOCKS + 63U) / 64U)
+/** Smallest payload buffer allocated for a new datagram. */
+#define REASM_MIN_CAPACITY 2048U
+
+typedef struct ReasmEntry {
+  uint8_t src_ip[4];
+  uint8_t dst_ip[4];
+  uint16_t identification;
+  uint8_t protocol;
+  /** TOS and TTL of the offset-0 fragment, used for the rebuilt header. */
+  uint8_t tos;
+  uint8_t ttl;
+  /** True once the fragment with MF clear has arrived. */
+  bool have_last;
+  /** Payload length, valid once have_last is set. */
+  size_t total_len;
+  /** Largest offset + length seen so far. */
+  size_t max_end;
+  /** Header room followed by capacity payload bytes. */
+  uint8_t* data;
+  size_t capacity;
+  /** Number of set bits in received. */
+  size_t blocks;
+  uint64_t received[REASM_BITMAP_WORDS];
+  uint64_t expires_ns;
+  struct ReasmEntry* prev;
+  struct ReasmEntry* next;
+} ReasmEntry;
+
+struct Ipv4Reasm {
+  /** Oldest entry; entries are kept in creation order, so also the first to expire. */
+  ReasmEntry* head;
+  ReasmEntry* tail;
+  size_t max_entries;
+  size_t max_bytes;
+  uint64_t timeout_ns;
+  SimTimer expire_timer;
+  Ipv4ReasmStats stats;
+};
+
+bool ipv4_is_fragment(const IPv4Packet* pkt) {
+  return pkt != NULL && (pkt->flags_frag_off & (IPV4_FLAG_MF | IPV4_FRAG_OFFSET_MASK)) != 0U;
+}
+
+int ipv4_fragment(PktBuf* datagram, uint16_t mtu, ipv4_frag_emit_fn emit, void* ctx) {
+  if (datagram == NULL || emit == NULL || datagram->len < IPV4_HEADER_LEN) {
+    pktbuf_release(datagram);
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  if (mtu == 0U || datagram->len <= mtu) {
+    return emit(datagram, ctx);
+  }
+
+  const uint8_t* header = datagram->data;
+  uint16_t flags = READ_U16(header, 6U);
+  size_t total_len = READ_U16(header, 2U);
+  if ((flags & IPV4_FLAG_DF) != 0U) {
+    pktbuf_release(datagram);
+    magi_errno = MAGI_ERR_MSGSIZE;
+    return MAGI_ERR_MSGSIZE;
+  }
+  if (mtu < IPV4_HEADER_LEN + REASM_BLOCK || total_len < IPV4_HEADER_LEN ||
+      total_len > datagram->len) {
+    pktbuf_release(datagram);
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  /* Re-fragmenting a fragment keeps its offset base and its MF bit on the tail. */
+  size_t chunk_max = (size_t)(mtu - IPV4_HEADER_LEN) & ~(size_t)(REASM_BLOCK - 1U);
+  size_t payload_len = total_len - IPV4_HEADER_LEN;
+  uint16_t base_blocks = flags & IPV4_FRAG_OFFSET_MASK;
+  uint16_t kept_flags = flags & (uint16_t)~(IPV4_FLAG_MF | IPV4_FRAG_OFFSET_MASK);
+  bool more_after = (flags & IPV4_FLAG_MF) != 0U;
+
+  int status = MAGI_OK;
+  for (size_t offset = 0U; offset < payload_len && status == MAGI_OK;) {
+    size_t chunk = payload_len - offset < chunk_max ? payload_len - offset : chunk_max;
+    bool last = offset + chunk == payload_len;
+    PktBuf* fragment = pktbuf_new(PKTBUF_HEADROOM, IPV4_HEADER_LEN + chunk);
+    uint8_t* out = pktbuf_put(fragment, IPV4_HEADER_LEN + chunk);
+    if (out == NULL) {
+      pktbuf_release(fragment);
+      magi_errno = MAGI_ERR_NOMEM;
+      status = MAGI_ERR_NOMEM;
+      break;
+    }
+
+    memcpy(out, header, IPV4_HEADER_LEN);
+    memcpy(out + IPV4_HEADER_LEN, header + IPV4_HEADER_LEN + offset, chunk);
+    uint16_t fragment_flags = kept_flags | (uint16_t)(base_blocks + offset / REASM_BLOCK);
+    if (!last || more_after) {
+      fragment_flags |= IPV4_FLAG_MF;
+    }
+    WRITE_U16(out, 2U, (uint16_t)(IPV4_HEADER_LEN + chunk));
+    WRITE_U16(out, 6U, fragment_flags);
+    WRITE_U16(out, 10U, 0U);
+    WRITE_U16(out, 10U, ipv4_checksum(out, IPV4_HEADER_LEN));
+    status = emit(fragment, ctx);
+    offset += chunk;
+  }
+
+  pktbuf_release(datagram);
+  return status;
+}
+
+/**
+ * @brief Bytes an entry is charged against the table's max_bytes.
+ */
+static size_t entry_cost(const ReasmEntry* entry) {
+  return sizeof(*entry) + IPV4_HEADER_LEN + entry->capacity;
+}
+
+/**
+ * @brief Re-arm the expiry timer for the oldest entry, or cancel it.
+ *
+ * Async builds do not run the clock queue; they expire lazily on input.
+ */
+static void reasm_rearm(Ipv4Reasm* table) {
+#ifndef MAGI_ASYNC
+  if (table->head == NULL) {
+    sim_timer_cancel(&table->expire_timer);
+    return;
+  }
+
+  uint64_t now = sim_now_ns();
+  uint64_t at = table->head->expires_ns;
+  if (!sim_timer_armed(&table->expire_timer) || table->expire_timer.at_ns != at) {
+    (void)sim_timer_arm(&table->expire_timer, at > now ? at - now : 0U);
+  }
+#else
+  (void)table;
+#endif
+}
+
+/**
+ * @brief Unlink and free an entry, optionally keeping its data buffer.
+ *
+ * @param table Owning table.
+ * @param entry Entry to remove.
+ * @param free_data false when the caller has taken over entry->data.
+ */
+static void reasm_remove(Ipv4Reasm* table, ReasmEntry* entry, bool free_data) {
+  if (entry->prev != NULL) {
+    entry->prev->next = entry->next;
+  } else {
+    table->head = entry->next;
+  }
+  if (entry->next != NULL) {
+    entry->next->prev = entry->prev;
+  } else {
+    table->tail = entry->prev;
+  }
+
+  table->stats.entries--;
+  table->stats.bytes -= entry_cost(entry);
+  if (free_data) {
+    free(entry->data);
+  }
+  free(entry);
+}
+
+/**
+ * @brief SimTimer callback: drop timed-out datagrams.
+ */
+static void reasm_timer_fire(void* ctx) {
+  (void)ipv4_reasm_expire(ctx);
+}
+
+Ipv4Reasm* ipv4_reasm_new(size_t max_entries, size_t max_bytes, uint32_t timeout_ms) {
+  Ipv4Reasm* table = calloc(1U, sizeof(*table));
+  if (table == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+
+  table->max_entries = max_entries != 0U ? max_entries : IPV4_REASM_MAX_ENTRIES;
+  table->max_bytes = max_bytes != 0U ? max_bytes : IPV4_REASM_MAX_BYTES;
+  table->timeout_ns =
+      (uint64_t)(timeout_ms != 0U ? timeout_ms : IPV4_REASM_TIMEOUT_MS) * SIM_NS_PER_MS;
+  sim_timer_init(&table->expire_timer, reasm_timer_fire, table);
+  return table;
+}
+
+void ipv4_reasm_free(Ipv4Reasm* table) {
+  if (table == NULL) {
+    return;
+  }
+
+  sim_timer_cancel(&table->expire_timer);
+  while (table->head != NULL) {
+    reasm_remove(table, table->head, true);
+  }
+  free(table);
+}
+
+size_t ipv4_reasm_expire(Ipv4Reasm* table) {
+  if (table == NULL) {
+    return 0U;
+  }
+
+  uint64_t now = sim_now_ns();
+  size_t dropped = 0U;
+  while (table->head != NULL && table->head->expires_ns <= now) {
+    reasm_remove(table, table->head, true);
+    table->stats.timeouts++;
+    dropped++;
+  }
+  reasm_rearm(table);
+  return dropped;
+}
+
+/**
+ * @brief Find the entry a fragment belongs to, newest first.
+ *
+ * Tables hold at most a few dozen datagrams, so a list scan is cheaper
+ * than maintaining a hash index.
+ */
+static ReasmEntry* reasm_find(const Ipv4Reasm* table, const IPv4Packet* fragment) {
+  for (ReasmEntry* entry = table->tail; entry != NULL; entry = entry->prev) {
+    if (entry->identification == fragment->identification &&
+        entry->protocol == fragment->protocol && memcmp(entry->src_ip, fragment->src_ip, 4U) == 0 &&
+        memcmp(entry->dst_ip, fragment->dst_ip, 4U) == 0) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Evict the oldest entries other than keep until extra bytes fit.
+ *
+ * @return true if the table now has room for extra more bytes.
+ */
+static bool reasm_make_room(Ipv4Reasm* table, const ReasmEntry* keep, size_t extra) {
+  while (table->stats.bytes + extra > table->max_bytes) {
+    ReasmEntry* victim = table->head;
+    if (victim == keep) {
+      victim = victim->next;
+    }
+    if (victim == NULL) {
+      return false;
+    }
+    reasm_remove(table, victim, true);
+    table->stats.evictions++;
+  }
+  return true;
+}
+
+/**
+ * @brief Append a new, empty entry for a fragment's datagram.
+ */
+static ReasmEntry* reasm_create(Ipv4Reasm* table, const IPv4Packet* fragment) {
+  if (table->stats.entries >= table->max_entries) {
+    reasm_remove(table, table->head, true);
+    table->stats.evictions++;
+  }
+  if (!reasm_make_room(table, NULL, sizeof(ReasmEntry) + IPV4_HEADER_LEN)) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+
+  ReasmEntry* entry = calloc(1U, sizeof(*entry));
+  uint8_t* data = malloc(IPV4_HEADER_LEN);
+  if (entry == NULL || data == NULL) {
+    free(entry);
+    free(data);
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+
+  memcpy(entry->src_ip, fragment->src_ip, 4U);
+  memcpy(entry->dst_ip, fragment->dst_ip, 4U);
+  entry->identification = fragment->identification;
+  entry->protocol = fragment->protocol;
+  entry->ttl = fragment->ttl;
+  entry->tos = fragment->tos;
+  entry->data = data;
+  entry->expires_ns = sim_now_ns() + table->timeout_ns;
+  entry->prev = table->tail;
+  if (table->tail != NULL) {
+    table->tail->next = entry;
+  } else {
+    table->head = entry;
+  }
+  table->tail = entry;
+  table->stats.entries++;
+  table->stats.bytes += entry_cost(entry);
+  reasm_rearm(table);
+  return entry;
+}
+
+/**
+ * @brief Grow an entry's payload buffer to hold at least need bytes.
+ *
+ * Capacity doubles to keep in-order arrival linear, but never beyond the
+ * largest legal payload or the table's byte budget.
+ */
+static int reasm_reserve(Ipv4Reasm* table, ReasmEntry* entry, size_t need) {
+  if (need <= entry->capacity) {
+    return MAGI_OK;
+  }
+
+  size_t capacity = entry->capacity * 2U;
+  if (capacity < REASM_MIN_CAPACITY) {
+    capacity = REASM_MIN_CAPACITY;
+  }
+  if (capacity < need) {
+    capacity = need;
+  }
+  if (capacity > REASM_MAX_PAYLOAD) {
+    capacity = REASM_MAX_PAYLOAD;
+  }
+  if (!reasm_make_room(table, entry, capacity - entry->capacity)) {
+    capacity = need;
+    if (!reasm_make_room(table, entry, capacity - entry->capacity)) {
+      magi_errno = MAGI_ERR_NOMEM;
+      return MAGI_ERR_NOMEM;
+    }
+  }
+
+  uint8_t* data = realloc(entry->data, IPV4_HEADER_LEN + capacity);
+  if (data == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
+  }
+
+  table->stats.bytes += capacity - entry->capacity;
+  entry->data = data;
+  entry->capacity = capacity;
+  return MAGI_OK;
+}
+
+/**
+ * @brief Mark the 8-byte blocks covering [start, end) as received.
+ */
+static void reasm_mark(ReasmEntry* entry, size_t start, size_t end) {
+  size_t first = start / REASM_BLOCK;
+  size_t last = (end + REASM_BLOCK - 1U) / REASM_BLOCK;
+  for (size_t block = first; block < last; ++block) {
+    uint64_t bit = 1ULL << (block % 64U);
+    uint64_t* word = &entry->received[block / 64U];
+    if ((*word & bit) == 0U) {
+      *word |= bit;
+      entry->blocks++;
+    }
+  }
+}
+
+/**
+ * @brief Drop a fragment that cannot belong to a well-formed datagram.
+ */
+static int reasm_reject(Ipv4Reasm* table) {
+  table->stats.drops++;
+  magi_errno = MAGI_ERR_FRAGMENTED;
+  return MAGI_ERR_FRAGMENTED;
+}
+
+int ipv4_reasm_input(Ipv4Reasm* table, const IPv4Packet* fragment, uint8_t** datagram_out,
+                     size_t* len_out) {
+  if (table == NULL || fragment == NULL || datagram_out == NULL || len_out == NULL ||
+      (fragment->payload_len > 0U && fragment->payload == NULL)) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  *datagram_out = NULL;
+  *len_out = 0U;
+  (void)ipv4_reasm_expire(table);
+
+  size_t offset = (size_t)(fragment->flags_frag_off & IPV4_FRAG_OFFSET_MASK) * REASM_BLOCK;
+  size_t len = fragment->payload_len;
+  size_t end = offset + len;
+  bool more = (fragment->flags_frag_off & IPV4_FLAG_MF) != 0U;
+  if (end > REASM_MAX_PAYLOAD || (more && (len == 0U || len % REASM_BLOCK != 0U))) {
+    return reasm_reject(table);
+  }
+
+  ReasmEntry* entry = reasm_find(table, fragment);
+  if (entry == NULL) {
+    entry = reasm_create(table, fragment);
+    if (entry == NULL) {
+      table->stats.drops++;
+      return MAGI_ERR_NOMEM;
+    }
+  }
+
+  /* A tail that disagrees with data already received means the datagram is corrupt. */
+  if ((entry->have_last && end > entry->total_len) ||
+      (entry->have_last && !more && end != entry->total_len) || (!more && entry->max_end > end)) {
+    return reasm_reject(table);
+  }
+
+  int status = reasm_reserve(table, entry, end);
+  if (status != MAGI_OK) {
+    reasm_remove(table, entry, true);
+    table->stats.evictions++;
+    reasm_rearm(table);
+    return status;
+  }
+
+  if (len > 0U) {
+    memcpy(entry->data + IPV4_HEADER_LEN + offset, fragment->payload, len);
+  }
+  reasm_mark(entry, offset, end);
+  if (offset == 0U) {
+    entry->tos = fragment->tos;
+    entry->ttl = fragment->ttl;
+  }
+  if (!more) {
+    entry->have_last = true;
+    entry->total_len = end;
+  }
+  if (end > entry->max_end) {
+    entry->max_end = end;
+  }
+  table->stats.fragments++;
+
+  if (!entry->have_last ||
+      entry->blocks != (entry->total_len + REASM_BLOCK - 1U) / REASM_BLOCK) {
+    return MAGI_OK;
+  }
+
+  IPv4Packet header = {0};
+  header.version_ihl = IPV4_VERSION_IHL;
+  header.tos = entry->tos;
+  header.identification = entry->identification;
+  header.ttl = entry->ttl;
+  header.protocol = entry->protocol;
+  memcpy(header.src_ip, entry->src_ip, 4U);
+  memcpy(header.dst_ip, entry->dst_ip, 4U);
+  header.payload_len = entry->total_len;
+  (void)ipv4_pack_header(&header, entry->data, IPV4_HEADER_LEN);
+
+  *datagram_out = entry->data;
+  *len_out = IPV4_HEADER_LEN + entry->total_len;
+  table->stats.reassembled++;
+  reasm_remove(table, entry, false);
+  reasm_rearm(table);
+  return MAGI_OK;
+}
+
+void ipv4_reasm_get_stats(const Ipv4Reasm* table, Ipv4ReasmStats* out) {
+  if (table == NULL || out == NULL) {
+    return;
+  }
+
+  *out = table->stats;
+}
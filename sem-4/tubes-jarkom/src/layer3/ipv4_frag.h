@@ -0,0 +1,138 @@
+/**
+ * @file ipv4_frag.h
+ * @brief IPv4 fragmentation and a bounded, timed reassembly table.
+ *
+ * Senders call ipv4_fragment() when a datagram is larger than the egress
+ * link MTU; fragments carry 8-byte aligned slices of the payload behind a
+ * copy of the original header (RFC 791). Receivers feed fragments into an
+ * Ipv4Reasm table keyed by (src, dst, identification, protocol). Each
+ * entry tracks received 8-byte blocks in a bitmap, so duplicates and
+ * overlaps cost nothing extra and completion is a counter compare.
+ *
+ * The table is bounded by entry count and by buffered bytes; the oldest
+ * incomplete datagram is evicted to make room. Entries that do not
+ * complete within their timeout are dropped by a clock timer (sequential
+ * builds) or lazily on the next fragment (async builds).
+ */
+
+#ifndef MAGI_LAYER3_IPV4_FRAG_H
+#define MAGI_LAYER3_IPV4_FRAG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "layer3/ipv4.h"
+
+struct PktBuf;
+
+/** Incomplete datagrams a table holds before evicting the oldest. */
+#define IPV4_REASM_MAX_ENTRIES 64U
+/** Payload bytes a table buffers before evicting the oldest datagram. */
+#define IPV4_REASM_MAX_BYTES (1024U * 1024U)
+/** Time an incomplete datagram waits for its missing fragments. */
+#define IPV4_REASM_TIMEOUT_MS 30000U
+
+/** @brief Reassembly counters. */
+typedef struct Ipv4ReasmStats {
+  /** Fragments accepted into the table. */
+  uint64_t fragments;
+  /** Datagrams completed and handed back. */
+  uint64_t reassembled;
+  /** Incomplete datagrams dropped by the timeout. */
+  uint64_t timeouts;
+  /** Incomplete datagrams dropped to stay within the limits. */
+  uint64_t evictions;
+  /** Malformed or inconsistent fragments dropped. */
+  uint64_t drops;
+  /** Incomplete datagrams currently held. */
+  size_t entries;
+  /** Bytes currently buffered. */
+  size_t bytes;
+} Ipv4ReasmStats;
+
+/** @brief Opaque reassembly table. */
+typedef struct Ipv4Reasm Ipv4Reasm;
+
+/**
+ * @brief Callback that takes ownership of one outgoing fragment.
+ *
+ * @param fragment Buffer starting at the fragment's IPv4 header.
+ * @param ctx Caller context.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+typedef int (*ipv4_frag_emit_fn)(struct PktBuf* fragment, void* ctx);
+
+/**
+ * @brief Check whether a packet is a fragment (MF set or non-zero offset).
+ *
+ * @param pkt Unpacked IPv4 packet.
+ * @return true if the packet is part of a larger datagram.
+ */
+bool ipv4_is_fragment(const IPv4Packet* pkt);
+
+/**
+ * @brief Emit a datagram, split into fragments if it exceeds the MTU.
+ *
+ * Datagrams that fit are passed to emit unchanged. Fragments get
+ * PKTBUF_HEADROOM for the link-layer header.
+ *
+ * @param datagram Buffer starting at an option-free IPv4 header; consumed.
+ * @param mtu Largest IPv4 total length the link carries; 0 means unlimited.
+ * @param emit Called once per fragment, in offset order.
+ * @param ctx Context passed to emit.
+ * @return MAGI_OK, MAGI_ERR_MSGSIZE if the datagram has DF set and does
+ *         not fit, or the first error returned by emit.
+ */
+int ipv4_fragment(struct PktBuf* datagram, uint16_t mtu, ipv4_frag_emit_fn emit, void* ctx);
+
+/**
+ * @brief Create a reassembly table.
+ *
+ * @param max_entries Incomplete datagrams held at once (0 = IPV4_REASM_MAX_ENTRIES).
+ * @param max_bytes Buffered bytes across all entries (0 = IPV4_REASM_MAX_BYTES).
+ * @param timeout_ms Per-datagram timeout (0 = IPV4_REASM_TIMEOUT_MS).
+ * @return Table instance, or NULL on failure.
+ */
+Ipv4Reasm* ipv4_reasm_new(size_t max_entries, size_t max_bytes, uint32_t timeout_ms);
+
+/**
+ * @brief Destroy a reassembly table and everything it buffers.
+ *
+ * @param table Table to free. NULL is allowed.
+ */
+void ipv4_reasm_free(Ipv4Reasm* table);
+
+/**
+ * @brief Add a fragment; return the whole datagram once it is complete.
+ *
+ * The returned datagram is a valid IPv4 packet (header included, flags and
+ * offset cleared, checksum recomputed) allocated with malloc().
+ *
+ * @param table Reassembly table.
+ * @param fragment Unpacked fragment; its payload is copied.
+ * @param datagram_out Set to the complete datagram, or NULL if still incomplete.
+ * @param len_out Set to the datagram length.
+ * @return MAGI_OK if the fragment was accepted, MAGI_ERR_FRAGMENTED if it
+ *         was malformed or inconsistent, or MAGI_ERR_NOMEM.
+ */
+int ipv4_reasm_input(Ipv4Reasm* table, const IPv4Packet* fragment, uint8_t** datagram_out,
+                     size_t* len_out);
+
+/**
+ * @brief Drop datagrams whose timeout has passed.
+ *
+ * @param table Reassembly table.
+ * @return Number of datagrams dropped.
+ */
+size_t ipv4_reasm_expire(Ipv4Reasm* table);
+
+/**
+ * @brief Read the table counters.
+ *
+ * @param table Reassembly table.
+ * @param out Destination for the counters.
+ */
+void ipv4_reasm_get_stats(const Ipv4Reasm* table, Ipv4ReasmStats* out);
+
+#endif
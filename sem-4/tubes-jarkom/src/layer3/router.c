@@ -1,10 +1,17 @@
 #define _POSIX_C_SOURCE 200809L
+#define MAGI_LOG_SUBSYS MAGI_LOG_L3
 
 #include "router.h"
 
 #include "core/interface.h"
+#include "core/pktbuf.h"
+#include "layer2/neighbor.h"
+#include "layer3/fib.h"
+#include "layer3/flow_cache.h"
 #include "layer3/icmp.h"
 #include "layer3/ipv4.h"
+#include "layer3/ipv4_frag.h"
+#include "layer4/udp.h"
 #include "utils/arena.h"
 #include "utils/byteops.h"
 #include "utils/log.h"
@@ -49,23 +56,66 @@ typedef struct RouterArpMessage {
 } RouterArpMessage;
 
 typedef struct RouterPendingPacket {
-  uint8_t* payload;
-  size_t payload_len;
+  PktBuf* pkt;
   uint16_t out_port;
   uint16_t vlan_id;
   struct RouterPendingPacket* next;
 } RouterPendingPacket;
 
+typedef struct RouterConnected {
+  Interface* iface;
+  uint8_t address[4];
+  RoutingTableEntry route;
+} RouterConnected;
+
 typedef struct RouterState {
-  RoutingTableEntry* routes;
-  size_t route_count;
-  size_t route_cap;
-  HashMap* arp_cache;
+  Fib* fib;
+  RouterConnected* connected;
+  size_t connected_count;
+  size_t connected_cap;
+  uint32_t connected_gen;
+  bool connected_synced;
+  NeighborTable* neighbors;
   HashMap* pending;
-  RoutingTableEntry scratch_route;
+  Ipv4Reasm* reasm;
   uint16_t next_id;
+  FlowCache* flows;
+  uint32_t flow_iface_gen;
+  uint32_t flow_neighbor_gen;
+  rip_dispatch_fn rip_handler;
 } RouterState;
 
+typedef struct RouterFragmentCtx {
+  Router* router;
+  Interface* egress;
+  const uint8_t* next_hop;
+  /** Next-hop MAC taken from the flow cache, or NULL to resolve it. */
+  const uint8_t* dst_mac;
+  /** Flow to cache once the next hop resolves, or NULL. */
+  const FlowKey* learn;
+} RouterFragmentCtx;
+
+typedef struct RouterRx {
+  /** Ingress interface. */
+  Interface* iface;
+  /** Start of the Ethernet frame, as passed to router_handle_receive. */
+  const uint8_t* frame;
+  /** Start of the IPv4 header inside the frame. */
+  const uint8_t* raw;
+} RouterRx;
+
+/** One received datagram on its way through the parse, lookup and transmit stages. */
+typedef struct RouterRxSlot {
+  RouterFrame frame;
+  IPv4Packet pkt;
+  FlowKey key;
+  /** Copy of the cached decision; valid while hit is set. */
+  FlowAction action;
+  /** flow_cache_generation() the action was looked up under. */
+  uint32_t flow_gen;
+  bool hit;
+} RouterRxSlot;
+
 Node* router_as_node(Router* router) {
   return router != NULL ? &router->node : NULL;
 }
@@ -160,52 +210,17 @@ static void mac_broadcast(uint8_t out[ROUTER_ETHERNET_MAC_LEN]) {
   }
 }
 
-/**
- * @brief Duplicate a string on the heap.
- *
- * @param text The null-terminated string to copy.
- * @return Heap-allocated copy, or NULL on allocation failure.
- */
-static char* duplicate_string(const char* text) {
-  if (text == NULL) {
-    return NULL;
-  }
-
-  size_t len = strlen(text) + 1U;
-  char* copy = malloc(len);
-  if (copy == NULL) {
-    magi_errno = MAGI_ERR_NOMEM;
-    return NULL;
-  }
-
-  memcpy(copy, text, len);
-  return copy;
-}
-
-/**
- * @brief hashmap_foreach callback to free heap-allocated string values.
- *
- * @param key   The hashmap entry key (unused).
- * @param value The string value to free.
- * @param ctx   User context (unused).
- */
-static void free_string_entry(const char* key, void* value, void* ctx) {
-  (void)key;
-  (void)ctx;
-  free(value);
-}
-
 /**
  * @brief Free a linked list of RouterPendingPacket structs.
  *
- * Each packet's payload buffer and the packet itself are freed.
+ * Each packet's buffer is released and the packet itself is freed.
  *
  * @param packet The head of the pending packet list.
  */
 static void free_pending_list(RouterPendingPacket* packet) {
   while (packet != NULL) {
     RouterPendingPacket* next = packet->next;
-    free(packet->payload);
+    pktbuf_release(packet->pkt);
     free(packet);
     packet = next;
   }
@@ -227,8 +242,9 @@ static void free_pending_entry(const char* key, void* value, void* ctx) {
 /**
  * @brief Free a RouterState and all its owned resources.
  *
- * Frees the routing table, ARP cache entries, pending packet queues,
- * and the state struct itself. Compatible with node->data_free.
+ * Frees the forwarding table, connected-route cache, neighbor table,
+ * pending packet queues, reassembly table, and the state struct itself. Compatible with
+ * node->data_free.
  *
  * @param data The RouterState pointer to free.
  */
@@ -238,18 +254,21 @@ static void router_state_free(void* data) {
     return;
   }
 
-  free(state->routes);
-  hashmap_foreach(state->arp_cache, free_string_entry, NULL);
-  hashmap_free(state->arp_cache);
+  fib_free(state->fib);
+  free(state->connected);
+  neighbor_table_free(state->neighbors);
   hashmap_foreach(state->pending, free_pending_entry, NULL);
   hashmap_free(state->pending);
+  ipv4_reasm_free(state->reasm);
+  flow_cache_free(state->flows);
   free(state);
 }
 
 /**
  * @brief Allocate and initialise a new RouterState.
  *
- * Creates ARP cache and pending hash maps, sets next_id to 1.
+ * Creates the forwarding table, neighbor table, pending hash map,
+ * reassembly table and flow cache, sets next_id to 1.
  *
  * @return Pointer to the new RouterState, or NULL on allocation failure.
  */
@@ -260,10 +279,14 @@ static RouterState* router_state_new(void) {
     return NULL;
   }
 
-  state->arp_cache = hashmap_new(16U);
+  state->fib = fib_new();
+  state->neighbors = neighbor_table_new(16U);
   state->pending = hashmap_new(16U);
+  state->reasm = ipv4_reasm_new(0U, 0U, 0U);
   state->next_id = 1U;
-  if (state->arp_cache == NULL || state->pending == NULL) {
+  state->flows = flow_cache_new(ROUTER_FLOW_CACHE_SLOTS);
+  if (state->fib == NULL || state->neighbors == NULL || state->pending == NULL ||
+      state->reasm == NULL || state->flows == NULL) {
     router_state_free(state);
     magi_errno = MAGI_ERR_NOMEM;
     return NULL;
@@ -316,28 +339,21 @@ static int parse_frame(const uint8_t* data, size_t len, RouterFrame* frame_out)
 }
 
 /**
- * @brief Serialize a RouterFrame to a heap-allocated byte buffer.
+ * @brief Prepend a RouterFrame's Ethernet header to a packet buffer.
  *
- * Handles both untagged and VLAN-tagged header formats.
+ * Handles both untagged and VLAN-tagged header formats. The header is
+ * written into the buffer's headroom; frame->payload is ignored.
  *
- * @param frame    The frame to serialise.
- * @param bytes_out Output pointer for the allocated byte buffer.
- * @param len_out   Output length.
+ * @param frame The frame header fields.
+ * @param pkt   Buffer whose current contents become the frame payload.
  * @return MAGI_OK on success, or an error code.
  */
-static int frame_to_bytes(const RouterFrame* frame, uint8_t** bytes_out, size_t* len_out) {
-  if (frame == NULL || bytes_out == NULL || len_out == NULL ||
-      (frame->payload_len > 0U && frame->payload == NULL)) {
-    magi_errno = MAGI_ERR_BADARGS;
-    return MAGI_ERR_BADARGS;
-  }
-
+static int frame_push_header(const RouterFrame* frame, PktBuf* pkt) {
   size_t header_len = frame->vlan_present ? ROUTER_ETHERNET_VLAN_LEN : ROUTER_ETHERNET_MIN_LEN;
-  size_t total_len = header_len + frame->payload_len;
-  uint8_t* bytes = malloc(total_len);
+  uint8_t* bytes = pktbuf_push(pkt, header_len);
   if (bytes == NULL) {
-    magi_errno = MAGI_ERR_NOMEM;
-    return MAGI_ERR_NOMEM;
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
   }
 
   memcpy(bytes, frame->dst_mac, ROUTER_ETHERNET_MAC_LEN);
@@ -350,12 +366,6 @@ static int frame_to_bytes(const RouterFrame* frame, uint8_t** bytes_out, size_t*
     WRITE_U16(bytes, 12U, frame->ethertype);
   }
 
-  if (frame->payload_len > 0U) {
-    memcpy(bytes + header_len, frame->payload, frame->payload_len);
-  }
-
-  *bytes_out = bytes;
-  *len_out = total_len;
   return MAGI_OK;
 }
 
@@ -465,12 +475,55 @@ static uint16_t egress_vlan_id(const Interface* iface, const RouterFrame* ingres
   return ingress != NULL && ingress->vlan_present ? ingress->vlan_id : 0U;
 }
 
+/**
+ * @brief Prepend an Ethernet header to a packet buffer and send it.
+ *
+ * The header goes into the buffer's headroom, so the payload is not
+ * copied. The buffer is consumed on every path.
+ *
+ * @param router    The router instance.
+ * @param iface     The egress interface.
+ * @param dst_mac   Destination MAC address.
+ * @param ethertype EtherType field value.
+ * @param pkt       Buffer holding the frame payload.
+ * @param vlan_id   VLAN ID (0 = untagged).
+ * @return MAGI_OK on success, or an error code.
+ */
+static int router_send_ethernet_pkt(Router* router, Interface* iface, const uint8_t dst_mac[6],
+                                    uint16_t ethertype, PktBuf* pkt, uint16_t vlan_id) {
+  if (router == NULL || iface == NULL || dst_mac == NULL || pkt == NULL) {
+    pktbuf_release(pkt);
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  RouterFrame frame = {0};
+  memcpy(frame.dst_mac, dst_mac, ROUTER_ETHERNET_MAC_LEN);
+  memcpy(frame.src_mac, iface->mac, ROUTER_ETHERNET_MAC_LEN);
+  frame.ethertype = ethertype;
+  frame.vlan_present = vlan_id != 0U;
+  frame.vlan_id = vlan_id;
+
+  int status = frame_push_header(&frame, pkt);
+  if (status != MAGI_OK) {
+    pktbuf_release(pkt);
+    return status;
+  }
+
+  if (magi_log_enabled(MAGI_LOG_SUBSYS, MAGI_LOG_INFO)) {
+    char dst_text[18];
+    mac_to_str(dst_mac, dst_text);
+    LOG(router_name(router), "Send Ethernet frame port=%u vlan=%u dst=%s ethertype=0x%04X",
+        (unsigned)iface->port_number, (unsigned)vlan_id, dst_text, (unsigned)ethertype);
+  }
+  return interface_send_pkt(iface, pkt);
+}
+
 /**
  * @brief Build and send an Ethernet frame from a router.
  *
- * Constructs a RouterFrame with the given parameters, serialises it,
- * and sends it via interface_send. The frame is heap-allocated and
- * freed by the link layer after transmission.
+ * Copies the payload once into a packet buffer and hands it to
+ * router_send_ethernet_pkt.
  *
  * @param router      The router instance.
  * @param iface       The egress interface.
@@ -489,34 +542,18 @@ static int router_send_ethernet(Router* router, Interface* iface, const uint8_t
     return MAGI_ERR_BADARGS;
   }
 
-  RouterFrame frame = {0};
-  memcpy(frame.dst_mac, dst_mac, ROUTER_ETHERNET_MAC_LEN);
-  memcpy(frame.src_mac, iface->mac, ROUTER_ETHERNET_MAC_LEN);
-  frame.ethertype = ethertype;
-  frame.vlan_present = vlan_id != 0U;
-  frame.vlan_id = vlan_id;
-  frame.payload = payload;
-  frame.payload_len = payload_len;
-
-  uint8_t* bytes = NULL;
-  size_t len = 0U;
-  int status = frame_to_bytes(&frame, &bytes, &len);
-  if (status != MAGI_OK) {
-    return status;
+  PktBuf* pkt = pktbuf_copy(PKTBUF_HEADROOM, payload, payload_len);
+  if (pkt == NULL) {
+    return MAGI_ERR_NOMEM;
   }
 
-  char dst_text[18];
-  mac_to_str(dst_mac, dst_text);
-  LOG(router_name(router), "Send Ethernet frame port=%u vlan=%u dst=%s ethertype=0x%04X",
-      (unsigned)iface->port_number, (unsigned)vlan_id, dst_text, (unsigned)ethertype);
-  return interface_send(iface, bytes, len);
+  return router_send_ethernet_pkt(router, iface, dst_mac, ethertype, pkt, vlan_id);
 }
 
 /**
- * @brief Insert or update an entry in the router's ARP cache.
+ * @brief Insert or refresh an entry in the router's neighbor table.
  *
- * If an entry already exists for the IP, it is overwritten. The MAC is
- * stored as its colon-separated string representation.
+ * The entry becomes REACHABLE with the given MAC.
  *
  * @param router The router instance.
  * @param ip     The IPv4 address.
@@ -530,38 +567,16 @@ static int router_cache_arp(Router* router, const uint8_t ip[4], const uint8_t m
     return MAGI_ERR_BADARGS;
   }
 
-  char ip_text[16];
-  char mac_text[18];
-  ipv4_address_to_string(ip, ip_text);
-  mac_to_str(mac, mac_text);
-
-  char* existing = hashmap_get(state->arp_cache, ip_text);
-  if (existing != NULL) {
-    snprintf(existing, 18U, "%s", mac_text);
-    return MAGI_OK;
-  }
-
-  char* stored = duplicate_string(mac_text);
-  if (stored == NULL) {
-    return MAGI_ERR_NOMEM;
-  }
-
-  int status = hashmap_set(state->arp_cache, ip_text, stored);
-  if (status != MAGI_OK) {
-    free(stored);
-    return status;
-  }
-
-  return MAGI_OK;
+  return neighbor_update(state->neighbors, ip, mac, neighbor_now_ms());
 }
 
 /**
- * @brief Look up a MAC address in the router's ARP cache.
+ * @brief Look up a MAC address in the router's neighbor table.
  *
  * @param router  The router instance.
  * @param ip      The IPv4 address to look up.
  * @param mac_out Output buffer for the 6-byte MAC address.
- * @return true if the entry was found and mac_out was populated.
+ * @return true if a REACHABLE or STALE entry was found and mac_out was populated.
  */
 static bool router_lookup_arp(Router* router, const uint8_t ip[4], uint8_t mac_out[6]) {
   RouterState* state = router_state(router);
@@ -569,51 +584,41 @@ static bool router_lookup_arp(Router* router, const uint8_t ip[4], uint8_t mac_o
     return false;
   }
 
-  char ip_text[16];
-  ipv4_address_to_string(ip, ip_text);
-  char* mac_text = hashmap_get(state->arp_cache, ip_text);
-  return mac_text != NULL && mac_from_str(mac_text, mac_out) == MAGI_OK;
+  bool hit = neighbor_resolve(state->neighbors, ip, neighbor_now_ms(), mac_out);
+  node_count(router_as_node(router), hit ? MAGI_NODE_ARP_HITS : MAGI_NODE_ARP_MISSES);
+  return hit;
 }
 
 /**
  * @brief Queue a packet while the ARP resolution for a next hop is pending.
  *
- * Allocates a RouterPendingPacket, copies the payload, and appends it
- * to the linked list for the given next-hop IP.
+ * Allocates a RouterPendingPacket that takes over the packet buffer and
+ * appends it to the linked list for the given next-hop IP.
  *
- * @param router      The router instance.
- * @param next_hop    The next-hop IPv4 address being resolved.
- * @param out_port    The egress port number.
- * @param vlan_id     The VLAN ID to use when sending queued packets.
- * @param payload     The packet payload (copied).
- * @param payload_len Length of the payload.
+ * @param router   The router instance.
+ * @param next_hop The next-hop IPv4 address being resolved.
+ * @param out_port The egress port number.
+ * @param vlan_id  The VLAN ID to use when sending queued packets.
+ * @param pkt      The IPv4 packet buffer; consumed on every path.
  * @return MAGI_OK on success, or an error code.
  */
 static int queue_pending_packet(Router* router, const uint8_t next_hop[4], uint16_t out_port,
-                                uint16_t vlan_id, const uint8_t* payload, size_t payload_len) {
+                                uint16_t vlan_id, PktBuf* pkt) {
   RouterState* state = router_state(router);
-  if (state == NULL || next_hop == NULL || (payload_len > 0U && payload == NULL)) {
+  if (state == NULL || next_hop == NULL || pkt == NULL) {
+    pktbuf_release(pkt);
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
   RouterPendingPacket* packet = calloc(1U, sizeof(*packet));
   if (packet == NULL) {
+    pktbuf_release(pkt);
     magi_errno = MAGI_ERR_NOMEM;
     return MAGI_ERR_NOMEM;
   }
 
-  if (payload_len > 0U) {
-    packet->payload = malloc(payload_len);
-    if (packet->payload == NULL) {
-      free(packet);
-      magi_errno = MAGI_ERR_NOMEM;
-      return MAGI_ERR_NOMEM;
-    }
-    memcpy(packet->payload, payload, payload_len);
-  }
-
-  packet->payload_len = payload_len;
+  packet->pkt = pkt;
   packet->out_port = out_port;
   packet->vlan_id = vlan_id;
 
@@ -673,14 +678,15 @@ static int flush_pending_packets(Router* router, const uint8_t next_hop[4],
     RouterPendingPacket* next = packet->next;
     Interface* iface = node_get_interface(router_as_node(router), packet->out_port);
     if (iface != NULL) {
-      int status = router_send_ethernet(router, iface, dst_mac, ROUTER_ETHERTYPE_IPV4,
-                                        packet->payload, packet->payload_len, packet->vlan_id);
+      int status = router_send_ethernet_pkt(router, iface, dst_mac, ROUTER_ETHERTYPE_IPV4,
+                                            packet->pkt, packet->vlan_id);
       if (status != MAGI_OK) {
         final_status = status;
       }
+    } else {
+      pktbuf_release(packet->pkt);
     }
 
-    free(packet->payload);
     free(packet);
     packet = next;
   }
@@ -717,32 +723,6 @@ static bool router_interface_matches_ip(const Interface* iface, const uint8_t ip
          ipv4_addr_equal(iface_ip, ip);
 }
 
-/**
- * @brief Find an interface on the router by its IPv4 address.
- *
- * Iterates the node's interface hashmap and returns the first interface
- * whose configured IP matches.
- *
- * @param router The router instance.
- * @param ip     The IPv4 address to look for.
- * @return Pointer to the matching Interface, or NULL.
- */
-static Interface* router_find_interface_by_ip(Router* router, const uint8_t ip[4]) {
-  Node* node = router_as_node(router);
-  if (node == NULL || node->interfaces == NULL || ip == NULL) {
-    return NULL;
-  }
-
-  for (size_t index = 0U; index < node->interfaces->capacity; ++index) {
-    HashEntry* entry = &node->interfaces->entries[index];
-    if (entry->key != NULL && !entry->tombstone && router_interface_matches_ip(entry->value, ip)) {
-      return entry->value;
-    }
-  }
-
-  return NULL;
-}
-
 /**
  * @brief Build and send an ARP request for a target IP.
  *
@@ -805,111 +785,296 @@ static int compare_routes_desc(const void* lhs, const void* rhs) {
 }
 
 /**
- * @brief Ensure the routing table array has capacity for at least `needed` entries.
+ * @brief Derive a directly connected routing table entry from an interface.
  *
- * Grows the array by doubling if necessary.
+ * Parses the interface's CIDR address and populates the RoutingTableEntry
+ * with the network, mask, prefix length, port, and metric 1.
  *
- * @param state  The router state.
- * @param needed The minimum required capacity.
- * @return MAGI_OK on success, or MAGI_ERR_NOMEM.
+ * @param iface   The interface to derive from.
+ * @param ip_out  Optional output for the interface's own address.
+ * @param out     Output RoutingTableEntry.
+ * @return true if the interface has a valid IP and the entry was populated.
  */
-static int ensure_route_capacity(RouterState* state, size_t needed) {
-  if (state == NULL) {
-    magi_errno = MAGI_ERR_BADARGS;
-    return MAGI_ERR_BADARGS;
+static bool interface_connected_route(const Interface* iface, uint8_t ip_out[4],
+                                      RoutingTableEntry* out) {
+  if (iface == NULL || out == NULL || iface->ip_address[0] == '\0') {
+    return false;
   }
 
-  if (state->route_cap >= needed) {
-    return MAGI_OK;
+  memset(out, 0, sizeof(*out));
+  if (ipv4_parse_cidr(iface->ip_address, ip_out, out->network, out->mask, &out->prefix_len) !=
+      MAGI_OK) {
+    return false;
+  }
+
+  out->out_port = iface->port_number;
+  out->metric = 1U;
+  return true;
+}
+
+/**
+ * @brief Rebuild the connected-route cache if the router's interfaces changed.
+ *
+ * Connected routes are installed into the FIB alongside static routes but
+ * never displace a static route with the same prefix, matching the old
+ * "static wins ties" lookup order. The cache is keyed off node->iface_gen,
+ * so the per-interface CIDR parsing only happens after an interface is
+ * added, removed, or readdressed.
+ *
+ * @param router The router instance.
+ */
+static void router_sync_connected(Router* router) {
+  RouterState* state = router_state(router);
+  Node* node = router_as_node(router);
+  if (state == NULL || node == NULL ||
+      (state->connected_synced && state->connected_gen == node->iface_gen)) {
+    return;
+  }
+
+  for (size_t index = 0U; index < state->connected_count; ++index) {
+    const RoutingTableEntry* route = &state->connected[index].route;
+    uint8_t origin = FIB_ORIGIN_STATIC;
+    if (fib_find(state->fib, route->network, route->prefix_len, &origin) != NULL &&
+        origin == FIB_ORIGIN_CONNECTED) {
+      (void)fib_remove(state->fib, route->network, route->prefix_len);
+    }
+  }
+  state->connected_count = 0U;
+
+  for (size_t index = 0U; index < node->iface_count; ++index) {
+    RouterConnected connected = {0};
+    connected.iface = node->iface_list[index];
+    if (!interface_connected_route(connected.iface, connected.address, &connected.route)) {
+      continue;
+    }
+
+    if (state->connected_count == state->connected_cap) {
+      size_t new_cap = state->connected_cap == 0U ? 8U : state->connected_cap * 2U;
+      RouterConnected* grown = realloc(state->connected, new_cap * sizeof(*grown));
+      if (grown == NULL) {
+        magi_errno = MAGI_ERR_NOMEM;
+        break;
+      }
+      state->connected = grown;
+      state->connected_cap = new_cap;
+    }
+
+    state->connected[state->connected_count++] = connected;
+    if (fib_find(state->fib, connected.route.network, connected.route.prefix_len, NULL) == NULL) {
+      (void)fib_insert(state->fib, &connected.route, FIB_ORIGIN_CONNECTED);
+    }
+  }
+
+  state->connected_gen = node->iface_gen;
+  state->connected_synced = true;
+}
+
+/**
+ * @brief Find an interface on the router by its IPv4 address.
+ *
+ * Uses the connected-route cache, so no address parsing happens per packet.
+ *
+ * @param router The router instance.
+ * @param ip     The IPv4 address to look for.
+ * @return Pointer to the matching Interface, or NULL.
+ */
+static Interface* router_find_interface_by_ip(Router* router, const uint8_t ip[4]) {
+  RouterState* state = router_state(router);
+  if (state == NULL || ip == NULL) {
+    return NULL;
   }
 
-  size_t new_cap = state->route_cap == 0U ? 8U : state->route_cap * 2U;
-  while (new_cap < needed) {
-    new_cap *= 2U;
+  router_sync_connected(router);
+  for (size_t index = 0U; index < state->connected_count; ++index) {
+    if (ipv4_addr_equal(state->connected[index].address, ip)) {
+      return state->connected[index].iface;
+    }
   }
 
-  RoutingTableEntry* routes = realloc(state->routes, new_cap * sizeof(*routes));
-  if (routes == NULL) {
+  return NULL;
+}
+
+typedef struct RouterRouteList {
+  RoutingTableEntry* routes;
+  size_t count;
+} RouterRouteList;
+
+/**
+ * @brief fib_foreach callback collecting static routes into an array.
+ *
+ * @param route  The installed route.
+ * @param origin FIB_ORIGIN_STATIC or FIB_ORIGIN_CONNECTED.
+ * @param ctx    RouterRouteList being filled.
+ */
+static void collect_static_route(const RoutingTableEntry* route, uint8_t origin, void* ctx) {
+  RouterRouteList* list = ctx;
+  if (origin == FIB_ORIGIN_STATIC) {
+    list->routes[list->count++] = *route;
+  }
+}
+
+/**
+ * @brief Snapshot the static routes in descending prefix length order.
+ *
+ * @param state   The router state.
+ * @param list    Output list; list->routes must be freed by the caller.
+ * @return MAGI_OK on success, or MAGI_ERR_NOMEM.
+ */
+static int router_collect_static_routes(const RouterState* state, RouterRouteList* list) {
+  list->routes = NULL;
+  list->count = 0U;
+  size_t total = fib_count(state->fib);
+  if (total == 0U) {
+    return MAGI_OK;
+  }
+
+  list->routes = malloc(total * sizeof(*list->routes));
+  if (list->routes == NULL) {
     magi_errno = MAGI_ERR_NOMEM;
     return MAGI_ERR_NOMEM;
   }
 
-  state->routes = routes;
-  state->route_cap = new_cap;
+  fib_foreach(state->fib, collect_static_route, list);
+  qsort(list->routes, list->count, sizeof(*list->routes), compare_routes_desc);
   return MAGI_OK;
 }
 
 /**
- * @brief Check whether a routing table entry matches a destination IP.
+ * @brief Cache the forwarding decision just made for a flow.
  *
- * Uses ipv4_addr_in_network to test (dst_ip & mask) == network.
+ * The entry lives no longer than the next hop's neighbor entry would
+ * without being confirmed again.
  *
- * @param route  The routing table entry to test.
- * @param dst_ip The destination IPv4 address.
- * @return true if the route covers the destination.
+ * @param router  The router instance.
+ * @param emit    Egress, next hop and the flow to learn.
+ * @param dst_mac The resolved next-hop MAC.
  */
-static bool route_matches(const RoutingTableEntry* route, const uint8_t dst_ip[4]) {
-  return route != NULL && dst_ip != NULL &&
-         ipv4_addr_in_network(dst_ip, route->network, route->mask);
+static void router_flow_learn(Router* router, const RouterFragmentCtx* emit,
+                              const uint8_t dst_mac[ROUTER_ETHERNET_MAC_LEN]) {
+  RouterState* state = router_state(router);
+  if (emit->learn == NULL || state->flows == NULL) {
+    return;
+  }
+
+  FlowAction action = {0};
+  action.egress = emit->egress;
+  memcpy(action.next_hop, emit->next_hop, sizeof(action.next_hop));
+  memcpy(action.dst_mac, dst_mac, sizeof(action.dst_mac));
+  action.expires_ms = neighbor_expires_ms(state->neighbors, emit->next_hop);
+  flow_cache_insert(state->flows, emit->learn, &action);
 }
 
 /**
- * @brief Check whether a routing table entry matches a given network/prefix.
+ * @brief Send one IPv4 datagram or fragment towards its next hop.
  *
- * Used to detect duplicate routes and for route removal.
+ * Uses the MAC in the context when the flow cache supplied one. Otherwise
+ * the neighbor table is consulted; on a hit the flow is cached, and on a
+ * miss the packet is queued and an ARP request is sent (at most one per
+ * NEIGHBOR_RETRANS_MS).
  *
- * @param route      The routing table entry.
- * @param network    The network address to compare.
- * @param prefix_len The prefix length to compare.
- * @return true if both network and prefix_len match.
+ * @param pkt Buffer starting at the IPv4 header; consumed.
+ * @param ctx RouterFragmentCtx naming the router, egress and next hop.
+ * @return MAGI_OK on success, or an error code.
  */
-static bool static_route_same_dest(const RoutingTableEntry* route, const uint8_t network[4],
-                                   int prefix_len) {
-  return route != NULL && network != NULL && route->prefix_len == prefix_len &&
-         ipv4_addr_equal(route->network, network);
+static int router_emit_ipv4(PktBuf* pkt, void* ctx) {
+  const RouterFragmentCtx* emit = ctx;
+  Router* router = emit->router;
+  Interface* egress = emit->egress;
+  RouterState* state = router_state(router);
+
+  uint16_t vlan_id = egress->vlan_id;
+  if (emit->dst_mac != NULL) {
+    return router_send_ethernet_pkt(router, egress, emit->dst_mac, ROUTER_ETHERTYPE_IPV4, pkt,
+                                    vlan_id);
+  }
+
+  uint8_t dst_mac[ROUTER_ETHERNET_MAC_LEN];
+  if (router_lookup_arp(router, emit->next_hop, dst_mac)) {
+    router_flow_learn(router, emit, dst_mac);
+    return router_send_ethernet_pkt(router, egress, dst_mac, ROUTER_ETHERTYPE_IPV4, pkt, vlan_id);
+  }
+
+  int status = queue_pending_packet(router, emit->next_hop, egress->port_number, vlan_id, pkt);
+  if (status == MAGI_OK &&
+      neighbor_start_probe(state->neighbors, emit->next_hop, neighbor_now_ms())) {
+    status = router_send_arp_request(router, egress, emit->next_hop, vlan_id);
+  }
+  return status;
 }
 
 /**
- * @brief Derive a directly connected routing table entry from an interface.
+ * @brief Serialise an IPv4 packet and send it out of a known egress.
  *
- * Parses the interface's CIDR address and populates the RoutingTableEntry
- * with the network, mask, prefix length, port, and metric 1.
+ * The packet is packed once into a packet buffer with Ethernet headroom
+ * and fragmented if it exceeds the egress link MTU. Callers check DF
+ * before getting here.
  *
- * @param iface The interface to derive from.
- * @param out   Output RoutingTableEntry.
- * @return true if the interface has a valid IP and the entry was populated.
+ * @param emit Egress and next hop, plus the cached MAC or flow to learn.
+ * @param pkt  The IPv4 packet to send.
+ * @return MAGI_OK on success, or an error code.
  */
-static bool interface_connected_route(const Interface* iface, RoutingTableEntry* out) {
-  if (iface == NULL || out == NULL || iface->ip_address[0] == '\0') {
-    return false;
+static int router_transmit_ipv4(RouterFragmentCtx* emit, IPv4Packet* pkt) {
+  size_t bytes_len = IPV4_HEADER_LEN + pkt->payload_len;
+  PktBuf* buf = pktbuf_new(PKTBUF_HEADROOM, bytes_len);
+  if (buf == NULL) {
+    return MAGI_ERR_NOMEM;
   }
 
-  memset(out, 0, sizeof(*out));
-  uint8_t iface_ip[4];
-  if (ipv4_parse_cidr(iface->ip_address, iface_ip, out->network, out->mask, &out->prefix_len) !=
-      MAGI_OK) {
-    return false;
+  int status = ipv4_pack(pkt, pktbuf_put(buf, bytes_len), bytes_len);
+  if (status != MAGI_OK) {
+    pktbuf_release(buf);
+    return status;
   }
 
-  (void)iface_ip;
-  out->out_port = iface->port_number;
-  out->metric = 1U;
-  return true;
+  return ipv4_fragment(buf, interface_mtu(emit->egress), router_emit_ipv4, emit);
 }
 
 /**
- * @brief Look up a route and send an IPv4 packet from a router.
+ * @brief Send a received datagram on with its TTL decremented, without re-serialising it.
  *
- * Performs an LPM lookup for the destination IP. If found, serialises
- * the packet and sends it as an Ethernet frame via the egress interface.
- * If the next-hop MAC is not in the ARP cache, the packet is queued
- * and an ARP request is sent.
+ * The buffer the link delivered is taken over when nothing else holds
+ * it; otherwise the datagram is copied once. Only the TTL and header
+ * checksum change (RFC 1624 incremental update), and the new Ethernet
+ * header goes into the headroom where the old one was. Datagrams over
+ * the egress MTU are repacked and fragmented instead.
  *
- * @param router The router instance.
- * @param pkt    The IPv4 packet to forward.
+ * @param emit Egress and next hop, plus the cached MAC or flow to learn.
+ * @param rx   Where the datagram arrived and the bytes it arrived in.
+ * @param pkt  The parsed datagram; its TTL must be above 1.
  * @return MAGI_OK on success, or an error code.
  */
-static int router_send_ipv4_packet(Router* router, IPv4Packet* pkt) {
+static int router_forward_datagram(RouterFragmentCtx* emit, const RouterRx* rx,
+                                   const IPv4Packet* pkt) {
+  uint16_t mtu = interface_mtu(emit->egress);
+  if (mtu != 0U && pkt->total_len > mtu) {
+    IPv4Packet forward = *pkt;
+    forward.ttl = (uint8_t)(pkt->ttl - 1U);
+    return router_transmit_ipv4(emit, &forward);
+  }
+
+  size_t l2_len = (size_t)(rx->raw - rx->frame);
+  PktBuf* buf = interface_claim_rx(rx->iface, rx->frame);
+  if (buf != NULL && pktbuf_headroom(buf) + l2_len >= ROUTER_ETHERNET_VLAN_LEN) {
+    (void)pktbuf_pull(buf, l2_len);
+    pktbuf_trim(buf, pkt->total_len);
+  } else {
+    /* No room for a tagged header in a claimed buffer: copy out of it, then let it go. */
+    PktBuf* copy = pktbuf_copy(PKTBUF_HEADROOM, rx->raw, pkt->total_len);
+    pktbuf_release(buf);
+    buf = copy;
+    if (buf == NULL) {
+      return MAGI_ERR_NOMEM;
+    }
+  }
+
+  uint8_t* header = buf->data;
+  uint16_t old_word = READ_U16(header, 8U);
+  header[8] = (uint8_t)(header[8] - 1U);
+  WRITE_U16(header, 10U, checksum_adjust16(READ_U16(header, 10U), old_word, READ_U16(header, 8U)));
+  return router_emit_ipv4(buf, emit);
+}
+
+int router_send_ipv4(Router* router, IPv4Packet* pkt) {
   RouterState* state = router_state(router);
   if (router == NULL || pkt == NULL || state == NULL) {
     magi_errno = MAGI_ERR_BADARGS;
@@ -918,6 +1083,7 @@ static int router_send_ipv4_packet(Router* router, IPv4Packet* pkt) {
 
   const RoutingTableEntry* route = lpm_lookup(router, pkt->dst_ip);
   if (route == NULL) {
+    node_count(router_as_node(router), MAGI_NODE_DROP_NO_ROUTE);
     magi_errno = MAGI_ERR_NOROUTE;
     return MAGI_ERR_NOROUTE;
   }
@@ -928,31 +1094,10 @@ static int router_send_ipv4_packet(Router* router, IPv4Packet* pkt) {
     return MAGI_ERR_NOLINK;
   }
 
-  uint8_t* bytes = NULL;
-  size_t bytes_len = 0U;
-  int status = ipv4_packet_to_bytes(pkt, &bytes, &bytes_len);
-  if (status != MAGI_OK) {
-    return status;
-  }
-
   uint8_t next_hop[4];
   memcpy(next_hop, ipv4_addr_is_zero(route->next_hop) ? pkt->dst_ip : route->next_hop, 4U);
-
-  uint8_t dst_mac[ROUTER_ETHERNET_MAC_LEN];
-  uint16_t vlan_id = egress->vlan_id;
-  if (router_lookup_arp(router, next_hop, dst_mac)) {
-    status = router_send_ethernet(router, egress, dst_mac, ROUTER_ETHERTYPE_IPV4, bytes, bytes_len,
-                                  vlan_id);
-    free(bytes);
-    return status;
-  }
-
-  status = queue_pending_packet(router, next_hop, egress->port_number, vlan_id, bytes, bytes_len);
-  if (status == MAGI_OK) {
-    status = router_send_arp_request(router, egress, next_hop, vlan_id);
-  }
-  free(bytes);
-  return status;
+  RouterFragmentCtx emit = {.router = router, .egress = egress, .next_hop = next_hop};
+  return router_transmit_ipv4(&emit, pkt);
 }
 
 /**
@@ -967,10 +1112,12 @@ static int router_send_ipv4_packet(Router* router, IPv4Packet* pkt) {
  * @param original_raw The raw bytes of the original IP header.
  * @param type         ICMP type (Time Exceeded or Destination Unreachable).
  * @param code         ICMP code.
+ * @param next_hop_mtu MTU reported in Fragmentation Needed messages, else 0.
  * @return MAGI_OK on success, or an error code.
  */
 static int router_send_icmp_error(Router* router, const IPv4Packet* original_pkt,
-                                  const uint8_t* original_raw, uint8_t type, uint8_t code) {
+                                  const uint8_t* original_raw, uint8_t type, uint8_t code,
+                                  uint16_t next_hop_mtu) {
   if (router == NULL || original_pkt == NULL || original_raw == NULL) {
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
@@ -1009,6 +1156,7 @@ static int router_send_icmp_error(Router* router, const IPv4Packet* original_pkt
   ICMPMessage icmp = {0};
   icmp.type = type;
   icmp.code = code;
+  icmp.sequence = next_hop_mtu;
   icmp.payload = error_payload;
   icmp.payload_len = error_payload_len;
 
@@ -1034,7 +1182,7 @@ static int router_send_icmp_error(Router* router, const IPv4Packet* original_pkt
   ipv4_address_to_string(original_pkt->src_ip, dst_text);
   LOG(router_name(router), "Send ICMP type=%u code=%u to %s", (unsigned)type, (unsigned)code,
       dst_text);
-  status = router_send_ipv4_packet(router, &reply);
+  status = router_send_ipv4(router, &reply);
   free(icmp_bytes);
   return status;
 }
@@ -1089,16 +1237,34 @@ static int router_send_echo_reply(Router* router, Interface* ingress, const IPv4
   reply.payload = icmp_bytes;
   reply.payload_len = icmp_len;
 
-  status = router_send_ipv4_packet(router, &reply);
+  status = router_send_ipv4(router, &reply);
   free(icmp_bytes);
   return status;
 }
 
+/**
+ * @brief Pass a UDP datagram for the RIP port to the registered handler.
+ *
+ * @param router The router instance.
+ * @param pkt    Whole (reassembled) UDP datagram addressed to the router.
+ */
+static void router_dispatch_rip(Router* router, const IPv4Packet* pkt) {
+  UDPDatagram dgram = {0};
+  if (udp_unpack(&dgram, pkt->src_ip, pkt->dst_ip, pkt->payload, pkt->payload_len) != MAGI_OK ||
+      dgram.dst_port != ROUTER_RIP_PORT) {
+    return;
+  }
+  router_state(router)->rip_handler(router_as_node(router), dgram.payload, dgram.payload_len,
+                                    pkt->src_ip);
+}
+
 /**
  * @brief Check whether an IPv4 packet is addressed to the router itself.
  *
  * If the destination IP matches one of the router's interfaces and the
- * protocol is ICMP, it handles the message (currently only Echo Reply).
+ * protocol is ICMP, it handles the message (currently only Echo Reply);
+ * UDP goes to the RIP handler when one is registered. Fragmented
+ * datagrams are reassembled first.
  * Always returns true if the packet is destined for the router, so that
  * the caller does not attempt to forward it.
  *
@@ -1113,22 +1279,34 @@ static bool router_handle_local_ipv4(Router* router, Interface* iface, const IPv
     return false;
   }
 
-  if (pkt->protocol != IPV4_PROTOCOL_ICMP) {
+  bool to_rip = pkt->protocol == IPV4_PROTOCOL_UDP && router_state(router)->rip_handler != NULL;
+  if (pkt->protocol != IPV4_PROTOCOL_ICMP && !to_rip) {
     return true;
   }
 
-  ICMPMessage msg = {0};
-  if (icmp_unpack(&msg, pkt->payload, pkt->payload_len) != MAGI_OK) {
-    return true;
+  IPv4Packet whole = *pkt;
+  uint8_t* datagram = NULL;
+  if (ipv4_is_fragment(pkt)) {
+    size_t datagram_len = 0U;
+    if (ipv4_reasm_input(router_state(router)->reasm, pkt, &datagram, &datagram_len) != MAGI_OK ||
+        datagram == NULL || ipv4_unpack(&whole, datagram, datagram_len) != MAGI_OK) {
+      free(datagram);
+      return true;
+    }
   }
 
-  if (msg.type == ICMP_TYPE_ECHO_REQUEST) {
+  ICMPMessage msg = {0};
+  if (to_rip) {
+    router_dispatch_rip(router, &whole);
+  } else if (icmp_unpack(&msg, whole.payload, whole.payload_len) == MAGI_OK &&
+      msg.type == ICMP_TYPE_ECHO_REQUEST) {
     char src_text[16];
-    ipv4_address_to_string(pkt->src_ip, src_text);
+    ipv4_address_to_string(whole.src_ip, src_text);
     LOG(router_name(router), "ICMP echo request for router interface from %s", src_text);
-    (void)router_send_echo_reply(router, iface != NULL ? iface : matching_iface, pkt, &msg);
+    (void)router_send_echo_reply(router, iface != NULL ? iface : matching_iface, &whole, &msg);
   }
 
+  free(datagram);
   return true;
 }
 
@@ -1147,6 +1325,7 @@ static void router_handle_arp(Router* router, Interface* iface, const RouterFram
   RouterArpMessage message = {0};
   if (router == NULL || iface == NULL || frame == NULL ||
       arp_from_bytes(frame->payload, frame->payload_len, &message) != MAGI_OK) {
+    node_count(router_as_node(router), MAGI_NODE_DROP_MALFORMED);
     LOG(router_name(router), "Drop malformed ARP payload");
     return;
   }
@@ -1190,28 +1369,51 @@ static void router_handle_arp(Router* router, Interface* iface, const RouterFram
   free(arp_bytes);
 }
 
+/**
+ * @brief Log a forwarded packet; the formatting is skipped when L3 info is off.
+ *
+ * @param router   The router instance.
+ * @param pkt      The packet as received.
+ * @param out_port The egress port number.
+ */
+static void router_log_forward(const Router* router, const IPv4Packet* pkt, uint16_t out_port) {
+  if (!magi_log_enabled(MAGI_LOG_SUBSYS, MAGI_LOG_INFO)) {
+    return;
+  }
+
+  char dst_text[16];
+  ipv4_address_to_string(pkt->dst_ip, dst_text);
+  LOG(router_name(router), "Forward IPv4 dst=%s ttl=%u out_port=%u", dst_text,
+      (unsigned)(pkt->ttl - 1U), (unsigned)out_port);
+}
+
 /**
  * @brief Forward an IPv4 packet not destined for the router.
  *
  * Decrements TTL (if TTL <=1, sends ICMP Time Exceeded), performs an
- * LPM lookup, and sends the packet via router_send_ipv4_packet. If no
- * route is found, sends ICMP Destination Unreachable.
+ * LPM lookup, and sends the packet along the route it found. If no
+ * route is found, sends ICMP Destination Unreachable; if the packet is
+ * larger than the egress MTU and has DF set, sends Fragmentation Needed.
  *
- * @param router       The router instance.
- * @param original_raw The raw IP header bytes (for embedding in ICMP errors).
- * @param pkt          The received IPv4 packet to forward.
+ * @param router The router instance.
+ * @param rx     Where the packet arrived; rx->raw is embedded in ICMP errors.
+ * @param pkt    The received IPv4 packet to forward.
+ * @param learn  Flow to cache once the next hop resolves, or NULL.
  */
-static void router_forward_ipv4(Router* router, const uint8_t* original_raw,
-                                const IPv4Packet* pkt) {
-  if (router == NULL || original_raw == NULL || pkt == NULL) {
+static void router_forward_ipv4(Router* router, const RouterRx* rx, const IPv4Packet* pkt,
+                                const FlowKey* learn) {
+  if (router == NULL || rx == NULL || pkt == NULL) {
     return;
   }
 
+  const uint8_t* original_raw = rx->raw;
+
   if (pkt->ttl <= 1U) {
     char src_text[16];
     ipv4_address_to_string(pkt->src_ip, src_text);
+    node_count(router_as_node(router), MAGI_NODE_DROP_TTL);
     LOG(router_name(router), "TTL expired while forwarding packet from %s", src_text);
-    (void)router_send_icmp_error(router, pkt, original_raw, ICMP_TYPE_TIME_EXCEEDED, 0U);
+    (void)router_send_icmp_error(router, pkt, original_raw, ICMP_TYPE_TIME_EXCEEDED, 0U, 0U);
     return;
   }
 
@@ -1219,60 +1421,271 @@ static void router_forward_ipv4(Router* router, const uint8_t* original_raw,
   if (route == NULL) {
     char dst_text[16];
     ipv4_address_to_string(pkt->dst_ip, dst_text);
+    node_count(router_as_node(router), MAGI_NODE_DROP_NO_ROUTE);
     LOG(router_name(router), "No route to %s", dst_text);
-    (void)router_send_icmp_error(router, pkt, original_raw, ICMP_TYPE_DEST_UNREACHABLE, 0U);
+    (void)router_send_icmp_error(router, pkt, original_raw, ICMP_TYPE_DEST_UNREACHABLE, 0U,
+                                 0U);
     return;
   }
 
-  IPv4Packet forward = *pkt;
-  forward.ttl = (uint8_t)(pkt->ttl - 1U);
-  char dst_text[16];
-  ipv4_address_to_string(pkt->dst_ip, dst_text);
-  LOG(router_name(router), "Forward IPv4 dst=%s ttl=%u out_port=%u", dst_text,
-      (unsigned)forward.ttl, (unsigned)route->out_port);
-  (void)router_send_ipv4_packet(router, &forward);
+  Interface* egress = node_get_interface(router_as_node(router), route->out_port);
+  uint16_t mtu = interface_mtu(egress);
+  if ((pkt->flags_frag_off & IPV4_FLAG_DF) != 0U && mtu != 0U && pkt->total_len > mtu) {
+    char dst_text[16];
+    ipv4_address_to_string(pkt->dst_ip, dst_text);
+    LOG(router_name(router), "Packet to %s needs fragmentation but has DF set (mtu=%u)", dst_text,
+        (unsigned)mtu);
+    (void)router_send_icmp_error(router, pkt, original_raw, ICMP_TYPE_DEST_UNREACHABLE,
+                                 ICMP_CODE_FRAG_NEEDED, mtu);
+    return;
+  }
+
+  if (egress == NULL || egress->link == NULL) {
+    magi_errno = MAGI_ERR_NOLINK;
+    return;
+  }
+
+  uint8_t next_hop[4];
+  memcpy(next_hop, ipv4_addr_is_zero(route->next_hop) ? pkt->dst_ip : route->next_hop, 4U);
+  RouterFragmentCtx emit = {
+      .router = router, .egress = egress, .next_hop = next_hop, .learn = learn};
+  router_log_forward(router, pkt, route->out_port);
+  (void)router_forward_datagram(&emit, rx, pkt);
 }
 
-void router_handle_receive(Node* node, Interface* in_iface, const uint8_t* data, size_t len) {
-  Router* router = router_from_node(node);
-  arena_reset(node->arena);
-  RouterFrame frame = {0};
+/**
+ * @brief Key a received IPv4 packet for the flow cache.
+ *
+ * Ports are read only from TCP and UDP packets that start at offset 0;
+ * later fragments of a flow share a key with ports 0.
+ *
+ * @param in_iface The ingress interface.
+ * @param frame    The parsed Ethernet frame.
+ * @param pkt      The received IPv4 packet.
+ * @param key      Receives the flow key.
+ */
+static void router_flow_key(const Interface* in_iface, const RouterFrame* frame,
+                            const IPv4Packet* pkt, FlowKey* key) {
+  key->addrs = ((uint64_t)READ_U32(pkt->src_ip, 0U) << 32U) | READ_U32(pkt->dst_ip, 0U);
+  key->ports = 0U;
+  if ((pkt->protocol == IPV4_PROTOCOL_TCP || pkt->protocol == IPV4_PROTOCOL_UDP) &&
+      (pkt->flags_frag_off & IPV4_FRAG_OFFSET_MASK) == 0U && pkt->payload_len >= 4U) {
+    key->ports = READ_U32(pkt->payload, 0U);
+  }
+  key->in_port = in_iface->port_number;
+  key->vlan_id = frame->vlan_present ? frame->vlan_id : 0U;
+  key->protocol = pkt->protocol;
+}
+
+/**
+ * @brief Get the router's flow cache, emptying it first if an interface
+ * or neighbor changed since it was last used.
+ *
+ * @param router The router instance.
+ * @return The flow cache, or NULL if it is disabled.
+ */
+static FlowCache* router_flow_cache(Router* router) {
+  RouterState* state = router_state(router);
+  Node* node = router_as_node(router);
+  if (state->flows == NULL) {
+    return NULL;
+  }
+
+  uint32_t neighbor_gen = neighbor_generation(state->neighbors);
+  if (state->flow_iface_gen != node->iface_gen || state->flow_neighbor_gen != neighbor_gen) {
+    flow_cache_invalidate(state->flows);
+    state->flow_iface_gen = node->iface_gen;
+    state->flow_neighbor_gen = neighbor_gen;
+  }
+  return state->flows;
+}
+
+/**
+ * @brief Forward a packet with a cached decision, skipping LPM and ARP.
+ *
+ * Packets that need an ICMP error (TTL running out, DF over the egress
+ * MTU) are left to the slow path, which reports them.
+ *
+ * @param router The router instance.
+ * @param action The cached forwarding decision for the packet's flow.
+ * @param rx     Where the packet arrived.
+ * @param pkt    The received IPv4 packet.
+ * @return true if the packet was forwarded.
+ */
+static bool router_forward_cached(Router* router, const FlowAction* action, const RouterRx* rx,
+                                  const IPv4Packet* pkt) {
+  Interface* egress = action->egress;
+  uint16_t mtu = interface_mtu(egress);
+  if (pkt->ttl <= 1U || egress->link == NULL ||
+      ((pkt->flags_frag_off & IPV4_FLAG_DF) != 0U && mtu != 0U && pkt->total_len > mtu)) {
+    return false;
+  }
+
+  node_count(router_as_node(router), MAGI_NODE_FLOW_HITS);
+  router_log_forward(router, pkt, egress->port_number);
+  RouterFragmentCtx emit = {
+      .router = router, .egress = egress, .next_hop = action->next_hop, .dst_mac = action->dst_mac};
+  (void)router_forward_datagram(&emit, rx, pkt);
+  return true;
+}
+
+/**
+ * @brief Parse stage: decode a received frame down to its IPv4 header.
+ *
+ * ARP is answered here, since it only updates the neighbor table; other
+ * frames that are not IPv4 for this router are dropped.
+ *
+ * @param router   The router instance.
+ * @param in_iface The ingress interface.
+ * @param data     Raw Ethernet frame bytes.
+ * @param len      Frame length.
+ * @param slot     Receives the parsed frame and packet.
+ * @return true if the datagram goes on to the lookup stage.
+ */
+static bool router_rx_parse(Router* router, Interface* in_iface, const uint8_t* data, size_t len,
+                            RouterRxSlot* slot) {
+  Node* node = router_as_node(router);
+  memset(&slot->frame, 0, sizeof(slot->frame));
   if (router == NULL || in_iface == NULL || data == NULL ||
-      parse_frame(data, len, &frame) != MAGI_OK) {
+      parse_frame(data, len, &slot->frame) != MAGI_OK) {
+    node_count(node, MAGI_NODE_DROP_MALFORMED);
     LOG(node != NULL ? node->name : "ROUTER", "Drop malformed Ethernet frame");
-    return;
+    return false;
   }
 
-  if (!frame_vlan_allowed(in_iface, &frame)) {
+  const RouterFrame* frame = &slot->frame;
+  if (!frame_vlan_allowed(in_iface, frame)) {
+    node_count(node, MAGI_NODE_DROP_VLAN);
     LOG(router_name(router), "Drop frame on Port %u: VLAN %u is not allowed",
-        (unsigned)in_iface->port_number, (unsigned)frame.vlan_id);
-    return;
+        (unsigned)in_iface->port_number, (unsigned)frame->vlan_id);
+    return false;
   }
 
-  if (frame.ethertype == ROUTER_ETHERTYPE_ARP) {
-    router_handle_arp(router, in_iface, &frame);
-    return;
+  if (frame->ethertype == ROUTER_ETHERTYPE_ARP) {
+    router_handle_arp(router, in_iface, frame);
+    return false;
   }
 
-  if (frame.ethertype != ROUTER_ETHERTYPE_IPV4) {
-    return;
+  if (frame->ethertype != ROUTER_ETHERTYPE_IPV4) {
+    return false;
   }
 
-  if (!mac_equal(frame.dst_mac, in_iface->mac) && !mac_is_broadcast(frame.dst_mac)) {
-    return;
+  if (!mac_equal(frame->dst_mac, in_iface->mac) && !mac_is_broadcast(frame->dst_mac)) {
+    return false;
   }
 
-  IPv4Packet pkt = {0};
-  if (ipv4_unpack(&pkt, frame.payload, frame.payload_len) != MAGI_OK) {
+  memset(&slot->pkt, 0, sizeof(slot->pkt));
+  if (ipv4_unpack(&slot->pkt, frame->payload, frame->payload_len) != MAGI_OK) {
+    node_count(node, MAGI_NODE_DROP_MALFORMED);
     LOG(router_name(router), "Drop IPv4 packet: bad header/checksum");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Lookup stage: key the datagram and probe the flow cache.
+ *
+ * @param in_iface The ingress interface.
+ * @param slot     Parsed datagram; receives the key and any cached decision.
+ * @param flows    The router's flow cache, or NULL if it is disabled.
+ * @param now_ms   Current neighbor-table time.
+ */
+static void router_rx_lookup(const Interface* in_iface, RouterRxSlot* slot, FlowCache* flows,
+                             uint64_t now_ms) {
+  router_flow_key(in_iface, &slot->frame, &slot->pkt, &slot->key);
+  const FlowAction* action = flow_cache_lookup(flows, &slot->key, now_ms);
+  slot->hit = action != NULL;
+  if (slot->hit) {
+    slot->action = *action;
+    slot->flow_gen = flow_cache_generation(flows);
+  }
+}
+
+/**
+ * @brief Transmit stage: forward on the cached decision, or deliver
+ * locally or route the datagram on a miss.
+ *
+ * A cached decision is used only if the cache was not dropped since the
+ * lookup stage; an earlier frame of the same burst may have changed a
+ * route or a neighbor.
+ *
+ * @param router   The router instance.
+ * @param in_iface The ingress interface.
+ * @param data     Start of the Ethernet frame.
+ * @param slot     Datagram from the lookup stage.
+ */
+static void router_rx_transmit(Router* router, Interface* in_iface, const uint8_t* data,
+                               const RouterRxSlot* slot) {
+  RouterRx rx = {.iface = in_iface, .frame = data, .raw = slot->frame.payload};
+  FlowCache* flows = router_flow_cache(router);
+  if (flows != NULL) {
+    if (slot->hit && slot->flow_gen == flow_cache_generation(flows) &&
+        router_forward_cached(router, &slot->action, &rx, &slot->pkt)) {
+      return;
+    }
+    node_count(router_as_node(router), MAGI_NODE_FLOW_MISSES);
+  }
+
+  if (router_handle_local_ipv4(router, in_iface, &slot->pkt)) {
     return;
   }
 
-  if (router_handle_local_ipv4(router, in_iface, &pkt)) {
+  router_forward_ipv4(router, &rx, &slot->pkt, flows != NULL ? &slot->key : NULL);
+}
+
+void router_handle_receive(Node* node, Interface* in_iface, const uint8_t* data, size_t len) {
+  Router* router = router_from_node(node);
+  arena_reset(node->arena);
+  RouterRxSlot slot;
+  if (!router_rx_parse(router, in_iface, data, len, &slot)) {
     return;
   }
 
-  router_forward_ipv4(router, frame.payload, &pkt);
+  router_rx_lookup(in_iface, &slot, router_flow_cache(router), neighbor_now_ms());
+  router_rx_transmit(router, in_iface, data, &slot);
+}
+
+/**
+ * @brief Handle a burst of frames one pipeline stage at a time: parse
+ * every frame, then probe the flow cache for every datagram, then
+ * forward them all, each with its buffer claimable for in-place
+ * forwarding.
+ *
+ * @param node   The router's node.
+ * @param frames Received frames; handled NODE_RX_BURST at a time.
+ * @param count  Number of frames.
+ */
+static void router_handle_receive_batch(Node* node, RxFrame* frames, size_t count) {
+  Router* router = router_from_node(node);
+  arena_reset(node->arena);
+  RouterRxSlot slots[NODE_RX_BURST];
+  bool live[NODE_RX_BURST];
+
+  for (size_t base = 0U; base < count; base += NODE_RX_BURST) {
+    RxFrame* burst = &frames[base];
+    size_t size = count - base < NODE_RX_BURST ? count - base : NODE_RX_BURST;
+    for (size_t index = 0U; index < size; ++index) {
+      live[index] = router_rx_parse(router, burst[index].iface, burst[index].data,
+                                    burst[index].len, &slots[index]);
+    }
+
+    FlowCache* flows = router_flow_cache(router);
+    uint64_t now_ms = neighbor_now_ms();
+    for (size_t index = 0U; index < size; ++index) {
+      if (live[index]) {
+        router_rx_lookup(burst[index].iface, &slots[index], flows, now_ms);
+      }
+    }
+
+    for (size_t index = 0U; index < size; ++index) {
+      if (live[index]) {
+        PktBuf* outer = interface_rx_begin(&burst[index]);
+        router_rx_transmit(router, burst[index].iface, burst[index].data, &slots[index]);
+        interface_rx_end(&burst[index], outer);
+      }
+    }
+  }
 }
 
 Router* router_new(const char* name) {
@@ -1290,6 +1703,7 @@ Router* router_new(const char* name) {
   node->data = state;
   node->data_free = router_state_free;
   node->handle_receive = router_handle_receive;
+  node->handle_receive_batch = router_handle_receive_batch;
   return router_from_node(node);
 }
 
@@ -1299,6 +1713,11 @@ void router_free(Router* router) {
 
 int router_add_route(Router* router, const char* dest_cidr, const char* next_hop_ip,
                      uint16_t out_port) {
+  return router_add_route_metric(router, dest_cidr, next_hop_ip, out_port, 1U);
+}
+
+int router_add_route_metric(Router* router, const char* dest_cidr, const char* next_hop_ip,
+                            uint16_t out_port, uint8_t metric) {
   RouterState* state = router_state(router);
   if (state == NULL || dest_cidr == NULL || out_port == 0U) {
     magi_errno = MAGI_ERR_BADARGS;
@@ -1320,24 +1739,11 @@ int router_add_route(Router* router, const char* dest_cidr, const char* next_hop
   }
 
   route.out_port = out_port;
-  route.metric = 1U;
-
-  for (size_t index = 0U; index < state->route_count; ++index) {
-    if (static_route_same_dest(&state->routes[index], route.network, route.prefix_len)) {
-      state->routes[index] = route;
-      qsort(state->routes, state->route_count, sizeof(*state->routes), compare_routes_desc);
-      return MAGI_OK;
-    }
-  }
-
-  int status = ensure_route_capacity(state, state->route_count + 1U);
-  if (status != MAGI_OK) {
-    return status;
-  }
+  route.metric = metric;
 
-  state->routes[state->route_count++] = route;
-  qsort(state->routes, state->route_count, sizeof(*state->routes), compare_routes_desc);
-  return MAGI_OK;
+  router_sync_connected(router);
+  flow_cache_invalidate(state->flows);
+  return fib_insert(state->fib, &route, FIB_ORIGIN_STATIC);
 }
 
 int router_remove_route(Router* router, const char* dest_cidr) {
@@ -1353,74 +1759,100 @@ int router_remove_route(Router* router, const char* dest_cidr) {
     return MAGI_ERR_BADARGS;
   }
 
-  for (size_t index = 0U; index < state->route_count; ++index) {
-    if (static_route_same_dest(&state->routes[index], parsed.network, parsed.prefix_len)) {
-      if (index + 1U < state->route_count) {
-        memmove(&state->routes[index], &state->routes[index + 1U],
-                (state->route_count - index - 1U) * sizeof(*state->routes));
-      }
-      state->route_count--;
-      return MAGI_OK;
+  router_sync_connected(router);
+  uint8_t origin = FIB_ORIGIN_CONNECTED;
+  if (fib_find(state->fib, parsed.network, parsed.prefix_len, &origin) == NULL ||
+      origin != FIB_ORIGIN_STATIC) {
+    magi_errno = MAGI_ERR_NOROUTE;
+    return MAGI_ERR_NOROUTE;
+  }
+
+  int status = fib_remove(state->fib, parsed.network, parsed.prefix_len);
+  if (status != MAGI_OK) {
+    return status;
+  }
+  flow_cache_invalidate(state->flows);
+
+  for (size_t index = 0U; index < state->connected_count; ++index) {
+    const RoutingTableEntry* connected = &state->connected[index].route;
+    if (connected->prefix_len == parsed.prefix_len &&
+        ipv4_addr_equal(connected->network, parsed.network)) {
+      return fib_insert(state->fib, connected, FIB_ORIGIN_CONNECTED);
     }
   }
 
-  magi_errno = MAGI_ERR_NOROUTE;
-  return MAGI_ERR_NOROUTE;
+  return MAGI_OK;
 }
 
-const RoutingTableEntry* lpm_lookup(Router* router, const uint8_t dst_ip[4]) {
+int router_set_flow_cache(Router* router, size_t slots) {
   RouterState* state = router_state(router);
-  if (state == NULL || dst_ip == NULL) {
-    return NULL;
+  if (state == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
   }
 
-  const RoutingTableEntry* best = NULL;
-  int best_prefix = -1;
-  for (size_t index = 0U; index < state->route_count; ++index) {
-    const RoutingTableEntry* route = &state->routes[index];
-    if (route->prefix_len > best_prefix && route_matches(route, dst_ip)) {
-      best = route;
-      best_prefix = route->prefix_len;
+  FlowCache* flows = NULL;
+  if (slots > 0U) {
+    flows = flow_cache_new(slots);
+    if (flows == NULL) {
+      return MAGI_ERR_NOMEM;
     }
   }
 
-  Node* node = router_as_node(router);
-  if (node != NULL && node->interfaces != NULL) {
-    for (size_t index = 0U; index < node->interfaces->capacity; ++index) {
-      HashEntry* entry = &node->interfaces->entries[index];
-      if (entry->key == NULL || entry->tombstone) {
-        continue;
-      }
+  flow_cache_free(state->flows);
+  state->flows = flows;
+  return MAGI_OK;
+}
 
-      RoutingTableEntry connected = {0};
-      if (interface_connected_route(entry->value, &connected) &&
-          connected.prefix_len > best_prefix && route_matches(&connected, dst_ip)) {
-        state->scratch_route = connected;
-        best = &state->scratch_route;
-        best_prefix = connected.prefix_len;
-      }
-    }
+void router_flow_cache_flush(Router* router) {
+  RouterState* state = router_state(router);
+  if (state != NULL) {
+    flow_cache_invalidate(state->flows);
+  }
+}
+
+void router_set_rip_handler(Router* router, rip_dispatch_fn handler) {
+  RouterState* state = router_state(router);
+  if (state != NULL) {
+    state->rip_handler = handler;
+  }
+}
+
+const RoutingTableEntry* lpm_lookup(Router* router, const uint8_t dst_ip[4]) {
+  RouterState* state = router_state(router);
+  if (state == NULL || dst_ip == NULL) {
+    return NULL;
   }
 
-  return best;
+  router_sync_connected(router);
+  node_count(router_as_node(router), MAGI_NODE_FIB_LOOKUPS);
+  return fib_lookup(state->fib, dst_ip);
 }
 
 /**
- * @brief hashmap_foreach callback to print a single ARP cache entry.
+ * @brief neighbor_foreach callback to print a single neighbor entry.
  *
- * Logs the IP-to-MAC mapping using the node name from ctx.
+ * Logs the IP-to-MAC mapping, state and age using the node name from ctx.
  *
- * @param key   The IP address string.
- * @param value The MAC address string.
- * @param ctx   The node name string (for LOG output).
+ * @param entry  The neighbor entry.
+ * @param now_ms Current time for age display.
+ * @param ctx    The node name string (for LOG output).
  */
-static void router_print_arp_entry(const char* key, void* value, void* ctx) {
+static void router_print_arp_entry(const NeighborEntry* entry, uint64_t now_ms, void* ctx) {
   const char* node_name = (const char*)ctx;
   if (node_name == NULL) {
     return;
   }
-  const char* mac = (const char*)value;
-  LOG(node_name, "ARP %s -> %s", key, mac != NULL ? mac : "(null)");
+
+  uint8_t ip[4] = {(uint8_t)(entry->ip >> 24U), (uint8_t)(entry->ip >> 16U),
+                   (uint8_t)(entry->ip >> 8U), (uint8_t)entry->ip};
+  char ip_text[16];
+  char mac_text[18];
+  ipv4_address_to_string(ip, ip_text);
+  mac_to_str(entry->mac, mac_text);
+  LOG(node_name, "ARP %s -> %s %s age=%llus", ip_text, mac_text,
+      neighbor_state_name(neighbor_entry_state(entry, now_ms)),
+      (unsigned long long)((now_ms - entry->updated_ms) / 1000U));
 }
 
 void router_print_arp_cache(const Router* router) {
@@ -1431,8 +1863,9 @@ void router_print_arp_cache(const Router* router) {
   }
 
   const Node* node = router_as_node_const(router);
-  hashmap_foreach(state->arp_cache, router_print_arp_entry, (void*)node->name);
-  if (state->arp_cache == NULL || state->arp_cache->count == 0U) {
+  neighbor_foreach(state->neighbors, neighbor_now_ms(), router_print_arp_entry,
+                   (void*)node->name);
+  if (neighbor_count(state->neighbors) == 0U) {
     LOG(router_name(router), "ARP cache empty");
   }
 }
@@ -1443,9 +1876,15 @@ void router_foreach_route(const Router* router, router_route_visitor_fn fn, void
     return;
   }
 
-  for (size_t index = 0U; index < state->route_count; ++index) {
-    fn(&state->routes[index], ctx);
+  RouterRouteList list = {0};
+  if (router_collect_static_routes(state, &list) != MAGI_OK) {
+    return;
+  }
+
+  for (size_t index = 0U; index < list.count; ++index) {
+    fn(&list.routes[index], ctx);
   }
+  free(list.routes);
 }
 
 void router_print_routes(const Router* router) {
@@ -1457,27 +1896,29 @@ void router_print_routes(const Router* router) {
 
   const Node* node = router_as_node_const(router);
   size_t count = 0U;
-  for (size_t index = 0U; index < state->route_count; ++index) {
+  RouterRouteList list = {0};
+  if (router_collect_static_routes(state, &list) != MAGI_OK) {
+    LOG(router_name(router), "Routing table unavailable");
+    return;
+  }
+
+  for (size_t index = 0U; index < list.count; ++index) {
     char dest[32];
     char next_hop[16];
-    (void)ipv4_format_cidr(state->routes[index].network, state->routes[index].prefix_len, dest,
+    (void)ipv4_format_cidr(list.routes[index].network, list.routes[index].prefix_len, dest,
                            sizeof(dest));
-    ipv4_address_to_string(state->routes[index].next_hop, next_hop);
+    ipv4_address_to_string(list.routes[index].next_hop, next_hop);
     LOG(router_name(router), "Route S %s via %s port %u", dest,
-        ipv4_addr_is_zero(state->routes[index].next_hop) ? "direct" : next_hop,
-        (unsigned)state->routes[index].out_port);
+        ipv4_addr_is_zero(list.routes[index].next_hop) ? "direct" : next_hop,
+        (unsigned)list.routes[index].out_port);
     count++;
   }
+  free(list.routes);
 
-  if (node != NULL && node->interfaces != NULL) {
-    for (size_t index = 0U; index < node->interfaces->capacity; ++index) {
-      const HashEntry* entry = &node->interfaces->entries[index];
-      if (entry == NULL || entry->key == NULL || entry->tombstone) {
-        continue;
-      }
-
+  if (node != NULL) {
+    for (size_t index = 0U; index < node->iface_count; ++index) {
       RoutingTableEntry connected = {0};
-      if (!interface_connected_route(entry->value, &connected)) {
+      if (!interface_connected_route(node->iface_list[index], NULL, &connected)) {
         continue;
       }
 
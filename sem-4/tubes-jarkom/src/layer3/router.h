@@ -14,6 +14,22 @@
 /** @brief Opaque router specialization of Node. */
 typedef struct Router Router;
 
+struct IPv4Packet;
+
+/** UDP port whose datagrams to a router address go to the RIP handler. */
+#define ROUTER_RIP_PORT 520U
+
+/**
+ * @brief RIP receive hook: payload of a UDP datagram to ROUTER_RIP_PORT on the router.
+ *
+ * @param node      Router node that received the datagram.
+ * @param data      UDP payload.
+ * @param len       Payload length in bytes.
+ * @param sender_ip Source address of the datagram.
+ */
+typedef void (*rip_dispatch_fn)(Node* node, const uint8_t* data, size_t len,
+                                const uint8_t sender_ip[4]);
+
 typedef struct RoutingTableEntry {
   uint8_t network[4];
   uint8_t mask[4];
@@ -74,17 +90,94 @@ const Router* router_from_node_const(const Node* node);
 
 int router_add_route(Router* router, const char* dest_cidr, const char* next_hop_ip,
                      uint16_t out_port);
+
+/**
+ * @brief Add or replace a static route with an explicit metric.
+ *
+ * router_add_route() is this with metric 1. RIP installs learned routes
+ * through it so their hop count shows in the table and in its updates.
+ *
+ * @param router      Router instance.
+ * @param dest_cidr   Destination prefix, e.g. "10.1.0.0/16".
+ * @param next_hop_ip Next hop address, or NULL/""/"direct" for on-link.
+ * @param out_port    Egress port.
+ * @param metric      Route metric.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int router_add_route_metric(Router* router, const char* dest_cidr, const char* next_hop_ip,
+                            uint16_t out_port, uint8_t metric);
 int router_remove_route(Router* router, const char* dest_cidr);
+
+/**
+ * @brief Route and send an IPv4 packet originated by the router itself.
+ *
+ * Looks up the destination, resolves the next hop (queueing behind ARP
+ * if needed) and fragments to the egress MTU.
+ *
+ * @param router Router instance.
+ * @param pkt    Packet to send; header fields are filled in as for forwarding.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int router_send_ipv4(Router* router, struct IPv4Packet* pkt);
+
+/**
+ * @brief Register the handler for UDP datagrams to ROUTER_RIP_PORT.
+ *
+ * Without a handler such datagrams are dropped like any other UDP
+ * addressed to the router.
+ *
+ * @param router  Router instance.
+ * @param handler Handler, or NULL to unregister.
+ */
+void router_set_rip_handler(Router* router, rip_dispatch_fn handler);
+
+/**
+ * @brief Longest-prefix-match lookup over static and connected routes.
+ *
+ * Backed by the compiled FIB in layer3/fib.h. On equal prefix length a
+ * static route wins over a connected one. The returned pointer is valid
+ * until the next route or interface change on this router.
+ *
+ * @param router Router instance.
+ * @param dst_ip Destination IPv4 address.
+ * @return Best matching route, or NULL if none.
+ */
 const RoutingTableEntry* lpm_lookup(Router* router, const uint8_t dst_ip[4]);
 void router_handle_receive(Node* node, struct Interface* in_iface, const uint8_t* data, size_t len);
+
+/** Flow cache entries per router; see router_set_flow_cache(). */
+#define ROUTER_FLOW_CACHE_SLOTS 1024U
+
+/**
+ * @brief Resize or disable the router's flow cache.
+ *
+ * The cache remembers the egress, next hop and next-hop MAC of recently
+ * forwarded flows so their later packets skip LPM and ARP (see
+ * layer3/flow_cache.h). Cached entries are dropped.
+ *
+ * @param router Router instance.
+ * @param slots  Entry count, rounded up to a power of two; 0 disables the cache.
+ * @return MAGI_OK on success, otherwise an error code.
+ */
+int router_set_flow_cache(Router* router, size_t slots);
+
+/**
+ * @brief Drop every flow cache entry.
+ *
+ * Route, interface and neighbor changes already do this; anything else
+ * that changes how the router forwards must call it.
+ *
+ * @param router Router instance.
+ */
+void router_flow_cache_flush(Router* router);
 void router_foreach_route(const Router* router, router_route_visitor_fn fn, void* ctx);
 void router_print_routes(const Router* router);
 
 /**
  * @brief Print the router's ARP cache contents.
  *
- * Iterates the ARP cache hashmap and logs each IP-to-MAC mapping.
- * If the cache is empty, logs "ARP cache empty".
+ * Logs each neighbor table entry with its IP-to-MAC mapping, state and
+ * age. If the cache is empty, logs "ARP cache empty".
  *
  * @param router The router whose ARP cache to display.
  */
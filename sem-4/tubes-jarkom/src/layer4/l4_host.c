@@ -1,10 +1,11 @@
 #define _POSIX_C_SOURCE 200809L
+#define MAGI_LOG_SUBSYS MAGI_LOG_L4
 
 #include "l4_host.h"
 
 #include "layer3/ipv4.h"
-#include "layer4/port_registry.h"
 #include "layer4/tcp.h"
+#include "layer4/tcp_conn.h"
 #include "layer4/tcp_socket.h"
 #include "layer4/udp.h"
 #include "layer4/udp_socket.h"
@@ -26,10 +27,10 @@ static void l4_data_destroy(void* data);
 /**
  * @brief Attach L4 (TCP/UDP) support to a host node.
  *
- * Creates a port registry HashMap, stores it in node->l4_data, and
- * registers the L4 dispatch and IP send callback function pointers.
- * If the node already has L4 data attached, only the callbacks are
- * updated and the existing registry is reused.
+ * Creates the port registry and the TCP connection table, stores
+ * them in node->l4_data, and registers the L4 dispatch and IP send
+ * callback function pointers. If the node already has L4 data attached,
+ * only the callbacks are updated and the existing state is reused.
  *
  * @param node  The host node to attach L4 to.
  * @return MAGI_OK on success, MAGI_ERR_NOMEM on allocation failure,
@@ -45,18 +46,30 @@ int l4_host_attach(Node* node) {
   if (node->l4_data != NULL) {
     node->handle_l4_packet = l4_dispatch_packet;
     node->send_ip_packet = ipv4_send_packet;
+    node->send_ip_pkt = ipv4_send_pkt;
     return MAGI_OK;
   }
 
-  HashMap* reg = port_registry_new();
-  if (reg == NULL) {
+  L4Host* host = calloc(1U, sizeof(*host));
+  if (host == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
+  }
+  host->ports = port_registry_new();
+  host->conns = tcp_conn_table_new(0U);
+  if (host->ports == NULL || host->conns == NULL) {
+    port_registry_free(host->ports);
+    tcp_conn_table_free(host->conns);
+    free(host);
+    magi_errno = MAGI_ERR_NOMEM;
     return MAGI_ERR_NOMEM;
   }
 
-  node->l4_data = reg;
+  node->l4_data = host;
   node->l4_data_free = l4_data_destroy;
   node->handle_l4_packet = l4_dispatch_packet;
   node->send_ip_packet = ipv4_send_packet;
+  node->send_ip_pkt = ipv4_send_pkt;
   return MAGI_OK;
 }
 
@@ -64,30 +77,164 @@ int l4_host_attach(Node* node) {
  * @brief Retrieve the port registry from a node's L4 data.
  *
  * @param node  The node whose port registry to retrieve.
- * @return HashMappointer (the port registry), or NULL if node is NULL
+ * @return Port registry, or NULL if node is NULL
  *         or L4 has not been attached.
  */
-void* l4_host_get_registry(Node* node) {
-  return (node != NULL) ? node->l4_data : NULL;
+PortRegistry* l4_host_get_registry(Node* node) {
+  L4Host* host = l4_host_get(node);
+  return host != NULL ? host->ports : NULL;
+}
+
+/**
+ * @brief Retrieve a node's L4 state.
+ *
+ * @param node  The node to query.
+ * @return L4Host pointer, or NULL if node is NULL or L4 has not been attached.
+ */
+L4Host* l4_host_get(Node* node) {
+  return (node != NULL) ? (L4Host*)node->l4_data : NULL;
+}
+
+/**
+ * @brief Free a TCP socket and drop it and its children from the connection table.
+ *
+ * @param node  Owning node.
+ * @param sock  Socket to free. May be NULL.
+ */
+void l4_host_tcp_free(Node* node, TCPSocket* sock) {
+  if (sock == NULL) {
+    return;
+  }
+
+  L4Host* host = l4_host_get(node);
+  if (host != NULL) {
+    TCPChildQueue* queues[2] = {&sock->listen.syn, &sock->listen.ready};
+    for (size_t index = 0U; index < 2U; ++index) {
+      while (queues[index]->head != NULL) {
+        TCPSocket* child = queues[index]->head;
+        tcp_socket_unlink_child(child);
+        (void)tcp_conn_table_remove(host->conns, child);
+        tcp_socket_free(child);
+      }
+    }
+    (void)tcp_conn_table_remove(host->conns, sock);
+  }
+  tcp_socket_free(sock);
 }
 
 /* ─── Internal helpers ─── */
 
+/**
+ * @brief Free a child no application has accepted (tcp_conn_table_foreach callback).
+ *
+ * Accepted children belong to whoever accepted them and are left alone.
+ *
+ * @param sock  Socket in the connection table.
+ * @param ctx   Unused context.
+ */
+static void l4_free_unaccepted(TCPSocket* sock, void* ctx) {
+  (void)ctx;
+  if (sock->listener != NULL) {
+    tcp_socket_free(sock);
+  }
+}
+
 /**
  * @brief Free all L4 data associated with a node.
  *
- * Iterates over the port registry, frees every PortBinding via
- * port_registry_free_binding, then frees the hashmap itself.
+ * Frees the listeners' unaccepted children and the connection table,
+ * then the port registry.
  *
- * @param data  Opaque pointer to the port registry HashMap.
+ * @param data  Opaque pointer to the L4Host.
  */
 static void l4_data_destroy(void* data) {
   if (data == NULL) {
     return;
   }
-  HashMap* reg = (HashMap*)data;
-  hashmap_foreach(reg, port_registry_free_binding, NULL);
-  hashmap_free(reg);
+  L4Host* host = (L4Host*)data;
+  tcp_conn_table_foreach(host->conns, l4_free_unaccepted, NULL);
+  tcp_conn_table_free(host->conns);
+  port_registry_free(host->ports);
+  free(host);
+}
+
+/**
+ * @brief Free every child of a listener that was reset or timed out before being accepted.
+ *
+ * @param host      Node L4 state.
+ * @param listener  Listening socket.
+ */
+static void l4_tcp_reap_children(L4Host* host, TCPSocket* listener) {
+  TCPChildQueue* queues[2] = {&listener->listen.syn, &listener->listen.ready};
+  for (size_t index = 0U; index < 2U; ++index) {
+    TCPSocket* child = queues[index]->head;
+    while (child != NULL) {
+      TCPSocket* next = child->queue_next;
+      if (child->state == TCP_CLOSED) {
+        tcp_socket_unlink_child(child);
+        (void)tcp_conn_table_remove(host->conns, child);
+        tcp_socket_free(child);
+      }
+      child = next;
+    }
+  }
+}
+
+/**
+ * @brief Deliver a TCP segment to its connection, spawning one for a SYN on a listener.
+ *
+ * The four-tuple table is consulted first; a miss falls back to the
+ * socket bound to the destination port. A SYN reaching a listener gets a
+ * child socket in the table before the state machine answers it, because
+ * in sequential mode the final ACK can arrive inside that call. A child
+ * that dies before it is accepted is freed here once the outermost
+ * dispatch returns, so nested deliveries never see it vanish.
+ *
+ * @param node    Receiving node.
+ * @param host    Node L4 state.
+ * @param seg     Parsed segment.
+ * @param src_ip  Source IPv4 address.
+ * @param dst_ip  Destination IPv4 address.
+ */
+static void l4_tcp_input(Node* node, L4Host* host, TCPSegment* seg, const uint8_t src_ip[4],
+                         const uint8_t dst_ip[4]) {
+  TCPSocket* sock =
+      tcp_conn_table_lookup(host->conns, src_ip, seg->src_port, dst_ip, seg->dst_port);
+  if (sock == NULL) {
+    sock = port_registry_lookup(host->ports, PORT_PROTOCOL_TCP, seg->dst_port);
+    if (sock == NULL) {
+      LOG(node->name, "TCP port %u not bound; send RST", (unsigned)seg->dst_port);
+      /* Send RST for unbound port */
+      tcp_send_rst_packet(node, dst_ip, src_ip, seg->dst_port, seg->src_port, seg->ack_num,
+                          seg->seq_num + (uint32_t)(seg->payload_len > 0U ? seg->payload_len : 1U));
+      return;
+    }
+
+    if (tcp_socket_is_listener(sock) && (seg->flags & TCP_FLAG_SYN) &&
+        !(seg->flags & (TCP_FLAG_ACK | TCP_FLAG_RST))) {
+      if (sock->listen.syn.count >= sock->listen.backlog) {
+        l4_tcp_reap_children(host, sock);
+      }
+      TCPSocket* child = tcp_socket_spawn(sock, seg, src_ip, dst_ip);
+      if (child == NULL) {
+        return;
+      }
+      if (tcp_conn_table_insert(host->conns, child) != MAGI_OK) {
+        tcp_socket_free(child);
+        return;
+      }
+      sock = child;
+    }
+  }
+
+  host->tcp_depth++;
+  (void)tcp_socket_handle_segment(sock, seg, node, src_ip, dst_ip);
+  host->tcp_depth--;
+  if (host->tcp_depth == 0U && sock->listener != NULL && sock->state == TCP_CLOSED) {
+    tcp_socket_unlink_child(sock);
+    (void)tcp_conn_table_remove(host->conns, sock);
+    tcp_socket_free(sock);
+  }
 }
 
 /**
@@ -95,8 +242,8 @@ static void l4_data_destroy(void* data) {
  *
  * Called via node->handle_l4_packet when an IPv4 packet with a
  * transport protocol (TCP or UDP) arrives. Parses the transport
- * header, looks up the bound socket in the port registry, and
- * either delivers the segment to the socket state machine (TCP)
+ * header, finds the connection (four-tuple table, then port registry)
+ * and either delivers the segment to the socket state machine (TCP)
  * or logs the datagram (UDP). Unbound TCP ports receive a RST.
  *
  * @param node         Receiving node.
@@ -112,8 +259,8 @@ static void l4_dispatch_packet(struct Node* node, const uint8_t src_ip[4], const
     return;
   }
 
-  HashMap* reg = (HashMap*)node->l4_data;
-  if (reg == NULL) {
+  L4Host* host = (L4Host*)node->l4_data;
+  if (host == NULL) {
     LOG(node->name, "L4 not attached: drop protocol %u", (unsigned)protocol);
     return;
   }
@@ -129,18 +276,7 @@ static void l4_dispatch_packet(struct Node* node, const uint8_t src_ip[4], const
       return;
     }
 
-    /* Look up bound socket */
-    void* sock = port_registry_lookup(reg, PORT_PROTOCOL_TCP, seg.dst_port);
-    if (sock == NULL) {
-      LOG(node->name, "TCP port %u not bound; send RST", (unsigned)seg.dst_port);
-      /* Send RST for unbound port */
-      tcp_send_rst_packet(node, dst_ip, src_ip, seg.dst_port, seg.src_port, seg.ack_num,
-                          seg.seq_num + (uint32_t)(seg.payload_len > 0U ? seg.payload_len : 1U));
-      return;
-    }
-
-    /* Let the socket state machine handle it */
-    (void)tcp_socket_handle_segment((TCPSocket*)sock, &seg, node, src_ip, dst_ip);
+    l4_tcp_input(node, host, &seg, src_ip, dst_ip);
     return;
   }
 
@@ -154,7 +290,7 @@ static void l4_dispatch_packet(struct Node* node, const uint8_t src_ip[4], const
     }
 
     /* Look up bound socket */
-    void* sock = port_registry_lookup(reg, PORT_PROTOCOL_UDP, dgram.dst_port);
+    void* sock = port_registry_lookup(host->ports, PORT_PROTOCOL_UDP, dgram.dst_port);
     if (sock == NULL) {
       LOG(node->name, "UDP port %u not bound; drop silently", (unsigned)dgram.dst_port);
       return;
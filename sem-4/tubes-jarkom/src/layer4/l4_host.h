@@ -2,19 +2,38 @@
  * @file l4_host.h
  * @brief L4 integration layer — attaches TCP/UDP handling to a host Node.
  *
- * Sets up node->l4_data as a port registry HashMap and configures
- * node->handle_l4_packet and node->send_ip_packet function pointers.
+ * Sets up node->l4_data as an L4Host (port registry plus TCP connection
+ * table) and configures node->handle_l4_packet and node->send_ip_packet
+ * function pointers. TCP segments are matched on their four-tuple first
+ * and fall back to the socket bound to the destination port.
  */
 #ifndef MAGI_LAYER4_L4_HOST_H
 #define MAGI_LAYER4_L4_HOST_H
 
+#include <stdint.h>
+
 #include "core/node.h"
+#include "layer4/port_registry.h"
+#include "layer4/tcp_conn.h"
+#include "layer4/tcp_socket.h"
+
+/**
+ * @brief Per-node L4 state stored in node->l4_data.
+ */
+typedef struct L4Host {
+  /** Port bindings, see port_registry.h. */
+  PortRegistry* ports;
+  /** Connections spawned by listeners, keyed by four-tuple. */
+  TCPConnTable* conns;
+  /** Nesting depth of TCP dispatch; dead children are only freed at depth 1. */
+  uint32_t tcp_depth;
+} L4Host;
 
 /**
  * @brief Attach L4 (TCP/UDP) support to a host node.
  *
- * Creates the port registry hashmap, stores it in node->l4_data,
- * and registers the dispatch and send callbacks.
+ * Creates the port registry and connection table, stores them in
+ * node->l4_data, and registers the dispatch and send callbacks.
  *
  * @param node  The host node to attach L4 to.
  * @return MAGI_OK on success, MAGI_ERR_NOMEM on allocation failure.
@@ -25,8 +44,27 @@ int l4_host_attach(Node* node);
  * @brief Retrieve the port registry from a node's L4 data.
  *
  * @param node  The node whose port registry to retrieve.
- * @return HashMap pointer, or NULL if not attached.
+ * @return Port registry, or NULL if not attached.
+ */
+PortRegistry* l4_host_get_registry(Node* node);
+
+/**
+ * @brief Retrieve a node's L4 state.
+ *
+ * @param node  The node to query.
+ * @return L4 state, or NULL if not attached.
+ */
+L4Host* l4_host_get(Node* node);
+
+/**
+ * @brief Free a TCP socket together with the connection-table entries that point at it.
+ *
+ * A listener's children that were never accepted are freed as well. Use
+ * this instead of tcp_socket_free() for sockets on an L4-attached node.
+ *
+ * @param node  Owning node.
+ * @param sock  Socket to free. NULL is allowed.
  */
-void* l4_host_get_registry(Node* node);
+void l4_host_tcp_free(Node* node, TCPSocket* sock);
 
 #endif /* MAGI_LAYER4_L4_HOST_H */
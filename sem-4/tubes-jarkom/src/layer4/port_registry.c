@@ -4,152 +4,228 @@
 
 #include "utils/magi_error.h"
 
-#include <stdio.h>
+#include <stdbool.h>
 #include <stdlib.h>
-#include <string.h>
+
+#define PORT_PAGE_SIZE 256U
+#define PORT_PAGE_COUNT 256U
+#define PORT_EPHEMERAL_COUNT (PORT_EPHEMERAL_MAX - PORT_EPHEMERAL_MIN + 1U)
+#define PORT_EPHEMERAL_WORDS (PORT_EPHEMERAL_COUNT / 64U)
+
+/** @brief Bindings of one protocol. */
+typedef struct PortTable {
+  /** Indexed by port >> 8; each page holds 256 socket pointers. */
+  void** pages[PORT_PAGE_COUNT];
+  /** One bit per ephemeral port, set while bound. */
+  uint64_t ephemeral_used[PORT_EPHEMERAL_WORDS];
+  /** Offset into the ephemeral range where the next search starts. */
+  uint32_t cursor;
+} PortTable;
+
+struct PortRegistry {
+  PortTable tcp;
+  PortTable udp;
+};
 
 /**
- * @brief Build a registry key string for a protocol/port pair.
+ * @brief Select the table for a protocol.
  *
- * Produces "tcp:<port>" or "udp:<port>" depending on protocol.
+ * @param reg      Port registry.
+ * @param protocol PORT_PROTOCOL_TCP or PORT_PROTOCOL_UDP.
+ * @return Table, or NULL for any other protocol.
+ */
+static PortTable* port_registry_table(PortRegistry* reg, uint8_t protocol) {
+  if (protocol == PORT_PROTOCOL_TCP) {
+    return &reg->tcp;
+  }
+  return protocol == PORT_PROTOCOL_UDP ? &reg->udp : NULL;
+}
+
+/**
+ * @brief Mark an ephemeral port bound or free; ports outside the range are ignored.
  *
- * @param protocol IPPROTO_TCP (6) or IPPROTO_UDP (17).
- * @param port     Port number.
- * @param out      Destination buffer (must hold at least 16 chars).
+ * @param table Protocol table.
+ * @param port  Port number.
+ * @param used  New state.
  */
-void port_registry_key(uint8_t protocol, uint16_t port, char out[16]) {
-  const char* proto_name = (protocol == PORT_PROTOCOL_TCP) ? "tcp" : "udp";
-  snprintf(out, 16U, "%s:%u", proto_name, (unsigned)port);
+static void port_registry_mark(PortTable* table, uint16_t port, bool used) {
+  if (port < PORT_EPHEMERAL_MIN) {
+    return;
+  }
+  uint32_t offset = (uint32_t)port - PORT_EPHEMERAL_MIN;
+  uint64_t bit = 1ULL << (offset % 64U);
+  if (used) {
+    table->ephemeral_used[offset / 64U] |= bit;
+  } else {
+    table->ephemeral_used[offset / 64U] &= ~bit;
+  }
 }
 
 /**
  * @brief Create a new empty port registry.
  *
- * Allocates a HashMap with an initial capacity of 16.
+ * Pages are allocated on first bind, so an idle registry is just the two
+ * page directories and ephemeral bitmaps.
  *
- * @return New HashMap pointer, or NULL on allocation failure.
+ * @return New registry, or NULL on allocation failure.
  */
-HashMap* port_registry_new(void) {
-  return hashmap_new(16U);
+PortRegistry* port_registry_new(void) {
+  PortRegistry* reg = calloc(1U, sizeof(*reg));
+  if (reg == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+  }
+  return reg;
+}
+
+/**
+ * @brief Destroy a port registry and its pages.
+ *
+ * Does NOT free the bound sockets — socket lifecycle is managed by the caller.
+ *
+ * @param reg Registry to free. NULL is allowed.
+ */
+void port_registry_free(PortRegistry* reg) {
+  if (reg == NULL) {
+    return;
+  }
+
+  for (size_t index = 0U; index < PORT_PAGE_COUNT; ++index) {
+    free(reg->tcp.pages[index]);
+    free(reg->udp.pages[index]);
+  }
+  free(reg);
 }
 
 /**
  * @brief Bind a socket (or opaque handler) to a protocol/port.
  *
- * Creates a PortBinding entry and inserts it into the registry.
- * Returns MAGI_ERR_PORTUSED if the protocol:port pair is already bound.
+ * Returns MAGI_ERR_PORTUSED if the protocol/port pair is already bound.
  *
  * @param reg      Port registry.
  * @param protocol IPPROTO_TCP (6) or IPPROTO_UDP (17).
  * @param port     Port number.
  * @param socket   Opaque socket or handler pointer to bind.
  * @return MAGI_OK on success, MAGI_ERR_PORTUSED if already bound,
- *         MAGI_ERR_NOMEM on allocation failure, MAGI_ERR_BADARGS on null input.
+ *         MAGI_ERR_NOMEM on allocation failure, MAGI_ERR_BADARGS on null input
+ *         or an unknown protocol.
  */
-int port_registry_bind(HashMap* reg, uint8_t protocol, uint16_t port, void* socket) {
-  if (reg == NULL || socket == NULL) {
+int port_registry_bind(PortRegistry* reg, uint8_t protocol, uint16_t port, void* socket) {
+  PortTable* table = reg != NULL ? port_registry_table(reg, protocol) : NULL;
+  if (table == NULL || socket == NULL) {
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
-  char key[16];
-  port_registry_key(protocol, port, key);
+  void** page = table->pages[port >> 8U];
+  if (page == NULL) {
+    page = calloc(PORT_PAGE_SIZE, sizeof(*page));
+    if (page == NULL) {
+      magi_errno = MAGI_ERR_NOMEM;
+      return MAGI_ERR_NOMEM;
+    }
+    table->pages[port >> 8U] = page;
+  }
 
-  if (hashmap_get(reg, key) != NULL) {
+  if (page[port & 0xFFU] != NULL) {
     magi_errno = MAGI_ERR_PORTUSED;
     return MAGI_ERR_PORTUSED;
   }
 
-  PortBinding* binding = malloc(sizeof(*binding));
-  if (binding == NULL) {
-    magi_errno = MAGI_ERR_NOMEM;
-    return MAGI_ERR_NOMEM;
-  }
+  page[port & 0xFFU] = socket;
+  port_registry_mark(table, port, true);
+  return MAGI_OK;
+}
 
-  binding->protocol = protocol;
-  binding->port = port;
-  binding->socket = socket;
+/**
+ * @brief Bind a socket to the next free port in the ephemeral range.
+ *
+ * Scans the bitmap a 64-port word at a time from the cursor, wrapping once
+ * around the range, and leaves the cursor just past the port it picked.
+ *
+ * @param reg      Port registry.
+ * @param protocol IPPROTO_TCP (6) or IPPROTO_UDP (17).
+ * @param socket   Opaque socket or handler pointer to bind.
+ * @param port_out Receives the chosen port.
+ * @return MAGI_OK on success, MAGI_ERR_PORTUSED if every ephemeral port is
+ *         bound, MAGI_ERR_NOMEM or MAGI_ERR_BADARGS as for port_registry_bind().
+ */
+int port_registry_bind_ephemeral(PortRegistry* reg, uint8_t protocol, void* socket,
+                                 uint16_t* port_out) {
+  PortTable* table = reg != NULL ? port_registry_table(reg, protocol) : NULL;
+  if (table == NULL || socket == NULL || port_out == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
 
-  int status = hashmap_set(reg, key, binding);
-  if (status != MAGI_OK) {
-    free(binding);
-    return status;
+  uint32_t first_word = table->cursor / 64U;
+  uint64_t start_mask = ~0ULL << (table->cursor % 64U);
+  /* The extra pass revisits the first word for the ports below the cursor. */
+  for (uint32_t step = 0U; step <= PORT_EPHEMERAL_WORDS; ++step) {
+    uint32_t word = (first_word + step) % PORT_EPHEMERAL_WORDS;
+    uint64_t free_bits = ~table->ephemeral_used[word];
+    if (step == 0U) {
+      free_bits &= start_mask;
+    } else if (step == PORT_EPHEMERAL_WORDS) {
+      free_bits &= ~start_mask;
+    }
+    if (free_bits == 0U) {
+      continue;
+    }
+
+    uint32_t offset = word * 64U + (uint32_t)__builtin_ctzll(free_bits);
+    uint16_t port = (uint16_t)(PORT_EPHEMERAL_MIN + offset);
+    int status = port_registry_bind(reg, protocol, port, socket);
+    if (status != MAGI_OK) {
+      return status;
+    }
+    table->cursor = (offset + 1U) % PORT_EPHEMERAL_COUNT;
+    *port_out = port;
+    return MAGI_OK;
   }
 
-  return MAGI_OK;
+  magi_errno = MAGI_ERR_PORTUSED;
+  return MAGI_ERR_PORTUSED;
 }
 
 /**
  * @brief Look up a binding by protocol and port.
  *
- * Searches the registry for the given protocol:port pair and returns
- * the associated socket pointer if found.
- *
  * @param reg      Port registry.
  * @param protocol IPPROTO_TCP (6) or IPPROTO_UDP (17).
  * @param port     Port number.
  * @return Socket pointer if found, NULL if not bound or registry is NULL.
  */
-void* port_registry_lookup(HashMap* reg, uint8_t protocol, uint16_t port) {
+void* port_registry_lookup(const PortRegistry* reg, uint8_t protocol, uint16_t port) {
   if (reg == NULL) {
     return NULL;
   }
 
-  char key[16];
-  port_registry_key(protocol, port, key);
-
-  PortBinding* binding = hashmap_get(reg, key);
-  if (binding == NULL) {
-    return NULL;
-  }
-
-  return binding->socket;
+  const PortTable* table = protocol == PORT_PROTOCOL_TCP   ? &reg->tcp
+                           : protocol == PORT_PROTOCOL_UDP ? &reg->udp
+                                                           : NULL;
+  void** page = table != NULL ? table->pages[port >> 8U] : NULL;
+  return page != NULL ? page[port & 0xFFU] : NULL;
 }
 
 /**
  * @brief Remove a binding from the registry.
  *
- * Looks up the protocol:port pair, removes it from the hashmap,
- * and frees the associated PortBinding struct.
+ * The page stays allocated; ports tend to be rebound near where they were.
  *
  * @param reg      Port registry.
  * @param protocol IPPROTO_TCP (6) or IPPROTO_UDP (17).
  * @param port     Port number.
  * @return MAGI_OK on success, MAGI_ERR_BADARGS if not found or registry is NULL.
  */
-int port_registry_unbind(HashMap* reg, uint8_t protocol, uint16_t port) {
-  if (reg == NULL) {
-    magi_errno = MAGI_ERR_BADARGS;
-    return MAGI_ERR_BADARGS;
-  }
-
-  char key[16];
-  port_registry_key(protocol, port, key);
-
-  PortBinding* binding = hashmap_get(reg, key);
-  if (binding == NULL) {
+int port_registry_unbind(PortRegistry* reg, uint8_t protocol, uint16_t port) {
+  PortTable* table = reg != NULL ? port_registry_table(reg, protocol) : NULL;
+  void** page = table != NULL ? table->pages[port >> 8U] : NULL;
+  if (page == NULL || page[port & 0xFFU] == NULL) {
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
-  int status = hashmap_delete(reg, key);
-  free(binding);
-  return status;
-}
-
-/**
- * @brief Free a PortBinding entry (hashmap_foreach callback).
- *
- * Frees the PortBinding struct allocated during port_registry_bind.
- * Does NOT free the socket itself — socket lifecycle is managed
- * by the caller.
- *
- * @param key   Registry key (unused).
- * @param value PortBinding pointer to free.
- * @param ctx   Unused context pointer.
- */
-void port_registry_free_binding(const char* key, void* value, void* ctx) {
-  (void)key;
-  (void)ctx;
-  free(value);
+  page[port & 0xFFU] = NULL;
+  port_registry_mark(table, port, false);
+  return MAGI_OK;
 }
@@ -1,8 +1,12 @@
 /**
  * @file port_registry.h
- * @brief Port-to-socket binding registry using the generic HashMap.
+ * @brief Port-to-socket binding registry indexed directly by port number.
  *
- * Key format: "tcp:<port>" or "udp:<port>" → PortBinding*
+ * Each protocol owns a two-level radix over the 16-bit port space: the high
+ * byte selects a 256-entry page, allocated on first bind, and the low byte
+ * selects the socket slot. Lookups are two loads with no formatting or
+ * hashing. Ports in the ephemeral range are also tracked in a bitmap so
+ * port_registry_bind_ephemeral() can find a free one a word at a time.
  */
 
 #ifndef MAGI_LAYER4_PORT_REGISTRY_H
@@ -10,76 +14,75 @@
 
 #include <stdint.h>
 
-#include "utils/hashmap.h"
-
 #define PORT_PROTOCOL_TCP 6U
 #define PORT_PROTOCOL_UDP 17U
 
-/**
- * @brief One port binding entry.
- */
-typedef struct PortBinding {
-  uint8_t protocol; /* IPPROTO_TCP or IPPROTO_UDP */
-  uint16_t port;
-  void* socket; /* TCPSocket* or UDPSocket* */
-} PortBinding;
+/** First port handed out by port_registry_bind_ephemeral() (RFC 6335 dynamic range). */
+#define PORT_EPHEMERAL_MIN 49152U
+/** Last port handed out by port_registry_bind_ephemeral(). */
+#define PORT_EPHEMERAL_MAX 65535U
+
+/** @brief Opaque port registry. */
+typedef struct PortRegistry PortRegistry;
 
 /**
- * @brief Create a new empty port registry (HashMap).
+ * @brief Create a new empty port registry.
  *
- * @return New HashMap, or NULL on failure.
+ * @return New registry, or NULL on failure.
  */
-HashMap* port_registry_new(void);
+PortRegistry* port_registry_new(void);
 
 /**
- * @brief Build a registry key string for a protocol/port pair.
+ * @brief Destroy a port registry. The bound sockets are not freed.
  *
- * @param protocol IPPROTO_TCP or IPPROTO_UDP.
- * @param port     Port number.
- * @param out      Destination buffer (must hold at least 16 chars).
+ * @param reg Registry to free. NULL is allowed.
  */
-void port_registry_key(uint8_t protocol, uint16_t port, char out[16]);
+void port_registry_free(PortRegistry* reg);
 
 /**
  * @brief Bind a socket to a protocol/port.
  *
  * @param reg      Port registry.
- * @param protocol IPPROTO_TCP or IPPROTO_UDP.
+ * @param protocol PORT_PROTOCOL_TCP or PORT_PROTOCOL_UDP.
  * @param port     Port number.
  * @param socket   Opaque socket pointer.
  * @return MAGI_OK on success, MAGI_ERR_PORTUSED if already bound.
  */
-int port_registry_bind(HashMap* reg, uint8_t protocol, uint16_t port, void* socket);
+int port_registry_bind(PortRegistry* reg, uint8_t protocol, uint16_t port, void* socket);
+
+/**
+ * @brief Bind a socket to any free port in the ephemeral range.
+ *
+ * Searches from a per-protocol cursor that advances past each port handed
+ * out, so a just-released port is not reused straight away.
+ *
+ * @param reg      Port registry.
+ * @param protocol PORT_PROTOCOL_TCP or PORT_PROTOCOL_UDP.
+ * @param socket   Opaque socket pointer.
+ * @param port_out Receives the chosen port.
+ * @return MAGI_OK on success, MAGI_ERR_PORTUSED if the range is exhausted.
+ */
+int port_registry_bind_ephemeral(PortRegistry* reg, uint8_t protocol, void* socket,
+                                 uint16_t* port_out);
 
 /**
  * @brief Look up a binding by protocol/port.
  *
  * @param reg      Port registry.
- * @param protocol IPPROTO_TCP or IPPROTO_UDP.
+ * @param protocol PORT_PROTOCOL_TCP or PORT_PROTOCOL_UDP.
  * @param port     Port number.
  * @return Socket pointer, or NULL if not bound.
  */
-void* port_registry_lookup(HashMap* reg, uint8_t protocol, uint16_t port);
+void* port_registry_lookup(const PortRegistry* reg, uint8_t protocol, uint16_t port);
 
 /**
  * @brief Remove a binding.
  *
  * @param reg      Port registry.
- * @param protocol IPPROTO_TCP or IPPROTO_UDP.
+ * @param protocol PORT_PROTOCOL_TCP or PORT_PROTOCOL_UDP.
  * @param port     Port number.
  * @return MAGI_OK on success, MAGI_ERR_BADARGS if not found.
  */
-int port_registry_unbind(HashMap* reg, uint8_t protocol, uint16_t port);
-
-/**
- * @brief Free a port binding (callback for hashmap_foreach-free).
- *
- * Frees the PortBinding struct. Does NOT free the socket itself.
- *
- * @param key   Registry key.
- * @param value PortBinding pointer.
- * @param ctx   Unused context.
- */
-void port_registry_free_binding(const char* key, void* value, void* ctx);
+int port_registry_unbind(PortRegistry* reg, uint8_t protocol, uint16_t port);
 
 #endif /* MAGI_LAYER4_PORT_REGISTRY_H */
@@ -13,10 +13,165 @@
 #include <stdlib.h>
 #include <string.h>
 
+/* ─── Sequence arithmetic ─── */
+
+/**
+ * @brief Modular a < b (RFC 793 §3.3).
+ *
+ * @param a First sequence number.
+ * @param b Second sequence number.
+ * @return true if a comes before b.
+ */
+bool tcp_seq_lt(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) < 0;
+}
+
+/**
+ * @brief Modular a <= b.
+ *
+ * @param a First sequence number.
+ * @param b Second sequence number.
+ * @return true if a equals or comes before b.
+ */
+bool tcp_seq_leq(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) <= 0;
+}
+
+/**
+ * @brief Modular a > b.
+ *
+ * @param a First sequence number.
+ * @param b Second sequence number.
+ * @return true if a comes after b.
+ */
+bool tcp_seq_gt(uint32_t a, uint32_t b) {
+  return tcp_seq_lt(b, a);
+}
+
+/**
+ * @brief Modular a >= b.
+ *
+ * @param a First sequence number.
+ * @param b Second sequence number.
+ * @return true if a equals or comes after b.
+ */
+bool tcp_seq_geq(uint32_t a, uint32_t b) {
+  return tcp_seq_leq(b, a);
+}
+
+/* ─── Options ─── */
+
+/**
+ * @brief Number of SACK blocks tcp_pack() will emit.
+ *
+ * @param seg Segment to inspect.
+ * @return sack_count clamped to TCP_SACK_MAX_BLOCKS.
+ */
+static size_t tcp_sack_emit_count(const TCPSegment* seg) {
+  return seg->sack_count < TCP_SACK_MAX_BLOCKS ? seg->sack_count : TCP_SACK_MAX_BLOCKS;
+}
+
+/**
+ * @brief Compute the header length including options.
+ *
+ * Each option is preceded by two NOPs so it stays 4-byte aligned, the
+ * layout RFC 2018 recommends: SACK-permitted takes 4 bytes, a SACK
+ * option 4 + 8 per block.
+ *
+ * @param seg Segment to measure.
+ * @return Header length in bytes.
+ */
+size_t tcp_header_len(const TCPSegment* seg) {
+  size_t len = TCP_HEADER_LEN;
+  if (seg == NULL) {
+    return len;
+  }
+  if (seg->sack_permitted) {
+    len += 4U;
+  }
+  size_t blocks = tcp_sack_emit_count(seg);
+  if (blocks > 0U) {
+    len += 4U + 8U * blocks;
+  }
+  return len;
+}
+
+/**
+ * @brief Write the option area behind the fixed header.
+ *
+ * @param seg Segment whose options are written.
+ * @param out Start of the option area; sized by tcp_header_len().
+ */
+static void tcp_write_options(const TCPSegment* seg, uint8_t* out) {
+  size_t off = 0U;
+  if (seg->sack_permitted) {
+    out[off++] = TCP_OPT_NOP;
+    out[off++] = TCP_OPT_NOP;
+    out[off++] = TCP_OPT_SACK_PERMITTED;
+    out[off++] = 2U;
+  }
+  size_t blocks = tcp_sack_emit_count(seg);
+  if (blocks > 0U) {
+    out[off++] = TCP_OPT_NOP;
+    out[off++] = TCP_OPT_NOP;
+    out[off++] = TCP_OPT_SACK;
+    out[off++] = (uint8_t)(2U + 8U * blocks);
+    for (size_t i = 0U; i < blocks; ++i) {
+      WRITE_U32(out, off, seg->sack[i].start);
+      WRITE_U32(out, off + 4U, seg->sack[i].end);
+      off += 8U;
+    }
+  }
+}
+
+/**
+ * @brief Parse the option area into the segment.
+ *
+ * Stops at EOL or at the first malformed option; what was parsed up to
+ * there is kept. Unknown options are skipped by their length byte.
+ *
+ * @param seg Segment to fill.
+ * @param opt Start of the option area.
+ * @param len Length of the option area.
+ */
+static void tcp_parse_options(TCPSegment* seg, const uint8_t* opt, size_t len) {
+  size_t i = 0U;
+  while (i < len) {
+    uint8_t kind = opt[i];
+    if (kind == TCP_OPT_EOL) {
+      break;
+    }
+    if (kind == TCP_OPT_NOP) {
+      ++i;
+      continue;
+    }
+    if (i + 1U >= len) {
+      break;
+    }
+    size_t opt_len = opt[i + 1U];
+    if (opt_len < 2U || i + opt_len > len) {
+      break;
+    }
+    if (kind == TCP_OPT_SACK_PERMITTED && opt_len == 2U) {
+      seg->sack_permitted = true;
+    } else if (kind == TCP_OPT_SACK && (opt_len - 2U) % 8U == 0U) {
+      size_t blocks = (opt_len - 2U) / 8U;
+      for (size_t b = 0U; b < blocks && seg->sack_count < TCP_SACK_MAX_BLOCKS; ++b) {
+        seg->sack[seg->sack_count].start = READ_U32(opt, i + 2U + 8U * b);
+        seg->sack[seg->sack_count].end = READ_U32(opt, i + 6U + 8U * b);
+        seg->sack_count++;
+      }
+    }
+    i += opt_len;
+  }
+}
+
+/* ─── Segment serialization ─── */
+
 /**
  * @brief Serialize a TCPSegment into a byte buffer.
  *
- * Builds the 20-byte TCP header in network byte order, computes the TCP
+ * Builds the TCP header and its options in network byte order, computes the TCP
  * checksum over the segment using the IPv4 pseudo-header (src_ip, dst_ip,
  * protocol=6, segment length), and copies the payload after the header.
  * On success the segment's checksum and data_offset fields are updated.
@@ -24,7 +179,7 @@
  * @param seg     Segment to serialize.
  * @param src_ip  Source IPv4 address (4 bytes) for pseudo-header.
  * @param dst_ip  Destination IPv4 address (4 bytes) for pseudo-header.
- * @param out     Output buffer (must hold at least TCP_HEADER_LEN + payload_len bytes).
+ * @param out     Output buffer (must hold at least tcp_header_len(seg) + payload_len bytes).
  * @param out_len Capacity of the output buffer.
  * @return MAGI_OK on success, MAGI_ERR_BADARGS on null pointer or insufficient buffer.
  */
@@ -35,7 +190,8 @@ int tcp_pack(TCPSegment* seg, const uint8_t src_ip[4], const uint8_t dst_ip[4],
     return MAGI_ERR_BADARGS;
   }
 
-  size_t total_len = TCP_HEADER_LEN + seg->payload_len;
+  size_t hdr_len = tcp_header_len(seg);
+  size_t total_len = hdr_len + seg->payload_len;
   if (out_len < total_len) {
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
@@ -48,16 +204,13 @@ int tcp_pack(TCPSegment* seg, const uint8_t src_ip[4], const uint8_t dst_ip[4],
   WRITE_U32(out, 4U, seg->seq_num);
   WRITE_U32(out, 8U, seg->ack_num);
 
-  uint8_t data_offset = (seg->data_offset != 0U) ? seg->data_offset : TCP_DATA_OFFSET_DEFAULT;
+  uint8_t data_offset = (uint8_t)(hdr_len / 4U);
   WRITE_U8(out, 12U, (data_offset << 4U) & 0xF0U);
   WRITE_U8(out, 13U, seg->flags);
-  WRITE_U16(out, 14U, seg->window_size != 0U ? seg->window_size : TCP_WINDOW_SIZE_DEFAULT);
+  WRITE_U16(out, 14U, seg->window_size);
   WRITE_U16(out, 16U, 0U); /* checksum placeholder */
   WRITE_U16(out, 18U, 0U); /* urgent pointer */
-
-  if (seg->payload_len > 0U && seg->payload != NULL) {
-    memcpy(out + TCP_HEADER_LEN, seg->payload, seg->payload_len);
-  }
+  tcp_write_options(seg, out + TCP_HEADER_LEN);
 
   /* Build pseudo-header for checksum */
   uint8_t pseudo_hdr[12];
@@ -67,7 +220,15 @@ int tcp_pack(TCPSegment* seg, const uint8_t src_ip[4], const uint8_t dst_ip[4],
   pseudo_hdr[9] = 6U; /* IPPROTO_TCP */
   WRITE_U16(pseudo_hdr, 10U, (uint16_t)total_len);
 
-  uint16_t cksum = transport_checksum(pseudo_hdr, 12U, out, total_len);
+  /* The header length is a multiple of four, so the payload sums on a word boundary. */
+  uint32_t sum = checksum_partial(0U, pseudo_hdr, sizeof(pseudo_hdr));
+  sum = checksum_partial(sum, out, hdr_len);
+  if (seg->payload_len > 0U && seg->payload != NULL) {
+    sum = checksum_copy_partial(sum, out + hdr_len, seg->payload, seg->payload_len);
+  } else {
+    sum = checksum_partial(sum, out + hdr_len, seg->payload_len);
+  }
+  uint16_t cksum = checksum_finish(sum);
   WRITE_U16(out, 16U, cksum);
 
   /* Update segment fields */
@@ -80,7 +241,7 @@ int tcp_pack(TCPSegment* seg, const uint8_t src_ip[4], const uint8_t dst_ip[4],
 /**
  * @brief Deserialize a byte buffer into a TCPSegment.
  *
- * Parses the 20-byte TCP header from the input buffer, validates the
+ * Parses the TCP header and its SACK options from the input buffer, validates the
  * checksum using the IPv4 pseudo-header (src_ip, dst_ip, protocol=6,
  * segment length), and sets the payload pointer into the input buffer.
  * The segment is zeroed before parsing.
@@ -137,6 +298,7 @@ int tcp_unpack(TCPSegment* seg, const uint8_t src_ip[4], const uint8_t dst_ip[4]
     return MAGI_ERR_BADCKSUM;
   }
 
+  tcp_parse_options(seg, in + TCP_HEADER_LEN, hdr_len - TCP_HEADER_LEN);
   seg->payload = in + hdr_len;
   seg->payload_len = in_len - hdr_len;
 
@@ -1,17 +1,22 @@
 /**
  * @file tcp.h
  * @brief TCP segment serialization and parsing.
+ *
+ * The only options understood are SACK-permitted and SACK (RFC 2018);
+ * others are skipped on input and never generated.
  */
 
 #ifndef MAGI_LAYER4_TCP_H
 #define MAGI_LAYER4_TCP_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
 #include "core/packet.h"
 
 #define TCP_HEADER_LEN 20U
+#define TCP_HEADER_LEN_MAX 60U
 #define TCP_DATA_OFFSET_DEFAULT 5U
 #define TCP_WINDOW_SIZE_DEFAULT 65535U
 
@@ -24,6 +29,21 @@
 #define TCP_FLAG_SYNACK (TCP_FLAG_SYN | TCP_FLAG_ACK)
 #define TCP_FLAG_FINACK (TCP_FLAG_FIN | TCP_FLAG_ACK)
 
+/* TCP option kinds */
+#define TCP_OPT_EOL 0U
+#define TCP_OPT_NOP 1U
+#define TCP_OPT_SACK_PERMITTED 4U
+#define TCP_OPT_SACK 5U
+
+/** SACK blocks that fit in the option space next to nothing else. */
+#define TCP_SACK_MAX_BLOCKS 4U
+
+/** @brief One SACK block: received sequence range [start, end). */
+typedef struct TCPSackBlock {
+  uint32_t start;
+  uint32_t end;
+} TCPSackBlock;
+
 /**
  * @brief Parsed TCP segment.
  */
@@ -33,23 +53,71 @@ typedef struct TCPSegment {
   uint16_t dst_port;
   uint32_t seq_num;
   uint32_t ack_num;
-  uint8_t data_offset; /* 4-bit field; always 5 for our impl */
+  uint8_t data_offset; /* 4-bit field; set by tcp_pack from the options present */
   uint8_t flags;
   uint16_t window_size;
   uint16_t checksum;
+  bool sack_permitted; /* SACK-permitted option (SYN segments only) */
+  uint8_t sack_count;  /* number of valid entries in sack[] */
+  TCPSackBlock sack[TCP_SACK_MAX_BLOCKS];
   const uint8_t* payload;
   size_t payload_len;
 } TCPSegment;
 
+/**
+ * @brief Compare sequence numbers modulo 2^32 (RFC 793 §3.3).
+ *
+ * @param a First sequence number.
+ * @param b Second sequence number.
+ * @return true if a comes before b.
+ */
+bool tcp_seq_lt(uint32_t a, uint32_t b);
+
+/**
+ * @brief Modular a <= b.
+ *
+ * @param a First sequence number.
+ * @param b Second sequence number.
+ * @return true if a equals or comes before b.
+ */
+bool tcp_seq_leq(uint32_t a, uint32_t b);
+
+/**
+ * @brief Modular a > b.
+ *
+ * @param a First sequence number.
+ * @param b Second sequence number.
+ * @return true if a comes after b.
+ */
+bool tcp_seq_gt(uint32_t a, uint32_t b);
+
+/**
+ * @brief Modular a >= b.
+ *
+ * @param a First sequence number.
+ * @param b Second sequence number.
+ * @return true if a equals or comes after b.
+ */
+bool tcp_seq_geq(uint32_t a, uint32_t b);
+
+/**
+ * @brief Header length tcp_pack() will write for a segment, options included.
+ *
+ * @param seg Segment to measure.
+ * @return Header length in bytes, a multiple of 4 between 20 and 60.
+ */
+size_t tcp_header_len(const TCPSegment* seg);
+
 /**
  * @brief Serialize a TCP segment into a byte buffer.
  *
- * Checksum is computed using the IPv4 pseudo-header.
+ * Checksum is computed using the IPv4 pseudo-header. The window field is
+ * written as given, so a zero window is advertised as zero.
  *
  * @param seg     Source segment.
  * @param src_ip  Source IPv4 address (4 bytes) for pseudo-header.
  * @param dst_ip  Destination IPv4 address (4 bytes) for pseudo-header.
- * @param out     Output buffer (must be at least TCP_HEADER_LEN + payload_len).
+ * @param out     Output buffer (must be at least tcp_header_len(seg) + payload_len).
  * @param out_len Output buffer size.
  * @return MAGI_OK on success, otherwise an error code.
  */
@@ -59,7 +127,8 @@ int tcp_pack(TCPSegment* seg, const uint8_t src_ip[4], const uint8_t dst_ip[4],
 /**
  * @brief Parse a TCP segment from raw bytes.
  *
- * Validates the checksum using the IPv4 pseudo-header.
+ * Validates the checksum using the IPv4 pseudo-header and parses the
+ * SACK-permitted and SACK options; other options are skipped.
  *
  * @param seg     Destination segment struct.
  * @param src_ip  Source IPv4 address (4 bytes) for pseudo-header.
@@ -0,0 +1,223 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tcp_conn.h"
+
+#include "layer4/tcp_socket.h"
+#include "utils/magi_error.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TCP_CONN_MIN_CAPACITY 16U
+
+/** @brief One slot: the packed four-tuple and the socket it names. */
+typedef struct TCPConnEntry {
+  /** Remote address in the high half, local address in the low half. */
+  uint64_t addrs;
+  /** Remote port in the high half, local port in the low half. */
+  uint32_t ports;
+  bool used;
+  struct TCPSocket* sock;
+} TCPConnEntry;
+
+struct TCPConnTable {
+  TCPConnEntry* slots;
+  size_t capacity;
+  size_t count;
+};
+
+/**
+ * @brief Pack two IPv4 addresses into one key word.
+ *
+ * @param remote_ip Remote address.
+ * @param local_ip Local address.
+ * @return Remote address << 32 | local address, both host order.
+ */
+static uint64_t tcp_conn_addrs(const uint8_t remote_ip[4], const uint8_t local_ip[4]) {
+  uint64_t key = 0U;
+  for (size_t index = 0U; index < 4U; ++index) {
+    key = (key << 8U) | remote_ip[index];
+  }
+  for (size_t index = 0U; index < 4U; ++index) {
+    key = (key << 8U) | local_ip[index];
+  }
+  return key;
+}
+
+/**
+ * @brief Home slot for a key (multiplicative hash with a high-bit fold).
+ *
+ * @param table Connection table.
+ * @param addrs Packed addresses.
+ * @param ports Packed ports.
+ * @return Slot index.
+ */
+static size_t tcp_conn_home(const TCPConnTable* table, uint64_t addrs, uint32_t ports) {
+  uint64_t hash = (addrs ^ ((uint64_t)ports << 16U)) * 0x9E3779B97F4A7C15ULL;
+  hash ^= hash >> 29U;
+  return (size_t)(hash & (uint64_t)(table->capacity - 1U));
+}
+
+/**
+ * @brief Find the slot holding a key, or the empty slot where it would go.
+ *
+ * @param table Connection table.
+ * @param addrs Packed addresses.
+ * @param ports Packed ports.
+ * @return Slot index.
+ */
+static size_t tcp_conn_probe(const TCPConnTable* table, uint64_t addrs, uint32_t ports) {
+  size_t mask = table->capacity - 1U;
+  size_t pos = tcp_conn_home(table, addrs, ports);
+  while (table->slots[pos].used &&
+         (table->slots[pos].addrs != addrs || table->slots[pos].ports != ports)) {
+    pos = (pos + 1U) & mask;
+  }
+  return pos;
+}
+
+/**
+ * @brief Double the slot array and rehash all live entries.
+ *
+ * @param table Connection table.
+ * @return MAGI_OK on success, or MAGI_ERR_NOMEM.
+ */
+static int tcp_conn_grow(TCPConnTable* table) {
+  size_t new_cap = table->capacity * 2U;
+  TCPConnEntry* slots = calloc(new_cap, sizeof(*slots));
+  if (slots == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
+  }
+
+  TCPConnEntry* old = table->slots;
+  size_t old_cap = table->capacity;
+  table->slots = slots;
+  table->capacity = new_cap;
+  for (size_t index = 0U; index < old_cap; ++index) {
+    if (old[index].used) {
+      table->slots[tcp_conn_probe(table, old[index].addrs, old[index].ports)] = old[index];
+    }
+  }
+
+  free(old);
+  return MAGI_OK;
+}
+
+TCPConnTable* tcp_conn_table_new(size_t initial_capacity) {
+  TCPConnTable* table = calloc(1U, sizeof(*table));
+  if (table == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+
+  size_t capacity = TCP_CONN_MIN_CAPACITY;
+  while (capacity < initial_capacity) {
+    capacity *= 2U;
+  }
+
+  table->slots = calloc(capacity, sizeof(*table->slots));
+  if (table->slots == NULL) {
+    free(table);
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+
+  table->capacity = capacity;
+  return table;
+}
+
+void tcp_conn_table_free(TCPConnTable* table) {
+  if (table == NULL) {
+    return;
+  }
+
+  free(table->slots);
+  free(table);
+}
+
+int tcp_conn_table_insert(TCPConnTable* table, struct TCPSocket* sock) {
+  if (table == NULL || sock == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  uint64_t addrs = tcp_conn_addrs(sock->remote_ip, sock->local_ip);
+  uint32_t ports = ((uint32_t)sock->remote_port << 16U) | sock->local_port;
+  size_t pos = tcp_conn_probe(table, addrs, ports);
+  if (table->slots[pos].used) {
+    magi_errno = MAGI_ERR_PORTUSED;
+    return MAGI_ERR_PORTUSED;
+  }
+
+  if ((table->count + 1U) * 4U > table->capacity * 3U) {
+    if (tcp_conn_grow(table) != MAGI_OK) {
+      return MAGI_ERR_NOMEM;
+    }
+    pos = tcp_conn_probe(table, addrs, ports);
+  }
+
+  table->slots[pos] = (TCPConnEntry){.addrs = addrs, .ports = ports, .used = true, .sock = sock};
+  table->count++;
+  return MAGI_OK;
+}
+
+struct TCPSocket* tcp_conn_table_lookup(const TCPConnTable* table, const uint8_t remote_ip[4],
+                                        uint16_t remote_port, const uint8_t local_ip[4],
+                                        uint16_t local_port) {
+  if (table == NULL || table->count == 0U) {
+    return NULL;
+  }
+
+  uint64_t addrs = tcp_conn_addrs(remote_ip, local_ip);
+  uint32_t ports = ((uint32_t)remote_port << 16U) | local_port;
+  const TCPConnEntry* entry = &table->slots[tcp_conn_probe(table, addrs, ports)];
+  return entry->used ? entry->sock : NULL;
+}
+
+bool tcp_conn_table_remove(TCPConnTable* table, const struct TCPSocket* sock) {
+  if (table == NULL || sock == NULL || table->count == 0U) {
+    return false;
+  }
+
+  uint64_t addrs = tcp_conn_addrs(sock->remote_ip, sock->local_ip);
+  uint32_t ports = ((uint32_t)sock->remote_port << 16U) | sock->local_port;
+  size_t pos = tcp_conn_probe(table, addrs, ports);
+  if (!table->slots[pos].used || table->slots[pos].sock != sock) {
+    return false;
+  }
+
+  /* Backward-shift deletion keeps every probe chain unbroken. */
+  size_t mask = table->capacity - 1U;
+  size_t hole = pos;
+  size_t next = (pos + 1U) & mask;
+  while (table->slots[next].used) {
+    size_t home = tcp_conn_home(table, table->slots[next].addrs, table->slots[next].ports);
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      table->slots[hole] = table->slots[next];
+      hole = next;
+    }
+    next = (next + 1U) & mask;
+  }
+
+  memset(&table->slots[hole], 0, sizeof(table->slots[hole]));
+  table->count--;
+  return true;
+}
+
+void tcp_conn_table_foreach(const TCPConnTable* table, tcp_conn_visitor_fn fn, void* ctx) {
+  if (table == NULL || fn == NULL) {
+    return;
+  }
+
+  for (size_t index = 0U; index < table->capacity; ++index) {
+    if (table->slots[index].used) {
+      fn(table->slots[index].sock, ctx);
+    }
+  }
+}
+
+size_t tcp_conn_table_count(const TCPConnTable* table) {
+  return table != NULL ? table->count : 0U;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file tcp_conn.h
+ * @brief Four-tuple TCP connection table.
+ *
+ * Holds the connections a listening socket has spawned, keyed by
+ * (remote IP, remote port, local IP, local port). L4 dispatch consults it
+ * before the per-port registry, so any number of clients can talk to one
+ * listening port at once. Keys are packed into a uint64_t and a uint32_t
+ * and live inline in an open-addressing slot array (linear probing,
+ * backward-shift deletion) that doubles at 75% load.
+ */
+
+#ifndef MAGI_LAYER4_TCP_CONN_H
+#define MAGI_LAYER4_TCP_CONN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct TCPSocket;
+
+/** @brief Opaque connection table. */
+typedef struct TCPConnTable TCPConnTable;
+
+typedef void (*tcp_conn_visitor_fn)(struct TCPSocket* sock, void* ctx);
+
+/**
+ * @brief Create an empty connection table.
+ *
+ * @param initial_capacity Minimum desired slot count.
+ * @return Table instance, or NULL on failure.
+ */
+TCPConnTable* tcp_conn_table_new(size_t initial_capacity);
+
+/**
+ * @brief Destroy a connection table. The sockets are not freed.
+ *
+ * @param table Table to free. NULL is allowed.
+ */
+void tcp_conn_table_free(TCPConnTable* table);
+
+/**
+ * @brief Add a socket under its current four-tuple.
+ *
+ * @param table Connection table.
+ * @param sock Socket with local and remote address and port set.
+ * @return MAGI_OK, MAGI_ERR_PORTUSED if the four-tuple is taken, or MAGI_ERR_NOMEM.
+ */
+int tcp_conn_table_insert(TCPConnTable* table, struct TCPSocket* sock);
+
+/**
+ * @brief Find the connection a segment belongs to.
+ *
+ * @param table Connection table.
+ * @param remote_ip Segment source address.
+ * @param remote_port Segment source port.
+ * @param local_ip Segment destination address.
+ * @param local_port Segment destination port.
+ * @return Socket, or NULL if no connection matches.
+ */
+struct TCPSocket* tcp_conn_table_lookup(const TCPConnTable* table, const uint8_t remote_ip[4],
+                                        uint16_t remote_port, const uint8_t local_ip[4],
+                                        uint16_t local_port);
+
+/**
+ * @brief Remove a socket; looked up by its four-tuple, matched by pointer.
+ *
+ * @param table Connection table.
+ * @param sock Socket to remove.
+ * @return true if the socket was in the table.
+ */
+bool tcp_conn_table_remove(TCPConnTable* table, const struct TCPSocket* sock);
+
+/**
+ * @brief Visit every socket in unspecified order. The visitor must not modify the table.
+ *
+ * @param table Connection table.
+ * @param fn Visitor callback.
+ * @param ctx Opaque callback context.
+ */
+void tcp_conn_table_foreach(const TCPConnTable* table, tcp_conn_visitor_fn fn, void* ctx);
+
+/**
+ * @brief Number of connections in the table.
+ *
+ * @param table Connection table.
+ * @return Entry count, or 0 for NULL.
+ */
+size_t tcp_conn_table_count(const TCPConnTable* table);
+
+#endif /* MAGI_LAYER4_TCP_CONN_H */
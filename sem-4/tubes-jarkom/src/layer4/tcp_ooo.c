@@ -0,0 +1,344 @@
+/**
+ * @file tcp_ooo.c
+ * @brief Treap of disjoint out-of-order sequence ranges.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "tcp_ooo.h"
+
+#include "layer4/tcp.h"
+#include "utils/magi_error.h"
+
+#include <stdlib.h>
+
+/** Pool size allocated by the first insert. */
+#define TCP_OOO_POOL_INITIAL 16U
+
+/**
+ * @brief Next treap priority (xorshift32).
+ *
+ * @param tree Tree whose generator advances.
+ * @return Pseudo-random priority.
+ */
+static uint32_t tcp_ooo_rand(TCPOooTree* tree) {
+  uint32_t x = tree->rng;
+  x ^= x << 13U;
+  x ^= x >> 17U;
+  x ^= x << 5U;
+  tree->rng = x;
+  return x;
+}
+
+/**
+ * @brief Take a node from the free list or the pool, growing it if needed.
+ *
+ * @param tree  Tree owning the pool.
+ * @param range Range stored in the node.
+ * @return Node index, or TCP_OOO_NIL on allocation failure.
+ */
+static uint32_t tcp_ooo_node_alloc(TCPOooTree* tree, TCPOooRange range) {
+  uint32_t idx;
+  if (tree->free_head != TCP_OOO_NIL) {
+    idx = tree->free_head;
+    tree->free_head = tree->nodes[idx].left;
+  } else {
+    if (tree->used == tree->cap) {
+      uint32_t cap = tree->cap != 0U ? tree->cap * 2U : TCP_OOO_POOL_INITIAL;
+      TCPOooNode* nodes = realloc(tree->nodes, (size_t)cap * sizeof(*nodes));
+      if (nodes == NULL) {
+        return TCP_OOO_NIL;
+      }
+      tree->nodes = nodes;
+      tree->cap = cap;
+    }
+    idx = tree->used++;
+  }
+
+  TCPOooNode* node = &tree->nodes[idx];
+  node->range = range;
+  node->prio = tcp_ooo_rand(tree);
+  node->left = TCP_OOO_NIL;
+  node->right = TCP_OOO_NIL;
+  return idx;
+}
+
+/**
+ * @brief Return a node to the free list and drop it from the totals.
+ *
+ * @param tree Tree owning the pool.
+ * @param idx  Node to release.
+ */
+static void tcp_ooo_node_release(TCPOooTree* tree, uint32_t idx) {
+  TCPOooNode* node = &tree->nodes[idx];
+  tree->count--;
+  tree->bytes -= node->range.end - node->range.start;
+  node->left = tree->free_head;
+  tree->free_head = idx;
+}
+
+/**
+ * @brief Split a subtree into ranges starting before key and the rest.
+ *
+ * @param tree  Tree owning the pool.
+ * @param root  Subtree to split.
+ * @param key   Split point.
+ * @param left  Receives the subtree of ranges with start < key.
+ * @param right Receives the subtree of ranges with start >= key.
+ */
+static void tcp_ooo_split(TCPOooTree* tree, uint32_t root, uint32_t key, uint32_t* left,
+                          uint32_t* right) {
+  if (root == TCP_OOO_NIL) {
+    *left = TCP_OOO_NIL;
+    *right = TCP_OOO_NIL;
+    return;
+  }
+
+  TCPOooNode* node = &tree->nodes[root];
+  if (tcp_seq_lt(node->range.start, key)) {
+    tcp_ooo_split(tree, node->right, key, &node->right, right);
+    *left = root;
+  } else {
+    tcp_ooo_split(tree, node->left, key, left, &node->left);
+    *right = root;
+  }
+}
+
+/**
+ * @brief Join two subtrees where every range in left precedes every range in right.
+ *
+ * @param tree  Tree owning the pool.
+ * @param left  Lower subtree.
+ * @param right Upper subtree.
+ * @return Root of the joined subtree.
+ */
+static uint32_t tcp_ooo_join(TCPOooTree* tree, uint32_t left, uint32_t right) {
+  if (left == TCP_OOO_NIL) {
+    return right;
+  }
+  if (right == TCP_OOO_NIL) {
+    return left;
+  }
+
+  if (tree->nodes[left].prio > tree->nodes[right].prio) {
+    tree->nodes[left].right = tcp_ooo_join(tree, tree->nodes[left].right, right);
+    return left;
+  }
+  tree->nodes[right].left = tcp_ooo_join(tree, left, tree->nodes[right].left);
+  return right;
+}
+
+/**
+ * @brief Unlink the lowest node of a subtree.
+ *
+ * The node's right child takes its place, which keeps the heap order
+ * since the child's priority is no higher than the removed node's.
+ *
+ * @param tree Tree owning the pool.
+ * @param root Non-empty subtree.
+ * @param out  Receives the unlinked node.
+ * @return New subtree root.
+ */
+static uint32_t tcp_ooo_unlink_min(TCPOooTree* tree, uint32_t root, uint32_t* out) {
+  TCPOooNode* node = &tree->nodes[root];
+  if (node->left == TCP_OOO_NIL) {
+    *out = root;
+    return node->right;
+  }
+  node->left = tcp_ooo_unlink_min(tree, node->left, out);
+  return root;
+}
+
+/**
+ * @brief Unlink the highest node of a subtree.
+ *
+ * @param tree Tree owning the pool.
+ * @param root Non-empty subtree.
+ * @param out  Receives the unlinked node.
+ * @return New subtree root.
+ */
+static uint32_t tcp_ooo_unlink_max(TCPOooTree* tree, uint32_t root, uint32_t* out) {
+  TCPOooNode* node = &tree->nodes[root];
+  if (node->right == TCP_OOO_NIL) {
+    *out = root;
+    return node->left;
+  }
+  node->right = tcp_ooo_unlink_max(tree, node->right, out);
+  return root;
+}
+
+void tcp_ooo_init(TCPOooTree* tree) {
+  tree->nodes = NULL;
+  tree->cap = 0U;
+  tree->root = TCP_OOO_NIL;
+  tree->free_head = TCP_OOO_NIL;
+  tree->used = 0U;
+  tree->rng = 0x9E3779B9U;
+  tree->count = 0U;
+  tree->bytes = 0U;
+}
+
+void tcp_ooo_free(TCPOooTree* tree) {
+  if (tree == NULL) {
+    return;
+  }
+  free(tree->nodes);
+  tcp_ooo_init(tree);
+}
+
+void tcp_ooo_clear(TCPOooTree* tree) {
+  tree->root = TCP_OOO_NIL;
+  tree->free_head = TCP_OOO_NIL;
+  tree->used = 0U;
+  tree->count = 0U;
+  tree->bytes = 0U;
+}
+
+/**
+ * @brief Insert a range, absorbing its neighbours.
+ *
+ * Splits the tree at start. The highest range below start is absorbed if
+ * it reaches start; ranges from start upward are absorbed while they begin
+ * at or before the growing end. The merged range is joined back between
+ * the two halves.
+ *
+ * @param tree   Tree to insert into.
+ * @param start  First sequence number.
+ * @param end    One past the last sequence number.
+ * @param merged Set to the resulting range. May be NULL.
+ * @return MAGI_OK, or MAGI_ERR_NOMEM.
+ */
+int tcp_ooo_insert(TCPOooTree* tree, uint32_t start, uint32_t end, TCPOooRange* merged) {
+  if (tree == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+  if (!tcp_seq_lt(start, end)) {
+    if (merged != NULL) {
+      merged->start = start;
+      merged->end = start;
+    }
+    return MAGI_OK;
+  }
+
+  /* Take the node first so a failed allocation leaves the tree untouched. */
+  TCPOooRange range = {start, end};
+  uint32_t idx = tcp_ooo_node_alloc(tree, range);
+  if (idx == TCP_OOO_NIL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
+  }
+
+  uint32_t left;
+  uint32_t right;
+  tcp_ooo_split(tree, tree->root, start, &left, &right);
+
+  if (left != TCP_OOO_NIL) {
+    uint32_t prev = left;
+    while (tree->nodes[prev].right != TCP_OOO_NIL) {
+      prev = tree->nodes[prev].right;
+    }
+    const TCPOooRange* p = &tree->nodes[prev].range;
+    if (tcp_seq_geq(p->end, range.start)) {
+      range.start = p->start;
+      if (tcp_seq_gt(p->end, range.end)) {
+        range.end = p->end;
+      }
+      left = tcp_ooo_unlink_max(tree, left, &prev);
+      tcp_ooo_node_release(tree, prev);
+    }
+  }
+
+  while (right != TCP_OOO_NIL) {
+    uint32_t next = right;
+    while (tree->nodes[next].left != TCP_OOO_NIL) {
+      next = tree->nodes[next].left;
+    }
+    const TCPOooRange* n = &tree->nodes[next].range;
+    if (tcp_seq_gt(n->start, range.end)) {
+      break;
+    }
+    if (tcp_seq_gt(n->end, range.end)) {
+      range.end = n->end;
+    }
+    right = tcp_ooo_unlink_min(tree, right, &next);
+    tcp_ooo_node_release(tree, next);
+  }
+
+  tree->nodes[idx].range = range;
+  tree->count++;
+  tree->bytes += range.end - range.start;
+  tree->root = tcp_ooo_join(tree, tcp_ooo_join(tree, left, idx), right);
+
+  if (merged != NULL) {
+    *merged = range;
+  }
+  return MAGI_OK;
+}
+
+bool tcp_ooo_first(const TCPOooTree* tree, TCPOooRange* out) {
+  uint32_t idx = tree->root;
+  if (idx == TCP_OOO_NIL) {
+    return false;
+  }
+  while (tree->nodes[idx].left != TCP_OOO_NIL) {
+    idx = tree->nodes[idx].left;
+  }
+  *out = tree->nodes[idx].range;
+  return true;
+}
+
+void tcp_ooo_pop_first(TCPOooTree* tree) {
+  if (tree->root == TCP_OOO_NIL) {
+    return;
+  }
+  uint32_t idx;
+  tree->root = tcp_ooo_unlink_min(tree, tree->root, &idx);
+  tcp_ooo_node_release(tree, idx);
+}
+
+bool tcp_ooo_find(const TCPOooTree* tree, uint32_t seq, TCPOooRange* out) {
+  uint32_t idx = tree->root;
+  uint32_t best = TCP_OOO_NIL;
+  while (idx != TCP_OOO_NIL) {
+    const TCPOooNode* node = &tree->nodes[idx];
+    if (tcp_seq_leq(node->range.start, seq)) {
+      best = idx;
+      idx = node->right;
+    } else {
+      idx = node->left;
+    }
+  }
+  if (best == TCP_OOO_NIL || !tcp_seq_lt(seq, tree->nodes[best].range.end)) {
+    return false;
+  }
+  *out = tree->nodes[best].range;
+  return true;
+}
+
+/**
+ * @brief In-order walk collecting up to max ranges.
+ *
+ * @param tree Tree owning the pool.
+ * @param idx  Subtree root.
+ * @param out  Destination array.
+ * @param max  Capacity of out.
+ * @param n    Ranges written so far; advanced.
+ */
+static void tcp_ooo_collect(const TCPOooTree* tree, uint32_t idx, TCPOooRange* out, size_t max,
+                            size_t* n) {
+  if (idx == TCP_OOO_NIL || *n >= max) {
+    return;
+  }
+  tcp_ooo_collect(tree, tree->nodes[idx].left, out, max, n);
+  if (*n < max) {
+    out[(*n)++] = tree->nodes[idx].range;
+  }
+  tcp_ooo_collect(tree, tree->nodes[idx].right, out, max, n);
+}
+
+size_t tcp_ooo_ranges(const TCPOooTree* tree, TCPOooRange* out, size_t max) {
+  size_t n = 0U;
+  tcp_ooo_collect(tree, tree->root, out, max, &n);
+  return n;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file tcp_ooo.h
+ * @brief Out-of-order sequence ranges held by a TCP receiver.
+ *
+ * The tree records which sequence ranges beyond RCV.NXT have arrived; the
+ * bytes themselves sit in the socket's receive ring at their final
+ * position, so nothing is copied or allocated per segment. Ranges are kept
+ * disjoint: an insert merges every range it overlaps or touches, so the
+ * tree holds one node per hole-separated island no matter how the sender's
+ * segments were reordered or duplicated.
+ *
+ * Nodes live in one growable pool and are linked by index into a treap
+ * (binary search tree on the range start, heap on a random priority), so
+ * insert, merge and lookup are O(log n) expected. All comparisons use
+ * modular sequence arithmetic.
+ */
+
+#ifndef MAGI_LAYER4_TCP_OOO_H
+#define MAGI_LAYER4_TCP_OOO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief A received sequence range [start, end). */
+typedef struct TCPOooRange {
+  uint32_t start;
+  uint32_t end;
+} TCPOooRange;
+
+/** @brief Treap node; children and free-list links are pool indices. */
+typedef struct TCPOooNode {
+  TCPOooRange range;
+  uint32_t prio;
+  uint32_t left;
+  uint32_t right;
+} TCPOooNode;
+
+/** @brief Set of disjoint out-of-order ranges. */
+typedef struct TCPOooTree {
+  TCPOooNode* nodes; /* pool; grown by doubling */
+  uint32_t cap;
+  uint32_t root;      /* TCP_OOO_NIL when empty */
+  uint32_t free_head; /* released nodes, linked through left */
+  uint32_t used;      /* pool slots handed out at least once */
+  uint32_t rng;       /* xorshift state for priorities */
+  /** Ranges currently held. */
+  size_t count;
+  /** Sequence space covered by all ranges. */
+  size_t bytes;
+} TCPOooTree;
+
+/** Null node index. */
+#define TCP_OOO_NIL UINT32_MAX
+
+/**
+ * @brief Initialise an empty tree. Nothing is allocated until the first insert.
+ *
+ * @param tree Tree to initialise.
+ */
+void tcp_ooo_init(TCPOooTree* tree);
+
+/**
+ * @brief Release the node pool.
+ *
+ * @param tree Tree to free. NULL is allowed.
+ */
+void tcp_ooo_free(TCPOooTree* tree);
+
+/**
+ * @brief Drop every range but keep the pool for reuse.
+ *
+ * @param tree Tree to clear.
+ */
+void tcp_ooo_clear(TCPOooTree* tree);
+
+/**
+ * @brief Add [start, end), merging with every range it overlaps or touches.
+ *
+ * @param tree   Tree to insert into.
+ * @param start  First sequence number.
+ * @param end    One past the last sequence number; an empty range is ignored.
+ * @param merged Set to the range now holding [start, end). May be NULL.
+ * @return MAGI_OK, or MAGI_ERR_NOMEM if the pool could not grow.
+ */
+int tcp_ooo_insert(TCPOooTree* tree, uint32_t start, uint32_t end, TCPOooRange* merged);
+
+/**
+ * @brief Get the lowest range.
+ *
+ * @param tree Tree to inspect.
+ * @param out  Set to the lowest range.
+ * @return true if the tree is not empty.
+ */
+bool tcp_ooo_first(const TCPOooTree* tree, TCPOooRange* out);
+
+/**
+ * @brief Remove the lowest range.
+ *
+ * @param tree Tree to modify. An empty tree is left unchanged.
+ */
+void tcp_ooo_pop_first(TCPOooTree* tree);
+
+/**
+ * @brief Find the range containing a sequence number.
+ *
+ * @param tree Tree to search.
+ * @param seq  Sequence number to look up.
+ * @param out  Set to the containing range.
+ * @return true if some range contains seq.
+ */
+bool tcp_ooo_find(const TCPOooTree* tree, uint32_t seq, TCPOooRange* out);
+
+/**
+ * @brief List ranges in ascending sequence order.
+ *
+ * @param tree Tree to walk.
+ * @param out  Destination array.
+ * @param max  Capacity of out.
+ * @return Number of ranges written (at most max).
+ */
+size_t tcp_ooo_ranges(const TCPOooTree* tree, TCPOooRange* out, size_t max);
+
+#endif /* MAGI_LAYER4_TCP_OOO_H */
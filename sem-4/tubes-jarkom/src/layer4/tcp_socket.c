@@ -4,14 +4,19 @@
  *
  * Implements the full state machine from AGENTS.md §11.2 including
  * 3-way handshake, 4-way teardown, RST handling, and out-of-order
- * reassembly in the receive buffer.
+ * reassembly in the receive buffer. The send side segments the send
+ * buffer by MSS, retransmits on RFC 6298 timeouts and on three duplicate
+ * ACKs, and runs NewReno congestion control.
  */
 
 #define _POSIX_C_SOURCE 200809L
+#define MAGI_LOG_SUBSYS MAGI_LOG_L4
 
 #include "tcp_socket.h"
 
 #include "core/interface.h"
+#include "core/pktbuf.h"
+#include "core/sim.h"
 #include "layer3/ipv4.h"
 #include "layer4/tcp.h"
 #include "utils/hashmap.h"
@@ -77,56 +82,129 @@ static void log_transition(TCPSocket* sock, TCPState old_state, TCPState new_sta
       tcp_state_name(new_state), (unsigned)flags, (unsigned)seq, (unsigned)ack);
 }
 
-/* ─── Segment sending helper ─── */
+/* ─── Segment sending helpers ─── */
 
 /**
- * @brief Build and send a TCP segment.
+ * @brief Receive window to advertise: free space in recv_buf.
  *
- * Allocates a buffer, serializes the segment via tcp_pack (which
- * computes the pseudo-header checksum), advances sock->seq_num
- * by the number of SYN/FIN flags plus payload bytes, then sends
- * the segment via node->send_ip_packet. The buffer is freed after
- * transmission.
+ * @param sock Socket whose buffer is measured.
+ * @return Window in bytes, clamped to the 16-bit header field.
+ */
+static uint16_t tcp_rcv_window(const TCPSocket* sock) {
+  size_t free_space =
+      sock->recv_buf_cap > sock->recv_buf_len ? sock->recv_buf_cap - sock->recv_buf_len : 0U;
+  return free_space > TCP_WINDOW_SIZE_DEFAULT ? (uint16_t)TCP_WINDOW_SIZE_DEFAULT
+                                              : (uint16_t)free_space;
+}
+
+/**
+ * @brief Serialize a segment into a fresh packet buffer.
+ *
+ * Allocates one packet buffer with headroom for the IPv4 and Ethernet
+ * headers and serializes the segment into it via tcp_pack (which computes
+ * the pseudo-header checksum). The payload is copied, so the caller's
+ * buffer may change as soon as this returns. Records the advertised
+ * window in sock->rcv_wnd_adv.
+ *
+ * A SYN offers SACK-permitted (a SYN+ACK only if the peer offered it).
+ * Bare ACKs carry SACK blocks while data is held out of order; segments
+ * with payload never do, so options cannot push them past the MSS.
  *
  * @param sock         Socket to send from.
+ * @param seq          Sequence number of the segment.
  * @param flags        TCP flags (SYN, ACK, FIN, PSH, etc.).
  * @param ack_num      Acknowledgment number for the segment.
  * @param payload      Payload data (may be NULL if len is 0).
  * @param payload_len  Length of payload in bytes.
- * @return MAGI_OK on success, or an error code from tcp_pack or send_ip_packet.
+ * @param out          Receives the packet buffer.
+ * @return MAGI_OK on success, MAGI_ERR_NOMEM, or an error code from tcp_pack.
  */
-static int tcp_send_segment(TCPSocket* sock, uint8_t flags, uint32_t ack_num,
-                            const uint8_t* payload, size_t payload_len) {
-  if (sock == NULL || sock->node == NULL || sock->node->send_ip_packet == NULL) {
-    magi_errno = MAGI_ERR_BADARGS;
-    return MAGI_ERR_BADARGS;
-  }
-
-  /* Cache the sequence number for this segment before any recursive calls. */
-  uint32_t used_seq = sock->seq_num;
-
+static int tcp_build_segment(TCPSocket* sock, uint32_t seq, uint8_t flags, uint32_t ack_num,
+                             const uint8_t* payload, size_t payload_len, PktBuf** out) {
   TCPSegment seg;
   memset(&seg, 0, sizeof(seg));
   seg.src_port = sock->local_port;
   seg.dst_port = sock->remote_port;
-  seg.seq_num = used_seq;
+  seg.seq_num = seq;
   seg.ack_num = ack_num;
-  seg.data_offset = TCP_DATA_OFFSET_DEFAULT;
   seg.flags = flags;
-  seg.window_size = TCP_WINDOW_SIZE_DEFAULT;
+  seg.window_size = tcp_rcv_window(sock);
   seg.payload = payload;
   seg.payload_len = payload_len;
+  if (flags & TCP_FLAG_SYN) {
+    seg.sack_permitted = !(flags & TCP_FLAG_ACK) || sock->sack_ok;
+  } else if (flags == TCP_FLAG_ACK && payload_len == 0U && sock->sack_ok) {
+    seg.sack_count = (uint8_t)tcp_socket_sack_blocks(sock, seg.sack, TCP_SACK_MAX_BLOCKS);
+  }
 
-  size_t total_len = TCP_HEADER_LEN + payload_len;
-  uint8_t* buf = malloc(total_len);
-  if (buf == NULL) {
-    magi_errno = MAGI_ERR_NOMEM;
+  size_t total_len = tcp_header_len(&seg) + payload_len;
+  PktBuf* pkt = pktbuf_new(PKTBUF_HEADROOM, total_len);
+  if (pkt == NULL) {
     return MAGI_ERR_NOMEM;
   }
 
+  uint8_t* buf = pktbuf_put(pkt, total_len);
   int status = tcp_pack(&seg, sock->local_ip, sock->remote_ip, buf, total_len);
   if (status != MAGI_OK) {
-    free(buf);
+    pktbuf_release(pkt);
+    return status;
+  }
+
+  sock->rcv_wnd_adv = seg.window_size;
+  *out = pkt;
+  return MAGI_OK;
+}
+
+/**
+ * @brief Hand a built segment to the network layer.
+ *
+ * Uses node->send_ip_pkt so the lower layers prepend their headers in
+ * place; nodes without the zero-copy hook fall back to
+ * node->send_ip_packet.
+ *
+ * @param sock Socket sending the segment.
+ * @param pkt  Segment from tcp_build_segment(); consumed.
+ * @return MAGI_OK on success, or an error code from the send hook.
+ */
+static int tcp_transmit(TCPSocket* sock, PktBuf* pkt) {
+  if (sock->node->send_ip_pkt != NULL) {
+    return sock->node->send_ip_pkt(sock->node, sock->local_ip, sock->remote_ip, IPV4_PROTOCOL_TCP,
+                                   IPV4_DEFAULT_TTL, pkt);
+  }
+
+  int status = sock->node->send_ip_packet(sock->node, sock->local_ip, sock->remote_ip,
+                                          IPV4_PROTOCOL_TCP, IPV4_DEFAULT_TTL, pkt->data, pkt->len);
+  pktbuf_release(pkt);
+  return status;
+}
+
+/**
+ * @brief Build and send an untracked control segment at seq_num.
+ *
+ * Used for SYN, SYN+ACK and bare ACKs; data and FIN go through the
+ * retransmission queue instead. Advances sock->seq_num by the number of
+ * SYN/FIN flags plus payload bytes.
+ *
+ * @param sock         Socket to send from.
+ * @param flags        TCP flags (SYN, ACK, FIN, PSH, etc.).
+ * @param ack_num      Acknowledgment number for the segment.
+ * @param payload      Payload data (may be NULL if len is 0).
+ * @param payload_len  Length of payload in bytes.
+ * @return MAGI_OK on success, or an error code from tcp_pack or send_ip_packet.
+ */
+static int tcp_send_segment(TCPSocket* sock, uint8_t flags, uint32_t ack_num,
+                            const uint8_t* payload, size_t payload_len) {
+  if (sock == NULL || sock->node == NULL || sock->node->send_ip_packet == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  /* Cache the sequence number for this segment before any recursive calls. */
+  uint32_t used_seq = sock->seq_num;
+
+  PktBuf* pkt = NULL;
+  int status = tcp_build_segment(sock, used_seq, flags, ack_num, payload, payload_len, &pkt);
+  if (status != MAGI_OK) {
     return status;
   }
 
@@ -139,69 +217,794 @@ static int tcp_send_segment(TCPSocket* sock, uint8_t flags, uint32_t ack_num,
   if (payload_len > 0U) {
     seq_advance += (uint32_t)payload_len;
   }
-  sock->seq_num += seq_advance;
-
-  status = sock->node->send_ip_packet(sock->node, sock->local_ip, sock->remote_ip,
-                                      IPV4_PROTOCOL_TCP, IPV4_DEFAULT_TTL, buf, total_len);
-  free(buf);
-  return status;
+  sock->seq_num += seq_advance;
+  if (tcp_seq_gt(sock->seq_num, sock->snd_max)) {
+    sock->snd_max = sock->seq_num;
+  }
+
+  return tcp_transmit(sock, pkt);
+}
+
+/* ─── RST segment sender (static helper for connection refused) ─── */
+
+/**
+ * @brief Send a bare RST segment (connection refused / reset).
+ *
+ * Builds a minimal RST segment with no payload and sends it via the
+ * node's send_ip_packet callback. Used for closed-port rejection and
+ * error handling in the state machine.
+ *
+ * @param node     Node to send from.
+ * @param src_ip   Source IPv4 address (4 bytes).
+ * @param dst_ip   Destination IPv4 address (4 bytes).
+ * @param src_port Source port.
+ * @param dst_port Destination port.
+ * @param seq_num  Sequence number for the RST segment.
+ * @param ack_num  Acknowledgment number for the RST segment.
+ */
+void tcp_send_rst_packet(struct Node* node, const uint8_t src_ip[4], const uint8_t dst_ip[4],
+                         uint16_t src_port, uint16_t dst_port, uint32_t seq_num, uint32_t ack_num) {
+  if (node == NULL || src_ip == NULL || dst_ip == NULL || node->send_ip_packet == NULL) {
+    return;
+  }
+
+  TCPSegment seg;
+  memset(&seg, 0, sizeof(seg));
+  seg.src_port = src_port;
+  seg.dst_port = dst_port;
+  seg.seq_num = seq_num;
+  seg.ack_num = ack_num;
+  seg.data_offset = TCP_DATA_OFFSET_DEFAULT;
+  seg.flags = TCP_FLAG_RST;
+  seg.window_size = 0U;
+
+  uint8_t buf[TCP_HEADER_LEN];
+  if (tcp_pack(&seg, src_ip, dst_ip, buf, sizeof(buf)) != MAGI_OK) {
+    return;
+  }
+
+  (void)node->send_ip_packet(node, src_ip, dst_ip, IPV4_PROTOCOL_TCP, IPV4_DEFAULT_TTL, buf,
+                             sizeof(buf));
+}
+
+/* ─── Send bare ACK helper ─── */
+
+/**
+ * @brief Send a bare ACK segment.
+ *
+ * Convenience wrapper around tcp_send_segment that sends a pure ACK
+ * (no SYN, FIN, or payload) using the socket's current ack_num.
+ *
+ * @param sock  Socket to send from.
+ * @return MAGI_OK on success, or an error code from tcp_send_segment.
+ */
+static int tcp_send_ack(TCPSocket* sock) {
+  return tcp_send_segment(sock, TCP_FLAG_ACK, sock->ack_num, NULL, 0U);
+}
+
+/* ─── Retransmission timer (RFC 6298) ─── */
+
+/**
+ * @brief Check whether the retransmission timer is running.
+ *
+ * @param sock Socket to check.
+ * @return true if a deadline is set.
+ */
+static bool tcp_rto_running(const TCPSocket* sock) {
+  return sock->rto_deadline_ns != 0U;
+}
+
+/**
+ * @brief (Re)start the retransmission timer with the current RTO.
+ *
+ * Sequential builds arm a clock timer; async builds only record the
+ * deadline, which tcp_rto_poll() checks on socket activity.
+ *
+ * @param sock Socket whose timer starts.
+ */
+static void tcp_rto_start(TCPSocket* sock) {
+  sock->rto_deadline_ns = sim_now_ns() + sock->rto_ns;
+#ifndef MAGI_ASYNC
+  (void)sim_timer_arm(&sock->rto_timer, sock->rto_ns);
+#endif
+}
+
+/**
+ * @brief Stop the retransmission timer.
+ *
+ * @param sock Socket whose timer stops.
+ */
+static void tcp_rto_stop(TCPSocket* sock) {
+  sock->rto_deadline_ns = 0U;
+  sim_timer_cancel(&sock->rto_timer);
+}
+
+/**
+ * @brief Fold one RTT measurement into SRTT/RTTVAR and recompute the RTO.
+ *
+ * RFC 6298 §2.2–2.4 with alpha = 1/8 and beta = 1/4. The virtual clock
+ * ticks in nanoseconds, so the clock-granularity term G is negligible;
+ * TCP_RTO_MIN_MS provides the floor.
+ *
+ * @param sock   Socket that took the sample.
+ * @param rtt_ns Measured round-trip time.
+ */
+static void tcp_rtt_sample(TCPSocket* sock, uint64_t rtt_ns) {
+  if (!sock->rtt_valid) {
+    sock->srtt_ns = rtt_ns;
+    sock->rttvar_ns = rtt_ns / 2U;
+    sock->rtt_valid = true;
+  } else {
+    uint64_t delta = sock->srtt_ns > rtt_ns ? sock->srtt_ns - rtt_ns : rtt_ns - sock->srtt_ns;
+    sock->rttvar_ns = (3U * sock->rttvar_ns + delta) / 4U;
+    sock->srtt_ns = (7U * sock->srtt_ns + rtt_ns) / 8U;
+  }
+
+  uint64_t rto = sock->srtt_ns + 4U * sock->rttvar_ns;
+  if (rto < TCP_RTO_MIN_MS * SIM_NS_PER_MS) {
+    rto = TCP_RTO_MIN_MS * SIM_NS_PER_MS;
+  }
+  if (rto > TCP_RTO_MAX_MS * SIM_NS_PER_MS) {
+    rto = TCP_RTO_MAX_MS * SIM_NS_PER_MS;
+  }
+  sock->rto_ns = rto;
+}
+
+/* ─── Send buffer and retransmission queue ─── */
+
+/**
+ * @brief Append application data to the send buffer.
+ *
+ * The buffer holds everything from snd_una onward. Acknowledged bytes are
+ * dropped by moving send_buf_off, so space is reclaimed by compacting
+ * before growing.
+ *
+ * @param sock Socket to queue on.
+ * @param data Bytes to copy.
+ * @param len  Number of bytes.
+ * @return MAGI_OK, MAGI_ERR_QUEUE_FULL past TCP_SEND_BUF_MAX, or MAGI_ERR_NOMEM.
+ */
+static int tcp_send_buf_append(TCPSocket* sock, const uint8_t* data, size_t len) {
+  if (len > TCP_SEND_BUF_MAX - sock->send_buf_len) {
+    return MAGI_ERR_QUEUE_FULL;
+  }
+
+  size_t needed = sock->send_buf_len + len;
+  if (sock->send_buf_off + needed > sock->send_buf_cap) {
+    if (sock->send_buf_off > 0U && sock->send_buf_len > 0U) {
+      memmove(sock->send_buf, sock->send_buf + sock->send_buf_off, sock->send_buf_len);
+    }
+    sock->send_buf_off = 0U;
+  }
+  if (needed > sock->send_buf_cap) {
+    size_t capacity = sock->send_buf_cap;
+    while (capacity < needed) {
+      capacity *= 2U;
+    }
+    if (capacity > TCP_SEND_BUF_MAX) {
+      capacity = TCP_SEND_BUF_MAX;
+    }
+    uint8_t* grown = realloc(sock->send_buf, capacity);
+    if (grown == NULL) {
+      return MAGI_ERR_NOMEM;
+    }
+    sock->send_buf = grown;
+    sock->send_buf_cap = capacity;
+  }
+
+  memcpy(sock->send_buf + sock->send_buf_off + sock->send_buf_len, data, len);
+  sock->send_buf_len += len;
+  return MAGI_OK;
+}
+
+/**
+ * @brief Record a transmitted segment at the tail of the retransmission queue.
+ *
+ * @param sock          Sending socket.
+ * @param seq           First sequence number of the segment.
+ * @param len           Sequence space it covers.
+ * @param retransmitted Whether this range was sent before.
+ * @return MAGI_OK or MAGI_ERR_NOMEM.
+ */
+static int tcp_tx_push(TCPSocket* sock, uint32_t seq, uint32_t len, bool retransmitted) {
+  if (sock->tx_count == sock->tx_cap) {
+    size_t capacity = sock->tx_cap * 2U;
+    TCPTxSegment* ring = malloc(capacity * sizeof(*ring));
+    if (ring == NULL) {
+      return MAGI_ERR_NOMEM;
+    }
+    for (size_t index = 0U; index < sock->tx_count; ++index) {
+      ring[index] = sock->tx_segs[(sock->tx_head + index) % sock->tx_cap];
+    }
+    free(sock->tx_segs);
+    sock->tx_segs = ring;
+    sock->tx_cap = capacity;
+    sock->tx_head = 0U;
+  }
+
+  TCPTxSegment* entry = &sock->tx_segs[(sock->tx_head + sock->tx_count) % sock->tx_cap];
+  entry->seq = seq;
+  entry->len = len;
+  entry->sent_ns = sim_now_ns();
+  entry->retransmitted = retransmitted;
+  sock->tx_count++;
+  return MAGI_OK;
+}
+
+/**
+ * @brief Mark queued segments overlapping [snd_una, end) as retransmitted.
+ *
+ * @param sock Socket retransmitting.
+ * @param end  Sequence number just past the retransmitted range.
+ */
+static void tcp_tx_mark_retransmitted(TCPSocket* sock, uint32_t end) {
+  for (size_t index = 0U; index < sock->tx_count; ++index) {
+    TCPTxSegment* entry = &sock->tx_segs[(sock->tx_head + index) % sock->tx_cap];
+    if (tcp_seq_geq(entry->seq, end)) {
+      break;
+    }
+    entry->retransmitted = true;
+    entry->sent_ns = sim_now_ns();
+  }
+}
+
+/**
+ * @brief Check whether the socket may put data or FIN on the wire in its state.
+ *
+ * @param state Connection state.
+ * @return true while our side of the connection is open or draining.
+ */
+static bool tcp_state_can_output(TCPState state) {
+  return state == TCP_ESTABLISHED || state == TCP_CLOSE_WAIT || state == TCP_FIN_WAIT_1 ||
+         state == TCP_CLOSING || state == TCP_LAST_ACK;
+}
+
+/**
+ * @brief Check whether our FIN has been sent and acknowledged.
+ *
+ * @param sock Socket to check.
+ * @return true once every byte and the FIN are acknowledged.
+ */
+static bool tcp_fin_acked(const TCPSocket* sock) {
+  return sock->fin_sent && sock->send_buf_len == 0U && sock->snd_una == sock->snd_max;
+}
+
+/**
+ * @brief Send a data or FIN segment at seq_num and track it for retransmission.
+ *
+ * The segment is queued and the timer started before the packet leaves,
+ * because in sequential mode the ACK can arrive inside tcp_transmit().
+ *
+ * @param sock    Sending socket.
+ * @param flags   TCP flags.
+ * @param payload Bytes from the send buffer (may be NULL if len is 0).
+ * @param len     Payload length.
+ * @return MAGI_OK, or an error if the segment could not be built. A
+ *         transmit failure counts as a loss and is left to the timer.
+ */
+static int tcp_send_tracked(TCPSocket* sock, uint8_t flags, const uint8_t* payload, size_t len) {
+  uint32_t seq = sock->seq_num;
+  uint32_t span = (uint32_t)len + ((flags & TCP_FLAG_FIN) ? 1U : 0U);
+  bool again = tcp_seq_lt(seq, sock->snd_max);
+
+  PktBuf* pkt = NULL;
+  int status = tcp_build_segment(sock, seq, flags, sock->ack_num, payload, len, &pkt);
+  if (status != MAGI_OK) {
+    return status;
+  }
+  status = tcp_tx_push(sock, seq, span, again);
+  if (status != MAGI_OK) {
+    pktbuf_release(pkt);
+    return status;
+  }
+
+  sock->seq_num += span;
+  if (tcp_seq_gt(sock->seq_num, sock->snd_max)) {
+    sock->snd_max = sock->seq_num;
+  }
+  if (flags & TCP_FLAG_FIN) {
+    sock->fin_sent = true;
+  }
+  sock->stats.segments_sent++;
+  if (again) {
+    sock->stats.retransmits++;
+  }
+  if (!tcp_rto_running(sock)) {
+    tcp_rto_start(sock);
+  }
+
+  (void)tcp_transmit(sock, pkt);
+  return MAGI_OK;
+}
+
+/**
+ * @brief Send the next segment the windows allow, if any.
+ *
+ * @param sock  Sending socket.
+ * @param probe Zero-window probe: send one byte even if the window is closed.
+ * @return true if a segment was sent.
+ */
+static bool tcp_output_one(TCPSocket* sock, bool probe) {
+  if (!tcp_state_can_output(sock->state) || sock->node == NULL ||
+      sock->node->send_ip_packet == NULL) {
+    return false;
+  }
+
+  size_t flight = (size_t)(uint32_t)(sock->seq_num - sock->snd_una);
+  if (flight >= sock->send_buf_len) {
+    if (sock->fin_queued && flight == sock->send_buf_len) {
+      return tcp_send_tracked(sock, TCP_FLAG_FIN | TCP_FLAG_ACK, NULL, 0U) == MAGI_OK;
+    }
+    return false;
+  }
+
+  size_t unsent = sock->send_buf_len - flight;
+  size_t window = sock->cwnd < sock->snd_wnd ? sock->cwnd : sock->snd_wnd;
+  size_t usable = window > flight ? window - flight : 0U;
+  if (probe && usable == 0U) {
+    usable = 1U;
+  }
+  size_t len = unsent < sock->mss ? unsent : sock->mss;
+  if (len > usable) {
+    len = usable;
+  }
+  /* Sender-side silly window avoidance: hold back a runt while ACKs are still due. */
+  if (len == 0U || (len < sock->mss && len < unsent && flight > 0U && !probe)) {
+    return false;
+  }
+
+  uint8_t flags = TCP_FLAG_ACK;
+  if (len == unsent) {
+    flags |= TCP_FLAG_PSH;
+  }
+  return tcp_send_tracked(sock, flags, sock->send_buf + sock->send_buf_off + flight, len) ==
+         MAGI_OK;
+}
+
+/**
+ * @brief Send as much queued data as the congestion and receive windows allow.
+ *
+ * In sequential mode ACKs arrive inside the send call and ask for more
+ * output; those nested calls only set output_pending and the outer loop
+ * picks the work up. If data is stuck behind a zero window with nothing in
+ * flight, the timer is started so it can probe the window.
+ *
+ * @param sock Sending socket.
+ */
+static void tcp_output(TCPSocket* sock) {
+  if (sock->in_output) {
+    sock->output_pending = true;
+    return;
+  }
+
+  sock->in_output = true;
+  do {
+    sock->output_pending = false;
+    while (tcp_output_one(sock, false)) {
+    }
+  } while (sock->output_pending);
+  sock->in_output = false;
+
+  if (sock->send_buf_len > 0U && sock->seq_num == sock->snd_una && !tcp_rto_running(sock) &&
+      tcp_state_can_output(sock->state)) {
+    tcp_rto_start(sock);
+  }
+}
+
+/**
+ * @brief Resend the segment at snd_una without moving seq_num.
+ *
+ * @param sock Socket repairing a loss.
+ */
+static void tcp_retransmit_head(TCPSocket* sock) {
+  uint32_t outstanding = sock->seq_num - sock->snd_una;
+  if (outstanding == 0U || sock->node == NULL || sock->node->send_ip_packet == NULL) {
+    return;
+  }
+
+  size_t len = sock->send_buf_len < sock->mss ? sock->send_buf_len : sock->mss;
+  if (len > outstanding) {
+    len = outstanding;
+  }
+  uint8_t flags = TCP_FLAG_ACK;
+  if (len == 0U) {
+    if (!sock->fin_sent) {
+      return;
+    }
+    flags |= TCP_FLAG_FIN;
+  }
+
+  PktBuf* pkt = NULL;
+  if (tcp_build_segment(sock, sock->snd_una, flags, sock->ack_num,
+                        sock->send_buf + sock->send_buf_off, len, &pkt) != MAGI_OK) {
+    return;
+  }
+  tcp_tx_mark_retransmitted(sock, sock->snd_una + (uint32_t)(len > 0U ? len : 1U));
+  sock->stats.segments_sent++;
+  sock->stats.retransmits++;
+  (void)tcp_transmit(sock, pkt);
+}
+
+/**
+ * @brief Handle a duplicate ACK: count it, fast retransmit on the third.
+ *
+ * Entering recovery halves the window (ssthresh = flight / 2) and inflates
+ * cwnd by the three segments that left the network; every further
+ * duplicate inflates it by one more MSS (RFC 5681 §3.2). Recovery is not
+ * re-entered for losses from the same window (RFC 6582 §3.2 step 1).
+ *
+ * @param sock Socket that received the duplicate.
+ */
+static void tcp_dupack(TCPSocket* sock) {
+  sock->dupacks++;
+  if (sock->in_recovery) {
+    sock->cwnd += sock->mss;
+    tcp_output(sock);
+    return;
+  }
+  if (sock->dupacks != TCP_DUPACK_THRESHOLD || tcp_seq_lt(sock->snd_una, sock->recover)) {
+    return;
+  }
+
+  uint32_t flight = sock->snd_max - sock->snd_una;
+  sock->ssthresh = flight / 2U > 2U * sock->mss ? flight / 2U : 2U * sock->mss;
+  sock->recover = sock->snd_max;
+  sock->in_recovery = true;
+  sock->cwnd = sock->ssthresh + TCP_DUPACK_THRESHOLD * sock->mss;
+  sock->stats.fast_retransmits++;
+  LOG(sock->node->name, "TCP %u: fast retransmit seq=%u (cwnd=%u ssthresh=%u)",
+      (unsigned)sock->local_port, (unsigned)sock->snd_una, (unsigned)sock->cwnd,
+      (unsigned)sock->ssthresh);
+  tcp_retransmit_head(sock);
+  tcp_output(sock);
+}
+
+/**
+ * @brief Handle an ACK that advances snd_una.
+ *
+ * Drops the acknowledged bytes and segments, takes an RTT sample from the
+ * newest acknowledged segment that was sent only once, then grows cwnd
+ * (slow start below ssthresh, one MSS per window above) or, in recovery,
+ * applies NewReno's partial/full ACK rules.
+ *
+ * @param sock Socket that received the ACK.
+ * @param ack  Acknowledgment number, after snd_una and at most snd_max.
+ */
+static void tcp_new_ack(TCPSocket* sock, uint32_t ack) {
+  uint32_t acked = ack - sock->snd_una;
+  size_t data = acked < sock->send_buf_len ? acked : sock->send_buf_len;
+  sock->send_buf_off += data;
+  sock->send_buf_len -= data;
+  if (sock->send_buf_len == 0U) {
+    sock->send_buf_off = 0U;
+  }
+  sock->snd_una = ack;
+  if (tcp_seq_lt(sock->seq_num, ack)) {
+    sock->seq_num = ack;
+  }
+  sock->rto_backoffs = 0U;
+
+  uint64_t now = sim_now_ns();
+  bool sampled = false;
+  uint64_t rtt_ns = 0U;
+  while (sock->tx_count > 0U) {
+    TCPTxSegment* head = &sock->tx_segs[sock->tx_head];
+    if (tcp_seq_gt(head->seq + head->len, ack)) {
+      if (tcp_seq_lt(head->seq, ack)) {
+        head->len -= ack - head->seq;
+        head->seq = ack;
+      }
+      break;
+    }
+    if (!head->retransmitted) {
+      rtt_ns = now - head->sent_ns;
+      sampled = true;
+    }
+    sock->tx_head = (sock->tx_head + 1U) % sock->tx_cap;
+    sock->tx_count--;
+  }
+  if (sampled) {
+    tcp_rtt_sample(sock, rtt_ns);
+  }
+
+  uint32_t flight = sock->snd_max - sock->snd_una;
+  bool partial = false;
+  if (sock->in_recovery) {
+    if (tcp_seq_geq(ack, sock->recover)) {
+      uint32_t deflated = (flight > sock->mss ? flight : sock->mss) + sock->mss;
+      sock->cwnd = deflated < sock->ssthresh ? deflated : sock->ssthresh;
+      sock->in_recovery = false;
+      sock->dupacks = 0U;
+    } else {
+      /* Partial ACK: the next hole is at snd_una; deflate by what left the network. */
+      partial = true;
+      sock->cwnd = sock->cwnd > acked ? sock->cwnd - acked : 0U;
+      if (acked >= sock->mss) {
+        sock->cwnd += sock->mss;
+      }
+    }
+  } else {
+    sock->dupacks = 0U;
+    if (sock->cwnd < sock->ssthresh) {
+      sock->cwnd += acked < sock->mss ? acked : sock->mss;
+    } else {
+      sock->cwnd_acked += acked;
+      if (sock->cwnd_acked >= sock->cwnd) {
+        sock->cwnd_acked -= sock->cwnd;
+        sock->cwnd += sock->mss;
+      }
+    }
+    if (sock->cwnd > TCP_SEND_BUF_MAX) {
+      sock->cwnd = TCP_SEND_BUF_MAX;
+    }
+  }
+
+  if (sock->snd_una == sock->snd_max) {
+    tcp_rto_stop(sock);
+  } else {
+    tcp_rto_start(sock);
+  }
+  if (partial) {
+    tcp_retransmit_head(sock);
+  }
+  tcp_output(sock);
+}
+
+/**
+ * @brief Process the acknowledgment and window fields of an incoming segment.
+ *
+ * A duplicate ACK (RFC 5681 §2) carries no data, SYN or FIN, repeats
+ * snd_una and the last window, and arrives while data is outstanding.
+ *
+ * @param sock Receiving socket.
+ * @param seg  Segment with the ACK flag set.
+ */
+static void tcp_ack_received(TCPSocket* sock, const TCPSegment* seg) {
+  uint32_t ack = seg->ack_num;
+  if (tcp_seq_lt(ack, sock->snd_una) || tcp_seq_gt(ack, sock->snd_max)) {
+    return;
+  }
+
+  uint32_t prev_wnd = sock->snd_wnd;
+  sock->snd_wnd = seg->window_size;
+  if (ack != sock->snd_una) {
+    tcp_new_ack(sock, ack);
+    return;
+  }
+
+  bool duplicate = seg->payload_len == 0U && !(seg->flags & (TCP_FLAG_SYN | TCP_FLAG_FIN)) &&
+                   seg->window_size == prev_wnd && seg->window_size != 0U &&
+                   sock->snd_max != sock->snd_una;
+  if (duplicate) {
+    tcp_dupack(sock);
+  } else if (sock->snd_wnd > prev_wnd) {
+    tcp_output(sock);
+  }
+}
+
+/**
+ * @brief Resend the SYN or SYN+ACK of a handshake that got no answer.
+ *
+ * The RTO doubles as for data (RFC 6298 §5.5); after TCP_SYN_RETRIES
+ * resends the open fails and the socket closes.
+ *
+ * @param sock Socket in SYN_SENT or SYN_RCVD.
+ */
+static void tcp_handshake_retransmit(TCPSocket* sock) {
+  if (++sock->rto_backoffs > TCP_SYN_RETRIES) {
+    LOG(sock->node->name, "TCP %u: no answer to %s, giving up", (unsigned)sock->local_port,
+        sock->state == TCP_SYN_SENT ? "SYN" : "SYN+ACK");
+    TCPState old = sock->state;
+    sock->state = TCP_CLOSED;
+    log_transition(sock, old, TCP_CLOSED, 0U, sock->snd_una, sock->ack_num);
+    return;
+  }
+
+  sock->rto_ns *= 2U;
+  if (sock->rto_ns > TCP_RTO_MAX_MS * SIM_NS_PER_MS) {
+    sock->rto_ns = TCP_RTO_MAX_MS * SIM_NS_PER_MS;
+  }
+  sock->seq_num = sock->snd_una;
+  sock->stats.timeouts++;
+  sock->stats.retransmits++;
+  bool active = sock->state == TCP_SYN_SENT;
+  tcp_rto_start(sock);
+  (void)tcp_send_segment(sock, active ? TCP_FLAG_SYN : TCP_FLAG_SYN | TCP_FLAG_ACK,
+                         active ? 0U : sock->ack_num, NULL, 0U);
+}
+
+/**
+ * @brief Retransmission timer expiry.
+ *
+ * With data outstanding this is a loss: ssthresh drops to half the flight,
+ * cwnd to one segment, and sending restarts from snd_una (go-back-N; the
+ * receiver's out-of-order buffer absorbs what already arrived). With a
+ * closed peer window it is a persist timeout and sends a one-byte probe.
+ * Either way the RTO doubles (RFC 6298 §5.5). After TCP_MAX_RETRIES
+ * consecutive expiries the connection is reset.
+ *
+ * @param sock Socket whose timer expired.
+ */
+static void tcp_rto_expired(TCPSocket* sock) {
+  sock->rto_deadline_ns = 0U;
+  if (sock->state == TCP_SYN_SENT || sock->state == TCP_SYN_RCVD) {
+    tcp_handshake_retransmit(sock);
+    return;
+  }
+  if (!tcp_state_can_output(sock->state) ||
+      (sock->snd_max == sock->snd_una && sock->send_buf_len == 0U && !sock->fin_queued)) {
+    return;
+  }
+
+  sock->rto_ns *= 2U;
+  if (sock->rto_ns > TCP_RTO_MAX_MS * SIM_NS_PER_MS) {
+    sock->rto_ns = TCP_RTO_MAX_MS * SIM_NS_PER_MS;
+  }
+  sock->seq_num = sock->snd_una;
+  sock->tx_count = 0U;
+
+  if (sock->snd_wnd == 0U) {
+    (void)tcp_output_one(sock, true);
+    if (!tcp_rto_running(sock)) {
+      tcp_rto_start(sock);
+    }
+    return;
+  }
+
+  if (++sock->rto_backoffs > TCP_MAX_RETRIES) {
+    LOG(sock->node->name, "TCP %u: retransmission limit reached, aborting",
+        (unsigned)sock->local_port);
+    tcp_send_rst_packet(sock->node, sock->local_ip, sock->remote_ip, sock->local_port,
+                        sock->remote_port, sock->snd_max, sock->ack_num);
+    TCPState old = sock->state;
+    sock->state = TCP_CLOSED;
+    log_transition(sock, old, TCP_CLOSED, TCP_FLAG_RST, sock->snd_max, sock->ack_num);
+    return;
+  }
+
+  uint32_t flight = sock->snd_max - sock->snd_una;
+  sock->ssthresh = flight / 2U > 2U * sock->mss ? flight / 2U : 2U * sock->mss;
+  sock->cwnd = sock->mss;
+  sock->cwnd_acked = 0U;
+  sock->recover = sock->snd_max;
+  sock->in_recovery = false;
+  sock->dupacks = 0U;
+  sock->stats.timeouts++;
+  LOG(sock->node->name, "TCP %u: retransmission timeout seq=%u (rto=%llu ms)",
+      (unsigned)sock->local_port, (unsigned)sock->snd_una,
+      (unsigned long long)(sock->rto_ns / SIM_NS_PER_MS));
+  tcp_output(sock);
+}
+
+/**
+ * @brief Simulation event: the retransmission timer fired.
+ *
+ * @param ctx The TCPSocket.
+ */
+static void tcp_rto_fire(void* ctx) {
+  tcp_rto_expired(ctx);
+}
+
+#ifdef MAGI_ASYNC
+/**
+ * @brief Run the retransmission timer if its deadline has passed.
+ *
+ * Async builds have no timer events for sockets; the deadline is checked
+ * whenever the socket sends or receives.
+ *
+ * @param sock Socket to check.
+ */
+static void tcp_rto_poll(TCPSocket* sock) {
+  if (tcp_rto_running(sock) && sim_now_ns() >= sock->rto_deadline_ns) {
+    tcp_rto_expired(sock);
+  }
 }
+#endif
 
-/* ─── RST segment sender (static helper for connection refused) ─── */
+/**
+ * @brief Find the node's first interface with an IPv4 address.
+ *
+ * @param node Node to search.
+ * @return Interface, or NULL if none is configured.
+ */
+static Interface* tcp_first_ipv4_interface(struct Node* node) {
+  for (size_t i = 0U; i < node->iface_count; ++i) {
+    Interface* candidate = node->iface_list[i];
+    if (candidate->ip_address[0] != '\0') {
+      return candidate;
+    }
+  }
+  return NULL;
+}
 
 /**
- * @brief Send a bare RST segment (connection refused / reset).
+ * @brief Reset the send side for a new connection.
  *
- * Builds a minimal RST segment with no payload and sends it via the
- * node's send_ip_packet callback. Used for closed-port rejection and
- * error handling in the state machine.
+ * The MSS comes from the egress link MTU (TCP_MSS_DEFAULT when unknown);
+ * the initial window follows RFC 5681 §3.1.
  *
- * @param node     Node to send from.
- * @param src_ip   Source IPv4 address (4 bytes).
- * @param dst_ip   Destination IPv4 address (4 bytes).
- * @param src_port Source port.
- * @param dst_port Destination port.
- * @param seq_num  Sequence number for the RST segment.
- * @param ack_num  Acknowledgment number for the RST segment.
+ * @param sock  Socket being opened.
+ * @param iface Egress interface, or NULL.
+ * @param iss   Initial send sequence number.
  */
-void tcp_send_rst_packet(struct Node* node, const uint8_t src_ip[4], const uint8_t dst_ip[4],
-                         uint16_t src_port, uint16_t dst_port, uint32_t seq_num, uint32_t ack_num) {
-  if (node == NULL || src_ip == NULL || dst_ip == NULL || node->send_ip_packet == NULL) {
-    return;
-  }
+static void tcp_open_send_side(TCPSocket* sock, const Interface* iface, uint32_t iss) {
+  uint16_t mtu = interface_mtu(iface);
+  sock->mss = mtu > IPV4_HEADER_LEN + TCP_HEADER_LEN
+                  ? (uint16_t)(mtu - IPV4_HEADER_LEN - TCP_HEADER_LEN)
+                  : (uint16_t)TCP_MSS_DEFAULT;
+  sock->seq_num = iss;
+  sock->snd_una = iss;
+  sock->snd_max = iss;
+  sock->recover = iss;
+  sock->snd_wnd = 0U;
+  sock->send_buf_off = 0U;
+  sock->send_buf_len = 0U;
+  sock->fin_queued = false;
+  sock->fin_sent = false;
+  sock->tx_count = 0U;
+  sock->cwnd = sock->mss > 2190U ? 2U * sock->mss : sock->mss > 1095U ? 3U * sock->mss
+                                                                       : 4U * sock->mss;
+  sock->ssthresh = UINT32_MAX;
+  sock->cwnd_acked = 0U;
+  sock->dupacks = 0U;
+  sock->in_recovery = false;
+  sock->rtt_valid = false;
+  sock->rto_backoffs = 0U;
+  sock->rto_ns = TCP_RTO_INITIAL_MS * SIM_NS_PER_MS;
+  tcp_rto_stop(sock);
+}
 
-  TCPSegment seg;
-  memset(&seg, 0, sizeof(seg));
-  seg.src_port = src_port;
-  seg.dst_port = dst_port;
-  seg.seq_num = seq_num;
-  seg.ack_num = ack_num;
-  seg.data_offset = TCP_DATA_OFFSET_DEFAULT;
-  seg.flags = TCP_FLAG_RST;
-  seg.window_size = 0U;
+/**
+ * @brief The handshake finished: stop the SYN timer and start data with a fresh RTO.
+ *
+ * @param sock Socket entering ESTABLISHED.
+ */
+static void tcp_open_complete(TCPSocket* sock) {
+  tcp_rto_stop(sock);
+  sock->rto_backoffs = 0U;
+  sock->rto_ns = TCP_RTO_INITIAL_MS * SIM_NS_PER_MS;
+}
 
-  uint8_t buf[TCP_HEADER_LEN];
-  if (tcp_pack(&seg, src_ip, dst_ip, buf, sizeof(buf)) != MAGI_OK) {
-    return;
-  }
+/* ─── Receive ring ─── */
 
-  (void)node->send_ip_packet(node, src_ip, dst_ip, IPV4_PROTOCOL_TCP, IPV4_DEFAULT_TTL, buf,
-                             sizeof(buf));
+/**
+ * @brief Copy bytes into the ring behind the unread in-order data.
+ *
+ * @param sock   Socket whose ring is written.
+ * @param offset Distance from ack_num (0 = the next in-order byte).
+ * @param data   Bytes to store.
+ * @param len    Number of bytes; offset + len must fit the free space.
+ */
+static void tcp_ring_write(TCPSocket* sock, size_t offset, const uint8_t* data, size_t len) {
+  size_t pos = (sock->recv_buf_head + sock->recv_buf_len + offset) % sock->recv_buf_cap;
+  size_t first = sock->recv_buf_cap - pos;
+  if (first > len) {
+    first = len;
+  }
+  memcpy(sock->recv_buf + pos, data, first);
+  if (len > first) {
+    memcpy(sock->recv_buf, data + first, len - first);
+  }
 }
 
-/* ─── Send bare ACK helper ─── */
-
 /**
- * @brief Send a bare ACK segment.
+ * @brief Move ack_num past out-of-order ranges it now reaches.
  *
- * Convenience wrapper around tcp_send_segment that sends a pure ACK
- * (no SYN, FIN, or payload) using the socket's current ack_num.
+ * The bytes are already in place in the ring, so this only extends
+ * recv_buf_len.
  *
- * @param sock  Socket to send from.
- * @return MAGI_OK on success, or an error code from tcp_send_segment.
+ * @param sock Socket whose in-order edge advanced.
  */
-static int tcp_send_ack(TCPSocket* sock) {
-  return tcp_send_segment(sock, TCP_FLAG_ACK, sock->ack_num, NULL, 0U);
+static void tcp_ooo_absorb(TCPSocket* sock) {
+  TCPOooRange first;
+  while (tcp_ooo_first(&sock->ooo, &first) && tcp_seq_leq(first.start, sock->ack_num)) {
+    if (tcp_seq_gt(first.end, sock->ack_num)) {
+      uint32_t fresh = first.end - sock->ack_num;
+      sock->recv_buf_len += fresh;
+      sock->ack_num += fresh;
+    }
+    tcp_ooo_pop_first(&sock->ooo);
+  }
 }
 
 /* ─── Receive buffer: insert a segment ─── */
@@ -210,68 +1013,69 @@ static int tcp_send_ack(TCPSocket* sock) {
  * @brief Insert a received TCP segment into the receive buffer.
  *
  * Handles three cases:
- *   - Duplicate/old segment (seq < ack_num): resend ACK, drop.
- *   - In-order data (seq == ack_num): append to recv_buf, advance
- *     ack_num, then flush any contiguous out-of-order segments.
- *   - Out-of-order data (seq > ack_num): store in the out_of_order
- *     linked list, sorted by sequence number. Does NOT send ACK.
+ *   - Duplicate/old segment (ends at or before ack_num): resend ACK, drop.
+ *     A segment that straddles ack_num is trimmed to its new bytes.
+ *   - In-order data (seq == ack_num): write to the ring, advance ack_num,
+ *     then absorb any out-of-order ranges that are now contiguous.
+ *   - Out-of-order data (seq > ack_num): write to the ring at its final
+ *     offset, record the range in the tree, and send an immediate
+ *     duplicate ACK (with SACK blocks) so the sender can fast retransmit
+ *     (RFC 5681 §4.2).
  *
- * After in-order insertion, sends an ACK for the updated ack_num.
+ * Data beyond the free ring space is cut off rather than dropped whole:
+ * the part that fits is kept and the ACK advertises the remaining window.
+ * A FIN counts only if the segment was not cut.
  *
  * @param sock  Socket receiving the data.
  * @param seg   Parsed incoming TCP segment.
- * @return MAGI_OK on success, MAGI_ERR_NOMEM on allocation failure.
+ * @return MAGI_OK on success, MAGI_ERR_NOMEM if the range tree could not grow.
  */
 static int tcp_recv_buf_insert_internal(TCPSocket* sock, TCPSegment* seg) {
   if (sock == NULL || seg == NULL) {
     return MAGI_ERR_BADARGS;
   }
 
+  const uint8_t* payload = seg->payload;
+  size_t payload_len = seg->payload_len;
+  uint32_t seq = seg->seq_num;
+  bool fin = (seg->flags & TCP_FLAG_FIN) != 0U;
+
   /* Duplicate / old segment */
-  if (seg->seq_num < sock->ack_num) {
-    /* Resend ACK for expected seq */
-    (void)tcp_send_ack(sock);
-    return MAGI_OK;
+  if (tcp_seq_lt(seq, sock->ack_num)) {
+    uint32_t stale = sock->ack_num - seq;
+    if (payload_len <= stale) {
+      /* Resend ACK for expected seq */
+      (void)tcp_send_ack(sock);
+      return MAGI_OK;
+    }
+    payload += stale;
+    payload_len -= stale;
+    seq = sock->ack_num;
   }
 
-  /* In-order data */
-  if (seg->seq_num == sock->ack_num) {
-    /* Append to recv buffer */
-    size_t needed = sock->recv_buf_len + seg->payload_len;
-    if (needed > sock->recv_buf_cap) {
-      /* Buffer full — drop (simplified) */
+  /* Cut the segment to the window */
+  size_t window = sock->recv_buf_cap - sock->recv_buf_len;
+  size_t offset = seq - sock->ack_num;
+  if (offset >= window) {
+    if (payload_len > 0U || offset > 0U) {
+      (void)tcp_send_ack(sock);
       return MAGI_OK;
     }
+  } else if (payload_len > window - offset) {
+    payload_len = window - offset;
+    fin = false;
+  }
 
-    if (seg->payload_len > 0U && seg->payload != NULL) {
-      memcpy(sock->recv_buf + sock->recv_buf_len, seg->payload, seg->payload_len);
-      sock->recv_buf_len += seg->payload_len;
-    }
-
-    /* Advance ack_num */
-    uint32_t advance = (uint32_t)seg->payload_len;
-    if (seg->flags & TCP_FLAG_FIN) {
-      advance += 1U;
-    }
-    sock->ack_num += advance;
-
-    /* Flush contiguous out-of-order segments */
-    OOOSegment** pp = &sock->out_of_order;
-    while (*pp != NULL) {
-      OOOSegment* ooo = *pp;
-      if (ooo->seq_num == sock->ack_num) {
-        size_t need2 = sock->recv_buf_len + ooo->len;
-        if (need2 <= sock->recv_buf_cap) {
-          memcpy(sock->recv_buf + sock->recv_buf_len, ooo->data, ooo->len);
-          sock->recv_buf_len += ooo->len;
-        }
-        sock->ack_num += (uint32_t)ooo->len;
-        *pp = ooo->next;
-        free(ooo->data);
-        free(ooo);
-      } else {
-        pp = &(*pp)->next;
-      }
+  /* In-order data */
+  if (offset == 0U) {
+    if (payload_len > 0U && payload != NULL) {
+      tcp_ring_write(sock, 0U, payload, payload_len);
+      sock->recv_buf_len += payload_len;
+      sock->ack_num += (uint32_t)payload_len;
+    }
+    tcp_ooo_absorb(sock);
+    if (fin) {
+      sock->ack_num += 1U;
     }
 
     /* Send ACK for the updated ack_num */
@@ -279,37 +1083,18 @@ static int tcp_recv_buf_insert_internal(TCPSocket* sock, TCPSegment* seg) {
     return MAGI_OK;
   }
 
-  /* Out-of-order data (seq_num > ack_num) — store for later */
-  if (seg->seq_num > sock->ack_num && seg->payload_len > 0U) {
-    OOOSegment* ooo = malloc(sizeof(*ooo));
-    if (ooo == NULL) {
-      return MAGI_ERR_NOMEM;
-    }
-
-    ooo->seq_num = seg->seq_num;
-    ooo->len = seg->payload_len;
-    ooo->data = malloc(seg->payload_len);
-    if (ooo->data == NULL && seg->payload_len > 0U) {
-      free(ooo);
-      return MAGI_ERR_NOMEM;
-    }
-    if (seg->payload_len > 0U) {
-      memcpy(ooo->data, seg->payload, seg->payload_len);
-    }
-    ooo->next = NULL;
-
-    /* Insert in sequence order */
-    OOOSegment** pp = &sock->out_of_order;
-    while (*pp != NULL && (*pp)->seq_num < ooo->seq_num) {
-      pp = &(*pp)->next;
+  /* Out-of-order data (seq_num > ack_num) — store in place for later */
+  if (payload_len > 0U && payload != NULL) {
+    int status = tcp_ooo_insert(&sock->ooo, seq, seq + (uint32_t)payload_len, NULL);
+    if (status != MAGI_OK) {
+      return status;
     }
-    ooo->next = *pp;
-    *pp = ooo;
+    tcp_ring_write(sock, offset, payload, payload_len);
+    sock->ooo_last_seq = seq;
 
-    /* Do NOT send ACK for out-of-order per spec */
-    return MAGI_OK;
+    /* Duplicate ACK: tells the sender a segment is missing */
+    (void)tcp_send_ack(sock);
   }
-
   return MAGI_OK;
 }
 
@@ -318,8 +1103,11 @@ static int tcp_recv_buf_insert_internal(TCPSocket* sock, TCPSegment* seg) {
 /**
  * @brief Read contiguous data from the socket's receive buffer.
  *
- * Copies up to len bytes from recv_buf into out, then shifts
- * remaining data to the front. Updates recv_buf_len accordingly.
+ * Copies up to len bytes out of the ring, in at most two pieces when the
+ * data wraps, and advances recv_buf_head; nothing is shifted. If the read
+ * opens the window by at least min(2 MSS, half the buffer) over what was
+ * last advertised, a window update is sent so a sender stalled on a small
+ * window resumes (RFC 1122 §4.2.3.3).
  *
  * @param sock  Socket with received data.
  * @param out   Output buffer for the copied bytes.
@@ -336,15 +1124,68 @@ size_t tcp_recv_buf_read(TCPSocket* sock, uint8_t* out, size_t len) {
     return 0U;
   }
 
-  memcpy(out, sock->recv_buf, to_copy);
-  size_t remaining = sock->recv_buf_len - to_copy;
-  if (remaining > 0U) {
-    memmove(sock->recv_buf, sock->recv_buf + to_copy, remaining);
+  size_t first = sock->recv_buf_cap - sock->recv_buf_head;
+  if (first > to_copy) {
+    first = to_copy;
+  }
+  memcpy(out, sock->recv_buf + sock->recv_buf_head, first);
+  if (to_copy > first) {
+    memcpy(out + first, sock->recv_buf, to_copy - first);
+  }
+  sock->recv_buf_head = (sock->recv_buf_head + to_copy) % sock->recv_buf_cap;
+  sock->recv_buf_len -= to_copy;
+
+  if (sock->state == TCP_ESTABLISHED || sock->state == TCP_FIN_WAIT_1 ||
+      sock->state == TCP_FIN_WAIT_2) {
+    size_t threshold = 2U * (size_t)sock->mss;
+    if (threshold > sock->recv_buf_cap / 2U) {
+      threshold = sock->recv_buf_cap / 2U;
+    }
+    if ((size_t)tcp_rcv_window(sock) >= (size_t)sock->rcv_wnd_adv + threshold) {
+      (void)tcp_send_ack(sock);
+    }
   }
-  sock->recv_buf_len = remaining;
   return to_copy;
 }
 
+/**
+ * @brief List SACK blocks for the ranges held out of order.
+ *
+ * The range holding the latest arrival goes first so the sender learns
+ * about it even if the ACK carrying older blocks is lost; the others
+ * follow in ascending order.
+ *
+ * @param sock TCP socket.
+ * @param out  Destination array.
+ * @param max  Capacity of out.
+ * @return Number of blocks written.
+ */
+size_t tcp_socket_sack_blocks(const TCPSocket* sock, TCPSackBlock* out, size_t max) {
+  if (sock == NULL || out == NULL || max == 0U || sock->ooo.count == 0U) {
+    return 0U;
+  }
+
+  TCPOooRange recent = {0U, 0U};
+  size_t n = 0U;
+  if (tcp_ooo_find(&sock->ooo, sock->ooo_last_seq, &recent)) {
+    out[n].start = recent.start;
+    out[n].end = recent.end;
+    n++;
+  }
+
+  TCPOooRange ranges[TCP_SACK_MAX_BLOCKS + 1U];
+  size_t count = tcp_ooo_ranges(&sock->ooo, ranges, TCP_SACK_MAX_BLOCKS + 1U);
+  for (size_t i = 0U; i < count && n < max; ++i) {
+    if (ranges[i].start == recent.start && ranges[i].end == recent.end) {
+      continue;
+    }
+    out[n].start = ranges[i].start;
+    out[n].end = ranges[i].end;
+    n++;
+  }
+  return n;
+}
+
 /**
  * @brief Check whether the socket has received data available.
  *
@@ -360,8 +1201,11 @@ bool tcp_socket_has_data(const TCPSocket* sock) {
 /**
  * @brief Allocate and initialise a TCP socket.
  *
- * Allocates a TCPSocket in CLOSED state with a 16 KB receive buffer.
- * The out_of_order list is initialised to NULL.
+ * Allocates a TCPSocket in CLOSED state with a 16 KB receive ring. The
+ * out-of-order range tree starts empty and allocates its node pool on the
+ * first out-of-order arrival. The send buffer (16 KB)
+ * and retransmission queue are allocated up front as well, so a
+ * connection that stays within them never allocates per segment.
  *
  * @param node  Owning node (used for sending responses).
  * @return New TCPSocket pointer, or NULL on allocation failure.
@@ -385,8 +1229,27 @@ TCPSocket* tcp_socket_new(struct Node* node) {
     return NULL;
   }
 
+  /* 16 KB send buffer, grown on demand up to TCP_SEND_BUF_MAX */
+  sock->send_buf_cap = 16384U;
+  sock->send_buf = malloc(sock->send_buf_cap);
+  sock->tx_cap = 16U;
+  sock->tx_segs = malloc(sock->tx_cap * sizeof(*sock->tx_segs));
+  if (sock->send_buf == NULL || sock->tx_segs == NULL) {
+    free(sock->send_buf);
+    free(sock->tx_segs);
+    free(sock->recv_buf);
+    free(sock);
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+
+  sock->recv_buf_head = 0U;
   sock->recv_buf_len = 0U;
-  sock->out_of_order = NULL;
+  sock->rcv_wnd_adv = tcp_rcv_window(sock);
+  tcp_ooo_init(&sock->ooo);
+
+  sim_timer_init(&sock->rto_timer, tcp_rto_fire, sock);
+  tcp_open_send_side(sock, NULL, 0U);
 
   return sock;
 }
@@ -394,8 +1257,11 @@ TCPSocket* tcp_socket_new(struct Node* node) {
 /**
  * @brief Destroy a TCP socket and free all resources.
  *
- * Frees the receive buffer, the out-of-order segment linked list
- * (including each segment's data), and the socket struct itself.
+ * Stops the retransmission timer, frees the send buffer and
+ * retransmission queue, the receive ring, the out-of-order range tree,
+ * and the socket struct itself. A child still queued leaves its listener;
+ * a listener's unaccepted children are only detached, since the L4 layer
+ * that holds them in its connection table frees them.
  * Does NOT free the owning node. NULL-safe.
  *
  * @param sock  Socket to free. May be NULL.
@@ -405,16 +1271,18 @@ void tcp_socket_free(TCPSocket* sock) {
     return;
   }
 
-  free(sock->recv_buf);
-
-  OOOSegment* ooo = sock->out_of_order;
-  while (ooo != NULL) {
-    OOOSegment* next = ooo->next;
-    free(ooo->data);
-    free(ooo);
-    ooo = next;
+  tcp_socket_unlink_child(sock);
+  while (sock->listen.syn.head != NULL) {
+    tcp_socket_unlink_child(sock->listen.syn.head);
   }
-
+  while (sock->listen.ready.head != NULL) {
+    tcp_socket_unlink_child(sock->listen.ready.head);
+  }
+  tcp_rto_stop(sock);
+  free(sock->send_buf);
+  free(sock->tx_segs);
+  free(sock->recv_buf);
+  tcp_ooo_free(&sock->ooo);
   free(sock);
 }
 
@@ -448,8 +1316,8 @@ static bool has_flags(uint8_t flags, uint8_t mask) {
  * @return MAGI_OK on success, MAGI_ERR_CONNRESET on RST or unexpected input,
  *         or an error code from the segment send helper.
  */
-int tcp_socket_handle_segment(TCPSocket* sock, TCPSegment* seg, struct Node* node,
-                              const uint8_t src_ip[4], const uint8_t dst_ip[4]) {
+static int tcp_input(TCPSocket* sock, TCPSegment* seg, struct Node* node, const uint8_t src_ip[4],
+                     const uint8_t dst_ip[4]) {
   if (sock == NULL || seg == NULL || node == NULL) {
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
@@ -468,10 +1336,15 @@ int tcp_socket_handle_segment(TCPSocket* sock, TCPSegment* seg, struct Node* nod
         (unsigned)ack, seg->payload_len);
   }
 
+#ifdef MAGI_ASYNC
+  tcp_rto_poll(sock);
+#endif
+
   /* ── RST handling (universal) ── */
   if (flags & TCP_FLAG_RST) {
     TCPState old = sock->state;
     sock->state = TCP_CLOSED;
+    tcp_rto_stop(sock);
     log_transition(sock, old, TCP_CLOSED, flags, seq, ack);
     LOG(node->name, "TCP connection reset by peer");
     return MAGI_ERR_CONNRESET;
@@ -483,7 +1356,10 @@ int tcp_socket_handle_segment(TCPSocket* sock, TCPSegment* seg, struct Node* nod
   case TCP_CLOSED:
     if (has_flags(flags, TCP_FLAG_SYN) && !(flags & TCP_FLAG_ACK)) {
       /* Passive open: CLOSED + SYN → SYN_RCVD */
-      sock->seq_num = (uint32_t)(rand() & 0xFFFF) | 0x10000000U; /* ISS */
+      tcp_open_send_side(sock, tcp_first_ipv4_interface(node),
+                         (uint32_t)(rand() & 0xFFFF) | 0x10000000U); /* ISS */
+      sock->snd_wnd = seg->window_size;
+      sock->sack_ok = seg->sack_permitted;
       sock->ack_num = seq + 1U;
       memcpy(sock->remote_ip, src_ip, 4U);
       sock->remote_port = seg->src_port;
@@ -491,6 +1367,7 @@ int tcp_socket_handle_segment(TCPSocket* sock, TCPSegment* seg, struct Node* nod
       memcpy(sock->local_ip, dst_ip, 4U);
       sock->state = TCP_SYN_RCVD;
       log_transition(sock, old_state, TCP_SYN_RCVD, flags, seq, ack);
+      tcp_rto_start(sock);
       return tcp_send_segment(sock, TCP_FLAG_SYN | TCP_FLAG_ACK, sock->ack_num, NULL, 0U);
     }
     /* Any other segment on CLOSED → send RST unless it's already an RST */
@@ -509,13 +1386,17 @@ int tcp_socket_handle_segment(TCPSocket* sock, TCPSegment* seg, struct Node* nod
   case TCP_LISTEN:
     if (has_flags(flags, TCP_FLAG_SYN) && !(flags & TCP_FLAG_ACK)) {
       /* Passive open */
-      sock->seq_num = (uint32_t)(rand() & 0xFFFF) | 0x10000000U; /* ISS */
+      tcp_open_send_side(sock, tcp_first_ipv4_interface(node),
+                         (uint32_t)(rand() & 0xFFFF) | 0x10000000U); /* ISS */
+      sock->snd_wnd = seg->window_size;
+      sock->sack_ok = seg->sack_permitted;
       sock->ack_num = seq + 1U;
       memcpy(sock->remote_ip, src_ip, 4U);
       sock->remote_port = seg->src_port;
       memcpy(sock->local_ip, dst_ip, 4U);
       sock->state = TCP_SYN_RCVD;
       log_transition(sock, old_state, TCP_SYN_RCVD, flags, seq, ack);
+      tcp_rto_start(sock);
       return tcp_send_segment(sock, TCP_FLAG_SYN | TCP_FLAG_ACK, sock->ack_num, NULL, 0U);
     }
     /* All others → drop silently */
@@ -535,14 +1416,20 @@ int tcp_socket_handle_segment(TCPSocket* sock, TCPSegment* seg, struct Node* nod
         return MAGI_ERR_CONNRESET;
       }
       /* Advance seq_num (SYN consumed) */
+      sock->snd_una = ack;
+      sock->snd_wnd = seg->window_size;
+      sock->sack_ok = seg->sack_permitted;
       sock->ack_num = seq + 1U;
       sock->state = TCP_ESTABLISHED;
+      tcp_open_complete(sock);
       log_transition(sock, old_state, TCP_ESTABLISHED, flags, seq, ack);
       return tcp_send_ack(sock);
     }
 
     if (has_flags(flags, TCP_FLAG_SYN) && !(flags & TCP_FLAG_ACK)) {
       /* Simultaneous open */
+      sock->snd_wnd = seg->window_size;
+      sock->sack_ok = seg->sack_permitted;
       sock->ack_num = seq + 1U;
       sock->state = TCP_SYN_RCVD;
       log_transition(sock, old_state, TCP_SYN_RCVD, flags, seq, ack);
@@ -569,7 +1456,10 @@ int tcp_socket_handle_segment(TCPSocket* sock, TCPSegment* seg, struct Node* nod
             (unsigned)sock->seq_num);
         return MAGI_ERR_CONNRESET;
       }
+      sock->snd_una = ack;
+      sock->snd_wnd = seg->window_size;
       sock->state = TCP_ESTABLISHED;
+      tcp_open_complete(sock);
       log_transition(sock, old_state, TCP_ESTABLISHED, flags, seq, ack);
       /* If there is payload data, process it */
       if (seg->payload_len > 0U) {
@@ -585,8 +1475,10 @@ int tcp_socket_handle_segment(TCPSocket* sock, TCPSegment* seg, struct Node* nod
       return tcp_send_ack(sock);
     }
 
-    if (has_flags(flags, TCP_FLAG_SYN)) {
-      goto send_rst_and_close;
+    if (has_flags(flags, TCP_FLAG_SYN) && seq + 1U == sock->ack_num) {
+      /* The peer resent its SYN: our SYN+ACK was lost, send it again */
+      sock->seq_num = sock->snd_una;
+      return tcp_send_segment(sock, TCP_FLAG_SYN | TCP_FLAG_ACK, sock->ack_num, NULL, 0U);
     }
 
     goto send_rst_and_close;
@@ -594,9 +1486,13 @@ int tcp_socket_handle_segment(TCPSocket* sock, TCPSegment* seg, struct Node* nod
   /* ═══════════════ ESTABLISHED ═══════════════ */
   case TCP_ESTABLISHED:
     if (flags & TCP_FLAG_ACK) {
-      /* ACK received — update send window */
-      /* (Simplified: no congestion control, just ack validation) */
-      if (seq == sock->ack_num && seg->payload_len == 0U) {
+      /* ACK received — advance snd_una, update the send and congestion windows */
+      tcp_ack_received(sock, seg);
+      if (sock->state != TCP_ESTABLISHED) {
+        /* Our output drew a RST from the peer */
+        return MAGI_OK;
+      }
+      if (seq == sock->ack_num && seg->payload_len == 0U && !(flags & TCP_FLAG_FIN)) {
         /* Pure ACK with no data */
         return MAGI_OK;
       }
@@ -627,26 +1523,27 @@ int tcp_socket_handle_segment(TCPSocket* sock, TCPSegment* seg, struct Node* nod
 
   /* ═══════════════ FIN_WAIT_1 ═══════════════ */
   case TCP_FIN_WAIT_1:
-    if (has_flags(flags, TCP_FLAG_ACK)) {
-      /* ACK of our FIN */
-      sock->state = TCP_FIN_WAIT_2;
-      log_transition(sock, old_state, TCP_FIN_WAIT_2, flags, seq, ack);
-      return MAGI_OK;
+    if (flags & TCP_FLAG_ACK) {
+      /* Queued data may still be in flight ahead of our FIN */
+      tcp_ack_received(sock, seg);
     }
 
     if (has_flags(flags, TCP_FLAG_FIN)) {
-      /* Simultaneous close */
+      /* FIN+ACK covering our FIN, or simultaneous close */
+      TCPState next = tcp_fin_acked(sock) ? TCP_TIME_WAIT : TCP_CLOSING;
       sock->ack_num = seq + 1U;
-      sock->state = TCP_CLOSING;
-      log_transition(sock, old_state, TCP_CLOSING, flags, seq, ack);
+      sock->state = next;
+      log_transition(sock, old_state, next, flags, seq, ack);
       return tcp_send_ack(sock);
     }
 
-    if (has_flags(flags, TCP_FLAG_FIN | TCP_FLAG_ACK)) {
-      sock->ack_num = seq + 1U;
-      sock->state = TCP_TIME_WAIT;
-      log_transition(sock, old_state, TCP_TIME_WAIT, flags, seq, ack);
-      return tcp_send_ack(sock);
+    if (has_flags(flags, TCP_FLAG_ACK)) {
+      if (tcp_fin_acked(sock)) {
+        /* ACK of our FIN */
+        sock->state = TCP_FIN_WAIT_2;
+        log_transition(sock, old_state, TCP_FIN_WAIT_2, flags, seq, ack);
+      }
+      return MAGI_OK;
     }
 
     goto send_rst_and_close;
@@ -665,6 +1562,10 @@ int tcp_socket_handle_segment(TCPSocket* sock, TCPSegment* seg, struct Node* nod
   /* ═══════════════ CLOSING ═══════════════ */
   case TCP_CLOSING:
     if (has_flags(flags, TCP_FLAG_ACK)) {
+      tcp_ack_received(sock, seg);
+      if (!tcp_fin_acked(sock)) {
+        return MAGI_OK;
+      }
       sock->state = TCP_TIME_WAIT;
       log_transition(sock, old_state, TCP_TIME_WAIT, flags, seq, ack);
       return MAGI_OK;
@@ -674,12 +1575,20 @@ int tcp_socket_handle_segment(TCPSocket* sock, TCPSegment* seg, struct Node* nod
   /* ═══════════════ CLOSE_WAIT ═══════════════ */
   case TCP_CLOSE_WAIT:
     /* Application should close, at which point we send FIN */
-    /* For now, any segment triggers RST since we shouldn't be receiving */
+    /* Our side may still be sending: take bare ACKs, anything else triggers RST */
+    if (flags == TCP_FLAG_ACK && seg->payload_len == 0U) {
+      tcp_ack_received(sock, seg);
+      return MAGI_OK;
+    }
     goto send_rst_and_close;
 
   /* ═══════════════ LAST_ACK ═══════════════ */
   case TCP_LAST_ACK:
     if (has_flags(flags, TCP_FLAG_ACK)) {
+      tcp_ack_received(sock, seg);
+      if (!tcp_fin_acked(sock)) {
+        return MAGI_OK;
+      }
       sock->state = TCP_CLOSED;
       log_transition(sock, old_state, TCP_CLOSED, flags, seq, ack);
       return MAGI_OK;
@@ -708,11 +1617,218 @@ send_rst_and_close: {
   tcp_send_rst_packet(node, sock->local_ip, sock->remote_ip, sock->local_port, sock->remote_port,
                       sock->seq_num, sock->ack_num);
   sock->state = TCP_CLOSED;
+  tcp_rto_stop(sock);
   log_transition(sock, old, TCP_CLOSED, flags, seq, ack);
 }
   return MAGI_ERR_CONNRESET;
 }
 
+/* ─── Passive open queues ─── */
+
+/**
+ * @brief Append a child to a listener queue.
+ *
+ * @param queue Queue to extend.
+ * @param child Socket on no queue.
+ */
+static void tcp_queue_push(TCPChildQueue* queue, TCPSocket* child) {
+  child->queue = queue;
+  child->queue_prev = queue->tail;
+  child->queue_next = NULL;
+  if (queue->tail != NULL) {
+    queue->tail->queue_next = child;
+  } else {
+    queue->head = child;
+  }
+  queue->tail = child;
+  if (++queue->count > queue->peak) {
+    queue->peak = queue->count;
+  }
+}
+
+/**
+ * @brief Take a child off the queue holding it.
+ *
+ * @param child Socket on a queue.
+ */
+static void tcp_queue_remove(TCPSocket* child) {
+  TCPChildQueue* queue = child->queue;
+  if (child->queue_prev != NULL) {
+    child->queue_prev->queue_next = child->queue_next;
+  } else {
+    queue->head = child->queue_next;
+  }
+  if (child->queue_next != NULL) {
+    child->queue_next->queue_prev = child->queue_prev;
+  } else {
+    queue->tail = child->queue_prev;
+  }
+  queue->count--;
+  child->queue = NULL;
+  child->queue_prev = NULL;
+  child->queue_next = NULL;
+}
+
+/**
+ * @brief Check whether a child on the SYN queue has finished its handshake.
+ *
+ * @param child Spawned socket.
+ * @return true once it left SYN_RCVD without being reset.
+ */
+static bool tcp_child_ready(const TCPSocket* child) {
+  return child->state != TCP_SYN_RCVD && child->state != TCP_CLOSED;
+}
+
+/**
+ * @brief Move a child whose handshake completed to the accept queue, if there is room.
+ *
+ * A child that finds the accept queue full stays on the SYN queue until
+ * tcp_socket_accept() frees a slot.
+ *
+ * @param child Spawned socket, not yet accepted.
+ */
+static void tcp_child_settle(TCPSocket* child) {
+  TCPListenQueues* listen = &child->listener->listen;
+  if (child->queue == &listen->syn && tcp_child_ready(child) &&
+      listen->ready.count < listen->backlog) {
+    tcp_queue_remove(child);
+    tcp_queue_push(&listen->ready, child);
+  }
+}
+
+/**
+ * @brief Process an incoming segment and keep a spawned child's queue membership current.
+ *
+ * @param sock    Target socket for the incoming segment.
+ * @param seg     Parsed incoming TCP segment.
+ * @param node    Owning node (for sending response segments).
+ * @param src_ip  Source IPv4 address of the received segment.
+ * @param dst_ip  Destination IPv4 address of the received segment.
+ * @return Status from the state machine.
+ */
+int tcp_socket_handle_segment(TCPSocket* sock, TCPSegment* seg, struct Node* node,
+                              const uint8_t src_ip[4], const uint8_t dst_ip[4]) {
+  int status = tcp_input(sock, seg, node, src_ip, dst_ip);
+  if (sock != NULL && sock->listener != NULL) {
+    tcp_child_settle(sock);
+  }
+  return status;
+}
+
+/**
+ * @brief Turn a LISTEN socket into a listener with SYN and accept queues.
+ *
+ * @param sock    Socket to listen on.
+ * @param backlog Requested queue capacity; clamped to 1..TCP_BACKLOG_MAX.
+ * @return MAGI_OK on success, MAGI_ERR_BADARGS if sock is NULL.
+ */
+int tcp_socket_listen(TCPSocket* sock, uint32_t backlog) {
+  if (sock == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  sock->listen.backlog = backlog == 0U ? 1U : backlog > TCP_BACKLOG_MAX ? TCP_BACKLOG_MAX : backlog;
+  if (sock->state != TCP_LISTEN) {
+    log_transition(sock, sock->state, TCP_LISTEN, 0U, 0U, 0U);
+    sock->state = TCP_LISTEN;
+  }
+  return MAGI_OK;
+}
+
+/**
+ * @brief Check whether a socket is a listener with queues.
+ *
+ * @param sock TCP socket.
+ * @return true in LISTEN with a non-zero backlog.
+ */
+bool tcp_socket_is_listener(const TCPSocket* sock) {
+  return sock != NULL && sock->state == TCP_LISTEN && sock->listen.backlog > 0U;
+}
+
+/**
+ * @brief Create a child socket for a SYN and put it on the SYN queue.
+ *
+ * Like common stacks, the SYN is dropped while either queue is full; the
+ * client's SYN retransmission tries again later.
+ *
+ * @param listener Listening socket.
+ * @param seg      The SYN.
+ * @param src_ip   Segment source address.
+ * @param dst_ip   Segment destination address.
+ * @return Child socket in CLOSED, or NULL if the SYN was dropped or memory ran out.
+ */
+TCPSocket* tcp_socket_spawn(TCPSocket* listener, const TCPSegment* seg, const uint8_t src_ip[4],
+                            const uint8_t dst_ip[4]) {
+  if (!tcp_socket_is_listener(listener) || seg == NULL || src_ip == NULL || dst_ip == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return NULL;
+  }
+
+  TCPListenQueues* listen = &listener->listen;
+  if (listen->syn.count >= listen->backlog || listen->ready.count >= listen->backlog) {
+    listen->syn_drops++;
+    LOG(listener->node->name, "TCP %u: backlog full (%u half-open, %u to accept), drop SYN",
+        (unsigned)listener->local_port, (unsigned)listen->syn.count,
+        (unsigned)listen->ready.count);
+    return NULL;
+  }
+
+  TCPSocket* child = tcp_socket_new(listener->node);
+  if (child == NULL) {
+    return NULL;
+  }
+
+  memcpy(child->local_ip, dst_ip, 4U);
+  child->local_port = seg->dst_port;
+  memcpy(child->remote_ip, src_ip, 4U);
+  child->remote_port = seg->src_port;
+  child->listener = listener;
+  tcp_queue_push(&listen->syn, child);
+  return child;
+}
+
+/**
+ * @brief Pop the oldest established child and refill the accept queue from the SYN queue.
+ *
+ * @param listener Listening socket.
+ * @return Child, or NULL if none is waiting.
+ */
+TCPSocket* tcp_socket_accept(TCPSocket* listener) {
+  if (listener == NULL || listener->listen.ready.head == NULL) {
+    return NULL;
+  }
+
+  TCPSocket* child = listener->listen.ready.head;
+  tcp_queue_remove(child);
+  child->listener = NULL;
+
+  /* A slot opened: admit the oldest child that completed while the queue was full */
+  for (TCPSocket* waiting = listener->listen.syn.head; waiting != NULL;
+       waiting = waiting->queue_next) {
+    if (tcp_child_ready(waiting)) {
+      tcp_queue_remove(waiting);
+      tcp_queue_push(&listener->listen.ready, waiting);
+      break;
+    }
+  }
+  return child;
+}
+
+/**
+ * @brief Detach a spawned child from its listener.
+ *
+ * @param child Socket from tcp_socket_spawn().
+ */
+void tcp_socket_unlink_child(TCPSocket* child) {
+  if (child == NULL || child->queue == NULL) {
+    return;
+  }
+
+  tcp_queue_remove(child);
+  child->listener = NULL;
+}
+
 /* ─── High-level API ─── */
 
 /**
@@ -735,19 +1851,7 @@ int tcp_socket_bind_listen(TCPSocket* sock, struct Node* node, uint16_t port) {
   }
 
   /* Set local IP from the node's first interface */
-  Interface* iface = NULL;
-  if (node->interfaces != NULL) {
-    for (size_t i = 0U; i < node->interfaces->capacity; ++i) {
-      HashEntry* entry = &node->interfaces->entries[i];
-      if (entry->key != NULL && !entry->tombstone) {
-        Interface* candidate = (Interface*)entry->value;
-        if (candidate->ip_address[0] != '\0') {
-          iface = candidate;
-          break;
-        }
-      }
-    }
-  }
+  Interface* iface = tcp_first_ipv4_interface(node);
   if (iface == NULL) {
     LOG(node->name, "Cannot bind TCP socket: node has no IPv4 interface");
     magi_errno = MAGI_ERR_BADARGS;
@@ -795,19 +1899,7 @@ int tcp_socket_connect(TCPSocket* sock, struct Node* node, const char* dst_ip, u
   }
 
   /* Set local IP from first interface */
-  Interface* iface = NULL;
-  if (node->interfaces != NULL) {
-    for (size_t i = 0U; i < node->interfaces->capacity; ++i) {
-      HashEntry* entry = &node->interfaces->entries[i];
-      if (entry->key != NULL && !entry->tombstone) {
-        Interface* candidate = (Interface*)entry->value;
-        if (candidate->ip_address[0] != '\0') {
-          iface = candidate;
-          break;
-        }
-      }
-    }
-  }
+  Interface* iface = tcp_first_ipv4_interface(node);
   if (iface == NULL) {
     LOG(node->name, "TCP connect: node has no IPv4 interface");
     magi_errno = MAGI_ERR_BADARGS;
@@ -819,25 +1911,28 @@ int tcp_socket_connect(TCPSocket* sock, struct Node* node, const char* dst_ip, u
     return MAGI_ERR_BADARGS;
   }
 
-  /* Assign ephemeral local port if not already bound */
+  /* The port must come from the node's registry, or replies would not find the socket */
   if (sock->local_port == 0U) {
-    /* Use a simple ephemeral port (49152 + hash of pointer) for now */
-    sock->local_port = (uint16_t)(49152U + ((uintptr_t)sock & 0x3FFFU));
+    LOG(node->name, "TCP connect: socket is not bound to a local port");
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
   }
 
   memcpy(sock->remote_ip, dst_ip_bytes, 4U);
   sock->remote_port = dst_port;
   sock->node = node;
 
-  /* Initial sequence number (ISS) */
-  sock->seq_num = (uint32_t)(rand() & 0xFFFF) | 0x20000000U;
+  /* Initial sequence number (ISS); the MSS follows the interface MTU */
+  tcp_open_send_side(sock, iface, (uint32_t)(rand() & 0xFFFF) | 0x20000000U);
 
-  /* Send SYN */
+  /* Send SYN; the timer resends it until the handshake completes */
   sock->state = TCP_SYN_SENT;
   log_transition(sock, TCP_CLOSED, TCP_SYN_SENT, TCP_FLAG_SYN, sock->seq_num, 0U);
+  tcp_rto_start(sock);
 
   int status = tcp_send_segment(sock, TCP_FLAG_SYN, 0U, NULL, 0U);
   if (status != MAGI_OK) {
+    tcp_rto_stop(sock);
     sock->state = TCP_CLOSED;
     log_transition(sock, TCP_SYN_SENT, TCP_CLOSED, 0U, 0U, 0U);
     return status;
@@ -849,14 +1944,17 @@ int tcp_socket_connect(TCPSocket* sock, struct Node* node, const char* dst_ip, u
 /**
  * @brief Send data on an ESTABLISHED TCP connection.
  *
- * Sends the payload with PSH+ACK flags. The socket must be in
- * ESTABLISHED state; otherwise MAGI_ERR_CONNRESET is returned.
+ * Copies the payload into the send buffer and transmits as many MSS-sized
+ * segments as min(cwnd, peer window) allows; the rest goes out as ACKs
+ * arrive. The socket must be in ESTABLISHED or CLOSE_WAIT state;
+ * otherwise MAGI_ERR_CONNRESET is returned.
  *
  * @param sock  TCP socket (must be ESTABLISHED).
  * @param node  Owning node.
  * @param data  Payload bytes to send.
  * @param len   Number of bytes to send.
- * @return MAGI_OK on success, MAGI_ERR_CONNRESET if not ESTABLISHED,
+ * @return MAGI_OK once buffered, MAGI_ERR_CONNRESET if not ESTABLISHED,
+ *         MAGI_ERR_QUEUE_FULL if the send buffer cannot take len more bytes,
  *         MAGI_ERR_BADARGS on null input.
  */
 int tcp_socket_send(TCPSocket* sock, struct Node* node, const uint8_t* data, size_t len) {
@@ -865,20 +1963,37 @@ int tcp_socket_send(TCPSocket* sock, struct Node* node, const uint8_t* data, siz
     return MAGI_ERR_BADARGS;
   }
 
-  if (sock->state != TCP_ESTABLISHED) {
+  if (sock->state != TCP_ESTABLISHED && sock->state != TCP_CLOSE_WAIT) {
     LOG(node->name, "TCP send: socket not ESTABLISHED (state=%s)", tcp_state_name(sock->state));
     magi_errno = MAGI_ERR_CONNRESET;
     return MAGI_ERR_CONNRESET;
   }
 
-  return tcp_send_segment(sock, TCP_FLAG_PSH | TCP_FLAG_ACK, sock->ack_num, data, len);
+#ifdef MAGI_ASYNC
+  tcp_rto_poll(sock);
+#endif
+  if (len == 0U) {
+    return MAGI_OK;
+  }
+
+  int status = tcp_send_buf_append(sock, data, len);
+  if (status != MAGI_OK) {
+    LOG(node->name, "TCP send: cannot buffer %zu bytes (%zu queued)", len, sock->send_buf_len);
+    magi_errno = status;
+    return status;
+  }
+
+  tcp_output(sock);
+  return MAGI_OK;
 }
 
 /**
  * @brief Initiate a graceful TCP close (send FIN).
  *
- * From ESTABLISHED: sends FIN+ACK, transitions to FIN_WAIT_1.
- * From CLOSE_WAIT: sends FIN+ACK, transitions to LAST_ACK.
+ * From ESTABLISHED: queues FIN+ACK, transitions to FIN_WAIT_1.
+ * From CLOSE_WAIT: queues FIN+ACK, transitions to LAST_ACK.
+ * The FIN leaves once the send buffer has drained and is retransmitted
+ * like data until acknowledged.
  * In all other states the close is rejected with MAGI_ERR_CONNRESET.
  *
  * @param sock  TCP socket to close.
@@ -896,15 +2011,46 @@ int tcp_socket_close(TCPSocket* sock, struct Node* node) {
     sock->state = TCP_FIN_WAIT_1;
     log_transition(sock, TCP_ESTABLISHED, TCP_FIN_WAIT_1, TCP_FLAG_FIN, sock->seq_num,
                    sock->ack_num);
-    return tcp_send_segment(sock, TCP_FLAG_FIN | TCP_FLAG_ACK, sock->ack_num, NULL, 0U);
+    sock->fin_queued = true;
+    tcp_output(sock);
+    return MAGI_OK;
   }
 
   if (sock->state == TCP_CLOSE_WAIT) {
     sock->state = TCP_LAST_ACK;
     log_transition(sock, TCP_CLOSE_WAIT, TCP_LAST_ACK, TCP_FLAG_FIN, sock->seq_num, sock->ack_num);
-    return tcp_send_segment(sock, TCP_FLAG_FIN | TCP_FLAG_ACK, sock->ack_num, NULL, 0U);
+    sock->fin_queued = true;
+    tcp_output(sock);
+    return MAGI_OK;
   }
 
   LOG(node->name, "TCP close: cannot close socket in state %s", tcp_state_name(sock->state));
   return MAGI_ERR_CONNRESET;
 }
+
+/**
+ * @brief Read a socket's send-side statistics.
+ *
+ * Copies the counters and fills in the current cwnd, ssthresh, peer
+ * window, MSS, SRTT, RTTVAR, RTO, bytes in flight and bytes still queued.
+ *
+ * @param sock TCP socket.
+ * @param out  Destination for the statistics.
+ */
+void tcp_socket_get_stats(const TCPSocket* sock, TCPSocketStats* out) {
+  if (sock == NULL || out == NULL) {
+    return;
+  }
+
+  size_t flight = (size_t)(uint32_t)(sock->seq_num - sock->snd_una);
+  *out = sock->stats;
+  out->cwnd = sock->cwnd;
+  out->ssthresh = sock->ssthresh;
+  out->snd_wnd = sock->snd_wnd;
+  out->mss = sock->mss;
+  out->srtt_us = sock->srtt_ns / 1000U;
+  out->rttvar_us = sock->rttvar_ns / 1000U;
+  out->rto_ms = sock->rto_ns / SIM_NS_PER_MS;
+  out->bytes_in_flight = flight;
+  out->bytes_queued = sock->send_buf_len > flight ? sock->send_buf_len - flight : 0U;
+}
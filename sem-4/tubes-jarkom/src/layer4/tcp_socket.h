@@ -1,6 +1,28 @@
 /**
  * @file tcp_socket.h
- * @brief TCP socket state machine and receive buffering.
+ * @brief TCP socket state machine, send/receive buffering and congestion control.
+ *
+ * The send side keeps every byte from SND.UNA onward in a send buffer and
+ * cuts it into MSS-sized segments as the window allows. Window = min(cwnd,
+ * peer's advertised window). Each transmitted segment is recorded until it
+ * is acknowledged, which gives per-segment RTT samples (Karn's rule skips
+ * retransmissions) for the RFC 6298 retransmission timer. Losses are
+ * repaired by fast retransmit after three duplicate ACKs with NewReno
+ * recovery (RFC 5681 / RFC 6582), or by the timer with exponential backoff.
+ *
+ * The receive side is a ring: in-order bytes sit between recv_buf_head and
+ * recv_buf_head + recv_buf_len, and out-of-order bytes are written straight
+ * to their final position behind them while a TCPOooTree records which
+ * ranges arrived. The advertised window is the free ring space, and ACKs
+ * carry SACK blocks (RFC 2018) for the held ranges when the peer offered
+ * SACK-permitted.
+ *
+ * A LISTEN socket set up with tcp_socket_bind_listen() alone becomes the
+ * connection itself, RFC 793 style. tcp_socket_listen() turns it into a
+ * BSD-style listener: each SYN spawns a child socket that waits in a SYN
+ * queue until the handshake completes and then in an accept queue until
+ * tcp_socket_accept() hands it out. Both queues hold at most the backlog;
+ * SYNs beyond it are dropped and the client retransmits.
  */
 
 #ifndef MAGI_LAYER4_TCP_SOCKET_H
@@ -11,9 +33,30 @@
 #include <stdint.h>
 
 #include "core/node.h"
+#include "core/sim.h"
 #include "layer4/tcp.h"
+#include "layer4/tcp_ooo.h"
 #include "utils/hashmap.h"
 
+/** Segment size when the egress MTU is unknown (1500 minus IPv4 and TCP headers). */
+#define TCP_MSS_DEFAULT 1460U
+/** Bytes tcp_socket_send() buffers (unacknowledged plus unsent) before refusing more. */
+#define TCP_SEND_BUF_MAX (1024U * 1024U)
+/** RFC 6298 initial retransmission timeout. */
+#define TCP_RTO_INITIAL_MS 1000U
+/** RTO floor; 200 ms like common stacks rather than RFC 6298's conservative 1 s. */
+#define TCP_RTO_MIN_MS 200U
+/** RTO ceiling reached by exponential backoff. */
+#define TCP_RTO_MAX_MS 60000U
+/** Duplicate ACKs that trigger a fast retransmit. */
+#define TCP_DUPACK_THRESHOLD 3U
+/** Consecutive timeouts after which the connection is aborted. */
+#define TCP_MAX_RETRIES 12U
+/** SYN or SYN+ACK retransmissions before an opening connection gives up. */
+#define TCP_SYN_RETRIES 6U
+/** Largest backlog tcp_socket_listen() accepts; bigger requests are clamped. */
+#define TCP_BACKLOG_MAX 4096U
+
 /* ─── TCP states ─── */
 typedef enum TCPState {
   TCP_CLOSED,
@@ -32,14 +75,64 @@ typedef enum TCPState {
 /** @brief State name strings for logging. */
 extern const char* tcp_state_name(TCPState state);
 
-/* ─── Out-of-order segment list ─── */
-typedef struct OOOSegment OOOSegment;
-struct OOOSegment {
-  uint32_t seq_num;
-  uint8_t* data;
-  size_t len;
-  OOOSegment* next;
-};
+/* ─── Retransmission queue entry ─── */
+typedef struct TCPTxSegment {
+  uint32_t seq;       /* first sequence number */
+  uint32_t len;       /* sequence space covered (payload plus FIN) */
+  uint64_t sent_ns;   /* time of the last transmission */
+  bool retransmitted; /* sent more than once: no RTT sample (Karn) */
+} TCPTxSegment;
+
+/** @brief Per-socket send-side counters and a snapshot of the control state. */
+typedef struct TCPSocketStats {
+  /** Congestion window in bytes. */
+  uint32_t cwnd;
+  /** Slow-start threshold in bytes (UINT32_MAX until the first loss). */
+  uint32_t ssthresh;
+  /** Window last advertised by the peer. */
+  uint32_t snd_wnd;
+  /** Maximum segment size in use. */
+  uint16_t mss;
+  /** Smoothed RTT in microseconds (0 before the first sample). */
+  uint64_t srtt_us;
+  /** RTT variation in microseconds. */
+  uint64_t rttvar_us;
+  /** Current retransmission timeout in milliseconds. */
+  uint64_t rto_ms;
+  /** Sequence space sent but not yet acknowledged. */
+  size_t bytes_in_flight;
+  /** Buffered bytes not yet sent. */
+  size_t bytes_queued;
+  /** Tracked segments put on the wire, retransmissions included. */
+  uint64_t segments_sent;
+  /** Segments sent again, for any reason. */
+  uint64_t retransmits;
+  /** Retransmissions triggered by duplicate ACKs. */
+  uint64_t fast_retransmits;
+  /** Retransmission timer expiries. */
+  uint64_t timeouts;
+} TCPSocketStats;
+
+/** @brief FIFO of child sockets, linked through their queue_prev/queue_next. */
+typedef struct TCPChildQueue {
+  struct TCPSocket* head;
+  struct TCPSocket* tail;
+  uint32_t count;
+  /** Highest count reached. */
+  uint32_t peak;
+} TCPChildQueue;
+
+/** @brief Passive-open state of a listener created by tcp_socket_listen(). */
+typedef struct TCPListenQueues {
+  /** Capacity of each queue; 0 for sockets that are not listeners. */
+  uint32_t backlog;
+  /** Children whose handshake is still open, oldest first. */
+  TCPChildQueue syn;
+  /** Established children waiting for tcp_socket_accept(), oldest first. */
+  TCPChildQueue ready;
+  /** SYNs dropped because a queue was full. */
+  uint64_t syn_drops;
+} TCPListenQueues;
 
 /* ─── TCP socket ─── */
 typedef struct TCPSocket {
@@ -48,20 +141,67 @@ typedef struct TCPSocket {
   uint16_t local_port;
   uint8_t remote_ip[4];
   uint16_t remote_port;
-  uint32_t seq_num; /* next seq to send */
+  uint32_t seq_num; /* next seq to send (SND.NXT) */
   uint32_t ack_num; /* next expected seq */
-  uint8_t* recv_buf;
-  size_t recv_buf_len;
+  uint8_t* recv_buf; /* ring of recv_buf_cap bytes */
+  size_t recv_buf_head; /* offset of the first unread byte */
+  size_t recv_buf_len;  /* unread in-order bytes */
   size_t recv_buf_cap;
-  OOOSegment* out_of_order;
+  uint16_t rcv_wnd_adv;  /* window in the last segment we sent */
+  TCPOooTree ooo;        /* ranges beyond ack_num already in the ring */
+  uint32_t ooo_last_seq; /* start of the latest out-of-order arrival */
+  bool sack_ok;          /* both ends sent SACK-permitted */
   struct Node* node;
   bool active_open; /* true = we initiated the connection */
+
+  /* Send side */
+  uint32_t snd_una; /* oldest unacknowledged seq */
+  uint32_t snd_max; /* highest seq sent; seq_num drops below it after a timeout */
+  uint32_t snd_wnd; /* peer's advertised window */
+  uint16_t mss;
+  uint8_t* send_buf; /* bytes from snd_una: in flight, then unsent */
+  size_t send_buf_off;
+  size_t send_buf_len;
+  size_t send_buf_cap;
+  bool fin_queued; /* close requested: FIN follows the last buffered byte */
+  bool fin_sent;
+  TCPTxSegment* tx_segs; /* ring of unacknowledged segments, oldest first */
+  size_t tx_head;
+  size_t tx_count;
+  size_t tx_cap;
+  bool in_output;      /* tcp_output() is on the stack */
+  bool output_pending; /* a nested call asked it to run again */
+
+  /* Retransmission timer (RFC 6298) */
+  uint64_t srtt_ns;
+  uint64_t rttvar_ns;
+  uint64_t rto_ns;
+  bool rtt_valid;
+  uint32_t rto_backoffs;    /* consecutive expiries */
+  uint64_t rto_deadline_ns; /* 0 = not running */
+  SimTimer rto_timer;
+
+  /* Congestion control (NewReno) */
+  uint32_t cwnd;
+  uint32_t ssthresh;
+  uint32_t cwnd_acked; /* bytes acked toward the next congestion-avoidance step */
+  uint32_t recover;    /* snd_max when the last recovery began */
+  uint32_t dupacks;
+  bool in_recovery;
+  TCPSocketStats stats;
+
+  /* Passive open */
+  TCPListenQueues listen;     /* queues, when this socket is a listener */
+  struct TCPSocket* listener; /* listener that spawned this child, until accepted */
+  TCPChildQueue* queue;       /* listener queue holding this child */
+  struct TCPSocket* queue_prev;
+  struct TCPSocket* queue_next;
 } TCPSocket;
 
 /**
  * @brief Allocate and initialise a TCP socket (state = CLOSED).
  *
- * recv_buf is allocated with 16 KB capacity.
+ * recv_buf and send_buf are allocated with 16 KB capacity each.
  *
  * @param node Owning node.
  * @return New socket, or NULL on failure.
@@ -92,7 +232,7 @@ int tcp_socket_handle_segment(TCPSocket* sock, TCPSegment* seg, struct Node* nod
 /**
  * @brief Read contiguous data from the receive buffer.
  *
- * Copies up to len bytes from recv_buf and shifts remaining data.
+ * Copies up to len bytes out of the ring (at most two memcpy calls).
  *
  * @param sock Socket with data.
  * @param out  Output buffer.
@@ -109,6 +249,19 @@ size_t tcp_recv_buf_read(TCPSocket* sock, uint8_t* out, size_t len);
  */
 bool tcp_socket_has_data(const TCPSocket* sock);
 
+/**
+ * @brief List the SACK blocks the socket would put on its next ACK.
+ *
+ * The first block covers the most recent out-of-order arrival, the rest
+ * follow in sequence order (RFC 2018 §4).
+ *
+ * @param sock TCP socket.
+ * @param out  Destination array.
+ * @param max  Capacity of out.
+ * @return Number of blocks written; 0 when nothing is held out of order.
+ */
+size_t tcp_socket_sack_blocks(const TCPSocket* sock, TCPSackBlock* out, size_t max);
+
 /**
  * @brief Send a bare RST segment (used for closed-port rejection).
  *
@@ -138,36 +291,97 @@ void tcp_send_rst_packet(struct Node* node, const uint8_t src_ip[4], const uint8
  */
 int tcp_socket_bind_listen(TCPSocket* sock, struct Node* node, uint16_t port);
 
+/**
+ * @brief Make a LISTEN socket spawn a child per SYN, with bounded queues.
+ *
+ * @param sock    Socket bound with tcp_socket_bind_listen() or already in LISTEN.
+ * @param backlog Capacity of the SYN queue and of the accept queue; clamped to
+ *                1..TCP_BACKLOG_MAX.
+ * @return MAGI_OK on success, MAGI_ERR_BADARGS if sock is NULL.
+ */
+int tcp_socket_listen(TCPSocket* sock, uint32_t backlog);
+
+/**
+ * @brief Check whether a socket spawns children (see tcp_socket_listen()).
+ *
+ * @param sock TCP socket.
+ * @return true for a LISTEN socket with a backlog.
+ */
+bool tcp_socket_is_listener(const TCPSocket* sock);
+
+/**
+ * @brief Create a child for a SYN that arrived on a listener.
+ *
+ * The child starts CLOSED with the segment's four-tuple, sits at the tail
+ * of the listener's SYN queue and leaves it when tcp_socket_handle_segment()
+ * moves it out of SYN_RCVD. Feed it the SYN next.
+ *
+ * @param listener Listening socket.
+ * @param seg      The SYN.
+ * @param src_ip   Segment source address.
+ * @param dst_ip   Segment destination address.
+ * @return Child socket, or NULL if a queue is full (counted in listen.syn_drops)
+ *         or memory ran out.
+ */
+TCPSocket* tcp_socket_spawn(TCPSocket* listener, const TCPSegment* seg, const uint8_t src_ip[4],
+                            const uint8_t dst_ip[4]);
+
+/**
+ * @brief Take the oldest established child off a listener's accept queue.
+ *
+ * The child may have been reset or closed by the peer since.
+ *
+ * @param listener Listening socket.
+ * @return Child, now owned by the caller, or NULL if the queue is empty.
+ */
+TCPSocket* tcp_socket_accept(TCPSocket* listener);
+
+/**
+ * @brief Take a child off whichever listener queue holds it.
+ *
+ * @param child Socket spawned by tcp_socket_spawn(); no-op once accepted.
+ */
+void tcp_socket_unlink_child(TCPSocket* child);
+
 /**
  * @brief Initiate an active open (client connection).
  *
- * The socket is placed in SYN_SENT state and a SYN is sent.
- * On success, the full 3-way handshake completes within this call
- * (synchronous sequential mode).
+ * The socket is placed in SYN_SENT state, a SYN is sent and the
+ * retransmit timer is armed to resend it until the handshake completes.
+ * The call returns without waiting: callers run the clock until the
+ * socket leaves SYN_SENT, as magi_connect() does.
  *
- * @param sock    TCP socket (must be in CLOSED state).
+ * @param sock    TCP socket (must be in CLOSED state and bound to a local
+ *                port in the node's port registry).
  * @param node    Owning node.
  * @param dst_ip  Destination IPv4 address (dotted decimal).
  * @param dst_port Destination port.
- * @return MAGI_OK on success, MAGI_ERR_CONNRESET if handshake fails.
+ * @return MAGI_OK on success, MAGI_ERR_BADARGS if the socket is unbound,
+ *         MAGI_ERR_CONNRESET if handshake fails.
  */
 int tcp_socket_connect(TCPSocket* sock, struct Node* node, const char* dst_ip, uint16_t dst_port);
 
 /**
- * @brief Send data on an ESTABLISHED socket.
+ * @brief Queue data on an ESTABLISHED (or CLOSE_WAIT) socket and send what the window allows.
+ *
+ * The data is copied into the send buffer and leaves in MSS-sized
+ * segments; the rest follows as ACKs open the window. Lost segments are
+ * retransmitted from the buffer.
  *
- * @param sock  TCP socket (must be ESTABLISHED).
+ * @param sock  TCP socket.
  * @param node  Owning node.
  * @param data  Payload bytes.
  * @param len   Payload length.
- * @return MAGI_OK on success.
+ * @return MAGI_OK once the data is buffered, MAGI_ERR_QUEUE_FULL if it would
+ *         exceed TCP_SEND_BUF_MAX, MAGI_ERR_CONNRESET in other states.
  */
 int tcp_socket_send(TCPSocket* sock, struct Node* node, const uint8_t* data, size_t len);
 
 /**
  * @brief Initiate active close (send FIN).
  *
- * The socket transitions from ESTABLISHED to FIN_WAIT_1.
+ * The socket transitions from ESTABLISHED to FIN_WAIT_1. The FIN goes out
+ * after any data still in the send buffer.
  *
  * @param sock  TCP socket.
  * @param node  Owning node.
@@ -175,4 +389,12 @@ int tcp_socket_send(TCPSocket* sock, struct Node* node, const uint8_t* data, siz
  */
 int tcp_socket_close(TCPSocket* sock, struct Node* node);
 
+/**
+ * @brief Read the socket's send-side statistics.
+ *
+ * @param sock TCP socket.
+ * @param out  Destination for the counters and current cwnd/RTT/RTO values.
+ */
+void tcp_socket_get_stats(const TCPSocket* sock, TCPSocketStats* out);
+
 #endif /* MAGI_LAYER4_TCP_SOCKET_H */
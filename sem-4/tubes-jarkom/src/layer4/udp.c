@@ -50,10 +50,6 @@ int udp_pack(UDPDatagram* dgram, const uint8_t src_ip[4], const uint8_t dst_ip[4
   WRITE_U16(out, 4U, (uint16_t)total_len);
   WRITE_U16(out, 6U, 0U); /* checksum placeholder */
 
-  if (dgram->payload_len > 0U && dgram->payload != NULL) {
-    memcpy(out + UDP_HEADER_LEN, dgram->payload, dgram->payload_len);
-  }
-
   /* Build pseudo-header for checksum */
   uint8_t pseudo_hdr[12];
   memcpy(pseudo_hdr, src_ip, 4U);
@@ -62,7 +58,15 @@ int udp_pack(UDPDatagram* dgram, const uint8_t src_ip[4], const uint8_t dst_ip[4
   pseudo_hdr[9] = 17U; /* IPPROTO_UDP */
   WRITE_U16(pseudo_hdr, 10U, (uint16_t)total_len);
 
-  uint16_t cksum = transport_checksum(pseudo_hdr, 12U, out, total_len);
+  /* Sum the payload while copying it in rather than reading it back afterwards. */
+  uint32_t sum = checksum_partial(0U, pseudo_hdr, sizeof(pseudo_hdr));
+  sum = checksum_partial(sum, out, UDP_HEADER_LEN);
+  if (dgram->payload_len > 0U && dgram->payload != NULL) {
+    sum = checksum_copy_partial(sum, out + UDP_HEADER_LEN, dgram->payload, dgram->payload_len);
+  } else {
+    sum = checksum_partial(sum, out + UDP_HEADER_LEN, dgram->payload_len);
+  }
+  uint16_t cksum = checksum_finish(sum);
 
   /* RFC 768: if checksum computes to 0x0000, store as 0xFFFF */
   if (cksum == 0U) {
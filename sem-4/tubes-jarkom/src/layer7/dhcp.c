@@ -1,4 +1,5 @@
 #define _POSIX_C_SOURCE 200809L
+#define MAGI_LOG_SUBSYS MAGI_LOG_L7
 
 #include "dhcp.h"
 
@@ -192,8 +193,7 @@ int dhcp_client_discover(Node* node) {
     return status;
   }
 
-  /* In sequential mode, the OFFER should already be in our buffer */
-  if (!magi_has_data(sock)) {
+  if (!magi_wait_data(sock, MAGI_SOCKET_WAIT_MS)) {
     LOG(node->name, "DHCP: no OFFER received");
     magi_close(sock);
     return MAGI_ERR_TIMEOUT;
@@ -238,7 +238,7 @@ int dhcp_client_discover(Node* node) {
   }
 
   /* Receive ACK */
-  if (!magi_has_data(sock)) {
+  if (!magi_wait_data(sock, MAGI_SOCKET_WAIT_MS)) {
     LOG(node->name, "DHCP: no ACK received");
     magi_close(sock);
     return MAGI_ERR_TIMEOUT;
@@ -259,7 +259,7 @@ int dhcp_client_discover(Node* node) {
   }
 
   /* Configure the host's IP address */
-  snprintf(iface->ip_address, sizeof(iface->ip_address), "%s", offered_ip_str);
+  (void)interface_set_ip(iface, offered_ip_str);
   LOG(node->name, "DHCP: ACK received — host configured with IP %s", offered_ip_str);
 
   magi_close(sock);
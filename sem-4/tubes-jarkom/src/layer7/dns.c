@@ -1,4 +1,5 @@
 #define _POSIX_C_SOURCE 200809L
+#define MAGI_LOG_SUBSYS MAGI_LOG_L7
 
 #include "dns.h"
 
@@ -105,7 +106,7 @@ int dns_query(Node* node, const char* dns_server_ip, const char* hostname, uint8
   }
 
   /* Receive response */
-  if (!magi_has_data(sock)) {
+  if (!magi_wait_data(sock, MAGI_SOCKET_WAIT_MS)) {
     LOG(node->name, "DNS: no response received");
     magi_close(sock);
     return MAGI_ERR_TIMEOUT;
@@ -1,4 +1,5 @@
 #define _POSIX_C_SOURCE 200809L
+#define MAGI_LOG_SUBSYS MAGI_LOG_L7
 
 #include "http.h"
 
@@ -81,7 +82,7 @@ int http_server_start(Node* node, const char* web_root) {
     return status;
   }
 
-  status = magi_listen(sock, 5);
+  status = magi_listen(sock, HTTP_SERVER_BACKLOG);
   if (status != MAGI_OK) {
     LOG(node->name, "HTTP server: failed to listen");
     magi_close(sock);
@@ -90,44 +91,57 @@ int http_server_start(Node* node, const char* web_root) {
 
   LOG(node->name, "HTTP server: listening on port 80 (content: %zu bytes)", strlen(content));
 
-  /* In sequential mode, check if there's a pending connection */
-  if (magi_has_data(sock)) {
-    /* Accept the connection */
+  /* In sequential mode, serve whatever is already waiting */
+  while (magi_has_data(sock)) {
     MagiSocket* conn = magi_accept(sock);
     if (conn == NULL) {
       LOG(node->name, "HTTP server: accept failed");
       return MAGI_OK;
     }
+    (void)http_server_respond(conn, content);
+  }
 
-    /* Read the GET request */
-    uint8_t req_buf[1024];
-    int rd = magi_recv(conn, req_buf, sizeof(req_buf) - 1U);
-    if (rd > 0) {
-      req_buf[rd] = '\0';
-      LOG(node->name, "HTTP server: received request (%d bytes):\n%s", rd, (const char*)req_buf);
-    }
+  /* Keep the server socket open — don't close it */
+  return MAGI_OK;
+}
 
-    /* Build and send response */
-    size_t content_len = strlen(content);
-    char response[2048];
-    int resp_len = snprintf(response, sizeof(response),
-                            "HTTP/1.1 200 OK\r\n"
-                            "Content-Length: %zu\r\n"
-                            "Connection: close\r\n"
-                            "\r\n"
-                            "%s",
-                            content_len, content);
+int http_server_respond(MagiSocket* conn, const char* content) {
+  if (conn == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
 
-    LOG(node->name, "HTTP server: sending response (%d bytes)", resp_len);
-    (void)magi_send(conn, (const uint8_t*)response, (size_t)resp_len);
+  Node* node = conn->node;
+  if (content == NULL || content[0] == '\0') {
+    content = DEFAULT_PAGE;
+  }
 
-    /* Server initiates close */
-    magi_close(conn);
-    LOG(node->name, "HTTP server: connection closed");
+  /* Read the GET request */
+  uint8_t req_buf[1024];
+  int rd = magi_recv(conn, req_buf, sizeof(req_buf) - 1U);
+  if (rd > 0) {
+    req_buf[rd] = '\0';
+    LOG(node->name, "HTTP server: received request (%d bytes):\n%s", rd, (const char*)req_buf);
   }
 
-  /* Keep the server socket open — don't close it */
-  return MAGI_OK;
+  /* Build and send response */
+  size_t content_len = strlen(content);
+  char response[2048];
+  int resp_len = snprintf(response, sizeof(response),
+                          "HTTP/1.1 200 OK\r\n"
+                          "Content-Length: %zu\r\n"
+                          "Connection: close\r\n"
+                          "\r\n"
+                          "%s",
+                          content_len, content);
+
+  LOG(node->name, "HTTP server: sending response (%d bytes)", resp_len);
+  int status = magi_send(conn, (const uint8_t*)response, (size_t)resp_len);
+
+  /* Server initiates close */
+  magi_close(conn);
+  LOG(node->name, "HTTP server: connection closed");
+  return status;
 }
 
 int http_server_stop(Node* node) {
@@ -11,10 +11,13 @@
 #define MAGI_LAYER7_HTTP_H
 
 #include "core/node.h"
+#include "layer7/magi_socket.h"
 
 #include <stddef.h>
 
 #define HTTP_PORT 80U
+/** Listen backlog of the HTTP server socket. */
+#define HTTP_SERVER_BACKLOG 128
 
 /**
  * @brief Start an HTTP server on a host node.
@@ -28,6 +31,18 @@
  */
 int http_server_start(Node* node, const char* web_root);
 
+/**
+ * @brief Answer one request on an accepted connection and close it.
+ *
+ * Reads the request (waiting like magi_recv()), sends a 200 response
+ * carrying content, and closes the connection.
+ *
+ * @param conn    Connection from magi_accept(); closed on return.
+ * @param content Body to serve (NULL or empty for the default page).
+ * @return MAGI_OK once the response is queued, otherwise an error code.
+ */
+int http_server_respond(MagiSocket* conn, const char* content);
+
 /**
  * @brief Stop the HTTP server on a host node.
  *
@@ -1,8 +1,10 @@
 #define _POSIX_C_SOURCE 200809L
+#define MAGI_LOG_SUBSYS MAGI_LOG_L7
 
 #include "magi_socket.h"
 
 #include "core/node.h"
+#include "core/sim.h"
 #include "layer3/ipv4.h"
 #include "layer4/l4_host.h"
 #include "layer4/port_registry.h"
@@ -64,7 +66,7 @@ int magi_bind(MagiSocket* sock, const char* ip, uint16_t port) {
     return MAGI_ERR_BADARGS;
   }
 
-  HashMap* reg = (HashMap*)l4_host_get_registry(sock->node);
+  PortRegistry* reg = l4_host_get_registry(sock->node);
   if (reg == NULL) {
     LOG(sock->node->name, "magi_bind: L4 not attached");
     magi_errno = MAGI_ERR_BADARGS;
@@ -101,8 +103,6 @@ int magi_bind(MagiSocket* sock, const char* ip, uint16_t port) {
 }
 
 int magi_listen(MagiSocket* sock, int backlog) {
-  (void)backlog; /* ignored in sequential mode */
-
   if (sock == NULL || sock->type != MAGI_SOCK_STREAM) {
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
@@ -115,9 +115,13 @@ int magi_listen(MagiSocket* sock, int backlog) {
   }
 
   TCPSocket* tcp = (TCPSocket*)sock->transport;
-  tcp->state = TCP_LISTEN;
+  int status = tcp_socket_listen(tcp, backlog > 0 ? (uint32_t)backlog : 1U);
+  if (status != MAGI_OK) {
+    return status;
+  }
   sock->listening = true;
-  LOG(sock->node->name, "magi_listen: TCP LISTEN on port %u", (unsigned)sock->local_port);
+  LOG(sock->node->name, "magi_listen: TCP LISTEN on port %u (backlog %u)",
+      (unsigned)sock->local_port, (unsigned)tcp->listen.backlog);
   return MAGI_OK;
 }
 
@@ -127,58 +131,84 @@ MagiSocket* magi_accept(MagiSocket* sock) {
     return NULL;
   }
 
+  /* Each SYN spawned a child socket in L4 dispatch; established ones
+     wait on the listener's accept queue. Children reset before anyone
+     accepted them are skipped. */
+  (void)magi_wait_data(sock, MAGI_SOCKET_WAIT_MS);
   TCPSocket* listen_tcp = (TCPSocket*)sock->transport;
-
-  /* In sequential mode the handshake already completed synchronously
-     when the remote host's SYN arrived via l4_dispatch_packet and was
-     processed by tcp_socket_handle_segment on the LISTEN socket.
-     The listening socket transitions LISTEN → SYN_RCVD → ESTABLISHED.
-     We create a new MagiSocket wrapping the now-ESTABLISHED socket
-     and create a fresh listening socket to take its place. */
-
-  if (listen_tcp->state != TCP_ESTABLISHED && listen_tcp->state != TCP_SYN_RCVD) {
-    LOG(sock->node->name, "magi_accept: no pending connection (state=%s)",
-        tcp_state_name(listen_tcp->state));
-    magi_errno = MAGI_ERR_BADARGS;
+  TCPSocket* child = tcp_socket_accept(listen_tcp);
+  while (child != NULL && child->state == TCP_CLOSED) {
+    l4_host_tcp_free(sock->node, child);
+    child = tcp_socket_accept(listen_tcp);
+  }
+  if (child == NULL) {
+    LOG(sock->node->name, "magi_accept: no pending connection on port %u",
+        (unsigned)sock->local_port);
+    magi_errno = MAGI_ERR_TIMEOUT;
     return NULL;
   }
 
-  /* Create the accepted connection socket */
   MagiSocket* accepted = calloc(1U, sizeof(*accepted));
   if (accepted == NULL) {
+    l4_host_tcp_free(sock->node, child);
     magi_errno = MAGI_ERR_NOMEM;
     return NULL;
   }
 
+  /* The listener keeps the port binding; the child lives in the connection table */
   accepted->family = MAGI_AF_INET;
   accepted->type = MAGI_SOCK_STREAM;
   accepted->node = sock->node;
-  accepted->transport = listen_tcp;
-  accepted->bound = true;
+  accepted->transport = child;
+  accepted->bound = false;
   accepted->listening = false;
-  accepted->local_port = sock->local_port;
+  accepted->local_port = child->local_port;
+  return accepted;
+}
 
-  /* Create a new listening socket to replace the one we just consumed */
-  TCPSocket* new_listen = tcp_socket_new(sock->node);
-  if (new_listen == NULL) {
-    free(accepted);
-    magi_errno = MAGI_ERR_NOMEM;
-    return NULL;
+/**
+ * @brief Bind an unbound socket to a free ephemeral port, as connect/sendto do implicitly.
+ *
+ * @param sock Socket to bind. Already-bound sockets are left alone.
+ * @return MAGI_OK, MAGI_ERR_BADARGS without L4, or MAGI_ERR_PORTUSED when the range is exhausted.
+ */
+static int magi_bind_ephemeral(MagiSocket* sock) {
+  if (sock->bound) {
+    return MAGI_OK;
   }
 
-  memcpy(new_listen->local_ip, listen_tcp->local_ip, 4U);
-  new_listen->local_port = listen_tcp->local_port;
-  new_listen->state = TCP_LISTEN;
+  PortRegistry* reg = l4_host_get_registry(sock->node);
+  if (reg == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
 
-  /* Update port registry to point to the new listening socket */
-  HashMap* reg = (HashMap*)l4_host_get_registry(sock->node);
-  if (reg != NULL) {
-    (void)port_registry_unbind(reg, PORT_PROTOCOL_TCP, sock->local_port);
-    (void)port_registry_bind(reg, PORT_PROTOCOL_TCP, sock->local_port, new_listen);
+  bool stream = sock->type == MAGI_SOCK_STREAM;
+  uint16_t port = 0U;
+  int status = port_registry_bind_ephemeral(reg, stream ? PORT_PROTOCOL_TCP : PORT_PROTOCOL_UDP,
+                                            sock->transport, &port);
+  if (status != MAGI_OK) {
+    return status;
   }
 
-  sock->transport = new_listen;
-  return accepted;
+  if (stream) {
+    ((TCPSocket*)sock->transport)->local_port = port;
+  } else {
+    ((UDPSocketState*)sock->transport)->local_port = port;
+  }
+  sock->local_port = port;
+  sock->bound = true;
+  return MAGI_OK;
+}
+
+/**
+ * @brief sim_run_until_cond() predicate: the TCP handshake has finished.
+ *
+ * @param ctx The TCPSocket being connected.
+ * @return true once the socket has left SYN_SENT.
+ */
+static bool tcp_handshake_done(const void* ctx) {
+  return ((const TCPSocket*)ctx)->state != TCP_SYN_SENT;
 }
 
 int magi_connect(MagiSocket* sock, const char* ip, uint16_t port) {
@@ -191,25 +221,16 @@ int magi_connect(MagiSocket* sock, const char* ip, uint16_t port) {
     TCPSocket* tcp = (TCPSocket*)sock->transport;
 
     /* Auto-bind to ephemeral port if not already bound */
-    if (!sock->bound) {
-      HashMap* reg = (HashMap*)l4_host_get_registry(sock->node);
-      if (reg == NULL) {
-        magi_errno = MAGI_ERR_BADARGS;
-        return MAGI_ERR_BADARGS;
-      }
-      uint16_t ephemeral = (uint16_t)(49152U + ((uintptr_t)tcp & 0x3FFFU));
-      int status = port_registry_bind(reg, PORT_PROTOCOL_TCP, ephemeral, tcp);
-      if (status != MAGI_OK) {
-        return status;
-      }
-      sock->local_port = ephemeral;
-      sock->bound = true;
+    int status = magi_bind_ephemeral(sock);
+    if (status != MAGI_OK) {
+      return status;
     }
 
-    int status = tcp_socket_connect(tcp, sock->node, ip, port);
+    status = tcp_socket_connect(tcp, sock->node, ip, port);
     if (status != MAGI_OK) {
       return status;
     }
+    (void)sim_run_until_cond(tcp_handshake_done, tcp, MAGI_SOCKET_WAIT_MS * SIM_NS_PER_MS);
 
     LOG(sock->node->name, "magi_connect: TCP connected to %s:%u (state=%s)", ip, (unsigned)port,
         tcp_state_name(tcp->state));
@@ -223,6 +244,10 @@ int magi_connect(MagiSocket* sock, const char* ip, uint16_t port) {
       magi_errno = MAGI_ERR_BADARGS;
       return MAGI_ERR_BADARGS;
     }
+    int status = magi_bind_ephemeral(sock);
+    if (status != MAGI_OK) {
+      return status;
+    }
     memcpy(udp->remote_ip, dst_bytes, 4U);
     udp->remote_port = port;
     return MAGI_OK;
@@ -303,6 +328,12 @@ int magi_sendto(MagiSocket* sock, const uint8_t* data, size_t len, const char* d
     return MAGI_ERR_BADARGS;
   }
 
+  /* Replies need somewhere to land: bind an ephemeral port on first send */
+  int status = magi_bind_ephemeral(sock);
+  if (status != MAGI_OK) {
+    return status;
+  }
+
   UDPDatagram dgram;
   memset(&dgram, 0, sizeof(dgram));
   dgram.src_port = udp->local_port;
@@ -317,7 +348,7 @@ int magi_sendto(MagiSocket* sock, const uint8_t* data, size_t len, const char* d
     return MAGI_ERR_NOMEM;
   }
 
-  int status = udp_pack(&dgram, udp->local_ip, dst_bytes, buf, total);
+  status = udp_pack(&dgram, udp->local_ip, dst_bytes, buf, total);
   if (status != MAGI_OK) {
     free(buf);
     return status;
@@ -341,6 +372,7 @@ int magi_recv(MagiSocket* sock, uint8_t* buf, size_t buf_len) {
     return MAGI_ERR_BADARGS;
   }
 
+  (void)magi_wait_data(sock, MAGI_SOCKET_WAIT_MS);
   if (sock->type == MAGI_SOCK_STREAM) {
     TCPSocket* tcp = (TCPSocket*)sock->transport;
     size_t rd = tcp_recv_buf_read(tcp, buf, buf_len);
@@ -369,6 +401,7 @@ int magi_recvfrom(MagiSocket* sock, uint8_t* buf, size_t buf_len, char* src_ip_o
     return MAGI_ERR_BADARGS;
   }
 
+  (void)magi_wait_data(sock, MAGI_SOCKET_WAIT_MS);
   UDPSocketState* udp = (UDPSocketState*)sock->transport;
 
   /* Capture sender info before reading */
@@ -390,7 +423,8 @@ bool magi_has_data(MagiSocket* sock) {
 
   if (sock->type == MAGI_SOCK_STREAM) {
     TCPSocket* tcp = (TCPSocket*)sock->transport;
-    return tcp_socket_has_data(tcp);
+    /* A listener is readable when a connection is waiting to be accepted */
+    return sock->listening ? tcp->listen.ready.count > 0U : tcp_socket_has_data(tcp);
   }
 
   if (sock->type == MAGI_SOCK_DGRAM) {
@@ -401,12 +435,30 @@ bool magi_has_data(MagiSocket* sock) {
   return false;
 }
 
+/**
+ * @brief sim_run_until_cond() predicate wrapping magi_has_data().
+ *
+ * @param ctx The MagiSocket to check.
+ * @return true if the socket has data available.
+ */
+static bool socket_readable(const void* ctx) {
+  return magi_has_data((MagiSocket*)ctx);
+}
+
+bool magi_wait_data(MagiSocket* sock, uint32_t timeout_ms) {
+  if (sock == NULL) {
+    return false;
+  }
+
+  return sim_run_until_cond(socket_readable, sock, (uint64_t)timeout_ms * SIM_NS_PER_MS);
+}
+
 int magi_close(MagiSocket* sock) {
   if (sock == NULL) {
     return MAGI_OK;
   }
 
-  HashMap* reg = (HashMap*)l4_host_get_registry(sock->node);
+  PortRegistry* reg = l4_host_get_registry(sock->node);
 
   if (sock->type == MAGI_SOCK_STREAM) {
     TCPSocket* tcp = (TCPSocket*)sock->transport;
@@ -414,11 +466,11 @@ int magi_close(MagiSocket* sock) {
       if (tcp->state == TCP_ESTABLISHED || tcp->state == TCP_CLOSE_WAIT) {
         (void)tcp_socket_close(tcp, sock->node);
       }
-      /* Unbind from port registry */
+      /* Unbind from port registry; accepted sockets never held the binding */
       if (reg != NULL && sock->bound) {
         (void)port_registry_unbind(reg, PORT_PROTOCOL_TCP, sock->local_port);
       }
-      tcp_socket_free(tcp);
+      l4_host_tcp_free(sock->node, tcp);
     }
   } else if (sock->type == MAGI_SOCK_DGRAM) {
     UDPSocketState* udp = (UDPSocketState*)sock->transport;
@@ -15,6 +15,9 @@
 
 struct Node;
 
+/** Simulated time blocking calls wait for a peer before giving up. */
+#define MAGI_SOCKET_WAIT_MS 2000U
+
 typedef enum { MAGI_AF_INET = 2 } MagiAddrFamily;
 typedef enum { MAGI_SOCK_STREAM = 1, MAGI_SOCK_DGRAM = 2 } MagiSockType;
 
@@ -51,8 +54,12 @@ int magi_bind(MagiSocket* sock, const char* ip, uint16_t port);
 /**
  * @brief Set a STREAM socket to listening state.
  *
+ * Each incoming SYN gets its own connection. Up to backlog of them may be
+ * mid-handshake, and up to backlog more established and waiting for
+ * magi_accept(); further SYNs are dropped until the client retries.
+ *
  * @param sock    TCP socket to listen on.
- * @param backlog Connection backlog (ignored in sequential mode).
+ * @param backlog Connection backlog (values below 1 mean 1).
  * @return MAGI_OK on success, otherwise an error code.
  */
 int magi_listen(MagiSocket* sock, int backlog);
@@ -60,16 +67,19 @@ int magi_listen(MagiSocket* sock, int backlog);
 /**
  * @brief Accept an incoming connection on a listening STREAM socket.
  *
- * In sequential mode, the handshake completes synchronously before returning.
+ * Returns the oldest established connection, waiting like magi_recv()
+ * when none is queued. magi_has_data() on a listener reports whether one
+ * is waiting.
  *
  * @param sock Listening socket.
- * @return New connected MagiSocket, or NULL on failure.
+ * @return New connected MagiSocket, or NULL if none arrived (MAGI_ERR_TIMEOUT).
  */
 MagiSocket* magi_accept(MagiSocket* sock);
 
 /**
  * @brief Connect a socket to a remote address.
  *
+ * An unbound socket is first bound to a free ephemeral port.
  * For STREAM sockets, completes the 3-way handshake before returning.
  * For DGRAM sockets, just sets the remote address.
  *
@@ -93,6 +103,9 @@ int magi_send(MagiSocket* sock, const uint8_t* data, size_t len);
 /**
  * @brief Send a UDP datagram to a specific destination.
  *
+ * An unbound socket is first bound to a free ephemeral port so replies
+ * can reach it.
+ *
  * @param sock    DGRAM socket to send from.
  * @param data    Payload bytes.
  * @param len     Payload length.
@@ -106,6 +119,8 @@ int magi_sendto(MagiSocket* sock, const uint8_t* data, size_t len, const char* d
 /**
  * @brief Receive data from a socket.
  *
+ * Waits up to MAGI_SOCKET_WAIT_MS of simulated time when nothing is queued.
+ *
  * @param sock    Socket to receive from.
  * @param buf     Output buffer.
  * @param buf_len Output buffer capacity.
@@ -116,6 +131,8 @@ int magi_recv(MagiSocket* sock, uint8_t* buf, size_t buf_len);
 /**
  * @brief Receive data from a DGRAM socket and get the sender's address.
  *
+ * Waits like magi_recv().
+ *
  * @param sock       DGRAM socket to receive from.
  * @param buf        Output buffer.
  * @param buf_len    Output buffer capacity.
@@ -134,6 +151,19 @@ int magi_recvfrom(MagiSocket* sock, uint8_t* buf, size_t buf_len, char* src_ip_o
  */
 bool magi_has_data(MagiSocket* sock);
 
+/**
+ * @brief Run the simulation until a socket has data or a timeout passes.
+ *
+ * In sequential builds replies cross delayed links as clock events, so a
+ * request/response client must let the clock run before reading. Async
+ * builds only check once.
+ *
+ * @param sock       Socket to wait on.
+ * @param timeout_ms Simulated time to wait.
+ * @return true if there is data available.
+ */
+bool magi_wait_data(MagiSocket* sock, uint32_t timeout_ms);
+
 /**
  * @brief Close a socket and release all resources.
  *
@@ -1,4 +1,5 @@
 #define _POSIX_C_SOURCE 200809L
+#define MAGI_LOG_SUBSYS MAGI_LOG_L7
 
 /**
  * @file rip.c
@@ -22,6 +23,7 @@
 
 #include "core/interface.h"
 #include "core/link.h"
+#include "core/sim.h"
 #include "layer3/ipv4.h"
 #include "layer3/router.h"
 #include "layer4/udp.h"
@@ -54,11 +56,16 @@ typedef struct RIPState {
   RIPRouteRecord* learned_routes;
   /** Connected routes advertised previously, used for link-down poisoning. */
   RIPRouteRecord* advertised_connected;
+  /** Router the state belongs to, for timer callbacks. */
+  Node* node;
+  /** Periodic update timer (sequential builds). */
+  SimTimer update_timer;
 } RIPState;
 
 /* ─── Forward declarations of internal helpers ─── */
 
 static void rip_free_state(void* data);
+static void rip_periodic_update(void* ctx);
 
 /* ─── Message Building / Parsing ─── */
 
@@ -179,28 +186,35 @@ static void rip_route_record_free_all(RIPRouteRecord* list) {
 typedef struct RipFindRouteCtx {
   const uint8_t* network;
   int prefix_len;
-  const RoutingTableEntry* route;
+  RoutingTableEntry* out;
+  bool found;
 } RipFindRouteCtx;
 
 static void rip_find_route_cb(const RoutingTableEntry* route, void* ctx) {
   RipFindRouteCtx* state = (RipFindRouteCtx*)ctx;
-  if (state == NULL || state->route != NULL || route == NULL || state->network == NULL) {
+  if (state == NULL || state->found || route == NULL || state->network == NULL) {
     return;
   }
 
   if (route->prefix_len == state->prefix_len && ipv4_addr_equal(route->network, state->network)) {
-    state->route = route;
+    *state->out = *route;
+    state->found = true;
   }
 }
 
+/*
+ * router_foreach_route() hands out entries that only live for the walk,
+ * so the match is copied into the caller's buffer.
+ */
 static const RoutingTableEntry* rip_find_exact_route(Router* router, const uint8_t network[4],
-                                                     int prefix_len) {
+                                                     int prefix_len, RoutingTableEntry* out) {
   RipFindRouteCtx ctx;
   ctx.network = network;
   ctx.prefix_len = prefix_len;
-  ctx.route = NULL;
+  ctx.out = out;
+  ctx.found = false;
   router_foreach_route(router, rip_find_route_cb, &ctx);
-  return ctx.route;
+  return ctx.found ? out : NULL;
 }
 
 static bool rip_connected_route_from_iface(const Interface* iface, RoutingTableEntry* out) {
@@ -434,6 +448,14 @@ int rip_init(Node* node) {
 
   state->sequence = 0U;
   state->active = true;
+  state->node = node;
+  sim_timer_init(&state->update_timer, rip_periodic_update, state);
+#ifndef MAGI_ASYNC
+  if (sim_timer_arm(&state->update_timer, RIP_UPDATE_INTERVAL_MS * SIM_NS_PER_MS) != MAGI_OK) {
+    free(state);
+    return MAGI_ERR_NOMEM;
+  }
+#endif
 
   node->l4_data = state;
   node->l4_data_free = rip_free_state;
@@ -755,7 +777,9 @@ void rip_handle_message(Node* node, const uint8_t* data, size_t len, const uint8
       continue;
     }
 
-    const RoutingTableEntry* exact = rip_find_exact_route(router, network, prefix_len);
+    RoutingTableEntry exact_route;
+    const RoutingTableEntry* exact =
+        rip_find_exact_route(router, network, prefix_len, &exact_route);
     RIPRouteRecord* learned =
         rip_route_record_find(state->learned_routes, network, prefix_len);
     bool learned_same_next_hop =
@@ -889,6 +913,17 @@ void rip_handle_message(Node* node, const uint8_t* data, size_t len, const uint8
 
 /* ─── Private helpers ─── */
 
+/**
+ * @brief Simulation event: send the periodic update and re-arm the timer.
+ *
+ * @param ctx The RIPState whose timer fired.
+ */
+static void rip_periodic_update(void* ctx) {
+  RIPState* state = (RIPState*)ctx;
+  (void)rip_send_update(state->node);
+  (void)sim_timer_arm(&state->update_timer, RIP_UPDATE_INTERVAL_MS * SIM_NS_PER_MS);
+}
+
 /**
  * @brief Free the RIP state attached to a node.
  *
@@ -901,6 +936,7 @@ static void rip_free_state(void* data) {
   if (state == NULL) {
     return;
   }
+  sim_timer_cancel(&state->update_timer);
   rip_route_record_free_all(state->learned_routes);
   rip_route_record_free_all(state->advertised_connected);
   free(state);
@@ -56,6 +56,9 @@
 /** Maximum number of RIP entries per message (conservative estimate). */
 #define RIP_MAX_ENTRIES 128U
 
+/** Interval between periodic updates, in simulated milliseconds. */
+#define RIP_UPDATE_INTERVAL_MS 30000U
+
 /* ─── Functions ─── */
 
 /**
@@ -63,6 +66,9 @@
  *
  * Registers the RIP dispatch handler on the router so that incoming
  * UDP packets to port 520 are processed. Allocates internal RIP state.
+ * Sequential builds schedule a periodic update every
+ * RIP_UPDATE_INTERVAL_MS on the simulation clock; async builds use the
+ * engine's 30 s tick instead.
  *
  * @param node Router node to initialise RIP on.
  * @return MAGI_OK on success, otherwise an error code.
@@ -11,7 +11,8 @@
 /**
  * @brief Program entry point.
  *
- * Initialises the topology, sets the concrete CLI node operations,
+ * Applies MAGI_LOG_LEVEL / MAGI_LOG_SINK, initialises the topology, sets
+ * the concrete CLI node operations,
  * loads the topology from the default JSON file (or continues with an
  * empty topology on failure), enters the CLI event loop, and cleans up
  * before exiting.
@@ -19,6 +20,7 @@
  * @return 0 on success, 1 on initialisation or runtime failure.
  */
 int main(void) {
+  magi_log_init_from_env();
   Topology* topology = topology_new();
   if (topology == NULL) {
     LOG("MAGI", "Failed to initialize topology");
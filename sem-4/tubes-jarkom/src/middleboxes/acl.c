@@ -1,4 +1,5 @@
 #define _POSIX_C_SOURCE 200809L
+#define MAGI_LOG_SUBSYS MAGI_LOG_L3
 
 #include "acl.h"
 
@@ -11,6 +12,304 @@
 #include <strings.h>
 
 #define ACL_INITIAL_CAPACITY 8U
+#define ACL_TUPLE_MIN_SLOTS 8U
+#define ACL_NO_RULE UINT32_MAX
+
+/** @brief A rule in binary form: host-order prefixes and inclusive port ranges. */
+typedef struct ACLMatch {
+  uint32_t src_net;
+  uint32_t dst_net;
+  uint16_t src_port_lo;
+  uint16_t src_port_hi;
+  uint16_t dst_port_lo;
+  uint16_t dst_port_hi;
+  uint8_t protocol;
+  bool permit;
+  /** Next rule, by rule id, with the same tuple and prefixes; ACL_NO_RULE ends the chain. */
+  uint32_t next;
+} ACLMatch;
+
+/** @brief One pair of prefixes within a tuple; its rules are chained in rule order. */
+typedef struct ACLBucket {
+  /** Source prefix in the high half, destination prefix in the low half. */
+  uint64_t key;
+  uint32_t head;
+  uint32_t tail;
+  bool used;
+} ACLBucket;
+
+/** @brief All rules with one (source length, destination length) pair of prefix lengths. */
+typedef struct ACLTuple {
+  uint32_t src_mask;
+  uint32_t dst_mask;
+  /** Lowest rule id in the tuple; tuples are kept sorted on it. */
+  uint32_t first_rule;
+  ACLBucket* slots;
+  size_t capacity;
+  size_t count;
+} ACLTuple;
+
+struct ACLClassifier {
+  /** Indexed by rule id. */
+  ACLMatch* matches;
+  size_t match_capacity;
+  ACLTuple* tuples;
+  size_t tuple_count;
+  size_t tuple_capacity;
+};
+
+/**
+ * @brief Free a classifier and its tuples.
+ *
+ * @param cls Classifier to free. NULL is allowed.
+ */
+static void acl_classifier_free(struct ACLClassifier* cls) {
+  if (cls == NULL) {
+    return;
+  }
+
+  for (size_t index = 0U; index < cls->tuple_count; ++index) {
+    free(cls->tuples[index].slots);
+  }
+  free(cls->tuples);
+  free(cls->matches);
+  free(cls);
+}
+
+/**
+ * @brief Read an address as a host-order word.
+ *
+ * @param ip 4-byte IP address.
+ * @return The address, most significant byte first.
+ */
+static uint32_t acl_addr_word(const uint8_t ip[4]) {
+  return ((uint32_t)ip[0] << 24U) | ((uint32_t)ip[1] << 16U) | ((uint32_t)ip[2] << 8U) | ip[3];
+}
+
+/**
+ * @brief Compile a CIDR or "any" string into a host-order network and mask.
+ *
+ * @param cidr     CIDR string ("x.x.x.x/y" or "any").
+ * @param net_out  Receives the network address.
+ * @param mask_out Receives the mask; 0 for "any".
+ * @return true if the string parsed, false if the rule can never match.
+ */
+static bool acl_compile_cidr(const char* cidr, uint32_t* net_out, uint32_t* mask_out) {
+  if (strcmp(cidr, ACL_CIDR_ANY) == 0) {
+    *net_out = 0U;
+    *mask_out = 0U;
+    return true;
+  }
+
+  uint8_t network[4];
+  uint8_t mask[4];
+  int prefix_len = 0;
+  uint8_t parsed_ip[4];
+  if (ipv4_parse_cidr(cidr, parsed_ip, network, mask, &prefix_len) != MAGI_OK) {
+    return false;
+  }
+
+  *net_out = acl_addr_word(network);
+  *mask_out = acl_addr_word(mask);
+  return true;
+}
+
+/**
+ * @brief Home slot of a prefix pair (multiplicative hash with a high-bit fold).
+ *
+ * @param tuple Tuple holding the slot array.
+ * @param key   Packed source and destination prefixes.
+ * @return Slot index.
+ */
+static size_t acl_tuple_home(const ACLTuple* tuple, uint64_t key) {
+  uint64_t hash = key * 0x9E3779B97F4A7C15ULL;
+  hash ^= hash >> 29U;
+  return (size_t)(hash & (uint64_t)(tuple->capacity - 1U));
+}
+
+/**
+ * @brief Find the bucket for a prefix pair, or the empty slot where it would go.
+ *
+ * @param tuple Tuple to search.
+ * @param key   Packed source and destination prefixes.
+ * @return Slot index.
+ */
+static size_t acl_tuple_probe(const ACLTuple* tuple, uint64_t key) {
+  size_t mask = tuple->capacity - 1U;
+  size_t pos = acl_tuple_home(tuple, key);
+  while (tuple->slots[pos].used && tuple->slots[pos].key != key) {
+    pos = (pos + 1U) & mask;
+  }
+  return pos;
+}
+
+/**
+ * @brief Double a tuple's slot array and rehash its buckets.
+ *
+ * @param tuple Tuple to grow.
+ * @return MAGI_OK on success, or MAGI_ERR_NOMEM.
+ */
+static int acl_tuple_grow(ACLTuple* tuple) {
+  size_t new_cap = tuple->capacity * 2U;
+  ACLBucket* slots = calloc(new_cap, sizeof(*slots));
+  if (slots == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
+  }
+
+  ACLBucket* old = tuple->slots;
+  size_t old_cap = tuple->capacity;
+  tuple->slots = slots;
+  tuple->capacity = new_cap;
+  for (size_t index = 0U; index < old_cap; ++index) {
+    if (old[index].used) {
+      tuple->slots[acl_tuple_probe(tuple, old[index].key)] = old[index];
+    }
+  }
+
+  free(old);
+  return MAGI_OK;
+}
+
+/**
+ * @brief Find or create the tuple for a pair of masks.
+ *
+ * A new tuple's first rule is the rule being added, which is the highest
+ * id so far, so appending keeps the tuples sorted on first_rule.
+ *
+ * @param cls      Classifier.
+ * @param src_mask Source mask.
+ * @param dst_mask Destination mask.
+ * @param rule_id  Rule being added.
+ * @return Tuple, or NULL on allocation failure.
+ */
+static ACLTuple* acl_classifier_tuple(struct ACLClassifier* cls, uint32_t src_mask,
+                                      uint32_t dst_mask, uint32_t rule_id) {
+  for (size_t index = 0U; index < cls->tuple_count; ++index) {
+    if (cls->tuples[index].src_mask == src_mask && cls->tuples[index].dst_mask == dst_mask) {
+      return &cls->tuples[index];
+    }
+  }
+
+  if (cls->tuple_count == cls->tuple_capacity) {
+    size_t new_cap = cls->tuple_capacity != 0U ? cls->tuple_capacity * 2U : 4U;
+    ACLTuple* tuples = realloc(cls->tuples, new_cap * sizeof(*tuples));
+    if (tuples == NULL) {
+      magi_errno = MAGI_ERR_NOMEM;
+      return NULL;
+    }
+    cls->tuples = tuples;
+    cls->tuple_capacity = new_cap;
+  }
+
+  ACLBucket* slots = calloc(ACL_TUPLE_MIN_SLOTS, sizeof(*slots));
+  if (slots == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+  ACLTuple* tuple = &cls->tuples[cls->tuple_count++];
+  *tuple = (ACLTuple){.src_mask = src_mask,
+                      .dst_mask = dst_mask,
+                      .first_rule = rule_id,
+                      .slots = slots,
+                      .capacity = ACL_TUPLE_MIN_SLOTS};
+  return tuple;
+}
+
+/**
+ * @brief Compile a rule and file it in the classifier.
+ *
+ * Rules arrive in id order, so appending to a bucket's chain keeps every
+ * chain sorted. A rule whose CIDR does not parse is compiled but filed
+ * nowhere: it never matches, as before.
+ *
+ * @param cls  Classifier with room for rule->rule_id in matches.
+ * @param rule Rule to add.
+ * @return MAGI_OK on success, or MAGI_ERR_NOMEM.
+ */
+static int acl_classifier_add(struct ACLClassifier* cls, const ACLRule* rule) {
+  uint32_t src_mask = 0U;
+  uint32_t dst_mask = 0U;
+  ACLMatch* match = &cls->matches[rule->rule_id];
+  *match = (ACLMatch){
+      .src_port_lo = rule->src_port,
+      .src_port_hi = rule->src_port != ACL_PORT_ANY ? rule->src_port : UINT16_MAX,
+      .dst_port_lo = rule->dst_port,
+      .dst_port_hi = rule->dst_port != ACL_PORT_ANY ? rule->dst_port : UINT16_MAX,
+      .protocol = rule->protocol,
+      .permit = rule->permit,
+      .next = ACL_NO_RULE,
+  };
+  if (!acl_compile_cidr(rule->src_cidr, &match->src_net, &src_mask) ||
+      !acl_compile_cidr(rule->dst_cidr, &match->dst_net, &dst_mask)) {
+    return MAGI_OK;
+  }
+
+  ACLTuple* tuple = acl_classifier_tuple(cls, src_mask, dst_mask, rule->rule_id);
+  if (tuple == NULL) {
+    return MAGI_ERR_NOMEM;
+  }
+
+  uint64_t key = ((uint64_t)match->src_net << 32U) | match->dst_net;
+  size_t pos = acl_tuple_probe(tuple, key);
+  if (tuple->slots[pos].used) {
+    cls->matches[tuple->slots[pos].tail].next = rule->rule_id;
+    tuple->slots[pos].tail = rule->rule_id;
+    return MAGI_OK;
+  }
+
+  if ((tuple->count + 1U) * 4U > tuple->capacity * 3U) {
+    if (acl_tuple_grow(tuple) != MAGI_OK) {
+      return MAGI_ERR_NOMEM;
+    }
+    pos = acl_tuple_probe(tuple, key);
+  }
+  tuple->slots[pos] =
+      (ACLBucket){.key = key, .head = rule->rule_id, .tail = rule->rule_id, .used = true};
+  tuple->count++;
+  return MAGI_OK;
+}
+
+/**
+ * @brief Find the first rule matching a packet.
+ *
+ * @param cls      Classifier.
+ * @param src      Source address, host order.
+ * @param dst      Destination address, host order.
+ * @param protocol IP protocol.
+ * @param ports    Whether the packet carries TCP/UDP ports to check.
+ * @param sport    Source port, 0 if the header is truncated.
+ * @param dport    Destination port, 0 if the header is truncated.
+ * @return Rule id, or ACL_NO_RULE.
+ */
+static uint32_t acl_classifier_find(const struct ACLClassifier* cls, uint32_t src, uint32_t dst,
+                                    uint8_t protocol, bool ports, uint16_t sport,
+                                    uint16_t dport) {
+  uint32_t best = ACL_NO_RULE;
+  for (size_t index = 0U; index < cls->tuple_count; ++index) {
+    const ACLTuple* tuple = &cls->tuples[index];
+    if (tuple->first_rule >= best) {
+      break; /* Every later tuple starts later still */
+    }
+
+    uint64_t key = ((uint64_t)(src & tuple->src_mask) << 32U) | (dst & tuple->dst_mask);
+    const ACLBucket* bucket = &tuple->slots[acl_tuple_probe(tuple, key)];
+    if (!bucket->used) {
+      continue;
+    }
+    for (uint32_t id = bucket->head; id != ACL_NO_RULE && id < best;) {
+      const ACLMatch* match = &cls->matches[id];
+      if ((match->protocol == ACL_PROTO_ANY || match->protocol == protocol) &&
+          (!ports || (sport >= match->src_port_lo && sport <= match->src_port_hi &&
+                      dport >= match->dst_port_lo && dport <= match->dst_port_hi))) {
+        best = id;
+        break;
+      }
+      id = match->next;
+    }
+  }
+  return best;
+}
 
 ACLTable* acl_table_new(void) {
   ACLTable* t = calloc(1U, sizeof(*t));
@@ -20,7 +319,12 @@ ACLTable* acl_table_new(void) {
   }
 
   t->rules = calloc(ACL_INITIAL_CAPACITY, sizeof(ACLRule));
-  if (t->rules == NULL) {
+  t->classifier = calloc(1U, sizeof(*t->classifier));
+  if (t->rules == NULL || t->classifier == NULL ||
+      magi_counters_init(&t->counters, 2U * ACL_INITIAL_CAPACITY) != MAGI_OK) {
+    magi_counters_free(&t->counters);
+    free(t->rules);
+    free(t->classifier);
     free(t);
     magi_errno = MAGI_ERR_NOMEM;
     return NULL;
@@ -36,19 +340,44 @@ void acl_table_free(ACLTable* t) {
     return;
   }
 
+  acl_classifier_free(t->classifier);
+  magi_counters_free(&t->counters);
   free(t->rules);
   free(t);
 }
 
+/**
+ * @brief Resize the per-rule counters, carrying the current values over.
+ *
+ * @param t     ACL table.
+ * @param rules Rule capacity to cover.
+ * @return MAGI_OK on success, or MAGI_ERR_NOMEM.
+ */
+static int acl_counters_grow(ACLTable* t, size_t rules) {
+  MagiCounters counters = {0};
+  if (magi_counters_init(&counters, 2U * rules) != MAGI_OK) {
+    return MAGI_ERR_NOMEM;
+  }
+  for (size_t index = 0U; index < 2U * t->count; ++index) {
+    magi_counter_add(&counters, index, magi_counter_read(&t->counters, index));
+  }
+  magi_counters_free(&t->counters);
+  t->counters = counters;
+  return MAGI_OK;
+}
+
 int acl_add_rule(ACLTable* t, ACLRule rule) {
   if (t == NULL) {
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
-  /* Grow the array if full */
+  /* Grow the array if full; capacity only moves once rules and counters both fit */
   if (t->count >= t->capacity) {
     size_t new_cap = t->capacity * 2U;
+    if (acl_counters_grow(t, new_cap) != MAGI_OK) {
+      return MAGI_ERR_NOMEM;
+    }
     ACLRule* new_rules = realloc(t->rules, new_cap * sizeof(ACLRule));
     if (new_rules == NULL) {
       magi_errno = MAGI_ERR_NOMEM;
@@ -58,7 +387,23 @@ int acl_add_rule(ACLTable* t, ACLRule rule) {
     t->capacity = new_cap;
   }
 
+  struct ACLClassifier* cls = t->classifier;
+  if (cls->match_capacity < t->capacity) {
+    ACLMatch* matches = realloc(cls->matches, t->capacity * sizeof(*matches));
+    if (matches == NULL) {
+      magi_errno = MAGI_ERR_NOMEM;
+      return MAGI_ERR_NOMEM;
+    }
+    cls->matches = matches;
+    cls->match_capacity = t->capacity;
+  }
+
+  rule.src_cidr[ACL_CIDR_LEN - 1U] = '\0';
+  rule.dst_cidr[ACL_CIDR_LEN - 1U] = '\0';
   rule.rule_id = (uint32_t)t->count;
+  if (acl_classifier_add(cls, &rule) != MAGI_OK) {
+    return MAGI_ERR_NOMEM;
+  }
   t->rules[t->count] = rule;
   t->count++;
   return MAGI_OK;
@@ -68,35 +413,28 @@ void acl_clear(ACLTable* t) {
   if (t == NULL) {
     return;
   }
-  t->count = 0U;
-}
 
-/**
- * @brief Test whether an IP address matches a CIDR or "any" string.
- *
- * @param ip    4-byte IP address.
- * @param cidr  CIDR string ("x.x.x.x/y" or "any").
- * @return true if the IP matches the CIDR range, false otherwise.
- */
-static bool acl_ip_matches_cidr(const uint8_t ip[4], const char* cidr) {
-  if (ip == NULL || cidr == NULL) {
-    return false;
+  struct ACLClassifier* cls = t->classifier;
+  for (size_t index = 0U; index < cls->tuple_count; ++index) {
+    free(cls->tuples[index].slots);
   }
+  cls->tuple_count = 0U;
+  magi_counters_reset(&t->counters);
+  t->count = 0U;
+}
 
-  if (strcmp(cidr, ACL_CIDR_ANY) == 0) {
-    return true;
+uint64_t acl_rule_hits(const ACLTable* t, uint32_t rule_id, uint64_t* bytes) {
+  if (t == NULL || rule_id >= t->count) {
+    if (bytes != NULL) {
+      *bytes = 0U;
+    }
+    return 0U;
   }
 
-  uint8_t network[4];
-  uint8_t mask[4];
-  int prefix_len = 0;
-  uint8_t parsed_ip[4];
-
-  if (ipv4_parse_cidr(cidr, parsed_ip, network, mask, &prefix_len) != MAGI_OK) {
-    return false;
+  if (bytes != NULL) {
+    *bytes = magi_counter_read(&t->counters, 2U * rule_id + 1U);
   }
-
-  return ipv4_addr_in_network(ip, network, mask);
+  return magi_counter_read(&t->counters, 2U * rule_id);
 }
 
 /**
@@ -134,60 +472,34 @@ uint8_t acl_parse_protocol(const char* text) {
   return 0xFF; /* invalid */
 }
 
-int acl_check(const ACLTable* t, const struct IPv4Packet* pkt) {
+int acl_check(ACLTable* t, const struct IPv4Packet* pkt) {
   if (t == NULL || pkt == NULL) {
     return MAGI_OK; /* No ACL → permit */
   }
 
-  for (size_t i = 0U; i < t->count; i++) {
-    const ACLRule* rule = &t->rules[i];
-
-    /* Check source CIDR */
-    if (!acl_ip_matches_cidr(pkt->src_ip, rule->src_cidr)) {
-      continue;
-    }
-
-    /* Check destination CIDR */
-    if (!acl_ip_matches_cidr(pkt->dst_ip, rule->dst_cidr)) {
-      continue;
+  /* Ports are only meaningful for TCP/UDP; a truncated header reads as port 0 */
+  bool ports = pkt->protocol == IPV4_PROTOCOL_TCP || pkt->protocol == IPV4_PROTOCOL_UDP;
+  uint16_t sport = 0U;
+  uint16_t dport = 0U;
+  if (ports && pkt->payload != NULL) {
+    if (pkt->payload_len >= 2U) {
+      sport = (uint16_t)((uint16_t)pkt->payload[0] << 8) | pkt->payload[1];
     }
-
-    /* Check protocol */
-    if (rule->protocol != ACL_PROTO_ANY && rule->protocol != pkt->protocol) {
-      continue;
-    }
-
-    /* Check source port (only meaningful for TCP/UDP) */
-    if (rule->src_port != ACL_PORT_ANY &&
-        (pkt->protocol == IPV4_PROTOCOL_TCP || pkt->protocol == IPV4_PROTOCOL_UDP)) {
-      /* Extract source port from transport header (first 2 bytes) */
-      uint16_t port = 0;
-      if (pkt->payload_len >= 2U && pkt->payload != NULL) {
-        port = (uint16_t)((uint16_t)pkt->payload[0] << 8) | pkt->payload[1];
-      }
-      if (port != rule->src_port) {
-        continue;
-      }
-    }
-
-    /* Check destination port (only meaningful for TCP/UDP) */
-    if (rule->dst_port != ACL_PORT_ANY &&
-        (pkt->protocol == IPV4_PROTOCOL_TCP || pkt->protocol == IPV4_PROTOCOL_UDP)) {
-      uint16_t port = 0;
-      if (pkt->payload_len >= 4U && pkt->payload != NULL) {
-        port = (uint16_t)((uint16_t)pkt->payload[2] << 8) | pkt->payload[3];
-      }
-      if (port != rule->dst_port) {
-        continue;
-      }
+    if (pkt->payload_len >= 4U) {
+      dport = (uint16_t)((uint16_t)pkt->payload[2] << 8) | pkt->payload[3];
     }
+  }
 
-    /* Rule matched — return its action */
-    return rule->permit ? MAGI_OK : MAGI_ERR_ACL_DENY;
+  uint32_t id = acl_classifier_find(t->classifier, acl_addr_word(pkt->src_ip),
+                                    acl_addr_word(pkt->dst_ip), pkt->protocol, ports, sport, dport);
+  if (id == ACL_NO_RULE) {
+    return MAGI_OK; /* No rule matched — default permit */
   }
 
-  /* No rule matched — default permit */
-  return MAGI_OK;
+  /* Rule matched — count it and return its action */
+  magi_counter_add(&t->counters, 2U * id, 1U);
+  magi_counter_add(&t->counters, 2U * id + 1U, pkt->total_len);
+  return t->classifier->matches[id].permit ? MAGI_OK : MAGI_ERR_ACL_DENY;
 }
 
 void acl_print(const ACLTable* t, const char* name) {
@@ -229,7 +541,10 @@ void acl_print(const ACLTable* t, const char* name) {
         break;
     }
 
-    LOG(prefix, "ACL #%u: %s %s %s %s", (unsigned)rule->rule_id, action, rule->src_cidr,
-        rule->dst_cidr, proto_str);
+    uint64_t bytes = 0U;
+    uint64_t hits = acl_rule_hits(t, rule->rule_id, &bytes);
+    LOG(prefix, "ACL #%u: %s %s %s %s (hits=%llu bytes=%llu)", (unsigned)rule->rule_id, action,
+        rule->src_cidr, rule->dst_cidr, proto_str, (unsigned long long)hits,
+        (unsigned long long)bytes);
   }
 }
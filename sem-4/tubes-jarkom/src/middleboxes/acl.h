@@ -4,6 +4,13 @@
  *
  * ACL rules are evaluated in order. The first matching rule wins.
  * If no rule matches, the default action is PERMIT.
+ *
+ * acl_add_rule() compiles each rule into binary prefixes and port ranges
+ * and files it in a tuple-space classifier: one hash table per distinct
+ * (source prefix length, destination prefix length) pair. acl_check()
+ * probes the tuples in order of their earliest rule and stops once no
+ * remaining tuple can beat the best match, so a few hundred rules cost a
+ * handful of hash probes rather than a walk over every rule.
  */
 
 #ifndef MAGI_MIDDLEBOXES_ACL_H
@@ -13,7 +20,10 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "core/stats.h"
+
 struct IPv4Packet;
+struct ACLClassifier;
 
 #define ACL_CIDR_ANY "any"
 #define ACL_CIDR_LEN 20U
@@ -40,6 +50,10 @@ typedef struct ACLTable {
   ACLRule* rules;
   size_t count;
   size_t capacity;
+  /** Compiled form of rules, kept in step by acl_add_rule() and acl_clear(). */
+  struct ACLClassifier* classifier;
+  /** Per rule: packets matched at 2 * rule_id, bytes at 2 * rule_id + 1. */
+  MagiCounters counters;
 } ACLTable;
 
 /**
@@ -70,14 +84,25 @@ int acl_add_rule(ACLTable* t, ACLRule rule);
 /**
  * @brief Check an IPv4 packet against the ACL table.
  *
- * Evaluates rules in order. The first matching rule's action is returned.
- * If no rule matches, the default action is PERMIT (MAGI_OK).
+ * The first matching rule's action is returned and the packet is counted
+ * against that rule. If no rule matches, the default action is PERMIT
+ * (MAGI_OK).
  *
  * @param t   ACL table. If NULL, all packets pass.
  * @param pkt Parsed IPv4 packet to check.
  * @return MAGI_OK if permitted, MAGI_ERR_ACL_DENY if denied.
  */
-int acl_check(const ACLTable* t, const struct IPv4Packet* pkt);
+int acl_check(ACLTable* t, const struct IPv4Packet* pkt);
+
+/**
+ * @brief Read a rule's match counters.
+ *
+ * @param t       ACL table.
+ * @param rule_id Rule index.
+ * @param bytes   Optional; receives the IPv4 bytes of the matched packets.
+ * @return Packets matched by the rule, or 0 for an unknown rule.
+ */
+uint64_t acl_rule_hits(const ACLTable* t, uint32_t rule_id, uint64_t* bytes);
 
 /**
  * @brief Parse a protocol name or number from a string.
@@ -91,14 +116,14 @@ int acl_check(const ACLTable* t, const struct IPv4Packet* pkt);
 uint8_t acl_parse_protocol(const char* text);
 
 /**
- * @brief Remove all rules from an ACL table.
+ * @brief Remove all rules from an ACL table and zero the counters.
  *
  * @param t ACL table to clear. NULL is allowed.
  */
 void acl_clear(ACLTable* t);
 
 /**
- * @brief Print all rules in an ACL table via LOG().
+ * @brief Print all rules in an ACL table, with their hit and byte counts, via LOG().
  *
  * @param t   ACL table to display.
  * @param name Router name for log prefix.
@@ -1,468 +1,885 @@
 #define _POSIX_C_SOURCE 200809L
+#define MAGI_LOG_SUBSYS MAGI_LOG_L3
 
 #include "nat.h"
 
+#include "core/sim.h"
 #include "layer3/ipv4.h"
 #include "utils/byteops.h"
-#include "utils/hashmap.h"
 #include "utils/log.h"
 #include "utils/magi_error.h"
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define IPV4_PSEUDO_HDR_LEN 12U
 #define ICMP_HEADER_MIN_LEN 8U
 #define ICMP_CKSUM_OFF 2U
 #define ICMP_ID_OFF 4U
-#define NAT_INITIAL_CAPACITY 16U
+#define TCP_HEADER_MIN_LEN 20U
+#define TCP_FLAGS_OFF 13U
+#define TCP_CKSUM_OFF 16U
+#define UDP_HEADER_MIN_LEN 8U
+#define UDP_CKSUM_OFF 6U
+
+#define NAT_TCP_FIN 0x01U
+#define NAT_TCP_SYN 0x02U
+#define NAT_TCP_RST 0x04U
+#define NAT_TCP_ACK 0x10U
+
+#define NAT_INDEX_MIN_CAPACITY 64U
+#define NAT_SLAB_MIN_CAPACITY 32U
+/** Slab slots checked for expiry each time a flow is created. */
+#define NAT_SWEEP_STEP 4U
+#define NAT_PORT_WORDS (65536U / 64U)
+#define NAT_NONE UINT32_MAX
+
+/** @brief TCP progress, just enough to pick an idle timeout. */
+typedef enum NATTcpState {
+  NAT_TCP_SYN_SENT,
+  NAT_TCP_ESTABLISHED,
+  NAT_TCP_CLOSING,
+  NAT_TCP_CLOSED,
+} NATTcpState;
+
+#define NAT_FIN_ORIG 0x01U
+#define NAT_FIN_REPLY 0x02U
+
+/** @brief Binary 5-tuple; ICMP queries use the identifier as both ports. */
+typedef struct NATTuple {
+  /** Source address in the high half, destination in the low half, host order. */
+  uint64_t addrs;
+  /** Source port in the high half, destination port in the low half. */
+  uint32_t ports;
+  uint8_t proto;
+} NATTuple;
+
+/** @brief One open-addressing slot; ref 0 marks it empty. */
+typedef struct NATSlot {
+  NATTuple key;
+  uint32_t ref;
+} NATSlot;
+
+/** @brief Open-addressing index from tuple to slab reference. */
+typedef struct NATIndex {
+  NATSlot* slots;
+  size_t capacity;
+  size_t count;
+} NATIndex;
+
+/** @brief One tracked connection. */
+typedef struct NATFlow {
+  /** As sent by the private host: private → remote. */
+  NATTuple orig;
+  /** As the replies arrive: remote → public address and port. */
+  NATTuple reply;
+  uint64_t last_seen_ns;
+  uint32_t mapping;
+  uint32_t next_free;
+  uint8_t tcp_state;
+  uint8_t fins;
+  bool live;
+} NATFlow;
+
+/** @brief Public port held by one private endpoint. */
+typedef struct NATMapping {
+  /** Protocol, private address and port; the destination half is zero. */
+  NATTuple key;
+  /** Flows using the mapping; it is released when this drops to zero. */
+  uint32_t flows;
+  uint32_t next_free;
+  uint16_t public_port;
+} NATMapping;
+
+/** @brief Public port bitmap of one protocol. */
+typedef struct NATPortMap {
+  /** One bit per port, set while mapped; ports below NAT_MIN_PORT stay set. */
+  uint64_t used[NAT_PORT_WORDS];
+  /** Port where the next search starts. */
+  uint32_t cursor;
+} NATPortMap;
+
+struct NATConntrack {
+  /** Orig and reply tuples of every flow; ref = flow * 2 + direction + 1. */
+  NATIndex flow_index;
+  /** Private endpoints; ref = mapping + 1. */
+  NATIndex mapping_index;
+  NATFlow* flows;
+  size_t flow_capacity;
+  size_t flow_count;
+  uint32_t flow_free;
+  NATMapping* mappings;
+  size_t mapping_capacity;
+  size_t mapping_count;
+  uint32_t mapping_free;
+  /** Next flow slot the incremental sweep looks at. */
+  size_t sweep_cursor;
+  NATPortMap ports[3];
+  uint64_t created;
+  uint64_t expired;
+  uint64_t no_port;
+  uint64_t no_session;
+};
+
+/* ─── Tuples and the index ─── */
 
-/* ─── Key building helpers ─── */
+/**
+ * @brief Build a tuple from addresses and ports.
+ *
+ * @param proto IP protocol number.
+ * @param src   Source address.
+ * @param sport Source port or ICMP identifier.
+ * @param dst   Destination address.
+ * @param dport Destination port or ICMP identifier.
+ * @return Packed tuple.
+ */
+static NATTuple nat_tuple(uint8_t proto, const uint8_t src[4], uint16_t sport,
+                          const uint8_t dst[4], uint16_t dport) {
+  return (NATTuple){.addrs = ((uint64_t)READ_U32(src, 0U) << 32U) | READ_U32(dst, 0U),
+                    .ports = ((uint32_t)sport << 16U) | dport,
+                    .proto = proto};
+}
 
 /**
- * @brief Build a forward-map key: "proto:pub_port"
+ * @brief Compare two tuples.
+ *
+ * @return true if every field matches.
  */
-static void nat_fwd_key(uint8_t protocol, uint16_t pub_port, char out[24]) {
-  snprintf(out, 24U, "%u:%u", (unsigned)protocol, (unsigned)pub_port);
+static bool nat_tuple_equal(const NATTuple* a, const NATTuple* b) {
+  return a->addrs == b->addrs && a->ports == b->ports && a->proto == b->proto;
 }
 
 /**
- * @brief Build a reverse-map key: "proto:priv_ip:priv_port"
+ * @brief Home slot for a tuple (multiplicative hash with a high-bit fold).
+ *
+ * The addresses are mixed before the ports go in: XOR-ing the two halves
+ * directly lets a host's address cancel against its port.
+ *
+ * @param index Index.
+ * @param key   Tuple.
+ * @return Slot index.
  */
-static void nat_rev_key(uint8_t protocol, const uint8_t priv_ip[4], uint16_t priv_port,
-                        char out[32]) {
-  char ip_str[16];
-  ipv4_address_to_string(priv_ip, ip_str);
-  snprintf(out, 32U, "%u:%s:%u", (unsigned)protocol, ip_str, (unsigned)priv_port);
+static size_t nat_index_home(const NATIndex* index, const NATTuple* key) {
+  uint64_t hash = key->addrs * 0x9E3779B97F4A7C15ULL;
+  hash ^= ((uint64_t)key->proto << 32U) | key->ports;
+  hash *= 0x9E3779B97F4A7C15ULL;
+  hash ^= hash >> 29U;
+  return (size_t)(hash & (uint64_t)(index->capacity - 1U));
 }
 
 /**
- * @brief Free a NATEntry (hashmap_foreach callback).
+ * @brief Find the slot holding a tuple, or the empty slot where it would go.
+ *
+ * @param index Index.
+ * @param key   Tuple.
+ * @return Slot index.
  */
-static void free_nat_entry(const char* key, void* value, void* ctx) {
-  (void)key;
-  (void)ctx;
-  free(value);
+static size_t nat_index_probe(const NATIndex* index, const NATTuple* key) {
+  size_t mask = index->capacity - 1U;
+  size_t pos = nat_index_home(index, key);
+  while (index->slots[pos].ref != 0U && !nat_tuple_equal(&index->slots[pos].key, key)) {
+    pos = (pos + 1U) & mask;
+  }
+  return pos;
 }
 
-/* ─── Public API ─── */
+/**
+ * @brief Look up a tuple.
+ *
+ * @param index Index.
+ * @param key   Tuple.
+ * @return Slab reference, or 0 if absent.
+ */
+static uint32_t nat_index_find(const NATIndex* index, const NATTuple* key) {
+  return index->slots[nat_index_probe(index, key)].ref;
+}
 
-NATTable* nat_table_new(const uint8_t public_ip[4]) {
-  if (public_ip == NULL) {
-    magi_errno = MAGI_ERR_BADARGS;
-    return NULL;
+/**
+ * @brief Make room for extra entries, so the inserts that follow cannot fail.
+ *
+ * Doubles the slot array and rehashes until the index would stay under 75% load.
+ *
+ * @param index Index.
+ * @param extra Entries about to be inserted.
+ * @return MAGI_OK on success, or MAGI_ERR_NOMEM.
+ */
+static int nat_index_reserve(NATIndex* index, size_t extra) {
+  size_t new_cap = index->capacity;
+  while ((index->count + extra) * 4U > new_cap * 3U) {
+    new_cap *= 2U;
+  }
+  if (new_cap == index->capacity) {
+    return MAGI_OK;
   }
 
-  NATTable* t = calloc(1U, sizeof(*t));
-  if (t == NULL) {
+  NATSlot* slots = calloc(new_cap, sizeof(*slots));
+  if (slots == NULL) {
     magi_errno = MAGI_ERR_NOMEM;
-    return NULL;
+    return MAGI_ERR_NOMEM;
   }
 
-  memcpy(t->public_ip, public_ip, 4U);
-  t->forward = hashmap_new(NAT_INITIAL_CAPACITY);
-  t->reverse = hashmap_new(NAT_INITIAL_CAPACITY);
-  t->next_port = NAT_MIN_PORT;
-
-  if (t->forward == NULL || t->reverse == NULL) {
-    hashmap_free(t->forward);
-    hashmap_free(t->reverse);
-    free(t);
-    magi_errno = MAGI_ERR_NOMEM;
-    return NULL;
+  NATSlot* old = index->slots;
+  size_t old_cap = index->capacity;
+  index->slots = slots;
+  index->capacity = new_cap;
+  for (size_t pos = 0U; pos < old_cap; ++pos) {
+    if (old[pos].ref != 0U) {
+      index->slots[nat_index_probe(index, &old[pos].key)] = old[pos];
+    }
   }
+  free(old);
+  return MAGI_OK;
+}
 
-  return t;
+/**
+ * @brief Insert a tuple known to be absent; room must have been reserved.
+ *
+ * @param index Index.
+ * @param key   Tuple.
+ * @param ref   Slab reference, non-zero.
+ */
+static void nat_index_insert(NATIndex* index, const NATTuple* key, uint32_t ref) {
+  index->slots[nat_index_probe(index, key)] = (NATSlot){.key = *key, .ref = ref};
+  index->count++;
 }
 
-void nat_table_free(NATTable* t) {
-  if (t == NULL) {
+/**
+ * @brief Remove a tuple if present.
+ *
+ * @param index Index.
+ * @param key   Tuple.
+ */
+static void nat_index_remove(NATIndex* index, const NATTuple* key) {
+  size_t pos = nat_index_probe(index, key);
+  if (index->slots[pos].ref == 0U) {
     return;
   }
 
-  hashmap_foreach(t->forward, free_nat_entry, NULL);
-  hashmap_free(t->forward);
-  hashmap_free(t->reverse);
-  free(t);
+  /* Backward-shift deletion keeps every probe chain unbroken. */
+  size_t mask = index->capacity - 1U;
+  size_t hole = pos;
+  size_t next = (pos + 1U) & mask;
+  while (index->slots[next].ref != 0U) {
+    size_t home = nat_index_home(index, &index->slots[next].key);
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      index->slots[hole] = index->slots[next];
+      hole = next;
+    }
+    next = (next + 1U) & mask;
+  }
+  index->slots[hole].ref = 0U;
+  index->count--;
 }
 
+/* ─── Public ports ─── */
+
 /**
- * @brief Allocate a new public port and create a session entry.
+ * @brief Port bitmap for a protocol.
  *
- * @param t         NAT table.
- * @param protocol  IP protocol number.
- * @param priv_ip   Private IP address.
- * @param priv_port Private port (0 for ICMP).
- * @param entry_out Output for the allocated entry.
- * @return MAGI_OK on success, MAGI_ERR_PORTUSED if ports exhausted.
+ * @param ct    Conntrack state.
+ * @param proto NAT_PROTO_ICMP, NAT_PROTO_TCP or NAT_PROTO_UDP.
+ * @return Bitmap.
+ */
+static NATPortMap* nat_port_map(struct NATConntrack* ct, uint8_t proto) {
+  if (proto == NAT_PROTO_ICMP) {
+    return &ct->ports[0];
+  }
+  return proto == NAT_PROTO_TCP ? &ct->ports[1] : &ct->ports[2];
+}
+
+/**
+ * @brief Take the next free public port at or after the cursor.
+ *
+ * Scans a 64-port word at a time and wraps once around the space.
+ *
+ * @param map      Port bitmap.
+ * @param port_out Receives the port.
+ * @return true if a port was free.
  */
-static int nat_allocate_port(NATTable* t, uint8_t protocol, const uint8_t priv_ip[4],
-                             uint16_t priv_port, NATEntry** entry_out) {
-  uint16_t start = t->next_port;
-  uint16_t port = start;
-
-  do {
-    char fwd_key[24];
-    nat_fwd_key(protocol, port, fwd_key);
-
-    if (hashmap_get(t->forward, fwd_key) == NULL) {
-      /* Port available — allocate */
-      NATEntry* entry = calloc(1U, sizeof(*entry));
-      if (entry == NULL) {
-        magi_errno = MAGI_ERR_NOMEM;
-        return MAGI_ERR_NOMEM;
-      }
-
-      memcpy(entry->private_ip, priv_ip, 4U);
-      entry->private_port = priv_port;
-      entry->public_port = port;
-      entry->protocol = protocol;
-
-      char rev_key[32];
-      nat_rev_key(protocol, priv_ip, priv_port, rev_key);
-      nat_fwd_key(protocol, port, fwd_key);
-
-      if (hashmap_set(t->forward, fwd_key, entry) != MAGI_OK ||
-          hashmap_set(t->reverse, rev_key, entry) != MAGI_OK) {
-        free(entry);
-        magi_errno = MAGI_ERR_NOMEM;
-        return MAGI_ERR_NOMEM;
-      }
-
-      t->next_port = port >= NAT_MAX_PORT ? NAT_MIN_PORT : (uint16_t)(port + 1U);
-      *entry_out = entry;
-      return MAGI_OK;
+static bool nat_port_take(NATPortMap* map, uint16_t* port_out) {
+  uint32_t first_word = map->cursor / 64U;
+  uint64_t start_mask = ~0ULL << (map->cursor % 64U);
+  /* The extra pass revisits the first word for the ports below the cursor. */
+  for (uint32_t step = 0U; step <= NAT_PORT_WORDS; ++step) {
+    uint32_t word = (first_word + step) % NAT_PORT_WORDS;
+    uint64_t free_bits = ~map->used[word];
+    if (step == 0U) {
+      free_bits &= start_mask;
+    } else if (step == NAT_PORT_WORDS) {
+      free_bits &= ~start_mask;
+    }
+    if (free_bits == 0U) {
+      continue;
     }
 
-    port = port >= NAT_MAX_PORT ? NAT_MIN_PORT : (uint16_t)(port + 1U);
-  } while (port != start);
+    uint32_t port = word * 64U + (uint32_t)__builtin_ctzll(free_bits);
+    map->used[word] |= 1ULL << (port % 64U);
+    map->cursor = (port + 1U) % 65536U;
+    *port_out = (uint16_t)port;
+    return true;
+  }
+  return false;
+}
 
-  magi_errno = MAGI_ERR_PORTUSED;
-  return MAGI_ERR_PORTUSED;
+/**
+ * @brief Return a public port to the bitmap.
+ *
+ * @param map  Port bitmap.
+ * @param port Port to free.
+ */
+static void nat_port_give(NATPortMap* map, uint16_t port) {
+  map->used[port / 64U] &= ~(1ULL << (port % 64U));
 }
 
+/* ─── Slabs ─── */
+
 /**
- * @brief Recompute the IPv4 header checksum on the parsed struct fields only.
+ * @brief Make sure a free flow slot exists, doubling the slab if needed.
  *
- * NOTE: This function modifies pkt->checksum but does NOT modify any
- * serialized buffer. The checksum will be computed correctly when
- * ipv4_packet_to_bytes() / ipv4_pack() is called later to serialize
- * the packet for transmission. This avoids crashing on pkt->base.buf
- * which may be NULL when the packet was unpacked from raw bytes.
+ * @param ct Conntrack state.
+ * @return MAGI_OK on success, or MAGI_ERR_NOMEM.
  */
-static void nat_mark_ipv4_cksum_stale(IPv4Packet* pkt) {
-  if (pkt == NULL) {
-    return;
+static int nat_flow_reserve(struct NATConntrack* ct) {
+  if (ct->flow_free != NAT_NONE) {
+    return MAGI_OK;
+  }
+
+  size_t new_cap = ct->flow_capacity == 0U ? NAT_SLAB_MIN_CAPACITY : ct->flow_capacity * 2U;
+  NATFlow* flows = realloc(ct->flows, new_cap * sizeof(*flows));
+  if (flows == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
   }
-  /* Zero the checksum field so ipv4_pack() will recompute it. */
-  pkt->checksum = 0U;
+
+  /* Chain the new slots lowest first so the slab fills in order. */
+  for (size_t id = new_cap; id-- > ct->flow_capacity;) {
+    flows[id] = (NATFlow){.next_free = ct->flow_free};
+    ct->flow_free = (uint32_t)id;
+  }
+  ct->flows = flows;
+  ct->flow_capacity = new_cap;
+  return MAGI_OK;
 }
 
 /**
- * @brief Recompute the ICMP checksum in-place after modifying the identifier.
+ * @brief Make sure a free mapping slot exists, doubling the slab if needed.
  *
- * ICMP checksum covers only the ICMP message (header + data), with no
- * pseudo-header (unlike TCP/UDP). The checksum field is at byte offset 2.
+ * @param ct Conntrack state.
+ * @return MAGI_OK on success, or MAGI_ERR_NOMEM.
  */
-static void nat_recompute_icmp_cksum(uint8_t* icmp_msg, size_t icmp_len) {
-  if (icmp_msg == NULL || icmp_len < ICMP_HEADER_MIN_LEN) {
-    return;
+static int nat_mapping_reserve(struct NATConntrack* ct) {
+  if (ct->mapping_free != NAT_NONE) {
+    return MAGI_OK;
+  }
+
+  size_t new_cap =
+      ct->mapping_capacity == 0U ? NAT_SLAB_MIN_CAPACITY : ct->mapping_capacity * 2U;
+  NATMapping* mappings = realloc(ct->mappings, new_cap * sizeof(*mappings));
+  if (mappings == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return MAGI_ERR_NOMEM;
+  }
+
+  for (size_t id = new_cap; id-- > ct->mapping_capacity;) {
+    mappings[id] = (NATMapping){.next_free = ct->mapping_free};
+    ct->mapping_free = (uint32_t)id;
   }
-  WRITE_U16(icmp_msg, ICMP_CKSUM_OFF, 0U);
-  uint16_t cksum = ipv4_checksum(icmp_msg, icmp_len);
-  WRITE_U16(icmp_msg, ICMP_CKSUM_OFF, cksum);
+  ct->mappings = mappings;
+  ct->mapping_capacity = new_cap;
+  return MAGI_OK;
 }
 
+/* ─── Flow lifecycle ─── */
+
 /**
- * @brief Translate an outbound TCP or UDP packet (private → public).
+ * @brief Idle timeout that currently applies to a flow.
  *
- * Reads the source port from the transport header, creates or reuses a
- * NAT session, rewrites src_ip → public_ip and src_port → allocated public
- * port. Marks the IPv4 checksum as stale (will be recomputed during
- * serialization).
+ * @param t    NAT table.
+ * @param flow Flow.
+ * @return Timeout in nanoseconds.
  */
-static int nat_translate_out_tcp_udp(NATTable* t, IPv4Packet* pkt) {
-  uint16_t priv_port = READ_U16(pkt->payload, 0U);
-  uint16_t dst_port = READ_U16(pkt->payload, 2U);
-
-  /* Check if a reverse entry already exists (reuse session) */
-  char rev_key[32];
-  nat_rev_key(pkt->protocol, pkt->src_ip, priv_port, rev_key);
-  NATEntry* existing = hashmap_get(t->reverse, rev_key);
-
-  if (existing != NULL) {
-    /* Reuse existing session — just rewrite IP and port */
-    memcpy(pkt->src_ip, t->public_ip, 4U);
-    WRITE_U16((uint8_t*)pkt->payload, 0U, existing->public_port);
-    nat_mark_ipv4_cksum_stale(pkt);
-    return MAGI_OK;
+static uint64_t nat_flow_timeout_ns(const NATTable* t, const NATFlow* flow) {
+  uint32_t ms = t->timeouts.tcp_transitory_ms;
+  if (flow->orig.proto == NAT_PROTO_UDP) {
+    ms = t->timeouts.udp_ms;
+  } else if (flow->orig.proto == NAT_PROTO_ICMP) {
+    ms = t->timeouts.icmp_ms;
+  } else if (flow->tcp_state == NAT_TCP_ESTABLISHED) {
+    ms = t->timeouts.tcp_established_ms;
+  } else if (flow->tcp_state == NAT_TCP_CLOSED) {
+    ms = t->timeouts.tcp_closed_ms;
   }
+  return (uint64_t)ms * SIM_NS_PER_MS;
+}
 
-  /* Allocate new public port */
-  NATEntry* entry = NULL;
-  int status = nat_allocate_port(t, pkt->protocol, pkt->src_ip, priv_port, &entry);
-  if (status != MAGI_OK) {
-    char src_text[16], dst_text[16];
-    ipv4_address_to_string(pkt->src_ip, src_text);
-    ipv4_address_to_string(pkt->dst_ip, dst_text);
-    LOG("NAT", "Outbound %s:%u -> %s:%u: no ports available", src_text, (unsigned)priv_port,
-        dst_text, (unsigned)dst_port);
-    return status;
+/**
+ * @brief Drop a flow, and its mapping and public port if it was the last user.
+ *
+ * @param t  NAT table.
+ * @param id Flow slot.
+ */
+static void nat_flow_release(NATTable* t, uint32_t id) {
+  struct NATConntrack* ct = t->conntrack;
+  NATFlow* flow = &ct->flows[id];
+  nat_index_remove(&ct->flow_index, &flow->orig);
+  nat_index_remove(&ct->flow_index, &flow->reply);
+
+  NATMapping* mapping = &ct->mappings[flow->mapping];
+  if (--mapping->flows == 0U) {
+    nat_index_remove(&ct->mapping_index, &mapping->key);
+    nat_port_give(nat_port_map(ct, mapping->key.proto), mapping->public_port);
+    mapping->next_free = ct->mapping_free;
+    ct->mapping_free = flow->mapping;
+    ct->mapping_count--;
   }
 
-  /* Rewrite source IP and port */
-  memcpy(pkt->src_ip, t->public_ip, 4U);
-  WRITE_U16((uint8_t*)pkt->payload, 0U, entry->public_port);
-  nat_mark_ipv4_cksum_stale(pkt);
+  flow->live = false;
+  flow->next_free = ct->flow_free;
+  ct->flow_free = id;
+  ct->flow_count--;
+}
+
+/**
+ * @brief Expire idle flows among the next few slab slots.
+ *
+ * @param t      NAT table.
+ * @param now_ns Current time.
+ * @param budget Slab slots to examine.
+ * @return Number of flows removed.
+ */
+static size_t nat_sweep(NATTable* t, uint64_t now_ns, size_t budget) {
+  struct NATConntrack* ct = t->conntrack;
+  size_t removed = 0U;
+  for (size_t step = 0U; step < budget && ct->flow_count > 0U; ++step) {
+    size_t id = ct->sweep_cursor;
+    ct->sweep_cursor = (id + 1U) % ct->flow_capacity;
+    const NATFlow* flow = &ct->flows[id];
+    if (flow->live && now_ns - flow->last_seen_ns > nat_flow_timeout_ns(t, flow)) {
+      nat_flow_release(t, (uint32_t)id);
+      ct->expired++;
+      removed++;
+    }
+  }
+  return removed;
+}
 
-  {
-    char src_text[16], dst_text[16];
-    ipv4_address_to_string(pkt->src_ip, src_text);
-    ipv4_address_to_string(pkt->dst_ip, dst_text);
-    LOG("NAT", "Outbound %s:%u -> %s:%u mapped to port %u", src_text, (unsigned)priv_port,
-        dst_text, (unsigned)dst_port, (unsigned)entry->public_port);
+/**
+ * @brief Find the live flow a tuple belongs to, expiring it first if idle too long.
+ *
+ * @param t         NAT table.
+ * @param key       Tuple as seen on the wire.
+ * @param now_ns    Current time.
+ * @param reply_out Receives whether the tuple is the flow's reply direction.
+ * @return Flow slot, or NAT_NONE.
+ */
+static uint32_t nat_flow_lookup(NATTable* t, const NATTuple* key, uint64_t now_ns,
+                                bool* reply_out) {
+  struct NATConntrack* ct = t->conntrack;
+  uint32_t ref = nat_index_find(&ct->flow_index, key);
+  if (ref == 0U) {
+    return NAT_NONE;
   }
 
-  return MAGI_OK;
+  uint32_t id = (ref - 1U) / 2U;
+  if (now_ns - ct->flows[id].last_seen_ns > nat_flow_timeout_ns(t, &ct->flows[id])) {
+    nat_flow_release(t, id);
+    ct->expired++;
+    return NAT_NONE;
+  }
+  *reply_out = ((ref - 1U) & 1U) != 0U;
+  return id;
 }
 
 /**
- * @brief Translate an outbound ICMP Echo Request (private → public).
+ * @brief Create a flow for an outbound tuple, mapping its private endpoint if new.
+ *
+ * Everything that can fail is reserved before anything is committed, so a
+ * failure leaves the table unchanged. When the public ports are exhausted a
+ * full expiry sweep is tried before giving up.
  *
- * Uses the ICMP identifier (bytes 4-5 of the ICMP header) as a port
- * surrogate. Rewrites src_ip → public_ip and the ICMP identifier →
- * allocated public port so that inbound Echo Replies can be demultiplexed.
- * Recomputes the ICMP checksum since the identifier changed.
+ * @param t      NAT table.
+ * @param orig   Outbound tuple.
+ * @param now_ns Current time.
+ * @param id_out Receives the flow slot.
+ * @return MAGI_OK, MAGI_ERR_NOMEM or MAGI_ERR_PORTUSED.
  */
-static int nat_translate_out_icmp(NATTable* t, IPv4Packet* pkt) {
-  if (pkt->payload_len < ICMP_HEADER_MIN_LEN) {
-    magi_errno = MAGI_ERR_BADARGS;
-    return MAGI_ERR_BADARGS;
+static int nat_flow_create(NATTable* t, const NATTuple* orig, uint64_t now_ns,
+                           uint32_t* id_out) {
+  struct NATConntrack* ct = t->conntrack;
+  nat_sweep(t, now_ns, NAT_SWEEP_STEP);
+
+  if (nat_index_reserve(&ct->flow_index, 2U) != MAGI_OK ||
+      nat_index_reserve(&ct->mapping_index, 1U) != MAGI_OK || nat_flow_reserve(ct) != MAGI_OK ||
+      nat_mapping_reserve(ct) != MAGI_OK) {
+    return MAGI_ERR_NOMEM;
   }
 
-  uint16_t icmp_id = READ_U16(pkt->payload, ICMP_ID_OFF);
+  NATTuple endpoint = {.addrs = orig->addrs & 0xFFFFFFFF00000000ULL,
+                       .ports = orig->ports & 0xFFFF0000U,
+                       .proto = orig->proto};
+  uint32_t ref = nat_index_find(&ct->mapping_index, &endpoint);
+  uint32_t mapping_id = ref - 1U;
+  if (ref == 0U) {
+    NATPortMap* map = nat_port_map(ct, orig->proto);
+    uint16_t port = 0U;
+    if (!nat_port_take(map, &port) && (nat_expire(t) == 0U || !nat_port_take(map, &port))) {
+      ct->no_port++;
+      magi_errno = MAGI_ERR_PORTUSED;
+      return MAGI_ERR_PORTUSED;
+    }
+
+    mapping_id = ct->mapping_free;
+    NATMapping* mapping = &ct->mappings[mapping_id];
+    ct->mapping_free = mapping->next_free;
+    *mapping = (NATMapping){.key = endpoint, .public_port = port, .next_free = NAT_NONE};
+    nat_index_insert(&ct->mapping_index, &endpoint, mapping_id + 1U);
+    ct->mapping_count++;
+  }
 
-  /* Check if a reverse entry already exists (reuse session) */
-  char rev_key[32];
-  nat_rev_key(pkt->protocol, pkt->src_ip, icmp_id, rev_key);
-  NATEntry* existing = hashmap_get(t->reverse, rev_key);
+  NATMapping* mapping = &ct->mappings[mapping_id];
+  uint16_t pub = mapping->public_port;
+  uint16_t remote_port = (uint16_t)orig->ports;
+  uint32_t public_addr = READ_U32(t->public_ip, 0U);
+  /* Echo replies carry the rewritten identifier in place of both ports. */
+  uint32_t reply_ports = orig->proto == NAT_PROTO_ICMP
+                             ? ((uint32_t)pub << 16U) | pub
+                             : ((uint32_t)remote_port << 16U) | pub;
+
+  uint32_t id = ct->flow_free;
+  NATFlow* flow = &ct->flows[id];
+  ct->flow_free = flow->next_free;
+  *flow = (NATFlow){.orig = *orig,
+                    .reply = {.addrs = (orig->addrs << 32U) | public_addr,
+                              .ports = reply_ports,
+                              .proto = orig->proto},
+                    .last_seen_ns = now_ns,
+                    .mapping = mapping_id,
+                    .next_free = NAT_NONE,
+                    .tcp_state = NAT_TCP_SYN_SENT,
+                    .live = true};
+  nat_index_insert(&ct->flow_index, &flow->orig, id * 2U + 1U);
+  nat_index_insert(&ct->flow_index, &flow->reply, id * 2U + 2U);
+  mapping->flows++;
+  ct->flow_count++;
+  ct->created++;
+  *id_out = id;
+  return MAGI_OK;
+}
 
-  if (existing != NULL) {
-    /* Reuse existing session — rewrite src_ip and ICMP identifier */
-    memcpy(pkt->src_ip, t->public_ip, 4U);
-    WRITE_U16((uint8_t*)pkt->payload, ICMP_ID_OFF, existing->public_port);
-    nat_recompute_icmp_cksum((uint8_t*)pkt->payload, pkt->payload_len);
-    nat_mark_ipv4_cksum_stale(pkt);
-    return MAGI_OK;
+/**
+ * @brief Advance a TCP flow's state from the flags of one segment.
+ *
+ * A RST, or a FIN in each direction, closes the flow; it then lingers for
+ * the short closed timeout to absorb retransmissions and the final ACK.
+ * A fresh SYN from the private side on a closed flow reopens it.
+ *
+ * @param flow  Flow.
+ * @param pkt   TCP segment in its IPv4 packet.
+ * @param reply true if the segment came from the remote side.
+ */
+static void nat_tcp_track(NATFlow* flow, const IPv4Packet* pkt, bool reply) {
+  if (pkt->payload_len < TCP_HEADER_MIN_LEN) {
+    return;
   }
 
-  /* Allocate new public port */
-  NATEntry* entry = NULL;
-  int status = nat_allocate_port(t, pkt->protocol, pkt->src_ip, icmp_id, &entry);
-  if (status != MAGI_OK) {
-    char src_text[16];
-    ipv4_address_to_string(pkt->src_ip, src_text);
-    LOG("NAT", "Outbound ICMP %s id=%u: no ports available", src_text, (unsigned)icmp_id);
-    return status;
+  uint8_t flags = pkt->payload[TCP_FLAGS_OFF];
+  if ((flags & NAT_TCP_RST) != 0U) {
+    flow->tcp_state = NAT_TCP_CLOSED;
+  } else if (!reply && flow->tcp_state == NAT_TCP_CLOSED &&
+             (flags & (NAT_TCP_SYN | NAT_TCP_ACK)) == NAT_TCP_SYN) {
+    flow->tcp_state = NAT_TCP_SYN_SENT;
+    flow->fins = 0U;
+  } else if ((flags & NAT_TCP_FIN) != 0U) {
+    flow->fins |= reply ? NAT_FIN_REPLY : NAT_FIN_ORIG;
+    flow->tcp_state = flow->fins == (NAT_FIN_ORIG | NAT_FIN_REPLY) ? NAT_TCP_CLOSED
+                                                                   : NAT_TCP_CLOSING;
+  } else if (reply && flow->tcp_state == NAT_TCP_SYN_SENT) {
+    flow->tcp_state = NAT_TCP_ESTABLISHED;
   }
+}
 
-  /* Rewrite source IP and ICMP identifier */
-  memcpy(pkt->src_ip, t->public_ip, 4U);
-  WRITE_U16((uint8_t*)pkt->payload, ICMP_ID_OFF, entry->public_port);
-  nat_recompute_icmp_cksum((uint8_t*)pkt->payload, pkt->payload_len);
-  nat_mark_ipv4_cksum_stale(pkt);
+/* ─── Packet rewriting ─── */
 
-  {
-    char src_text[16];
-    ipv4_address_to_string(pkt->src_ip, src_text);
-    LOG("NAT", "Outbound ICMP %s id=%u mapped to port %u", src_text, (unsigned)icmp_id,
-        (unsigned)entry->public_port);
+/**
+ * @brief Rewrite one address and one port, patching every checksum that covers them.
+ *
+ * The IPv4 header checksum, the TCP and UDP checksums (whose pseudo-header
+ * holds the address) and the ICMP checksum (which covers only the
+ * identifier) are all updated per RFC 1624 instead of being recomputed.
+ * A UDP checksum of zero means "none" and is left alone.
+ *
+ * @param pkt      Packet to rewrite.
+ * @param addr     pkt->src_ip or pkt->dst_ip.
+ * @param new_addr Replacement address.
+ * @param port_off Offset of the port (or ICMP identifier) in the payload.
+ * @param new_port Replacement port.
+ */
+static void nat_rewrite(IPv4Packet* pkt, uint8_t addr[4], const uint8_t new_addr[4],
+                        size_t port_off, uint16_t new_port) {
+  uint8_t* l4 = (uint8_t*)pkt->payload;
+  uint32_t old_ip = READ_U32(addr, 0U);
+  uint32_t new_ip = READ_U32(new_addr, 0U);
+  uint16_t old_port = READ_U16(l4, port_off);
+  pkt->checksum = checksum_adjust32(pkt->checksum, old_ip, new_ip);
+
+  if (pkt->protocol == NAT_PROTO_TCP && pkt->payload_len >= TCP_HEADER_MIN_LEN) {
+    uint16_t cksum = checksum_adjust32(READ_U16(l4, TCP_CKSUM_OFF), old_ip, new_ip);
+    cksum = checksum_adjust16(cksum, old_port, new_port);
+    WRITE_U16(l4, TCP_CKSUM_OFF, cksum);
+  } else if (pkt->protocol == NAT_PROTO_UDP && pkt->payload_len >= UDP_HEADER_MIN_LEN &&
+             READ_U16(l4, UDP_CKSUM_OFF) != 0U) {
+    uint16_t cksum = checksum_adjust32(READ_U16(l4, UDP_CKSUM_OFF), old_ip, new_ip);
+    cksum = checksum_adjust16(cksum, old_port, new_port);
+    WRITE_U16(l4, UDP_CKSUM_OFF, cksum == 0U ? 0xFFFFU : cksum);
+  } else if (pkt->protocol == NAT_PROTO_ICMP) {
+    uint16_t cksum = checksum_adjust16(READ_U16(l4, ICMP_CKSUM_OFF), old_port, new_port);
+    WRITE_U16(l4, ICMP_CKSUM_OFF, cksum);
   }
 
-  return MAGI_OK;
+  memcpy(addr, new_addr, 4U);
+  WRITE_U16(l4, port_off, new_port);
 }
 
-int nat_translate_out(NATTable* t, struct IPv4Packet* pkt) {
+/**
+ * @brief Check that a packet is something the NAT can translate.
+ *
+ * @param t   NAT table.
+ * @param pkt Packet.
+ * @return true for TCP, UDP and ICMP packets with a readable port or identifier.
+ */
+static bool nat_packet_ok(const NATTable* t, const IPv4Packet* pkt) {
   if (t == NULL || pkt == NULL || pkt->payload == NULL || pkt->payload_len < 4U) {
-    magi_errno = MAGI_ERR_BADARGS;
-    return MAGI_ERR_BADARGS;
+    return false;
+  }
+  if (pkt->protocol == NAT_PROTO_ICMP) {
+    return pkt->payload_len >= ICMP_HEADER_MIN_LEN;
   }
+  return pkt->protocol == NAT_PROTO_TCP || pkt->protocol == NAT_PROTO_UDP;
+}
 
+/**
+ * @brief Tuple of a packet as it appears on the wire.
+ *
+ * @param pkt Packet accepted by nat_packet_ok().
+ * @return Tuple.
+ */
+static NATTuple nat_packet_tuple(const IPv4Packet* pkt) {
   if (pkt->protocol == NAT_PROTO_ICMP) {
-    return nat_translate_out_icmp(t, pkt);
+    uint16_t icmp_id = READ_U16(pkt->payload, ICMP_ID_OFF);
+    return nat_tuple(pkt->protocol, pkt->src_ip, icmp_id, pkt->dst_ip, icmp_id);
   }
+  return nat_tuple(pkt->protocol, pkt->src_ip, READ_U16(pkt->payload, 0U), pkt->dst_ip,
+                   READ_U16(pkt->payload, 2U));
+}
 
-  if (pkt->protocol != NAT_PROTO_TCP && pkt->protocol != NAT_PROTO_UDP) {
-    magi_errno = MAGI_ERR_BADARGS;
-    return MAGI_ERR_BADARGS;
+/**
+ * @brief Protocol name for log lines.
+ */
+static const char* nat_proto_name(uint8_t proto) {
+  switch (proto) {
+    case NAT_PROTO_ICMP:
+      return "ICMP";
+    case NAT_PROTO_TCP:
+      return "TCP";
+    case NAT_PROTO_UDP:
+      return "UDP";
+    default:
+      return "?";
   }
+}
 
-  return nat_translate_out_tcp_udp(t, pkt);
+/**
+ * @brief Format the address and port (or identifier) of one side of a tuple.
+ *
+ * @param key    Tuple.
+ * @param source true for the source side.
+ * @param out    Receives "a.b.c.d:port".
+ */
+static void nat_format_end(const NATTuple* key, bool source, char out[24]) {
+  uint32_t addr = (uint32_t)(source ? key->addrs >> 32U : key->addrs);
+  uint8_t ip[4];
+  WRITE_U32(ip, 0U, addr);
+  char ip_text[16];
+  ipv4_address_to_string(ip, ip_text);
+  unsigned port = (unsigned)(source ? key->ports >> 16U : key->ports & 0xFFFFU);
+  snprintf(out, 24U, "%s:%u", ip_text, port);
 }
 
 /**
- * @brief Translate an inbound TCP or UDP packet (public → private).
+ * @brief Log the outcome for a tuple; the formatting is skipped when L3 info is off.
  *
- * Looks up the destination port in the forward map, rewrites dst_ip and
- * dst_port back to the original private values. Removes the session entry
- * from both maps (one-shot). Marks the IPv4 checksum as stale (will be
- * recomputed during serialization).
+ * @param direction "Outbound" or "Inbound".
+ * @param key       Tuple as seen on the wire.
+ * @param outcome   What happened to the packet.
+ * @param port      Public port to append to the outcome, or -1.
  */
-static int nat_translate_in_tcp_udp(NATTable* t, IPv4Packet* pkt) {
-  uint16_t dst_port = READ_U16(pkt->payload, 2U);
+static void nat_log(const char* direction, const NATTuple* key, const char* outcome, int port) {
+  if (!magi_log_enabled(MAGI_LOG_SUBSYS, MAGI_LOG_INFO)) {
+    return;
+  }
 
-  char fwd_key[24];
-  nat_fwd_key(pkt->protocol, dst_port, fwd_key);
-  NATEntry* entry = hashmap_get(t->forward, fwd_key);
+  char src_text[24], dst_text[24];
+  nat_format_end(key, true, src_text);
+  nat_format_end(key, false, dst_text);
+  if (port >= 0) {
+    LOG("NAT", "%s %s %s -> %s %s %d", direction, nat_proto_name(key->proto), src_text, dst_text,
+        outcome, port);
+  } else {
+    LOG("NAT", "%s %s %s -> %s: %s", direction, nat_proto_name(key->proto), src_text, dst_text,
+        outcome);
+  }
+}
 
-  if (entry == NULL) {
-    char dst_text[16];
-    ipv4_address_to_string(pkt->dst_ip, dst_text);
-    LOG("NAT", "Inbound %s:%u: no matching session", dst_text, (unsigned)dst_port);
+/* ─── Public API ─── */
+
+NATTable* nat_table_new(const uint8_t public_ip[4]) {
+  if (public_ip == NULL) {
     magi_errno = MAGI_ERR_BADARGS;
-    return MAGI_ERR_BADARGS;
+    return NULL;
+  }
+
+  NATTable* t = calloc(1U, sizeof(*t));
+  struct NATConntrack* ct = calloc(1U, sizeof(*ct));
+  if (t == NULL || ct == NULL) {
+    free(t);
+    free(ct);
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
   }
 
-  /* Rewrite destination IP and port back to private values */
-  memcpy(pkt->dst_ip, entry->private_ip, 4U);
-  WRITE_U16((uint8_t*)pkt->payload, 2U, entry->private_port);
-  nat_mark_ipv4_cksum_stale(pkt);
+  memcpy(t->public_ip, public_ip, 4U);
+  t->timeouts = (NATTimeouts){.udp_ms = NAT_TIMEOUT_UDP_MS,
+                              .icmp_ms = NAT_TIMEOUT_ICMP_MS,
+                              .tcp_established_ms = NAT_TIMEOUT_TCP_ESTABLISHED_MS,
+                              .tcp_transitory_ms = NAT_TIMEOUT_TCP_TRANSITORY_MS,
+                              .tcp_closed_ms = NAT_TIMEOUT_TCP_CLOSED_MS};
+  t->conntrack = ct;
+
+  ct->flow_index.capacity = NAT_INDEX_MIN_CAPACITY;
+  ct->flow_index.slots = calloc(NAT_INDEX_MIN_CAPACITY, sizeof(NATSlot));
+  ct->mapping_index.capacity = NAT_INDEX_MIN_CAPACITY;
+  ct->mapping_index.slots = calloc(NAT_INDEX_MIN_CAPACITY, sizeof(NATSlot));
+  /* The slabs start empty and are allocated by the first flow. */
+  ct->flow_free = NAT_NONE;
+  ct->mapping_free = NAT_NONE;
+  if (ct->flow_index.slots == NULL || ct->mapping_index.slots == NULL) {
+    nat_table_free(t);
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
 
-  {
-    char orig_dst_text[16], priv_text[16];
-    ipv4_address_to_string(t->public_ip, orig_dst_text);
-    ipv4_address_to_string(entry->private_ip, priv_text);
-    LOG("NAT", "Inbound %s:%u -> %s:%u (was %s:%u via port %u)", orig_dst_text,
-        (unsigned)dst_port, priv_text, (unsigned)entry->private_port, orig_dst_text,
-        (unsigned)dst_port, (unsigned)entry->public_port);
+  /* Well-known and registered-below-1024 ports are never handed out. */
+  for (size_t proto = 0U; proto < 3U; ++proto) {
+    memset(ct->ports[proto].used, 0xFF, NAT_MIN_PORT / 8U);
+    ct->ports[proto].cursor = NAT_MIN_PORT;
   }
+  return t;
+}
 
-  /* Remove session from both maps (one-shot) */
-  hashmap_delete(t->forward, fwd_key);
-  {
-    char rev_key[32];
-    nat_rev_key(pkt->protocol, entry->private_ip, entry->private_port, rev_key);
-    hashmap_delete(t->reverse, rev_key);
+void nat_table_free(NATTable* t) {
+  if (t == NULL) {
+    return;
   }
-  free(entry);
 
-  return MAGI_OK;
+  if (t->conntrack != NULL) {
+    free(t->conntrack->flow_index.slots);
+    free(t->conntrack->mapping_index.slots);
+    free(t->conntrack->flows);
+    free(t->conntrack->mappings);
+    free(t->conntrack);
+  }
+  free(t);
 }
 
-/**
- * @brief Translate an inbound ICMP Echo Reply (public → private).
- *
- * Looks up the ICMP identifier (which was rewritten to the allocated public
- * port on outbound) in the forward map. Rewrites dst_ip back to the private
- * IP and restores the original ICMP identifier. Recomputes the ICMP checksum
- * since the identifier changed. Removes the session (one-shot).
- */
-static int nat_translate_in_icmp(NATTable* t, IPv4Packet* pkt) {
-  if (pkt->payload_len < ICMP_HEADER_MIN_LEN) {
+int nat_translate_out(NATTable* t, struct IPv4Packet* pkt) {
+  if (!nat_packet_ok(t, pkt)) {
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
-  uint16_t icmp_id = READ_U16(pkt->payload, ICMP_ID_OFF);
-
-  char fwd_key[24];
-  nat_fwd_key(pkt->protocol, icmp_id, fwd_key);
-  NATEntry* entry = hashmap_get(t->forward, fwd_key);
-
-  if (entry == NULL) {
-    char dst_text[16];
-    ipv4_address_to_string(pkt->dst_ip, dst_text);
-    LOG("NAT", "Inbound ICMP %s id=%u: no matching session", dst_text, (unsigned)icmp_id);
+  struct NATConntrack* ct = t->conntrack;
+  NATTuple orig = nat_packet_tuple(pkt);
+  uint64_t now_ns = sim_now_ns();
+  bool reply = false;
+  uint32_t id = nat_flow_lookup(t, &orig, now_ns, &reply);
+  if (id != NAT_NONE && reply) {
+    /* Only a reply tuple can hold the public address; this packet is not from inside. */
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
-  /* Rewrite destination IP and restore original ICMP identifier */
-  memcpy(pkt->dst_ip, entry->private_ip, 4U);
-  WRITE_U16((uint8_t*)pkt->payload, ICMP_ID_OFF, entry->private_port);
-  nat_recompute_icmp_cksum((uint8_t*)pkt->payload, pkt->payload_len);
-  nat_mark_ipv4_cksum_stale(pkt);
-
-  {
-    char orig_dst_text[16], priv_text[16];
-    ipv4_address_to_string(t->public_ip, orig_dst_text);
-    ipv4_address_to_string(entry->private_ip, priv_text);
-    LOG("NAT", "Inbound ICMP %s id=%u -> %s id=%u (was %s id=%u via port %u)",
-        orig_dst_text, (unsigned)icmp_id, priv_text, (unsigned)entry->private_port,
-        orig_dst_text, (unsigned)icmp_id, (unsigned)entry->public_port);
+  if (id == NAT_NONE) {
+    int status = nat_flow_create(t, &orig, now_ns, &id);
+    if (status != MAGI_OK) {
+      nat_log("Outbound", &orig,
+              status == MAGI_ERR_PORTUSED ? "no ports available" : "out of memory", -1);
+      return status;
+    }
+    nat_log("Outbound", &orig, "mapped to port", (uint16_t)ct->flows[id].reply.ports);
   }
 
-  /* Remove session from both maps (one-shot) */
-  hashmap_delete(t->forward, fwd_key);
-  {
-    char rev_key[32];
-    nat_rev_key(pkt->protocol, entry->private_ip, entry->private_port, rev_key);
-    hashmap_delete(t->reverse, rev_key);
+  NATFlow* flow = &ct->flows[id];
+  if (pkt->protocol == NAT_PROTO_TCP) {
+    nat_tcp_track(flow, pkt, false);
   }
-  free(entry);
-
+  flow->last_seen_ns = now_ns;
+  /* The public port is the reply tuple's destination port; no need to touch the mapping. */
+  nat_rewrite(pkt, pkt->src_ip, t->public_ip, pkt->protocol == NAT_PROTO_ICMP ? ICMP_ID_OFF : 0U,
+              (uint16_t)flow->reply.ports);
   return MAGI_OK;
 }
 
 int nat_translate_in(NATTable* t, struct IPv4Packet* pkt) {
-  if (t == NULL || pkt == NULL || pkt->payload == NULL || pkt->payload_len < 4U) {
+  if (!nat_packet_ok(t, pkt)) {
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
-  if (pkt->protocol == NAT_PROTO_ICMP) {
-    return nat_translate_in_icmp(t, pkt);
-  }
-
-  if (pkt->protocol != NAT_PROTO_TCP && pkt->protocol != NAT_PROTO_UDP) {
+  struct NATConntrack* ct = t->conntrack;
+  NATTuple key = nat_packet_tuple(pkt);
+  bool reply = false;
+  uint64_t now_ns = sim_now_ns();
+  uint32_t id = nat_flow_lookup(t, &key, now_ns, &reply);
+  if (id == NAT_NONE || !reply) {
+    nat_log("Inbound", &key, "no matching session", -1);
+    ct->no_session++;
     magi_errno = MAGI_ERR_BADARGS;
     return MAGI_ERR_BADARGS;
   }
 
-  return nat_translate_in_tcp_udp(t, pkt);
-}
+  NATFlow* flow = &ct->flows[id];
+  if (pkt->protocol == NAT_PROTO_TCP) {
+    nat_tcp_track(flow, pkt, true);
+  }
+  flow->last_seen_ns = now_ns;
 
-/**
- * @brief Context for the nat_print_entry callback.
- */
-typedef struct NatPrintCtx {
-  const char* name;
-  size_t count;
-} NatPrintCtx;
+  uint8_t private_ip[4];
+  WRITE_U32(private_ip, 0U, (uint32_t)(flow->orig.addrs >> 32U));
+  nat_rewrite(pkt, pkt->dst_ip, private_ip, pkt->protocol == NAT_PROTO_ICMP ? ICMP_ID_OFF : 2U,
+              (uint16_t)(flow->orig.ports >> 16U));
+  return MAGI_OK;
+}
 
-/**
- * @brief hashmap_foreach callback to print one NAT session entry.
- */
-static void nat_print_entry(const char* key, void* value, void* ctx) {
-  NatPrintCtx* pc = (NatPrintCtx*)ctx;
-  const NATEntry* entry = (const NATEntry*)value;
-  if (entry == NULL || pc == NULL) {
-    return;
+size_t nat_expire(NATTable* t) {
+  if (t == NULL) {
+    return 0U;
   }
+  return nat_sweep(t, sim_now_ns(), t->conntrack->flow_capacity);
+}
 
-  (void)key;
-  pc->count++;
-
-  const char* proto_str = "?";
-  switch (entry->protocol) {
-    case NAT_PROTO_ICMP:
-      proto_str = "ICMP";
-      break;
-    case NAT_PROTO_TCP:
-      proto_str = "TCP";
-      break;
-    case NAT_PROTO_UDP:
-      proto_str = "UDP";
-      break;
-    default:
-      break;
+void nat_get_stats(const NATTable* t, NATStats* out) {
+  if (t == NULL || out == NULL) {
+    return;
   }
 
-  char priv_str[16];
-  ipv4_address_to_string(entry->private_ip, priv_str);
-  LOG(pc->name, "NAT #%zu: %s %s:%u <-> ?:%u", pc->count, proto_str,
-      priv_str, (unsigned)entry->private_port, (unsigned)entry->public_port);
+  const struct NATConntrack* ct = t->conntrack;
+  *out = (NATStats){.flows = ct->flow_count,
+                    .mappings = ct->mapping_count,
+                    .created = ct->created,
+                    .expired = ct->expired,
+                    .no_port = ct->no_port,
+                    .no_session = ct->no_session};
 }
 
 void nat_print(const NATTable* t, const char* name) {
@@ -470,19 +887,33 @@ void nat_print(const NATTable* t, const char* name) {
     return;
   }
 
+  static const char* const state_names[] = {"SYN_SENT", "ESTABLISHED", "CLOSING", "CLOSED"};
+  const struct NATConntrack* ct = t->conntrack;
   char pub_str[16];
   ipv4_address_to_string(t->public_ip, pub_str);
+  LOG(name, "NAT: public IP %s, %zu flows over %zu mappings:", pub_str, ct->flow_count,
+      ct->mapping_count);
+
+  uint64_t now_ns = sim_now_ns();
+  size_t count = 0U;
+  for (size_t id = 0U; id < ct->flow_capacity; ++id) {
+    const NATFlow* flow = &ct->flows[id];
+    if (!flow->live) {
+      continue;
+    }
 
-  LOG(name, "NAT: public IP %s, next port %u, active sessions:", pub_str,
-      (unsigned)t->next_port);
-
-  NatPrintCtx ctx;
-  ctx.name = name;
-  ctx.count = 0U;
-
-  hashmap_foreach(t->forward, nat_print_entry, &ctx);
+    char src_text[24], dst_text[24];
+    nat_format_end(&flow->orig, true, src_text);
+    nat_format_end(&flow->orig, false, dst_text);
+    bool tcp = flow->orig.proto == NAT_PROTO_TCP;
+    LOG(name, "NAT #%zu: %s %s -> %s via port %u, idle %llu ms%s%s", ++count,
+        nat_proto_name(flow->orig.proto), src_text, dst_text,
+        (unsigned)ct->mappings[flow->mapping].public_port,
+        (unsigned long long)((now_ns - flow->last_seen_ns) / SIM_NS_PER_MS), tcp ? ", " : "",
+        tcp ? state_names[flow->tcp_state] : "");
+  }
 
-  if (ctx.count == 0U) {
+  if (count == 0U) {
     LOG(name, "NAT: no active sessions");
   }
 }
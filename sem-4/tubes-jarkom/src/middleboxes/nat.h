@@ -9,26 +9,35 @@
  * - TCP/UDP: src_ip:src_port → public_ip:allocated_port (port-based PAT)
  * - ICMP:    src_ip:icmp_id  → public_ip:allocated_port (ID-based translation per RFC 3022)
  *
- * Forward map: key = "proto:pub_port"  → NATEntry
- * Reverse map: key = "proto:pvt_ip:pvt_port" → NATEntry
+ * Two tables make up the state:
+ * - Mappings: (proto, private ip, private port) → public port. The mapping
+ *   is endpoint-independent (RFC 4787 REQ-1): every flow from one private
+ *   endpoint shares it, whatever the remote end.
+ * - Connection tracking: one flow per binary 5-tuple, found under both its
+ *   outbound tuple and the tuple its replies carry. Inbound packets are
+ *   only translated if they belong to a tracked flow.
  *
- * Sessions are one-shot (removed on inbound translation) for simplicity.
- * Public ports are allocated starting from 1024, incrementing per session.
+ * Flows expire after a per-protocol idle timeout (see NATTimeouts). TCP
+ * flows follow SYN, FIN and RST so closed connections go away quickly
+ * while established ones are kept for hours. A mapping lives as long as
+ * its last flow. Expired flows are reclaimed lazily when a lookup finds
+ * them, a few at a time as new flows are created, and in full by
+ * nat_expire().
  *
- * Checksums are marked stale during translation and recomputed by
- * ipv4_pack() during the subsequent serialization step (the NAT
- * translation runs on parsed struct fields, not serialized buffers).
- * ICMP checksums are recomputed in-place since the identifier changes.
+ * Public ports come from a per-protocol bitmap scanned a word at a time
+ * from a rotating cursor. IPv4, TCP, UDP and ICMP checksums are patched
+ * incrementally (RFC 1624) for the rewritten address and port, so a
+ * translated packet is valid without touching its payload.
  */
 
 #ifndef MAGI_MIDDLEBOXES_NAT_H
 #define MAGI_MIDDLEBOXES_NAT_H
 
-#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
 struct IPv4Packet;
+struct NATConntrack;
 
 #define NAT_PROTO_ICMP 1U
 #define NAT_PROTO_TCP  6U
@@ -37,28 +46,51 @@ struct IPv4Packet;
 #define NAT_MIN_PORT 1024U
 #define NAT_MAX_PORT 65535U
 
+/** UDP idle timeout; RFC 4787 REQ-5 asks for at least two minutes. */
+#define NAT_TIMEOUT_UDP_MS 120000U
+/** ICMP query idle timeout; RFC 5508 REQ-1 asks for at least 60 seconds. */
+#define NAT_TIMEOUT_ICMP_MS 60000U
+/** Established TCP idle timeout; RFC 5382 REQ-5 asks for 2 hours 4 minutes. */
+#define NAT_TIMEOUT_TCP_ESTABLISHED_MS 7440000U
+/** TCP opening or half-closed; RFC 5382 REQ-5 asks for 4 minutes. */
+#define NAT_TIMEOUT_TCP_TRANSITORY_MS 240000U
+/** TCP after a RST or a FIN each way; long enough for stragglers and the last ACK. */
+#define NAT_TIMEOUT_TCP_CLOSED_MS 10000U
+
+/**
+ * @brief Idle timeouts in milliseconds, applied when a flow is next seen or swept.
+ */
+typedef struct NATTimeouts {
+  uint32_t udp_ms;
+  uint32_t icmp_ms;
+  uint32_t tcp_established_ms;
+  uint32_t tcp_transitory_ms;
+  uint32_t tcp_closed_ms;
+} NATTimeouts;
+
 /**
- * @brief One NAT session entry.
+ * @brief Counters and occupancy, see nat_get_stats().
  */
-typedef struct NATEntry {
-  uint8_t  private_ip[4];   /**< Original private IP. */
-  uint16_t private_port;    /**< Original private port (0 for ICMP). */
-  uint16_t public_port;     /**< Allocated public port. */
-  uint8_t  protocol;        /**< IP protocol (TCP, UDP, or ICMP). */
-} NATEntry;
+typedef struct NATStats {
+  size_t flows;          /**< Flows currently tracked. */
+  size_t mappings;       /**< Private endpoints currently mapped. */
+  uint64_t created;      /**< Flows created. */
+  uint64_t expired;      /**< Flows removed by timeout. */
+  uint64_t no_port;      /**< New flows refused because every public port was taken. */
+  uint64_t no_session;   /**< Inbound packets that matched no flow. */
+} NATStats;
 
 /**
- * @brief NAT table with forward/reverse lookup maps.
+ * @brief NAT table: public address, timeouts and connection-tracking state.
  */
 typedef struct NATTable {
-  uint8_t   public_ip[4];   /**< Public IP address to masquerade behind. */
-  void     *forward;         /**< HashMap: "proto:pub_port" → NATEntry* */
-  void     *reverse;         /**< HashMap: "proto:pvt_ip:pvt_port" → NATEntry* */
-  uint16_t  next_port;       /**< Next public port to allocate (starts at 1024). */
+  uint8_t public_ip[4];   /**< Public IP address to masquerade behind. */
+  NATTimeouts timeouts;   /**< Idle timeouts; may be changed at any time. */
+  struct NATConntrack* conntrack;
 } NATTable;
 
 /**
- * @brief Create a new NAT table with a given public IP.
+ * @brief Create a new NAT table with a given public IP and the default timeouts.
  *
  * @param public_ip 4-byte public IP address.
  * @return New NATTable, or NULL on allocation failure.
@@ -75,11 +107,11 @@ void nat_table_free(NATTable* t);
 /**
  * @brief Translate an outbound packet (private → public).
  *
- * TCP/UDP: rewrites src_ip → public_ip and src_port → allocated port.
- * ICMP:    rewrites src_ip → public_ip and ICMP identifier → allocated port.
+ * TCP/UDP: rewrites src_ip → public_ip and src_port → mapped port.
+ * ICMP:    rewrites src_ip → public_ip and ICMP identifier → mapped port.
  *
- * IPv4 checksum is marked stale for subsequent serialization.
- * ICMP checksum is recomputed in-place (identifier changed).
+ * Creates the flow, and the mapping if the private endpoint has none.
+ * Checksums are updated incrementally.
  *
  * @param t   NAT table.
  * @param pkt Parsed IPv4 packet to translate.
@@ -92,11 +124,11 @@ int nat_translate_out(NATTable* t, struct IPv4Packet* pkt);
 /**
  * @brief Translate an inbound packet (public → private).
  *
- * TCP/UDP: looks up by dst_port, rewrites dst_ip and dst_port to private values.
+ * TCP/UDP: looks up the flow by 5-tuple, rewrites dst_ip and dst_port to private values.
  * ICMP:    looks up by ICMP identifier, rewrites dst_ip and identifier.
  *
- * The session is removed from both maps after translation (one-shot).
- * ICMP checksum is recomputed in-place (identifier changed).
+ * The flow stays until it times out or, for TCP, is closed.
+ * Checksums are updated incrementally.
  *
  * @param t   NAT table.
  * @param pkt Parsed IPv4 packet to translate.
@@ -105,6 +137,22 @@ int nat_translate_out(NATTable* t, struct IPv4Packet* pkt);
  */
 int nat_translate_in(NATTable* t, struct IPv4Packet* pkt);
 
+/**
+ * @brief Remove every flow that has been idle past its timeout.
+ *
+ * @param t NAT table.
+ * @return Number of flows removed.
+ */
+size_t nat_expire(NATTable* t);
+
+/**
+ * @brief Read the table's occupancy and counters.
+ *
+ * @param t   NAT table.
+ * @param out Receives the statistics.
+ */
+void nat_get_stats(const NATTable* t, NATStats* out);
+
 /**
  * @brief Print all active NAT sessions via LOG().
  *
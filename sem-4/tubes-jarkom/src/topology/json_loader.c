@@ -448,7 +448,7 @@ static int load_node_array(cJSON* array, Topology* topology, TopologyNodeKind ki
           return MAGI_ERR_BADARGS;
         }
         if (ip_address != NULL) {
-          snprintf(iface->ip_address, sizeof(iface->ip_address), "%s", ip_address);
+          (void)interface_set_ip(iface, ip_address);
         }
         iface->vlan_id = vlan_id;
       }
@@ -510,6 +510,39 @@ static int load_node_array(cJSON* array, Topology* topology, TopologyNodeKind ki
   return MAGI_OK;
 }
 
+/**
+ * @brief Parse a link's "queue" object: discipline, limit and RED parameters.
+ */
+static int load_link_queue(const cJSON* item, LinkQueueConfig* queue) {
+  if (!cJSON_IsObject(item)) {
+    return MAGI_ERR_BADARGS;
+  }
+
+  const cJSON* kind_item = cJSON_GetObjectItemCaseSensitive(item, "discipline");
+  const cJSON* limit_item = cJSON_GetObjectItemCaseSensitive(item, "limit");
+  const cJSON* min_item = cJSON_GetObjectItemCaseSensitive(item, "red_min");
+  const cJSON* max_item = cJSON_GetObjectItemCaseSensitive(item, "red_max");
+  const cJSON* max_p_item = cJSON_GetObjectItemCaseSensitive(item, "red_max_p");
+
+  if (kind_item != NULL && (!cJSON_IsString(kind_item) ||
+                            !link_parse_queue_kind(kind_item->valuestring, &queue->kind))) {
+    return MAGI_ERR_BADARGS;
+  }
+  if (cJSON_IsNumber(limit_item)) {
+    queue->limit = (uint32_t)limit_item->valuedouble;
+  }
+  if (cJSON_IsNumber(min_item)) {
+    queue->red_min = (uint32_t)min_item->valuedouble;
+  }
+  if (cJSON_IsNumber(max_item)) {
+    queue->red_max = (uint32_t)max_item->valuedouble;
+  }
+  if (cJSON_IsNumber(max_p_item)) {
+    queue->red_max_p = max_p_item->valuedouble;
+  }
+  return MAGI_OK;
+}
+
 /**
  * @brief Load links from a cJSON array into the topology.
  */
@@ -532,6 +565,8 @@ static int load_link_array(cJSON* array, Topology* topology) {
       delay_item = cJSON_GetObjectItemCaseSensitive(item, "delay_ms");
     }
     cJSON* mtu_item = cJSON_GetObjectItemCaseSensitive(item, "mtu");
+    cJSON* bandwidth_item = cJSON_GetObjectItemCaseSensitive(item, "bandwidth");
+    cJSON* queue_item = cJSON_GetObjectItemCaseSensitive(item, "queue");
 
     const char* endpoint_a_text = NULL;
     const char* endpoint_b_text = NULL;
@@ -572,7 +607,26 @@ static int load_link_array(cJSON* array, Topology* topology) {
       mtu = (uint16_t)mtu_item->valuedouble;
     }
 
-    if (topology_add_link(topology, node_a, port_a, node_b, port_b, delay_ms, mtu) == NULL) {
+    uint64_t bandwidth_bps = 0U;
+    if (cJSON_IsNumber(bandwidth_item) && bandwidth_item->valuedouble >= 0.0) {
+      bandwidth_bps = (uint64_t)bandwidth_item->valuedouble;
+    } else if (cJSON_IsString(bandwidth_item)) {
+      if (!link_parse_rate(bandwidth_item->valuestring, &bandwidth_bps)) {
+        return MAGI_ERR_BADARGS;
+      }
+    } else if (bandwidth_item != NULL) {
+      return MAGI_ERR_BADARGS;
+    }
+
+    LinkQueueConfig queue = {.kind = LINK_QUEUE_FIFO, .limit = LINK_QUEUE_DEFAULT_LIMIT};
+    if (queue_item != NULL && load_link_queue(queue_item, &queue) != MAGI_OK) {
+      return MAGI_ERR_BADARGS;
+    }
+
+    TopologyLinkInfo* info =
+        topology_add_link(topology, node_a, port_a, node_b, port_b, delay_ms, mtu);
+    if (info == NULL || link_set_bandwidth(info->link, bandwidth_bps) != MAGI_OK ||
+        link_set_queue(info->link, &queue) != MAGI_OK) {
       return MAGI_ERR_BADARGS;
     }
   }
@@ -805,6 +859,47 @@ fail:
   return NULL;
 }
 
+/**
+ * @brief Add a link's bandwidth and queue settings, and its counters, to its JSON object.
+ *
+ * Bandwidth and queue are written only when they differ from the defaults.
+ * The "stats" object is informational; loading ignores it.
+ */
+static int add_link_shaping(cJSON* link_obj, const Link* link) {
+  if (link->bandwidth_bps != 0U &&
+      !cJSON_AddNumberToObject(link_obj, "bandwidth", (double)link->bandwidth_bps)) {
+    return MAGI_ERR_NOMEM;
+  }
+
+  const LinkQueueConfig* queue = &link->queue;
+  if (queue->kind != LINK_QUEUE_FIFO || queue->limit != LINK_QUEUE_DEFAULT_LIMIT) {
+    cJSON* queue_obj = cJSON_AddObjectToObject(link_obj, "queue");
+    if (queue_obj == NULL ||
+        !cJSON_AddStringToObject(queue_obj, "discipline", link_queue_kind_name(queue->kind)) ||
+        !cJSON_AddNumberToObject(queue_obj, "limit", queue->limit)) {
+      return MAGI_ERR_NOMEM;
+    }
+    if (queue->kind == LINK_QUEUE_RED &&
+        (!cJSON_AddNumberToObject(queue_obj, "red_min", queue->red_min) ||
+         !cJSON_AddNumberToObject(queue_obj, "red_max", queue->red_max) ||
+         !cJSON_AddNumberToObject(queue_obj, "red_max_p", queue->red_max_p))) {
+      return MAGI_ERR_NOMEM;
+    }
+  }
+
+  LinkStats stats = {0};
+  (void)link_get_stats(link, NULL, &stats);
+  cJSON* stats_obj = cJSON_AddObjectToObject(link_obj, "stats");
+  if (stats_obj == NULL ||
+      !cJSON_AddNumberToObject(stats_obj, "tx_packets", (double)stats.tx_packets) ||
+      !cJSON_AddNumberToObject(stats_obj, "tx_bytes", (double)stats.tx_bytes) ||
+      !cJSON_AddNumberToObject(stats_obj, "drops", (double)stats.drops) ||
+      !cJSON_AddNumberToObject(stats_obj, "queue_hwm", stats.queue_hwm)) {
+    return MAGI_ERR_NOMEM;
+  }
+  return MAGI_OK;
+}
+
 /**
  * @brief Serialize the topology link section into a cJSON array.
  */
@@ -854,7 +949,8 @@ static cJSON* save_link_array(const Topology* topology) {
 
     if (!cJSON_AddItemToObject(link_obj, "endpoints", endpoints) ||
         !cJSON_AddNumberToObject(link_obj, "delay", info->link->delay_ms) ||
-        !cJSON_AddNumberToObject(link_obj, "mtu", info->link->mtu)) {
+        !cJSON_AddNumberToObject(link_obj, "mtu", info->link->mtu) ||
+        add_link_shaping(link_obj, info->link) != MAGI_OK) {
       cJSON_Delete(link_obj);
       goto fail;
     }
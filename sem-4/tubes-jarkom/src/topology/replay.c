@@ -0,0 +1,512 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "replay.h"
+
+#include "core/node.h"
+#include "core/sim.h"
+#include "utils/hashmap.h"
+#include "utils/magi_error.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef MAGI_ASYNC
+#include <pthread.h>
+#endif
+
+/** pcapng interfaces remembered per section; records from later ones are skipped. */
+#define REPLAY_MAX_IFACES 64U
+/** Initial scratch buffer; grown for larger records. */
+#define REPLAY_SCRATCH_BYTES 2048U
+
+#define PCAP_MAGIC_US 0xA1B2C3D4U
+#define PCAP_MAGIC_NS 0xA1B23C4DU
+#define PCAP_HEADER_LEN 24U
+#define PCAP_RECORD_LEN 16U
+#define PCAPNG_SHB 0x0A0D0D0AU
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4DU
+#define PCAPNG_IDB 1U
+#define PCAPNG_PB 2U
+#define PCAPNG_SPB 3U
+#define PCAPNG_EPB 6U
+#define PCAPNG_OPT_IF_TSRESOL 9U
+#define LINKTYPE_ETHERNET 1U
+
+/**
+ * @brief Timestamp unit of one capture interface.
+ */
+typedef struct ReplayIfaceInfo {
+  bool ethernet;
+  /** Units are 2^-exponent seconds rather than 10^-exponent. */
+  bool binary;
+  uint8_t exponent;
+} ReplayIfaceInfo;
+
+/**
+ * @brief Read position in a mapped capture file.
+ */
+typedef struct ReplayFile {
+  const uint8_t* base;
+  size_t len;
+  size_t offset;
+  bool pcapng;
+  bool swapped;
+  /** Classic pcap: the one interface. pcapng: the current section's interfaces. */
+  ReplayIfaceInfo ifaces[REPLAY_MAX_IFACES];
+  size_t if_count;
+} ReplayFile;
+
+/**
+ * @brief One frame as found in the file.
+ */
+typedef struct ReplayRecord {
+  const uint8_t* data;
+  uint32_t caplen;
+  uint32_t origlen;
+  uint64_t ts_ns;
+  bool has_ts;
+  bool ethernet;
+} ReplayRecord;
+
+static uint32_t swap32(uint32_t value) {
+  return (value >> 24) | ((value >> 8) & 0xFF00U) | ((value << 8) & 0xFF0000U) | (value << 24);
+}
+
+static uint32_t file_u32(const ReplayFile* file, const uint8_t* bytes) {
+  uint32_t value;
+  memcpy(&value, bytes, sizeof(value));
+  return file->swapped ? swap32(value) : value;
+}
+
+static uint16_t file_u16(const ReplayFile* file, const uint8_t* bytes) {
+  uint16_t value;
+  memcpy(&value, bytes, sizeof(value));
+  return file->swapped ? (uint16_t)((value >> 8) | (value << 8)) : value;
+}
+
+/**
+ * @brief Convert a timestamp in interface units to nanoseconds.
+ */
+static uint64_t ticks_to_ns(const ReplayIfaceInfo* info, uint64_t ticks) {
+  static const uint64_t pow10[] = {1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL,
+                                   1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL};
+  if (!info->binary) {
+    if (info->exponent <= 9U) {
+      return ticks * pow10[9U - info->exponent];
+    }
+    uint8_t extra = info->exponent - 9U;
+    return extra <= 9U ? ticks / pow10[extra] : 0U;
+  }
+
+  uint8_t shift = info->exponent;
+  if (shift > 32U) {
+    ticks >>= shift - 32U;
+    shift = 32U;
+  }
+  uint64_t whole = ticks >> shift;
+  uint64_t fraction = ticks & ((1ULL << shift) - 1U);
+  return whole * 1000000000ULL + ((fraction * 1000000000ULL) >> shift);
+}
+
+/**
+ * @brief Recognize the file and position at its first record.
+ *
+ * @return true for classic pcap or pcapng.
+ */
+static bool replay_open_format(ReplayFile* file) {
+  file->offset = 0U;
+  file->if_count = 0U;
+  if (file->len < 12U) {
+    return false;
+  }
+
+  uint32_t magic;
+  memcpy(&magic, file->base, sizeof(magic));
+  if (magic == PCAPNG_SHB) {
+    file->pcapng = true;
+    return true;
+  }
+
+  file->pcapng = false;
+  file->swapped = magic == swap32(PCAP_MAGIC_US) || magic == swap32(PCAP_MAGIC_NS);
+  uint32_t native = file->swapped ? swap32(magic) : magic;
+  if ((native != PCAP_MAGIC_US && native != PCAP_MAGIC_NS) || file->len < PCAP_HEADER_LEN) {
+    return false;
+  }
+  file->ifaces[0].ethernet = (file_u32(file, file->base + 20U) & 0xFFFFU) == LINKTYPE_ETHERNET;
+  file->ifaces[0].binary = false;
+  file->ifaces[0].exponent = native == PCAP_MAGIC_NS ? 9U : 6U;
+  file->if_count = 1U;
+  file->offset = PCAP_HEADER_LEN;
+  return true;
+}
+
+/**
+ * @brief Read the next classic pcap record.
+ *
+ * @return 1 for a record, 0 at the end of the file, -1 if the file is damaged.
+ */
+static int replay_next_pcap(ReplayFile* file, ReplayRecord* record) {
+  if (file->offset == file->len) {
+    return 0;
+  }
+  if (file->len - file->offset < PCAP_RECORD_LEN) {
+    return -1;
+  }
+
+  const uint8_t* header = file->base + file->offset;
+  uint64_t seconds = file_u32(file, header);
+  uint64_t fraction = file_u32(file, header + 4U);
+  record->caplen = file_u32(file, header + 8U);
+  record->origlen = file_u32(file, header + 12U);
+  if (record->caplen > file->len - file->offset - PCAP_RECORD_LEN) {
+    return -1;
+  }
+
+  const ReplayIfaceInfo* info = &file->ifaces[0];
+  record->data = header + PCAP_RECORD_LEN;
+  record->ts_ns = seconds * 1000000000ULL + ticks_to_ns(info, fraction);
+  record->has_ts = true;
+  record->ethernet = info->ethernet;
+  file->offset += PCAP_RECORD_LEN + record->caplen;
+  return 1;
+}
+
+/**
+ * @brief Remember an Interface Description Block's link type and timestamp unit.
+ */
+static void replay_read_idb(ReplayFile* file, const uint8_t* block, uint32_t total) {
+  if (file->if_count == REPLAY_MAX_IFACES || total < 20U) {
+    return;
+  }
+
+  ReplayIfaceInfo* info = &file->ifaces[file->if_count++];
+  info->ethernet = file_u16(file, block + 8U) == LINKTYPE_ETHERNET;
+  info->binary = false;
+  info->exponent = 6U;
+
+  size_t offset = 16U;
+  while (offset + 4U <= total - 4U) {
+    uint16_t code = file_u16(file, block + offset);
+    uint16_t len = file_u16(file, block + offset + 2U);
+    if (code == 0U || offset + 4U + len > total - 4U) {
+      break;
+    }
+    if (code == PCAPNG_OPT_IF_TSRESOL && len >= 1U) {
+      uint8_t resolution = block[offset + 4U];
+      bool binary = (resolution & 0x80U) != 0U;
+      uint8_t exponent = resolution & 0x7FU;
+      /* A 2^-64 tick or finer cannot come from a real clock; keep the default. */
+      if (!binary || exponent < 64U) {
+        info->binary = binary;
+        info->exponent = exponent;
+      }
+    }
+    offset += 4U + (((size_t)len + 3U) & ~(size_t)3U);
+  }
+}
+
+/**
+ * @brief Fill a record from a packet block whose interface id and timestamp are known.
+ */
+static int replay_packet_block(ReplayFile* file, const uint8_t* block, uint32_t total,
+                               uint32_t if_id, size_t data_offset, uint32_t caplen,
+                               uint32_t origlen, ReplayRecord* record) {
+  if (data_offset + caplen > total - 4U) {
+    return -1;
+  }
+
+  const ReplayIfaceInfo* info = if_id < file->if_count ? &file->ifaces[if_id] : NULL;
+  uint64_t ticks = ((uint64_t)file_u32(file, block + 12U) << 32) | file_u32(file, block + 16U);
+  record->data = block + data_offset;
+  record->caplen = caplen;
+  record->origlen = origlen;
+  record->ethernet = info != NULL && info->ethernet;
+  record->has_ts = info != NULL;
+  record->ts_ns = info != NULL ? ticks_to_ns(info, ticks) : 0U;
+  return 1;
+}
+
+/**
+ * @brief Read the next pcapng packet, handling section and interface blocks on the way.
+ *
+ * @return 1 for a record, 0 at the end of the file, -1 if the file is damaged.
+ */
+static int replay_next_pcapng(ReplayFile* file, ReplayRecord* record) {
+  for (;;) {
+    if (file->offset == file->len) {
+      return 0;
+    }
+    if (file->len - file->offset < 12U) {
+      return -1;
+    }
+
+    const uint8_t* block = file->base + file->offset;
+    uint32_t type;
+    memcpy(&type, block, sizeof(type));
+    if (type == PCAPNG_SHB) {
+      uint32_t magic;
+      memcpy(&magic, block + 8U, sizeof(magic));
+      if (magic != PCAPNG_BYTE_ORDER_MAGIC && magic != swap32(PCAPNG_BYTE_ORDER_MAGIC)) {
+        return -1;
+      }
+      file->swapped = magic != PCAPNG_BYTE_ORDER_MAGIC;
+      file->if_count = 0U;
+    } else {
+      type = file_u32(file, block);
+    }
+
+    uint32_t total = file_u32(file, block + 4U);
+    if (total < 12U || total % 4U != 0U || total > file->len - file->offset) {
+      return -1;
+    }
+    file->offset += total;
+
+    int status = 0;
+    if (type == PCAPNG_IDB) {
+      replay_read_idb(file, block, total);
+    } else if (type == PCAPNG_EPB && total >= 32U) {
+      status = replay_packet_block(file, block, total, file_u32(file, block + 8U), 28U,
+                                   file_u32(file, block + 20U), file_u32(file, block + 24U),
+                                   record);
+    } else if (type == PCAPNG_PB && total >= 32U) {
+      status = replay_packet_block(file, block, total, file_u16(file, block + 8U), 28U,
+                                   file_u32(file, block + 20U), file_u32(file, block + 24U),
+                                   record);
+    } else if (type == PCAPNG_SPB && total >= 16U) {
+      uint32_t origlen = file_u32(file, block + 8U);
+      uint32_t room = total - 16U;
+      status = replay_packet_block(file, block, total, 0U, 12U, origlen < room ? origlen : room,
+                                   origlen, record);
+      record->has_ts = false;
+    }
+    if (status != 0) {
+      return status;
+    }
+  }
+}
+
+static int replay_next(ReplayFile* file, ReplayRecord* record) {
+  return file->pcapng ? replay_next_pcapng(file, record) : replay_next_pcap(file, record);
+}
+
+static double replay_wall_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Let time pass until at_ns on the clock frames are paced against.
+ *
+ * The sequential build runs simulation events up to that time; with
+ * MAGI_ASYNC the calling thread sleeps.
+ */
+static void replay_wait_until(uint64_t at_ns) {
+#ifdef MAGI_ASYNC
+  struct timespec deadline = {.tv_sec = (time_t)(at_ns / 1000000000ULL),
+                              .tv_nsec = (long)(at_ns % 1000000000ULL)};
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) != 0) {
+  }
+#else
+  if (at_ns > sim_now_ns()) {
+    sim_run_until(at_ns);
+  }
+#endif
+}
+
+/**
+ * @brief Hand one frame to the interface.
+ */
+static void replay_inject(Interface* iface, const uint8_t* frame, size_t len) {
+#ifdef MAGI_ASYNC
+  /* Engine workers run this node under the same lock. */
+  pthread_mutex_lock(&iface->node->lock);
+  interface_receive(iface, frame, len);
+  pthread_mutex_unlock(&iface->node->lock);
+#else
+  interface_receive(iface, frame, len);
+#endif
+}
+
+static void add_node_drops(const Node* node, uint64_t drops[MAGI_NODE_DROP_REASONS]) {
+  for (size_t reason = 0U; reason < MAGI_NODE_DROP_REASONS; ++reason) {
+    drops[reason] += magi_counter_read(&node->counters, reason);
+  }
+}
+
+static void add_topology_node_drops(const char* key, void* value, void* ctx) {
+  (void)key;
+  const TopologyNodeInfo* info = value;
+  if (info != NULL && info->node != NULL) {
+    add_node_drops(info->node, ctx);
+  }
+}
+
+/**
+ * @brief Current drop counters, summed over the topology or over one node.
+ */
+static void replay_read_drops(const Topology* topology, const Interface* iface,
+                              uint64_t drops[MAGI_NODE_DROP_REASONS]) {
+  memset(drops, 0, sizeof(uint64_t) * MAGI_NODE_DROP_REASONS);
+  if (topology != NULL && topology->nodes != NULL) {
+    hashmap_foreach(topology->nodes, add_topology_node_drops, drops);
+  } else {
+    add_node_drops(iface->node, drops);
+  }
+}
+
+/**
+ * @brief Play the file once from the top.
+ *
+ * @return MAGI_OK, or MAGI_ERR_BADARGS if a damaged record stopped the pass.
+ */
+static int replay_pass(ReplayFile* file, Interface* iface, const ReplayConfig* config,
+                       uint8_t** scratch, size_t* scratch_len, ReplayReport* report) {
+  if (!replay_open_format(file)) {
+    return MAGI_ERR_BADARGS;
+  }
+
+  double speed = config->timing == REPLAY_TIMING_SCALED ? config->speed : 1.0;
+  uint64_t pass_start = sim_now_ns();
+  uint64_t first_ts = 0U;
+  bool have_first = false;
+  ReplayRecord record;
+  int status;
+  while ((status = replay_next(file, &record)) == 1) {
+    if (!record.ethernet) {
+      report->skipped_linktype++;
+      continue;
+    }
+    if (record.caplen < record.origlen) {
+      report->skipped_truncated++;
+      continue;
+    }
+
+    if (config->timing != REPLAY_TIMING_FAST && record.has_ts) {
+      if (!have_first) {
+        first_ts = record.ts_ns;
+        have_first = true;
+      } else if (record.ts_ns > first_ts) {
+        replay_wait_until(pass_start + (uint64_t)((double)(record.ts_ns - first_ts) / speed));
+      }
+    }
+
+    if (record.caplen > *scratch_len) {
+      uint8_t* grown = realloc(*scratch, record.caplen);
+      if (grown == NULL) {
+        return MAGI_ERR_NOMEM;
+      }
+      *scratch = grown;
+      *scratch_len = record.caplen;
+    }
+    /* Receivers may rewrite frames in place, and the mapping is read-only. */
+    memcpy(*scratch, record.data, record.caplen);
+    if (config->rewrite_dst_mac && record.caplen >= 6U) {
+      memcpy(*scratch, iface->mac, 6U);
+    }
+    replay_inject(iface, *scratch, record.caplen);
+    report->packets++;
+    report->bytes += record.caplen;
+  }
+  return status == 0 ? MAGI_OK : MAGI_ERR_BADARGS;
+}
+
+bool replay_parse_timing(const char* text, ReplayConfig* config) {
+  if (text == NULL || config == NULL) {
+    return false;
+  }
+  if (strcmp(text, "original") == 0) {
+    config->timing = REPLAY_TIMING_ORIGINAL;
+    return true;
+  }
+  if (strcmp(text, "fast") == 0) {
+    config->timing = REPLAY_TIMING_FAST;
+    return true;
+  }
+
+  /* "x10", "10x" or plain "10". */
+  const char* number = text[0] == 'x' ? text + 1 : text;
+  char* end = NULL;
+  double speed = strtod(number, &end);
+  bool suffix_ok = *end == '\0' || (number == text && strcmp(end, "x") == 0);
+  if (end == number || !suffix_ok || !(speed > 0.0)) {
+    return false;
+  }
+  config->timing = REPLAY_TIMING_SCALED;
+  config->speed = speed;
+  return true;
+}
+
+int replay_run(Topology* topology, Interface* iface, const char* path,
+               const ReplayConfig* config, ReplayReport* report) {
+  ReplayConfig defaults = {.timing = REPLAY_TIMING_ORIGINAL, .loops = 1U};
+  if (config == NULL) {
+    config = &defaults;
+  }
+  if (report != NULL) {
+    memset(report, 0, sizeof(*report));
+  }
+  if (iface == NULL || iface->node == NULL || path == NULL || report == NULL ||
+      (config->timing == REPLAY_TIMING_SCALED && !(config->speed > 0.0))) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  int fd = open(path, O_RDONLY);
+  struct stat info;
+  if (fd < 0 || fstat(fd, &info) != 0 || info.st_size <= 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+  ReplayFile file = {.len = (size_t)info.st_size};
+  void* mapping = mmap(NULL, file.len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+  posix_madvise(mapping, file.len, POSIX_MADV_SEQUENTIAL);
+  file.base = mapping;
+
+  size_t scratch_len = REPLAY_SCRATCH_BYTES;
+  uint8_t* scratch = malloc(scratch_len);
+  uint64_t drops_before[MAGI_NODE_DROP_REASONS];
+  replay_read_drops(topology, iface, drops_before);
+
+  int status = scratch != NULL ? MAGI_OK : MAGI_ERR_NOMEM;
+  uint32_t loops = config->loops != 0U ? config->loops : 1U;
+  uint64_t sim_start = sim_now_ns();
+  double wall_start = replay_wall_sec();
+  for (uint32_t loop = 0U; loop < loops && status == MAGI_OK; ++loop) {
+    status = replay_pass(&file, iface, config, &scratch, &scratch_len, report);
+  }
+  report->wall_sec = replay_wall_sec() - wall_start;
+  report->sim_sec = (double)(sim_now_ns() - sim_start) / 1e9;
+  report->pps = report->wall_sec > 0.0 ? (double)report->packets / report->wall_sec : 0.0;
+
+  /* Let frames still crossing delayed links land before reading the drops. */
+  uint32_t drain_ms = config->drain_ms != 0U ? config->drain_ms : REPLAY_DEFAULT_DRAIN_MS;
+  replay_wait_until(sim_now_ns() + (uint64_t)drain_ms * SIM_NS_PER_MS);
+
+  uint64_t drops_after[MAGI_NODE_DROP_REASONS];
+  replay_read_drops(topology, iface, drops_after);
+  for (size_t reason = 0U; reason < MAGI_NODE_DROP_REASONS; ++reason) {
+    report->drops[reason] = drops_after[reason] - drops_before[reason];
+  }
+
+  free(scratch);
+  munmap(mapping, file.len);
+  if (status != MAGI_OK) {
+    magi_errno = status;
+  }
+  return status;
+}
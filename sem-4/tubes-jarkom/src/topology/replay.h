@@ -0,0 +1,103 @@
+/**
+ * @file replay.h
+ * @brief Replay recorded pcap/pcapng traffic into a topology interface.
+ *
+ * The file is mapped read-only and walked in place; each Ethernet frame is
+ * copied into a scratch buffer and handed to interface_receive() as if it
+ * had just arrived on the chosen interface. Classic pcap (microsecond or
+ * nanosecond, either byte order) and pcapng (EPB, SPB and the obsolete PB,
+ * several sections and interfaces, any if_tsresol) are understood.
+ *
+ * Pacing follows the recorded timestamps, optionally sped up, or is turned
+ * off entirely. The sequential build paces on the simulation clock, so
+ * timers and delayed links fire between frames exactly as recorded and a
+ * replay at original timing finishes as fast as the CPU allows. With
+ * MAGI_ASYNC pacing is on the wall clock, frames are injected under the
+ * receiving node's lock, and the engine must already be running.
+ */
+
+#ifndef MAGI_TOPOLOGY_REPLAY_H
+#define MAGI_TOPOLOGY_REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "core/interface.h"
+#include "core/stats.h"
+#include "topology.h"
+
+/** Settle time after the last frame used when the config leaves it at 0. */
+#define REPLAY_DEFAULT_DRAIN_MS 100U
+
+/**
+ * @brief How frames are spaced.
+ */
+typedef enum ReplayTiming {
+  /** Keep the recorded gaps. */
+  REPLAY_TIMING_ORIGINAL = 0,
+  /** Divide the recorded gaps by speed. */
+  REPLAY_TIMING_SCALED,
+  /** Inject back to back; no time passes between frames. */
+  REPLAY_TIMING_FAST,
+} ReplayTiming;
+
+/**
+ * @brief Replay options.
+ */
+typedef struct ReplayConfig {
+  ReplayTiming timing;
+  /** Speed-up for REPLAY_TIMING_SCALED, such as 10.0. */
+  double speed;
+  /** Passes over the file; 0 means 1. */
+  uint32_t loops;
+  /** Overwrite each frame's destination MAC with the interface's own. */
+  bool rewrite_dst_mac;
+  /** Time to let in-flight frames land before drops are read; 0 picks the default. */
+  uint32_t drain_ms;
+} ReplayConfig;
+
+/**
+ * @brief What a replay did and where frames were lost.
+ */
+typedef struct ReplayReport {
+  /** Frames handed to the interface. */
+  uint64_t packets;
+  /** Bytes handed to the interface. */
+  uint64_t bytes;
+  /** Records cut short by the capture's snap length, not injected. */
+  uint64_t skipped_truncated;
+  /** Records from interfaces that are not Ethernet, not injected. */
+  uint64_t skipped_linktype;
+  /** Wall-clock time spent injecting, excluding the drain. */
+  double wall_sec;
+  /** Simulated time the injection covered (wall-clock time with MAGI_ASYNC). */
+  double sim_sec;
+  /** packets / wall_sec. */
+  double pps;
+  /** Node drops by reason, summed over the topology, during the replay and drain. */
+  uint64_t drops[MAGI_NODE_DROP_REASONS];
+} ReplayReport;
+
+/**
+ * @brief Parse a timing word: "original", "fast", or a speed-up such as "x10" or "10x".
+ *
+ * @param text Timing word.
+ * @param config Updated timing and speed.
+ * @return true on success.
+ */
+bool replay_parse_timing(const char* text, ReplayConfig* config);
+
+/**
+ * @brief Replay a capture file into an interface.
+ *
+ * @param topology Topology whose node drops are reported, or NULL for the interface's node only.
+ * @param iface Interface the frames arrive on.
+ * @param path pcap or pcapng file.
+ * @param config Options, or NULL to replay once at original timing.
+ * @param report Results; filled in even when the file turns out to be damaged part way.
+ * @return MAGI_OK, or MAGI_ERR_BADARGS for an unreadable, unrecognized or damaged file.
+ */
+int replay_run(Topology* topology, Interface* iface, const char* path,
+               const ReplayConfig* config, ReplayReport* report);
+
+#endif
@@ -0,0 +1,331 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "stats_export.h"
+
+#include "core/interface.h"
+#include "core/stats.h"
+#include "utils/log.h"
+#include "utils/magi_error.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct StatsNodeCollectState {
+  const TopologyNodeInfo** items;
+  size_t count;
+  size_t index;
+} StatsNodeCollectState;
+
+static void collect_stats_node(const char* key, void* value, void* ctx) {
+  (void)key;
+
+  StatsNodeCollectState* state = ctx;
+  const TopologyNodeInfo* info = value;
+  if (info != NULL && info->node != NULL && state->index < state->count) {
+    state->items[state->index++] = info;
+  }
+}
+
+static int compare_stats_node(const void* lhs, const void* rhs) {
+  const TopologyNodeInfo* left = *(const TopologyNodeInfo* const*)lhs;
+  const TopologyNodeInfo* right = *(const TopologyNodeInfo* const*)rhs;
+
+  if (left->kind != right->kind) {
+    return (int)left->kind - (int)right->kind;
+  }
+
+  return strcmp(left->node->name, right->node->name);
+}
+
+/**
+ * @brief Collect the topology's nodes in report order.
+ *
+ * @param topology Topology to walk.
+ * @param count_out Number of nodes returned.
+ * @return Array to free(), or NULL when empty or out of memory (magi_errno tells which).
+ */
+static const TopologyNodeInfo** collect_sorted_nodes(const Topology* topology,
+                                                     size_t* count_out) {
+  *count_out = 0U;
+  magi_errno = MAGI_OK;
+  size_t count = topology_count_nodes_of_kind(topology, TOPOLOGY_NODE_HOST) +
+                 topology_count_nodes_of_kind(topology, TOPOLOGY_NODE_SWITCH) +
+                 topology_count_nodes_of_kind(topology, TOPOLOGY_NODE_ROUTER);
+  if (count == 0U) {
+    return NULL;
+  }
+
+  const TopologyNodeInfo** items = calloc(count, sizeof(*items));
+  if (items == NULL) {
+    magi_errno = MAGI_ERR_NOMEM;
+    return NULL;
+  }
+
+  StatsNodeCollectState state = {.items = items, .count = count, .index = 0U};
+  hashmap_foreach(topology->nodes, collect_stats_node, &state);
+  qsort(items, state.index, sizeof(*items), compare_stats_node);
+  *count_out = state.index;
+  return items;
+}
+
+/**
+ * @brief Write a string with JSON escaping, without the quotes.
+ */
+static void write_json_string(FILE* out, const char* text) {
+  for (const unsigned char* cursor = (const unsigned char*)text; *cursor != '\0'; ++cursor) {
+    if (*cursor == '"' || *cursor == '\\') {
+      fputc('\\', out);
+      fputc(*cursor, out);
+    } else if (*cursor < 0x20U) {
+      fprintf(out, "\\u%04x", (unsigned)*cursor);
+    } else {
+      fputc(*cursor, out);
+    }
+  }
+}
+
+/**
+ * @brief Write a string with OpenMetrics label-value escaping.
+ */
+static void write_label_value(FILE* out, const char* text) {
+  for (const char* cursor = text; *cursor != '\0'; ++cursor) {
+    if (*cursor == '"' || *cursor == '\\') {
+      fputc('\\', out);
+      fputc(*cursor, out);
+    } else if (*cursor == '\n') {
+      fputs("\\n", out);
+    } else {
+      fputc(*cursor, out);
+    }
+  }
+}
+
+static void write_json(FILE* out, const TopologyNodeInfo** nodes, size_t count) {
+  fputs("{\n  \"nodes\": [", out);
+  for (size_t index = 0U; index < count; ++index) {
+    const Node* node = nodes[index]->node;
+    fputs(index == 0U ? "\n    {\"name\": \"" : ",\n    {\"name\": \"", out);
+    write_json_string(out, node->name);
+    fprintf(out, "\", \"kind\": \"%s\",\n     ", topology_kind_name(nodes[index]->kind));
+    for (size_t counter = 0U; counter < MAGI_NODE_COUNTER_COUNT; ++counter) {
+      fprintf(out, " \"%s\": %llu,", magi_node_counter_name((MagiNodeCounter)counter),
+              (unsigned long long)magi_counter_read(&node->counters, counter));
+    }
+
+    fputs("\n      \"interfaces\": [", out);
+    for (size_t port = 0U; port < node->iface_count; ++port) {
+      const Interface* iface = node->iface_list[port];
+      fprintf(out, "%s{\"port\": %u", port == 0U ? "\n        " : ",\n        ",
+              (unsigned)iface->port_number);
+      for (size_t counter = 0U; counter < MAGI_IFACE_COUNTER_COUNT; ++counter) {
+        fprintf(out, ", \"%s\": %llu", magi_iface_counter_name((MagiIfaceCounter)counter),
+                (unsigned long long)magi_counter_read(&iface->counters, counter));
+      }
+      fputc('}', out);
+    }
+    fputs(node->iface_count > 0U ? "\n      ]}" : "]}", out);
+  }
+  fputs(count > 0U ? "\n  ]\n}\n" : "]\n}\n", out);
+}
+
+static void write_openmetrics(FILE* out, const TopologyNodeInfo** nodes, size_t count) {
+  for (size_t counter = 0U; counter < MAGI_IFACE_COUNTER_COUNT; ++counter) {
+    const char* name = magi_iface_counter_name((MagiIfaceCounter)counter);
+    fprintf(out, "# TYPE magi_interface_%s counter\n", name);
+    for (size_t index = 0U; index < count; ++index) {
+      const Node* node = nodes[index]->node;
+      for (size_t port = 0U; port < node->iface_count; ++port) {
+        const Interface* iface = node->iface_list[port];
+        fprintf(out, "magi_interface_%s_total{node=\"", name);
+        write_label_value(out, node->name);
+        fprintf(out, "\",port=\"%u\"} %llu\n", (unsigned)iface->port_number,
+                (unsigned long long)magi_counter_read(&iface->counters, counter));
+      }
+    }
+  }
+
+  fputs("# TYPE magi_node_drops counter\n", out);
+  for (size_t index = 0U; index < count; ++index) {
+    const Node* node = nodes[index]->node;
+    for (size_t reason = 0U; reason < MAGI_NODE_DROP_REASONS; ++reason) {
+      fputs("magi_node_drops_total{node=\"", out);
+      write_label_value(out, node->name);
+      fprintf(out, "\",reason=\"%s\"} %llu\n", magi_drop_reason_name((MagiNodeCounter)reason),
+              (unsigned long long)magi_counter_read(&node->counters, reason));
+    }
+  }
+
+  for (size_t counter = MAGI_NODE_DROP_REASONS; counter < MAGI_NODE_COUNTER_COUNT; ++counter) {
+    const char* name = magi_node_counter_name((MagiNodeCounter)counter);
+    fprintf(out, "# TYPE magi_node_%s counter\n", name);
+    for (size_t index = 0U; index < count; ++index) {
+      const Node* node = nodes[index]->node;
+      fprintf(out, "magi_node_%s_total{node=\"", name);
+      write_label_value(out, node->name);
+      fprintf(out, "\"} %llu\n", (unsigned long long)magi_counter_read(&node->counters, counter));
+    }
+  }
+  fputs("# EOF\n", out);
+}
+
+bool topology_stats_parse_format(const char* text, TopologyStatsFormat* out) {
+  if (text == NULL || out == NULL) {
+    return false;
+  }
+
+  if (strcmp(text, "json") == 0) {
+    *out = TOPOLOGY_STATS_JSON;
+    return true;
+  }
+  if (strcmp(text, "openmetrics") == 0 || strcmp(text, "prom") == 0) {
+    *out = TOPOLOGY_STATS_OPENMETRICS;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Print one node's counters and one line per interface.
+ */
+static void print_node_stats(const TopologyNodeInfo* info) {
+  const Node* node = info->node;
+  const MagiCounters* counters = &node->counters;
+  LOG("STATS", "%s %s: drops malformed=%llu vlan=%llu ttl=%llu no_route=%llu acl=%llu "
+               "queue_full=%llu arp hit=%llu miss=%llu fib_lookups=%llu "
+               "flow hit=%llu miss=%llu",
+      topology_kind_name(info->kind), node->name,
+      (unsigned long long)magi_counter_read(counters, MAGI_NODE_DROP_MALFORMED),
+      (unsigned long long)magi_counter_read(counters, MAGI_NODE_DROP_VLAN),
+      (unsigned long long)magi_counter_read(counters, MAGI_NODE_DROP_TTL),
+      (unsigned long long)magi_counter_read(counters, MAGI_NODE_DROP_NO_ROUTE),
+      (unsigned long long)magi_counter_read(counters, MAGI_NODE_DROP_ACL),
+      (unsigned long long)magi_counter_read(counters, MAGI_NODE_DROP_QUEUE_FULL),
+      (unsigned long long)magi_counter_read(counters, MAGI_NODE_ARP_HITS),
+      (unsigned long long)magi_counter_read(counters, MAGI_NODE_ARP_MISSES),
+      (unsigned long long)magi_counter_read(counters, MAGI_NODE_FIB_LOOKUPS),
+      (unsigned long long)magi_counter_read(counters, MAGI_NODE_FLOW_HITS),
+      (unsigned long long)magi_counter_read(counters, MAGI_NODE_FLOW_MISSES));
+
+  for (size_t port = 0U; port < node->iface_count; ++port) {
+    const Interface* iface = node->iface_list[port];
+    LOG("STATS", "  port %u: rx=%llu pkts %llu bytes tx=%llu pkts %llu bytes",
+        (unsigned)iface->port_number,
+        (unsigned long long)magi_counter_read(&iface->counters, MAGI_IFACE_RX_PACKETS),
+        (unsigned long long)magi_counter_read(&iface->counters, MAGI_IFACE_RX_BYTES),
+        (unsigned long long)magi_counter_read(&iface->counters, MAGI_IFACE_TX_PACKETS),
+        (unsigned long long)magi_counter_read(&iface->counters, MAGI_IFACE_TX_BYTES));
+  }
+}
+
+int topology_print_stats(const Topology* topology, const char* node_name) {
+  if (topology == NULL || topology->nodes == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  if (node_name != NULL) {
+    const TopologyNodeInfo* info = topology_get_node_info(topology, node_name);
+    if (info == NULL || info->node == NULL) {
+      magi_errno = MAGI_ERR_BADARGS;
+      return MAGI_ERR_BADARGS;
+    }
+    print_node_stats(info);
+    return MAGI_OK;
+  }
+
+  size_t count = 0U;
+  const TopologyNodeInfo** nodes = collect_sorted_nodes(topology, &count);
+  if (nodes == NULL && magi_errno == MAGI_ERR_NOMEM) {
+    return MAGI_ERR_NOMEM;
+  }
+  if (count == 0U) {
+    LOG("STATS", "Topology is empty");
+  }
+  for (size_t index = 0U; index < count; ++index) {
+    print_node_stats(nodes[index]);
+  }
+  free(nodes);
+  return MAGI_OK;
+}
+
+int topology_write_stats(const Topology* topology, TopologyStatsFormat format, FILE* out) {
+  if (topology == NULL || topology->nodes == NULL || out == NULL ||
+      (format != TOPOLOGY_STATS_JSON && format != TOPOLOGY_STATS_OPENMETRICS)) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  size_t count = 0U;
+  const TopologyNodeInfo** nodes = collect_sorted_nodes(topology, &count);
+  if (nodes == NULL && magi_errno == MAGI_ERR_NOMEM) {
+    return MAGI_ERR_NOMEM;
+  }
+
+  if (format == TOPOLOGY_STATS_JSON) {
+    write_json(out, nodes, count);
+  } else {
+    write_openmetrics(out, nodes, count);
+  }
+  free(nodes);
+  return MAGI_OK;
+}
+
+int topology_export_stats(const Topology* topology, TopologyStatsFormat format,
+                          const char* filename) {
+  if (filename == NULL || strcmp(filename, "-") == 0) {
+    int status = topology_write_stats(topology, format, stdout);
+    fflush(stdout);
+    return status;
+  }
+
+  FILE* file = fopen(filename, "w");
+  if (file == NULL) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  int status = topology_write_stats(topology, format, file);
+  if (fclose(file) != 0 && status == MAGI_OK) {
+    magi_errno = MAGI_ERR_BADARGS;
+    status = MAGI_ERR_BADARGS;
+  }
+  return status;
+}
+
+static void reset_node_stats(const char* key, void* value, void* ctx) {
+  (void)key;
+  (void)ctx;
+
+  TopologyNodeInfo* info = value;
+  if (info == NULL || info->node == NULL) {
+    return;
+  }
+
+  magi_counters_reset(&info->node->counters);
+  for (size_t port = 0U; port < info->node->iface_count; ++port) {
+    magi_counters_reset(&info->node->iface_list[port]->counters);
+  }
+}
+
+static void reset_link_stats(const char* key, void* value, void* ctx) {
+  (void)key;
+  (void)ctx;
+
+  TopologyLinkInfo* info = value;
+  if (info != NULL) {
+    link_reset_stats(info->link);
+  }
+}
+
+void topology_reset_stats(Topology* topology) {
+  if (topology == NULL) {
+    return;
+  }
+
+  if (topology->nodes != NULL) {
+    hashmap_foreach(topology->nodes, reset_node_stats, NULL);
+  }
+  if (topology->links != NULL) {
+    hashmap_foreach(topology->links, reset_link_stats, NULL);
+  }
+}
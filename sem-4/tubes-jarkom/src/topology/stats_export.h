@@ -0,0 +1,73 @@
+/**
+ * @file stats_export.h
+ * @brief Topology-wide counter reports: CLI table, JSON and OpenMetrics text.
+ */
+
+#ifndef MAGI_TOPOLOGY_STATS_EXPORT_H
+#define MAGI_TOPOLOGY_STATS_EXPORT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "topology.h"
+
+/**
+ * @brief Machine-readable counter formats.
+ */
+typedef enum TopologyStatsFormat {
+  /** One JSON document with a nodes array. */
+  TOPOLOGY_STATS_JSON,
+  /** OpenMetrics (Prometheus) text exposition, ending in "# EOF". */
+  TOPOLOGY_STATS_OPENMETRICS
+} TopologyStatsFormat;
+
+/**
+ * @brief Parse a format name: "json", "openmetrics" or "prom".
+ *
+ * @param text Format name.
+ * @param out Parsed format.
+ * @return true on success.
+ */
+bool topology_stats_parse_format(const char* text, TopologyStatsFormat* out);
+
+/**
+ * @brief Print node and interface counters through the log.
+ *
+ * @param topology Topology to report on.
+ * @param node_name Node to show, or NULL for every node.
+ * @return MAGI_OK, or MAGI_ERR_BADARGS if node_name is not in the topology.
+ */
+int topology_print_stats(const Topology* topology, const char* node_name);
+
+/**
+ * @brief Write every node and interface counter to a stream.
+ *
+ * Nodes appear in kind, then name, order and interfaces in port order,
+ * so successive dumps line up.
+ *
+ * @param topology Topology to report on.
+ * @param format Output format.
+ * @param out Destination stream.
+ * @return MAGI_OK, MAGI_ERR_BADARGS, or MAGI_ERR_NOMEM.
+ */
+int topology_write_stats(const Topology* topology, TopologyStatsFormat format, FILE* out);
+
+/**
+ * @brief Write every counter to a file, or to stdout.
+ *
+ * @param topology Topology to report on.
+ * @param format Output format.
+ * @param filename Output path, or NULL or "-" for stdout.
+ * @return MAGI_OK, MAGI_ERR_BADARGS (including an unwritable path), or MAGI_ERR_NOMEM.
+ */
+int topology_export_stats(const Topology* topology, TopologyStatsFormat format,
+                          const char* filename);
+
+/**
+ * @brief Zero every node, interface and link counter.
+ *
+ * @param topology Topology to reset.
+ */
+void topology_reset_stats(Topology* topology);
+
+#endif
@@ -712,9 +712,26 @@ static void print_node_list(const Topology* topology, TopologyNodeKind kind) {
 }
 
 /**
- * @brief Print all links in sorted order.
+ * @brief Print the egress counters of one link direction.
  */
-static void print_links(const Topology* topology) {
+static void print_link_direction(const Link* link, const struct Interface* sender,
+                                 const char* from, uint16_t from_port, const char* to,
+                                 uint16_t to_port) {
+  LinkStats stats = {0};
+  if (link_get_stats(link, sender, &stats) != MAGI_OK) {
+    return;
+  }
+
+  LOG("TOPO", "  %s:%u -> %s:%u tx=%llu pkts %llu bytes drops=%llu queue=%u hwm=%u", from,
+      (unsigned)from_port, to, (unsigned)to_port, (unsigned long long)stats.tx_packets,
+      (unsigned long long)stats.tx_bytes, (unsigned long long)stats.drops,
+      (unsigned)stats.queue_depth, (unsigned)stats.queue_hwm);
+}
+
+/**
+ * @brief Print all links in sorted order, optionally with per-direction counters.
+ */
+static void print_links(const Topology* topology, bool with_stats) {
   if (topology == NULL || topology->links == NULL) {
     return;
   }
@@ -736,16 +753,38 @@ static void print_links(const Topology* topology) {
 
   for (size_t index = 0; index < count; ++index) {
     TopologyLinkInfo* info = items[index];
-    if (info != NULL) {
+    if (info == NULL) {
+      continue;
+    }
+
+    const Link* link = info->link;
+    if (link->bandwidth_bps == 0U) {
       LOG("TOPO", "%s:%u <-> %s:%u delay=%ums mtu=%u", info->node_a, (unsigned)info->port_a,
-          info->node_b, (unsigned)info->port_b, (unsigned)info->link->delay_ms,
-          (unsigned)info->link->mtu);
+          info->node_b, (unsigned)info->port_b, (unsigned)link->delay_ms, (unsigned)link->mtu);
+    } else {
+      char rate[24];
+      link_format_rate(link->bandwidth_bps, rate, sizeof(rate));
+      LOG("TOPO", "%s:%u <-> %s:%u delay=%ums mtu=%u bw=%sbps queue=%s/%u", info->node_a,
+          (unsigned)info->port_a, info->node_b, (unsigned)info->port_b, (unsigned)link->delay_ms,
+          (unsigned)link->mtu, rate, link_queue_kind_name(link->queue.kind),
+          (unsigned)link->queue.limit);
+    }
+
+    if (with_stats) {
+      print_link_direction(link, link->endpoint_a, info->node_a, info->port_a, info->node_b,
+                           info->port_b);
+      print_link_direction(link, link->endpoint_b, info->node_b, info->port_b, info->node_a,
+                           info->port_a);
     }
   }
 
   free(items);
 }
 
+void topology_print_link_stats(const Topology* topology) {
+  print_links(topology, true);
+}
+
 /**
  * @brief Print a human-readable summary of the topology.
  *
@@ -768,7 +807,7 @@ void topology_print(const Topology* topology) {
   LOG("TOPO", "Routers:");
   print_node_list(topology, TOPOLOGY_NODE_ROUTER);
   LOG("TOPO", "Links:");
-  print_links(topology);
+  print_links(topology, false);
 }
 
 /**
@@ -257,6 +257,13 @@ size_t topology_count_links(const Topology* topology);
  */
 void topology_print(const Topology* topology);
 
+/**
+ * @brief Print every link with its egress counters for each direction.
+ *
+ * @param topology Topology instance.
+ */
+void topology_print_link_stats(const Topology* topology);
+
 /**
  * @brief Replace destination topology state with source state.
  *
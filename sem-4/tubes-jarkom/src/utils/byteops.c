@@ -2,66 +2,337 @@
 
 #include "byteops.h"
 
+#include "utils/magi_error.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CHECKSUM_X86 1
+#include <immintrin.h>
+#else
+#define CHECKSUM_X86 0
+#endif
+
+/* Below this the vector setup and reduction cost more than they save. */
+#define CHECKSUM_VECTOR_MIN 64U
+/* Bytes per kernel call; keeps every 64-bit lane far from overflowing. */
+#define CHECKSUM_CHUNK ((size_t)1U << 30U)
+
 /**
- * @brief Fold carry bits back into the low 16 bits of a checksum accumulator.
+ * @brief Sum a buffer in host byte order, optionally copying it on the way.
  *
- * Repeatedly adds any high 16-bit carry into the low 16 bits until the
- * accumulator fits entirely within 16 bits. This is the standard Internet
- * checksum carry-folding step (RFC 1071).
+ * Kernels add the buffer as native-endian words into 64-bit accumulators and
+ * leave folding to the caller. The one's complement sum does not depend on
+ * byte order apart from a final byte swap (RFC 1071, section 2), so this is
+ * exact on either endianness.
  *
- * @param sum The 32-bit accumulator from 16-bit word summation.
- * @return Folded 32-bit value with the top 16 bits zeroed.
+ * @param dst Copy destination, or NULL to only sum.
+ * @param src Bytes to sum.
+ * @param len Length in bytes.
+ * @return Unfolded sum.
  */
-static uint32_t fold_sum(uint32_t sum) {
-  while ((sum >> 16U) != 0U) {
-    sum = (sum & 0xFFFFU) + (sum >> 16U);
-  }
+typedef uint64_t (*ChecksumKernelFn)(uint8_t* dst, const uint8_t* src, size_t len);
 
-  return sum;
+/**
+ * @brief Fold carry bits back into the low 16 bits of a checksum accumulator.
+ *
+ * Adds the high halves into the low ones, 64 to 32 bits and then 32 to 16,
+ * until the accumulator fits entirely within 16 bits. This is the standard
+ * Internet checksum carry-folding step (RFC 1071); the fixed steps avoid a
+ * data-dependent loop.
+ *
+ * @param sum The 64-bit accumulator from word summation.
+ * @return Folded value with everything above the low 16 bits zeroed.
+ */
+static uint32_t fold_sum(uint64_t sum) {
+  sum = (sum & 0xFFFFFFFFU) + (sum >> 32U);
+  sum = (sum & 0xFFFFFFFFU) + (sum >> 32U);
+  sum = (sum & 0xFFFFU) + (sum >> 16U);
+  sum = (sum & 0xFFFFU) + (sum >> 16U);
+  return (uint32_t)sum;
 }
 
 /**
- * @brief Accumulate big-endian 16-bit words from a data buffer into a checksum sum.
+ * @brief Add a 64-bit word with end-around carry.
  *
- * Processes the data two bytes at a time, interpreting each adjacent pair as
- * a big-endian uint16_t and adding it to the accumulator. A trailing odd byte
- * is zero-padded to 16 bits. Carry is folded after each addition to prevent
- * accumulator overflow.
+ * 2^64 is 1 modulo 0xFFFF, so a carry out of bit 63 is added back in at
+ * bit 0. The sum cannot carry twice.
  *
- * @param sum  Initial accumulator value (typically 0).
- * @param data Pointer to the data buffer.
- * @param len  Length of the data buffer in bytes.
- * @return Accumulated checksum sum (may still contain carries from the
- *         final word — caller should fold or finalize).
+ * @param sum Accumulator.
+ * @param word Word to add.
+ * @return Updated accumulator.
  */
-static uint32_t accumulate_words(uint32_t sum, const uint8_t* data, size_t len) {
-  while (len >= 2U) {
-    sum += (uint32_t)(((uint16_t)data[0] << 8) | (uint16_t)data[1]);
-    sum = fold_sum(sum);
-    data += 2U;
-    len -= 2U;
+static inline uint64_t add_carry64(uint64_t sum, uint64_t word) {
+  sum += word;
+  return sum + (sum < word);
+}
+
+/**
+ * @brief Sum the last few bytes of a buffer, handling a trailing odd byte.
+ *
+ * @param dst Copy destination, or NULL.
+ * @param src Bytes to sum; fewer than 16.
+ * @param len Length in bytes.
+ * @return Unfolded host-order sum.
+ */
+static uint64_t checksum_tail(uint8_t* dst, const uint8_t* src, size_t len) {
+  uint64_t sum = 0U;
+  if (dst != NULL) {
+    memcpy(dst, src, len);
   }
 
+  while (len >= 4U) {
+    uint32_t word;
+    memcpy(&word, src, sizeof(word));
+    sum += word;
+    src += 4U;
+    len -= 4U;
+  }
+  if (len >= 2U) {
+    uint16_t word;
+    memcpy(&word, src, sizeof(word));
+    sum += word;
+    src += 2U;
+    len -= 2U;
+  }
   if (len == 1U) {
-    sum += (uint32_t)((uint16_t)data[0] << 8);
-    sum = fold_sum(sum);
+    /* The odd byte is the high half of a zero-padded big-endian word. */
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    sum += src[0];
+#else
+    sum += (uint64_t)src[0] << 8U;
+#endif
   }
 
   return sum;
 }
 
 /**
- * @brief Finalize an Internet checksum from a folded accumulator.
+ * @brief Portable kernel: two 64-bit words per step with end-around carry.
+ *
+ * @param dst Copy destination, or NULL.
+ * @param src Bytes to sum.
+ * @param len Length in bytes.
+ * @return Unfolded host-order sum.
+ */
+static uint64_t checksum_portable(uint8_t* dst, const uint8_t* src, size_t len) {
+  uint64_t sum0 = 0U;
+  uint64_t sum1 = 0U;
+  while (len >= 16U) {
+    uint64_t lo;
+    uint64_t hi;
+    memcpy(&lo, src, sizeof(lo));
+    memcpy(&hi, src + 8U, sizeof(hi));
+    if (dst != NULL) {
+      memcpy(dst, src, 16U);
+      dst += 16U;
+    }
+    sum0 = add_carry64(sum0, lo);
+    sum1 = add_carry64(sum1, hi);
+    src += 16U;
+    len -= 16U;
+  }
+
+  uint64_t sum = add_carry64(sum0, sum1);
+  return add_carry64(sum, checksum_tail(dst, src, len));
+}
+
+#if CHECKSUM_X86
+/**
+ * @brief SSE2 kernel: widens 32-bit words into two 64-bit lanes, 32 bytes per step.
+ *
+ * @param dst Copy destination, or NULL.
+ * @param src Bytes to sum.
+ * @param len Length in bytes; at most CHECKSUM_CHUNK.
+ * @return Unfolded host-order sum.
+ */
+__attribute__((target("sse2"))) static uint64_t checksum_sse2(uint8_t* dst, const uint8_t* src,
+                                                              size_t len) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc0 = zero;
+  __m128i acc1 = zero;
+  while (len >= 32U) {
+    __m128i first = _mm_loadu_si128((const __m128i*)src);
+    __m128i second = _mm_loadu_si128((const __m128i*)(src + 16U));
+    if (dst != NULL) {
+      _mm_storeu_si128((__m128i*)dst, first);
+      _mm_storeu_si128((__m128i*)(dst + 16U), second);
+      dst += 32U;
+    }
+    acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(first, zero));
+    acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(first, zero));
+    acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(second, zero));
+    acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(second, zero));
+    src += 32U;
+    len -= 32U;
+  }
+
+  uint64_t lanes[2];
+  _mm_storeu_si128((__m128i*)lanes, _mm_add_epi64(acc0, acc1));
+  uint64_t sum = add_carry64(lanes[0], lanes[1]);
+  return add_carry64(sum, checksum_portable(dst, src, len));
+}
+
+/**
+ * @brief AVX2 kernel: as the SSE2 one with four 64-bit lanes, 64 bytes per step.
  *
- * Performs a final carry fold and then takes the one's complement
- * to produce the 16-bit Internet checksum value ready for wire placement.
+ * @param dst Copy destination, or NULL.
+ * @param src Bytes to sum.
+ * @param len Length in bytes; at most CHECKSUM_CHUNK.
+ * @return Unfolded host-order sum.
+ */
+__attribute__((target("avx2"))) static uint64_t checksum_avx2(uint8_t* dst, const uint8_t* src,
+                                                              size_t len) {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i acc0 = zero;
+  __m256i acc1 = zero;
+  while (len >= 64U) {
+    __m256i first = _mm256_loadu_si256((const __m256i*)src);
+    __m256i second = _mm256_loadu_si256((const __m256i*)(src + 32U));
+    if (dst != NULL) {
+      _mm256_storeu_si256((__m256i*)dst, first);
+      _mm256_storeu_si256((__m256i*)(dst + 32U), second);
+      dst += 64U;
+    }
+    acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(first, zero));
+    acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(first, zero));
+    acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(second, zero));
+    acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(second, zero));
+    src += 64U;
+    len -= 64U;
+  }
+
+  uint64_t lanes[4];
+  _mm256_storeu_si256((__m256i*)lanes, _mm256_add_epi64(acc0, acc1));
+  uint64_t sum = add_carry64(add_carry64(lanes[0], lanes[1]), add_carry64(lanes[2], lanes[3]));
+  return add_carry64(sum, checksum_portable(dst, src, len));
+}
+#endif
+
+static const struct {
+  const char* name;
+  ChecksumKernelFn fn;
+} checksum_kernels[CHECKSUM_KERNEL_COUNT] = {
+    [CHECKSUM_KERNEL_PORTABLE] = {"portable", checksum_portable},
+#if CHECKSUM_X86
+    [CHECKSUM_KERNEL_SSE2] = {"sse2", checksum_sse2},
+    [CHECKSUM_KERNEL_AVX2] = {"avx2", checksum_avx2},
+#else
+    [CHECKSUM_KERNEL_SSE2] = {"sse2", NULL},
+    [CHECKSUM_KERNEL_AVX2] = {"avx2", NULL},
+#endif
+};
+
+/* Index into checksum_kernels, or -1 until the first checksum picks one. */
+static atomic_int checksum_active = -1;
+
+bool checksum_kernel_supported(ChecksumKernel kernel) {
+  if ((unsigned)kernel >= CHECKSUM_KERNEL_COUNT || checksum_kernels[kernel].fn == NULL) {
+    return false;
+  }
+
+#if CHECKSUM_X86
+  /* Reads CPUID, including whether the OS saves the AVX registers. */
+  __builtin_cpu_init();
+  if (kernel == CHECKSUM_KERNEL_AVX2) {
+    return __builtin_cpu_supports("avx2");
+  }
+  if (kernel == CHECKSUM_KERNEL_SSE2) {
+    return __builtin_cpu_supports("sse2");
+  }
+#endif
+  return true;
+}
+
+int checksum_set_kernel(ChecksumKernel kernel) {
+  if (!checksum_kernel_supported(kernel)) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  atomic_store_explicit(&checksum_active, (int)kernel, memory_order_relaxed);
+  return MAGI_OK;
+}
+
+ChecksumKernel checksum_get_kernel(void) {
+  int active = atomic_load_explicit(&checksum_active, memory_order_relaxed);
+  if (active >= 0) {
+    return (ChecksumKernel)active;
+  }
+
+  /* Threads racing here all pick the same kernel, so either store wins. */
+  ChecksumKernel best = CHECKSUM_KERNEL_PORTABLE;
+  for (int kernel = CHECKSUM_KERNEL_COUNT - 1; kernel > CHECKSUM_KERNEL_PORTABLE; --kernel) {
+    if (checksum_kernel_supported((ChecksumKernel)kernel)) {
+      best = (ChecksumKernel)kernel;
+      break;
+    }
+  }
+  atomic_store_explicit(&checksum_active, (int)best, memory_order_relaxed);
+  return best;
+}
+
+const char* checksum_kernel_name(ChecksumKernel kernel) {
+  if ((unsigned)kernel >= CHECKSUM_KERNEL_COUNT) {
+    return "unknown";
+  }
+
+  return checksum_kernels[kernel].name;
+}
+
+/**
+ * @brief Sum (and optionally copy) a buffer and add it to a running sum.
  *
- * @param sum The folded accumulator (carries already resolved to low 16 bits).
- * @return The 16-bit one's complement checksum.
+ * @param sum Running network-order sum.
+ * @param dst Copy destination, or NULL.
+ * @param src Bytes to sum.
+ * @param len Length in bytes.
+ * @return Updated sum, folded to 16 bits.
  */
-static uint16_t finalize_checksum(uint32_t sum) {
-  sum = fold_sum(sum);
-  return (uint16_t)~sum;
+static uint32_t checksum_accumulate(uint32_t sum, uint8_t* dst, const uint8_t* src, size_t len) {
+  uint64_t native = 0U;
+  if (len < CHECKSUM_VECTOR_MIN) {
+    native = checksum_portable(dst, src, len);
+  } else {
+    ChecksumKernelFn fn = checksum_kernels[checksum_get_kernel()].fn;
+    while (len > 0U) {
+      /* The chunk size is even, so every chunk after the first starts on a word boundary. */
+      size_t chunk = len < CHECKSUM_CHUNK ? len : CHECKSUM_CHUNK;
+      native = add_carry64(native, fn(dst, src, chunk));
+      if (dst != NULL) {
+        dst += chunk;
+      }
+      src += chunk;
+      len -= chunk;
+    }
+  }
+
+  uint32_t folded = fold_sum(native);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  folded = ((folded >> 8U) | (folded << 8U)) & 0xFFFFU;
+#endif
+  return fold_sum((uint64_t)sum + folded);
+}
+
+uint32_t checksum_partial(uint32_t sum, const uint8_t* data, size_t len) {
+  if (data == NULL) {
+    return sum;
+  }
+
+  return checksum_accumulate(sum, NULL, data, len);
+}
+
+uint32_t checksum_copy_partial(uint32_t sum, uint8_t* dst, const uint8_t* src, size_t len) {
+  if (dst == NULL || src == NULL) {
+    return sum;
+  }
+
+  return checksum_accumulate(sum, dst, src, len);
+}
+
+uint16_t checksum_finish(uint32_t sum) {
+  return (uint16_t)~fold_sum(sum);
 }
 
 uint16_t ipv4_checksum(const uint8_t* header, size_t len) {
@@ -69,20 +340,22 @@ uint16_t ipv4_checksum(const uint8_t* header, size_t len) {
     return 0U;
   }
 
-  return finalize_checksum(accumulate_words(0U, header, len));
+  return checksum_finish(checksum_partial(0U, header, len));
 }
 
 uint16_t transport_checksum(const uint8_t* pseudo_hdr, size_t ph_len, const uint8_t* segment,
                             size_t seg_len) {
-  uint32_t sum = 0U;
-
-  if (pseudo_hdr != NULL) {
-    sum = accumulate_words(sum, pseudo_hdr, ph_len);
-  }
+  uint32_t sum = checksum_partial(0U, pseudo_hdr, ph_len);
+  return checksum_finish(checksum_partial(sum, segment, seg_len));
+}
 
-  if (segment != NULL) {
-    sum = accumulate_words(sum, segment, seg_len);
-  }
+uint16_t checksum_adjust16(uint16_t cksum, uint16_t old_word, uint16_t new_word) {
+  /* HC' = ~(~HC + ~m + m'), which avoids the -0 corner case of the RFC 1141 form */
+  uint32_t sum = (uint32_t)(uint16_t)~cksum + (uint32_t)(uint16_t)~old_word + new_word;
+  return checksum_finish(sum);
+}
 
-  return finalize_checksum(sum);
-}
\ No newline at end of file
+uint16_t checksum_adjust32(uint16_t cksum, uint32_t old_value, uint32_t new_value) {
+  cksum = checksum_adjust16(cksum, (uint16_t)(old_value >> 16U), (uint16_t)(new_value >> 16U));
+  return checksum_adjust16(cksum, (uint16_t)old_value, (uint16_t)new_value);
+}
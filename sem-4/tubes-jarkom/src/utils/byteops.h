@@ -1,11 +1,17 @@
 /**
  * @file byteops.h
  * @brief Endian-safe byte helpers and checksum utilities.
+ *
+ * Checksums are summed by a kernel picked once at runtime from the CPU's
+ * features (AVX2, SSE2, or a portable 64-bit loop). Every kernel gives the
+ * same result bit for bit; checksum_set_kernel() exists so benchmarks can
+ * compare them.
  */
 
 #ifndef MAGI_UTILS_BYTEOPS_H
 #define MAGI_UTILS_BYTEOPS_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -32,6 +38,14 @@
   ((uint32_t)((uint32_t)(buf)[(off)] << 24) | (uint32_t)((uint32_t)(buf)[(off) + 1U] << 16) |      \
    (uint32_t)((uint32_t)(buf)[(off) + 2U] << 8) | (uint32_t)(buf)[(off) + 3U])
 
+/** @brief Checksum summing kernels, in order of preference. */
+typedef enum ChecksumKernel {
+  CHECKSUM_KERNEL_PORTABLE,
+  CHECKSUM_KERNEL_SSE2,
+  CHECKSUM_KERNEL_AVX2,
+  CHECKSUM_KERNEL_COUNT
+} ChecksumKernel;
+
 /**
  * @brief Compute IPv4 header checksum.
  *
@@ -53,4 +67,87 @@ uint16_t ipv4_checksum(const uint8_t* header, size_t len);
 uint16_t transport_checksum(const uint8_t* pseudo_hdr, size_t ph_len, const uint8_t* segment,
                             size_t seg_len);
 
+/**
+ * @brief Add a buffer to a running one's complement sum.
+ *
+ * Each buffer is summed as if zero-padded to an even length, so only the
+ * last piece of a checksummed region may have an odd length.
+ *
+ * @param sum Running sum; 0 to start.
+ * @param data Bytes to add.
+ * @param len Length in bytes.
+ * @return Updated sum, folded to 16 bits, for checksum_finish().
+ */
+uint32_t checksum_partial(uint32_t sum, const uint8_t* data, size_t len);
+
+/**
+ * @brief Copy a buffer and add it to a running sum in the same pass.
+ *
+ * @param sum Running sum; 0 to start.
+ * @param dst Destination; must not overlap src.
+ * @param src Bytes to copy and add.
+ * @param len Length in bytes.
+ * @return Updated sum, as checksum_partial() would give for the copied bytes.
+ */
+uint32_t checksum_copy_partial(uint32_t sum, uint8_t* dst, const uint8_t* src, size_t len);
+
+/**
+ * @brief Turn a running sum into the checksum to store.
+ *
+ * @param sum Sum from checksum_partial() or checksum_copy_partial().
+ * @return The 16-bit one's complement checksum.
+ */
+uint16_t checksum_finish(uint32_t sum);
+
+/**
+ * @brief Report whether this build and CPU can run a kernel.
+ *
+ * @param kernel Kernel to check.
+ * @return true if checksum_set_kernel() would accept it.
+ */
+bool checksum_kernel_supported(ChecksumKernel kernel);
+
+/**
+ * @brief Force a summing kernel instead of the one picked at startup.
+ *
+ * @param kernel Kernel to use.
+ * @return MAGI_OK, or MAGI_ERR_BADARGS if the kernel is not supported here.
+ */
+int checksum_set_kernel(ChecksumKernel kernel);
+
+/**
+ * @brief Kernel checksums currently go through.
+ *
+ * @return Active kernel.
+ */
+ChecksumKernel checksum_get_kernel(void);
+
+/**
+ * @brief Short name of a kernel for logs and benchmark output.
+ *
+ * @param kernel Kernel.
+ * @return Static name, or "unknown".
+ */
+const char* checksum_kernel_name(ChecksumKernel kernel);
+
+/**
+ * @brief Update a checksum for one changed 16-bit word (RFC 1624 eqn. 3).
+ *
+ * @param cksum Checksum as stored in the header.
+ * @param old_word Word before the change.
+ * @param new_word Word after the change.
+ * @return Checksum covering the new word.
+ */
+uint16_t checksum_adjust16(uint16_t cksum, uint16_t old_word, uint16_t new_word);
+
+/**
+ * @brief Update a checksum for one changed 32-bit field, such as an IPv4 address.
+ *
+ * @param cksum Checksum as stored in the header.
+ * @param old_value Field before the change.
+ * @param new_value Field after the change.
+ * @return Checksum covering the new field.
+ */
+uint16_t checksum_adjust32(uint16_t cksum, uint32_t old_value, uint32_t new_value);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,363 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "log.h"
+
+#include "utils/magi_error.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+/** Drain thread sleep when the ring is empty. */
+#define MAGI_LOG_IDLE_NS 1000000L
+/** Longest accepted level spec. */
+#define MAGI_LOG_SPEC_MAX 128U
+
+/**
+ * @brief One ring slot.
+ *
+ * seq implements a bounded MPMC sequence: a producer may fill the slot
+ * when seq equals its ticket, and publishes it by storing ticket + 1; the
+ * drain thread empties it when seq equals head + 1 and hands it to the
+ * next lap by storing head + MAGI_LOG_RING_SLOTS.
+ */
+typedef struct MagiLogSlot {
+  atomic_size_t seq;
+  uint8_t level;
+  uint16_t len;
+  char text[MAGI_LOG_LINE_MAX];
+} MagiLogSlot;
+
+_Atomic uint8_t magi_log_levels[MAGI_LOG_SUBSYS_COUNT] = {
+    MAGI_LOG_INFO, MAGI_LOG_INFO, MAGI_LOG_INFO, MAGI_LOG_INFO, MAGI_LOG_INFO, MAGI_LOG_INFO,
+};
+
+static const char* const magi_log_level_names[] = {"error", "warn", "info", "debug"};
+static const char* const magi_log_subsys_names[] = {"core", "l2", "l3", "l4", "l7", "cli"};
+
+static MagiLogSlot magi_log_ring[MAGI_LOG_RING_SLOTS];
+static atomic_size_t magi_log_tail;
+static atomic_uint magi_log_mode = MAGI_LOG_SINK_SYNC;
+static atomic_uint_fast64_t magi_log_drop_total;
+static atomic_uint_fast64_t magi_log_drop_pending;
+
+/* Consumer side: the drain thread and magi_log_flush() take drain_lock. */
+static pthread_mutex_t magi_log_drain_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t magi_log_head;
+static bool magi_log_ring_ready;
+
+/* Drain thread lifecycle, guarded by control_lock. */
+static pthread_mutex_t magi_log_control_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t magi_log_thread;
+static bool magi_log_thread_running;
+static atomic_bool magi_log_stop;
+static bool magi_log_atexit_registered;
+
+/**
+ * @brief Reserve a slot, format the line into it and publish it.
+ *
+ * @param level Line level.
+ * @param fmt printf format.
+ * @param args Format arguments.
+ * @return true if queued, false if the ring was full.
+ */
+static bool magi_log_ring_push(MagiLogLevel level, const char* fmt, va_list args) {
+  size_t pos = atomic_load_explicit(&magi_log_tail, memory_order_relaxed);
+  MagiLogSlot* slot;
+  for (;;) {
+    slot = &magi_log_ring[pos & (MAGI_LOG_RING_SLOTS - 1U)];
+    size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (seq == pos) {
+      if (atomic_compare_exchange_weak_explicit(&magi_log_tail, &pos, pos + 1U,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if ((ptrdiff_t)(seq - pos) < 0) {
+      return false;
+    } else {
+      pos = atomic_load_explicit(&magi_log_tail, memory_order_relaxed);
+    }
+  }
+
+  int written = vsnprintf(slot->text, sizeof(slot->text), fmt, args);
+  size_t len = written > 0 ? (size_t)written : 0U;
+  if (len >= sizeof(slot->text)) {
+    len = sizeof(slot->text) - 1U;
+    slot->text[len - 1U] = '\n';
+  }
+  slot->len = (uint16_t)len;
+  slot->level = (uint8_t)level;
+  atomic_store_explicit(&slot->seq, pos + 1U, memory_order_release);
+  return true;
+}
+
+/**
+ * @brief Write out every published slot in order. Caller holds drain_lock.
+ *
+ * @return Number of lines written.
+ */
+static size_t magi_log_ring_drain_locked(void) {
+  size_t drained = 0U;
+  bool to_err = false;
+  for (;;) {
+    MagiLogSlot* slot = &magi_log_ring[magi_log_head & (MAGI_LOG_RING_SLOTS - 1U)];
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != magi_log_head + 1U) {
+      break;
+    }
+    bool err = slot->level <= MAGI_LOG_WARN;
+    fwrite(slot->text, 1U, slot->len, err ? stderr : stdout);
+    to_err = to_err || err;
+    atomic_store_explicit(&slot->seq, magi_log_head + MAGI_LOG_RING_SLOTS, memory_order_release);
+    magi_log_head++;
+    drained++;
+  }
+
+  uint64_t dropped = atomic_exchange_explicit(&magi_log_drop_pending, 0U, memory_order_relaxed);
+  if (dropped > 0U) {
+    fprintf(stderr, "[LOG][WARN] ring full, dropped %llu lines\n", (unsigned long long)dropped);
+    to_err = true;
+  }
+  if (drained > 0U) {
+    fflush(stdout);
+  }
+  if (to_err) {
+    fflush(stderr);
+  }
+  return drained;
+}
+
+/**
+ * @brief Drain thread: empty the ring, sleeping briefly whenever it is idle.
+ *
+ * @param arg Unused.
+ * @return NULL.
+ */
+static void* magi_log_thread_main(void* arg) {
+  (void)arg;
+  const struct timespec idle = {.tv_sec = 0, .tv_nsec = MAGI_LOG_IDLE_NS};
+  while (!atomic_load_explicit(&magi_log_stop, memory_order_acquire)) {
+    pthread_mutex_lock(&magi_log_drain_lock);
+    size_t drained = magi_log_ring_drain_locked();
+    pthread_mutex_unlock(&magi_log_drain_lock);
+    if (drained == 0U) {
+      nanosleep(&idle, NULL);
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Stop the drain thread if it runs. Caller holds control_lock.
+ */
+static void magi_log_stop_thread_locked(void) {
+  if (!magi_log_thread_running) {
+    return;
+  }
+  atomic_store_explicit(&magi_log_stop, true, memory_order_release);
+  pthread_join(magi_log_thread, NULL);
+  magi_log_thread_running = false;
+}
+
+/**
+ * @brief atexit hook: write out anything still queued.
+ */
+static void magi_log_at_exit(void) {
+  (void)magi_log_set_sink(MAGI_LOG_SINK_SYNC);
+}
+
+/**
+ * @brief Parse a level name.
+ *
+ * @param text Name such as "debug".
+ * @param len Length of text.
+ * @param out Parsed level.
+ * @return true on success.
+ */
+static bool magi_log_parse_level(const char* text, size_t len, MagiLogLevel* out) {
+  for (size_t index = 0U; index <= MAGI_LOG_DEBUG; ++index) {
+    const char* name = magi_log_level_names[index];
+    if (strlen(name) == len && strncasecmp(text, name, len) == 0) {
+      *out = (MagiLogLevel)index;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Parse a subsystem name.
+ *
+ * @param text Name such as "l3".
+ * @param len Length of text.
+ * @param out Parsed subsystem.
+ * @return true on success.
+ */
+static bool magi_log_parse_subsys(const char* text, size_t len, MagiLogSubsys* out) {
+  for (size_t index = 0U; index < MAGI_LOG_SUBSYS_COUNT; ++index) {
+    const char* name = magi_log_subsys_names[index];
+    if (strlen(name) == len && strncasecmp(text, name, len) == 0) {
+      *out = (MagiLogSubsys)index;
+      return true;
+    }
+  }
+  return false;
+}
+
+void magi_log_write(MagiLogLevel level, const char* fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  if (atomic_load_explicit(&magi_log_mode, memory_order_relaxed) == MAGI_LOG_SINK_RING) {
+    if (!magi_log_ring_push(level, fmt, args)) {
+      atomic_fetch_add_explicit(&magi_log_drop_total, 1U, memory_order_relaxed);
+      atomic_fetch_add_explicit(&magi_log_drop_pending, 1U, memory_order_relaxed);
+    }
+  } else {
+    FILE* stream = level <= MAGI_LOG_WARN ? stderr : stdout;
+    vfprintf(stream, fmt, args);
+    fflush(stream);
+  }
+  va_end(args);
+}
+
+void magi_log_set_level(MagiLogSubsys subsys, MagiLogLevel level) {
+  if ((unsigned)subsys >= MAGI_LOG_SUBSYS_COUNT || (unsigned)level > MAGI_LOG_DEBUG) {
+    return;
+  }
+  atomic_store_explicit(&magi_log_levels[subsys], (uint8_t)level, memory_order_relaxed);
+}
+
+MagiLogLevel magi_log_level(MagiLogSubsys subsys) {
+  if ((unsigned)subsys >= MAGI_LOG_SUBSYS_COUNT) {
+    return MAGI_LOG_INFO;
+  }
+  return (MagiLogLevel)atomic_load_explicit(&magi_log_levels[subsys], memory_order_relaxed);
+}
+
+int magi_log_apply_spec(const char* spec) {
+  if (spec == NULL || strlen(spec) >= MAGI_LOG_SPEC_MAX) {
+    magi_errno = MAGI_ERR_BADARGS;
+    return MAGI_ERR_BADARGS;
+  }
+
+  /* Validate into a copy first so a bad entry changes nothing. */
+  MagiLogLevel levels[MAGI_LOG_SUBSYS_COUNT];
+  for (size_t index = 0U; index < MAGI_LOG_SUBSYS_COUNT; ++index) {
+    levels[index] = magi_log_level((MagiLogSubsys)index);
+  }
+
+  const char* cursor = spec;
+  for (;;) {
+    const char* end = strchr(cursor, ',');
+    size_t len = end != NULL ? (size_t)(end - cursor) : strlen(cursor);
+    const char* eq = memchr(cursor, '=', len);
+    MagiLogLevel level;
+    if (eq == NULL) {
+      if (!magi_log_parse_level(cursor, len, &level)) {
+        magi_errno = MAGI_ERR_BADARGS;
+        return MAGI_ERR_BADARGS;
+      }
+      for (size_t index = 0U; index < MAGI_LOG_SUBSYS_COUNT; ++index) {
+        if (index != MAGI_LOG_CLI) {
+          levels[index] = level;
+        }
+      }
+    } else {
+      MagiLogSubsys subsys;
+      size_t name_len = (size_t)(eq - cursor);
+      if (!magi_log_parse_subsys(cursor, name_len, &subsys) ||
+          !magi_log_parse_level(eq + 1, len - name_len - 1U, &level)) {
+        magi_errno = MAGI_ERR_BADARGS;
+        return MAGI_ERR_BADARGS;
+      }
+      levels[subsys] = level;
+    }
+    if (end == NULL) {
+      break;
+    }
+    cursor = end + 1;
+  }
+
+  for (size_t index = 0U; index < MAGI_LOG_SUBSYS_COUNT; ++index) {
+    magi_log_set_level((MagiLogSubsys)index, levels[index]);
+  }
+  return MAGI_OK;
+}
+
+int magi_log_set_sink(MagiLogSink sink) {
+  pthread_mutex_lock(&magi_log_control_lock);
+  if (sink == MAGI_LOG_SINK_RING) {
+    if (!magi_log_ring_ready) {
+      for (size_t index = 0U; index < MAGI_LOG_RING_SLOTS; ++index) {
+        atomic_init(&magi_log_ring[index].seq, index);
+      }
+      magi_log_ring_ready = true;
+    }
+    if (!magi_log_thread_running) {
+      atomic_store_explicit(&magi_log_stop, false, memory_order_relaxed);
+      if (pthread_create(&magi_log_thread, NULL, magi_log_thread_main, NULL) != 0) {
+        pthread_mutex_unlock(&magi_log_control_lock);
+        magi_errno = MAGI_ERR_NOMEM;
+        return MAGI_ERR_NOMEM;
+      }
+      magi_log_thread_running = true;
+      if (!magi_log_atexit_registered) {
+        magi_log_atexit_registered = atexit(magi_log_at_exit) == 0;
+      }
+    }
+    atomic_store_explicit(&magi_log_mode, MAGI_LOG_SINK_RING, memory_order_release);
+  } else {
+    atomic_store_explicit(&magi_log_mode, MAGI_LOG_SINK_SYNC, memory_order_release);
+    magi_log_stop_thread_locked();
+    magi_log_flush();
+  }
+  pthread_mutex_unlock(&magi_log_control_lock);
+  return MAGI_OK;
+}
+
+MagiLogSink magi_log_sink(void) {
+  return (MagiLogSink)atomic_load_explicit(&magi_log_mode, memory_order_acquire);
+}
+
+void magi_log_flush(void) {
+  pthread_mutex_lock(&magi_log_drain_lock);
+  if (magi_log_ring_ready) {
+    (void)magi_log_ring_drain_locked();
+  }
+  pthread_mutex_unlock(&magi_log_drain_lock);
+}
+
+uint64_t magi_log_dropped(void) {
+  return atomic_load_explicit(&magi_log_drop_total, memory_order_relaxed);
+}
+
+void magi_log_init_from_env(void) {
+  const char* spec = getenv("MAGI_LOG_LEVEL");
+  if (spec != NULL && spec[0] != '\0' && magi_log_apply_spec(spec) != MAGI_OK) {
+    LOG_WARN("LOG", "ignoring invalid MAGI_LOG_LEVEL '%s'", spec);
+  }
+
+  const char* sink = getenv("MAGI_LOG_SINK");
+  if (sink == NULL || sink[0] == '\0' || strcasecmp(sink, "sync") == 0) {
+    return;
+  }
+  if (strcasecmp(sink, "ring") == 0) {
+    if (magi_log_set_sink(MAGI_LOG_SINK_RING) != MAGI_OK) {
+      LOG_WARN("LOG", "could not start the ring sink; staying synchronous");
+    }
+    return;
+  }
+  LOG_WARN("LOG", "ignoring invalid MAGI_LOG_SINK '%s'", sink);
+}
+
+const char* magi_log_level_name(MagiLogLevel level) {
+  return (unsigned)level <= MAGI_LOG_DEBUG ? magi_log_level_names[level] : "?";
+}
+
+const char* magi_log_subsys_name(MagiLogSubsys subsys) {
+  return (unsigned)subsys < MAGI_LOG_SUBSYS_COUNT ? magi_log_subsys_names[subsys] : "?";
+}
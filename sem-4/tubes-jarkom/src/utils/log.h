@@ -1,35 +1,209 @@
 /**
  * @file log.h
- * @brief Lightweight logging macros for stdout/stderr.
+ * @brief Leveled, per-subsystem logging with a synchronous or ring-buffer sink.
+ *
+ * Every line has a level (error, warn, info, debug) and belongs to the
+ * subsystem of the file that emitted it: a translation unit defines
+ * MAGI_LOG_SUBSYS (for example MAGI_LOG_L3) before including this header,
+ * otherwise it logs as MAGI_LOG_CORE. A line is emitted only if its level
+ * is at most MAGI_LOG_COMPILE_LEVEL, which removes it from the build
+ * entirely, and at most the run-time level of its subsystem, which costs
+ * one relaxed load when it is filtered out.
+ *
+ * The synchronous sink (the default) writes and flushes each line on the
+ * calling thread, which keeps output interleaved with the CLI. The ring
+ * sink formats the line into a lock-free in-memory ring and returns; a
+ * background thread writes the ring out in batches. When the ring is
+ * full, lines are dropped and counted rather than blocking the caller.
+ *
+ * Output format is [node] message for info and debug lines on stdout, and
+ * [node][WARN] or [node][ERROR] message on stderr.
  */
 
 #ifndef MAGI_UTILS_LOG_H
 #define MAGI_UTILS_LOG_H
 
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
+/** @brief Log severities, most severe first. */
+typedef enum MagiLogLevel {
+  MAGI_LOG_ERROR = 0,
+  MAGI_LOG_WARN = 1,
+  MAGI_LOG_INFO = 2,
+  MAGI_LOG_DEBUG = 3,
+} MagiLogLevel;
+
+/** @brief Subsystems with independent run-time levels. */
+typedef enum MagiLogSubsys {
+  /** Core, topology and anything that does not set MAGI_LOG_SUBSYS. */
+  MAGI_LOG_CORE = 0,
+  MAGI_LOG_L2 = 1,
+  MAGI_LOG_L3 = 2,
+  MAGI_LOG_L4 = 3,
+  MAGI_LOG_L7 = 4,
+  /** Replies to CLI commands; bare levels in a spec leave it alone. */
+  MAGI_LOG_CLI = 5,
+  MAGI_LOG_SUBSYS_COUNT = 6,
+} MagiLogSubsys;
+
+/** @brief Where log lines go. */
+typedef enum MagiLogSink {
+  /** Write and flush on the calling thread. */
+  MAGI_LOG_SINK_SYNC = 0,
+  /** Queue in the in-memory ring; a background thread writes it out. */
+  MAGI_LOG_SINK_RING = 1,
+} MagiLogSink;
+
+/** Most verbose level compiled in; lines above it cost nothing. */
+#ifndef MAGI_LOG_COMPILE_LEVEL
+#define MAGI_LOG_COMPILE_LEVEL MAGI_LOG_DEBUG
+#endif
+
+/** Subsystem of the including translation unit. */
+#ifndef MAGI_LOG_SUBSYS
+#define MAGI_LOG_SUBSYS MAGI_LOG_CORE
+#endif
+
+/** Ring slots; a power of two. */
+#define MAGI_LOG_RING_SLOTS 4096U
+/** Longest line kept by the ring sink, newline included; longer lines are cut. */
+#define MAGI_LOG_LINE_MAX 240U
+
+/** Run-time level per subsystem (internal; use magi_log_set_level()). */
+extern _Atomic uint8_t magi_log_levels[MAGI_LOG_SUBSYS_COUNT];
+
 /**
- * @brief Emit an informational log line to stdout.
+ * @brief Check whether a line would be emitted.
  *
- * Output format is [node] message.
+ * @param subsys MagiLogSubsys of the line.
+ * @param level MagiLogLevel of the line.
  */
-#define LOG(node_name, fmt, ...)                                                                   \
-  do {                                                                                             \
-    const char* magi_log_name = (node_name) != NULL ? (node_name) : "?";                           \
-    fprintf(stdout, "[%s] " fmt "\n", magi_log_name __VA_OPT__(, ) __VA_ARGS__);                   \
-    fflush(stdout);                                                                                \
-  } while (0)
+#define magi_log_enabled(subsys, level)                                                            \
+  ((level) <= MAGI_LOG_COMPILE_LEVEL &&                                                            \
+   atomic_load_explicit(&magi_log_levels[(subsys)], memory_order_relaxed) >= (level))
 
 /**
- * @brief Emit a warning log line to stderr.
+ * @brief Emit one line at a level from the current subsystem.
  *
- * Output format is [node][WARN] message.
+ * Arguments are not evaluated when the line is filtered out.
  */
-#define LOG_WARN(node_name, fmt, ...)                                                              \
+#define MAGI_LOG_AT(level, tag, node_name, fmt, ...)                                               \
   do {                                                                                             \
-    const char* magi_log_name = (node_name) != NULL ? (node_name) : "?";                           \
-    fprintf(stderr, "[%s][WARN] " fmt "\n", magi_log_name __VA_OPT__(, ) __VA_ARGS__);             \
-    fflush(stderr);                                                                                \
+    if (magi_log_enabled(MAGI_LOG_SUBSYS, (level))) {                                              \
+      const char* magi_log_name = (node_name) != NULL ? (node_name) : "?";                         \
+      magi_log_write((level), "[%s]" tag " " fmt "\n", magi_log_name __VA_OPT__(, ) __VA_ARGS__);  \
+    }                                                                                              \
   } while (0)
 
-#endif
\ No newline at end of file
+/** @brief Emit an informational line: [node] message. */
+#define LOG(node_name, fmt, ...)                                                                   \
+  MAGI_LOG_AT(MAGI_LOG_INFO, "", node_name, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+/** @brief Emit a per-packet trace line, off unless the subsystem is at debug. */
+#define LOG_DEBUG(node_name, fmt, ...)                                                             \
+  MAGI_LOG_AT(MAGI_LOG_DEBUG, "", node_name, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+/** @brief Emit a warning line to stderr: [node][WARN] message. */
+#define LOG_WARN(node_name, fmt, ...)                                                              \
+  MAGI_LOG_AT(MAGI_LOG_WARN, "[WARN]", node_name, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+/** @brief Emit an error line to stderr: [node][ERROR] message. */
+#define LOG_ERROR(node_name, fmt, ...)                                                             \
+  MAGI_LOG_AT(MAGI_LOG_ERROR, "[ERROR]", node_name, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+/**
+ * @brief Format and emit a line through the current sink.
+ *
+ * Call through the LOG macros, which apply the level filters.
+ *
+ * @param level MagiLogLevel; warn and error lines go to stderr.
+ * @param fmt printf format producing the whole line, newline included.
+ */
+void magi_log_write(MagiLogLevel level, const char* fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Set the run-time level of one subsystem.
+ *
+ * @param subsys Subsystem to change.
+ * @param level Most verbose level to emit.
+ */
+void magi_log_set_level(MagiLogSubsys subsys, MagiLogLevel level);
+
+/**
+ * @brief Get the run-time level of one subsystem.
+ *
+ * @param subsys Subsystem to query.
+ * @return Current level.
+ */
+MagiLogLevel magi_log_level(MagiLogSubsys subsys);
+
+/**
+ * @brief Apply a level spec such as "warn", "l3=debug" or "info,l2=warn,l4=debug".
+ *
+ * A bare level applies to every subsystem except cli, so command replies
+ * stay visible; subsys=level entries apply to one. Entries are applied
+ * left to right. Nothing changes if any entry is malformed.
+ *
+ * @param spec Comma-separated spec.
+ * @return MAGI_OK, or MAGI_ERR_BADARGS.
+ */
+int magi_log_apply_spec(const char* spec);
+
+/**
+ * @brief Switch the output sink.
+ *
+ * Switching to the ring starts the drain thread; switching back to sync
+ * writes out whatever is still queued first, so lines stay in order.
+ *
+ * @param sink New sink.
+ * @return MAGI_OK, or MAGI_ERR_NOMEM if the drain thread cannot start.
+ */
+int magi_log_set_sink(MagiLogSink sink);
+
+/**
+ * @brief Get the current sink.
+ *
+ * @return Current sink.
+ */
+MagiLogSink magi_log_sink(void);
+
+/**
+ * @brief Write out every line queued in the ring so far.
+ */
+void magi_log_flush(void);
+
+/**
+ * @brief Lines the ring sink has dropped because it was full.
+ *
+ * @return Total dropped since start.
+ */
+uint64_t magi_log_dropped(void);
+
+/**
+ * @brief Configure from MAGI_LOG_LEVEL (a spec) and MAGI_LOG_SINK ("sync" or "ring").
+ *
+ * Unset variables leave the defaults alone; invalid ones are reported and ignored.
+ */
+void magi_log_init_from_env(void);
+
+/**
+ * @brief Name of a level, such as "info".
+ *
+ * @param level Level.
+ * @return Static string.
+ */
+const char* magi_log_level_name(MagiLogLevel level);
+
+/**
+ * @brief Name of a subsystem, such as "l3".
+ *
+ * @param subsys Subsystem.
+ * @return Static string.
+ */
+const char* magi_log_subsys_name(MagiLogSubsys subsys);
+
+#endif
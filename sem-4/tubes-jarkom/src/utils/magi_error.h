@@ -35,5 +35,9 @@ extern _Thread_local int magi_errno;
 #define MAGI_ERR_FRAGMENTED -10
 /** Invalid arguments. */
 #define MAGI_ERR_BADARGS -11
+/** Egress queue full; the frame was dropped. */
+#define MAGI_ERR_QUEUE_FULL -12
+/** Datagram exceeds the path MTU and has Don't Fragment set. */
+#define MAGI_ERR_MSGSIZE -13
 
 #endif
\ No newline at end of file
@@ -1,8 +1,13 @@
 #define _POSIX_C_SOURCE 200809L
 
+#include "core/link.h"
 #include "core/node.h"
+#include "core/sim.h"
+#include "layer2/host.h"
+#include "layer3/ipv4.h"
 #include "layer4/l4_host.h"
 #include "layer4/port_registry.h"
+#include "layer4/tcp_conn.h"
 #include "layer4/tcp_socket.h"
 #include "layer4/udp_socket.h"
 #include "layer7/magi_socket.h"
@@ -229,6 +234,130 @@ static void test_port_cleanup(void) {
   node_free(node);
 }
 
+/* -----------------------------------------------------------------------
+ * Test 8: Ephemeral port allocation
+ * ----------------------------------------------------------------------- */
+static void test_ephemeral_ports(void) {
+  printf("\n--- Test: Ephemeral Port Allocation ---\n");
+
+  PortRegistry* reg = port_registry_new();
+  int owner = 0;
+  uint16_t first = 0U;
+  uint16_t second = 0U;
+  uint16_t port = 0U;
+  port_registry_bind_ephemeral(reg, PORT_PROTOCOL_UDP, &owner, &first);
+  port_registry_bind_ephemeral(reg, PORT_PROTOCOL_UDP, &owner, &second);
+  ASSERT(first == PORT_EPHEMERAL_MIN && second == PORT_EPHEMERAL_MIN + 1U,
+         "Ephemeral ports start at the bottom of the range");
+
+  port_registry_bind(reg, PORT_PROTOCOL_UDP, PORT_EPHEMERAL_MIN + 2U, &owner);
+  port_registry_unbind(reg, PORT_PROTOCOL_UDP, first);
+  port_registry_bind_ephemeral(reg, PORT_PROTOCOL_UDP, &owner, &port);
+  ASSERT(port == PORT_EPHEMERAL_MIN + 3U, "Explicit binds skipped, released port not reused");
+  ASSERT(port_registry_lookup(reg, PORT_PROTOCOL_TCP, port) == NULL, "Protocols are separate");
+
+  size_t count = 0U;
+  while (port_registry_bind_ephemeral(reg, PORT_PROTOCOL_UDP, &owner, &port) == MAGI_OK) {
+    ++count;
+  }
+  ASSERT(count == PORT_EPHEMERAL_MAX - PORT_EPHEMERAL_MIN + 1U - 3U,
+         "Every free port handed out once before exhaustion");
+  port_registry_unbind(reg, PORT_PROTOCOL_UDP, 50000U);
+  ASSERT(port_registry_bind_ephemeral(reg, PORT_PROTOCOL_UDP, &owner, &port) == MAGI_OK &&
+             port == 50000U,
+         "Search wraps around to a released port");
+  port_registry_free(reg);
+
+  Node* node = node_new("EphemeralHost");
+  l4_host_attach(node);
+  MagiSocket* sock = magi_socket(node, MAGI_AF_INET, MAGI_SOCK_DGRAM);
+  (void)magi_sendto(sock, (const uint8_t*)"x", 1U, "10.9.9.9", 53);
+  ASSERT(sock->bound && sock->local_port >= PORT_EPHEMERAL_MIN &&
+             port_registry_lookup(l4_host_get_registry(node), PORT_PROTOCOL_UDP,
+                                  sock->local_port) == sock->transport,
+         "sendto binds an unbound socket to an ephemeral port");
+  magi_close(sock);
+  node_free(node);
+}
+
+/* -----------------------------------------------------------------------
+ * Test 9: Concurrent connections to one listening port (sequential only)
+ * ----------------------------------------------------------------------- */
+#ifndef MAGI_ASYNC
+static Node* make_linked_host(const char* name, const char* cidr) {
+  Host* host = host_new(name);
+  Node* node = host_as_node(host);
+  host_configure(host, cidr, NULL);
+  ipv4_host_attach(node);
+  l4_host_attach(node);
+  return node;
+}
+
+static bool tcp_established(const void* ctx) {
+  return ((const TCPSocket*)ctx)->state == TCP_ESTABLISHED;
+}
+
+static void test_accept_backlog(void) {
+  printf("\n--- Test: Four-Tuple Demux and Backlog ---\n");
+
+  Node* client = make_linked_host("Client", "10.0.0.1/24");
+  Node* server = make_linked_host("Server", "10.0.0.2/24");
+  Link* link = link_new(node_get_interface(client, 1U), node_get_interface(server, 1U), 0U, 1500U);
+
+  MagiSocket* listener = magi_socket(server, MAGI_AF_INET, MAGI_SOCK_STREAM);
+  magi_bind(listener, "10.0.0.2", 80);
+  magi_listen(listener, 2);
+  TCPSocket* listen_tcp = (TCPSocket*)listener->transport;
+
+  /* Three clients on one host; the third SYN finds the accept queue full */
+  MagiSocket* clients[3];
+  for (uint16_t index = 0U; index < 3U; ++index) {
+    clients[index] = magi_socket(client, MAGI_AF_INET, MAGI_SOCK_STREAM);
+    magi_bind(clients[index], "10.0.0.1", (uint16_t)(40001U + index));
+    magi_connect(clients[index], "10.0.0.2", 80);
+  }
+  TCPSocket* third = (TCPSocket*)clients[2]->transport;
+  ASSERT(((TCPSocket*)clients[0]->transport)->state == TCP_ESTABLISHED &&
+             ((TCPSocket*)clients[1]->transport)->state == TCP_ESTABLISHED,
+         "First two clients established concurrently");
+  ASSERT(third->state == TCP_SYN_SENT && listen_tcp->listen.syn_drops > 0U,
+         "Third SYN dropped while the backlog is full");
+  ASSERT(listen_tcp->state == TCP_LISTEN, "Listener stays in LISTEN");
+  ASSERT(magi_has_data(listener), "Listener readable with connections queued");
+
+  MagiSocket* first = magi_accept(listener);
+  MagiSocket* second = magi_accept(listener);
+  ASSERT(first != NULL && ((TCPSocket*)first->transport)->remote_port == 40001U &&
+             second != NULL && ((TCPSocket*)second->transport)->remote_port == 40002U,
+         "Accept returns connections in arrival order");
+
+  magi_send(clients[1], (const uint8_t*)"two", 3U);
+  ASSERT(magi_has_data(second) && !magi_has_data(first), "Data reaches only its own connection");
+
+  /* The retransmitted SYN gets in now that the queue has room */
+  sim_run_until_cond(tcp_established, third, 30000U * SIM_NS_PER_MS);
+  ASSERT(third->state == TCP_ESTABLISHED, "Dropped client connects on SYN retransmission");
+  MagiSocket* late = magi_accept(listener);
+  ASSERT(late != NULL && ((TCPSocket*)late->transport)->remote_port == 40003U,
+         "Retried connection accepted");
+  ASSERT(tcp_conn_table_count(l4_host_get(server)->conns) == 3U, "Three connections in the table");
+
+  magi_close(first);
+  magi_close(second);
+  magi_close(late);
+  ASSERT(tcp_conn_table_count(l4_host_get(server)->conns) == 0U, "Closed connections leave");
+  ASSERT(port_registry_lookup(l4_host_get_registry(server), PORT_PROTOCOL_TCP, 80) == listen_tcp,
+         "Listener keeps the port binding");
+  for (size_t index = 0U; index < 3U; ++index) {
+    magi_close(clients[index]);
+  }
+  magi_close(listener);
+  link_free(link);
+  node_free(client);
+  node_free(server);
+}
+#endif
+
 /* ======================================================================= */
 
 int main(void) {
@@ -241,6 +370,10 @@ int main(void) {
   test_udp_recvfrom();
   test_close_null();
   test_port_cleanup();
+  test_ephemeral_ports();
+#ifndef MAGI_ASYNC
+  test_accept_backlog();
+#endif
 
   printf("\n=== Results: %d/%d tests passed ===\n", tests_passed, tests_run);
 
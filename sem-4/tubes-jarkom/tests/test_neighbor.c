@@ -0,0 +1,125 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "core/interface.h"
+#include "core/link.h"
+#include "core/node.h"
+#include "core/sim.h"
+#include "layer2/host.h"
+#include "layer2/neighbor.h"
+#include "layer3/ipv4.h"
+#include "utils/byteops.h"
+#include "utils/magi_error.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define ASSERT(cond, msg)                                                                         \
+  do {                                                                                            \
+    tests_run++;                                                                                  \
+    if (cond) {                                                                                   \
+      printf("  PASS: %s\n", (msg));                                                              \
+      tests_passed++;                                                                             \
+    } else {                                                                                      \
+      printf("  FAIL: %s\n", (msg));                                                              \
+    }                                                                                             \
+  } while (0)
+
+#ifndef MAGI_ASYNC
+/* A peer that never answers; it only counts the ARP requests that reach it. */
+static size_t arp_requests = 0U;
+
+static void silent_receive(Node* node, Interface* iface, const uint8_t* data, size_t len) {
+  (void)node;
+  (void)iface;
+  if (len >= 14U + 8U && READ_U16(data, 12U) == 0x0806U && READ_U16(data, 14U + 6U) == 1U) {
+    arp_requests++;
+  }
+}
+
+/* -----------------------------------------------------------------------
+ * Test 1: a ping that timed out does not block the next ARP request
+ * ----------------------------------------------------------------------- */
+static void test_arp_retry_after_timeout(void) {
+  printf("\n--- Test: ARP Retry After Ping Timeout ---\n");
+
+  Host* host = host_new("PINGER");
+  Node* node = host_as_node(host);
+  host_configure(host, "10.0.0.1/24", NULL);
+  ipv4_host_attach(node);
+  Node* peer = node_new("SILENT");
+  peer->handle_receive = silent_receive;
+  Link* link = link_new(node_get_interface(node, 1U), node_add_interface(peer, 1U), 1U, 1500U);
+  ASSERT(link != NULL, "Link the host to a silent peer");
+
+  /* Start away from t=0 so probe timestamps are ordinary values. */
+  (void)sim_run_until(sim_now_ns() + 10000U * SIM_NS_PER_MS);
+  arp_requests = 0U;
+
+  uint64_t start_ms = sim_now_ms();
+  (void)ipv4_host_ping(node, "10.0.0.99");
+  ASSERT(arp_requests == 1U, "First ping sends an ARP request");
+  ASSERT(sim_now_ms() >= start_ms + IPV4_PROBE_TIMEOUT_MS,
+         "The clock moves to the deadline when the ping times out");
+
+  (void)ipv4_host_ping(node, "10.0.0.99");
+  ASSERT(arp_requests == 2U, "Second ping sends a new ARP request");
+
+  link_free(link);
+  node_free(peer);
+  host_free(host);
+}
+
+/* -----------------------------------------------------------------------
+ * Test 2: entries nobody looks up again are swept on the clock
+ * ----------------------------------------------------------------------- */
+static void test_sweep_idle_entries(void) {
+  printf("\n--- Test: Neighbor Sweep ---\n");
+
+  NeighborTable* table = neighbor_table_new(8U);
+  ASSERT(table != NULL, "Create neighbor table");
+
+  uint64_t start_ms = neighbor_now_ms();
+  const uint8_t resolved_ip[4] = {10U, 0U, 0U, 2U};
+  const uint8_t mac[6] = {0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x02U};
+  const uint8_t unanswered_ip[4] = {10U, 0U, 0U, 3U};
+  ASSERT(neighbor_update(table, resolved_ip, mac, start_ms) == MAGI_OK, "Learn a neighbor");
+  ASSERT(neighbor_start_probe(table, unanswered_ip, start_ms), "Probe an unanswered address");
+  ASSERT(neighbor_count(table) == 2U, "Both entries are in the table");
+
+  (void)sim_run_until((start_ms + NEIGHBOR_INCOMPLETE_MS) * SIM_NS_PER_MS);
+  ASSERT(neighbor_count(table) == 1U, "The unanswered entry is swept after its timeout");
+
+  (void)sim_run_until((start_ms + NEIGHBOR_REACHABLE_MS + NEIGHBOR_STALE_MS) * SIM_NS_PER_MS);
+  ASSERT(neighbor_count(table) == 0U, "The stale entry is swept without a lookup");
+
+  uint32_t gen = neighbor_generation(table);
+  neighbor_table_free(table);
+  ASSERT(gen != 0U, "Sweeping a resolved entry bumps the generation");
+}
+#endif
+
+/* ======================================================================= */
+
+int main(void) {
+  printf("=== Neighbor Table Tests ===\n");
+
+#ifndef MAGI_ASYNC
+  test_arp_retry_after_timeout();
+  test_sweep_idle_entries();
+#else
+  printf("\nskipped: the tests drive the sequential simulation clock\n");
+#endif
+
+  printf("\n=== Results: %d/%d tests passed ===\n", tests_passed, tests_run);
+
+  if (tests_passed != tests_run) {
+    printf("RESULT: FAIL\n");
+    return 1;
+  }
+  printf("RESULT: PASS\n");
+  return 0;
+}